@@ -0,0 +1,71 @@
+#ifndef OC8_ARENA_OC8_ARENA_H_
+#define OC8_ARENA_OC8_ARENA_H_
+
+//===--oc8_arena/oc8_arena.h - Bump allocator ---------------------*- C -*-===//
+//
+// oc8_arena library
+// Author: Steven Lariau
+//
+//===----------------------------------------------------------------------===//
+///
+/// \file
+/// Definition of struct oc8_arena_t
+/// Bump allocator: memory is taken from big chunks, and all of it is
+/// released at once when the arena is freed
+///
+/// The data structures of the toolchain (sfile, bin file, linker, smap) can
+/// allocate from an arena given by the caller. Then a whole assemble / link
+/// job is freed in O(1) by freeing the arena, and their free functions don't
+/// release anything
+///
+//===----------------------------------------------------------------------===//
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Default size of a chunk
+#define OC8_ARENA_CHUNK_SIZE (64 * 1024)
+
+typedef struct oc8_arena_chunk oc8_arena_chunk_t;
+
+/// Bump allocator
+/// A zero-initialized struct is a valid empty arena with the default chunk
+/// size
+typedef struct {
+  oc8_arena_chunk_t *chunks; // current chunk, then all the previous ones
+  size_t chunk_size;         // 0 for OC8_ARENA_CHUNK_SIZE
+  size_t nb_chunks;
+  size_t nb_bytes; // total size of all allocations
+} oc8_arena_t;
+
+/// Initialize an empty arena
+/// `chunk_size` is the size of chunks allocated with malloc, 0 for the default
+/// Bigger allocations get their own chunk
+void oc8_arena_init(oc8_arena_t *arena, size_t chunk_size);
+
+/// Free all memory allocated by the arena
+void oc8_arena_free(oc8_arena_t *arena);
+
+/// Allocate `size` bytes, aligned for any type
+/// If `arena` is NULL, use malloc
+void *oc8_arena_alloc(oc8_arena_t *arena, size_t size);
+
+/// Resize `ptr`, allocated by `oc8_arena_alloc` with size `old_size`
+/// Only the last allocation of the arena grows in place, any other one is
+/// moved and the old memory is lost until the arena is freed
+/// If `arena` is NULL, use realloc
+void *oc8_arena_realloc(oc8_arena_t *arena, void *ptr, size_t old_size,
+                        size_t size);
+
+/// Release `ptr`, allocated by `oc8_arena_alloc`
+/// If `arena` is NULL, use free, otherwise does nothing
+void oc8_arena_release(oc8_arena_t *arena, void *ptr);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // !OC8_ARENA_OC8_ARENA_H_
@@ -16,18 +16,47 @@
 #include <stddef.h>
 #include <stdint.h>
 
+#include "../oc8_bin/cache.h"
 #include "../oc8_bin/file.h"
+#include "../oc8_pool/oc8_pool.h"
+#include "opt.h"
 #include "sfile.h"
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+/// Must be changed every time the assembler output changes for the same
+/// source, to invalidate the objects in the caches
+#define OC8_AS_CACHE_VERSION (2)
+
 /// Build and fill `bf` from `sf`
 /// Works correctly only if `oc8_as_sfile_check(sf)` was successfull
-/// `oc8_bin_file_check` isn't called at the end
-/// `bf` must not be initialized
-void oc8_as_compile_sfile(oc8_as_sfile_t *sf, oc8_bin_file_t *bf);
+/// `oc8_bin_file_validate` isn't called at the end
+/// `bf` must not be initialized, it allocates from the arena of `sf`, if any
+/// @returns 0 if success, != 0 if a symbol or the ROM is invalid (printed),
+/// `bf` is freed then
+int oc8_as_compile_sfile(oc8_as_sfile_t *sf, oc8_bin_file_t *bf);
+
+/// Assemble one file: parse and check `in_path`, compile it, and write the
+/// object file to `out_path`
+/// Errors don't abort the program: they are printed, and only this file
+/// fails. All memory of the job comes from one arena, released even on error
+/// Can be called by many threads at once
+/// @param pool if not NULL, the file is parsed in chunks by the threads of
+/// `pool` (see `oc8_as_parse_raw_parallel`)
+/// @param cache if not NULL, the output is taken from the cache when it
+/// already has an object for the same source, or stored in it
+/// @returns 0 if success, != 0 on error
+int oc8_as_assemble_file(const char *in_path, const char *out_path,
+                         oc8_pool_t *pool, const oc8_bin_cache_t *cache);
+
+/// Same as `oc8_as_assemble_file`, but the code is optimized with the passes
+/// in `opt_flags` before it's compiled (see `oc8_as_optimize_sfile`)
+/// The cached objects are different for every `opt_flags`
+int oc8_as_assemble_file_opt(const char *in_path, const char *out_path,
+                             oc8_pool_t *pool, const oc8_bin_cache_t *cache,
+                             unsigned opt_flags);
 
 #ifdef __cplusplus
 }
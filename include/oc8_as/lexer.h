@@ -0,0 +1,153 @@
+#ifndef OC8_AS_LEXER_H_
+#define OC8_AS_LEXER_H_
+
+//===--oc8_as/lexer.h - Tokenizer of assembly code ----------------*- C -*-===//
+//
+// oc8_as library
+// Author: Steven Lariau
+//
+//===----------------------------------------------------------------------===//
+///
+/// \file
+/// Lexer: split a stream in typed tokens for the parser
+/// Mnemonics, directives, registers and type names are resolved to enum ids
+/// with a perfect hash table, in constant time
+///
+//===----------------------------------------------------------------------===//
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "oc8_defs/consts.h"
+#include "stream.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+  OC8_AS_TOK_EOF,
+  OC8_AS_TOK_NL,     // end of line, comments are skipped until the '\n'
+  OC8_AS_TOK_ID,     // identifier: mnemonic, label or symbol
+  OC8_AS_TOK_INT,    // integer (bases 2, 8, 10 and 16)
+  OC8_AS_TOK_DIR,    // '.' <directive>
+  OC8_AS_TOK_REG,    // '%' <register>
+  OC8_AS_TOK_TYPE,   // '@' <typename>
+  OC8_AS_TOK_COMMA,  // ','
+  OC8_AS_TOK_COLON,  // ':'
+  OC8_AS_TOK_LPAREN, // '('
+  OC8_AS_TOK_RPAREN, // ')'
+  OC8_AS_TOK_ERR,    // invalid input, the lexer stays on this token
+} oc8_as_tok_kind_t;
+
+typedef enum {
+  OC8_AS_MN_NONE, // identifier isn't a mnemonic
+  OC8_AS_MN_ADD,
+  OC8_AS_MN_AND,
+  OC8_AS_MN_BCD,
+  OC8_AS_MN_CALL,
+  OC8_AS_MN_CLS,
+  OC8_AS_MN_DRAW,
+  OC8_AS_MN_FSPR,
+  OC8_AS_MN_JMP,
+  OC8_AS_MN_MOV,
+  OC8_AS_MN_MOVM,
+  OC8_AS_MN_OR,
+  OC8_AS_MN_RAND,
+  OC8_AS_MN_RET,
+  OC8_AS_MN_SHL,
+  OC8_AS_MN_SHR,
+  OC8_AS_MN_SKPE,
+  OC8_AS_MN_SKPN,
+  OC8_AS_MN_SKPKP,
+  OC8_AS_MN_SKPKN,
+  OC8_AS_MN_SUB,
+  OC8_AS_MN_SUBN,
+  OC8_AS_MN_SYS,
+  OC8_AS_MN_WAITK,
+  OC8_AS_MN_XOR,
+} oc8_as_mn_t;
+
+typedef enum {
+  OC8_AS_DIR_BYTE,
+  OC8_AS_DIR_EQU,
+  OC8_AS_DIR_GLOBL,
+  OC8_AS_DIR_SIZE,
+  OC8_AS_DIR_TYPE,
+  OC8_AS_DIR_WORD,
+  OC8_AS_DIR_ZERO,
+} oc8_as_dir_t;
+
+// %v0 to %vf have ids 0x0 to 0xf
+typedef enum {
+  OC8_AS_REG_VF = 0xF,
+  OC8_AS_REG_I,
+  OC8_AS_REG_DT,
+  OC8_AS_REG_ST,
+} oc8_as_reg_t;
+
+typedef enum {
+  OC8_AS_TYPENAME_FUNCTION,
+  OC8_AS_TYPENAME_OBJECT,
+} oc8_as_typename_t;
+
+/// Entry of the keywords table
+typedef struct {
+  const char *name; // with the prefix: `.byte`, `%v0`, `@function`
+  uint8_t len;
+  uint8_t kind; // oc8_as_tok_kind_t: ID (mnemonics), DIR, REG or TYPE
+  uint8_t id;   // oc8_as_mn_t, oc8_as_dir_t, oc8_as_reg_t or oc8_as_typename_t
+} oc8_as_keyword_t;
+
+typedef struct {
+  oc8_as_tok_kind_t kind;
+  // INT: value
+  // ID: oc8_as_mn_t, OC8_AS_MN_NONE if not a mnemonic
+  // DIR / REG / TYPE: id of the keyword
+  unsigned val;
+  size_t row; // start at 1
+  size_t col; // start at 1
+  char text[OC8_MAX_SYM_SIZE + 1]; // ID only, 0-terminated
+} oc8_as_token_t;
+
+typedef struct {
+  oc8_as_stream_t *is;
+  const char *name; // file path or (raw) for strings
+  size_t row;       // position of the next char in the stream
+  size_t col;
+  oc8_as_token_t tok; // current token
+} oc8_as_lexer_t;
+
+/// All keywords: mnemonics, directives, registers and type names
+extern const oc8_as_keyword_t g_oc8_as_keywords[];
+extern const size_t g_oc8_as_keywords_size;
+
+/// Find a keyword by its name (including the prefix char), O(1)
+/// @returns NULL if `str` isn't a keyword
+const oc8_as_keyword_t *oc8_as_find_keyword(const char *str, size_t len);
+
+/// Initialize the lexer, and read the first token
+/// @param name name of the stream for error messages
+void oc8_as_lexer_init(oc8_as_lexer_t *lx, oc8_as_stream_t *is,
+                       const char *name);
+
+/// Same as `oc8_as_lexer_init`, but the stream starts at line `row` of the
+/// input, when it's only a part of a bigger file
+void oc8_as_lexer_init_at(oc8_as_lexer_t *lx, oc8_as_stream_t *is,
+                          const char *name, size_t row);
+
+/// Read the next token in `lx->tok`
+/// If the input has an invalid token, an error message is printed and the
+/// token kind is `OC8_AS_TOK_ERR` for this call and all the next ones
+/// @returns `lx->tok`
+const oc8_as_token_t *oc8_as_lexer_next(oc8_as_lexer_t *lx);
+
+/// Print a syntax error at the position of the current token, and set its
+/// kind to `OC8_AS_TOK_ERR`. Nothing is printed if it's already an error
+void oc8_as_lexer_error(oc8_as_lexer_t *lx, const char *msg);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // !OC8_AS_LEXER_H_
@@ -0,0 +1,53 @@
+#ifndef OC8_AS_OPT_H_
+#define OC8_AS_OPT_H_
+
+//===--oc8_as/opt.h - Peephole optimizer --------------------------*- C -*-===//
+//
+// oc8_as library
+// Author: Steven Lariau
+//
+//===----------------------------------------------------------------------===//
+///
+/// \file
+/// Peephole optimizer: rewrite the items of an `oc8_as_sfile_t` before it's
+/// compiled, to get smaller code that runs fewer instructions
+///
+//===----------------------------------------------------------------------===//
+
+#include <stddef.h>
+
+#include "sfile.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+  /// Delete `mov %vX, %vX`, `add 0, %vX`, and `jmp` to the next instruction
+  OC8_AS_OPT_NOPS = 1 << 0,
+  /// `jmp` / `call` to a `jmp L` goes straight to `L`, `jmp` to a `ret` is a
+  /// `ret`
+  OC8_AS_OPT_JUMPS = 1 << 1,
+  /// `call f` followed by `ret` is a `jmp f`
+  OC8_AS_OPT_TAIL_CALLS = 1 << 2,
+
+  OC8_AS_OPT_ALL =
+      OC8_AS_OPT_NOPS | OC8_AS_OPT_JUMPS | OC8_AS_OPT_TAIL_CALLS,
+} oc8_as_opt_flags_t;
+
+/// Optimize the items of `sf` with the passes in `flags`, until nothing
+/// changes
+/// Symbol positions and sizes are moved with the items. Instructions are
+/// never deleted after a skip instruction, or when they have a label (`ret`
+/// only). If the file has a `jmp_v0`, or a `.align` bigger than 2, the code
+/// layout may be used for computed jumps: instructions are rewritten, but
+/// none is deleted
+/// Must be called after `oc8_as_sfile_check(sf)`
+/// @returns the number of bytes deleted
+size_t oc8_as_optimize_sfile(oc8_as_sfile_t *sf, unsigned flags);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // !OC8_AS_OPT_H_
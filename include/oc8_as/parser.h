@@ -17,6 +17,7 @@
 #include <stddef.h>
 #include <stdint.h>
 
+#include "oc8_pool/oc8_pool.h"
 #include "sfile.h"
 #include "stream.h"
 
@@ -24,6 +25,9 @@
 extern "C" {
 #endif
 
+/// Default size in bytes of the chunks for parallel parsing
+#define OC8_AS_PARSE_CHUNK_SIZE (128 * 1024)
+
 /// Parse an input stream to build an sfile
 /// User is reponsible for deallocating the sfile and `is`
 /// @param is_name name given to the stream for better error messages. optional
@@ -31,18 +35,50 @@ extern "C" {
 /// `oc8_as_sfile_check` isn't called after the parsing
 oc8_as_sfile_t *oc8_as_run_parser(oc8_as_stream_t *is, const char *is_name);
 
+/// Same as `oc8_as_run_parser`, but the sfile allocates from `arena`
+/// (see `oc8_as_sfile_new_arena`)
+oc8_as_sfile_t *oc8_as_run_parser_arena(oc8_as_stream_t *is,
+                                        const char *is_name,
+                                        oc8_arena_t *arena);
+
 /// Wrapper `around oc8_as_run_parser`
 /// Parse an input file to build an sfile
 /// User is reponsible for deallocating the sfile
 /// @returns pointer to newly allocated sfile
 oc8_as_sfile_t *oc8_as_parse_file(const char *path);
 
+/// Same as `oc8_as_parse_file`, but the sfile allocates from `arena`
+oc8_as_sfile_t *oc8_as_parse_file_arena(const char *path, oc8_arena_t *arena);
+
 /// Wrapper `around oc8_as_run_parser`
 /// Parse a raw ascii string to build an sfile
 /// User is reponsible for deallocating the sfile
 /// @returns pointer to newly allocated sfile
 oc8_as_sfile_t *oc8_as_parse_raw(const char *str, size_t len);
 
+/// Same as `oc8_as_parse_raw`, but the sfile allocates from `arena`
+oc8_as_sfile_t *oc8_as_parse_raw_arena(const char *str, size_t len,
+                                       oc8_arena_t *arena);
+
+/// Parse a raw ascii string with many threads
+/// The input is split in chunks at line boundaries. The chunks are parsed in
+/// parallel with `pool`, each one in its own sfile, and then merged in order
+/// (see `oc8_as_sfile_append`)
+/// The result is identical to the one of `oc8_as_parse_raw_arena`
+/// On error, the first error of every failing chunk is printed
+/// @param is_name name of the input for error messages
+/// @param chunk_size approximate size of a chunk in bytes, 0 for the default
+/// @returns pointer to newly allocated sfile, from `arena` if not NULL
+oc8_as_sfile_t *oc8_as_parse_raw_parallel(const char *str, size_t len,
+                                          const char *is_name,
+                                          oc8_pool_t *pool, size_t chunk_size,
+                                          oc8_arena_t *arena);
+
+/// Same as `oc8_as_parse_raw_parallel` with the default chunk size, on the
+/// content of the file at `path`, mapped in memory
+oc8_as_sfile_t *oc8_as_parse_file_parallel(const char *path, oc8_pool_t *pool,
+                                           oc8_arena_t *arena);
+
 #ifdef __cplusplus
 }
 #endif
@@ -16,6 +16,8 @@
 #include <stddef.h>
 #include <stdint.h>
 
+#include "oc8_arena/oc8_arena.h"
+#include "oc8_is/ins.h"
 #include "oc8_smap/oc8_smap.h"
 
 #define OC8_AS_MAX_SYMS (256)
@@ -52,11 +54,12 @@ typedef enum {
 } oc8_as_sym_type_t;
 
 typedef struct {
-  const char *name; // pointer to the str stored in smap
+  const char *name; // interned (see oc8_smap/oc8_strpool.h)
   uint16_t pos;
   uint16_t size;
   oc8_as_sym_type_t type;
   int is_global;
+  int has_size; // 1 if set by a .size directive, even to 0
 } oc8_as_sym_def_t;
 
 /// This struct is used to create an assembly file
@@ -96,38 +99,64 @@ typedef struct {
   uint16_t next_sym_idx; // index of next symbol
 
   oc8_smap_t equ_map; // map for .equ directive
+
+  // All memory is allocated from this arena, or with malloc if NULL
+  oc8_arena_t *arena;
 } oc8_as_sfile_t;
 
 /// Allocate and initialize a sfile_t struct
 /// @returns the pointer to the initialized struct
 oc8_as_sfile_t *oc8_as_sfile_new();
 
+/// Same as `oc8_as_sfile_new`, but all memory (and the struct itself) is
+/// allocated from `arena`. `oc8_as_sfile_free` doesn't release anything
+oc8_as_sfile_t *oc8_as_sfile_new_arena(oc8_arena_t *arena);
+
 /// Free all memory used by the struct (and the struct itself)
 void oc8_as_sfile_free(oc8_as_sfile_t *as);
 
 /// Make sure the sfile is valid
-/// If it's not, the program abort
 /// Possible errors are:
 /// - empty file
 /// - trying to set properties (type, size, globl) of extern symbol
-void oc8_as_sfile_check(oc8_as_sfile_t *as);
+/// @returns 0 if valid, != 0 otherwise (errors are printed)
+int oc8_as_sfile_check(oc8_as_sfile_t *as);
 
 /// Add a symbol at the current position in the code
-void oc8_as_sfile_add_sym(oc8_as_sfile_t *as, const char *sym);
+/// @returns 0 if success, != 0 on error (redefinition, name too long)
+int oc8_as_sfile_add_sym(oc8_as_sfile_t *as, const char *sym);
 
 /// Returns the index associated with a symbol
 /// Create one if doesn't exist yet
+/// Returns 0 if the name is invalid, or if there are already
+/// `OC8_AS_MAX_SYMS` symbols
 uint16_t oc8_as_sfile_get_sym_idx(oc8_as_sfile_t *as, const char *sym);
 
 /// Get the value of a constant (added with .equ directive)
 /// Returns a pointer to the value, and null if not found
 size_t *oc8_as_sfile_get_equ(oc8_as_sfile_t *as, const char *key);
 
+/// Append all items, symbols and constants of `other` at the end of `as`
+/// The result is the same as if all calls used to build `other` were made on
+/// `as` instead: symbol indices are created in the same order, positions are
+/// shifted by the size of `as`, and redefinitions are errors
+/// `other` isn't modified, and must not have align items, unless the end of
+/// `as` is already aligned
+/// @returns 0 if success, != 0 on error (errors are printed)
+int oc8_as_sfile_append(oc8_as_sfile_t *as, oc8_as_sfile_t *other);
+
 // ## Add instructions functions ##
 
+/// Add the instruction `ins`, its type and operands must be filled
+/// `op_sym` is NULL, or the symbol used by its immediate operand
+/// @returns 0 if success, != 0 on error
+/// The `sins` and symbol directive functions below also return 0 if success
+int oc8_as_sfile_add_ins(oc8_as_sfile_t *as, oc8_is_ins_t *ins,
+                         const char *op_sym);
+
 void oc8_as_sfile_ins_add_imm(oc8_as_sfile_t *as, uint8_t i_src, uint8_t r_dst);
-void oc8_as_sfile_sins_add_imm(oc8_as_sfile_t *as, const char *s_src,
-                               uint8_t r_dst);
+int oc8_as_sfile_sins_add_imm(oc8_as_sfile_t *as, const char *s_src,
+                              uint8_t r_dst);
 void oc8_as_sfile_ins_add(oc8_as_sfile_t *as, uint8_t r_src, uint8_t r_dst);
 void oc8_as_sfile_ins_add_i(oc8_as_sfile_t *as, uint8_t r_src);
 
@@ -136,28 +165,28 @@ void oc8_as_sfile_ins_and(oc8_as_sfile_t *as, uint8_t r_src, uint8_t r_dst);
 void oc8_as_sfile_ins_bcd(oc8_as_sfile_t *as, uint8_t r_src);
 
 void oc8_as_sfile_ins_call(oc8_as_sfile_t *as, uint16_t i_addr);
-void oc8_as_sfile_sins_call(oc8_as_sfile_t *as, const char *s_addr);
+int oc8_as_sfile_sins_call(oc8_as_sfile_t *as, const char *s_addr);
 
 void oc8_as_sfile_ins_cls(oc8_as_sfile_t *as);
 
 void oc8_as_sfile_ins_draw(oc8_as_sfile_t *as, uint8_t r_x, uint8_t r_y,
                            uint8_t i_h);
-void oc8_as_sfile_sins_draw(oc8_as_sfile_t *as, uint8_t r_x, uint8_t r_y,
-                            const char *s_h);
+int oc8_as_sfile_sins_draw(oc8_as_sfile_t *as, uint8_t r_x, uint8_t r_y,
+                           const char *s_h);
 
 void oc8_as_sfile_ins_fspr(oc8_as_sfile_t *as, uint8_t r_src);
 
 void oc8_as_sfile_ins_jmp(oc8_as_sfile_t *as, uint16_t i_addr);
-void oc8_as_sfile_sins_jmp(oc8_as_sfile_t *as, const char *s_addr);
+int oc8_as_sfile_sins_jmp(oc8_as_sfile_t *as, const char *s_addr);
 void oc8_as_sfile_ins_jmp_v0(oc8_as_sfile_t *as, uint16_t i_addr);
-void oc8_as_sfile_sins_jmp_v0(oc8_as_sfile_t *as, const char *s_addr);
+int oc8_as_sfile_sins_jmp_v0(oc8_as_sfile_t *as, const char *s_addr);
 
 void oc8_as_sfile_ins_mov_imm(oc8_as_sfile_t *as, uint8_t i_src, uint8_t r_dst);
-void oc8_as_sfile_sins_mov_imm(oc8_as_sfile_t *as, const char *s_src,
-                               uint8_t r_dst);
+int oc8_as_sfile_sins_mov_imm(oc8_as_sfile_t *as, const char *s_src,
+                              uint8_t r_dst);
 void oc8_as_sfile_ins_mov(oc8_as_sfile_t *as, uint8_t r_src, uint8_t r_dst);
 void oc8_as_sfile_ins_mov_i(oc8_as_sfile_t *as, uint16_t i_addr);
-void oc8_as_sfile_sins_mov_i(oc8_as_sfile_t *as, const char *s_addr);
+int oc8_as_sfile_sins_mov_i(oc8_as_sfile_t *as, const char *s_addr);
 void oc8_as_sfile_ins_mov_fdt(oc8_as_sfile_t *as, uint8_t r_dst);
 void oc8_as_sfile_ins_mov_dt(oc8_as_sfile_t *as, uint8_t r_src);
 void oc8_as_sfile_ins_mov_st(oc8_as_sfile_t *as, uint8_t r_src);
@@ -168,8 +197,8 @@ void oc8_as_sfile_ins_movm_ld(oc8_as_sfile_t *as, uint8_t r_dst);
 void oc8_as_sfile_ins_or(oc8_as_sfile_t *as, uint8_t r_src, uint8_t r_dst);
 
 void oc8_as_sfile_ins_rand(oc8_as_sfile_t *as, uint8_t i_mask, uint8_t r_dst);
-void oc8_as_sfile_sins_rand(oc8_as_sfile_t *as, const char *s_mask,
-                            uint8_t r_dst);
+int oc8_as_sfile_sins_rand(oc8_as_sfile_t *as, const char *s_mask,
+                           uint8_t r_dst);
 
 void oc8_as_sfile_ins_ret(oc8_as_sfile_t *as);
 
@@ -178,12 +207,12 @@ void oc8_as_sfile_ins_shl(oc8_as_sfile_t *as, uint8_t r_src, uint8_t r_dst);
 void oc8_as_sfile_ins_shr(oc8_as_sfile_t *as, uint8_t r_src, uint8_t r_dst);
 
 void oc8_as_sfile_ins_skpe_imm(oc8_as_sfile_t *as, uint8_t i_y, uint8_t r_x);
-void oc8_as_sfile_sins_skpe_imm(oc8_as_sfile_t *as, const char *s_y,
-                                uint8_t r_x);
+int oc8_as_sfile_sins_skpe_imm(oc8_as_sfile_t *as, const char *s_y,
+                               uint8_t r_x);
 void oc8_as_sfile_ins_skpe(oc8_as_sfile_t *as, uint8_t r_y, uint8_t r_x);
 void oc8_as_sfile_ins_skpn_imm(oc8_as_sfile_t *as, uint8_t i_y, uint8_t r_x);
-void oc8_as_sfile_sins_skpn_imm(oc8_as_sfile_t *as, const char *s_y,
-                                uint8_t r_x);
+int oc8_as_sfile_sins_skpn_imm(oc8_as_sfile_t *as, const char *s_y,
+                               uint8_t r_x);
 void oc8_as_sfile_ins_skpn(oc8_as_sfile_t *as, uint8_t r_y, uint8_t r_x);
 
 void oc8_as_sfile_ins_skpkp(oc8_as_sfile_t *as, uint8_t r_src);
@@ -194,7 +223,7 @@ void oc8_as_sfile_ins_sub(oc8_as_sfile_t *as, uint8_t r_src, uint8_t r_dst);
 void oc8_as_sfile_ins_subn(oc8_as_sfile_t *as, uint8_t r_src, uint8_t r_dst);
 
 void oc8_as_sfile_ins_sys(oc8_as_sfile_t *as, uint16_t i_addr);
-void oc8_as_sfile_sins_sys(oc8_as_sfile_t *as, const char *s_addr);
+int oc8_as_sfile_sins_sys(oc8_as_sfile_t *as, const char *s_addr);
 
 void oc8_as_sfile_ins_waitk(oc8_as_sfile_t *as, uint8_t r_dst);
 
@@ -206,14 +235,14 @@ void oc8_as_sfile_dir_align(oc8_as_sfile_t *as, uint16_t nbytes);
 
 void oc8_as_sfile_dir_byte(oc8_as_sfile_t *as, uint8_t val);
 
-void oc8_as_sfile_dir_equ(oc8_as_sfile_t *as, const char *key, uint16_t val);
+int oc8_as_sfile_dir_equ(oc8_as_sfile_t *as, const char *key, uint16_t val);
 
-void oc8_as_sfile_dir_globl(oc8_as_sfile_t *as, const char *sym);
+int oc8_as_sfile_dir_globl(oc8_as_sfile_t *as, const char *sym);
 
-void oc8_as_sfile_dir_size(oc8_as_sfile_t *as, const char *sym, uint16_t size);
+int oc8_as_sfile_dir_size(oc8_as_sfile_t *as, const char *sym, uint16_t size);
 
-void oc8_as_sfile_dir_type(oc8_as_sfile_t *as, const char *sym,
-                           oc8_as_sym_type_t type);
+int oc8_as_sfile_dir_type(oc8_as_sfile_t *as, const char *sym,
+                          oc8_as_sym_type_t type);
 
 void oc8_as_sfile_dir_word(oc8_as_sfile_t *as, uint16_t val);
 
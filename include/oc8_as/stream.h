@@ -10,15 +10,24 @@
 ///
 /// \file
 /// Stream struct definition
+/// The input is read in large blocks (or mapped in memory), and
+/// `oc8_as_stream_peek` / `oc8_as_stream_get` are inline reads in the current
+/// block. A new block is only fetched when the current one is exhausted.
 ///
 //===----------------------------------------------------------------------===//
 
+#include <stddef.h>
 #include <stdio.h>
 
+#include "oc8_bin/bin_view.h"
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+// Size of the blocks read from a FILE or a functor
+#define OC8_AS_STREAM_BLOCK_SIZE (64 * 1024)
+
 // The actual function that read one byte from the underlying input
 typedef int (*oc8_as_functor_fn_f)(void *functor_ptr);
 
@@ -27,12 +36,20 @@ typedef struct {
   char data[];
 } oc8_as_functor_t;
 
-/// Struct used to read from an input stream byte by byte, using dynamic
-/// dispatch
+/// Struct used to read from an input stream byte by byte
+/// Bytes in [cur, end) are the current block, and can be read directly
 typedef struct {
+  const char *cur;
+  const char *end;
+  size_t nb_read; // number of bytes in all previous blocks
+  int eof;
+
+  // Sources, only one is used
+  FILE *f;
+  int own_f; // `f` opened by `oc8_as_stream_init_from_path`
   oc8_as_functor_t *getc_fn;
-  char last;
-  int last_def;
+  oc8_bin_map_t map;
+  char *buf; // block buffer for `f` and `getc_fn`
 } oc8_as_stream_t;
 
 /// Initialize a stream from a FILE object
@@ -42,21 +59,52 @@ typedef struct {
 void oc8_as_stream_init_from_file(oc8_as_stream_t *is, FILE *f);
 
 /// Initialize a stream from a raw bytes array
+/// The array isn't copied, it must outlive the stream
 /// @param is - uninitialized data, get initialized
 void oc8_as_stream_init_from_raw(oc8_as_stream_t *is, const void *arr,
                                  size_t len);
 
+/// Initialize a stream from the file at `path`
+/// The file is mapped in memory, or read by blocks if it cannot be mapped
+/// (empty file, pipe, ...)
+/// @returns 0 if success, != 0 if the file cannot be opened
+int oc8_as_stream_init_from_path(oc8_as_stream_t *is, const char *path);
+
+/// Initialize a stream from a custom source: `functor->fn(functor)` returns
+/// the next byte, or EOF
+/// The functor is called to fill blocks, and is owned by the stream: it's
+/// released with `free` by `oc8_as_stream_free`
+void oc8_as_stream_init_from_functor(oc8_as_stream_t *is,
+                                     oc8_as_functor_t *functor);
+
 /// Release all memory associacted with the stream
 /// Doesn't free the stream pointer itself
 void oc8_as_stream_free(oc8_as_stream_t *is);
 
+/// Fetch the next block of the input, only when [cur, end) is empty
+/// @returns 0 if the end of the input is reached
+int oc8_as_stream_refill(oc8_as_stream_t *is);
+
+/// Number of bytes already consumed
+static inline size_t oc8_as_stream_pos(const oc8_as_stream_t *is) {
+  return is->nb_read - (size_t)(is->end - is->cur);
+}
+
 /// Peek at the current char of the stream, doesn't consume it
 /// @returns the char, or EOF if none left
-int oc8_as_stream_peek(oc8_as_stream_t *is);
+static inline int oc8_as_stream_peek(oc8_as_stream_t *is) {
+  if (is->cur == is->end && !oc8_as_stream_refill(is))
+    return EOF;
+  return (unsigned char)*is->cur;
+}
 
 /// Read and consume the current char of the stream
 /// @return the char, or EOF if none left
-int oc8_as_stream_get(oc8_as_stream_t *is);
+static inline int oc8_as_stream_get(oc8_as_stream_t *is) {
+  if (is->cur == is->end && !oc8_as_stream_refill(is))
+    return EOF;
+  return (unsigned char)*is->cur++;
+}
 
 #ifdef __cplusplus
 }
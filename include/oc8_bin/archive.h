@@ -0,0 +1,135 @@
+#ifndef OC8_BIN_ARCHIVE_H_
+#define OC8_BIN_ARCHIVE_H_
+
+//===--oc8_bin/archive.h - static library of objects --------------*- C -*-===//
+//
+// oc8_bin library
+// Author: Steven Lariau
+//
+//===----------------------------------------------------------------------===//
+///
+/// \file
+/// Archive files (.c8a): a static library of object files, with an index of
+/// their global symbols
+/// The linker only adds the members that define a symbol it needs (see
+/// oc8_ld/archive.h)
+///
+//===----------------------------------------------------------------------===//
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "bin_view.h"
+#include "pack.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Archive format, version 1:
+// - 00-07: magic number: 0x14 0x40 0x4F 0x43 0x38 0x41 0x52 0x00
+// - 08-09: version: uint16_t (little endian)
+// - 0a-0b: reserved, 0
+// - 0c-0f: number of members: uint32_t (little endian)
+// - 10-13: number of symbols: uint32_t (little endian)
+// - 14-17: size of the names table: uint32_t (little endian)
+// - 18-??: members table, one entry per member, in the archive order
+// - ??-??: symbols index, one entry per global symbol, sorted by hash, then
+//          name
+// - ??-??: names table, all member and symbol names, 0-terminated
+// - ??-??: members content, object files in binary format
+//
+// Each member entry is:
+// - 00-03: name: uint32_t (little endian), offset in the names table
+// - 04-07: offset from the beginning of the file: uint32_t (little endian)
+// - 08-0b: size in bytes: uint32_t (little endian)
+//
+// Each symbol entry is:
+// - 00-03: hash of the name: uint32_t (little endian),
+//          `oc8_bin_raw_hash_name(name)`
+// - 04-07: name: uint32_t (little endian), offset in the names table
+// - 08-0b: index of the member that defines it: uint32_t (little endian)
+// If many members define the same global symbol, the first one is indexed
+
+#define OC8_BIN_AR_VERSION (1)
+#define OC8_BIN_AR_EXT ".c8a"
+
+extern const uint8_t g_oc8_bin_ar_magic_value[8];
+
+typedef struct __attribute__((__packed__)) {
+  char magic[8];
+  uint16_t version;
+  uint16_t reserved;
+  uint32_t nb_members;
+  uint32_t nb_syms;
+  uint32_t names_size;
+} oc8_bin_raw_ar_header_t;
+
+typedef struct __attribute__((__packed__)) {
+  uint32_t name;
+  uint32_t offset;
+  uint32_t size;
+} oc8_bin_raw_ar_member_t;
+
+typedef struct __attribute__((__packed__)) {
+  uint32_t hash;
+  uint32_t name;
+  uint32_t member;
+} oc8_bin_raw_ar_sym_t;
+
+/// Read-only archive, all pointers are inside the raw data
+/// The raw data must outlive the archive
+typedef struct {
+  const uint8_t *data;
+  size_t size;
+
+  const oc8_bin_raw_ar_member_t *members;
+  size_t nb_members;
+  const oc8_bin_raw_ar_sym_t *syms;
+  size_t nb_syms;
+  const char *names;
+  size_t names_size;
+
+  // Set by `oc8_bin_archive_open`, released by `oc8_bin_archive_close`
+  oc8_bin_map_t map;
+} oc8_bin_archive_t;
+
+/// Build an archive from the raw data in `in_buf`
+/// The tables and the bounds of all members are checked, not the members
+/// @returns 0 if success, != 0 if `in_buf` isn't a valid archive
+int oc8_bin_archive_init(oc8_bin_archive_t *ar, const void *in_buf,
+                         size_t buf_len);
+
+/// Map the file at `path`, and build an archive from it
+/// @returns 0 if success, != 0 if the file cannot be read or isn't an archive
+int oc8_bin_archive_open(oc8_bin_archive_t *ar, const char *path);
+
+/// Unmap the file if the archive was built with `oc8_bin_archive_open`
+void oc8_bin_archive_close(oc8_bin_archive_t *ar);
+
+/// Find the index of the member that defines the global symbol `name`,
+/// O(log n)
+/// @returns -1 if not found
+long oc8_bin_archive_find_sym(const oc8_bin_archive_t *ar, const char *name);
+
+/// Read the member at `idx`, the result points inside the archive data
+void oc8_bin_archive_get(const oc8_bin_archive_t *ar, size_t idx,
+                         oc8_bin_pack_member_t *member);
+
+/// Write an archive with all `members` in `out_buf`, if not NULL
+/// Members are kept in the same order, they must be object files
+/// @returns the size of the archive, or 0 if a member isn't an object file,
+/// or two members have the same name
+size_t oc8_bin_archive_write_raw(const oc8_bin_pack_member_t *members,
+                                 size_t nb_members, uint8_t *out_buf);
+
+/// Wrapper around `oc8_bin_archive_write_raw` to write the archive to a file
+/// @returns 0 if success, != 0 if the archive is invalid or cannot be written
+int oc8_bin_archive_write_to_file(const oc8_bin_pack_member_t *members,
+                                  size_t nb_members, const char *path);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // !OC8_BIN_ARCHIVE_H_
@@ -21,14 +21,29 @@ extern "C" {
 #endif
 
 /// Build file `f` using raw binaray data in `in_buf`
+/// Reads both version 10 and 11 of the format
 /// `f` must be unitialized.
-/// This function doesn't call `oc8_bin_file_check`
+/// This function doesn't call `oc8_bin_file_validate`
 /// `buf_len` is used to make sure the raw data has the right size
-void oc8_bin_read_file_raw(oc8_bin_file_t *f, const void *in_buf,
-                           size_t buf_len);
+/// @returns 0 if success, != 0 on error (printed). On error, `f` is left
+/// unitialized, there is nothing to free
+int oc8_bin_read_file_raw(oc8_bin_file_t *f, const void *in_buf,
+                          size_t buf_len);
+
+/// Same as `oc8_bin_read_file_raw`, but `f` allocates from `arena`
+/// (see `oc8_bin_file_init_arena`)
+int oc8_bin_read_file_raw_arena(oc8_bin_file_t *f, const void *in_buf,
+                                size_t buf_len, oc8_arena_t *arena);
 
 /// Wrapper around `oc8_bin_read_file_raw` to read data directly from a file
-void oc8_bin_read_from_file(oc8_bin_file_t *f, const char *path);
+/// The file is mapped in memory, not copied (see bin_view.h), and unmapped
+/// before returning, even on error
+/// @returns 0 if success, != 0 on error (printed)
+int oc8_bin_read_from_file(oc8_bin_file_t *f, const char *path);
+
+/// Same as `oc8_bin_read_from_file`, but `f` allocates from `arena`
+int oc8_bin_read_from_file_arena(oc8_bin_file_t *f, const char *path,
+                                 oc8_arena_t *arena);
 
 #ifdef __cplusplus
 }
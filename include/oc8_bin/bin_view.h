@@ -0,0 +1,140 @@
+#ifndef OC8_BIN_BIN_VIEW_H_
+#define OC8_BIN_BIN_VIEW_H_
+
+//===--oc8_bin/bin_view.h - read-only view of a raw file ----------*- C -*-===//
+//
+// oc8_bin library
+// Author: Steven Lariau
+//
+//===----------------------------------------------------------------------===//
+///
+/// \file
+/// Memory-mapped files, and oc8_bin_file_view_t: read-only access to a
+/// binary file in raw format, without copying anything
+///
+//===----------------------------------------------------------------------===//
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "file.h"
+#include "format.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// A file mapped read-only in memory
+/// For a pack member, `data` is inside the mapping of the whole pack
+typedef struct {
+  const uint8_t *data;
+  size_t size;
+
+  // Whole mapping, released by `oc8_bin_map_close`
+  const uint8_t *base;
+  size_t base_size;
+  void *shared_pack; // pack of a member (private), NULL for a whole file
+} oc8_bin_map_t;
+
+/// Map the file at `path` in memory
+/// @returns 0 if success, != 0 if the file cannot be opened or is empty
+int oc8_bin_map_open(oc8_bin_map_t *map, const char *path);
+
+/// Same as `oc8_bin_map_open`, but if there is no file at `path`, it can also
+/// be a member of a pack: `archive.c8pk:member` (see pack.h)
+/// A pack is mapped once, and shared by all its open members. The last pack
+/// used stays mapped after its members are closed
+/// Thread-safe
+/// @returns 0 if success, != 0 if the file cannot be opened, is empty, or
+/// the pack member doesn't exist
+int oc8_bin_map_open_member(oc8_bin_map_t *map, const char *path);
+
+/// Unmap the file
+void oc8_bin_map_close(oc8_bin_map_t *map);
+
+/// Read-only binary file, all pointers are inside the raw data
+/// The raw data must outlive the view
+/// Multi-bytes fields are little endian, like the raw format (see format.h)
+/// Symbols and refs are read with the functions below, that work for both
+/// versions
+typedef struct {
+  uint16_t version;
+  oc8_bin_file_type_t type;
+
+  size_t syms_defs_size;
+  size_t syms_refs_size;
+
+  const uint8_t *rom;
+  size_t rom_size;
+
+  // Version 10 only
+  const oc8_bin_raw_sym_def_t *syms_defs;
+  const oc8_bin_raw_sym_ref_t *syms_refs;
+
+  // Version 11 only, pointers to the sections content
+  const oc8_bin_raw_sym_v11_t *syms;
+  const char *strtab;
+  size_t strtab_size;
+  const uint8_t *refs;
+  size_t refs_size;
+  const uint8_t *hash;
+  size_t hash_nb_buckets;
+  const uint8_t *addr_index;
+  const uint8_t *sizes;
+
+  // Set by `oc8_bin_file_view_open`, released by `oc8_bin_file_view_close`
+  oc8_bin_map_t map;
+} oc8_bin_file_view_t;
+
+/// One symbol def of a view, `name` points inside the raw data
+typedef struct {
+  const char *name;
+  uint16_t id;
+  int is_global;
+  oc8_bin_sym_type_t type;
+  uint16_t addr;
+  uint16_t size;
+} oc8_bin_view_sym_t;
+
+/// Build a view of the raw binary data in `in_buf`
+/// Only the header and the sections sizes are checked, use
+/// `oc8_bin_read_file_raw` and `oc8_bin_file_validate` to validate the symbols
+/// @returns 0 if success, != 0 if `in_buf` isn't a binary file
+int oc8_bin_file_view_init(oc8_bin_file_view_t *view, const void *in_buf,
+                           size_t buf_len);
+
+/// Map the file at `path`, and build a view of it
+/// @returns 0 if success, != 0 if the file cannot be read or isn't a binary
+/// file
+int oc8_bin_file_view_open(oc8_bin_file_view_t *view, const char *path);
+
+/// Unmap the file if the view was built with `oc8_bin_file_view_open`
+void oc8_bin_file_view_close(oc8_bin_file_view_t *view);
+
+/// Read the symbol def `id`, O(1)
+/// @returns 0 if success, != 0 if `id` or the def is invalid
+int oc8_bin_file_view_get_sym(const oc8_bin_file_view_t *view, size_t id,
+                              oc8_bin_view_sym_t *sym);
+
+/// Find the id of the global symbol def named `name`
+/// O(1) with the hash index of version 11, O(n) for version 10
+/// @returns -1 if not found
+long oc8_bin_file_view_find_global(const oc8_bin_file_view_t *view,
+                                   const char *name);
+
+/// Find the lowest id of the symbol defs at `addr`
+/// O(log n) with the address index of version 11, O(n) for version 10
+/// @returns -1 if not found
+long oc8_bin_file_view_find_addr(const oc8_bin_file_view_t *view,
+                                 uint16_t addr);
+
+/// Decode all symbol refs in `out`, that must have `syms_refs_size` items
+/// @returns 0 if success, != 0 if the refs are invalid
+int oc8_bin_file_view_get_refs(const oc8_bin_file_view_t *view,
+                               oc8_bin_sym_ref_t *out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // !OC8_BIN_BIN_VIEW_H_
@@ -21,13 +21,16 @@ extern "C" {
 #endif
 
 /// Write `f` in raw binaray format to `out_buf`
-/// Works correctly only if `oc8_bin_file_check(f, 0)` was successfull
+/// The format depends on the version of `f` (see format.h)
+/// Works correctly only if `oc8_bin_file_validate(f, 0)` was successfull
 /// Returns the number of bytes written
-/// If `out_buf` is NULL, directly returns with the size (O(1))
+/// If `out_buf` is NULL, directly returns with the size (O(1) for version 10)
 size_t oc8_bin_write_file_raw(oc8_bin_file_t *f, void *out_buf);
 
 /// Wrapper around `oc8_bin_write_file_raw` to write data directly to a file
-void oc8_bin_write_to_file(oc8_bin_file_t *f, const char *path);
+/// The file is replaced atomically (see `oc8_bin_write_file_atomic`)
+/// @returns 0 if success, != 0 on error (printed)
+int oc8_bin_write_to_file(oc8_bin_file_t *f, const char *path);
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,84 @@
+#ifndef OC8_BIN_CACHE_H_
+#define OC8_BIN_CACHE_H_
+
+//===--oc8_bin/cache.h - on-disk build cache ----------------------*- C -*-===//
+//
+// oc8_bin library
+// Author: Steven Lariau
+//
+//===----------------------------------------------------------------------===//
+///
+/// \file
+/// Content hash, and a directory of build outputs indexed by the hash of
+/// their inputs. Used by oc8-as and oc8-ld to skip the work when the inputs
+/// didn't change
+///
+//===----------------------------------------------------------------------===//
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Cache directory:
+// - <key>.<ext>: one output file (.c8o, .c8bin), read-only
+//   key is a 64 bits hash, written with 16 hex digits
+// - any other file added by the tools (eg: linker state, see oc8_ld)
+// Entries are written to a temporary file, then renamed: many processes can
+// share the same directory
+// Outputs are hard links to the entries when possible: every file written by
+// the tools is replaced by a new one (see `oc8_bin_write_file_atomic`),
+// never modified in place
+
+/// Initial value of a hash
+#define OC8_BIN_HASH_INIT (0xcbf29ce484222325ULL)
+
+/// Hash `len` bytes of `data`, starting from the hash `h` (FNV-1a, 64 bits)
+/// Hashes can be chained: `hash(b, hash(a, h))` is the hash of `a` + `b`
+uint64_t oc8_bin_hash(const void *data, size_t len, uint64_t h);
+
+/// Same as `oc8_bin_hash` on a 0-terminated string (with the terminator)
+uint64_t oc8_bin_hash_str(const char *str, uint64_t h);
+
+typedef struct {
+  char *dir;
+} oc8_bin_cache_t;
+
+/// Open the cache directory `dir`, created if it doesn't exist
+/// @returns 0 if success, != 0 if it cannot be created
+int oc8_bin_cache_open(oc8_bin_cache_t *cache, const char *dir);
+
+/// Free the memory used by `cache`, the directory is kept
+void oc8_bin_cache_close(oc8_bin_cache_t *cache);
+
+/// Path of the entry `key`.`ext` in the cache
+/// @returns a string allocated with malloc
+char *oc8_bin_cache_path(const oc8_bin_cache_t *cache, uint64_t key,
+                         const char *ext);
+
+/// If the cache has the entry `key`.`ext`, make `out_path` a copy of it (a
+/// hard link if possible)
+/// @returns 0 if found, != 0 if not found or cannot be copied
+int oc8_bin_cache_get(const oc8_bin_cache_t *cache, uint64_t key,
+                      const char *ext, const char *out_path);
+
+/// Store a copy of the file at `path` as the entry `key`.`ext`
+/// @returns 0 if success, != 0 on error
+int oc8_bin_cache_put(const oc8_bin_cache_t *cache, uint64_t key,
+                      const char *ext, const char *path);
+
+/// Write `len` bytes of `data` to a temporary file next to `path`, and rename
+/// it to `path`: readers never see a partial file, and other links to the old
+/// file are left unchanged
+/// @param mode permissions of the new file
+/// @returns 0 if success, != 0 on error
+int oc8_bin_write_file_atomic(const char *path, const void *data, size_t len,
+                              unsigned mode);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // !OC8_BIN_CACHE_H_
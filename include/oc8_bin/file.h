@@ -17,6 +17,7 @@
 #include <stddef.h>
 #include <stdint.h>
 
+#include "oc8_arena/oc8_arena.h"
 #include "oc8_defs/oc8_defs.h"
 #include "oc8_smap/oc8_smap.h"
 
@@ -27,19 +28,20 @@ extern "C" {
 // bin struct:
 
 // - header (oc8_bin_header_t)
-//   + version: uint16_t, must be 10
+//   + version: uint16_t, 10 or 11. Only changes the raw format (see format.h)
 //   + type: object file (.c8o) or binary file (.c8bin)
 
 // - list of symbols defs, with some metadata: (oc8_bin_sym_def_t)
 //   + id: unique identifier, uint16_t. Position in the list
 //   + name: original symbol name, not unique (but 2 globals cannot have same
-//   name)
+//   name). Interned, shared by all files
 //   + global: true/false
 //   + type (function, object, or no)
 //     used to know how to print data at specific addr.
 //     If no or unknown, print as binary data
 //   + addr in binary data (remember: starts at 0x200)
 //     if 0, symbol is unkown
+//   + size in bytes, set by the .size directive. 0 if unknown
 
 // - list of all symbols references (oc8_bin_sym_ref_t)
 //   These are the references in the ROM content to symbols.
@@ -65,6 +67,8 @@ extern "C" {
 //   + type must be valid
 //   + addr must be in the range of the ROM content (0x200 to ROM end), or 0
 //     (late check)
+//   + if size isn't 0, addr can't be 0, and addr + size must be at most the
+//     ROM end (late check)
 // - Symbol ref:
 //   + ins_addr must be in the valid range of the ROM content (0x200 to ROM end)
 //     (late check)
@@ -78,6 +82,11 @@ extern "C" {
 // - Symbol def:
 //   + addr must not be 0
 
+// Supported versions, new files are created with OC8_BIN_VERSION
+#define OC8_BIN_VERSION_V10 (10)
+#define OC8_BIN_VERSION_V11 (11)
+#define OC8_BIN_VERSION OC8_BIN_VERSION_V11
+
 typedef enum {
   OC8_BIN_FILE_TYPE_OBJ,
   OC8_BIN_FILE_TYPE_BIN,
@@ -94,12 +103,15 @@ typedef struct {
   oc8_bin_file_type_t type;
 } oc8_bin_header_t;
 
+/// The name is interned (see oc8_smap/oc8_strpool.h): names are compared
+/// by pointer, and never copied when a def is copied
 typedef struct {
+  const char *name;
   uint16_t id;
-  char name[OC8_MAX_SYM_SIZE + 1];
-  int is_global;
-  oc8_bin_sym_type_t type;
   uint16_t addr;
+  uint16_t size;
+  uint8_t is_global;
+  oc8_bin_sym_type_t type : 8;
 } oc8_bin_sym_def_t;
 
 typedef struct {
@@ -110,8 +122,10 @@ typedef struct {
 /// Binary file (either object or full binary ROM)
 /// You must never write field structs directly, and use functions
 /// They perform arguments checking
-/// Some more complex checks are run with file_check() once the struct is
-/// complete
+/// Setters return != 0 if an argument is invalid (printed), and leave `bf`
+/// unchanged
+/// Some more complex checks are run with `oc8_bin_file_validate` once the
+/// struct is complete
 /// The only exception is for ROM, once ts'is setup (function init_room), you
 /// can directly write anything to the buffer
 typedef struct {
@@ -131,38 +145,56 @@ typedef struct {
   // pointer to allocated ROM data, struct responsible for its lifetime
   uint8_t *rom;
   size_t rom_size;
+
+  // All memory is allocated from this arena, or with malloc if NULL
+  oc8_arena_t *arena;
 } oc8_bin_file_t;
 
 /// Initialize `bf` to empty, unprepared file, and allocate all needed memory
 void oc8_bin_file_init(oc8_bin_file_t *bf);
 
+/// Same as `oc8_bin_file_init`, but all memory is allocated from `arena`
+/// (see oc8_arena.h). `oc8_bin_file_free` doesn't release anything
+void oc8_bin_file_init_arena(oc8_bin_file_t *bf, oc8_arena_t *arena);
+
 /// Initialize `bf` with ROM copied from `rom`
-/// This function doesn't call `oc8_bin_file_check`
+/// This function doesn't call `oc8_bin_file_validate`
 /// `bf` will be an executable binary, without any symbol infos
 /// except `_rom_begin` at 0x200
-void oc8_bin_file_init_binary_rom(oc8_bin_file_t *bf, const void *rom,
-                                  size_t rom_size);
+/// @returns 0 if success, != 0 if the ROM is too big (printed), `bf` is
+/// freed then
+int oc8_bin_file_init_binary_rom(oc8_bin_file_t *bf, const void *rom,
+                                 size_t rom_size);
 
 /// Free all memory allocated by `bf`
 void oc8_bin_file_free(oc8_bin_file_t *bf);
 
 /// Check if the file is valid, after it's complete
 /// If `is_bin`, do more tests to be sure it can be runned
-/// Panics if there is an error
-void oc8_bin_file_check(oc8_bin_file_t *bf, int is_bin);
+/// @returns 0 if valid, != 0 otherwise (errors are printed)
+int oc8_bin_file_validate(const oc8_bin_file_t *bf, int is_bin);
 
-void oc8_bin_file_set_version(oc8_bin_file_t *bf, uint16_t version);
+/// @returns 0 if success, != 0 if `version` isn't supported (printed)
+int oc8_bin_file_set_version(oc8_bin_file_t *bf, uint16_t version);
 
-void oc8_bin_file_set_type(oc8_bin_file_t *bf, oc8_bin_file_type_t type);
+/// @returns 0 if success, != 0 if `type` is invalid (printed)
+int oc8_bin_file_set_type(oc8_bin_file_t *bf, oc8_bin_file_type_t type);
 
 /// Can only be called once to set the max number of definitions
 /// Cannot be changed later
-void oc8_bin_file_set_defs_count(oc8_bin_file_t *bf, size_t len);
+/// @returns 0 if success, != 0 if already called (printed)
+int oc8_bin_file_set_defs_count(oc8_bin_file_t *bf, size_t len);
+
+/// `name` is interned, it doesn't need to be kept alive by the caller
+/// @returns id of the new symbol, or -1 if the name or type is invalid, there
+/// is no room left, or a global with the same name exists (printed)
+int oc8_bin_file_add_def(oc8_bin_file_t *bf, const char *name, int is_global,
+                         oc8_bin_sym_type_t type, uint16_t addr);
 
-/// @returns id of the new symbol
-uint16_t oc8_bin_file_add_def(oc8_bin_file_t *bf, const char *name,
-                              int is_global, oc8_bin_sym_type_t type,
-                              uint16_t addr);
+/// Set the size of the symbol `sym_id`, it's 0 after `oc8_bin_file_add_def`
+/// @returns 0 if success, != 0 if `sym_id` is invalid (printed)
+int oc8_bin_file_set_def_size(oc8_bin_file_t *bf, uint16_t sym_id,
+                              uint16_t size);
 
 /// Can add a ref before it's added in the defs
 void oc8_bin_file_add_ref(oc8_bin_file_t *bf, uint16_t ins_addr,
@@ -170,7 +202,9 @@ void oc8_bin_file_add_ref(oc8_bin_file_t *bf, uint16_t ins_addr,
 
 /// Allocate memory for the ROM, can only be called once,
 /// Cannot be resized later
-void oc8_bin_file_init_rom(oc8_bin_file_t *bf, size_t rom_size);
+/// @returns 0 if success, != 0 if called twice or `rom_size` is too big
+/// (printed)
+int oc8_bin_file_init_rom(oc8_bin_file_t *bf, size_t rom_size);
 
 #ifdef __cplusplus
 }
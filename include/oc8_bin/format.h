@@ -14,13 +14,14 @@
 //===----------------------------------------------------------------------===//
 
 #include "../oc8_defs/oc8_defs.h"
+#include <stddef.h>
 #include <stdint.h>
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
-// Binary format:
+// Binary format, version 10:
 // - 00-07: magic number: 0x14 0x40 0x4F 0x43 0x38 0x00 0x00 0x00
 // - 08-09: version: uint16_t (little endian)
 // - 0a-0b: type: uint16_t (little endian). 1 = obj, 2 = bin
@@ -40,6 +41,53 @@ extern "C" {
 // Each symbol ref is:
 // - 00-01: ins_addr: uint16_t (little endian)
 // - 02-03: sym_id: uint16_t (little endian)
+//
+// Binary format, version 11:
+// - 00-07: magic number (same as version 10)
+// - 08-09: version: uint16_t (little endian)
+// - 0a-0b: type: uint16_t (little endian). 1 = obj, 2 = bin
+// - 0c-0d: number of sections: uint16_t (little endian)
+// - 0e-0f: reserved, 0
+// - 10-??: section directory
+// - ??-??: sections content, located with the directory
+//
+// Each section directory entry is:
+// - 00-01: kind: uint16_t (little endian), OC8_BIN_SEC_*
+// - 02-03: reserved, 0
+// - 04-07: offset from the beginning of the file: uint32_t (little endian)
+// - 08-0b: size in bytes: uint32_t (little endian)
+//
+// Sections, each kind can appear at most once. A missing section is empty:
+// - ROM: rom content
+// - STRTAB: all symbol names, 0-terminated, every name is stored only once
+// - SYMS: array of symbol defs, indexed by id:
+//   + 00-03: name: uint32_t (little endian), offset in STRTAB
+//   + 04-05: addr: uint16_t (little endian)
+//   + 06-06: global (1 byte, 0/1)
+//   + 07-07: type (1 byte, 0 = no, 1 = function, 2 = object)
+// - REFS: number of refs (varint), then for each ref:
+//   + ins_addr - previous ins_addr (zigzag varint, previous is 0 for the
+//     first ref)
+//   + sym_id (varint)
+//   Varints are little endian groups of 7 bits, the high bit is set on all
+//   bytes except the last one
+// - HASH: hash table of global symbols
+//   + 00-03: number of buckets: uint32_t (little endian), power of 2
+//   + then each bucket: uint16_t (little endian), sym_id + 1, or 0 if empty
+//   A name starts at bucket `oc8_bin_raw_hash_name(name) & (nb_buckets - 1)`
+//   Collisions use the next bucket, until an empty one
+// - ADDR: array of sym_id (uint16_t, little endian) sorted by addr, then id
+// - SIZES: array of symbol sizes (uint16_t, little endian), indexed by id
+//   Empty if all sizes are 0
+
+#define OC8_BIN_SEC_ROM (1)
+#define OC8_BIN_SEC_STRTAB (2)
+#define OC8_BIN_SEC_SYMS (3)
+#define OC8_BIN_SEC_REFS (4)
+#define OC8_BIN_SEC_HASH (5)
+#define OC8_BIN_SEC_ADDR (6)
+#define OC8_BIN_SEC_SIZES (7)
+#define OC8_BIN_NB_SECS (7)
 
 extern const uint8_t g_oc8_bin_raw_magic_value[8];
 
@@ -64,6 +112,40 @@ typedef struct __attribute__((__packed__)) {
   uint16_t sym_id;
 } oc8_bin_raw_sym_ref_t;
 
+typedef struct __attribute__((__packed__)) {
+  char magic[8];
+  uint16_t version;
+  uint16_t type;
+  uint16_t nb_secs;
+  uint16_t reserved;
+} oc8_bin_raw_header_v11_t;
+
+typedef struct __attribute__((__packed__)) {
+  uint16_t kind;
+  uint16_t reserved;
+  uint32_t offset;
+  uint32_t size;
+} oc8_bin_raw_sec_t;
+
+typedef struct __attribute__((__packed__)) {
+  uint32_t name;
+  uint16_t addr;
+  uint8_t is_global;
+  uint8_t type;
+} oc8_bin_raw_sym_v11_t;
+
+/// Hash of a symbol name, used by the HASH section (FNV-1a)
+uint32_t oc8_bin_raw_hash_name(const char *name);
+
+/// Write `val` as a varint in `out_buf`, if not NULL
+/// @returns the number of bytes of the varint
+size_t oc8_bin_raw_write_varint(uint32_t val, uint8_t *out_buf);
+
+/// Read a varint from `in_buf`, reading at most `buf_len` bytes
+/// @returns the number of bytes read, 0 if the varint is invalid
+size_t oc8_bin_raw_read_varint(const uint8_t *in_buf, size_t buf_len,
+                               uint32_t *val);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,136 @@
+#ifndef OC8_BIN_PACK_H_
+#define OC8_BIN_PACK_H_
+
+//===--oc8_bin/pack.h - archive of many files ---------------------*- C -*-===//
+//
+// oc8_bin library
+// Author: Steven Lariau
+//
+//===----------------------------------------------------------------------===//
+///
+/// \file
+/// Pack files (.c8pk): many ROMs / binary files stored in one archive, with a
+/// sorted index to find a member by name
+/// A member is read with a single mapping of the archive, without copying
+/// (see `oc8_bin_map_open_member` with a path `archive.c8pk:member`)
+///
+//===----------------------------------------------------------------------===//
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "bin_view.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Pack format, version 1:
+// - 00-07: magic number: 0x14 0x40 0x4F 0x43 0x38 0x50 0x4B 0x00
+// - 08-09: version: uint16_t (little endian)
+// - 0a-0b: reserved, 0
+// - 0c-0f: number of members: uint32_t (little endian)
+// - 10-13: size of the names table: uint32_t (little endian)
+// - 14-17: reserved, 0
+// - 18-??: index, one entry per member, sorted by hash, then name
+// - ??-??: names table, all member names, 0-terminated
+// - ??-??: members content, each member starts at a multiple of
+//          OC8_BIN_PACK_ALIGN
+//
+// Each index entry is:
+// - 00-03: hash of the name: uint32_t (little endian),
+//          `oc8_bin_raw_hash_name(name)`
+// - 04-07: name: uint32_t (little endian), offset in the names table
+// - 08-0b: offset from the beginning of the file: uint32_t (little endian)
+// - 0c-0f: size in bytes: uint32_t (little endian)
+
+#define OC8_BIN_PACK_VERSION (1)
+#define OC8_BIN_PACK_ALIGN (4096)
+
+// Path of a pack member: `archive.c8pk:member`
+#define OC8_BIN_PACK_EXT ".c8pk"
+#define OC8_BIN_PACK_SEP ':'
+
+extern const uint8_t g_oc8_bin_pack_magic_value[8];
+
+typedef struct __attribute__((__packed__)) {
+  char magic[8];
+  uint16_t version;
+  uint16_t reserved;
+  uint32_t nb_members;
+  uint32_t names_size;
+  uint32_t reserved2;
+} oc8_bin_raw_pack_header_t;
+
+typedef struct __attribute__((__packed__)) {
+  uint32_t hash;
+  uint32_t name;
+  uint32_t offset;
+  uint32_t size;
+} oc8_bin_raw_pack_entry_t;
+
+/// One member of a pack, `data` isn't owned
+typedef struct {
+  const char *name;
+  const void *data;
+  size_t size;
+} oc8_bin_pack_member_t;
+
+/// Read-only pack, all pointers are inside the raw data
+/// The raw data must outlive the pack
+typedef struct {
+  const uint8_t *data;
+  size_t size;
+
+  const oc8_bin_raw_pack_entry_t *entries;
+  size_t nb_members;
+  const char *names;
+  size_t names_size;
+
+  // Set by `oc8_bin_pack_open`, released by `oc8_bin_pack_close`
+  oc8_bin_map_t map;
+} oc8_bin_pack_t;
+
+/// Build a pack from the raw data in `in_buf`
+/// The index, the names, and the bounds of all members are checked
+/// @returns 0 if success, != 0 if `in_buf` isn't a valid pack
+int oc8_bin_pack_init(oc8_bin_pack_t *pack, const void *in_buf,
+                      size_t buf_len);
+
+/// Map the file at `path`, and build a pack from it
+/// @returns 0 if success, != 0 if the file cannot be read or isn't a pack
+int oc8_bin_pack_open(oc8_bin_pack_t *pack, const char *path);
+
+/// Unmap the file if the pack was built with `oc8_bin_pack_open`
+void oc8_bin_pack_close(oc8_bin_pack_t *pack);
+
+/// Find the index of the member named `name`, O(log n)
+/// @returns -1 if not found
+long oc8_bin_pack_find(const oc8_bin_pack_t *pack, const char *name);
+
+/// Read the member at `idx`, the result points inside the pack data
+void oc8_bin_pack_get(const oc8_bin_pack_t *pack, size_t idx,
+                      oc8_bin_pack_member_t *member);
+
+/// Write a pack with all `members` in `out_buf`, if not NULL
+/// Members can be in any order, they are sorted in the index
+/// @returns the size of the pack, or 0 if two members have the same name
+size_t oc8_bin_pack_write_raw(const oc8_bin_pack_member_t *members,
+                              size_t nb_members, uint8_t *out_buf);
+
+/// Wrapper around `oc8_bin_pack_write_raw` to write the pack to a file
+/// @returns 0 if success, != 0 if the pack is invalid or cannot be written
+int oc8_bin_pack_write_to_file(const oc8_bin_pack_member_t *members,
+                               size_t nb_members, const char *path);
+
+/// Split `path` if it names a member of a pack: `archive.c8pk:member`
+/// @returns a pointer to the member name in `path`, or NULL if `path` isn't
+/// a pack member path
+/// The archive path is the first `member - path - 1` characters of `path`
+const char *oc8_bin_pack_split_path(const char *path);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // !OC8_BIN_PACK_H_
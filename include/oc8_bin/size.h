@@ -0,0 +1,50 @@
+#ifndef OC8_BIN_SIZE_H_
+#define OC8_BIN_SIZE_H_
+
+//===--oc8_bin/size.h - size of the symbols of a file_t -----------*- C -*-===//
+//
+// oc8_bin library
+// Author: Steven Lariau
+//
+//===----------------------------------------------------------------------===//
+///
+/// \file
+/// Size in the ROM of every symbol of a binary file, used by oc8-size and by
+/// the map of the linker
+///
+//===----------------------------------------------------------------------===//
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "file.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// Bytes available for the ROM, from 0x200 to the end of the memory
+#define OC8_BIN_ROM_MAX_SIZE (OC8_MEMORY_SIZE - OC8_ROM_START)
+
+/// Size of a symbol def in the ROM
+typedef struct {
+  const oc8_bin_sym_def_t *def;
+  uint16_t size;
+
+  // No size (.size directive): it's the distance to the next symbol at a
+  // higher address, or to the end of the ROM
+  int is_estimated;
+} oc8_bin_sym_size_t;
+
+/// Compute the size of all symbol defs of `bf` with an address (not extern)
+/// `out` must have `bf->syms_defs_size` items, they are sorted by address,
+/// then by name
+/// @returns the number of items written to `out`
+size_t oc8_bin_get_sym_sizes(const oc8_bin_file_t *bf,
+                             oc8_bin_sym_size_t *out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // !OC8_BIN_SIZE_H_
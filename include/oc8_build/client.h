@@ -0,0 +1,81 @@
+#ifndef OC8_BUILD_CLIENT_H_
+#define OC8_BUILD_CLIENT_H_
+
+//===--oc8_build/client.h - requests to oc8-buildd ----------------*- C -*-===//
+//
+// oc8_build library
+// Author: Steven Lariau
+//
+//===----------------------------------------------------------------------===//
+///
+/// \file
+/// Protocol of the build server (see server.h), and functions used by the
+/// tools to forward their work to it
+///
+//===----------------------------------------------------------------------===//
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Protocol, over a Unix stream socket, with one request per connection:
+// - client -> server: header (oc8_build_req_header_t), with the stderr of the
+//   client attached (SCM_RIGHTS), then `strs_len` bytes: `nb_strs`
+//   0-terminated strings. All paths are absolute
+//   + AS: cache directory ("" if none), then pairs of (input, output)
+//   + LD: cache directory ("" if none), output, then all inputs
+//   + STOP: no strings, the server exits
+// - server -> client: int32_t, exit code of the request
+// Errors are printed by the server directly to the stderr of the client
+
+#define OC8_BUILD_MAGIC (0x4238434fU) // "OC8B"
+
+/// Max size of the strings of one request
+#define OC8_BUILD_MAX_STRS_LEN (1 << 20)
+
+typedef enum {
+  OC8_BUILD_REQ_AS,
+  OC8_BUILD_REQ_LD,
+  OC8_BUILD_REQ_STOP,
+} oc8_build_req_kind_t;
+
+typedef struct {
+  uint32_t magic;
+  uint32_t kind;
+  uint32_t nb_strs;
+  uint32_t strs_len;
+} oc8_build_req_header_t;
+
+/// Path of the server socket: $OC8_BUILDD_SOCKET if set, or
+/// /tmp/oc8-buildd-<uid>.sock
+/// @returns a string allocated with malloc, or NULL if $OC8_BUILDD_SOCKET is
+/// empty (the server is disabled)
+char *oc8_build_socket_path(void);
+
+/// @returns `path` if absolute, or the current directory + `path`, allocated
+/// with malloc
+char *oc8_build_abs_path(const char *path);
+
+/// Send a request to the server at `socket_path`, and wait for the result
+/// @param status set to the exit code of the request
+/// @returns 0 if the request was run by the server, != 0 if the server isn't
+/// running or stopped before the end (nothing is printed)
+int oc8_build_client_send(const char *socket_path, oc8_build_req_kind_t kind,
+                          const char *const *strs, size_t nb_strs,
+                          int *status);
+
+/// Send a request of a tool to the default server, if it's running
+/// Non-empty relative paths in `strs` are made absolute
+/// @returns same as `oc8_build_client_send`
+int oc8_build_client_forward(oc8_build_req_kind_t kind,
+                             const char *const *strs, size_t nb_strs,
+                             int *status);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // !OC8_BUILD_CLIENT_H_
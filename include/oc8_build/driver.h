@@ -0,0 +1,61 @@
+#ifndef OC8_BUILD_DRIVER_H_
+#define OC8_BUILD_DRIVER_H_
+
+//===--oc8_build/driver.h - in-memory build driver ----------------*- C -*-===//
+//
+// oc8_build library
+// Author: Steven Lariau
+//
+//===----------------------------------------------------------------------===//
+///
+/// \file
+/// Build assembly sources into a runnable program in one call, with every
+/// intermediate file kept in memory. Used by oc8-build, and by tests that run
+/// many small programs
+///
+//===----------------------------------------------------------------------===//
+
+#include <stddef.h>
+
+#include "../oc8_arena/oc8_arena.h"
+#include "../oc8_bin/file.h"
+#include "../oc8_emu/batch.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// Assembly source (.c8s) in memory
+typedef struct {
+  const char *name; // used in error messages
+  const char *data; // not 0-terminated
+  size_t len;
+} oc8_build_src_t;
+
+/// Parse, assemble and link `srcs` into the binary file `out_bf`, with the
+/// `_start` entry point: same result as oc8-as on every source, then oc8-ld
+/// Nothing is read or written on disk
+/// Errors don't abort the program: they are printed, and the function fails
+/// Can be called by many threads at once, with different arenas
+/// @param arena all memory, including `out_bf`, is allocated from it, and
+/// released with the arena (even on error)
+/// @returns 0 if success, != 0 on error
+int oc8_build_link_sources(const oc8_build_src_t *srcs, size_t nb_srcs,
+                           oc8_bin_file_t *out_bf, oc8_arena_t *arena);
+
+/// Build `srcs`, and load the ROM into the global emulator (see
+/// `oc8_emu_load_rom`)
+/// @returns 0 if success, != 0 on error
+int oc8_build_load_emu(const oc8_build_src_t *srcs, size_t nb_srcs);
+
+/// Build `srcs`, and load the ROM into machine `idx` of `b` (see
+/// `oc8_emu_batch_load_rom`)
+/// @returns 0 if success, != 0 on error
+int oc8_build_load_batch(const oc8_build_src_t *srcs, size_t nb_srcs,
+                         oc8_emu_batch_t *b, size_t idx);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // !OC8_BUILD_DRIVER_H_
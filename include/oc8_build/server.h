@@ -0,0 +1,93 @@
+#ifndef OC8_BUILD_SERVER_H_
+#define OC8_BUILD_SERVER_H_
+
+//===--oc8_build/server.h - in-memory build server ----------------*- C -*-===//
+//
+// oc8_build library
+// Author: Steven Lariau
+//
+//===----------------------------------------------------------------------===//
+///
+/// \file
+/// Build server used by oc8-buildd: runs the requests of oc8-as and oc8-ld
+/// (see client.h), and keeps the objects in memory between requests
+///
+//===----------------------------------------------------------------------===//
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "../oc8_arena/oc8_arena.h"
+#include "../oc8_bin/file.h"
+#include "../oc8_pool/oc8_pool.h"
+#include "../oc8_smap/oc8_smap.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Memory cache
+// Every file read or written by the server has an entry, keyed by its path:
+// - sources: the object file compiled from it
+// - object files: the object file it contains
+// The entry is valid while the file is unchanged on disk (same mtime, size,
+// and inode)
+// - AS: a source with a valid entry isn't assembled again. Its output is
+//   written only if it changed since the server wrote it
+// - LD: inputs with a valid entry aren't read again
+//
+// Requests are run one at a time, and the files of an AS request are
+// assembled in parallel
+// Errors in a request are printed to the stderr of the client, and only this
+// request fails
+
+/// Object file kept in memory, shared by many entries
+typedef struct {
+  oc8_arena_t arena;
+  oc8_bin_file_t bf; // allocated from `arena`
+  size_t refs;
+} oc8_build_obj_t;
+
+/// Version of a file on disk
+typedef struct {
+  int64_t mtime_sec;
+  int64_t mtime_nsec;
+  int64_t size;
+  uint64_t ino;
+  uint64_t dev;
+} oc8_build_file_id_t;
+
+typedef struct {
+  oc8_build_file_id_t id;
+  oc8_build_obj_t *obj;
+} oc8_build_entry_t;
+
+typedef struct {
+  char *socket_path;
+  int fd;
+  oc8_pool_t pool;
+  size_t nb_threads;
+  oc8_smap_t sources; // path => allocated oc8_build_entry_t *
+  oc8_smap_t objects; // path => allocated oc8_build_entry_t *
+
+  size_t nb_reused; // number of files taken from memory, for stats
+} oc8_build_server_t;
+
+/// Create the socket at `socket_path`, and start `nb_threads` threads
+/// (0: nb of CPUs)
+/// @returns 0 if success, != 0 if it fails, or another server is already
+/// running (the error is printed)
+int oc8_build_server_init(oc8_build_server_t *s, const char *socket_path,
+                          size_t nb_threads);
+
+/// Run requests until a STOP request
+void oc8_build_server_run(oc8_build_server_t *s);
+
+/// Remove the socket, and free all memory of the server
+void oc8_build_server_free(oc8_build_server_t *s);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // !OC8_BUILD_SERVER_H_
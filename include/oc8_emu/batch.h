@@ -0,0 +1,121 @@
+#ifndef OC8_EMU_BATCH_H_
+#define OC8_EMU_BATCH_H_
+
+//===--oc8_emu/batch.h - Batch of emulators -----------------------*- C -*-===//
+//
+// oc8_emu library
+// Author: Steven Lariau
+//
+//===----------------------------------------------------------------------===//
+///
+/// \file
+/// Run many independant CHIP-8 machines in the same process
+/// Used to play thousands of short episodes (bot testing, input fuzzing)
+/// All machines are stepped together on a pool of threads
+///
+//===----------------------------------------------------------------------===//
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "ctx.h"
+#include "input.h"
+#include "screen.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct oc8_emu_batch_pool oc8_emu_batch_pool_t;
+
+/// N machines allocated in one contiguous block
+/// Every array has one entry per machine, and is indexed by the machine id
+/// The RAM isn't in the block: machines running the same ROM share its pages
+/// (see ctx.h), and read it with `oc8_emu_ctx_read(&ctxs[i], addr)`
+/// The keypads and screens are flat arrays that the caller reads / writes
+/// directly between two steps:
+/// - keypad of machine i: keypads[i * OC8_EMU_NB_KEYS + k]
+/// - screen of machine i: screens[i * OC8_EMU_SCREEN_SIZE + b]
+///
+/// There is no wall-clock in a batch: the Delay and Sound Timers are
+/// decreased every `ins_per_frame` instructions executed by a machine
+typedef struct {
+  // Number of machines
+  size_t size;
+
+  oc8_emu_cpu_t *cpus;
+
+  // OC8_EMU_MIN_STACK_SIZE entries per machine
+  uint16_t *stacks;
+
+  uint8_t *screens;
+  int *keypads;
+
+  // Set to the OC8_EMU_EXEC_ERR_* code when a machine runs an invalid
+  // instruction, 0 otherwhise
+  // A halted machine isn't stepped anymore, until it's reset
+  uint8_t *halted;
+
+  // Contexts used to run the instructions, point to the other arrays
+  oc8_emu_ctx_t *ctxs;
+
+  // Number of instructions executed by a machine in one frame (1/60s)
+  // 0 is used as 1
+  uint16_t ins_per_frame;
+
+  // Total number of instructions executed by all machines
+  uint64_t counter_ins;
+
+  oc8_emu_batch_pool_t *pool;
+} oc8_emu_batch_t;
+
+/// Allocate a batch of `size` machines, all reset
+/// @param nb_threads - number of threads used to step the batch, including the
+/// calling thread. 0 to use one thread per online CPU
+/// @returns 0 if success, != 0 if the machines or threads cannot be allocated
+/// (printed), nothing is left to free then
+int oc8_emu_batch_init(oc8_emu_batch_t *b, size_t size, unsigned nb_threads);
+
+/// Stop all threads and release the memory of the batch
+void oc8_emu_batch_free(oc8_emu_batch_t *b);
+
+/// Reset machine `idx` to the same state than `oc8_emu_init`
+/// CPU, memory, screen and keypad are cleared, and the machine is un-halted
+void oc8_emu_batch_reset(oc8_emu_batch_t *b, size_t idx);
+
+/// Load a ROM into memory of machine `idx`, and set its PC
+/// The ROM is loaded through the ROM cache (see rom_cache.h), its pages are
+/// shared with all machines running the same ROM
+/// @returns 0 if success, != 0 if the ROM doesn't fit in memory
+int oc8_emu_batch_load_rom(oc8_emu_batch_t *b, size_t idx,
+                           const void *rom_bytes, unsigned rom_size);
+
+/// Load the same ROM into all machines
+/// The ROM is stored only once, and its pages are shared by all machines
+/// @returns 0 if success, != 0 if the ROM doesn't fit in memory
+int oc8_emu_batch_load_rom_all(oc8_emu_batch_t *b, const void *rom_bytes,
+                               unsigned rom_size);
+
+/// Run `nb_ins` instructions on every machine that isn't halted
+/// Returns once all machines are done
+/// A machine blocked on FX0A tries again at every instruction
+void oc8_emu_batch_step(oc8_emu_batch_t *b, unsigned nb_ins);
+
+/// Run one frame (`ins_per_frame` instructions) on every machine
+void oc8_emu_batch_step_frame(oc8_emu_batch_t *b);
+
+/// Returns a pointer to the screen matrix of machine `idx`
+static inline uint8_t *oc8_emu_batch_screen(oc8_emu_batch_t *b, size_t idx) {
+  return b->screens + idx * OC8_EMU_SCREEN_SIZE;
+}
+
+/// Returns a pointer to the keypad of machine `idx`
+static inline int *oc8_emu_batch_keypad(oc8_emu_batch_t *b, size_t idx) {
+  return b->keypads + idx * OC8_EMU_NB_KEYS;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // !OC8_EMU_BATCH_H_
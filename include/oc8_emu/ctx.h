@@ -0,0 +1,128 @@
+#ifndef OC8_EMU_CTX_H_
+#define OC8_EMU_CTX_H_
+
+//===--oc8_emu/ctx.h - Emulator context ---------------------------*- C -*-===//
+//
+// oc8_emu library
+// Author: Steven Lariau
+//
+//===----------------------------------------------------------------------===//
+///
+/// \file
+/// Group all the state of one CHIP-8 machine
+/// Instructions are executed on a context, so that many machines can live in
+/// the same process (see batch.h)
+///
+//===----------------------------------------------------------------------===//
+
+#include <stdint.h>
+
+#include "cpu.h"
+#include "mem.h"
+#include "metrics.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// Everything needed to run instructions on one machine
+///
+/// The RAM is accessed through a table of 256-byte pages
+/// Pages can be private to the machine, or shared read-only with other
+/// machines running the same ROM (from an `oc8_emu_image_t`). A shared page is
+/// copied on the first write (FX33 / FX55)
+typedef struct {
+  oc8_emu_cpu_t *cpu;
+
+  // RAM pages
+  uint8_t *pages[OC8_EMU_NB_PAGES];
+
+  // Bit i set if pages[i] belongs to `image`, and must be copied before write
+  uint16_t shared_pages;
+
+  // Image of the shared pages, NULL if the RAM is a `oc8_emu_mem_t`
+  // Pages copied from the image are allocated, and released on detach
+  oc8_emu_image_t *image;
+
+  // At least OC8_EMU_MIN_STACK_SIZE entries
+  uint16_t *stack;
+
+  // Screen matrix, OC8_EMU_SCREEN_SIZE bytes
+  uint8_t *screen;
+
+  // Keypad state, OC8_EMU_NB_KEYS entries
+  int *keypad;
+
+  // Can be NULL, no metrics are collected in that case
+  oc8_emu_metrics_t *metrics;
+} oc8_emu_ctx_t;
+
+/// Context of the global emulator
+/// Points to g_oc8_emu_cpu, g_oc8_emu_mem, g_oc8_emu_screen, g_oc8_emu_keypad
+/// and g_oc8_emu_metrics
+extern oc8_emu_ctx_t g_oc8_emu_ctx;
+
+/// Use `mem` as RAM and stack of `ctx`, no page is shared
+/// The previous image of `ctx` is detached
+void oc8_emu_ctx_set_mem(oc8_emu_ctx_t *ctx, oc8_emu_mem_t *mem);
+
+/// Use pages of `img` as RAM of `ctx`, and add a reference to `img`
+/// The previous image of `ctx` is detached
+void oc8_emu_ctx_attach(oc8_emu_ctx_t *ctx, oc8_emu_image_t *img);
+
+/// Release the pages copied from the image, and the reference to the image
+/// The pages of `ctx` are invalid until the next attach
+void oc8_emu_ctx_detach(oc8_emu_ctx_t *ctx);
+
+/// Replace the shared page `page` by a private copy
+void oc8_emu_ctx_privatize(oc8_emu_ctx_t *ctx, unsigned page);
+
+/// Read one byte of RAM, addresses wrap around at OC8_EMU_RAM_SIZE
+static inline uint8_t oc8_emu_ctx_read(const oc8_emu_ctx_t *ctx,
+                                       unsigned addr) {
+  addr &= OC8_EMU_RAM_SIZE - 1;
+  return ctx->pages[addr / OC8_EMU_PAGE_SIZE][addr % OC8_EMU_PAGE_SIZE];
+}
+
+/// Write one byte of RAM, addresses wrap around at OC8_EMU_RAM_SIZE
+static inline void oc8_emu_ctx_write(oc8_emu_ctx_t *ctx, unsigned addr,
+                                     uint8_t val) {
+  addr &= OC8_EMU_RAM_SIZE - 1;
+  unsigned page = addr / OC8_EMU_PAGE_SIZE;
+  if ((ctx->shared_pages >> page) & 0x1)
+    oc8_emu_ctx_privatize(ctx, page);
+  ctx->pages[page][addr % OC8_EMU_PAGE_SIZE] = val;
+}
+
+#define OC8_EMU_EXEC_OK (0)
+#define OC8_EMU_EXEC_ERR_DECODE (1)
+#define OC8_EMU_EXEC_ERR_STACK (2)
+// CXNN with NN = 0, or EX9E / EXA1 with a key > 0xF in VX
+#define OC8_EMU_EXEC_ERR_OPERAND (3)
+
+/// Fetch, decode and execute one instruction of `ctx`
+/// Doesn't update the timers, and never aborts
+/// The machine state isn't changed if an error happens
+/// @returns OC8_EMU_EXEC_OK, or OC8_EMU_EXEC_ERR_* if the instruction is
+/// invalid
+int oc8_emu_ctx_exec(oc8_emu_ctx_t *ctx);
+
+/// Decrease the Delay and Sound Timers of `ctx` by `val`, stops at 0
+void oc8_emu_ctx_decrease_timers(oc8_emu_ctx_t *ctx, unsigned val);
+
+/// Check that the instruction already fetched in `ctx->cpu->curr_ins` can be
+/// executed on the current state of `ctx`
+/// Implementation in exec_ins.c
+/// @returns OC8_EMU_EXEC_OK, or OC8_EMU_EXEC_ERR_STACK / _OPERAND
+int oc8_emu_check_ins(const oc8_emu_ctx_t *ctx);
+
+/// Execute the instruction already fetched in `ctx->cpu->curr_ins`
+/// It must be valid (see `oc8_emu_check_ins`)
+/// Implementation in exec_ins.c
+void oc8_emu_exec_ins(oc8_emu_ctx_t *ctx);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // !OC8_EMU_CTX_H_
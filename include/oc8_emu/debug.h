@@ -26,6 +26,10 @@ extern "C" {
 /// Null if version is 0
 extern oc8_bin_file_t g_oc8_emu_bin_file;
 
+/// ROM cache entry owning the content of `g_oc8_emu_bin_file`
+/// NULL if `g_oc8_emu_bin_file` is owned by the emulator
+extern struct oc8_emu_rom *g_oc8_emu_bin_rom;
+
 /// Returns true if `g_oc8_emu_bin_file` isn't empty
 static inline int g_oc8_emu_bin_file_loaded() {
   return g_oc8_emu_bin_file.header.version != 0;
@@ -0,0 +1,147 @@
+#ifndef OC8_EMU_LOCKSTEP_H_
+#define OC8_EMU_LOCKSTEP_H_
+
+//===--oc8_emu/lockstep.h - SIMD lockstep interpreter -------------*- C -*-===//
+//
+// oc8_emu library
+// Author: Steven Lariau
+//
+//===----------------------------------------------------------------------===//
+///
+/// \file
+/// Run many instances of the same ROM in lockstep, on a single thread
+/// The CPU state is stored as a structure of arrays: the same register of all
+/// machines is contiguous in memory
+/// At every step, all machines sharing the lowest PC execute the instruction
+/// together, with SIMD vector operations (SSE2, or AVX2 if compiled with
+/// -mavx2). Machines whose PC diverged wait, and are regrouped when the others
+/// reach the same PC
+///
+//===----------------------------------------------------------------------===//
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "ctx.h"
+#include "input.h"
+#include "screen.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// The number of machines is rounded up to a multiple of this
+#define OC8_EMU_LOCKSTEP_LANES (32)
+
+/// N machines running the same ROM
+/// Every per-machine array has `stride` entries, the extra padding machines
+/// are never executed
+/// - register Vr of machine i: regs[r * stride + i]
+/// - keypad of machine i: keypads[i * OC8_EMU_NB_KEYS + k]
+/// - screen of machine i: screens[i * OC8_EMU_SCREEN_SIZE + b]
+/// - RAM of machine i: `oc8_emu_ctx_read(&ctxs[i], addr)`, the ROM pages are
+///   shared by all machines
+///
+/// Timers are decreased every `ins_per_frame` instructions, like
+/// `oc8_emu_batch_t`, so both give the exact same results
+typedef struct {
+  // Number of machines
+  size_t size;
+
+  // `size` rounded up to OC8_EMU_LOCKSTEP_LANES
+  size_t stride;
+
+  uint8_t *regs;
+  uint16_t *reg_pc;
+  uint16_t *reg_i;
+  uint8_t *reg_dt;
+  uint8_t *reg_st;
+  uint8_t *reg_sp;
+  unsigned long *rg_seed;
+
+  // Set to 1 if the last executed instruction was a blocked FX0A
+  uint8_t *block_waitq;
+
+  // Set to the OC8_EMU_EXEC_ERR_* code when a machine runs an invalid
+  // instruction, 0 otherwhise
+  uint8_t *halted;
+
+  uint8_t *screens;
+  int *keypads;
+
+  // OC8_EMU_MIN_STACK_SIZE entries per machine
+  uint16_t *stacks;
+
+  // Memory, stack, screen and keypad of every machine
+  // The CPU isn't used, the registers are only in the arrays above
+  oc8_emu_ctx_t *ctxs;
+
+  // Number of instructions executed by a machine in one frame (1/60s)
+  // A new value is only used after the next timer update of every machine
+  // 0 is used as 1
+  uint16_t ins_per_frame;
+
+  // Total number of instructions executed by all machines
+  uint64_t counter_ins;
+
+  // Number of groups executed, `counter_ins / counter_groups` is the average
+  // number of machines executing every instruction
+  uint64_t counter_groups;
+
+  // Internal state
+  uint16_t *budget;
+  uint16_t *frame_left;
+  uint8_t *mask;
+  uint8_t *blk_any;
+
+  // Bitmap of all addresses written by any machine
+  // Instructions at these addresses must be fetched for every machine
+  uint8_t mem_written[OC8_EMU_RAM_SIZE / 8];
+} oc8_emu_lockstep_t;
+
+/// Allocate `size` machines, all reset
+/// @returns 0 if success, != 0 if the machines cannot be allocated (printed),
+/// nothing is left to free then
+int oc8_emu_lockstep_init(oc8_emu_lockstep_t *ls, size_t size);
+
+/// Release the memory of all machines
+void oc8_emu_lockstep_free(oc8_emu_lockstep_t *ls);
+
+/// Reset machine `idx` to the same state than `oc8_emu_init`
+/// The ROM must be loaded again
+void oc8_emu_lockstep_reset(oc8_emu_lockstep_t *ls, size_t idx);
+
+/// Load the ROM into memory of all machines, and set their PC
+/// @returns 0 if success, != 0 if the ROM doesn't fit in memory
+int oc8_emu_lockstep_load_rom(oc8_emu_lockstep_t *ls, const void *rom_bytes,
+                              unsigned rom_size);
+
+/// Run `nb_ins` instructions on every machine that isn't halted
+void oc8_emu_lockstep_step(oc8_emu_lockstep_t *ls, unsigned nb_ins);
+
+/// Run one frame (`ins_per_frame` instructions) on every machine
+void oc8_emu_lockstep_step_frame(oc8_emu_lockstep_t *ls);
+
+/// Returns a pointer to register Vr of machine 0
+static inline uint8_t *oc8_emu_lockstep_reg(oc8_emu_lockstep_t *ls,
+                                            unsigned r) {
+  return ls->regs + r * ls->stride;
+}
+
+/// Returns a pointer to the screen matrix of machine `idx`
+static inline uint8_t *oc8_emu_lockstep_screen(oc8_emu_lockstep_t *ls,
+                                               size_t idx) {
+  return ls->screens + idx * OC8_EMU_SCREEN_SIZE;
+}
+
+/// Returns a pointer to the keypad of machine `idx`
+static inline int *oc8_emu_lockstep_keypad(oc8_emu_lockstep_t *ls,
+                                           size_t idx) {
+  return ls->keypads + idx * OC8_EMU_NB_KEYS;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // !OC8_EMU_LOCKSTEP_H_
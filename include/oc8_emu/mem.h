@@ -17,6 +17,7 @@
 #include <stdint.h>
 
 #include "../oc8_bin/file.h"
+#include "../oc8_is/ins.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -27,6 +28,13 @@ extern "C" {
 #define OC8_EMU_ROM_ADDR (0x200)
 #define OC8_EMU_FONT_HEXA_ADDR (0x100)
 
+// Entries of the stack reachable with the 8-bit stack pointer
+#define OC8_EMU_MIN_STACK_SIZE (256)
+
+// The RAM is split in pages, that can be shared between machines
+#define OC8_EMU_PAGE_SIZE (256)
+#define OC8_EMU_NB_PAGES (OC8_EMU_RAM_SIZE / OC8_EMU_PAGE_SIZE)
+
 /// The CHIP-8 RAM
 typedef struct {
 
@@ -45,6 +53,46 @@ extern oc8_emu_mem_t g_oc8_emu_mem;
 /// Setup the content of the memory
 void oc8_emu_init_mem();
 
+/// Clear `mem`, and copy the hexadecimal font at OC8_EMU_FONT_HEXA_ADDR
+void oc8_emu_mem_reset(oc8_emu_mem_t *mem);
+
+/// Read-only RAM image of a ROM, shared by all machines running it
+/// Only the pages with ROM bytes are stored in the image, the other pages
+/// point to process-wide pages: the font page, and a zero page
+/// Reference counted, never modified after creation
+typedef struct {
+  unsigned refs;
+  uint8_t *pages[OC8_EMU_NB_PAGES];
+
+  // Optional instructions decoded at every address of the ROM pages
+  // ins[i] is the instruction at OC8_EMU_ROM_ADDR + i, only valid if
+  // ins_ok[i] != 0. NULL if the image wasn't decoded
+  oc8_is_ins_t *ins;
+  uint8_t *ins_ok;
+  unsigned ins_size;
+
+  uint8_t data[];
+} oc8_emu_image_t;
+
+/// Create an image with the font and `rom_bytes` loaded at OC8_EMU_ROM_ADDR
+/// The caller owns the only reference
+/// @returns NULL if the ROM doesn't fit in memory
+oc8_emu_image_t *oc8_emu_image_new(const void *rom_bytes, unsigned rom_size);
+
+/// Decode the instructions at every address of the ROM pages of `img`
+/// Must be called before `img` is shared
+void oc8_emu_image_decode(oc8_emu_image_t *img);
+
+/// Returns the image with only the font, never free'd
+oc8_emu_image_t *oc8_emu_image_font();
+
+/// Add a reference to `img`, thread-safe
+void oc8_emu_image_ref(oc8_emu_image_t *img);
+
+/// Remove a reference to `img`, and free it if it was the last one
+/// Thread-safe
+void oc8_emu_image_unref(oc8_emu_image_t *img);
+
 /// Load a ROM into memory
 /// @param rom_size must be <= 3584 to fit in memory
 /// Also set the PC at the beginning of the rom
@@ -54,13 +102,15 @@ void oc8_emu_load_rom(const void *rom_bytes, unsigned rom_size);
 /// Also assign `bf` as the debug bin of the emu
 /// `bf` is moved into emu and cannot be used (or free'd) after this
 /// Also set the PC at the beginning of the rom
-/// `oc8_bin_file_check` isn't called
+/// `oc8_bin_file_validate` isn't called
 void oc8_emu_load_bin(oc8_bin_file_t *bf);
 
 /// Wrapper around `oc8_emu_load_rom` / `oc8_emu_load_bin`
 /// Open / close the file, and do all the checks
 /// Can load raw ROM file. or binary `.ocbin` file
 /// Detect if the file is `.ocbin` (using magic number, not ext)
+/// The file is parsed through the ROM cache (see rom_cache.h), the symbols
+/// of `g_oc8_emu_bin_file` are shared with the cache entry
 void oc8_emu_load_rom_file(const char *path);
 
 #ifdef __cplusplus
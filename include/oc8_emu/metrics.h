@@ -0,0 +1,146 @@
+#ifndef OC8_EMU_METRICS_H_
+#define OC8_EMU_METRICS_H_
+
+//===--oc8_emu/metrics.h - Emulator metrics -----------------------*- C -*-===//
+//
+// oc8_emu library
+// Author: Steven Lariau
+//
+//===----------------------------------------------------------------------===//
+///
+/// \file
+/// Counters and histograms collected while the emulator is running
+/// Can be exported in Prometheus text format, and served on a local socket
+///
+//===----------------------------------------------------------------------===//
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define OC8_EMU_METRICS_CACHE_LINE (64)
+
+// Bucket i counts values <= 2^i, last bucket is +Inf
+#define OC8_EMU_METRICS_HIST_BUCKETS (24)
+
+/// Monotonic counter, alone on its cache line
+typedef struct __attribute__((aligned(OC8_EMU_METRICS_CACHE_LINE))) {
+  uint64_t val;
+} oc8_emu_metrics_counter_t;
+
+/// Histogram with power of 2 buckets
+/// Buckets are not cumulative, they are summed when exported
+typedef struct __attribute__((aligned(OC8_EMU_METRICS_CACHE_LINE))) {
+  uint64_t buckets[OC8_EMU_METRICS_HIST_BUCKETS];
+  uint64_t sum;
+  uint64_t count;
+} oc8_emu_metrics_hist_t;
+
+/// All metrics of one emulator context
+/// Updated by the CPU, except for frames that are counted by the front-end
+/// with `oc8_emu_metrics_frame`, and the ROM cache lookups that are counted
+/// by the cache in `g_oc8_emu_metrics`
+typedef struct {
+  // Number of executed instructions
+  oc8_emu_metrics_counter_t ins;
+
+  // Number of frames presented by the front-end
+  oc8_emu_metrics_counter_t frames;
+
+  // Number of DXYN executed since the last frame
+  oc8_emu_metrics_counter_t frame_draws;
+
+  // Number of DXYN executed per presented frame
+  oc8_emu_metrics_hist_t draws_per_frame;
+
+  // Number of ROM cache lookups that found / didn't find the ROM
+  oc8_emu_metrics_counter_t rom_cache_hits;
+  oc8_emu_metrics_counter_t rom_cache_misses;
+
+  // Time in us spent blocked on FX0A, for every completed wait
+  oc8_emu_metrics_hist_t waitk_us;
+
+  // Difference in us between the wanted and the real cycle start time
+  oc8_emu_metrics_hist_t pacing_jitter_us;
+
+  // Time in us when the current FX0A wait started, 0 if not waiting
+  uint64_t waitk_begin;
+
+  // Instructions per second, computed by `oc8_emu_metrics_update_ips`
+  double ips;
+  uint64_t ips_last_time;
+  uint64_t ips_last_ins;
+} oc8_emu_metrics_t;
+
+/// Metrics of the global emulator
+extern oc8_emu_metrics_t g_oc8_emu_metrics;
+
+/// Called by `emu_init`
+/// Reset all metrics to 0
+void oc8_emu_init_metrics();
+
+/// Returns the current time in us, clock used for all metrics
+uint64_t oc8_emu_metrics_now_us();
+
+static inline void oc8_emu_metrics_inc(oc8_emu_metrics_counter_t *c) {
+  ++c->val;
+}
+
+/// Add one value to the histogram `h`
+void oc8_emu_metrics_observe(oc8_emu_metrics_hist_t *h, uint64_t val);
+
+/// Must be called by the front-end every time a frame is displayed
+/// (when the screen changed, or at every timer tick)
+void oc8_emu_metrics_frame(oc8_emu_metrics_t *m);
+
+/// Compute the instructions per second since the last call
+void oc8_emu_metrics_update_ips(oc8_emu_metrics_t *m);
+
+/// Write all metrics of `m` in Prometheus text format to `out_buf`
+/// The output is 0-terminated, and truncated if `out_buf_len` is too small
+/// `out_buf` may be NULL if `out_buf_len` is 0
+/// @returns number of bytes needed (without final \0)
+size_t oc8_emu_metrics_print(const oc8_emu_metrics_t *m, char *out_buf,
+                             size_t out_buf_len);
+
+// Max number of connected clients waiting for their request to be read
+#define OC8_EMU_METRICS_MAX_CLIENTS (8)
+
+/// Local socket serving the metrics over HTTP
+/// Doesn't use any thread, the emulator loop must call
+/// `oc8_emu_metrics_server_poll` regularly (once per frame)
+/// All sockets are non-blocking: a client that didn't send its request yet
+/// stays pending until a later poll, or is dropped after a timeout
+typedef struct {
+  int fd;
+  oc8_emu_metrics_t *m;
+  char unix_path[108]; // Removed on close, empty for TCP
+
+  int clients[OC8_EMU_METRICS_MAX_CLIENTS];
+  uint64_t clients_deadline[OC8_EMU_METRICS_MAX_CLIENTS]; // in us
+  size_t nb_clients;
+} oc8_emu_metrics_server_t;
+
+/// Start listening on `addr`
+/// `addr` is either `unix:<path>` for a Unix-domain socket, or a port number
+/// to listen on localhost (127.0.0.1)
+/// @returns 0 if success, != 0 otherwhise
+int oc8_emu_metrics_server_open(oc8_emu_metrics_server_t *srv,
+                                oc8_emu_metrics_t *m, const char *addr);
+
+/// Accept new clients, and answer those whose request arrived
+/// Never blocks, neither on accept nor on reading a request
+/// The instructions per second are updated at every scrape
+void oc8_emu_metrics_server_poll(oc8_emu_metrics_server_t *srv);
+
+/// Stop listening and release the socket
+void oc8_emu_metrics_server_close(oc8_emu_metrics_server_t *srv);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // !OC8_EMU_METRICS_H_
@@ -14,9 +14,14 @@
 ///
 //===----------------------------------------------------------------------===//
 
+#include "batch.h"
 #include "cpu.h"
+#include "ctx.h"
 #include "input.h"
+#include "lockstep.h"
 #include "mem.h"
+#include "metrics.h"
+#include "rom_cache.h"
 #include "screen.h"
 
 #endif // !OC8_EMU_OC8_EMU_H_
@@ -0,0 +1,95 @@
+#ifndef OC8_EMU_ROM_CACHE_H_
+#define OC8_EMU_ROM_CACHE_H_
+
+//===--oc8_emu/rom_cache.h - Shared ROM cache ---------------------*- C -*-===//
+//
+// oc8_emu library
+// Author: Steven Lariau
+//
+//===----------------------------------------------------------------------===//
+///
+/// \file
+/// Process-wide cache of loaded ROMs, indexed by a hash of their content
+/// Loading the same ROM many times (eg many batch machines, or many emulator
+/// sessions) only reads, parses and decodes it once
+/// All functions are thread-safe
+///
+//===----------------------------------------------------------------------===//
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "../oc8_arena/oc8_arena.h"
+#include "../oc8_bin/file.h"
+#include "mem.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// One loaded ROM, never modified after creation
+/// Reference counted, the cache owns one reference until it is trimmed
+typedef struct oc8_emu_rom {
+  unsigned refs;
+
+  // Hash of the content, and the content itself (raw ROM or .c8bin file)
+  uint64_t hash;
+  uint8_t *content;
+  size_t content_size;
+
+  // True if the content was checked for the .c8bin format
+  int detect_bin;
+
+  // RAM image with the ROM, its instructions are decoded
+  // Machines attach to it with `oc8_emu_ctx_attach`
+  oc8_emu_image_t *image;
+
+  // ROM bytes, stored in the image
+  const uint8_t *rom;
+  size_t rom_size;
+
+  // Symbols of the ROM, only valid if `has_bin`
+  // All their memory is allocated from `bin_arena`
+  int has_bin;
+  oc8_bin_file_t bin;
+  oc8_arena_t bin_arena;
+
+  // Next entry with the same hash bucket
+  struct oc8_emu_rom *next;
+} oc8_emu_rom_t;
+
+/// Get the entry for the raw ROM `rom_bytes`, and load it if needed
+/// The caller owns one reference to the result
+/// @returns NULL if the ROM doesn't fit in memory
+oc8_emu_rom_t *oc8_emu_rom_cache_get(const void *rom_bytes, size_t rom_size);
+
+/// Same as `oc8_emu_rom_cache_get`, but `content` can be either a raw ROM or
+/// a `.c8bin` file (detected with the magic number)
+/// @returns NULL if the `.c8bin` file is invalid (errors are printed), or the
+/// ROM doesn't fit in memory
+oc8_emu_rom_t *oc8_emu_rom_cache_get_content(const void *content,
+                                             size_t content_size);
+
+/// Read the file at `path`, and call `oc8_emu_rom_cache_get_content`
+/// @returns NULL if the file cannot be read, is an invalid `.c8bin` file, or
+/// the ROM is too big (errors are printed)
+oc8_emu_rom_t *oc8_emu_rom_cache_get_file(const char *path);
+
+/// Add a reference to `rom`
+void oc8_emu_rom_ref(oc8_emu_rom_t *rom);
+
+/// Remove a reference to `rom`, and free it if it was the last one
+void oc8_emu_rom_unref(oc8_emu_rom_t *rom);
+
+/// Remove all entries only referenced by the cache
+/// Machines attached to their images keep running
+void oc8_emu_rom_cache_trim();
+
+/// Returns the number of entries in the cache
+size_t oc8_emu_rom_cache_size();
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // !OC8_EMU_ROM_CACHE_H_
@@ -22,27 +22,31 @@ extern "C" {
 #define OC8_EMU_SCREEN_WIDTH (64)
 #define OC8_EMU_SCREEN_HEIGHT (32)
 
+// Size in bytes of the screen matrix
+#define OC8_EMU_SCREEN_SIZE (OC8_EMU_SCREEN_WIDTH * OC8_EMU_SCREEN_HEIGHT / 8)
+
 /// The screen matrix
 /// Every byte entry is 8 pixels
 /// The emulator doesn't display the matrix,
 /// It simply set this matrix
-extern uint8_t
-    g_oc8_emu_screen[OC8_EMU_SCREEN_WIDTH * OC8_EMU_SCREEN_HEIGHT / 8];
+extern uint8_t g_oc8_emu_screen[OC8_EMU_SCREEN_SIZE];
 
-static inline int oc8_emu_screen_get_pix(unsigned x, unsigned y) {
+static inline int oc8_emu_screen_buf_get_pix(const uint8_t *screen, unsigned x,
+                                             unsigned y) {
   unsigned pos = y * OC8_EMU_SCREEN_WIDTH + x;
   unsigned idx = pos / 8;
   unsigned bit = pos % 8;
-  unsigned val = g_oc8_emu_screen[idx];
+  unsigned val = screen[idx];
 
   return (val >> bit) & 0x1;
 }
 
-static inline void oc8_emu_screen_set_pix(unsigned x, unsigned y, int v) {
+static inline void oc8_emu_screen_buf_set_pix(uint8_t *screen, unsigned x,
+                                              unsigned y, int v) {
   unsigned pos = y * OC8_EMU_SCREEN_WIDTH + x;
   unsigned idx = pos / 8;
   unsigned bit = pos % 8;
-  unsigned val = g_oc8_emu_screen[idx];
+  unsigned val = screen[idx];
   unsigned mask = 0x1 << bit;
 
   if (v)
@@ -50,7 +54,15 @@ static inline void oc8_emu_screen_set_pix(unsigned x, unsigned y, int v) {
   else
     val &= ~mask;
 
-  g_oc8_emu_screen[idx] = val & 0xFF;
+  screen[idx] = val & 0xFF;
+}
+
+static inline int oc8_emu_screen_get_pix(unsigned x, unsigned y) {
+  return oc8_emu_screen_buf_get_pix(g_oc8_emu_screen, x, y);
+}
+
+static inline void oc8_emu_screen_set_pix(unsigned x, unsigned y, int v) {
+  oc8_emu_screen_buf_set_pix(g_oc8_emu_screen, x, y, v);
 }
 
 /// Called be `emu_init`
@@ -80,6 +80,10 @@ typedef struct {
 /// @returns != 0 if failed to decode instruction
 int oc8_is_decode_ins(oc8_is_ins_t *ins, const char *buf);
 
+/// Same as `oc8_is_decode_ins`, but doesn't print a warning on failure
+/// Used to decode bytes that may be data
+int oc8_is_try_decode_ins(oc8_is_ins_t *ins, const char *buf);
+
 /// Encode the instruction `ins`
 /// Write the opcode in 2 bytes of `buf`
 /// Also write it in opcode field of `ins`
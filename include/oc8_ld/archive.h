@@ -0,0 +1,43 @@
+#ifndef OC8_LD_ARCHIVE_H_
+#define OC8_LD_ARCHIVE_H_
+
+//===--oc8_ld/archive.h - lazy extraction of archive members ------*- C -*-===//
+//
+// oc8_ld library
+// Author: Steven Lariau
+//
+//===----------------------------------------------------------------------===//
+///
+/// \file
+/// Add to a linker the members of its archives that are needed, like a
+/// static library
+///
+//===----------------------------------------------------------------------===//
+
+#include "oc8_ld/linker.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Member extraction
+//
+// An extern symbol of a unit is undefined if no unit defines it as global.
+// Every undefined symbol is searched in the archives, in the order they were
+// added, with the symbol index of the archive: the first member that defines
+// it is read from the archive data, and added as a new unit after all others.
+// Its own extern symbols are resolved the same way, until no member is added
+// Members that define no undefined symbol are never read
+// Symbols not found in any archive are errors of step 3)
+
+/// Add to `ld` the members of its archives needed by its units
+/// The members already added stay units of `ld` on error
+/// @param nb_added set to the number of members added, optional
+/// @returns 0 if success, != 0 if a member isn't a valid object file (printed)
+int oc8_ld_extract_members(oc8_ld_linker_t *ld, size_t *nb_added);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // !OC8_LD_ARCHIVE_H_
@@ -0,0 +1,118 @@
+#ifndef OC8_LD_INCREMENTAL_H_
+#define OC8_LD_INCREMENTAL_H_
+
+//===--oc8_ld/incremental.h - link files with a cache -------------*- C -*-===//
+//
+// oc8_ld library
+// Author: Steven Lariau
+//
+//===----------------------------------------------------------------------===//
+///
+/// \file
+/// Link object files to a binary file, reusing the work of previous links
+/// stored in a cache directory (see oc8_bin/cache.h)
+///
+//===----------------------------------------------------------------------===//
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "oc8_bin/cache.h"
+#include "oc8_pool/oc8_pool.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Link with a cache
+//
+// 1) The key of the output is the hash of the content of all inputs, in
+//    order. If the cache has an output for this key, it's used as is
+//
+// 2) Otherwise, the linker state of the last link of the same output path is
+//    read from the cache (<hash of path>.c8ld). For every input, it has:
+//    - the hash of the content
+//    - the hash of the interface: ROM size and list of symbol defs, with
+//      their name, type, and address (0 if extern)
+//    - its position in the output: ROM address, first output symbol id, and
+//      range of its refs
+//
+// 3) If all changed inputs kept the same interface, the symbol layout of the
+//    output is the same: the previous output is copied, and only the ROM
+//    bytes and refs of the changed inputs are replaced and patched again
+//
+// 4) Otherwise, everything is linked again (see linker.h)
+//
+// The new output and linker state are stored in the cache
+// In every case, the output is identical to the one of a full link
+// With the garbage collection of sections, the layout depends on all inputs:
+// there is no incremental link, only steps 1) and 4)
+// Same with archives (.c8a, see oc8_bin/archive.h): an input can add any
+// number of units
+
+typedef enum {
+  OC8_LD_LINK_FULL,        // all inputs were linked
+  OC8_LD_LINK_INCREMENTAL, // only the changed inputs were patched
+  OC8_LD_LINK_CACHED,      // the output was found in the cache
+} oc8_ld_link_kind_t;
+
+/// Must be changed every time the linker output changes for the same inputs,
+/// to invalidate the binaries in the caches
+#define OC8_LD_CACHE_VERSION (2)
+
+/// Options of `oc8_ld_link_files`, all fields can be 0 / NULL
+typedef struct {
+  /// Threads used by a full link to patch the units (see
+  /// `oc8_ld_linker_set_pool`)
+  oc8_pool_t *pool;
+
+  /// Used as explained above
+  const oc8_bin_cache_t *cache;
+
+  /// Remove the code and data not reachable from `_start` (see linker.h)
+  int use_gc;
+
+  /// Fold the identical functions and objects (see pieces.h)
+  int use_icf;
+
+  /// If != 0, inline the leaf functions up to this size (see lto.h)
+  uint16_t lto_max_size;
+
+  /// If not NULL, the inlined and folded symbols are printed to it (not when
+  /// the output is taken from the cache)
+  FILE *report;
+
+  /// If not NULL, the map of the output is printed to it (see map.h)
+  /// The output is always linked again, without the cache
+  FILE *map;
+} oc8_ld_link_opts_t;
+
+/// Infos about the output of `oc8_ld_link_files`
+typedef struct {
+  oc8_ld_link_kind_t kind; // the way the output was built
+
+  // Size of the ROM of all inputs (all members for an archive), and of the
+  // output ROM, without the start code: the difference is the size reclaimed
+  // by the garbage collection, the folding, and the unused members, minus the
+  // size added by the inlining
+  size_t in_rom_size;
+  size_t out_rom_size;
+} oc8_ld_link_res_t;
+
+/// Link the object files `in_paths` into the binary file `out_path`, with
+/// the `_start` entry point
+/// Inputs can also be archives, only their needed members are linked
+/// Errors don't abort the program: they are printed, and the function fails
+/// @param opts if NULL, use the default options
+/// @param res if not NULL, set to infos about the output
+/// @returns 0 if success, != 0 on error
+int oc8_ld_link_files(const char *const *in_paths, size_t nb_inputs,
+                      const char *out_path, const oc8_ld_link_opts_t *opts,
+                      oc8_ld_link_res_t *res);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // !OC8_LD_INCREMENTAL_H_
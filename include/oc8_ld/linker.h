@@ -17,8 +17,10 @@
 #include <stddef.h>
 #include <stdint.h>
 
+#include "oc8_bin/archive.h"
 #include "oc8_bin/file.h"
 #include "oc8_defs/oc8_defs.h"
+#include "oc8_pool/oc8_pool.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -26,6 +28,28 @@ extern "C" {
 
 // Linking process
 //
+// Archives (`oc8_ld_linker_add_archive`, see archive.h): before all steps,
+// the members of archives that define a global symbol still undefined are
+// added as units, until all symbols are found or aren't in any archive
+//
+// Link-time inlining (`oc8_ld_linker_set_lto`, see lto.h): then, the calls
+// to small leaf functions are replaced by their body, and the units changed
+// are assembled again
+//
+// 0) Only with garbage collection of sections (`oc8_ld_linker_set_gc`), or
+//    identical code folding (`oc8_ld_linker_set_icf`), see pieces.h
+//    Split the ROM of every obj in pieces: the range of every symbol with a
+//    type and a size (.type / .size directives), and the bytes between them
+//    With gc, mark live the pieces of the start code, and all the pieces they
+//    reference (through symbol refs), recursively. A piece without a size can
+//    also run into the next one, it's always live with it
+//    With icf, identical live pieces with a size are folded into one
+//    Only live pieces that weren't folded are kept, they are moved closer,
+//    with the same address parity: instructions stay aligned
+//    Symbol defs and refs of removed pieces are dropped, and extern symbols
+//    only used by removed pieces don't need to be defined
+//    Symbol defs of folded pieces are moved to the copy that is kept
+//
 // 1) Compute the start address for every obj in the final ROM file
 //    All obj code is located one after the other, starting at 0x200
 //    Check if the output ROM size isn't too big (max 4K)
@@ -47,12 +71,17 @@ extern "C" {
 //    Fix and add every ref to the output symbol refs list
 //    Fix ins_addr: use the start addr of the obj
 //    Fix sym_id: use the mapping from obj sym_id to output sym_id
+//    The addr of the symbol is already known: compute the patch of the
+//    instruction (field to change, found with the first nibble of the opcode,
+//    and value), and check that the value fits in the field
+//    Steps 3) and 4) are done in the same pass over the units
 //
 // 5) Concat binary data of all obj files into one for the output bin file.
 //
 // 6) Go through all the symbol refs of the output bin file
-//    For each one, fix the opcode in the RAM by using the known addr from the
-//    symbols def as the constant value
+//    For each one, apply its patch: a masked store of the immediate field
+//    Steps 5) and 6) can't fail, and are done per unit: units are disjoint
+//    parts of the ROM, patched in parallel if the linker has a pool
 //
 // A synbol '_start' must be defined, that's the program entry point.
 // Actually the entry point is still at 0x200, but the linker add this code at
@@ -60,19 +89,82 @@ extern "C" {
 // _rom_begin:
 //  jmp _start
 
+/// Part of the ROM of an obj, kept or removed as a whole by the garbage
+/// collection of sections
+typedef struct {
+  uint16_t begin;      // offset in the obj ROM
+  uint16_t end;        // offset of the end (excluded)
+  uint16_t out_off;    // offset in the ROM of the obj in the output, if kept
+  uint16_t sym_id;     // obj sym_id of the symbol of the range, if sized
+  uint32_t kept_unit;  // if folded, unit index of the copy kept
+  uint32_t kept_piece; // if folded, piece index of the copy kept
+  uint8_t is_sized;    // range of a symbol with a type and a size
+  uint8_t is_live;
+  uint8_t is_folded; // live, but replaced by an identical piece
+} oc8_ld_piece_t;
+
 // Contains all infos needed during linking for one obj file `bf`
 typedef struct {
   oc8_bin_file_t *bf;
   uint16_t *syms_map; // mapping from obj sym_id to output sym_id
   uint16_t rom_addr;  // ROM addr offset in the output binary
+  uint16_t out_size;  // size of the obj in the output ROM
+  size_t refs_begin;  // index of the first ref of the obj in the output
+  size_t refs_size;   // number of refs of the obj in the output
+
+  // Pieces sorted by offset, only with garbage collection
+  oc8_ld_piece_t *pieces;
+  size_t nb_pieces;
+
+  // `bf` is a member of an archive, released with the linker
+  int owns_bf;
+
+  // Name of the input, only used by the map (see map.h), or NULL
+  const char *name;
 } oc8_ld_unit_t;
 
+/// Leaf function inlined by the link-time inlining
+typedef struct {
+  uint32_t unit;    // unit index of the function
+  const char *name; // interned (see oc8_smap/oc8_strpool.h)
+  size_t nb_calls;  // number of call sites replaced
+} oc8_ld_inlined_t;
+
+/// Immediate field of an instruction changed by a ref
+typedef enum {
+  OC8_LD_PATCH_NNN, // 12 bits: 0NNN, 1NNN, 2NNN, ANNN, BNNN
+  OC8_LD_PATCH_NN,  // 8 bits: 3XNN, 4XNN, 6XNN, 7XNN, CXNN
+  OC8_LD_PATCH_N,   // 4 bits: DXYN
+} oc8_ld_patch_kind_t;
+
 typedef struct {
   oc8_ld_unit_t **units_arr; // allocated array of units, grows by realloc
   size_t units_size;
   size_t units_cap;
   oc8_bin_file_t start_bf;
   int use_start_bf;
+
+  // Archives searched for undefined symbols, in order, grows by realloc
+  const oc8_bin_archive_t **archives_arr;
+  size_t archives_size;
+  size_t archives_cap;
+
+  // All memory is allocated from this arena, or with malloc if NULL
+  oc8_arena_t *arena;
+
+  // Threads used to patch the units, or NULL
+  oc8_pool_t *pool;
+
+  // Garbage collection of sections, and identical code folding (step 0)
+  int use_gc;
+  int use_icf;
+
+  // Max size of the functions inlined, 0 without link-time inlining
+  uint16_t lto_max_size;
+  // Functions inlined, in the order of their first call, grows by realloc
+  oc8_ld_inlined_t *inlined_arr;
+  size_t inlined_size;
+  size_t inlined_cap;
 } oc8_ld_linker_t;
 
 /// Initialize the linker `ld` with no input files
@@ -80,20 +172,72 @@ typedef struct {
 /// above
 void oc8_ld_linker_init(oc8_ld_linker_t *ld, int use_start_sym);
 
+/// Same as `oc8_ld_linker_init`, but all memory of the linker, and of the
+/// output file, is allocated from `arena`
+/// `oc8_ld_linker_free` doesn't release anything
+void oc8_ld_linker_init_arena(oc8_ld_linker_t *ld, int use_start_sym,
+                              oc8_arena_t *arena);
+
+/// Patch the units on the threads of `pool` (steps 5 and 6 above)
+/// The output is the same as without pool
+void oc8_ld_linker_set_pool(oc8_ld_linker_t *ld, oc8_pool_t *pool);
+
+/// Enable or disable the garbage collection of sections (step 0 above)
+/// Disabled by default
+void oc8_ld_linker_set_gc(oc8_ld_linker_t *ld, int use_gc);
+
+/// Enable or disable the identical code folding (step 0 above)
+/// Disabled by default
+void oc8_ld_linker_set_icf(oc8_ld_linker_t *ld, int use_icf);
+
+/// Inline the leaf functions up to `max_size` bytes at their call sites
+/// (see lto.h), 0 to disable it
+/// Disabled by default
+void oc8_ld_linker_set_lto(oc8_ld_linker_t *ld, uint16_t max_size);
+
 /// Free all ressources alocated by the linker struct `ld`
 void oc8_ld_linker_free(oc8_ld_linker_t *ld);
 
 /// Add an input bin object file `bf` (.c8o) to the linker unit `ld`
 /// Doesn't perform linking yet, just add `bf` to the list of objects
 /// `bf` must not be of type object and not bin
-/// Doesn't call `oc8_bin_file_check` on `bf`
+/// Doesn't call `oc8_bin_file_validate` on `bf`
 /// `bf` pointer must still be valid when calling `oc8_ld_linker_link`
 void oc8_ld_linker_add(oc8_ld_linker_t *ld, oc8_bin_file_t *bf);
 
+/// Same as `oc8_ld_linker_add`, with the name of the input in the map
+/// `name` must still be valid when the map is printed
+void oc8_ld_linker_add_named(oc8_ld_linker_t *ld, oc8_bin_file_t *bf,
+                             const char *name);
+
+/// Add the archive `ar` (.c8a): its members are added as units only if they
+/// define a symbol needed by the other units
+/// `ar` must still be valid when calling `oc8_ld_linker_link`
+void oc8_ld_linker_add_archive(oc8_ld_linker_t *ld,
+                               const oc8_bin_archive_t *ar);
+
 /// Link all object files specified with `oc8_ld_linker_add` into one header
 /// file Output binary file written to `out_bf` `out_bf` must be initialized
-/// Doesn't call `oc8_bin_file_check` at the end
-void oc8_ld_linker_link(oc8_ld_linker_t *ld, oc8_bin_file_t *out_bf);
+/// `out_bf` allocates from the arena of the linker, if any
+/// Doesn't call `oc8_bin_file_validate` at the end
+/// @returns 0 if success, != 0 on error (printed), `out_bf` is freed then and
+/// `ld` must only be freed
+int oc8_ld_linker_link(oc8_ld_linker_t *ld, oc8_bin_file_t *out_bf);
+
+/// Change the immediate operand of the instruction at `ins_addr` to `val`
+/// (step 6 above)
+/// @param rom ROM data, starting at 0x200
+/// @returns 0 if success, != 0 if the instruction has no immediate field, or
+/// `val` doesn't fit in it (printed)
+int oc8_ld_fix_opcode(uint8_t *rom, uint16_t ins_addr, uint16_t val);
+
+/// Find the immediate field `kind` of the 2 bytes instruction `ins`
+/// @returns 0 if found, != 0 if it has none (not printed)
+int oc8_ld_get_patch_kind(const uint8_t *ins, oc8_ld_patch_kind_t *kind);
+
+/// Set the immediate field `kind` of the instruction `ins` to `val`, without
+/// any check
+void oc8_ld_apply_patch(uint8_t *ins, oc8_ld_patch_kind_t kind, uint16_t val);
 
 #ifdef __cplusplus
 }
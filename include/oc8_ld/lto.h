@@ -0,0 +1,65 @@
+#ifndef OC8_LD_LTO_H_
+#define OC8_LD_LTO_H_
+
+//===--oc8_ld/lto.h - link-time inlining --------------------------*- C -*-===//
+//
+// oc8_ld library
+// Author: Steven Lariau
+//
+//===----------------------------------------------------------------------===//
+///
+/// \file
+/// Link-time optimization: inline the small leaf functions of all objects at
+/// their call sites, before the other steps of linking (see linker.h)
+///
+//===----------------------------------------------------------------------===//
+
+#include <stddef.h>
+#include <stdio.h>
+
+#include "oc8_ld/linker.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Link-time inlining
+//
+// A leaf function is a symbol with a `.type @function` and a `.size` not
+// bigger than the max size, made only of instructions, that ends with its
+// only `ret`. It has no jump or call, and the instruction before the `ret`
+// isn't a skip. Its refs must be to global or extern symbols to be inlined
+// in another unit
+//
+// Every unit with a call to a leaf function is lifted back to assembly
+// items (see oc8_as/sfile.h): the refs of an object give the symbol of every
+// instruction that uses one, so the code can be moved and assembled again.
+// Bytes in functions and around the refs are instructions, the others are
+// kept as bytes. While it's lifted, every `call f` is replaced by the body of
+// `f`, without its `ret`. A call after a skip is only replaced if the body is
+// a single instruction. A unit with a BNNN jump isn't lifted: its code can't
+// move
+// Jumps are threaded again in the unit (see oc8_as/opt.h), and it's
+// assembled into a new object
+// Functions no longer called are kept, the garbage collection of sections
+// removes them
+
+/// Default max size of the leaf functions inlined, with their `ret`
+#define OC8_LD_LTO_DEFAULT_MAX_SIZE (6)
+
+/// Inline the leaf functions at their call sites in all units of `ld`
+/// No unit is changed on error
+/// @param nb_calls set to the number of call sites replaced, optional
+/// @returns 0 if success, != 0 if an object isn't valid (printed)
+int oc8_ld_inline_calls(oc8_ld_linker_t *ld, size_t *nb_calls);
+
+/// Print to `os` one line for every inlined function, after
+/// `oc8_ld_linker_link`
+/// @returns the number of call sites replaced
+size_t oc8_ld_print_inlines(const oc8_ld_linker_t *ld, FILE *os);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // !OC8_LD_LTO_H_
@@ -0,0 +1,47 @@
+#ifndef OC8_LD_MAP_H_
+#define OC8_LD_MAP_H_
+
+//===--oc8_ld/map.h - map file of a linked binary -----------------*- C -*-===//
+//
+// oc8_ld library
+// Author: Steven Lariau
+//
+//===----------------------------------------------------------------------===//
+///
+/// \file
+/// Print the map of the output of the linker: where every unit and every
+/// symbol is, and the bytes left in the ROM
+///
+//===----------------------------------------------------------------------===//
+
+#include <stdio.h>
+
+#include "oc8_bin/file.h"
+#include "oc8_ld/linker.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Map format
+//
+// The first line is the ROM budget: bytes used, of the 0x200-0xFFF range,
+// bytes free, and padding bytes added by the linker
+// Then every unit, in output order:
+// - one line with its address, output size, input size, padding bytes
+//   added by the linker, bytes removed (gc) or folded (icf), and name
+// - one line for every symbol inside it, sorted by address then name, with
+//   its address, size, type, and name. The size is prefixed by `~` if it's
+//   estimated (see oc8_bin/size.h)
+// Folded symbols are aliases: they are listed with the unit of the copy that
+// is kept
+
+/// Print the map of `out_bf`, after `oc8_ld_linker_link` with `ld`
+void oc8_ld_print_map(const oc8_ld_linker_t *ld, const oc8_bin_file_t *out_bf,
+                      FILE *os);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // !OC8_LD_MAP_H_
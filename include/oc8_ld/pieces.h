@@ -0,0 +1,64 @@
+#ifndef OC8_LD_PIECES_H_
+#define OC8_LD_PIECES_H_
+
+//===--oc8_ld/pieces.h - remove and fold parts of objects ---------*- C -*-===//
+//
+// oc8_ld library
+// Author: Steven Lariau
+//
+//===----------------------------------------------------------------------===//
+///
+/// \file
+/// Split the objects of a linker in pieces, to remove the unused ones
+/// (garbage collection of sections), and fold the identical ones (identical
+/// code folding). This is the step 0 of linking (see linker.h)
+///
+//===----------------------------------------------------------------------===//
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "oc8_ld/linker.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Identical code folding
+//
+// Only live pieces with a size can be folded, if the code before them doesn't
+// run into them. Objects are only folded if the program can't write to
+// memory: no unit has the bytes of a bcd or a `movm` to memory, else two
+// buffers would become one. Two pieces are identical if:
+// - they have the same bytes, once the immediate fields changed by the refs
+//   are set to 0
+// - they have refs at the same offsets, to the same offset of identical
+//   pieces
+//
+// Pieces are put in classes by hash, first with their bytes and the offsets
+// of their refs, then again with the class of the targets of their refs,
+// until the number of classes doesn't change. Pieces of the same hash are
+// still compared, collisions are never folded
+// In every class, the first piece in the output is kept
+
+/// Index of the piece at `off` in the obj ROM, `unit` must have pieces
+size_t oc8_ld_find_piece(const oc8_ld_unit_t *unit, uint16_t off);
+
+/// Split all units of `ld` in pieces, mark the live ones (all of them
+/// without gc), and fold the identical ones (only with icf)
+/// Set the output size and the number of output refs of every unit
+/// @returns 0 if success, != 0 if a global is defined twice, or a live piece
+/// uses an undefined symbol (printed)
+int oc8_ld_collect_pieces(oc8_ld_linker_t *ld);
+
+/// Print to `os` one line for every folded symbol, after
+/// `oc8_ld_linker_link`
+/// @returns the total size of the folded pieces
+size_t oc8_ld_print_folds(const oc8_ld_linker_t *ld, FILE *os);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // !OC8_LD_PIECES_H_
@@ -0,0 +1,69 @@
+#ifndef OC8_POOL_OC8_POOL_H_
+#define OC8_POOL_OC8_POOL_H_
+
+//===--oc8_pool/oc8_pool.h - Pool of worker threads ---------------*- C -*-===//
+//
+// oc8_pool library
+// Author: Steven Lariau
+//
+//===----------------------------------------------------------------------===//
+///
+/// \file
+/// Definition of struct oc8_pool_t
+/// Pool of worker threads, started once, to run many independent jobs
+/// in parallel: `oc8_pool_run` is a parallel for loop
+///
+//===----------------------------------------------------------------------===//
+
+#include <pthread.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// Job function: `arg` is the argument given to `oc8_pool_run`, and `idx`
+/// the index of the job
+typedef void (*oc8_pool_fn_f)(void *arg, size_t idx);
+
+typedef struct {
+  pthread_t *threads;
+  size_t nb_threads;
+
+  pthread_mutex_t lock;
+  pthread_cond_t cv_work; // new batch of jobs, or stop
+  pthread_cond_t cv_done; // one worker finished the batch
+  pthread_mutex_t run_lock; // only one batch at a time
+  int stop;
+
+  // Current batch, jobs are taken in order with `next`
+  oc8_pool_fn_f fn;
+  void *arg;
+  size_t nb_jobs;
+  size_t next;
+  size_t gen;         // incremented for every batch
+  size_t nb_finished; // number of workers done with the batch
+} oc8_pool_t;
+
+/// Number of CPUs available
+size_t oc8_pool_nb_cpus(void);
+
+/// Start `nb_threads` workers, can be 0
+/// The thread calling `oc8_pool_run` also runs jobs: use
+/// `oc8_pool_nb_cpus() - 1` workers to use all CPUs
+void oc8_pool_init(oc8_pool_t *pool, size_t nb_threads);
+
+/// Stop and join all workers
+void oc8_pool_free(oc8_pool_t *pool);
+
+/// Call `fn(arg, i)` for every i in [0, nb_jobs), in any order and on any
+/// thread, and return once all jobs are done
+/// The pool can be used from many threads, but batches are run one at a time
+void oc8_pool_run(oc8_pool_t *pool, oc8_pool_fn_f fn, void *arg,
+                  size_t nb_jobs);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // !OC8_POOL_OC8_POOL_H_
@@ -16,6 +16,8 @@
 
 #include <stddef.h>
 
+#include "../oc8_arena/oc8_arena.h"
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -23,26 +25,52 @@ extern "C" {
 typedef struct oc8_smap_node oc8_smap_node_t;
 
 struct oc8_smap_node {
-  oc8_smap_node_t *next;
+  oc8_smap_node_t *next; // next node in insertion order
+  oc8_smap_node_t *prev;
+  size_t hash;
   size_t val;
-  char key[];
+  const char *key; // `key_buf`, or the interned key itself
+  char key_buf[];
 };
 
+/// One slot of the hash table
+/// The hash is cached to skip most key comparisons, and to grow the table
+/// without hashing the keys again
+typedef struct {
+  size_t hash;
+  oc8_smap_node_t *node; // NULL if empty or removed
+} oc8_smap_slot_t;
+
 /// Symbol table <string, size_t>
 /// Key is char* (0-terminated)
 /// Val is size_t, but often used to store allocated pointers
 /// The key is allocated and copied on the Node, and doesn't need to be kept
 /// alive by the user
 ///
-/// Implementation based on a linked list
-/// All operations are O(n), with n number of items in the table
+/// Implementation based on a hash table with open addressing (linear
+/// probing), find / insert / remove are O(1) on average
+/// Nodes are allocated in an arena: node and key pointers stay valid until the
+/// table is freed, even if the table grows, or the node is removed
+/// The arena is owned by the table, or given by the caller with
+/// `oc8_smap_init_arena`
+/// A table created with `oc8_smap_init_interned` only has interned keys (see
+/// oc8_strpool.h): they are hashed and compared by pointer, and never copied
 typedef struct {
   oc8_smap_node_t *head;
+  oc8_smap_node_t *tail;
   size_t len;
+
+  oc8_smap_slot_t *slots;
+  size_t slots_size; // power of 2, or 0 before the first insertion
+  size_t slots_used; // nodes + removed slots
+
+  oc8_arena_t *arena; // caller arena for everything, or NULL
+  oc8_arena_t nodes;   // own arena for the nodes, if `arena` is NULL
+  int interned_keys;
 } oc8_smap_t;
 
 /// Iterator to go through all items in the symbol table
-/// The order is unspecified
+/// Items are visited in insertion order
 /// Insert / Remove in the map may invalidate the iterator (UB)
 typedef struct {
   oc8_smap_node_t *node;
@@ -51,6 +79,16 @@ typedef struct {
 /// Initialize a new empty symbol table
 void oc8_smap_init(oc8_smap_t *sm);
 
+/// Initialize a new empty symbol table, allocating all memory from `arena`
+/// `oc8_smap_free` doesn't release anything, the memory is released with the
+/// arena
+void oc8_smap_init_arena(oc8_smap_t *sm, oc8_arena_t *arena);
+
+/// Same as `oc8_smap_init_arena` (`arena` can be NULL), but all keys given to
+/// the table must be interned with `oc8_strpool_intern`
+/// A lookup with a string that isn't interned never finds anything
+void oc8_smap_init_interned(oc8_smap_t *sm, oc8_arena_t *arena);
+
 /// Free and destroy all memory associated with the symbol table
 void oc8_smap_free(oc8_smap_t *sm);
 
@@ -58,6 +96,9 @@ void oc8_smap_free(oc8_smap_t *sm);
 /// Points to first item
 oc8_smap_it_t oc8_smap_get_it(oc8_smap_t *sm);
 
+/// Hash of a string key, as computed by the tables without interned keys
+size_t oc8_smap_hash(const char *key);
+
 /// Look for a key in the symbol table
 /// @returns NULL if not found, or a valid pointer to the node if found
 oc8_smap_node_t *oc8_smap_find(oc8_smap_t *sm, const char *key);
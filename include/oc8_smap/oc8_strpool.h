@@ -0,0 +1,40 @@
+#ifndef OC8_SMAP_OC8_STRPOOL_H_
+#define OC8_SMAP_OC8_STRPOOL_H_
+
+//===--oc8_smap/oc8_strpool.h - Interned strings ------------------*- C -*-===//
+//
+// oc8_smap library
+// Author: Steven Lariau
+//
+//===----------------------------------------------------------------------===//
+///
+/// \file
+/// Process-wide pool of interned strings, used for symbol names
+/// Each distinct string is stored once, so two interned strings are equal
+/// only if their pointers are equal
+/// All functions are thread-safe, the pool is split in shards with their own
+/// lock
+///
+//===----------------------------------------------------------------------===//
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// Returns the interned copy of `str`, and adds it to the pool if needed
+/// The result is valid until the end of the program
+const char *oc8_strpool_intern(const char *str);
+
+/// Returns the interned copy of `str`, or NULL if it isn't in the pool
+const char *oc8_strpool_find(const char *str);
+
+/// Returns the number of strings in the pool
+size_t oc8_strpool_size(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // !OC8_SMAP_OC8_STRPOOL_H_
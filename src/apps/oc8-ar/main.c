@@ -0,0 +1,119 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "args_parser/args_parser.h"
+#include "oc8_bin/archive.h"
+#include "oc8_bin/bin_view.h"
+
+args_parser_option_t opts[3] = {
+    {
+        .name = "output",
+        .id_short = 'o',
+        .id_long = "output",
+        .type = ARGS_PARSER_OTY_VAL,
+        .desc = "Path to output archive file (.c8a)",
+        .required = 0,
+    },
+
+    {
+        .name = "list",
+        .id_short = 'l',
+        .id_long = "list",
+        .type = ARGS_PARSER_OTY_FLAG,
+        .desc = "List the members of the input archives, and their symbols",
+        .required = 0,
+    },
+
+    {
+        .name = "help",
+        .id_short = 'h',
+        .id_long = "help",
+        .type = ARGS_PARSER_OTY_HELP,
+        .desc = "Print an help message an exit",
+    },
+};
+
+args_parser_t ap = {
+    .bin_name = "oc8-ar",
+    .options_arr = opts,
+    .options_size = 3,
+    .have_others = 1,
+};
+
+// Member name: file name, without the directories
+static char *member_name(const char *path) {
+  const char *base = strrchr(path, '/');
+  return strdup(base ? base + 1 : path);
+}
+
+static int list_archive(const char *path) {
+  oc8_bin_archive_t ar;
+  if (oc8_bin_archive_open(&ar, path) != 0) {
+    fprintf(stderr, "oc8-ar: `%s' isn't a valid archive file.\n", path);
+    return 1;
+  }
+
+  for (size_t i = 0; i < ar.nb_members; ++i) {
+    oc8_bin_pack_member_t member;
+    oc8_bin_archive_get(&ar, i, &member);
+    printf("%8zu %s\n", member.size, member.name);
+    for (size_t j = 0; j < ar.nb_syms; ++j)
+      if (ar.syms[j].member == i)
+        printf("         %s\n", ar.names + ar.syms[j].name);
+  }
+  oc8_bin_archive_close(&ar);
+  return 0;
+}
+
+int main(int argc, char **argv) {
+  args_parser_run(&ap, argc, argv);
+  const char *out_path = opts[0].value;
+  int list = opts[1].found;
+  if (!list && !out_path) {
+    fprintf(stderr, "oc8-ar: Missing output file (-o) or list mode (-l).\n");
+    return 1;
+  }
+
+  oc8_bin_map_t *maps = malloc(argc * sizeof(oc8_bin_map_t));
+  oc8_bin_pack_member_t *members = malloc(argc * sizeof(oc8_bin_pack_member_t));
+  size_t nb_inputs = 0;
+  int err = 0;
+
+  // Inputs are all arguments that aren't options, in the archive order
+  for (int i = 1; i < argc && !err; ++i) {
+    const char *in_path = argv[i];
+    if (in_path == out_path || in_path[0] == '-')
+      continue;
+
+    if (list) {
+      err = list_archive(in_path);
+      continue;
+    }
+
+    oc8_bin_map_t *map = &maps[nb_inputs];
+    if (oc8_bin_map_open(map, in_path) != 0) {
+      fprintf(stderr, "oc8-ar: Failed to read file `%s'.\n", in_path);
+      err = 1;
+      break;
+    }
+
+    oc8_bin_pack_member_t *member = &members[nb_inputs++];
+    member->name = member_name(in_path);
+    member->data = map->data;
+    member->size = map->size;
+  }
+
+  if (!list && !err)
+    err = oc8_bin_archive_write_to_file(members, nb_inputs, out_path) != 0;
+
+  for (size_t i = 0; i < nb_inputs; ++i) {
+    free((char *)members[i].name);
+    oc8_bin_map_close(&maps[i]);
+  }
+  free(members);
+  free(maps);
+  return err;
+}
@@ -1,18 +1,21 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
 #include "args_parser/args_parser.h"
 #include "oc8_as/as.h"
-#include "oc8_as/parser.h"
-#include "oc8_as/sfile.h"
-#include "oc8_bin/bin_writer.h"
-#include "oc8_bin/file.h"
+#include "oc8_bin/cache.h"
+#include "oc8_build/client.h"
+#include "oc8_pool/oc8_pool.h"
+#include "oc8_smap/oc8_smap.h"
 
-args_parser_option_t opts[3] = {
+args_parser_option_t opts[8] = {
     {
         .name = "input",
         .type = ARGS_PARSER_OTY_PRIM,
-        .desc = "Path to input text assembly file (.c8s)",
+        .desc = "Path to input text assembly file (.c8s), can be repeated",
         .required = 1,
     },
 
@@ -21,10 +24,52 @@ args_parser_option_t opts[3] = {
         .id_short = 'o',
         .id_long = "output",
         .type = ARGS_PARSER_OTY_VAL,
-        .desc = "Path to output object file (.c8o)",
+        .desc = "Path to output object file (.c8o), only with one input",
+        .required = 0,
+    },
+
+    {
+        .name = "output-dir",
+        .id_short = 'd',
+        .id_long = "output-dir",
+        .type = ARGS_PARSER_OTY_VAL,
+        .desc = "Directory of the output object files",
+        .required = 0,
+    },
+
+    {
+        .name = "jobs",
+        .id_short = 'j',
+        .id_long = "jobs",
+        .type = ARGS_PARSER_OTY_VAL,
+        .desc = "Number of threads (default: nb of CPUs)",
         .required = 0,
     },
 
+    {
+        .name = "cache-dir",
+        .id_short = 'c',
+        .id_long = "cache-dir",
+        .type = ARGS_PARSER_OTY_VAL,
+        .desc = "Directory of cached objects, reused for unchanged sources",
+        .required = 0,
+    },
+
+    {
+        .name = "optimize",
+        .id_short = 'O',
+        .id_long = "optimize",
+        .type = ARGS_PARSER_OTY_FLAG,
+        .desc = "Delete useless instructions, thread jumps and tail calls",
+    },
+
+    {
+        .name = "no-tail-calls",
+        .id_long = "no-tail-calls",
+        .type = ARGS_PARSER_OTY_FLAG,
+        .desc = "With -O, keep `call f` followed by `ret`",
+    },
+
     {
         .name = "help",
         .id_short = 'h',
@@ -37,41 +82,153 @@ args_parser_option_t opts[3] = {
 args_parser_t ap = {
     .bin_name = "oc8-as",
     .options_arr = opts,
-    .options_size = 3,
-    .have_others = 0,
+    .options_size = 8,
+    .have_others = 1,
 };
 
-int main(int argc, char **argv) {
-  char *out_buff = NULL;
+typedef struct {
+  const char *in_path;
+  char *out_path;
+  int err;
+} job_t;
 
-  args_parser_run(&ap, argc, argv);
+static oc8_bin_cache_t *g_cache = NULL;
+static unsigned g_opt_flags = 0;
+
+// Output path: `out_dir` (or the input directory) + input file name, with
+// the extension replaced by .c8o
+static char *gen_out_path(const char *in_path, const char *out_dir) {
+  const char *base = strrchr(in_path, '/');
+  base = base ? base + 1 : in_path;
+  const char *ext = strrchr(base, '.');
+  size_t base_len = ext && ext != base ? (size_t)(ext - base) : strlen(base);
+  size_t dir_len = out_dir ? strlen(out_dir) + 1 : (size_t)(base - in_path);
+
+  char *res = malloc(dir_len + base_len + 5);
+  if (out_dir) {
+    memcpy(res, out_dir, dir_len - 1);
+    res[dir_len - 1] = '/';
+  } else
+    memcpy(res, in_path, dir_len);
+  memcpy(res + dir_len, base, base_len);
+  strcpy(res + dir_len + base_len, ".c8o");
+  return res;
+}
+
+static int is_input(const char *arg) {
+  if (arg[0] == '-')
+    return 0;
+  for (size_t i = 1; i < ap.options_size; ++i)
+    if (opts[i].value == arg)
+      return 0;
+  return 1;
+}
 
-  if (opts[1].value == NULL) { // no output, generate file path
-    size_t len = strlen(opts[0].value);
-    out_buff = malloc(len + 1);
-    memcpy(out_buff, opts[0].value, len + 1);
-    out_buff[len - 1] = 'o'; // turn c8s into c80
-    opts[1].value = out_buff;
+// @returns 0 if the jobs were run by oc8-buildd, with exit code `status`
+static int forward_jobs(job_t *jobs, size_t nb_jobs, const char *cache_dir,
+                        int *status) {
+  size_t nb_strs = 2 * nb_jobs + 1;
+  const char **strs = malloc(nb_strs * sizeof(const char *));
+  strs[0] = cache_dir ? cache_dir : "";
+  for (size_t i = 0; i < nb_jobs; ++i) {
+    strs[1 + 2 * i] = jobs[i].in_path;
+    strs[2 + 2 * i] = jobs[i].out_path;
   }
+  int err = oc8_build_client_forward(OC8_BUILD_REQ_AS, strs, nb_strs, status);
+  free(strs);
+  return err;
+}
+
+static void run_job(void *arg, size_t idx) {
+  job_t *job = &((job_t *)arg)[idx];
+  job->err = oc8_as_assemble_file_opt(job->in_path, job->out_path, NULL,
+                                      g_cache, g_opt_flags);
+}
 
-  const char *in_path = opts[0].value;
+int main(int argc, char **argv) {
+  args_parser_run(&ap, argc, argv);
   const char *out_path = opts[1].value;
+  const char *out_dir = opts[2].value;
+  const char *cache_dir = opts[4].value;
+  size_t nb_threads = opts[3].value ? (size_t)atoi(opts[3].value) : 0;
+  if (!nb_threads)
+    nb_threads = oc8_pool_nb_cpus();
+  if (opts[5].found)
+    g_opt_flags = opts[6].found ? OC8_AS_OPT_ALL & ~OC8_AS_OPT_TAIL_CALLS
+                                : OC8_AS_OPT_ALL;
+
+  oc8_bin_cache_t cache;
+  if (cache_dir) {
+    if (oc8_bin_cache_open(&cache, cache_dir) != 0) {
+      fprintf(stderr, "oc8-as: Cannot use cache directory `%s'.\n",
+              cache_dir);
+      return 1;
+    }
+    g_cache = &cache;
+  }
 
-  // Parse input file
-  oc8_as_sfile_t *sf = oc8_as_parse_file(in_path);
-  oc8_as_sfile_check(sf);
+  job_t *jobs = malloc(argc * sizeof(job_t));
+  size_t nb_jobs = 0;
+  for (int i = 1; i < argc; ++i)
+    if (is_input(argv[i]))
+      jobs[nb_jobs++].in_path = argv[i];
 
-  // Compile input file to binary object
-  oc8_bin_file_t bf;
-  oc8_as_compile_sfile(sf, &bf);
-  oc8_bin_file_check(&bf, /*is_bin=*/0);
+  if (out_path && nb_jobs > 1) {
+    fprintf(stderr, "oc8-as: Cannot use -o with many input files, use -d.\n");
+    free(jobs);
+    if (g_cache)
+      oc8_bin_cache_close(g_cache);
+    return 1;
+  }
+
+  // Two inputs can't have the same output file
+  oc8_smap_t outs;
+  oc8_smap_init(&outs);
+  int err = 0;
+  for (size_t i = 0; i < nb_jobs; ++i) {
+    job_t *job = &jobs[i];
+    job->out_path = out_path ? strdup(out_path)
+                             : gen_out_path(job->in_path, out_dir);
+    job->err = 0;
+    if (oc8_smap_find(&outs, job->out_path)) {
+      fprintf(stderr, "oc8-as: Output file `%s' used by many inputs.\n",
+              job->out_path);
+      err = 1;
+    }
+    oc8_smap_insert(&outs, job->out_path, i);
+  }
+  oc8_smap_free(&outs);
 
-  // Write binary object to file
-  oc8_bin_write_to_file(&bf, out_path);
+  // oc8-buildd only assembles without optimizations
+  int forwarded = !err && !g_opt_flags &&
+                  forward_jobs(jobs, nb_jobs, cache_dir, &err) == 0;
+  if (!err && !forwarded) {
+    // Many files: one job per file, or a single one parsed in chunks
+    oc8_pool_t pool;
+    if (nb_jobs == 1) {
+      oc8_pool_init(&pool, nb_threads - 1);
+      jobs[0].err = oc8_as_assemble_file_opt(
+          jobs[0].in_path, jobs[0].out_path, nb_threads > 1 ? &pool : NULL,
+          g_cache, g_opt_flags);
+    } else {
+      oc8_pool_init(&pool, nb_jobs < nb_threads ? nb_jobs - 1 : nb_threads - 1);
+      oc8_pool_run(&pool, run_job, jobs, nb_jobs);
+    }
+    oc8_pool_free(&pool);
+
+    size_t nb_failed = 0;
+    for (size_t i = 0; i < nb_jobs; ++i)
+      nb_failed += jobs[i].err != 0;
+    if (nb_failed && nb_jobs > 1)
+      fprintf(stderr, "oc8-as: %zu of %zu files failed.\n", nb_failed,
+              nb_jobs);
+    err = nb_failed != 0;
+  }
 
-  // Cleanup data
-  oc8_as_sfile_free(sf);
-  oc8_bin_file_free(&bf);
-  free(out_buff);
-  return 0;
+  for (size_t i = 0; i < nb_jobs; ++i)
+    free(jobs[i].out_path);
+  free(jobs);
+  if (g_cache)
+    oc8_bin_cache_close(g_cache);
+  return err;
 }
@@ -50,8 +50,12 @@ int main(int argc, char **argv) {
 
   // Read and check file
   oc8_bin_file_t bf;
-  oc8_bin_read_from_file(&bf, in_path);
-  oc8_bin_file_check(&bf, /*is_bin=*/1);
+  if (oc8_bin_read_from_file(&bf, in_path) != 0)
+    return 1;
+  if (oc8_bin_file_validate(&bf, /*is_bin=*/1) != 0) {
+    oc8_bin_file_free(&bf);
+    return 1;
+  }
 
   // Write ROM to output file
   FILE *os = fopen(out_path, "wb");
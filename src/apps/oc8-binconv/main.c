@@ -0,0 +1,76 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "args_parser/args_parser.h"
+#include "oc8_bin/bin_reader.h"
+#include "oc8_bin/bin_writer.h"
+#include "oc8_bin/file.h"
+
+args_parser_option_t opts[4] = {
+    {
+        .name = "input",
+        .type = ARGS_PARSER_OTY_PRIM,
+        .desc = "Path to input binary file (.c8o/.c8bin)",
+        .required = 1,
+    },
+
+    {
+        .name = "output",
+        .id_short = 'o',
+        .id_long = "output",
+        .type = ARGS_PARSER_OTY_VAL,
+        .desc = "Path to output binary file (.c8o/.c8bin)",
+        .required = 1,
+    },
+
+    {
+        .name = "version",
+        .id_short = 'v',
+        .id_long = "version",
+        .type = ARGS_PARSER_OTY_VAL,
+        .desc = "Format version of the output file (10 or 11, default 11)",
+        .required = 0,
+    },
+
+    {
+        .name = "help",
+        .id_short = 'h',
+        .id_long = "help",
+        .type = ARGS_PARSER_OTY_HELP,
+        .desc = "Print an help message an exit",
+    },
+};
+
+args_parser_t ap = {
+    .bin_name = "oc8-binconv",
+    .options_arr = opts,
+    .options_size = 4,
+    .have_others = 0,
+};
+
+int main(int argc, char **argv) {
+  args_parser_run(&ap, argc, argv);
+  const char *in_path = opts[0].value;
+  const char *out_path = opts[1].value;
+
+  unsigned version = OC8_BIN_VERSION;
+  if (opts[2].found) {
+    version = (unsigned)atoi(opts[2].value);
+    if (version != OC8_BIN_VERSION_V10 && version != OC8_BIN_VERSION_V11) {
+      fprintf(stderr, "oc8-binconv: Unsupported version `%s'.\n",
+              opts[2].value);
+      return 1;
+    }
+  }
+
+  // Read and check file, then write it with the new version
+  oc8_bin_file_t bf;
+  if (oc8_bin_read_from_file(&bf, in_path) != 0)
+    return 1;
+  int err = oc8_bin_file_validate(&bf, /*is_bin=*/0) != 0 ||
+            oc8_bin_file_set_version(&bf, (uint16_t)version) != 0 ||
+            oc8_bin_write_to_file(&bf, out_path) != 0;
+
+  oc8_bin_file_free(&bf);
+  return err;
+}
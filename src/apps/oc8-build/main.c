@@ -0,0 +1,102 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "args_parser/args_parser.h"
+#include "oc8_bin/bin_view.h"
+#include "oc8_bin/bin_writer.h"
+#include "oc8_bin/cache.h"
+#include "oc8_build/driver.h"
+
+args_parser_option_t opts[4] = {
+    {
+        .name = "output",
+        .id_short = 'o',
+        .id_long = "output",
+        .type = ARGS_PARSER_OTY_VAL,
+        .desc = "Path to output binary file (.c8bin), or ROM with --rom",
+        .required = 1,
+    },
+
+    {
+        .name = "rom",
+        .id_short = 'r',
+        .id_long = "rom",
+        .type = ARGS_PARSER_OTY_FLAG,
+        .desc = "Write a raw CHIP-8 ROM, same as oc8-bin2rom",
+    },
+
+    {
+        .name = "input",
+        .type = ARGS_PARSER_OTY_PRIM,
+        .desc = "Paths to input text assembly files (.c8s)",
+        .required = 1,
+    },
+
+    {
+        .name = "help",
+        .id_short = 'h',
+        .id_long = "help",
+        .type = ARGS_PARSER_OTY_HELP,
+        .desc = "Print an help message an exit",
+    },
+};
+
+args_parser_t ap = {
+    .bin_name = "oc8-build",
+    .options_arr = opts,
+    .options_size = 4,
+    .have_others = 1,
+};
+
+static int is_input(const char *arg) {
+  if (arg[0] == '-')
+    return 0;
+  for (size_t i = 0; i < ap.options_size; ++i)
+    if (opts[i].value == arg && opts[i].type != ARGS_PARSER_OTY_PRIM)
+      return 0;
+  return 1;
+}
+
+int main(int argc, char **argv) {
+  args_parser_run(&ap, argc, argv);
+  const char *out_path = opts[0].value;
+
+  // Sources are mapped, and everything else stays in memory
+  oc8_bin_map_t *maps = calloc(argc, sizeof(oc8_bin_map_t));
+  oc8_build_src_t *srcs = malloc(argc * sizeof(oc8_build_src_t));
+  size_t nb_srcs = 0;
+  int err = 0;
+  for (int i = 1; i < argc && !err; ++i) {
+    if (!is_input(argv[i]))
+      continue;
+    if (oc8_bin_map_open(&maps[nb_srcs], argv[i]) != 0) {
+      fprintf(stderr, "oc8-build: Failed to read file `%s'.\n", argv[i]);
+      err = 1;
+      break;
+    }
+    srcs[nb_srcs].name = argv[i];
+    srcs[nb_srcs].data = (const char *)maps[nb_srcs].data;
+    srcs[nb_srcs].len = maps[nb_srcs].size;
+    ++nb_srcs;
+  }
+
+  oc8_arena_t arena;
+  oc8_arena_init(&arena, 0);
+  oc8_bin_file_t bf;
+  if (!err)
+    err = oc8_build_link_sources(srcs, nb_srcs, &bf, &arena) != 0;
+  if (!err && opts[1].found) {
+    if (oc8_bin_write_file_atomic(out_path, bf.rom, bf.rom_size, 0644) != 0) {
+      fprintf(stderr, "oc8-build: Failed to write file `%s'.\n", out_path);
+      err = 1;
+    }
+  } else if (!err)
+    err = oc8_bin_write_to_file(&bf, out_path) != 0;
+
+  oc8_arena_free(&arena);
+  for (size_t i = 0; i < nb_srcs; ++i)
+    oc8_bin_map_close(&maps[i]);
+  free(maps);
+  free(srcs);
+  return err;
+}
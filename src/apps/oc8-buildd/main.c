@@ -0,0 +1,88 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "args_parser/args_parser.h"
+#include "oc8_build/client.h"
+#include "oc8_build/server.h"
+
+args_parser_option_t opts[4] = {
+    {
+        .name = "socket",
+        .id_short = 's',
+        .id_long = "socket",
+        .type = ARGS_PARSER_OTY_VAL,
+        .desc = "Path to the Unix socket (default: $OC8_BUILDD_SOCKET, or "
+                "/tmp/oc8-buildd-<uid>.sock)",
+        .required = 0,
+    },
+
+    {
+        .name = "jobs",
+        .id_short = 'j',
+        .id_long = "jobs",
+        .type = ARGS_PARSER_OTY_VAL,
+        .desc = "Number of threads (default: nb of CPUs)",
+        .required = 0,
+    },
+
+    {
+        .name = "stop",
+        .id_long = "stop",
+        .type = ARGS_PARSER_OTY_FLAG,
+        .desc = "Stop the running server",
+    },
+
+    {
+        .name = "help",
+        .id_short = 'h',
+        .id_long = "help",
+        .type = ARGS_PARSER_OTY_HELP,
+        .desc = "Print an help message an exit",
+    },
+};
+
+args_parser_t ap = {
+    .bin_name = "oc8-buildd",
+    .options_arr = opts,
+    .options_size = 4,
+    .have_others = 0,
+};
+
+int main(int argc, char **argv) {
+  args_parser_run(&ap, argc, argv);
+  char *socket_path =
+      opts[0].value ? strdup(opts[0].value) : oc8_build_socket_path();
+  size_t nb_threads = opts[1].value ? (size_t)atoi(opts[1].value) : 0;
+  if (!socket_path) {
+    fprintf(stderr, "oc8-buildd: Disabled by empty $OC8_BUILDD_SOCKET.\n");
+    return 1;
+  }
+
+  if (opts[2].found) {
+    int status;
+    int err = oc8_build_client_send(socket_path, OC8_BUILD_REQ_STOP, NULL, 0,
+                                    &status);
+    if (err)
+      fprintf(stderr, "oc8-buildd: No server running on `%s'.\n",
+              socket_path);
+    free(socket_path);
+    return err != 0;
+  }
+
+  // A client that exits early must not stop the server
+  signal(SIGPIPE, SIG_IGN);
+
+  oc8_build_server_t server;
+  if (oc8_build_server_init(&server, socket_path, nb_threads) != 0) {
+    free(socket_path);
+    return 1;
+  }
+  free(socket_path);
+  oc8_build_server_run(&server);
+  oc8_build_server_free(&server);
+  return 0;
+}
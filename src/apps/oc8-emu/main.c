@@ -5,9 +5,44 @@
 #include <stdio.h>
 #include <stdlib.h>
 
+#include "args_parser/args_parser.h"
 #include "oc8_emu/oc8_emu.h"
 #include "sdl-env.h"
 
+args_parser_option_t opts[3] = {
+    {
+        .name = "input",
+        .type = ARGS_PARSER_OTY_PRIM,
+        .desc = "Path to CHIP-8 ROM or binary file (.c8bin)",
+        .required = 1,
+    },
+
+    {
+        .name = "metrics",
+        .id_short = 'm',
+        .id_long = "metrics",
+        .type = ARGS_PARSER_OTY_VAL,
+        .desc = "Serve metrics in Prometheus format on a localhost port, or "
+                "on a Unix socket with unix:<path>",
+        .required = 0,
+    },
+
+    {
+        .name = "help",
+        .id_short = 'h',
+        .id_long = "help",
+        .type = ARGS_PARSER_OTY_HELP,
+        .desc = "Print an help message an exit",
+    },
+};
+
+args_parser_t ap = {
+    .bin_name = "oc8-emu",
+    .options_arr = opts,
+    .options_size = 3,
+    .have_others = 0,
+};
+
 uint8_t *img_buf;
 
 static const size_t keypad_map[OC8_EMU_NB_KEYS] = {
@@ -25,18 +60,20 @@ static void load_image() {
       img_buf[3 * OC8_EMU_SCREEN_WIDTH * y + 3 * x + 2] = val;
     }
   }
-
-  sdl_env_render();
 }
 
 int main(int argc, char **argv) {
-  if (argc < 2) {
-    fprintf(stderr, "Usage: ./oc8-emu <file>\n");
-    return 1;
-  }
+  args_parser_run(&ap, argc, argv);
 
   oc8_emu_init();
-  oc8_emu_load_rom_file(argv[1]);
+  oc8_emu_load_rom_file(opts[0].value);
+
+  oc8_emu_metrics_server_t metrics_srv = {.fd = -1};
+  if (opts[1].value &&
+      oc8_emu_metrics_server_open(&metrics_srv, &g_oc8_emu_metrics,
+                                  opts[1].value) != 0)
+    return 1;
+
   sdl_env_init("oc8-emu", 640, 320);
   img_buf = (uint8_t *)malloc(OC8_EMU_SCREEN_HEIGHT * OC8_EMU_SCREEN_WIDTH * 3);
   sdl_env_set_image(img_buf, OC8_EMU_SCREEN_WIDTH, OC8_EMU_SCREEN_HEIGHT);
@@ -44,19 +81,28 @@ int main(int argc, char **argv) {
 
   for (;;) {
     // Run one cycle
+    uint64_t last_tick = g_oc8_emu_cpu.timer_last_update;
     oc8_emu_cpu_cycle();
     if (g_oc8_emu_cpu.screen_changed)
       load_image();
 
+    // Present a new frame when the screen changed, and at every timer tick
+    int present = g_oc8_emu_cpu.screen_changed ||
+                  g_oc8_emu_cpu.timer_last_update != last_tick;
+
     // Run GUI loop
-    if (sdl_env_update() != 0)
+    if (sdl_env_update(present) != 0)
       break;
+    if (present)
+      oc8_emu_metrics_frame(&g_oc8_emu_metrics);
+    oc8_emu_metrics_server_poll(&metrics_srv);
 
     // Update key states
     for (int i = 0; i < OC8_EMU_NB_KEYS; ++i)
       g_oc8_emu_keypad[i] = sdl_env_keystate(keypad_map[i]) != 0;
   }
 
+  oc8_emu_metrics_server_close(&metrics_srv);
   sdl_env_exit();
   free(img_buf);
   return 0;
@@ -41,7 +41,7 @@ void sdl_env_exit() {
   SDL_Quit();
 }
 
-int sdl_env_update() {
+int sdl_env_update(int render) {
   int quit = 0;
 
   SDL_Event e;
@@ -62,7 +62,8 @@ int sdl_env_update() {
     }
   }
 
-  sdl_env_render();
+  if (render)
+    sdl_env_render();
 
   return quit;
 }
@@ -44,9 +44,9 @@ void sdl_env_init(const char *win_title, int win_width, int win_height);
 /// Close the window and release all the ressources
 void sdl_env_exit();
 
-/// Handle GUI events and redraw graphics
+/// Handle GUI events, and redraw graphics if `render` != 0
 /// @returns a value != 0 if the user want to close the window
-int sdl_env_update();
+int sdl_env_update(int render);
 
 /// Only render display, doesn't handle other events
 void sdl_env_render();
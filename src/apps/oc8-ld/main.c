@@ -2,14 +2,13 @@
 #include <stdlib.h>
 
 #include "args_parser/args_parser.h"
-#include "oc8_bin/bin_reader.h"
-#include "oc8_bin/bin_writer.h"
-#include "oc8_bin/file.h"
-#include "oc8_ld/linker.h"
+#include "oc8_bin/cache.h"
+#include "oc8_build/client.h"
+#include "oc8_ld/incremental.h"
+#include "oc8_ld/lto.h"
+#include "oc8_pool/oc8_pool.h"
 
-#define MAX_IN_FILES 64
-
-args_parser_option_t opts[2] = {
+args_parser_option_t opts[9] = {
     {
         .name = "output",
         .id_short = 'o',
@@ -19,6 +18,62 @@ args_parser_option_t opts[2] = {
         .required = 1,
     },
 
+    {
+        .name = "cache-dir",
+        .id_short = 'c',
+        .id_long = "cache-dir",
+        .type = ARGS_PARSER_OTY_VAL,
+        .desc = "Directory of cached binaries, relinks only changed objects",
+        .required = 0,
+    },
+
+    {
+        .name = "jobs",
+        .id_short = 'j',
+        .id_long = "jobs",
+        .type = ARGS_PARSER_OTY_VAL,
+        .desc = "Number of threads (default: nb of CPUs)",
+        .required = 0,
+    },
+
+    {
+        .name = "gc-sections",
+        .id_long = "gc-sections",
+        .type = ARGS_PARSER_OTY_FLAG,
+        .desc = "Remove the functions and objects not used by _start",
+    },
+
+    {
+        .name = "icf",
+        .id_long = "icf",
+        .type = ARGS_PARSER_OTY_FLAG,
+        .desc = "Fold the identical functions and objects",
+    },
+
+    {
+        .name = "lto",
+        .id_long = "lto",
+        .type = ARGS_PARSER_OTY_FLAG,
+        .desc = "Inline the small leaf functions at their call sites",
+    },
+
+    {
+        .name = "lto-size",
+        .id_long = "lto-size",
+        .type = ARGS_PARSER_OTY_VAL,
+        .desc = "Max size in bytes of the functions inlined (default: 6)",
+        .required = 0,
+    },
+
+    {
+        .name = "map",
+        .id_short = 'M',
+        .id_long = "map",
+        .type = ARGS_PARSER_OTY_VAL,
+        .desc = "Path to output map file: address and size of every symbol",
+        .required = 0,
+    },
+
     {
         .name = "help",
         .id_short = 'h',
@@ -31,53 +86,88 @@ args_parser_option_t opts[2] = {
 args_parser_t ap = {
     .bin_name = "oc8-ld",
     .options_arr = opts,
-    .options_size = 2,
+    .options_size = 9,
     .have_others = 1,
 };
 
+static int is_input(const char *arg) {
+  if (arg[0] == '-')
+    return 0;
+  for (size_t i = 0; i < ap.options_size; ++i)
+    if (opts[i].value == arg)
+      return 0;
+  return 1;
+}
+
 int main(int argc, char **argv) {
   args_parser_run(&ap, argc, argv);
   const char *out_path = opts[0].value;
+  const char *cache_dir = opts[1].value;
+  size_t nb_threads = opts[2].value ? (size_t)atoi(opts[2].value) : 0;
+  int use_gc = opts[3].found;
+  int use_icf = opts[4].found;
+  uint16_t lto_max_size = 0;
+  if (opts[5].found)
+    lto_max_size = opts[6].value ? (uint16_t)atoi(opts[6].value)
+                                 : OC8_LD_LTO_DEFAULT_MAX_SIZE;
+  const char *map_path = opts[7].value;
+  if (!nb_threads)
+    nb_threads = oc8_pool_nb_cpus();
+
+  oc8_bin_cache_t cache;
+  if (cache_dir && oc8_bin_cache_open(&cache, cache_dir) != 0) {
+    fprintf(stderr, "oc8-ld: Cannot use cache directory `%s'.\n", cache_dir);
+    return 1;
+  }
+  FILE *map_os = map_path ? fopen(map_path, "w") : NULL;
+  if (map_path && !map_os) {
+    fprintf(stderr, "oc8-ld: Failed to write file `%s'.\n", map_path);
+    if (cache_dir)
+      oc8_bin_cache_close(&cache);
+    return 1;
+  }
+
+  // Find all input object files, after the cache and output paths sent to
+  // oc8-buildd
+  const char **strs = malloc((argc + 2) * sizeof(const char *));
+  const char **in_paths = strs + 2;
   size_t nb_inputs = 0;
+  strs[0] = cache_dir ? cache_dir : "";
+  strs[1] = out_path;
+  for (int i = 1; i < argc; ++i)
+    if (is_input(argv[i]))
+      in_paths[nb_inputs++] = argv[i];
 
-  oc8_ld_linker_t ld;
-  oc8_bin_file_t in_objs[MAX_IN_FILES];
-  oc8_ld_linker_init(&ld, 1);
-
-  // Find and add all input object files
-  for (int i = 1; i < argc; ++i) {
-    if (argv[i] == out_path || (i + 1 < argc && argv[i + 1] == out_path))
-      continue;
-
-    oc8_bin_file_t *obj = &in_objs[nb_inputs++];
-    if (nb_inputs > MAX_IN_FILES) {
-      fprintf(stderr, "oc8-ld: Cannot have more than %d input files.\n",
-              MAX_IN_FILES);
-      return 1;
-    }
-
-    const char *in_path = argv[i];
-    oc8_bin_read_from_file(obj, in_path);
-    oc8_bin_file_check(obj, /*is_bin=*/0);
-    if (obj->header.type != OC8_BIN_FILE_TYPE_OBJ) {
-      fprintf(stderr, "oc8-ld: Input file `%s' must be of type object.\n",
-              in_path);
-      return 1;
-    }
-
-    oc8_ld_linker_add(&ld, obj);
+  // oc8-buildd only links with the default options
+  int err;
+  if (use_gc || use_icf || lto_max_size || map_os ||
+      oc8_build_client_forward(OC8_BUILD_REQ_LD, strs, nb_inputs + 2, &err)) {
+    oc8_pool_t pool;
+    oc8_pool_init(&pool, nb_threads - 1);
+    oc8_ld_link_opts_t link_opts = {
+        .pool = nb_threads > 1 ? &pool : NULL,
+        .cache = cache_dir ? &cache : NULL,
+        .use_gc = use_gc,
+        .use_icf = use_icf,
+        .lto_max_size = lto_max_size,
+        .report = use_icf || lto_max_size ? stdout : NULL,
+        .map = map_os,
+    };
+    oc8_ld_link_res_t res;
+    err = oc8_ld_link_files(in_paths, nb_inputs, out_path, &link_opts, &res);
+    oc8_pool_free(&pool);
+    if (!err && res.in_rom_size < res.out_rom_size)
+      printf("oc8-ld: added %zu bytes, ROM size is %zu bytes.\n",
+             res.out_rom_size - res.in_rom_size, res.out_rom_size + 2);
+    else if (!err && (use_gc || use_icf || lto_max_size))
+      printf("oc8-ld: reclaimed %zu bytes, ROM size is %zu bytes.\n",
+             res.in_rom_size - res.out_rom_size, res.out_rom_size + 2);
   }
 
-  // Link all files in one binary, and save it
-  oc8_bin_file_t bf;
-  oc8_ld_linker_link(&ld, &bf);
-  oc8_bin_file_check(&bf, /*is_bin=*/1);
-  oc8_bin_write_to_file(&bf, out_path);
-
-  // Cleanup
-  for (size_t i = 0; i < nb_inputs; ++i)
-    oc8_bin_file_free(&in_objs[i]);
-  oc8_bin_file_free(&bf);
-  oc8_ld_linker_free(&ld);
-  return 0;
+  free(strs);
+  if (map_os && fclose(map_os) != 0)
+    err = 1;
+  if (cache_dir)
+    oc8_bin_cache_close(&cache);
+  return err != 0;
 }
@@ -3,6 +3,7 @@
 
 #include "args_parser/args_parser.h"
 #include "oc8_bin/bin_reader.h"
+#include "oc8_bin/bin_view.h"
 #include "oc8_bin/file.h"
 #include "oc8_bin/printer.h"
 #include "oc8_defs/oc8_defs.h"
@@ -44,10 +45,21 @@ int main(int argc, char **argv) {
   args_parser_run(&ap, argc, argv);
   const char *in_path = opts[0].value;
 
-  // Read and check file
+  // Read and check file, that can be a pack member
+  oc8_bin_map_t map;
+  if (oc8_bin_map_open_member(&map, in_path) != 0) {
+    fprintf(stderr, "oc8-objdump: Failed to read file `%s'.\n", in_path);
+    return 1;
+  }
   oc8_bin_file_t bf;
-  oc8_bin_read_from_file(&bf, in_path);
-  oc8_bin_file_check(&bf, /*is_bin=*/0);
+  int err = oc8_bin_read_file_raw(&bf, map.data, map.size);
+  oc8_bin_map_close(&map);
+  if (err)
+    return 1;
+  if (oc8_bin_file_validate(&bf, /*is_bin=*/0) != 0) {
+    oc8_bin_file_free(&bf);
+    return 1;
+  }
 
   oc8_bin_printer_t printer;
   oc8_bin_printer_init(&printer, &bf);
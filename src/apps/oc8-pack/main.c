@@ -0,0 +1,126 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "args_parser/args_parser.h"
+#include "oc8_bin/bin_view.h"
+#include "oc8_bin/pack.h"
+
+args_parser_option_t opts[3] = {
+    {
+        .name = "output",
+        .id_short = 'o',
+        .id_long = "output",
+        .type = ARGS_PARSER_OTY_VAL,
+        .desc = "Path to output pack file (.c8pk)",
+        .required = 0,
+    },
+
+    {
+        .name = "list",
+        .id_short = 'l',
+        .id_long = "list",
+        .type = ARGS_PARSER_OTY_FLAG,
+        .desc = "List the members of the input pack files",
+        .required = 0,
+    },
+
+    {
+        .name = "help",
+        .id_short = 'h',
+        .id_long = "help",
+        .type = ARGS_PARSER_OTY_HELP,
+        .desc = "Print an help message an exit",
+    },
+};
+
+args_parser_t ap = {
+    .bin_name = "oc8-pack",
+    .options_arr = opts,
+    .options_size = 3,
+    .have_others = 1,
+};
+
+// Member name: file name without its extension, or the member name if the
+// input is itself a pack member
+static char *member_name(const char *path) {
+  const char *member = oc8_bin_pack_split_path(path);
+  if (member)
+    return strdup(member);
+
+  const char *base = strrchr(path, '/');
+  base = base ? base + 1 : path;
+  char *res = strdup(base);
+  char *ext = strrchr(res, '.');
+  if (ext && ext != res)
+    *ext = '\0';
+  return res;
+}
+
+static int list_pack(const char *path) {
+  oc8_bin_pack_t pack;
+  if (oc8_bin_pack_open(&pack, path) != 0) {
+    fprintf(stderr, "oc8-pack: `%s' isn't a valid pack file.\n", path);
+    return 1;
+  }
+
+  for (size_t i = 0; i < pack.nb_members; ++i) {
+    oc8_bin_pack_member_t member;
+    oc8_bin_pack_get(&pack, i, &member);
+    printf("%8zu %s\n", member.size, member.name);
+  }
+  oc8_bin_pack_close(&pack);
+  return 0;
+}
+
+int main(int argc, char **argv) {
+  args_parser_run(&ap, argc, argv);
+  const char *out_path = opts[0].value;
+  int list = opts[1].found;
+  if (!list && !out_path) {
+    fprintf(stderr, "oc8-pack: Missing output file (-o) or list mode (-l).\n");
+    return 1;
+  }
+
+  oc8_bin_map_t *maps = malloc(argc * sizeof(oc8_bin_map_t));
+  oc8_bin_pack_member_t *members = malloc(argc * sizeof(oc8_bin_pack_member_t));
+  size_t nb_inputs = 0;
+  int err = 0;
+
+  // Inputs are all arguments that aren't options
+  for (int i = 1; i < argc && !err; ++i) {
+    const char *in_path = argv[i];
+    if (in_path == out_path || in_path[0] == '-')
+      continue;
+
+    if (list) {
+      err = list_pack(in_path);
+      continue;
+    }
+
+    oc8_bin_map_t *map = &maps[nb_inputs];
+    if (oc8_bin_map_open(map, in_path) != 0) {
+      fprintf(stderr, "oc8-pack: Failed to read file `%s'.\n", in_path);
+      err = 1;
+      break;
+    }
+
+    oc8_bin_pack_member_t *member = &members[nb_inputs++];
+    member->name = member_name(in_path);
+    member->data = map->data;
+    member->size = map->size;
+  }
+
+  if (!list && !err)
+    err = oc8_bin_pack_write_to_file(members, nb_inputs, out_path) != 0;
+
+  for (size_t i = 0; i < nb_inputs; ++i) {
+    free((char *)members[i].name);
+    oc8_bin_map_close(&maps[i]);
+  }
+  free(members);
+  free(maps);
+  return err;
+}
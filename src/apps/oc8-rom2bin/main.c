@@ -63,16 +63,18 @@ int main(int argc, char **argv) {
   char *rom_data = malloc(rom_size);
   if (fread(rom_data, 1, rom_size, is) != rom_size)
     io_err(in_path);
+  fclose(is);
 
   // Build and save bin object
   oc8_bin_file_t bf;
-  oc8_bin_file_init_binary_rom(&bf, rom_data, rom_size);
-  oc8_bin_file_check(&bf, /*is_bin=*/1);
-  oc8_bin_write_to_file(&bf, out_path);
+  int err = oc8_bin_file_init_binary_rom(&bf, rom_data, rom_size) != 0;
+  free(rom_data);
+  if (err)
+    return 1;
+  err = oc8_bin_file_validate(&bf, /*is_bin=*/1) != 0 ||
+        oc8_bin_write_to_file(&bf, out_path) != 0;
 
   // Cleanup files
   oc8_bin_file_free(&bf);
-  fclose(is);
-  free(rom_data);
-  return 0;
+  return err;
 }
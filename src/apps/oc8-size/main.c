@@ -0,0 +1,144 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "args_parser/args_parser.h"
+#include "oc8_bin/bin_reader.h"
+#include "oc8_bin/file.h"
+#include "oc8_bin/size.h"
+
+args_parser_option_t opts[3] = {
+    {
+        .name = "sort",
+        .id_short = 's',
+        .id_long = "sort",
+        .type = ARGS_PARSER_OTY_VAL,
+        .desc = "Sort symbols by size (default), name, or addr",
+        .required = 0,
+    },
+
+    {
+        .name = "all",
+        .id_short = 'a',
+        .id_long = "all",
+        .type = ARGS_PARSER_OTY_FLAG,
+        .desc = "Also list the local labels without a type",
+        .required = 0,
+    },
+
+    {
+        .name = "help",
+        .id_short = 'h',
+        .id_long = "help",
+        .type = ARGS_PARSER_OTY_HELP,
+        .desc = "Print an help message an exit",
+    },
+};
+
+args_parser_t ap = {
+    .bin_name = "oc8-size",
+    .options_arr = opts,
+    .options_size = 3,
+    .have_others = 1,
+};
+
+typedef enum {
+  SORT_SIZE,
+  SORT_NAME,
+  SORT_ADDR,
+} sort_t;
+
+static int cmp_name(const void *a, const void *b) {
+  const oc8_bin_sym_size_t *x = (const oc8_bin_sym_size_t *)a;
+  const oc8_bin_sym_size_t *y = (const oc8_bin_sym_size_t *)b;
+  return strcmp(x->def->name, y->def->name);
+}
+
+// Biggest first, ties by name: the order doesn't depend on addresses
+static int cmp_size(const void *a, const void *b) {
+  const oc8_bin_sym_size_t *x = (const oc8_bin_sym_size_t *)a;
+  const oc8_bin_sym_size_t *y = (const oc8_bin_sym_size_t *)b;
+  if (x->size != y->size)
+    return x->size > y->size ? -1 : 1;
+  return cmp_name(a, b);
+}
+
+static const char *type_name(oc8_bin_sym_type_t type) {
+  switch (type) {
+  case OC8_BIN_SYM_TYPE_FUN:
+    return "function";
+  case OC8_BIN_SYM_TYPE_OBJ:
+    return "object";
+  default:
+    return "-";
+  }
+}
+
+// @returns the ROM size of the file
+static size_t print_sizes(const char *path, sort_t sort, int all) {
+  oc8_bin_file_t bf;
+  if (oc8_bin_read_from_file(&bf, path) != 0)
+    exit(1);
+  if (oc8_bin_file_validate(&bf, /*is_bin=*/0) != 0)
+    exit(1);
+
+  if (bf.header.type == OC8_BIN_FILE_TYPE_BIN)
+    printf("%s: %zu bytes, %zu bytes free\n", path, (size_t)bf.rom_size,
+           (size_t)OC8_BIN_ROM_MAX_SIZE - bf.rom_size);
+  else
+    printf("%s: %zu bytes\n", path, (size_t)bf.rom_size);
+
+  oc8_bin_sym_size_t *syms =
+      malloc((bf.syms_defs_size + 1) * sizeof(oc8_bin_sym_size_t));
+  size_t nb_syms = oc8_bin_get_sym_sizes(&bf, syms);
+  if (sort != SORT_ADDR)
+    qsort(syms, nb_syms, sizeof(oc8_bin_sym_size_t),
+          sort == SORT_SIZE ? cmp_size : cmp_name);
+
+  // Estimated sizes are prefixed by `~`
+  for (size_t i = 0; i < nb_syms; ++i) {
+    const oc8_bin_sym_def_t *def = syms[i].def;
+    if (!all && !def->is_global && def->type == OC8_BIN_SYM_TYPE_NO)
+      continue;
+    char size[8];
+    snprintf(size, sizeof(size), "%s%u", syms[i].is_estimated ? "~" : "",
+             (unsigned)syms[i].size);
+    printf("  %6s  %-8s  %s\n", size, type_name(def->type), def->name);
+  }
+
+  size_t res = bf.rom_size;
+  free(syms);
+  oc8_bin_file_free(&bf);
+  return res;
+}
+
+int main(int argc, char **argv) {
+  args_parser_run(&ap, argc, argv);
+  const char *sort_str = opts[0].value;
+  int all = opts[1].found;
+  sort_t sort = SORT_SIZE;
+  if (sort_str && strcmp(sort_str, "name") == 0)
+    sort = SORT_NAME;
+  else if (sort_str && strcmp(sort_str, "addr") == 0)
+    sort = SORT_ADDR;
+  else if (sort_str && strcmp(sort_str, "size") != 0) {
+    fprintf(stderr, "oc8-size: Invalid sort `%s'.\n", sort_str);
+    return 1;
+  }
+
+  // Inputs are all arguments that aren't options
+  size_t total = 0;
+  size_t nb_inputs = 0;
+  for (int i = 1; i < argc; ++i) {
+    const char *in_path = argv[i];
+    if (in_path == sort_str || in_path[0] == '-')
+      continue;
+    if (nb_inputs++)
+      printf("\n");
+    total += print_sizes(in_path, sort, all);
+  }
+
+  if (nb_inputs > 1)
+    printf("\ntotal: %zu bytes\n", total);
+  return 0;
+}
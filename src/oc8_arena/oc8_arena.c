@@ -0,0 +1,103 @@
+#include "oc8_arena/oc8_arena.h"
+#include <stdlib.h>
+#include <string.h>
+
+// Alignment of all allocations, enough for any type used in the toolchain
+#define ALIGN (2 * sizeof(void *))
+
+struct oc8_arena_chunk {
+  oc8_arena_chunk_t *next;
+  size_t used;
+  size_t size;
+  size_t last; // offset of the last allocation
+  // Data starts after the header, rounded to ALIGN
+};
+
+static size_t align_up(size_t size) {
+  return (size + ALIGN - 1) & ~(ALIGN - 1);
+}
+
+static char *chunk_data(oc8_arena_chunk_t *chunk) {
+  return (char *)chunk + align_up(sizeof(oc8_arena_chunk_t));
+}
+
+void oc8_arena_init(oc8_arena_t *arena, size_t chunk_size) {
+  arena->chunks = NULL;
+  arena->chunk_size = chunk_size;
+  arena->nb_chunks = 0;
+  arena->nb_bytes = 0;
+}
+
+void oc8_arena_free(oc8_arena_t *arena) {
+  oc8_arena_chunk_t *chunk = arena->chunks;
+  while (chunk) {
+    oc8_arena_chunk_t *next = chunk->next;
+    free(chunk);
+    chunk = next;
+  }
+  oc8_arena_init(arena, arena->chunk_size);
+}
+
+void *oc8_arena_alloc(oc8_arena_t *arena, size_t size) {
+  if (!arena)
+    return malloc(size ? size : 1);
+
+  size = align_up(size ? size : 1);
+  oc8_arena_chunk_t *chunk = arena->chunks;
+  if (!chunk || chunk->size - chunk->used < size) {
+    size_t chunk_size =
+        arena->chunk_size ? arena->chunk_size : OC8_ARENA_CHUNK_SIZE;
+    int is_big = size > chunk_size;
+    if (is_big)
+      chunk_size = size;
+    chunk = malloc(align_up(sizeof(oc8_arena_chunk_t)) + chunk_size);
+    chunk->used = 0;
+    chunk->size = chunk_size;
+
+    // A big allocation gets its own chunk, and the current one is kept for
+    // the next allocations
+    if (is_big && arena->chunks) {
+      chunk->next = arena->chunks->next;
+      arena->chunks->next = chunk;
+    } else {
+      chunk->next = arena->chunks;
+      arena->chunks = chunk;
+    }
+    ++arena->nb_chunks;
+  }
+
+  chunk->last = chunk->used;
+  chunk->used += size;
+  arena->nb_bytes += size;
+  return chunk_data(chunk) + chunk->last;
+}
+
+void *oc8_arena_realloc(oc8_arena_t *arena, void *ptr, size_t old_size,
+                        size_t size) {
+  if (!arena)
+    return realloc(ptr, size ? size : 1);
+  if (!ptr)
+    return oc8_arena_alloc(arena, size);
+
+  // Grow or shrink in place if it's the last allocation of the current chunk
+  oc8_arena_chunk_t *chunk = arena->chunks;
+  size_t new_used = chunk->last + align_up(size ? size : 1);
+  if ((char *)ptr == chunk_data(chunk) + chunk->last &&
+      new_used <= chunk->size) {
+    if (new_used >= chunk->used)
+      arena->nb_bytes += new_used - chunk->used;
+    else
+      arena->nb_bytes -= chunk->used - new_used;
+    chunk->used = new_used;
+    return ptr;
+  }
+
+  void *res = oc8_arena_alloc(arena, size);
+  memcpy(res, ptr, old_size < size ? old_size : size);
+  return res;
+}
+
+void oc8_arena_release(oc8_arena_t *arena, void *ptr) {
+  if (!arena)
+    free(ptr);
+}
@@ -0,0 +1,90 @@
+#include <catch2/catch.hpp>
+
+#include "oc8_arena/oc8_arena.h"
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+TEST_CASE("oc8_arena alloc", "") {
+  oc8_arena_t arena;
+  oc8_arena_init(&arena, 1024);
+  std::vector<char *> ptrs;
+  for (int i = 0; i < 100; ++i) {
+    char *ptr = (char *)oc8_arena_alloc(&arena, 1 + i % 40);
+    REQUIRE((uintptr_t)ptr % (2 * sizeof(void *)) == 0);
+    std::memset(ptr, i, 1 + i % 40);
+    ptrs.push_back(ptr);
+  }
+  for (int i = 0; i < 100; ++i)
+    for (int j = 0; j < 1 + i % 40; ++j)
+      REQUIRE(ptrs[i][j] == (char)i);
+
+  REQUIRE(arena.nb_chunks > 1);
+  REQUIRE(arena.nb_chunks < 10);
+  oc8_arena_free(&arena);
+  REQUIRE(arena.nb_chunks == 0);
+  REQUIRE(arena.chunks == nullptr);
+}
+
+TEST_CASE("oc8_arena big alloc", "") {
+  oc8_arena_t arena;
+  oc8_arena_init(&arena, 256);
+  char *a = (char *)oc8_arena_alloc(&arena, 16);
+  char *big = (char *)oc8_arena_alloc(&arena, 4096);
+  std::memset(big, 1, 4096);
+  REQUIRE(arena.nb_chunks == 2);
+
+  // The first chunk is still used after the big allocation
+  char *b = (char *)oc8_arena_alloc(&arena, 16);
+  REQUIRE(b == a + 16);
+  REQUIRE(arena.nb_chunks == 2);
+  oc8_arena_free(&arena);
+}
+
+TEST_CASE("oc8_arena realloc", "") {
+  oc8_arena_t arena;
+  oc8_arena_init(&arena, 1024);
+
+  // The last allocation grows in place
+  int *arr = (int *)oc8_arena_alloc(&arena, 4 * sizeof(int));
+  for (int i = 0; i < 4; ++i)
+    arr[i] = i;
+  int *arr2 = (int *)oc8_arena_realloc(&arena, arr, 4 * sizeof(int),
+                                       64 * sizeof(int));
+  REQUIRE(arr2 == arr);
+  REQUIRE(arena.nb_bytes == 64 * sizeof(int));
+
+  // And shrinks in place
+  arr2 = (int *)oc8_arena_realloc(&arena, arr2, 64 * sizeof(int),
+                                  16 * sizeof(int));
+  REQUIRE(arr2 == arr);
+  REQUIRE(arena.nb_bytes == 16 * sizeof(int));
+  for (int i = 0; i < 4; ++i)
+    REQUIRE(arr2[i] == i);
+
+  // Not the last one anymore, it moves
+  oc8_arena_alloc(&arena, 8);
+  int *arr3 = (int *)oc8_arena_realloc(&arena, arr2, 16 * sizeof(int),
+                                       128 * sizeof(int));
+  REQUIRE(arr3 != arr2);
+  for (int i = 0; i < 4; ++i)
+    REQUIRE(arr3[i] == i);
+
+  // Too big for the chunk
+  int *arr4 = (int *)oc8_arena_realloc(&arena, arr3, 128 * sizeof(int),
+                                       1024 * sizeof(int));
+  for (int i = 0; i < 4; ++i)
+    REQUIRE(arr4[i] == i);
+  oc8_arena_release(&arena, arr4);
+  oc8_arena_free(&arena);
+}
+
+TEST_CASE("oc8_arena heap", "") {
+  // Without arena, same as malloc / realloc / free
+  int *arr = (int *)oc8_arena_alloc(nullptr, 4 * sizeof(int));
+  arr[3] = 5;
+  arr = (int *)oc8_arena_realloc(nullptr, arr, 4 * sizeof(int),
+                                 1000 * sizeof(int));
+  REQUIRE(arr[3] == 5);
+  oc8_arena_release(nullptr, arr);
+}
@@ -1,6 +1,10 @@
 #include "oc8_as/as.h"
+#include "oc8_as/parser.h"
+#include "oc8_as/stream.h"
+#include "oc8_bin/bin_writer.h"
 #include "oc8_defs/oc8_defs.h"
 
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
@@ -39,17 +43,18 @@ void oc8_bin_file_init_rom(oc8_bin_file_t *bf, size_t rom_size);
 
 #endif
 
-void oc8_as_compile_sfile(oc8_as_sfile_t *sf, oc8_bin_file_t *bf) {
+int oc8_as_compile_sfile(oc8_as_sfile_t *sf, oc8_bin_file_t *bf) {
   // Set header
-  oc8_bin_file_init(bf);
-  oc8_bin_file_set_version(bf, 10);
+  oc8_bin_file_init_arena(bf, sf->arena);
+  oc8_bin_file_set_version(bf, OC8_BIN_VERSION);
   oc8_bin_file_set_type(bf, OC8_BIN_FILE_TYPE_OBJ);
 
   // Init defs_list and array [sf_sym_id => bf_sym_id]
   // Need to substract -1 and add 1 to size because def counts starts at 1 for
   // sfile
   size_t nb_defs = sf->next_sym_idx - 1;
-  uint16_t *ids_map = malloc((nb_defs + 1) * sizeof(uint16_t));
+  uint16_t *ids_map =
+      oc8_arena_alloc(sf->arena, (nb_defs + 1) * sizeof(uint16_t));
   oc8_bin_file_set_defs_count(bf, nb_defs);
 
   // Go through all the symbols used in the file, and add it to the defs table
@@ -57,7 +62,8 @@ void oc8_as_compile_sfile(oc8_as_sfile_t *sf, oc8_bin_file_t *bf) {
   // Symbol order is unspecified
   oc8_smap_it_t it = oc8_smap_get_it(&sf->syms_map);
   size_t bf_sym_id = 0;
-  while (oc8_smap_it_get(&it) != NULL) {
+  int err = 0;
+  while (!err && oc8_smap_it_get(&it) != NULL) {
     const char *sym_name = oc8_smap_it_get(&it)->key;
     uint16_t sf_sym_id = oc8_smap_it_get(&it)->val;
     oc8_smap_node_t *node_defs = oc8_smap_find(&sf->syms_defs_map, sym_name);
@@ -73,14 +79,20 @@ void oc8_as_compile_sfile(oc8_as_sfile_t *sf, oc8_bin_file_t *bf) {
       type = OC8_BIN_SYM_TYPE_OBJ;
     uint16_t addr = def ? def->pos + OC8_ROM_START : 0;
 
-    oc8_bin_file_add_def(bf, sym_name, is_global, type, addr);
+    err = oc8_bin_file_add_def(bf, sym_name, is_global, type, addr) < 0;
+    if (!err && def && def->has_size)
+      err = oc8_bin_file_set_def_size(bf, bf_sym_id, def->size);
     oc8_smap_it_next(&it);
     ++bf_sym_id;
   }
 
   // Prepare rom
   size_t rom_size = sf->curr_addr;
-  oc8_bin_file_init_rom(bf, rom_size);
+  if (err || oc8_bin_file_init_rom(bf, rom_size) != 0) {
+    oc8_arena_release(sf->arena, ids_map);
+    oc8_bin_file_free(bf);
+    return -1;
+  }
   uint8_t *rom_ptr = (uint8_t *)bf->rom;
 
   // Go through all items, write to ROM and build refs table at the same time
@@ -113,5 +125,77 @@ void oc8_as_compile_sfile(oc8_as_sfile_t *sf, oc8_bin_file_t *bf) {
   }
 
   // Clean up
-  free(ids_map);
+  oc8_arena_release(sf->arena, ids_map);
+  return 0;
+}
+
+// Key of an object in the cache: hash of the source, assembler version and
+// optimizations
+static uint64_t cache_key(const oc8_as_stream_t *is, unsigned opt_flags) {
+  uint64_t version = OC8_AS_CACHE_VERSION;
+  uint64_t flags = opt_flags;
+  uint64_t h = oc8_bin_hash_str("oc8-as", OC8_BIN_HASH_INIT);
+  h = oc8_bin_hash(&version, sizeof(version), h);
+  if (flags)
+    h = oc8_bin_hash(&flags, sizeof(flags), h);
+  return oc8_bin_hash(is->map.data, is->map.size, h);
+}
+
+int oc8_as_assemble_file(const char *in_path, const char *out_path,
+                         oc8_pool_t *pool, const oc8_bin_cache_t *cache) {
+  return oc8_as_assemble_file_opt(in_path, out_path, pool, cache, 0);
+}
+
+int oc8_as_assemble_file_opt(const char *in_path, const char *out_path,
+                             oc8_pool_t *pool, const oc8_bin_cache_t *cache,
+                             unsigned opt_flags) {
+  oc8_as_stream_t is;
+  if (oc8_as_stream_init_from_path(&is, in_path) != 0) {
+    fprintf(stderr, "oc8-as: Failed to open input file `%s'.\n", in_path);
+    return -1;
+  }
+
+  // Only mapped files can be hashed without reading them twice
+  uint64_t key = 0;
+  if (cache && is.map.data) {
+    key = cache_key(&is, opt_flags);
+    if (oc8_bin_cache_get(cache, key, "c8o", out_path) == 0) {
+      oc8_as_stream_free(&is);
+      return 0;
+    }
+  }
+  oc8_arena_t arena;
+  oc8_arena_init(&arena, 0);
+
+  oc8_as_sfile_t *sf;
+  if (pool && is.map.data)
+    sf = oc8_as_parse_raw_parallel((const char *)is.map.data, is.map.size,
+                                   in_path, pool, 0, &arena);
+  else
+    sf = oc8_as_run_parser_arena(&is, in_path, &arena);
+  if (!sf || oc8_as_sfile_check(sf) != 0) {
+    // The message was already printed
+    oc8_as_stream_free(&is);
+    oc8_arena_free(&arena);
+    fprintf(stderr, "oc8-as: Failed to assemble `%s'.\n", in_path);
+    return -1;
+  }
+
+  if (opt_flags)
+    oc8_as_optimize_sfile(sf, opt_flags);
+  oc8_bin_file_t bf;
+  int err = oc8_as_compile_sfile(sf, &bf) != 0 ||
+            oc8_bin_file_validate(&bf, /*is_bin=*/0) != 0 ||
+            oc8_bin_write_to_file(&bf, out_path) != 0;
+  if (!err && cache && is.map.data)
+    oc8_bin_cache_put(cache, key, "c8o", out_path);
+
+  // The object is in the arena, the messages were already printed
+  oc8_as_stream_free(&is);
+  oc8_arena_free(&arena);
+  if (err) {
+    fprintf(stderr, "oc8-as: Failed to assemble `%s'.\n", in_path);
+    return -1;
+  }
+  return 0;
 }
@@ -0,0 +1,68 @@
+// Build the keywords hash table of the lexer from keywords.def
+// Usage: gen_keywords <output-file>
+// Fails if two keywords have the same hash, or a keyword is too long
+
+#include <stdio.h>
+#include <string.h>
+
+#include "kw_hash.h"
+
+#define KW(str, kind, id) str,
+
+static const char *g_names[] = {
+#include "keywords.def"
+};
+
+#undef KW
+
+#define NB_NAMES (sizeof(g_names) / sizeof(g_names[0]))
+
+int main(int argc, char **argv) {
+  if (argc != 2) {
+    fprintf(stderr, "Usage: gen_keywords <output-file>\n");
+    return 1;
+  }
+
+  size_t table[KW_TABLE_SIZE];
+  for (size_t h = 0; h < KW_TABLE_SIZE; ++h)
+    table[h] = NB_NAMES;
+
+  for (size_t i = 0; i < NB_NAMES; ++i) {
+    size_t len = strlen(g_names[i]);
+    if (len < 2 || len > KW_MAX_LEN) {
+      fprintf(stderr, "gen_keywords: keyword `%s' must have 2 to %d chars\n",
+              g_names[i], KW_MAX_LEN);
+      return 1;
+    }
+
+    unsigned h = kw_hash((const unsigned char *)g_names[i], len);
+    if (table[h] != NB_NAMES) {
+      fprintf(stderr, "gen_keywords: keywords `%s' and `%s' have the same "
+                      "hash\n",
+              g_names[table[h]], g_names[i]);
+      return 1;
+    }
+    table[h] = i;
+  }
+
+  FILE *os = fopen(argv[1], "w");
+  if (!os) {
+    fprintf(stderr, "gen_keywords: Cannot open `%s'\n", argv[1]);
+    return 1;
+  }
+
+  fprintf(os, "// Generated by gen_keywords from keywords.def, do not edit\n\n"
+              "static const oc8_as_keyword_t *const "
+              "g_keywords_table[KW_TABLE_SIZE] = {\n");
+  for (size_t h = 0; h < KW_TABLE_SIZE; ++h)
+    if (table[h] != NB_NAMES)
+      fprintf(os, "    [%zu] = &g_oc8_as_keywords[%zu], // %s\n", h, table[h],
+              g_names[table[h]]);
+  fprintf(os, "};\n");
+
+  if (fclose(os) != 0) {
+    fprintf(stderr, "gen_keywords: Cannot write `%s'\n", argv[1]);
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,30 @@
+#ifndef OC8_AS_KW_HASH_H_
+#define OC8_AS_KW_HASH_H_
+
+//===--oc8_as/kw_hash.h - Hash of the keywords --------------------*- C -*-===//
+//
+// oc8_as library
+// Author: Steven Lariau
+//
+//===----------------------------------------------------------------------===//
+///
+/// \file
+/// Perfect hash of the keywords listed in keywords.def
+/// Shared by the lexer and gen_keywords, that builds the table at build time
+///
+//===----------------------------------------------------------------------===//
+
+#include <stddef.h>
+
+#define KW_TABLE_SIZE (128)
+#define KW_MAX_LEN (9) // @function
+
+// First char, second char, last char and length
+// `len` must be >= 2
+static inline unsigned kw_hash(const unsigned char *str, size_t len) {
+  return ((unsigned)str[0] * 3 + (unsigned)str[1] * 31 +
+          (unsigned)str[len - 1] + (unsigned)len * 4) &
+         (KW_TABLE_SIZE - 1);
+}
+
+#endif //! OC8_AS_KW_HASH_H_
@@ -0,0 +1,250 @@
+#include "oc8_as/lexer.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "kw_hash.h"
+#include "oc8_defs/oc8_defs.h"
+
+#define KW(str, kind, id) {str, sizeof(str) - 1, kind, id},
+
+const oc8_as_keyword_t g_oc8_as_keywords[] = {
+#include "keywords.def"
+};
+
+#undef KW
+
+const size_t g_oc8_as_keywords_size =
+    sizeof(g_oc8_as_keywords) / sizeof(g_oc8_as_keywords[0]);
+
+// g_keywords_table: entry of g_oc8_as_keywords at every hash, or NULL
+// Generated by gen_keywords from keywords.def, the build fails if two
+// keywords have the same hash
+#include "keywords_table.inc"
+
+const oc8_as_keyword_t *oc8_as_find_keyword(const char *str, size_t len) {
+  if (len < 2 || len > KW_MAX_LEN)
+    return NULL;
+  const oc8_as_keyword_t *kw =
+      g_keywords_table[kw_hash((const unsigned char *)str, len)];
+  if (!kw || kw->len != len || memcmp(kw->name, str, len) != 0)
+    return NULL;
+  return kw;
+}
+
+static inline int lx_peekc(oc8_as_lexer_t *lx) {
+  return oc8_as_stream_peek(lx->is);
+}
+
+static inline int lx_getc(oc8_as_lexer_t *lx) {
+  int res = oc8_as_stream_get(lx->is);
+  if (res == '\n') {
+    lx->col = 1;
+    ++lx->row;
+  } else
+    ++lx->col;
+  return res;
+}
+
+void oc8_as_lexer_error(oc8_as_lexer_t *lx, const char *msg) {
+  if (lx->tok.kind == OC8_AS_TOK_ERR) // only the first error is reported
+    return;
+  // One call, so messages of files assembled in parallel aren't mixed
+  fprintf(stderr,
+          "oc8_as/parser.c: Syntax error in input file: %s\n"
+          "Error near %s:%u:%u\n",
+          msg, lx->name, (unsigned)lx->tok.row, (unsigned)lx->tok.col);
+  lx->tok.kind = OC8_AS_TOK_ERR;
+}
+
+static int is_id_char(int c) {
+  return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
+         (c >= '0' && c <= '9') || c == '_';
+}
+
+#define HEX_UNDEF ((unsigned)-1)
+
+static inline unsigned hex_c2i(int c) { // HEX_UNDEF if not in base
+  if (c >= '0' && c <= '9')
+    return (unsigned)(c - '0');
+  else if (c >= 'a' && c <= 'f')
+    return (unsigned)(c - 'a') + 10;
+  else if (c >= 'A' && c <= 'F')
+    return (unsigned)(c - 'A') + 10;
+  else
+    return HEX_UNDEF;
+}
+
+static unsigned lex_digits(oc8_as_lexer_t *lx, unsigned base,
+                           const char *err_msg) {
+  unsigned res = 0;
+  unsigned len = 0;
+
+  for (;;) {
+    unsigned digit = hex_c2i(lx_peekc(lx));
+    if (digit >= base)
+      break;
+
+    lx_getc(lx);
+    res = base * res + digit;
+    ++len;
+  }
+
+  if (!len) {
+    oc8_as_lexer_error(lx, err_msg);
+    return 0;
+  }
+  return res;
+}
+
+static unsigned lex_int(oc8_as_lexer_t *lx) {
+  if (lx_peekc(lx) != '0')
+    return lex_digits(lx, 10, "Base 10 immediate expected");
+
+  lx_getc(lx);
+  int c = lx_peekc(lx);
+  if (c == 'x') {
+    lx_getc(lx);
+    return lex_digits(lx, 16, "Base 16 immediate expected");
+  }
+  if (c == 'b') {
+    lx_getc(lx);
+    return lex_digits(lx, 2, "Base 2 immediate expected");
+  }
+
+  if (c < '0' || c > '9') // base 8 with only a 0
+    return 0;
+  return lex_digits(lx, 8, "Base 8 immediate expected");
+}
+
+// Read identifier chars after `len` chars already in the token text
+// @returns the total length
+static size_t lex_id(oc8_as_lexer_t *lx, size_t len) {
+  char *text = lx->tok.text;
+  while (is_id_char(lx_peekc(lx))) {
+    if (len == OC8_MAX_SYM_SIZE) {
+      oc8_as_lexer_error(lx, "Identifier too long");
+      break;
+    }
+    text[len++] = (char)lx_getc(lx);
+  }
+  text[len] = '\0';
+  return len;
+}
+
+// '.' <directive>, '%' <register> or '@' <typename>
+static void lex_prefixed(oc8_as_lexer_t *lx, oc8_as_tok_kind_t kind,
+                         const char *err_msg) {
+  oc8_as_token_t *tok = &lx->tok;
+  tok->kind = kind;
+  tok->text[0] = (char)lx_getc(lx);
+  size_t len = lex_id(lx, 1);
+  if (tok->kind == OC8_AS_TOK_ERR)
+    return;
+  const oc8_as_keyword_t *kw = oc8_as_find_keyword(tok->text, len);
+  if (!kw || kw->kind != kind) {
+    oc8_as_lexer_error(lx, err_msg);
+    return;
+  }
+  tok->val = kw->id;
+}
+
+// Skip whole blocks of the stream until the end of line
+static void skip_comment(oc8_as_lexer_t *lx) {
+  oc8_as_stream_t *st = lx->is;
+  while (oc8_as_stream_refill(st)) {
+    const char *nl = memchr(st->cur, '\n', (size_t)(st->end - st->cur));
+    const char *stop = nl ? nl : st->end;
+    lx->col += (size_t)(stop - st->cur);
+    st->cur = stop;
+    if (nl)
+      break;
+  }
+}
+
+void oc8_as_lexer_init(oc8_as_lexer_t *lx, oc8_as_stream_t *is,
+                       const char *name) {
+  oc8_as_lexer_init_at(lx, is, name, 1);
+}
+
+void oc8_as_lexer_init_at(oc8_as_lexer_t *lx, oc8_as_stream_t *is,
+                          const char *name, size_t row) {
+  lx->is = is;
+  lx->name = name ? name : "???";
+  lx->row = row;
+  lx->col = 1;
+  lx->tok.kind = OC8_AS_TOK_NL;
+  oc8_as_lexer_next(lx);
+}
+
+const oc8_as_token_t *oc8_as_lexer_next(oc8_as_lexer_t *lx) {
+  oc8_as_token_t *tok = &lx->tok;
+  if (tok->kind == OC8_AS_TOK_ERR)
+    return tok;
+  int c = lx_peekc(lx);
+  while (c == ' ' || c == '\t') {
+    lx_getc(lx);
+    c = lx_peekc(lx);
+  }
+  if (c == '#') {
+    skip_comment(lx);
+    c = lx_peekc(lx);
+  }
+
+  tok->row = lx->row;
+  tok->col = lx->col;
+  tok->val = 0;
+  tok->text[0] = '\0';
+
+  switch (c) {
+  case EOF:
+    tok->kind = OC8_AS_TOK_EOF;
+    return tok;
+  case '\n':
+    tok->kind = OC8_AS_TOK_NL;
+    break;
+  case ',':
+    tok->kind = OC8_AS_TOK_COMMA;
+    break;
+  case ':':
+    tok->kind = OC8_AS_TOK_COLON;
+    break;
+  case '(':
+    tok->kind = OC8_AS_TOK_LPAREN;
+    break;
+  case ')':
+    tok->kind = OC8_AS_TOK_RPAREN;
+    break;
+  case '.':
+    lex_prefixed(lx, OC8_AS_TOK_DIR, "Unknown directive name");
+    return tok;
+  case '%':
+    lex_prefixed(lx, OC8_AS_TOK_REG, "Invalid register name");
+    return tok;
+  case '@':
+    lex_prefixed(lx, OC8_AS_TOK_TYPE, "Unknown typename");
+    return tok;
+
+  default:
+    if (c >= '0' && c <= '9') {
+      tok->kind = OC8_AS_TOK_INT;
+      tok->val = lex_int(lx);
+      return tok;
+    }
+    if (!is_id_char(c)) {
+      oc8_as_lexer_error(lx, "Invalid character");
+      return tok;
+    }
+
+    tok->kind = OC8_AS_TOK_ID;
+    size_t len = lex_id(lx, 0);
+    const oc8_as_keyword_t *kw = oc8_as_find_keyword(tok->text, len);
+    if (kw && kw->kind == OC8_AS_TOK_ID)
+      tok->val = kw->id;
+    return tok;
+  }
+
+  // Single char tokens
+  lx_getc(lx);
+  return tok;
+}
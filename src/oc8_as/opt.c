@@ -0,0 +1,277 @@
+#include "oc8_as/opt.h"
+#include "oc8_is/ins.h"
+
+#include <string.h>
+
+#define OPCODE_SIZE (2)
+// A jump is threaded one step per pass, chains longer than this are only
+// partially threaded
+#define MAX_PASSES (16)
+
+typedef struct {
+  oc8_as_sfile_t *sf;
+  int can_delete;
+
+  oc8_as_sym_def_t **defs; // [sym_idx] => definition, NULL if extern
+  uint32_t *items_at;      // [pos] => index of the instruction at pos + 1
+  uint8_t *is_label;       // [pos] => 1 if a symbol is defined at pos
+  uint16_t *new_pos;       // [old pos] => pos after the items are deleted
+  uint8_t *is_deleted;     // [item index] => 1 if deleted at the end of the
+                           // pass
+} ctx_t;
+
+// @returns 0 if the item at `idx` is an instruction, decoded in `ins`
+static int get_ins(const ctx_t *ctx, size_t idx, oc8_is_ins_t *ins) {
+  const oc8_as_data_item_t *item = &ctx->sf->items_arr[idx];
+  if (item->type != OC8_AS_DATA_ITEM_TYPE_INS)
+    return -1;
+  uint16_t opcode = item->ins_opcode;
+  return oc8_is_try_decode_ins(ins, (const char *)&opcode);
+}
+
+// Change the type of the instruction `ins` of `item`, and encode it again
+static void set_ins(oc8_as_data_item_t *item, oc8_is_ins_t *ins,
+                    oc8_is_type_t type) {
+  ins->type = type;
+  ins->opcode = 0;
+  oc8_is_encode_ins(ins, NULL);
+  item->ins_opcode = ins->opcode;
+}
+
+static int is_skip(oc8_is_type_t type) {
+  return type == OC8_IS_TYPE_3XNN || type == OC8_IS_TYPE_4XNN ||
+         type == OC8_IS_TYPE_5XY0 || type == OC8_IS_TYPE_9XY0 ||
+         type == OC8_IS_TYPE_EX9E || type == OC8_IS_TYPE_EXA1;
+}
+
+// 1 if the item at `idx` may be skipped by the instruction before it: it
+// can't be deleted or grow, the skip would land on the next one
+static int after_skip(const ctx_t *ctx, size_t idx) {
+  oc8_is_ins_t ins;
+  return idx > 0 && get_ins(ctx, idx - 1, &ins) == 0 && is_skip(ins.type);
+}
+
+// @returns the index of the instruction at the symbol used by `item`, or -1
+// if it's extern, or not an instruction
+static long get_target(const ctx_t *ctx, const oc8_as_data_item_t *item) {
+  const oc8_as_sym_def_t *def =
+      item->sym_idx ? ctx->defs[item->sym_idx] : NULL;
+  if (!def || def->pos >= ctx->sf->curr_addr)
+    return -1;
+  return (long)ctx->items_at[def->pos] - 1;
+}
+
+// Find the instructions and labels at their current positions
+static void index_items(ctx_t *ctx) {
+  oc8_as_sfile_t *sf = ctx->sf;
+  size_t len = (size_t)sf->curr_addr + 1;
+  memset(ctx->items_at, 0, len * sizeof(uint32_t));
+  memset(ctx->is_label, 0, len);
+  for (size_t i = 0; i < sf->items_size; ++i)
+    if (sf->items_arr[i].type == OC8_AS_DATA_ITEM_TYPE_INS)
+      ctx->items_at[sf->items_arr[i].pos] = (uint32_t)i + 1;
+  for (size_t i = 0; i < sf->syms_defs_size; ++i)
+    if (sf->syms_defs_arr[i].pos < len)
+      ctx->is_label[sf->syms_defs_arr[i].pos] = 1;
+}
+
+// `jmp L` / `call L`, with `L: jmp M` => `jmp M` / `call M`
+// `jmp L`, with `L: ret` => `ret`
+static int thread_jumps(ctx_t *ctx) {
+  oc8_as_sfile_t *sf = ctx->sf;
+  int changed = 0;
+  for (size_t i = 0; i < sf->items_size; ++i) {
+    oc8_as_data_item_t *item = &sf->items_arr[i];
+    oc8_is_ins_t ins;
+    oc8_is_ins_t target;
+    if (get_ins(ctx, i, &ins) != 0 ||
+        (ins.type != OC8_IS_TYPE_1NNN && ins.type != OC8_IS_TYPE_2NNN))
+      continue;
+    long t_idx = get_target(ctx, item);
+    if (t_idx < 0 || (size_t)t_idx == i ||
+        get_ins(ctx, (size_t)t_idx, &target) != 0)
+      continue;
+    const oc8_as_data_item_t *t_item = &sf->items_arr[t_idx];
+
+    if (target.type == OC8_IS_TYPE_1NNN &&
+        (t_item->sym_idx != item->sym_idx ||
+         target.operands[0] != ins.operands[0])) {
+      item->sym_idx = t_item->sym_idx;
+      ins.operands[0] = target.operands[0];
+      set_ins(item, &ins, ins.type);
+      changed = 1;
+    } else if (target.type == OC8_IS_TYPE_00EE &&
+               ins.type == OC8_IS_TYPE_1NNN) {
+      item->sym_idx = 0;
+      set_ins(item, &ins, OC8_IS_TYPE_00EE);
+      changed = 1;
+    }
+  }
+  return changed;
+}
+
+// `call f` followed by `ret` => `jmp f`
+// The `ret` is deleted if it doesn't have a label
+static int rewrite_tail_calls(ctx_t *ctx) {
+  oc8_as_sfile_t *sf = ctx->sf;
+  int changed = 0;
+  for (size_t i = 0; i + 1 < sf->items_size; ++i) {
+    oc8_as_data_item_t *item = &sf->items_arr[i];
+    oc8_is_ins_t ins;
+    oc8_is_ins_t next;
+    if (get_ins(ctx, i, &ins) != 0 || ins.type != OC8_IS_TYPE_2NNN ||
+        after_skip(ctx, i) || get_ins(ctx, i + 1, &next) != 0 ||
+        next.type != OC8_IS_TYPE_00EE)
+      continue;
+
+    set_ins(item, &ins, OC8_IS_TYPE_1NNN);
+    if (ctx->can_delete && !ctx->is_label[sf->items_arr[i + 1].pos])
+      ctx->is_deleted[i + 1] = 1;
+    changed = 1;
+  }
+  return changed;
+}
+
+// Mark `mov %vX, %vX`, `add 0, %vX`, and `jmp` to the next instruction
+static int mark_nops(ctx_t *ctx) {
+  oc8_as_sfile_t *sf = ctx->sf;
+  int changed = 0;
+  for (size_t i = 0; i < sf->items_size; ++i) {
+    const oc8_as_data_item_t *item = &sf->items_arr[i];
+    oc8_is_ins_t ins;
+    if (ctx->is_deleted[i] || get_ins(ctx, i, &ins) != 0 ||
+        after_skip(ctx, i))
+      continue;
+
+    int is_nop = 0;
+    if (ins.type == OC8_IS_TYPE_8XY0)
+      is_nop = ins.operands[0] == ins.operands[1];
+    else if (ins.type == OC8_IS_TYPE_7XNN)
+      is_nop = !item->sym_idx && ins.operands[1] == 0;
+    else if (ins.type == OC8_IS_TYPE_1NNN && get_target(ctx, item) >= 0)
+      is_nop = ctx->defs[item->sym_idx]->pos == item->pos + OPCODE_SIZE;
+    if (is_nop) {
+      ctx->is_deleted[i] = 1;
+      changed = 1;
+    }
+  }
+  return changed;
+}
+
+// Delete the marked items, and move the items and symbols after them
+// @returns the number of bytes deleted
+static size_t delete_items(ctx_t *ctx) {
+  oc8_as_sfile_t *sf = ctx->sf;
+  size_t nb_kept = 0;
+  for (size_t i = 0; i < sf->items_size; ++i)
+    nb_kept += !ctx->is_deleted[i];
+  if (nb_kept == sf->items_size || nb_kept == 0) {
+    // Never leave an empty file
+    memset(ctx->is_deleted, 0, sf->items_size);
+    return 0;
+  }
+
+  uint16_t *new_pos = ctx->new_pos;
+  uint16_t old_end = sf->curr_addr;
+  uint16_t pos = 0;
+  nb_kept = 0;
+  for (size_t i = 0; i < sf->items_size; ++i) {
+    oc8_as_data_item_t item = sf->items_arr[i];
+    uint16_t end =
+        i + 1 < sf->items_size ? sf->items_arr[i + 1].pos : old_end;
+    if (ctx->is_deleted[i]) {
+      for (uint16_t p = item.pos; p < end; ++p)
+        new_pos[p] = pos;
+      continue;
+    }
+
+    if (item.type == OC8_AS_DATA_ITEM_TYPE_ALIGN) {
+      // The padding is computed again at the new position
+      for (uint16_t p = item.pos; p < end; ++p)
+        new_pos[p] = pos;
+      item.pos = pos;
+      if (pos % item.align_nbytes)
+        pos += item.align_nbytes - pos % item.align_nbytes;
+    } else {
+      for (uint16_t p = item.pos; p < end; ++p)
+        new_pos[p] = pos + (p - item.pos);
+      uint16_t size = end - item.pos;
+      item.pos = pos;
+      pos += size;
+    }
+    sf->items_arr[nb_kept++] = item;
+  }
+  new_pos[old_end] = pos;
+
+  // A symbol of a deleted item is moved to the next one
+  for (size_t i = 0; i < sf->syms_defs_size; ++i) {
+    oc8_as_sym_def_t *def = &sf->syms_defs_arr[i];
+    if (def->pos > old_end)
+      continue;
+    if (def->has_size) {
+      uint16_t end = def->pos + def->size < old_end ? def->pos + def->size
+                                                    : old_end;
+      def->size -= (end - def->pos) - (new_pos[end] - new_pos[def->pos]);
+    }
+    def->pos = new_pos[def->pos];
+  }
+
+  memset(ctx->is_deleted, 0, sf->items_size);
+  sf->items_size = nb_kept;
+  sf->curr_addr = pos;
+  return old_end - pos;
+}
+
+size_t oc8_as_optimize_sfile(oc8_as_sfile_t *sf, unsigned flags) {
+  ctx_t ctx;
+  ctx.sf = sf;
+  ctx.can_delete = 1;
+  for (size_t i = 0; i < sf->items_size; ++i) {
+    oc8_is_ins_t ins;
+    if ((sf->items_arr[i].type == OC8_AS_DATA_ITEM_TYPE_ALIGN &&
+         sf->items_arr[i].align_nbytes > OPCODE_SIZE) ||
+        (get_ins(&ctx, i, &ins) == 0 && ins.type == OC8_IS_TYPE_BNNN))
+      ctx.can_delete = 0;
+  }
+
+  size_t nb_syms = sf->next_sym_idx;
+  ctx.defs = oc8_arena_alloc(sf->arena, nb_syms * sizeof(oc8_as_sym_def_t *));
+  memset(ctx.defs, 0, nb_syms * sizeof(oc8_as_sym_def_t *));
+  oc8_smap_it_t it = oc8_smap_get_it(&sf->syms_map);
+  for (; oc8_smap_it_get(&it); oc8_smap_it_next(&it)) {
+    oc8_smap_node_t *node =
+        oc8_smap_find(&sf->syms_defs_map, oc8_smap_it_get(&it)->key);
+    if (node)
+      ctx.defs[oc8_smap_it_get(&it)->val] = &sf->syms_defs_arr[node->val];
+  }
+
+  // The file only gets smaller
+  size_t len = (size_t)sf->curr_addr + 1;
+  ctx.items_at = oc8_arena_alloc(sf->arena, len * sizeof(uint32_t));
+  ctx.is_label = oc8_arena_alloc(sf->arena, len);
+  ctx.new_pos = oc8_arena_alloc(sf->arena, len * sizeof(uint16_t));
+  ctx.is_deleted = oc8_arena_alloc(sf->arena, sf->items_size + 1);
+  memset(ctx.is_deleted, 0, sf->items_size + 1);
+
+  size_t nb_deleted = 0;
+  for (int pass = 0; pass < MAX_PASSES; ++pass) {
+    index_items(&ctx);
+    int changed = 0;
+    if (flags & OC8_AS_OPT_JUMPS)
+      changed |= thread_jumps(&ctx);
+    if (flags & OC8_AS_OPT_TAIL_CALLS)
+      changed |= rewrite_tail_calls(&ctx);
+    if ((flags & OC8_AS_OPT_NOPS) && ctx.can_delete)
+      changed |= mark_nops(&ctx);
+    nb_deleted += delete_items(&ctx);
+    if (!changed)
+      break;
+  }
+
+  oc8_arena_release(sf->arena, ctx.is_deleted);
+  oc8_arena_release(sf->arena, ctx.new_pos);
+  oc8_arena_release(sf->arena, ctx.is_label);
+  oc8_arena_release(sf->arena, ctx.items_at);
+  oc8_arena_release(sf->arena, ctx.defs);
+  return nb_deleted;
+}
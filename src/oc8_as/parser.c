@@ -2,59 +2,15 @@
 
 #include <assert.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
+#include "oc8_as/lexer.h"
 #include "oc8_as/sfile.h"
 #include "oc8_as/stream.h"
 #include "oc8_defs/oc8_defs.h"
 
 #define MAX_OPS (3)
-#define MAX_INS_NAME_LEN (8)
-#define MAX_REG_NAME_LEN (4)
-#define MAX_DIR_NAME_LEN (16)
-
-// Wrappper around stream, to count lines / cols, and get better error messages
-typedef struct {
-  oc8_as_stream_t *is;
-  size_t row;       // start at 1
-  size_t col;       // start at 1
-  const char *name; // file path or (raw) for strings
-} reader_t;
-
-static int reader_peekc(reader_t *is) { return oc8_as_stream_peek(is->is); }
-
-static int reader_getc(reader_t *is) {
-  int res = oc8_as_stream_get(is->is);
-  if (res == '\n') {
-    is->col = 1;
-    ++is->row;
-  } else
-    ++is->col;
-  return res;
-}
-
-static void reader_error(reader_t *is, const char *msg) {
-  fprintf(stderr, "oc8_as/parser.c: Syntax error in input file: %s\n", msg);
-  fprintf(stderr, "Error near %s:%u:%u\n", is->name, (unsigned)is->row,
-          (unsigned)is->col);
-  fprintf(stderr, "Aborting !\n");
-  PANIC();
-}
-
-static void skip_ws(reader_t *is, int skip_nl) {
-  for (;;) {
-    int c = reader_peekc(is);
-    if (c == ' ' || c == '\t') {
-      reader_getc(is);
-      continue;
-    }
-    if (skip_nl && c == '\n') {
-      reader_getc(is);
-      continue;
-    }
-    break;
-  }
-}
 
 typedef enum {
   OP_TYPE_IMM,
@@ -65,19 +21,15 @@ typedef enum {
 typedef struct {
   int is_sym; // If this operand defined as a symbol
   op_type_t type;
-
-  union {
-    char val_reg[MAX_REG_NAME_LEN + 1]; // operand register name
-    unsigned val_imm; // operand register value (or 0 if symbol)
-  };
-
+  unsigned val_reg; // operand register (oc8_as_reg_t)
+  unsigned val_imm; // operand immediate value (or 0 if symbol)
   unsigned imm_off; // used only for REG_IND, 0 if symbol
 } op_t;
 
 typedef struct {
   op_t ops[MAX_OPS];
   size_t ops_size;
-  char name[MAX_INS_NAME_LEN + 1];
+  oc8_as_mn_t mn;
 
   // when one of the ops has imm sym value, stored here
   // no ins have 2 immediates
@@ -87,395 +39,304 @@ typedef struct {
 } as_ins_t;
 
 typedef struct {
-  reader_t is;
+  oc8_as_lexer_t lx;
   oc8_as_sfile_t *sf;
 } parser_t;
 
-#define HEX_UNDEF ((unsigned)-1)
-
-static inline unsigned hex_c2i(int c) { // HEX_UNDEF if not in base
-  if (c >= '0' && c <= '9')
-    return (unsigned)(c - '0');
-  else if (c >= 'a' && c <= 'f')
-    return (unsigned)(c - 'a') + 10;
-  else if (c >= 'A' && c <= 'F')
-    return (unsigned)(c - 'A') + 10;
-  else
-    return HEX_UNDEF;
+static int parse_error(parser_t *ps, const char *msg) {
+  oc8_as_lexer_error(&ps->lx, msg);
+  return -1;
 }
 
-static unsigned r_int(reader_t *is, unsigned base, const char *err_msg) {
-  unsigned res = 0;
-  unsigned len = 0;
-
-  for (;;) {
-    unsigned digit = hex_c2i(reader_peekc(is));
-    if (digit >= base)
-      break;
-
-    reader_getc(is);
-    res = base * res + digit;
-    ++len;
-  }
-
-  if (!len)
-    reader_error(is, err_msg);
-  return res;
+static inline const oc8_as_token_t *tok_next(parser_t *ps) {
+  return oc8_as_lexer_next(&ps->lx);
 }
 
-static int is_id_char(int c) {
-  return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
-         (c >= '0' && c <= '9') || c == '_';
+static int is_stmt_end(const oc8_as_token_t *tok) {
+  return tok->kind == OC8_AS_TOK_NL || tok->kind == OC8_AS_TOK_EOF;
 }
 
-static int is_lhexa_char(int c) {
-  return (c >= 'a' && c <= 'f') || (c >= '0' && c <= '9');
-}
-
-static void r_id(reader_t *is, char *out_buf, size_t max_len,
-                 const char *err_msg) {
-  size_t len = 0;
-
-  for (;;) {
-    int c = reader_peekc(is);
-    if (!is_id_char(c))
-      break;
-    reader_getc(is);
-
-    if (len == max_len)
-      reader_error(is, err_msg);
+// All the p_* functions below return 0 if success, != 0 on error
+// The error message is printed by the first function that fails
 
-    out_buf[len++] = (char)c;
-  }
+// Consume a token of kind `kind`, or fail with `err_msg`
+static int p_expect(parser_t *ps, oc8_as_tok_kind_t kind,
+                    const char *err_msg) {
+  if (ps->lx.tok.kind != kind)
+    return parse_error(ps, err_msg);
+  tok_next(ps);
+  return 0;
+}
 
-  if (!len)
-    reader_error(is, err_msg);
-  out_buf[len] = 0;
+// Read an identifier in `out_buf` (at least OC8_MAX_SYM_SIZE + 1 bytes)
+static int p_id(parser_t *ps, char *out_buf, const char *err_msg) {
+  const oc8_as_token_t *tok = &ps->lx.tok;
+  if (tok->kind != OC8_AS_TOK_ID)
+    return parse_error(ps, err_msg);
+  strcpy(out_buf, tok->text);
+  tok_next(ps);
+  return 0;
 }
 
-// If imm is integer, returns it
-// If label, store it in ins->sym
+// If imm is integer, store it in `val`
+// If label, store it in ins->sym, and 0 in `val`
 // If `ins` is NULL, cannot have an @id
-static unsigned r_imm(reader_t *is, as_ins_t *ins) {
-  int c = reader_peekc(is);
-
-  if (c == '0') {
-    reader_getc(is);
-    c = reader_peekc(is);
-    if (c == 'x') {
-      reader_getc(is);
-      return r_int(is, 16, "Base 16 immediate expected");
-    }
-    if (c == 'b') {
-      reader_getc(is);
-      return r_int(is, 2, "Base 2 immediate expected");
-    }
-
-    c = reader_peekc(is);
-    if (c < '0' || c > '9') // base 8 with only a 0
-      return 0;
-    return r_int(is, 8, "Base 8 immediate expected");
+static int p_imm(parser_t *ps, as_ins_t *ins, unsigned *val) {
+  const oc8_as_token_t *tok = &ps->lx.tok;
+  if (tok->kind == OC8_AS_TOK_INT) {
+    *val = tok->val;
+    tok_next(ps);
+    return 0;
   }
 
-  if (c >= '1' && c <= '9')
-    return r_int(is, 10, "Base 10 immediate expected");
-
   if (!ins)
-    reader_error(is, "Expected immediate integer value");
+    return parse_error(ps, "Expected immediate integer value");
 
   if (ins->sym[0])
-    reader_error(is, "Cannot have 2 symbols in one instruction");
+    return parse_error(ps, "Cannot have 2 symbols in one instruction");
 
-  r_id(is, ins->sym, OC8_MAX_SYM_SIZE, "Invalid symbol");
-  return 0;
+  *val = 0;
+  return p_id(ps, ins->sym, "Invalid symbol");
 }
 
-static void r_reg(reader_t *is, op_t *op) {
-  if (reader_getc(is) != '%')
-    reader_error(is, "Expected a register");
-
-  r_id(is, op->val_reg, MAX_REG_NAME_LEN, "Invalid register name");
+static int p_reg(parser_t *ps, op_t *op) {
+  const oc8_as_token_t *tok = &ps->lx.tok;
+  if (tok->kind != OC8_AS_TOK_REG)
+    return parse_error(ps, "Expected a register");
+  op->val_reg = tok->val;
+  tok_next(ps);
+  return 0;
 }
 
-// returns 1 if found and parsed one op, 0 otherwhise
-static int r_op(reader_t *is, as_ins_t *ins) {
-  int c = reader_peekc(is);
-  if (!is_id_char(c) && c != '%')
+// returns 1 if found and parsed one op, 0 if there is none, -1 on error
+static int p_op(parser_t *ps, as_ins_t *ins) {
+  oc8_as_tok_kind_t kind = ps->lx.tok.kind;
+  if (kind != OC8_AS_TOK_ID && kind != OC8_AS_TOK_INT &&
+      kind != OC8_AS_TOK_REG)
     return 0;
 
+  if (ins->ops_size == MAX_OPS)
+    return parse_error(ps, "Too many operands");
   op_t *op = &ins->ops[ins->ops_size++];
   op->is_sym = 0;
+  op->imm_off = 0;
 
-  if (c == '%') { // parse reg
-    r_reg(is, op);
+  if (kind == OC8_AS_TOK_REG) {
     op->type = OP_TYPE_REG;
-    return 1;
+    return p_reg(ps, op) ? -1 : 1;
   }
 
   int has_sym = !!ins->sym[0];
-  op->val_imm = r_imm(is, ins);
+  if (p_imm(ps, ins, &op->val_imm))
+    return -1;
   op->type = OP_TYPE_IMM;
   if (!has_sym && ins->sym[0])
     op->is_sym = 1;
 
-  if (reader_peekc(is) != '(')
+  if (ps->lx.tok.kind != OC8_AS_TOK_LPAREN)
     return 1;
-  reader_getc(is);
+  tok_next(ps);
 
   // <imm> '(' <reg> ')'
   op->type = OP_TYPE_REG_IND;
   op->imm_off = op->val_imm;
-  r_reg(is, op);
-  if (reader_getc(is) != ')')
-    reader_error(is, "expected )");
-
+  if (p_reg(ps, op) || p_expect(ps, OC8_AS_TOK_RPAREN, "expected )"))
+    return -1;
   return 1;
 }
 
-// return 1 if get an ins, or 0 if get a label
-// if label, stored in ins->name
-static int r_ins_or_label(reader_t *is, as_ins_t *ins) {
+// Parse the operands of an instruction, until the end of the line
+static int p_ops(parser_t *ps, as_ins_t *ins) {
   ins->ops_size = 0;
   ins->sym[0] = 0;
 
-  r_id(is, ins->name, MAX_INS_NAME_LEN, "Invalid instruction name");
-  if (reader_peekc(is) == ':') {
-    reader_getc(is);
-    return 0;
-  }
-
-  skip_ws(is, /*skip_nl=*/0);
-
   int want_op = 0;  // 1 when see a comma (must have an op)
   int want_end = 0; // 1 when didn't see a comma (must end)
 
   for (;;) {
-    int c = reader_peekc(is);
-    int is_op = c != EOF && c != '\n' && c != '#';
+    int is_op = !is_stmt_end(&ps->lx.tok);
     if (is_op && want_end)
-      reader_error(is, "Unexpected operand without ',' separator");
+      return parse_error(ps, "Unexpected operand without ',' separator");
     if (!is_op && want_op)
-      reader_error(is, "Unexpected end of instruction after ',' separator");
+      return parse_error(ps,
+                         "Unexpected end of instruction after ',' separator");
     if (!is_op)
       break;
 
-    if (!r_op(is, ins))
-      reader_error(is, "Failed to parse operand");
+    int res = p_op(ps, ins);
+    if (res < 0)
+      return res;
+    if (!res)
+      return parse_error(ps, "Failed to parse operand");
 
-    skip_ws(is, /*skip_nl=*/0);
-    if (reader_peekc(is) == ',') {
-      reader_getc(is);
+    if (ps->lx.tok.kind == OC8_AS_TOK_COMMA) {
+      tok_next(ps);
       want_op = 1;
       want_end = 0;
-      skip_ws(is, /*skip_nl=*/0);
     } else {
       want_op = 0;
       want_end = 1;
     }
   }
-
-  return 1;
+  return 0;
 }
 
-static void r_dir_byte(parser_t *ps) {
-  reader_t *is = &(ps->is);
-  oc8_as_sfile_t *sf = ps->sf;
-  skip_ws(is, /*skip_nl=*/0);
-
-  unsigned val = r_imm(is, NULL);
+static int p_dir_byte(parser_t *ps) {
+  unsigned val;
+  if (p_imm(ps, NULL, &val))
+    return -1;
   if (val > 0xFF)
-    reader_error(is, "directive byte: value must be <= 0xFF");
-  oc8_as_sfile_dir_byte(sf, val);
+    return parse_error(ps, "directive byte: value must be <= 0xFF");
+  oc8_as_sfile_dir_byte(ps->sf, val);
+  return 0;
 }
 
-static void r_dir_equ(parser_t *ps) {
-  reader_t *is = &(ps->is);
-  oc8_as_sfile_t *sf = ps->sf;
-  skip_ws(is, /*skip_nl=*/0);
-
+static int p_dir_equ(parser_t *ps) {
   char name[OC8_MAX_SYM_SIZE + 1];
-  r_id(is, name, OC8_MAX_SYM_SIZE, "directive equ: invalid identifier");
+  unsigned val;
+  if (p_id(ps, name, "directive equ: invalid identifier") ||
+      p_expect(ps, OC8_AS_TOK_COMMA,
+               "directive equ: expected ',' after identifier") ||
+      p_imm(ps, NULL, &val))
+    return -1;
 
-  skip_ws(is, /*skip_nl=*/0);
-  if (reader_getc(is) != ',')
-    reader_error(is, "directive equ: expected ',' after identifier");
-  skip_ws(is, /*skip_nl=*/0);
-
-  unsigned val = r_imm(is, NULL);
   if (val > 0xFFF)
-    reader_error(is, "directive equ: value must be <= 0xFFF");
-  oc8_as_sfile_dir_equ(sf, name, val);
+    return parse_error(ps, "directive equ: value must be <= 0xFFF");
+  return oc8_as_sfile_dir_equ(ps->sf, name, val);
 }
 
-static void r_dir_globl(parser_t *ps) {
-  reader_t *is = &(ps->is);
-  oc8_as_sfile_t *sf = ps->sf;
-  skip_ws(is, /*skip_nl=*/0);
-
+static int p_dir_globl(parser_t *ps) {
   char sym[OC8_MAX_SYM_SIZE + 1];
-  r_id(is, sym, OC8_MAX_SYM_SIZE, "directive globl: invalid symbol");
-  oc8_as_sfile_dir_globl(sf, sym);
+  if (p_id(ps, sym, "directive globl: invalid symbol"))
+    return -1;
+  return oc8_as_sfile_dir_globl(ps->sf, sym);
 }
 
-static void r_dir_size(parser_t *ps) {
-  reader_t *is = &(ps->is);
-  oc8_as_sfile_t *sf = ps->sf;
-  skip_ws(is, /*skip_nl=*/0);
-
+static int p_dir_size(parser_t *ps) {
   char sym[OC8_MAX_SYM_SIZE + 1];
-  r_id(is, sym, OC8_MAX_SYM_SIZE, "directive size: invalid symbol");
-
-  skip_ws(is, /*skip_nl=*/0);
-  if (reader_getc(is) != ',')
-    reader_error(is, "directive size: expected ',' after symbol");
-  skip_ws(is, /*skip_nl=*/0);
+  unsigned val;
+  if (p_id(ps, sym, "directive size: invalid symbol") ||
+      p_expect(ps, OC8_AS_TOK_COMMA,
+               "directive size: expected ',' after symbol") ||
+      p_imm(ps, NULL, &val))
+    return -1;
 
-  unsigned val = r_imm(is, NULL);
   if (val > 0xFFF)
-    reader_error(is, "directive size: value must be <= 0xFFF");
-  oc8_as_sfile_dir_size(sf, sym, val);
+    return parse_error(ps, "directive size: value must be <= 0xFFF");
+  return oc8_as_sfile_dir_size(ps->sf, sym, val);
 }
 
-static void r_dir_type(parser_t *ps) {
-  reader_t *is = &(ps->is);
-  oc8_as_sfile_t *sf = ps->sf;
-  skip_ws(is, /*skip_nl=*/0);
-
+static int p_dir_type(parser_t *ps) {
   char sym[OC8_MAX_SYM_SIZE + 1];
-  r_id(is, sym, OC8_MAX_SYM_SIZE, "directive type: invalid symbol");
-
-  skip_ws(is, /*skip_nl=*/0);
-  if (reader_getc(is) != ',')
-    reader_error(is, "directive type: expected ',' after symbol");
-  skip_ws(is, /*skip_nl=*/0);
-
-  if (reader_getc(is) != '@')
-    reader_error(is, "directive type: expected '@' before typename");
-
-  char stype[12];
-  r_id(is, stype, sizeof(stype) - 1, "directive type: invalid typename");
-  oc8_as_sym_type_t type;
-  if (strcmp(stype, "function") == 0)
-    type = OC8_AS_DATA_SYM_TYPE_FUN;
-  else if (strcmp(stype, "object") == 0)
-    type = OC8_AS_DATA_SYM_TYPE_OBJ;
-  else
-    reader_error(is, "directive type: unknown typename");
-
-  oc8_as_sfile_dir_type(sf, sym, type);
-}
-
-static void r_dir_word(parser_t *ps) {
-  reader_t *is = &(ps->is);
-  oc8_as_sfile_t *sf = ps->sf;
-  skip_ws(is, /*skip_nl=*/0);
-
-  unsigned val = r_imm(is, NULL);
+  if (p_id(ps, sym, "directive type: invalid symbol") ||
+      p_expect(ps, OC8_AS_TOK_COMMA,
+               "directive type: expected ',' after symbol"))
+    return -1;
+
+  const oc8_as_token_t *tok = &ps->lx.tok;
+  if (tok->kind != OC8_AS_TOK_TYPE)
+    return parse_error(ps, "directive type: expected '@' before typename");
+  oc8_as_sym_type_t type = tok->val == OC8_AS_TYPENAME_FUNCTION
+                               ? OC8_AS_DATA_SYM_TYPE_FUN
+                               : OC8_AS_DATA_SYM_TYPE_OBJ;
+  tok_next(ps);
+  return oc8_as_sfile_dir_type(ps->sf, sym, type);
+}
+
+static int p_dir_word(parser_t *ps) {
+  unsigned val;
+  if (p_imm(ps, NULL, &val))
+    return -1;
   if (val > 0xFFFF)
-    reader_error(is, "directive word: value must be <= 0xFFFF");
-  oc8_as_sfile_dir_word(sf, val);
+    return parse_error(ps, "directive word: value must be <= 0xFFFF");
+  oc8_as_sfile_dir_word(ps->sf, val);
+  return 0;
 }
 
-static void r_dir_zero(parser_t *ps) {
-  reader_t *is = &(ps->is);
-  oc8_as_sfile_t *sf = ps->sf;
-  skip_ws(is, /*skip_nl=*/0);
-
-  unsigned val = r_imm(is, NULL);
+static int p_dir_zero(parser_t *ps) {
+  unsigned val;
+  if (p_imm(ps, NULL, &val))
+    return -1;
   if (val > 0xFFF)
-    reader_error(is, "directive zero: value must be <= 0xFFF");
-  oc8_as_sfile_dir_zero(sf, val);
+    return parse_error(ps, "directive zero: value must be <= 0xFFF");
+  oc8_as_sfile_dir_zero(ps->sf, val);
+  return 0;
 }
 
 // parse a directive
-static void r_dir(parser_t *ps) {
-  reader_t *is = &(ps->is);
-  if (reader_getc(is) != '.')
-    reader_error(is, "Internal parser error: expected directive");
-
-  char name[MAX_DIR_NAME_LEN + 1];
-  r_id(is, name, MAX_DIR_NAME_LEN, "Invalid directive name");
-
-  if (strcmp(name, "byte") == 0)
-    r_dir_byte(ps);
-  else if (strcmp(name, "equ") == 0)
-    r_dir_equ(ps);
-  else if (strcmp(name, "globl") == 0)
-    r_dir_globl(ps);
-  else if (strcmp(name, "size") == 0)
-    r_dir_size(ps);
-  else if (strcmp(name, "type") == 0)
-    r_dir_type(ps);
-  else if (strcmp(name, "word") == 0)
-    r_dir_word(ps);
-  else if (strcmp(name, "zero") == 0)
-    r_dir_zero(ps);
-  else
-    reader_error(is, "Unknown directive name");
-
-  skip_ws(is, /*skip_nl=*/0);
-  int c = reader_peekc(is);
-  int dir_end = c == EOF || c == '\n' || c == '#';
-  if (!dir_end)
-    reader_error(is, "Invalid char after end of directive");
-}
-
-static void r_comment(reader_t *is) {
-  if (reader_getc(is) != '#')
-    reader_error(is, "Internal error: r_comment expected start with '#'");
-
-  for (;;) {
-    int c = reader_getc(is);
-    if (c == '\n' || c == EOF)
-      break;
+static int p_dir(parser_t *ps) {
+  oc8_as_dir_t dir = (oc8_as_dir_t)ps->lx.tok.val;
+  tok_next(ps);
+
+  int res = 0;
+  switch (dir) {
+  case OC8_AS_DIR_BYTE:
+    res = p_dir_byte(ps);
+    break;
+  case OC8_AS_DIR_EQU:
+    res = p_dir_equ(ps);
+    break;
+  case OC8_AS_DIR_GLOBL:
+    res = p_dir_globl(ps);
+    break;
+  case OC8_AS_DIR_SIZE:
+    res = p_dir_size(ps);
+    break;
+  case OC8_AS_DIR_TYPE:
+    res = p_dir_type(ps);
+    break;
+  case OC8_AS_DIR_WORD:
+    res = p_dir_word(ps);
+    break;
+  case OC8_AS_DIR_ZERO:
+    res = p_dir_zero(ps);
+    break;
   }
+  if (res)
+    return res;
+
+  if (!is_stmt_end(&ps->lx.tok))
+    return parse_error(ps, "Invalid char after end of directive");
+  return 0;
 }
 
 static int is_op_vreg(op_t *op) {
-  return op->type == OP_TYPE_REG && op->val_reg[0] == 'v' &&
-         is_lhexa_char(op->val_reg[1]) && op->val_reg[2] == 0;
+  return op->type == OP_TYPE_REG && op->val_reg <= OC8_AS_REG_VF;
 }
 
 static int is_op_reg_i(op_t *op) {
-  return op->type == OP_TYPE_REG && op->val_reg[0] == 'i' &&
-         op->val_reg[1] == 0;
+  return op->type == OP_TYPE_REG && op->val_reg == OC8_AS_REG_I;
 }
 
 static int is_op_reg_dt(op_t *op) {
-  return op->type == OP_TYPE_REG && op->val_reg[0] == 'd' &&
-         op->val_reg[1] == 't' && op->val_reg[2] == 0;
+  return op->type == OP_TYPE_REG && op->val_reg == OC8_AS_REG_DT;
 }
 
 static int is_op_reg_st(op_t *op) {
-  return op->type == OP_TYPE_REG && op->val_reg[0] == 's' &&
-         op->val_reg[1] == 't' && op->val_reg[2] == 0;
+  return op->type == OP_TYPE_REG && op->val_reg == OC8_AS_REG_ST;
 }
 
-static unsigned vreg_idx(op_t *op) {
-  char c = op->val_reg[1];
-  if (c >= '0' && c <= '9')
-    return c - '0';
-  else
-    return (c - 'a') + 10;
-}
+static unsigned vreg_idx(op_t *op) { return op->val_reg; }
 
-static void add_ins(parser_t *parser, as_ins_t *ins) {
+static int add_ins(parser_t *parser, as_ins_t *ins) {
   oc8_as_sfile_t *sf = parser->sf;
   size_t nops = ins->ops_size;
   op_t *op0 = &ins->ops[0];
   op_t *op1 = &ins->ops[1];
   op_t *op2 = &ins->ops[2];
   const char *sym = ins->sym[0] == 0 ? NULL : &ins->sym[0];
+  int err = 0;
 
-  if (strcmp(ins->name, "add") == 0) {
+  switch (ins->mn) {
+  case OC8_AS_MN_ADD: {
     // add <Src:NN>, %v<Dst:X> (7XNN)
     if (nops == 2 && op0->type == OP_TYPE_IMM && is_op_vreg(op1)) {
       unsigned i_src = op0->val_imm;
       if (i_src > 0xFF)
-        reader_error(&parser->is, "add imediate operand must be <= 0xFF");
+        return parse_error(parser, "add imediate operand must be <= 0xFF");
       unsigned r_dst = vreg_idx(op1);
       if (sym)
-        oc8_as_sfile_sins_add_imm(sf, sym, r_dst);
+        err = oc8_as_sfile_sins_add_imm(sf, sym, r_dst);
       else
         oc8_as_sfile_ins_add_imm(sf, i_src, r_dst);
     }
@@ -494,10 +355,11 @@ static void add_ins(parser_t *parser, as_ins_t *ins) {
     }
 
     else
-      reader_error(&parser->is, "Invalid operands for add instruction");
+      return parse_error(parser, "Invalid operands for add instruction");
+    break;
   }
 
-  else if (strcmp(ins->name, "and") == 0) {
+  case OC8_AS_MN_AND: {
     // and %v<Src:Y>, %v<Dst:X>	(8XY2)
     if (nops == 2 && is_op_vreg(op0) && is_op_vreg(op1)) {
       unsigned r_src = vreg_idx(op0);
@@ -506,10 +368,11 @@ static void add_ins(parser_t *parser, as_ins_t *ins) {
     }
 
     else
-      reader_error(&parser->is, "Invalid operands for and instruction");
+      return parse_error(parser, "Invalid operands for and instruction");
+    break;
   }
 
-  else if (strcmp(ins->name, "bcd") == 0) {
+  case OC8_AS_MN_BCD: {
     // bcd %v<Src:X> (FX33)
     if (nops == 1 && is_op_vreg(op0)) {
       unsigned r_src = vreg_idx(op0);
@@ -517,37 +380,40 @@ static void add_ins(parser_t *parser, as_ins_t *ins) {
     }
 
     else
-      reader_error(&parser->is, "Invalid operands for and instruction");
+      return parse_error(parser, "Invalid operands for and instruction");
+    break;
   }
 
-  else if (strcmp(ins->name, "call") == 0) {
+  case OC8_AS_MN_CALL: {
     // call <Addr:NNN> (2NNN)
     if (nops == 1 && op0->type == OP_TYPE_IMM) {
       unsigned i_src = op0->val_imm;
       if (i_src > 0xFFF)
-        reader_error(&parser->is,
-                     "call instruction: operand 0 must be <= 0xFFF");
+        return parse_error(parser,
+                           "call instruction: operand 0 must be <= 0xFFF");
       if (sym)
-        oc8_as_sfile_sins_call(sf, sym);
+        err = oc8_as_sfile_sins_call(sf, sym);
       else
         oc8_as_sfile_ins_call(sf, i_src);
     }
 
     else
-      reader_error(&parser->is, "Invalid operands for call instruction");
+      return parse_error(parser, "Invalid operands for call instruction");
+    break;
   }
 
-  else if (strcmp(ins->name, "cls") == 0) {
+  case OC8_AS_MN_CLS: {
     // cls (00E0)
     if (nops == 0) {
       oc8_as_sfile_ins_cls(sf);
     }
 
     else
-      reader_error(&parser->is, "Invalid operands for cls instruction");
+      return parse_error(parser, "Invalid operands for cls instruction");
+    break;
   }
 
-  else if (strcmp(ins->name, "draw") == 0) {
+  case OC8_AS_MN_DRAW: {
     // draw %v<X:X>, %v<Y:Y>, <H:N>  (DXYN)
     if (nops == 3 && is_op_vreg(op0) && is_op_vreg(op1) &&
         op2->type == OP_TYPE_IMM) {
@@ -555,19 +421,20 @@ static void add_ins(parser_t *parser, as_ins_t *ins) {
       unsigned r_y = vreg_idx(op1);
       unsigned i_h = op2->val_imm;
       if (i_h > 0xF)
-        reader_error(&parser->is,
-                     "draw instruction: operand #2 must be <= 0xF");
+        return parse_error(parser,
+                           "draw instruction: operand #2 must be <= 0xF");
       if (sym)
-        oc8_as_sfile_sins_draw(sf, r_x, r_y, sym);
+        err = oc8_as_sfile_sins_draw(sf, r_x, r_y, sym);
       else
         oc8_as_sfile_ins_draw(sf, r_x, r_y, i_h);
     }
 
     else
-      reader_error(&parser->is, "Invalid operands for draw instruction");
+      return parse_error(parser, "Invalid operands for draw instruction");
+    break;
   }
 
-  else if (strcmp(ins->name, "fspr") == 0) {
+  case OC8_AS_MN_FSPR: {
     // fspr %v<Src:X> (FX29)
     if (nops == 1 && is_op_vreg(op0)) {
       unsigned r_src = vreg_idx(op0);
@@ -575,48 +442,50 @@ static void add_ins(parser_t *parser, as_ins_t *ins) {
     }
 
     else
-      reader_error(&parser->is, "Invalid operands for fspr instruction");
+      return parse_error(parser, "Invalid operands for fspr instruction");
+    break;
   }
 
-  else if (strcmp(ins->name, "jmp") == 0) {
+  case OC8_AS_MN_JMP: {
     // jmp <Addr:NNN> (1NNN)
     if (nops == 1 && op0->type == OP_TYPE_IMM) {
       unsigned i_addr = op0->val_imm;
       if (i_addr > 0xFFF)
-        reader_error(&parser->is,
-                     "jmp instruction: operand #0 must be <= 0xFFF");
+        return parse_error(parser,
+                           "jmp instruction: operand #0 must be <= 0xFFF");
       if (sym)
-        oc8_as_sfile_sins_jmp(sf, sym);
+        err = oc8_as_sfile_sins_jmp(sf, sym);
       else
         oc8_as_sfile_ins_jmp(sf, i_addr);
     }
 
     // jmp <Addr:NNN>(%v0) (BNNN)
     else if (nops == 1 && op0->type == OP_TYPE_REG_IND &&
-             strcmp(op0->val_reg, "v0") == 0) {
+             op0->val_reg == 0) {
       unsigned i_addr = op0->imm_off;
       if (i_addr > 0xFFF)
-        reader_error(&parser->is,
-                     "jmp instruction: operand #0 must be <= 0xFFF");
+        return parse_error(parser,
+                           "jmp instruction: operand #0 must be <= 0xFFF");
       if (sym)
-        oc8_as_sfile_sins_jmp_v0(sf, sym);
+        err = oc8_as_sfile_sins_jmp_v0(sf, sym);
       else
         oc8_as_sfile_ins_jmp_v0(sf, i_addr);
     }
 
     else
-      reader_error(&parser->is, "Invalid operand for jmp instruction");
+      return parse_error(parser, "Invalid operand for jmp instruction");
+    break;
   }
 
-  else if (strcmp(ins->name, "mov") == 0) {
+  case OC8_AS_MN_MOV: {
     // mov <Src:NN>, %v<Dst:X> (6XNN)
     if (nops == 2 && op0->type == OP_TYPE_IMM && is_op_vreg(op1)) {
       unsigned i_src = op0->val_imm;
       if (i_src > 0xFF)
-        reader_error(&parser->is, "mov imediate operand must be <= 0xFF");
+        return parse_error(parser, "mov imediate operand must be <= 0xFF");
       unsigned r_dst = vreg_idx(op1);
       if (sym)
-        oc8_as_sfile_sins_mov_imm(sf, sym, r_dst);
+        err = oc8_as_sfile_sins_mov_imm(sf, sym, r_dst);
       else
         oc8_as_sfile_ins_mov_imm(sf, i_src, r_dst);
     }
@@ -632,9 +501,9 @@ static void add_ins(parser_t *parser, as_ins_t *ins) {
     else if (nops == 2 && op0->type == OP_TYPE_IMM && is_op_reg_i(op1)) {
       unsigned i_src = op0->val_imm;
       if (i_src > 0xFFF)
-        reader_error(&parser->is, "mov imediate operand must be <= 0xFFF");
+        return parse_error(parser, "mov imediate operand must be <= 0xFFF");
       if (sym)
-        oc8_as_sfile_sins_mov_i(sf, sym);
+        err = oc8_as_sfile_sins_mov_i(sf, sym);
       else
         oc8_as_sfile_ins_mov_i(sf, i_src);
     }
@@ -658,10 +527,11 @@ static void add_ins(parser_t *parser, as_ins_t *ins) {
     }
 
     else
-      reader_error(&parser->is, "Invalid operands for mov instruction");
+      return parse_error(parser, "Invalid operands for mov instruction");
+    break;
   }
 
-  else if (strcmp(ins->name, "movm") == 0) {
+  case OC8_AS_MN_MOVM: {
     // movm %v<Src:X>, %i (FX55)
     if (nops == 2 && is_op_vreg(op0) && is_op_reg_i(op1)) {
       unsigned r_src = vreg_idx(op0);
@@ -675,10 +545,11 @@ static void add_ins(parser_t *parser, as_ins_t *ins) {
     }
 
     else
-      reader_error(&parser->is, "Invalid operands for movm instruction");
+      return parse_error(parser, "Invalid operands for movm instruction");
+    break;
   }
 
-  else if (strcmp(ins->name, "or") == 0) {
+  case OC8_AS_MN_OR: {
     // or %v<Src:Y>, %v<Dst:X> (8XY1)
     if (nops == 2 && is_op_vreg(op0) && is_op_vreg(op1)) {
       unsigned r_src = vreg_idx(op0);
@@ -687,37 +558,40 @@ static void add_ins(parser_t *parser, as_ins_t *ins) {
     }
 
     else
-      reader_error(&parser->is, "Invalid operands for or instruction");
+      return parse_error(parser, "Invalid operands for or instruction");
+    break;
   }
 
-  else if (strcmp(ins->name, "rand") == 0) {
+  case OC8_AS_MN_RAND: {
     // rand <Mask:NN>, %v<Dst:X> (CXNN)
     if (nops == 2 && op0->type == OP_TYPE_IMM && is_op_vreg(op1)) {
       unsigned i_mask = op0->val_imm;
       if (i_mask > 0xFF)
-        reader_error(&parser->is, "rand imediate operand must be <= 0xFF");
+        return parse_error(parser, "rand imediate operand must be <= 0xFF");
       unsigned r_dst = vreg_idx(op1);
       if (sym)
-        oc8_as_sfile_sins_rand(sf, sym, r_dst);
+        err = oc8_as_sfile_sins_rand(sf, sym, r_dst);
       else
         oc8_as_sfile_ins_rand(sf, i_mask, r_dst);
     }
 
     else
-      reader_error(&parser->is, "Invalid operands for rand instruction");
+      return parse_error(parser, "Invalid operands for rand instruction");
+    break;
   }
 
-  else if (strcmp(ins->name, "ret") == 0) {
+  case OC8_AS_MN_RET: {
     // ret (00EE)
     if (nops == 0) {
       oc8_as_sfile_ins_ret(sf);
     }
 
     else
-      reader_error(&parser->is, "Invalid operands for ret instruction");
+      return parse_error(parser, "Invalid operands for ret instruction");
+    break;
   }
 
-  else if (strcmp(ins->name, "shl") == 0) {
+  case OC8_AS_MN_SHL: {
     // shl %v<Src:Y>, %v<Dst:X> (8XYE)
     if (nops == 2 && is_op_vreg(op0) && is_op_vreg(op1)) {
       unsigned r_src = vreg_idx(op0);
@@ -726,10 +600,11 @@ static void add_ins(parser_t *parser, as_ins_t *ins) {
     }
 
     else
-      reader_error(&parser->is, "Invalid operands for shl instruction");
+      return parse_error(parser, "Invalid operands for shl instruction");
+    break;
   }
 
-  else if (strcmp(ins->name, "shr") == 0) {
+  case OC8_AS_MN_SHR: {
     // shr %v<Src:Y>, %v<Dst:X> (8XY6)
     if (nops == 2 && is_op_vreg(op0) && is_op_vreg(op1)) {
       unsigned r_src = vreg_idx(op0);
@@ -738,18 +613,19 @@ static void add_ins(parser_t *parser, as_ins_t *ins) {
     }
 
     else
-      reader_error(&parser->is, "Invalid operands for shr instruction");
+      return parse_error(parser, "Invalid operands for shr instruction");
+    break;
   }
 
-  else if (strcmp(ins->name, "skpe") == 0) {
+  case OC8_AS_MN_SKPE: {
     // skpe <Y:NN>, %v<X:X> (3XNN)
     if (nops == 2 && op0->type == OP_TYPE_IMM && is_op_vreg(op1)) {
       unsigned i_x = op0->val_imm;
       if (i_x > 0xFF)
-        reader_error(&parser->is, "skpe imediate operand must be <= 0xFF");
+        return parse_error(parser, "skpe imediate operand must be <= 0xFF");
       unsigned r_y = vreg_idx(op1);
       if (sym)
-        oc8_as_sfile_sins_skpe_imm(sf, sym, r_y);
+        err = oc8_as_sfile_sins_skpe_imm(sf, sym, r_y);
       else
         oc8_as_sfile_ins_skpe_imm(sf, i_x, r_y);
     }
@@ -762,18 +638,19 @@ static void add_ins(parser_t *parser, as_ins_t *ins) {
     }
 
     else
-      reader_error(&parser->is, "Invalid operands for skpe instruction");
+      return parse_error(parser, "Invalid operands for skpe instruction");
+    break;
   }
 
-  else if (strcmp(ins->name, "skpn") == 0) {
+  case OC8_AS_MN_SKPN: {
     // skpn <Y:NN>, %v<X:X> (4XNN)
     if (nops == 2 && op0->type == OP_TYPE_IMM && is_op_vreg(op1)) {
       unsigned i_x = op0->val_imm;
       if (i_x > 0xFF)
-        reader_error(&parser->is, "skpn imediate operand must be <= 0xFF");
+        return parse_error(parser, "skpn imediate operand must be <= 0xFF");
       unsigned r_y = vreg_idx(op1);
       if (sym)
-        oc8_as_sfile_sins_skpn_imm(sf, sym, r_y);
+        err = oc8_as_sfile_sins_skpn_imm(sf, sym, r_y);
       else
         oc8_as_sfile_ins_skpn_imm(sf, i_x, r_y);
     }
@@ -786,10 +663,11 @@ static void add_ins(parser_t *parser, as_ins_t *ins) {
     }
 
     else
-      reader_error(&parser->is, "Invalid operands for skpn instruction");
+      return parse_error(parser, "Invalid operands for skpn instruction");
+    break;
   }
 
-  else if (strcmp(ins->name, "skpkp") == 0) {
+  case OC8_AS_MN_SKPKP: {
     // skpkp %v<K:X> (EX9E)
     if (nops == 1 && is_op_vreg(op0)) {
       unsigned r_src = vreg_idx(op0);
@@ -797,10 +675,11 @@ static void add_ins(parser_t *parser, as_ins_t *ins) {
     }
 
     else
-      reader_error(&parser->is, "Invalid operands for skpkp instruction");
+      return parse_error(parser, "Invalid operands for skpkp instruction");
+    break;
   }
 
-  else if (strcmp(ins->name, "skpkn") == 0) {
+  case OC8_AS_MN_SKPKN: {
     // skpkn %v<K:X> (EXA1)
     if (nops == 1 && is_op_vreg(op0)) {
       unsigned r_src = vreg_idx(op0);
@@ -808,10 +687,11 @@ static void add_ins(parser_t *parser, as_ins_t *ins) {
     }
 
     else
-      reader_error(&parser->is, "Invalid operands for skpkn instruction");
+      return parse_error(parser, "Invalid operands for skpkn instruction");
+    break;
   }
 
-  else if (strcmp(ins->name, "sub") == 0) {
+  case OC8_AS_MN_SUB: {
     // sub %v<Src:Y>, %v<Dst:X> (8XY5)
     if (nops == 2 && is_op_vreg(op0) && is_op_vreg(op1)) {
       unsigned r_src = vreg_idx(op0);
@@ -820,10 +700,11 @@ static void add_ins(parser_t *parser, as_ins_t *ins) {
     }
 
     else
-      reader_error(&parser->is, "Invalid operands for sub instruction");
+      return parse_error(parser, "Invalid operands for sub instruction");
+    break;
   }
 
-  else if (strcmp(ins->name, "subn") == 0) {
+  case OC8_AS_MN_SUBN: {
     // subn %v<Src:Y>, %v<Dst:X> (8XY7)
     if (nops == 2 && is_op_vreg(op0) && is_op_vreg(op1)) {
       unsigned r_src = vreg_idx(op0);
@@ -832,24 +713,26 @@ static void add_ins(parser_t *parser, as_ins_t *ins) {
     }
 
     else
-      reader_error(&parser->is, "Invalid operands for subn instruction");
+      return parse_error(parser, "Invalid operands for subn instruction");
+    break;
   }
 
-  else if (strcmp(ins->name, "sys") == 0) {
+  case OC8_AS_MN_SYS: {
     // sys <Addr:NNN> (0NNN)
     if (nops == 1 && op0->type == OP_TYPE_IMM) {
       unsigned i_addr = op0->val_imm;
       if (i_addr > 0xFFF)
-        reader_error(&parser->is, "sys imediate operand must be <= 0xFFF");
+        return parse_error(parser, "sys imediate operand must be <= 0xFFF");
       if (sym)
-        oc8_as_sfile_sins_sys(sf, sym);
+        err = oc8_as_sfile_sins_sys(sf, sym);
       else
         oc8_as_sfile_ins_sys(sf, i_addr);
     } else
-      reader_error(&parser->is, "Invalid operands for sys instruction");
+      return parse_error(parser, "Invalid operands for sys instruction");
+    break;
   }
 
-  else if (strcmp(ins->name, "waitk") == 0) {
+  case OC8_AS_MN_WAITK: {
     // waitk %v<Dst:X> (FX0A)
     if (nops == 1 && is_op_vreg(op0)) {
       unsigned r_dst = vreg_idx(op0);
@@ -857,10 +740,11 @@ static void add_ins(parser_t *parser, as_ins_t *ins) {
     }
 
     else
-      reader_error(&parser->is, "Invalid operands for waitk instruction");
+      return parse_error(parser, "Invalid operands for waitk instruction");
+    break;
   }
 
-  else if (strcmp(ins->name, "xor") == 0) {
+  case OC8_AS_MN_XOR: {
     // xor %v<Src:Y>, %v<Dst:X> (8XY3)
     if (nops == 2 && is_op_vreg(op0) && is_op_vreg(op1)) {
       unsigned r_src = vreg_idx(op0);
@@ -869,83 +753,231 @@ static void add_ins(parser_t *parser, as_ins_t *ins) {
     }
 
     else
-      reader_error(&parser->is, "Invalid operands for subn instruction");
+      return parse_error(parser, "Invalid operands for subn instruction");
+    break;
   }
 
-  else
-    reader_error(&parser->is, "Unknown instruction");
+  default:
+    return parse_error(parser, "Unknown instruction");
+  }
+  return err;
 }
 
 // Try to parse a declaration
-// Returns 1 if OK, 0 if EOF reached
-static int r_decl(parser_t *ps) {
-  skip_ws(&ps->is, /*skip_nl=*/1);
-  int c = reader_peekc(&ps->is);
-  if (c == EOF)
+// Returns 1 if OK, 0 if EOF reached, -1 on error
+static int p_decl(parser_t *ps) {
+  const oc8_as_token_t *tok = &ps->lx.tok;
+  while (tok->kind == OC8_AS_TOK_NL)
+    tok_next(ps);
+  if (tok->kind == OC8_AS_TOK_EOF)
     return 0;
 
-  // parse comment
-  if (c == '#') {
-    r_comment(&ps->is);
-    return 1;
-  }
-
   // parse directive
-  if (c == '.') {
-    r_dir(ps);
-    return 1;
-  }
+  if (tok->kind == OC8_AS_TOK_DIR)
+    return p_dir(ps) ? -1 : 1;
 
   // parse instruction or label
-  as_ins_t ins;
-  int is_ins = r_ins_or_label(&ps->is, &ins);
-  if (!is_ins) {
-    oc8_as_sfile_add_sym(ps->sf, ins.name);
-    return 1;
+  char name[OC8_MAX_SYM_SIZE + 1];
+  oc8_as_mn_t mn = (oc8_as_mn_t)tok->val;
+  if (p_id(ps, name, "Expected an instruction, a label or a directive"))
+    return -1;
+  if (tok->kind == OC8_AS_TOK_COLON) {
+    tok_next(ps);
+    return oc8_as_sfile_add_sym(ps->sf, name) ? -1 : 1;
   }
 
-  add_ins(ps, &ins);
+  if (mn == OC8_AS_MN_NONE)
+    return parse_error(ps, "Unknown instruction");
+  as_ins_t ins;
+  ins.mn = mn;
+  if (p_ops(ps, &ins) || add_ins(ps, &ins))
+    return -1;
   return 1;
 }
 
-static void r_file(parser_t *ps) {
-  while (r_decl(ps))
+static int p_file(parser_t *ps) {
+  int res;
+  while ((res = p_decl(ps)) > 0)
     continue;
+  return res;
 }
 
 oc8_as_sfile_t *oc8_as_run_parser(oc8_as_stream_t *is, const char *is_name) {
-  oc8_as_sfile_t *sf = oc8_as_sfile_new();
+  return oc8_as_run_parser_arena(is, is_name, NULL);
+}
+
+// Parse `is`, that starts at line `row` of the input
+// Returns NULL on error
+static oc8_as_sfile_t *run_parser(oc8_as_stream_t *is, const char *is_name,
+                                  size_t row, oc8_arena_t *arena) {
+  oc8_as_sfile_t *sf = oc8_as_sfile_new_arena(arena);
   parser_t ps;
-  ps.is.row = 1;
-  ps.is.col = 1;
-  ps.is.is = is;
-  ps.is.name = is_name ? is_name : "???";
+  oc8_as_lexer_init_at(&ps.lx, is, is_name, row);
   ps.sf = sf;
-  r_file(&ps);
+  if (p_file(&ps)) {
+    oc8_as_sfile_free(sf);
+    return NULL;
+  }
   return sf;
 }
 
+oc8_as_sfile_t *oc8_as_run_parser_arena(oc8_as_stream_t *is,
+                                        const char *is_name,
+                                        oc8_arena_t *arena) {
+  return run_parser(is, is_name, 1, arena);
+}
+
 /// Parse an input file to build an sfile
 /// User is reponsible for deallocating the sfile
 /// @returns pointer to newly allocated sfile
 oc8_as_sfile_t *oc8_as_parse_file(const char *path) {
-  FILE *f = fopen(path, "r");
-  if (!f) {
+  return oc8_as_parse_file_arena(path, NULL);
+}
+
+oc8_as_sfile_t *oc8_as_parse_file_arena(const char *path, oc8_arena_t *arena) {
+  oc8_as_stream_t is;
+  if (oc8_as_stream_init_from_path(&is, path) != 0) {
     fprintf(stderr, "oc8_as_parser: failed to open input file `%s`\n", path);
-    PANIC();
+    return NULL;
   }
-  oc8_as_stream_t is;
-  oc8_as_stream_init_from_file(&is, f);
-  oc8_as_sfile_t *res = oc8_as_run_parser(&is, path);
+  oc8_as_sfile_t *res = oc8_as_run_parser_arena(&is, path, arena);
   oc8_as_stream_free(&is);
-  fclose(f);
   return res;
 }
 
 oc8_as_sfile_t *oc8_as_parse_raw(const char *str, size_t len) {
+  return oc8_as_parse_raw_arena(str, len, NULL);
+}
+
+oc8_as_sfile_t *oc8_as_parse_raw_arena(const char *str, size_t len,
+                                       oc8_arena_t *arena) {
   oc8_as_stream_t is;
   oc8_as_stream_init_from_raw(&is, str, len);
-  oc8_as_sfile_t *res = oc8_as_run_parser(&is, "(raw string)");
+  oc8_as_sfile_t *res = oc8_as_run_parser_arena(&is, "(raw string)", arena);
   oc8_as_stream_free(&is);
   return res;
 }
+
+typedef struct {
+  const char *begin;
+  size_t len;
+  size_t row; // first line of the chunk in the input
+  oc8_arena_t arena;
+  oc8_as_sfile_t *sf;
+  int err;
+} chunk_t;
+
+typedef struct {
+  const char *is_name;
+  chunk_t *chunks;
+} chunks_job_t;
+
+// First pass: count the lines of every chunk (in `row`)
+static void count_chunk_lines(void *arg, size_t idx) {
+  chunk_t *ch = &((chunks_job_t *)arg)->chunks[idx];
+  const char *cur = ch->begin;
+  const char *end = ch->begin + ch->len;
+  size_t res = 0;
+  while ((cur = memchr(cur, '\n', end - cur)) != NULL) {
+    ++cur;
+    ++res;
+  }
+  ch->row = res;
+}
+
+// Second pass: parse every chunk in its own sfile
+// Errors only stop this chunk
+static void parse_chunk(void *arg, size_t idx) {
+  chunks_job_t *job = (chunks_job_t *)arg;
+  chunk_t *ch = &job->chunks[idx];
+  oc8_arena_init(&ch->arena, 0);
+
+  oc8_as_stream_t is;
+  oc8_as_stream_init_from_raw(&is, ch->begin, ch->len);
+  ch->sf = run_parser(&is, job->is_name, ch->row, &ch->arena);
+  oc8_as_stream_free(&is);
+  ch->err = ch->sf == NULL; // The message was already printed
+}
+
+// Returns NULL on error
+static oc8_as_sfile_t *merge_chunks(chunk_t *chunks, size_t nb_chunks,
+                                    oc8_arena_t *arena) {
+  oc8_as_sfile_t *sf = oc8_as_sfile_new_arena(arena);
+  for (size_t i = 0; i < nb_chunks; ++i)
+    if (oc8_as_sfile_append(sf, chunks[i].sf)) {
+      oc8_as_sfile_free(sf);
+      return NULL;
+    }
+  return sf;
+}
+
+oc8_as_sfile_t *oc8_as_parse_raw_parallel(const char *str, size_t len,
+                                          const char *is_name,
+                                          oc8_pool_t *pool, size_t chunk_size,
+                                          oc8_arena_t *arena) {
+  if (!chunk_size)
+    chunk_size = OC8_AS_PARSE_CHUNK_SIZE;
+
+  // Split at line boundaries: every chunk but the last is a bit bigger than
+  // `chunk_size`
+  chunk_t *chunks = malloc((len / chunk_size + 1) * sizeof(chunk_t));
+  size_t nb_chunks = 0;
+  const char *cur = str;
+  const char *end = str + len;
+  while (cur < end) {
+    const char *next = end;
+    if ((size_t)(end - cur) > chunk_size) {
+      const char *nl = memchr(cur + chunk_size, '\n', end - cur - chunk_size);
+      next = nl ? nl + 1 : end;
+    }
+    chunks[nb_chunks].begin = cur;
+    chunks[nb_chunks].len = next - cur;
+    ++nb_chunks;
+    cur = next;
+  }
+
+  if (nb_chunks <= 1) {
+    free(chunks);
+    oc8_as_stream_t is;
+    oc8_as_stream_init_from_raw(&is, str, len);
+    oc8_as_sfile_t *res = run_parser(&is, is_name, 1, arena);
+    oc8_as_stream_free(&is);
+    return res;
+  }
+
+  chunks_job_t job;
+  job.is_name = is_name;
+  job.chunks = chunks;
+  oc8_pool_run(pool, count_chunk_lines, &job, nb_chunks);
+  size_t row = 1;
+  for (size_t i = 0; i < nb_chunks; ++i) {
+    size_t nb_lines = chunks[i].row;
+    chunks[i].row = row;
+    row += nb_lines;
+  }
+  oc8_pool_run(pool, parse_chunk, &job, nb_chunks);
+
+  int err = 0;
+  for (size_t i = 0; i < nb_chunks; ++i)
+    err |= chunks[i].err;
+
+  // Merge in input order, can fail on symbols defined in 2 chunks
+  oc8_as_sfile_t *res = err ? NULL : merge_chunks(chunks, nb_chunks, arena);
+
+  for (size_t i = 0; i < nb_chunks; ++i)
+    oc8_arena_free(&chunks[i].arena);
+  free(chunks);
+  return res;
+}
+
+oc8_as_sfile_t *oc8_as_parse_file_parallel(const char *path, oc8_pool_t *pool,
+                                           oc8_arena_t *arena) {
+  oc8_bin_map_t map;
+  if (oc8_bin_map_open(&map, path) != 0)
+    return oc8_as_parse_file_arena(path, arena);
+
+  oc8_as_sfile_t *res = oc8_as_parse_raw_parallel(
+      (const char *)map.data, map.size, path, pool, 0, arena);
+  oc8_bin_map_close(&map);
+  return res;
+}
@@ -1,13 +1,12 @@
 #include "oc8_as/sfile.h"
-#include "oc8_defs/debug.h"
 #include "oc8_defs/oc8_defs.h"
 
-#include <assert.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
 #include "oc8_is/ins.h"
+#include "oc8_smap/oc8_strpool.h"
 
 #define BASE_ITEMS_LENGTH 256
 #define POS_UNDEF ((uint16_t)-1)
@@ -16,9 +15,11 @@
 static void add_item(oc8_as_sfile_t *as, oc8_as_data_item_t item) {
   item.pos = as->curr_addr;
   if (as->items_size == as->items_cap) {
+    size_t old_size = as->items_cap * sizeof(oc8_as_data_item_t);
     as->items_cap *= 2;
     as->items_arr =
-        realloc(as->items_arr, as->items_cap * sizeof(oc8_as_data_item_t));
+        oc8_arena_realloc(as->arena, as->items_arr, old_size,
+                          as->items_cap * sizeof(oc8_as_data_item_t));
   }
 
   as->items_arr[as->items_size++] = item;
@@ -28,80 +29,107 @@ static void add_item(oc8_as_sfile_t *as, oc8_as_data_item_t item) {
 /// operands must already be filled
 /// op_sym is NULL usually, or the sym if one of the operands is a symbol
 /// No need to precise which, there is no ins with 2 immediate operands
-static void add_ins(oc8_as_sfile_t *as, oc8_is_ins_t *ins, oc8_is_type_t type,
-                    const char *op_sym) {
+/// @returns 0 if success, != 0 if the symbol is invalid
+static int add_ins(oc8_as_sfile_t *as, oc8_is_ins_t *ins, oc8_is_type_t type,
+                   const char *op_sym) {
   ins->opcode = 0;
   ins->type = type;
   oc8_is_encode_ins(ins, NULL);
 
   oc8_as_data_item_t item;
   item.sym_idx = op_sym ? oc8_as_sfile_get_sym_idx(as, op_sym) : 0;
+  if (op_sym && !item.sym_idx)
+    return -1;
   item.type = OC8_AS_DATA_ITEM_TYPE_INS;
   item.ins_opcode = ins->opcode;
   add_item(as, item);
   as->curr_addr += OPCODE_SIZE;
+  return 0;
 }
 
+/// @returns the definition of `sym`, created if needed, or NULL on error
 static oc8_as_sym_def_t *add_sym_def(oc8_as_sfile_t *as, const char *sym) {
   // Check if already exists
   oc8_smap_node_t *node = oc8_smap_find(&as->syms_defs_map, sym);
   if (node)
     return &as->syms_defs_arr[node->val];
 
+  // generate entry in syms_map if none already
+  if (!oc8_as_sfile_get_sym_idx(as, sym))
+    return NULL;
+
   // Insert in syms_defs_map
   size_t idx = as->syms_defs_size++;
   oc8_smap_insert(&as->syms_defs_map, sym, idx);
-  node = oc8_smap_find(&as->syms_defs_map, sym);
-  assert(node);
 
   // Insert in syms_defs_list
   oc8_as_sym_def_t *def = &as->syms_defs_arr[idx];
-  def->name = node->key;
+  def->name = oc8_strpool_intern(sym);
   def->pos = POS_UNDEF;
   def->size = 0;
   def->type = OC8_AS_DATA_SYM_TYPE_NO;
   def->is_global = 0;
+  def->has_size = 0;
+  return def;
+}
 
-  // generate entry in syms_map if none already
-  oc8_as_sfile_get_sym_idx(as, sym);
+static oc8_as_sym_def_t *define_sym(oc8_as_sfile_t *as, const char *sym,
+                                    uint16_t pos) {
+  // Check for label redefinition
+  oc8_as_sym_def_t *def = add_sym_def(as, sym);
+  if (!def)
+    return NULL;
+  if (def->pos != POS_UNDEF) {
+    fprintf(stderr,
+            "oc8_as_sfile_add_sym: Defining symbol `%s`, but there is already "
+            "one with the same name\n",
+            sym);
+    return NULL;
+  }
+
+  // Update position
+  def->pos = pos;
   return def;
 }
 
-oc8_as_sfile_t *oc8_as_sfile_new() {
-  oc8_as_sfile_t *as = (oc8_as_sfile_t *)malloc(sizeof(oc8_as_sfile_t));
-  as->items_arr = malloc(BASE_ITEMS_LENGTH * sizeof(oc8_as_data_item_t));
+oc8_as_sfile_t *oc8_as_sfile_new() { return oc8_as_sfile_new_arena(NULL); }
+
+oc8_as_sfile_t *oc8_as_sfile_new_arena(oc8_arena_t *arena) {
+  oc8_as_sfile_t *as = oc8_arena_alloc(arena, sizeof(oc8_as_sfile_t));
+  as->arena = arena;
+  as->items_arr =
+      oc8_arena_alloc(arena, BASE_ITEMS_LENGTH * sizeof(oc8_as_data_item_t));
   as->items_size = 0;
   as->items_cap = BASE_ITEMS_LENGTH;
   as->curr_addr = 0;
 
   as->syms_defs_size = 0;
-  oc8_smap_init(&as->syms_defs_map);
+  oc8_smap_init_arena(&as->syms_defs_map, arena);
 
-  oc8_smap_init(&as->syms_map);
+  oc8_smap_init_arena(&as->syms_map, arena);
   as->next_sym_idx = 1;
 
-  oc8_smap_init(&as->equ_map);
+  oc8_smap_init_arena(&as->equ_map, arena);
   return as;
 }
 
 void oc8_as_sfile_free(oc8_as_sfile_t *as) {
-  free(as->items_arr);
+  oc8_arena_release(as->arena, as->items_arr);
   oc8_smap_free(&as->syms_defs_map);
   oc8_smap_free(&as->syms_map);
   oc8_smap_free(&as->equ_map);
-  free(as);
+  oc8_arena_release(as->arena, as);
 }
 
 /// Make sure the sfile is valid
-/// If it's not, the program abort
 /// Possible errors are:
 /// - empty file
 /// - trying to set properties (type, size, globl) of extern symbol
-void oc8_as_sfile_check(oc8_as_sfile_t *as) {
+int oc8_as_sfile_check(oc8_as_sfile_t *as) {
   // - empty file
   if (as->curr_addr == 0) {
-    fprintf(stderr, "oc8_as_sfile_check: File is empty");
-    PANIC();
+    fprintf(stderr, "oc8_as_sfile_check: File is empty\n");
+    return -1;
   }
 
   // - trying to set properties (type, size, globl) of extern symbol
@@ -109,35 +137,25 @@ void oc8_as_sfile_check(oc8_as_sfile_t *as) {
     oc8_as_sym_def_t *def = &as->syms_defs_arr[i];
     if (def->pos == POS_UNDEF) {
       fprintf(stderr,
-              "oc8_as_sfile_check: cannot set property of extern symbol `%s`",
+              "oc8_as_sfile_check: cannot set property of extern symbol `%s`\n",
               def->name);
-      PANIC();
+      return -1;
     }
   }
+  return 0;
 }
 
-void oc8_as_sfile_add_sym(oc8_as_sfile_t *as, const char *sym) {
+int oc8_as_sfile_add_sym(oc8_as_sfile_t *as, const char *sym) {
   size_t len = strlen(sym);
   if (len > OC8_MAX_SYM_SIZE) {
     fprintf(stderr,
             "oc8_as_sfile_add_sym: trying to add symbol `%s` of size %u, but "
             "max size is %u\n",
             sym, (unsigned)len, (unsigned)OC8_MAX_SYM_SIZE);
-    PANIC();
-  }
-
-  // Check for label redefinition
-  oc8_as_sym_def_t *def = add_sym_def(as, sym);
-  if (def->pos != POS_UNDEF) {
-    fprintf(stderr,
-            "oc8_as_sfile_add_sym: Defining symbol `%s`, but there is already "
-            "one with the same name",
-            sym);
-    PANIC();
+    return -1;
   }
 
-  // Update position
-  def->pos = as->curr_addr;
+  return define_sym(as, sym, as->curr_addr) ? 0 : -1;
 }
 
 uint16_t oc8_as_sfile_get_sym_idx(oc8_as_sfile_t *as, const char *sym) {
@@ -152,7 +170,17 @@ uint16_t oc8_as_sfile_get_sym_idx(oc8_as_sfile_t *as, const char *sym) {
         "oc8_as_sfile_get_sym_idx: trying to add symbol `%s` of size %u, but "
         "max size is %u\n",
         sym, (unsigned)len, (unsigned)OC8_MAX_SYM_SIZE);
-    PANIC();
+    return 0;
+  }
+
+  // The definitions are stored in a fixed array, there is at most one per
+  // symbol: bounding the symbols is enough
+  if (as->next_sym_idx > OC8_AS_MAX_SYMS) {
+    fprintf(stderr,
+            "oc8_as_sfile_get_sym_idx: trying to add symbol `%s`, but there "
+            "are already %u symbols (max)\n",
+            sym, (unsigned)OC8_AS_MAX_SYMS);
+    return 0;
   }
 
   uint16_t id = as->next_sym_idx++;
@@ -165,6 +193,94 @@ size_t *oc8_as_sfile_get_equ(oc8_as_sfile_t *as, const char *key) {
   return node ? &(node->val) : NULL;
 }
 
+int oc8_as_sfile_append(oc8_as_sfile_t *as, oc8_as_sfile_t *other) {
+  // Symbols: indices of `other` are given in order of first use, so creating
+  // them in index order gives the same order than a serial build
+  size_t nb_syms = other->next_sym_idx;
+  const char **names =
+      oc8_arena_alloc(as->arena, nb_syms * sizeof(const char *));
+  uint16_t *ids_map = oc8_arena_alloc(as->arena, nb_syms * sizeof(uint16_t));
+  oc8_smap_it_t it = oc8_smap_get_it(&other->syms_map);
+  for (; oc8_smap_it_get(&it); oc8_smap_it_next(&it))
+    names[oc8_smap_it_get(&it)->val] = oc8_smap_it_get(&it)->key;
+  int res = 0;
+  ids_map[0] = 0;
+  for (size_t i = 1; i < nb_syms && !res; ++i)
+    if (!(ids_map[i] = oc8_as_sfile_get_sym_idx(as, names[i])))
+      res = -1;
+
+  // Definitions, the properties set in `other` override those of `as`
+  uint16_t base = as->curr_addr;
+  for (size_t i = 0; i < other->syms_defs_size && !res; ++i) {
+    oc8_as_sym_def_t *src = &other->syms_defs_arr[i];
+    oc8_as_sym_def_t *def = src->pos != POS_UNDEF
+                                ? define_sym(as, src->name, base + src->pos)
+                                : add_sym_def(as, src->name);
+    if (!def) {
+      res = -1;
+      break;
+    }
+    if (src->has_size) {
+      def->size = src->size;
+      def->has_size = 1;
+    }
+    if (src->type != OC8_AS_DATA_SYM_TYPE_NO)
+      def->type = src->type;
+    if (src->is_global)
+      def->is_global = 1;
+  }
+
+  // Items, check the alignments before adding anything
+  for (size_t i = 0; i < other->items_size && !res; ++i) {
+    oc8_as_data_item_t *item = &other->items_arr[i];
+    if (item->type == OC8_AS_DATA_ITEM_TYPE_ALIGN &&
+        base % item->align_nbytes != 0) {
+      fprintf(stderr,
+              "oc8_as_sfile_append: cannot move .align %u to position %u\n",
+              (unsigned)item->align_nbytes, (unsigned)base);
+      res = -1;
+    }
+  }
+  if (res) {
+    oc8_arena_release(as->arena, ids_map);
+    oc8_arena_release(as->arena, names);
+    return res;
+  }
+
+  // Items, reserve all the space at once
+  size_t new_size = as->items_size + other->items_size;
+  if (new_size > as->items_cap) {
+    size_t old_size = as->items_cap * sizeof(oc8_as_data_item_t);
+    while (as->items_cap < new_size)
+      as->items_cap *= 2;
+    as->items_arr =
+        oc8_arena_realloc(as->arena, as->items_arr, old_size,
+                          as->items_cap * sizeof(oc8_as_data_item_t));
+  }
+  for (size_t i = 0; i < other->items_size; ++i) {
+    oc8_as_data_item_t item = other->items_arr[i];
+    item.sym_idx = ids_map[item.sym_idx];
+    item.pos = base + item.pos;
+    as->items_arr[as->items_size++] = item;
+  }
+  as->curr_addr = base + other->curr_addr;
+
+  // Constants
+  it = oc8_smap_get_it(&other->equ_map);
+  for (; oc8_smap_it_get(&it) && !res; oc8_smap_it_next(&it))
+    res = oc8_as_sfile_dir_equ(as, oc8_smap_it_get(&it)->key,
+                               oc8_smap_it_get(&it)->val);
+
+  oc8_arena_release(as->arena, ids_map);
+  oc8_arena_release(as->arena, names);
+  return res;
+}
+
+int oc8_as_sfile_add_ins(oc8_as_sfile_t *as, oc8_is_ins_t *ins,
+                         const char *op_sym) {
+  return add_ins(as, ins, ins->type, op_sym);
+}
+
 void oc8_as_sfile_ins_add_imm(oc8_as_sfile_t *as, uint8_t i_src,
                               uint8_t r_dst) {
   oc8_is_ins_t ins;
@@ -173,12 +289,12 @@ void oc8_as_sfile_ins_add_imm(oc8_as_sfile_t *as, uint8_t i_src,
   add_ins(as, &ins, OC8_IS_TYPE_7XNN, NULL);
 }
 
-void oc8_as_sfile_sins_add_imm(oc8_as_sfile_t *as, const char *s_src,
-                               uint8_t r_dst) {
+int oc8_as_sfile_sins_add_imm(oc8_as_sfile_t *as, const char *s_src,
+                              uint8_t r_dst) {
   oc8_is_ins_t ins;
   ins.operands[0] = r_dst;
   ins.operands[1] = 0;
-  add_ins(as, &ins, OC8_IS_TYPE_7XNN, s_src);
+  return add_ins(as, &ins, OC8_IS_TYPE_7XNN, s_src);
 }
 
 void oc8_as_sfile_ins_add(oc8_as_sfile_t *as, uint8_t r_src, uint8_t r_dst) {
@@ -213,10 +329,10 @@ void oc8_as_sfile_ins_call(oc8_as_sfile_t *as, uint16_t i_addr) {
   add_ins(as, &ins, OC8_IS_TYPE_2NNN, NULL);
 }
 
-void oc8_as_sfile_sins_call(oc8_as_sfile_t *as, const char *s_addr) {
+int oc8_as_sfile_sins_call(oc8_as_sfile_t *as, const char *s_addr) {
   oc8_is_ins_t ins;
   ins.operands[0] = 0;
-  add_ins(as, &ins, OC8_IS_TYPE_2NNN, s_addr);
+  return add_ins(as, &ins, OC8_IS_TYPE_2NNN, s_addr);
 }
 
 void oc8_as_sfile_ins_cls(oc8_as_sfile_t *as) {
@@ -233,13 +349,13 @@ void oc8_as_sfile_ins_draw(oc8_as_sfile_t *as, uint8_t r_x, uint8_t r_y,
   add_ins(as, &ins, OC8_IS_TYPE_DXYN, NULL);
 }
 
-void oc8_as_sfile_sins_draw(oc8_as_sfile_t *as, uint8_t r_x, uint8_t r_y,
-                            const char *s_h) {
+int oc8_as_sfile_sins_draw(oc8_as_sfile_t *as, uint8_t r_x, uint8_t r_y,
+                           const char *s_h) {
   oc8_is_ins_t ins;
   ins.operands[0] = r_x;
   ins.operands[1] = r_y;
   ins.operands[2] = 0;
-  add_ins(as, &ins, OC8_IS_TYPE_DXYN, s_h);
+  return add_ins(as, &ins, OC8_IS_TYPE_DXYN, s_h);
 }
 
 void oc8_as_sfile_ins_fspr(oc8_as_sfile_t *as, uint8_t r_src) {
@@ -254,10 +370,10 @@ void oc8_as_sfile_ins_jmp(oc8_as_sfile_t *as, uint16_t i_addr) {
   add_ins(as, &ins, OC8_IS_TYPE_1NNN, NULL);
 }
 
-void oc8_as_sfile_sins_jmp(oc8_as_sfile_t *as, const char *s_addr) {
+int oc8_as_sfile_sins_jmp(oc8_as_sfile_t *as, const char *s_addr) {
   oc8_is_ins_t ins;
   ins.operands[0] = 0;
-  add_ins(as, &ins, OC8_IS_TYPE_1NNN, s_addr);
+  return add_ins(as, &ins, OC8_IS_TYPE_1NNN, s_addr);
 }
 
 void oc8_as_sfile_ins_jmp_v0(oc8_as_sfile_t *as, uint16_t i_addr) {
@@ -266,10 +382,10 @@ void oc8_as_sfile_ins_jmp_v0(oc8_as_sfile_t *as, uint16_t i_addr) {
   add_ins(as, &ins, OC8_IS_TYPE_BNNN, NULL);
 }
 
-void oc8_as_sfile_sins_jmp_v0(oc8_as_sfile_t *as, const char *s_addr) {
+int oc8_as_sfile_sins_jmp_v0(oc8_as_sfile_t *as, const char *s_addr) {
   oc8_is_ins_t ins;
   ins.operands[0] = 0;
-  add_ins(as, &ins, OC8_IS_TYPE_BNNN, s_addr);
+  return add_ins(as, &ins, OC8_IS_TYPE_BNNN, s_addr);
 }
 
 void oc8_as_sfile_ins_mov_imm(oc8_as_sfile_t *as, uint8_t i_src,
@@ -280,12 +396,12 @@ void oc8_as_sfile_ins_mov_imm(oc8_as_sfile_t *as, uint8_t i_src,
   add_ins(as, &ins, OC8_IS_TYPE_6XNN, NULL);
 }
 
-void oc8_as_sfile_sins_mov_imm(oc8_as_sfile_t *as, const char *s_src,
-                               uint8_t r_dst) {
+int oc8_as_sfile_sins_mov_imm(oc8_as_sfile_t *as, const char *s_src,
+                              uint8_t r_dst) {
   oc8_is_ins_t ins;
   ins.operands[0] = r_dst;
   ins.operands[1] = 0;
-  add_ins(as, &ins, OC8_IS_TYPE_6XNN, s_src);
+  return add_ins(as, &ins, OC8_IS_TYPE_6XNN, s_src);
 }
 
 void oc8_as_sfile_ins_mov(oc8_as_sfile_t *as, uint8_t r_src, uint8_t r_dst) {
@@ -301,10 +417,10 @@ void oc8_as_sfile_ins_mov_i(oc8_as_sfile_t *as, uint16_t i_addr) {
   add_ins(as, &ins, OC8_IS_TYPE_ANNN, NULL);
 }
 
-void oc8_as_sfile_sins_mov_i(oc8_as_sfile_t *as, const char *s_addr) {
+int oc8_as_sfile_sins_mov_i(oc8_as_sfile_t *as, const char *s_addr) {
   oc8_is_ins_t ins;
   ins.operands[0] = 0;
-  add_ins(as, &ins, OC8_IS_TYPE_ANNN, s_addr);
+  return add_ins(as, &ins, OC8_IS_TYPE_ANNN, s_addr);
 }
 
 void oc8_as_sfile_ins_mov_fdt(oc8_as_sfile_t *as, uint8_t r_dst) {
@@ -351,12 +467,12 @@ void oc8_as_sfile_ins_rand(oc8_as_sfile_t *as, uint8_t i_mask, uint8_t r_dst) {
   add_ins(as, &ins, OC8_IS_TYPE_CXNN, NULL);
 }
 
-void oc8_as_sfile_sins_rand(oc8_as_sfile_t *as, const char *s_mask,
-                            uint8_t r_dst) {
+int oc8_as_sfile_sins_rand(oc8_as_sfile_t *as, const char *s_mask,
+                           uint8_t r_dst) {
   oc8_is_ins_t ins;
   ins.operands[0] = r_dst;
   ins.operands[1] = 0;
-  add_ins(as, &ins, OC8_IS_TYPE_CXNN, s_mask);
+  return add_ins(as, &ins, OC8_IS_TYPE_CXNN, s_mask);
 }
 
 void oc8_as_sfile_ins_ret(oc8_as_sfile_t *as) {
@@ -385,12 +501,12 @@ void oc8_as_sfile_ins_skpe_imm(oc8_as_sfile_t *as, uint8_t i_y, uint8_t r_x) {
   add_ins(as, &ins, OC8_IS_TYPE_3XNN, NULL);
 }
 
-void oc8_as_sfile_sins_skpe_imm(oc8_as_sfile_t *as, const char *s_y,
-                                uint8_t r_x) {
+int oc8_as_sfile_sins_skpe_imm(oc8_as_sfile_t *as, const char *s_y,
+                               uint8_t r_x) {
   oc8_is_ins_t ins;
   ins.operands[0] = r_x;
   ins.operands[1] = 0;
-  add_ins(as, &ins, OC8_IS_TYPE_3XNN, s_y);
+  return add_ins(as, &ins, OC8_IS_TYPE_3XNN, s_y);
 }
 
 void oc8_as_sfile_ins_skpe(oc8_as_sfile_t *as, uint8_t r_y, uint8_t r_x) {
@@ -407,12 +523,12 @@ void oc8_as_sfile_ins_skpn_imm(oc8_as_sfile_t *as, uint8_t i_y, uint8_t r_x) {
   add_ins(as, &ins, OC8_IS_TYPE_4XNN, NULL);
 }
 
-void oc8_as_sfile_sins_skpn_imm(oc8_as_sfile_t *as, const char *s_y,
-                                uint8_t r_x) {
+int oc8_as_sfile_sins_skpn_imm(oc8_as_sfile_t *as, const char *s_y,
+                               uint8_t r_x) {
   oc8_is_ins_t ins;
   ins.operands[0] = r_x;
   ins.operands[1] = 0;
-  add_ins(as, &ins, OC8_IS_TYPE_4XNN, s_y);
+  return add_ins(as, &ins, OC8_IS_TYPE_4XNN, s_y);
 }
 
 void oc8_as_sfile_ins_skpn(oc8_as_sfile_t *as, uint8_t r_y, uint8_t r_x) {
@@ -454,10 +570,10 @@ void oc8_as_sfile_ins_sys(oc8_as_sfile_t *as, uint16_t i_addr) {
   add_ins(as, &ins, OC8_IS_TYPE_0NNN, NULL);
 }
 
-void oc8_as_sfile_sins_sys(oc8_as_sfile_t *as, const char *s_addr) {
+int oc8_as_sfile_sins_sys(oc8_as_sfile_t *as, const char *s_addr) {
   oc8_is_ins_t ins;
   ins.operands[0] = 0;
-  add_ins(as, &ins, OC8_IS_TYPE_0NNN, s_addr);
+  return add_ins(as, &ins, OC8_IS_TYPE_0NNN, s_addr);
 }
 
 void oc8_as_sfile_ins_waitk(oc8_as_sfile_t *as, uint8_t r_dst) {
@@ -497,27 +613,38 @@ void oc8_as_sfile_dir_byte(oc8_as_sfile_t *as, uint8_t val) {
   as->curr_addr += 1;
 }
 
-void oc8_as_sfile_dir_globl(oc8_as_sfile_t *as, const char *sym) {
+int oc8_as_sfile_dir_globl(oc8_as_sfile_t *as, const char *sym) {
   oc8_as_sym_def_t *def = add_sym_def(as, sym);
+  if (!def)
+    return -1;
   def->is_global = 1;
+  return 0;
 }
 
-void oc8_as_sfile_dir_equ(oc8_as_sfile_t *as, const char *key, uint16_t val) {
+int oc8_as_sfile_dir_equ(oc8_as_sfile_t *as, const char *key, uint16_t val) {
   if (oc8_smap_insert(&as->equ_map, key, val) == 0) {
     fprintf(stderr, "oc8_as_file_dir_equ: Redefinition of cast %s\n", key);
-    exit(1);
+    return -1;
   }
+  return 0;
 }
 
-void oc8_as_sfile_dir_size(oc8_as_sfile_t *as, const char *sym, uint16_t size) {
+int oc8_as_sfile_dir_size(oc8_as_sfile_t *as, const char *sym, uint16_t size) {
   oc8_as_sym_def_t *def = add_sym_def(as, sym);
+  if (!def)
+    return -1;
   def->size = size;
+  def->has_size = 1;
+  return 0;
 }
 
-void oc8_as_sfile_dir_type(oc8_as_sfile_t *as, const char *sym,
-                           oc8_as_sym_type_t type) {
+int oc8_as_sfile_dir_type(oc8_as_sfile_t *as, const char *sym,
+                          oc8_as_sym_type_t type) {
   oc8_as_sym_def_t *def = add_sym_def(as, sym);
+  if (!def)
+    return -1;
   def->type = type;
+  return 0;
 }
 
 void oc8_as_sfile_dir_word(oc8_as_sfile_t *as, uint16_t val) {
@@ -2,76 +2,82 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
-typedef struct {
-  oc8_as_functor_fn_f fn;
-  FILE *is;
-} functor_file_t;
-
-typedef struct {
-  oc8_as_functor_fn_f fn;
-  const void *arr;
-  size_t len;
-  size_t idx;
-} functor_raw_t;
+static void init_stream(oc8_as_stream_t *is) {
+  memset(is, 0, sizeof(oc8_as_stream_t));
+}
 
-static int get_byte_fn_file(void *functor_ptr) {
-  functor_file_t *f_file = (functor_file_t *)functor_ptr;
-  return fgetc(f_file->is);
+static void set_block(oc8_as_stream_t *is, const char *data, size_t len) {
+  is->cur = data;
+  is->end = data + len;
+  is->nb_read += len;
 }
 
-static int get_byte_fn_raw(void *functor_ptr) {
-  functor_raw_t *f_raw = (functor_raw_t *)functor_ptr;
-  if (f_raw->idx == f_raw->len)
-    return EOF;
-  else
-    return ((char *)f_raw->arr)[f_raw->idx++];
+void oc8_as_stream_init_from_file(oc8_as_stream_t *is, FILE *f) {
+  init_stream(is);
+  is->f = f;
+  is->buf = malloc(OC8_AS_STREAM_BLOCK_SIZE);
 }
 
-static void init_stream(oc8_as_stream_t *is, oc8_as_functor_t *functor) {
-  is->getc_fn = functor;
-  is->last_def = 0;
+void oc8_as_stream_init_from_raw(oc8_as_stream_t *is, const void *arr,
+                                 size_t len) {
+  init_stream(is);
+  // The whole input is one block
+  set_block(is, (const char *)arr, len);
+  is->eof = 1;
 }
 
-static void load_last(oc8_as_stream_t *is) {
-  if (!is->last_def) {
-    is->last = is->getc_fn->fn(is->getc_fn);
-    is->last_def = 1;
+int oc8_as_stream_init_from_path(oc8_as_stream_t *is, const char *path) {
+  init_stream(is);
+  if (oc8_bin_map_open(&is->map, path) == 0) {
+    set_block(is, (const char *)is->map.data, is->map.size);
+    is->eof = 1;
+    return 0;
   }
-}
 
-static void clear_last(oc8_as_stream_t *is) {
-  if (is->last != EOF)
-    is->last_def = 0;
+  FILE *f = fopen(path, "r");
+  if (!f)
+    return -1;
+  oc8_as_stream_init_from_file(is, f);
+  is->own_f = 1;
+  return 0;
 }
 
-void oc8_as_stream_init_from_file(oc8_as_stream_t *is, FILE *f) {
-  functor_file_t *functor = (functor_file_t *)malloc(sizeof(functor_file_t));
-  functor->fn = get_byte_fn_file;
-  functor->is = f;
-  init_stream(is, (oc8_as_functor_t *)functor);
+void oc8_as_stream_init_from_functor(oc8_as_stream_t *is,
+                                     oc8_as_functor_t *functor) {
+  init_stream(is);
+  is->getc_fn = functor;
+  is->buf = malloc(OC8_AS_STREAM_BLOCK_SIZE);
 }
 
-void oc8_as_stream_init_from_raw(oc8_as_stream_t *is, const void *arr,
-                                 size_t len) {
-  functor_raw_t *functor = (functor_raw_t *)malloc(sizeof(functor_raw_t));
-  functor->fn = get_byte_fn_raw;
-  functor->arr = arr;
-  functor->len = len;
-  functor->idx = 0;
-  init_stream(is, (oc8_as_functor_t *)functor);
+void oc8_as_stream_free(oc8_as_stream_t *is) {
+  if (is->own_f)
+    fclose(is->f);
+  oc8_bin_map_close(&is->map);
+  free(is->getc_fn);
+  free(is->buf);
 }
 
-void oc8_as_stream_free(oc8_as_stream_t *is) { free(is->getc_fn); }
+int oc8_as_stream_refill(oc8_as_stream_t *is) {
+  if (is->cur != is->end)
+    return 1;
+  if (is->eof)
+    return 0;
 
-int oc8_as_stream_peek(oc8_as_stream_t *is) {
-  load_last(is);
-  return is->last;
-}
+  size_t len = 0;
+  if (is->f)
+    len = fread(is->buf, 1, OC8_AS_STREAM_BLOCK_SIZE, is->f);
+  else
+    while (len < OC8_AS_STREAM_BLOCK_SIZE) {
+      int c = is->getc_fn->fn(is->getc_fn);
+      if (c == EOF)
+        break;
+      is->buf[len++] = (char)c;
+    }
 
-int oc8_as_stream_get(oc8_as_stream_t *is) {
-  load_last(is);
-  int res = is->last;
-  clear_last(is);
-  return res;
+  if (len < OC8_AS_STREAM_BLOCK_SIZE)
+    is->eof = 1;
+  set_block(is, is->buf, len);
+  return len != 0;
 }
@@ -1,7 +1,13 @@
 #include <catch2/catch.hpp>
+#include <cstdio>
+#include <fstream>
+#include <cstdlib>
+#include <iterator>
 #include <set>
 #include <sstream>
 #include <string>
+#include <sys/stat.h>
+#include <thread>
 #include <vector>
 
 #include "../../tests/test_src.h"
@@ -80,8 +86,8 @@ TEST_CASE("compile simple ins 7XNN", "") {
   oc8_as_sfile_ins_add_imm(sf, 0x73, 0xB);
 
   oc8_bin_file_t bf;
-  oc8_as_compile_sfile(sf, &bf);
-  oc8_bin_file_check(&bf, 0);
+  REQUIRE(oc8_as_compile_sfile(sf, &bf) == 0);
+  REQUIRE(oc8_bin_file_validate(&bf, 0) == 0);
 
   REQUIRE(bf.syms_defs_size == 0);
   REQUIRE(bf.syms_refs_size == 0);
@@ -103,8 +109,8 @@ TEST_CASE("compile 2 ins", "") {
   oc8_as_sfile_ins_bcd(sf, 0xE);
 
   oc8_bin_file_t bf;
-  oc8_as_compile_sfile(sf, &bf);
-  oc8_bin_file_check(&bf, 0);
+  REQUIRE(oc8_as_compile_sfile(sf, &bf) == 0);
+  REQUIRE(oc8_bin_file_validate(&bf, 0) == 0);
 
   REQUIRE(bf.syms_defs_size == 0);
   REQUIRE(bf.syms_refs_size == 0);
@@ -133,8 +139,8 @@ TEST_CASE("compile misc no syms", "") {
   oc8_as_sfile_dir_zero(sf, 3);
 
   oc8_bin_file_t bf;
-  oc8_as_compile_sfile(sf, &bf);
-  oc8_bin_file_check(&bf, 0);
+  REQUIRE(oc8_as_compile_sfile(sf, &bf) == 0);
+  REQUIRE(oc8_bin_file_validate(&bf, 0) == 0);
 
   REQUIRE(bf.syms_defs_size == 0);
   REQUIRE(bf.syms_refs_size == 0);
@@ -164,8 +170,8 @@ TEST_CASE("compile 2 syms use 0 syms defs", "") {
   oc8_as_sfile_sins_jmp(sf, "bar");
 
   oc8_bin_file_t bf;
-  oc8_as_compile_sfile(sf, &bf);
-  oc8_bin_file_check(&bf, 0);
+  REQUIRE(oc8_as_compile_sfile(sf, &bf) == 0);
+  REQUIRE(oc8_bin_file_validate(&bf, 0) == 0);
 
   REQUIRE(bf.syms_defs_size == 2);
   REQUIRE(bf.syms_refs_size == 2);
@@ -196,8 +202,8 @@ TEST_CASE("compile 0 syms use 2 syms defs", "") {
   oc8_as_sfile_ins_ret(sf);
 
   oc8_bin_file_t bf;
-  oc8_as_compile_sfile(sf, &bf);
-  oc8_bin_file_check(&bf, 0);
+  REQUIRE(oc8_as_compile_sfile(sf, &bf) == 0);
+  REQUIRE(oc8_bin_file_validate(&bf, 0) == 0);
 
   REQUIRE(bf.syms_defs_size == 2);
   REQUIRE(bf.syms_refs_size == 0);
@@ -230,8 +236,8 @@ TEST_CASE("compile 3 syms use 3 syms defs", "") {
   oc8_as_sfile_sins_jmp(sf, "foo");
 
   oc8_bin_file_t bf;
-  oc8_as_compile_sfile(sf, &bf);
-  oc8_bin_file_check(&bf, 0);
+  REQUIRE(oc8_as_compile_sfile(sf, &bf) == 0);
+  REQUIRE(oc8_bin_file_validate(&bf, 0) == 0);
 
   REQUIRE(bf.syms_defs_size == 4);
   REQUIRE(bf.syms_refs_size == 3);
@@ -265,8 +271,8 @@ TEST_CASE("compile 3 syms use 3 syms defs", "") {
 TEST_CASE("compile fibo", "") {
   oc8_as_sfile_t *sf = parse_str(test_fibo_src);
   oc8_bin_file_t bf;
-  oc8_as_compile_sfile(sf, &bf);
-  oc8_bin_file_check(&bf, 0);
+  REQUIRE(oc8_as_compile_sfile(sf, &bf) == 0);
+  REQUIRE(oc8_bin_file_validate(&bf, 0) == 0);
 
   REQUIRE(bf.syms_defs_size == 3);
   REQUIRE(bf.syms_refs_size == 2);
@@ -288,8 +294,8 @@ TEST_CASE("compile fibo", "") {
 TEST_CASE("compile fact_table", "") {
   oc8_as_sfile_t *sf = parse_str(test_fact_table_src);
   oc8_bin_file_t bf;
-  oc8_as_compile_sfile(sf, &bf);
-  oc8_bin_file_check(&bf, 0);
+  REQUIRE(oc8_as_compile_sfile(sf, &bf) == 0);
+  REQUIRE(oc8_bin_file_validate(&bf, 0) == 0);
 
   REQUIRE(bf.syms_defs_size == 5);
   REQUIRE(bf.syms_refs_size == 3);
@@ -315,3 +321,95 @@ TEST_CASE("compile fact_table", "") {
   oc8_bin_file_free(&bf);
   oc8_as_sfile_free(sf);
 }
+
+namespace {
+
+void save_file(const std::string &path, const char *data) {
+  std::ofstream os(path);
+  os << data;
+}
+
+std::string read_file(const std::string &path) {
+  std::ifstream is(path, std::ios::binary);
+  return std::string(std::istreambuf_iterator<char>(is),
+                     std::istreambuf_iterator<char>());
+}
+
+} // namespace
+
+TEST_CASE("assemble many files in parallel", "") {
+  // Invalid files fail without stopping the other jobs
+  std::vector<const char *> srcs = {
+      test_fibo_src,        "mov 0x1000, %v0\n", test_fact_table_src,
+      "badins %v1\n",       test_call_add_src,   "call undef_sym, 3\n",
+      test_my_add_src,      test_sum_rec_src,
+  };
+  std::vector<int> ok = {1, 0, 1, 0, 1, 0, 1, 1};
+  std::vector<std::string> ins, outs;
+  for (size_t i = 0; i < srcs.size(); ++i) {
+    ins.push_back("/tmp/ts_oc8_as_job" + std::to_string(i) + ".c8s");
+    outs.push_back("/tmp/ts_oc8_as_job" + std::to_string(i) + ".c8o");
+    save_file(ins[i], srcs[i]);
+    std::remove(outs[i].c_str());
+  }
+
+  std::vector<int> errs(srcs.size(), -1);
+  std::vector<std::thread> threads;
+  for (size_t t = 0; t < 4; ++t)
+    threads.emplace_back([&, t] {
+      for (size_t i = t; i < srcs.size(); i += 4)
+        errs[i] = oc8_as_assemble_file(ins[i].c_str(), outs[i].c_str(),
+                                         nullptr, nullptr);
+    });
+  for (auto &th : threads)
+    th.join();
+
+  for (size_t i = 0; i < srcs.size(); ++i) {
+    REQUIRE((errs[i] == 0) == ok[i]);
+    REQUIRE(!read_file(outs[i]).empty() == ok[i]);
+  }
+
+  // Same result when assembled alone
+  std::string ref = read_file(outs[0]);
+  REQUIRE(oc8_as_assemble_file(ins[0].c_str(), outs[0].c_str(), nullptr,
+                               nullptr) == 0);
+  REQUIRE(read_file(outs[0]) == ref);
+  REQUIRE(oc8_as_assemble_file("/tmp/no/such/file.c8s", outs[0].c_str(),
+                               nullptr, nullptr) != 0);
+
+  for (size_t i = 0; i < srcs.size(); ++i) {
+    std::remove(ins[i].c_str());
+    std::remove(outs[i].c_str());
+  }
+}
+
+TEST_CASE("assemble with a cache", "") {
+  REQUIRE(std::system("rm -rf /tmp/ts_oc8_as_cache") == 0);
+  oc8_bin_cache_t cache;
+  REQUIRE(oc8_bin_cache_open(&cache, "/tmp/ts_oc8_as_cache") == 0);
+  const char *in = "/tmp/ts_oc8_as_cache.c8s";
+  const char *out = "/tmp/ts_oc8_as_cache.c8o";
+  save_file(in, test_fibo_src);
+  REQUIRE(oc8_as_assemble_file(in, out, nullptr, nullptr) == 0);
+  std::string ref = read_file(out);
+
+  // The second time, the output is a link to the cache entry
+  struct stat st;
+  for (int i = 0; i < 2; ++i) {
+    REQUIRE(oc8_as_assemble_file(in, out, nullptr, &cache) == 0);
+    REQUIRE(read_file(out) == ref);
+    REQUIRE(stat(out, &st) == 0);
+    REQUIRE(st.st_nlink == (nlink_t)(i + 1));
+  }
+
+  save_file(in, test_my_add_src);
+  REQUIRE(oc8_as_assemble_file(in, out, nullptr, &cache) == 0);
+  REQUIRE(read_file(out) != ref);
+  save_file(in, test_fibo_src);
+  REQUIRE(oc8_as_assemble_file(in, out, nullptr, &cache) == 0);
+  REQUIRE(read_file(out) == ref);
+
+  oc8_bin_cache_close(&cache);
+  std::remove(in);
+  std::remove(out);
+}
@@ -0,0 +1,150 @@
+#include <catch2/catch.hpp>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "oc8_as/lexer.h"
+
+namespace {
+
+std::vector<oc8_as_token_t> lex_str(const char *str) {
+  oc8_as_stream_t is;
+  oc8_as_stream_init_from_raw(&is, str, std::strlen(str));
+  oc8_as_lexer_t lx;
+  oc8_as_lexer_init(&lx, &is, "(raw string)");
+  std::vector<oc8_as_token_t> res;
+  for (;;) {
+    res.push_back(lx.tok);
+    if (lx.tok.kind == OC8_AS_TOK_EOF)
+      break;
+    oc8_as_lexer_next(&lx);
+  }
+  oc8_as_stream_free(&is);
+  return res;
+}
+
+const oc8_as_keyword_t *find_kw(const char *str) {
+  return oc8_as_find_keyword(str, std::strlen(str));
+}
+
+} // namespace
+
+TEST_CASE("lexer every keyword finds itself", "") {
+  REQUIRE(g_oc8_as_keywords_size == 52);
+  for (std::size_t i = 0; i < g_oc8_as_keywords_size; ++i) {
+    const oc8_as_keyword_t *kw = &g_oc8_as_keywords[i];
+    REQUIRE(kw->len == std::strlen(kw->name));
+    REQUIRE(find_kw(kw->name) == kw);
+  }
+}
+
+TEST_CASE("lexer keywords", "") {
+  const char *mns[] = {"add",  "and",   "bcd",   "call", "cls",  "draw",
+                       "fspr", "jmp",   "mov",   "movm", "or",   "rand",
+                       "ret",  "shl",   "shr",   "skpe", "skpn", "skpkp",
+                       "skpkn", "sub",  "subn",  "sys",  "waitk", "xor"};
+  for (unsigned i = 0; i < sizeof(mns) / sizeof(mns[0]); ++i) {
+    auto kw = find_kw(mns[i]);
+    REQUIRE(kw);
+    REQUIRE(kw->kind == OC8_AS_TOK_ID);
+    REQUIRE(kw->id == OC8_AS_MN_ADD + i);
+  }
+
+  const char *dirs[] = {".byte", ".equ",  ".globl", ".size",
+                        ".type", ".word", ".zero"};
+  for (unsigned i = 0; i < sizeof(dirs) / sizeof(dirs[0]); ++i) {
+    auto kw = find_kw(dirs[i]);
+    REQUIRE(kw);
+    REQUIRE(kw->kind == OC8_AS_TOK_DIR);
+    REQUIRE(kw->id == OC8_AS_DIR_BYTE + i);
+  }
+
+  const char *hex = "0123456789abcdef";
+  for (unsigned i = 0; i < 16; ++i) {
+    std::string reg = std::string("%v") + hex[i];
+    auto kw = find_kw(reg.c_str());
+    REQUIRE(kw);
+    REQUIRE(kw->kind == OC8_AS_TOK_REG);
+    REQUIRE(kw->id == i);
+  }
+  REQUIRE(find_kw("%i")->id == OC8_AS_REG_I);
+  REQUIRE(find_kw("%dt")->id == OC8_AS_REG_DT);
+  REQUIRE(find_kw("%st")->id == OC8_AS_REG_ST);
+  REQUIRE(find_kw("@function")->id == OC8_AS_TYPENAME_FUNCTION);
+  REQUIRE(find_kw("@object")->id == OC8_AS_TYPENAME_OBJECT);
+
+  const char *others[] = {"a",   "ad",    "addd", "movmm", "%v",  "%vg",
+                          "%v10", ".bytes", "skpk", "_start", "fibo", "%I",
+                          "ADD", "@func", "@objects", "jmpx", "x"};
+  for (auto str : others)
+    REQUIRE(find_kw(str) == nullptr);
+}
+
+TEST_CASE("lexer tokens", "") {
+  auto toks = lex_str("loop: mov 0x1F, %v3 # comment, (ignored)\n"
+                      "  .type f, @function\n"
+                      "jmp 12(%v0)\n\tadd 0b101, %va\n.word 017");
+  std::vector<oc8_as_tok_kind_t> kinds;
+  for (const auto &tok : toks)
+    kinds.push_back(tok.kind);
+  std::vector<oc8_as_tok_kind_t> ref = {
+      OC8_AS_TOK_ID,     OC8_AS_TOK_COLON, OC8_AS_TOK_ID,    OC8_AS_TOK_INT,
+      OC8_AS_TOK_COMMA,  OC8_AS_TOK_REG,   OC8_AS_TOK_NL,    OC8_AS_TOK_DIR,
+      OC8_AS_TOK_ID,     OC8_AS_TOK_COMMA, OC8_AS_TOK_TYPE,  OC8_AS_TOK_NL,
+      OC8_AS_TOK_ID,     OC8_AS_TOK_INT,   OC8_AS_TOK_LPAREN, OC8_AS_TOK_REG,
+      OC8_AS_TOK_RPAREN, OC8_AS_TOK_NL,    OC8_AS_TOK_ID,    OC8_AS_TOK_INT,
+      OC8_AS_TOK_COMMA,  OC8_AS_TOK_REG,   OC8_AS_TOK_NL,    OC8_AS_TOK_DIR,
+      OC8_AS_TOK_INT,    OC8_AS_TOK_EOF,
+  };
+  REQUIRE(kinds == ref);
+
+  REQUIRE(std::string(toks[0].text) == "loop");
+  REQUIRE(toks[0].val == OC8_AS_MN_NONE);
+  REQUIRE(toks[2].val == OC8_AS_MN_MOV);
+  REQUIRE(toks[3].val == 0x1F);
+  REQUIRE(toks[5].val == 3);
+  REQUIRE(toks[6].row == 1);
+  REQUIRE(toks[7].val == OC8_AS_DIR_TYPE);
+  REQUIRE(toks[7].row == 2);
+  REQUIRE(toks[7].col == 3);
+  REQUIRE(std::string(toks[8].text) == "f");
+  REQUIRE(toks[10].val == OC8_AS_TYPENAME_FUNCTION);
+  REQUIRE(toks[12].val == OC8_AS_MN_JMP);
+  REQUIRE(toks[13].val == 12);
+  REQUIRE(toks[15].val == 0);
+  REQUIRE(toks[18].val == OC8_AS_MN_ADD);
+  REQUIRE(toks[18].col == 2);
+  REQUIRE(toks[19].val == 5);
+  REQUIRE(toks[21].val == 0xA);
+  REQUIRE(toks[24].val == 017);
+  REQUIRE(toks[25].row == 5);
+}
+
+TEST_CASE("lexer empty and comments", "") {
+  auto toks = lex_str("");
+  REQUIRE(toks.size() == 1);
+  REQUIRE(toks[0].kind == OC8_AS_TOK_EOF);
+
+  toks = lex_str("# only a comment");
+  REQUIRE(toks.size() == 1);
+
+  toks = lex_str("#a\n\n 0 # b");
+  REQUIRE(toks.size() == 4);
+  REQUIRE(toks[2].kind == OC8_AS_TOK_INT);
+  REQUIRE(toks[2].val == 0);
+  REQUIRE(toks[2].row == 3);
+}
+
+TEST_CASE("lexer first row", "") {
+  const char *str = "ret\n\ncls";
+  oc8_as_stream_t is;
+  oc8_as_stream_init_from_raw(&is, str, std::strlen(str));
+  oc8_as_lexer_t lx;
+  oc8_as_lexer_init_at(&lx, &is, "(chunk)", 41);
+  REQUIRE(lx.tok.row == 41);
+  while (lx.tok.kind != OC8_AS_TOK_EOF && lx.tok.val != OC8_AS_MN_CLS)
+    oc8_as_lexer_next(&lx);
+  REQUIRE(lx.tok.row == 43);
+  REQUIRE(lx.tok.col == 1);
+  oc8_as_stream_free(&is);
+}
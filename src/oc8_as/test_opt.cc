@@ -0,0 +1,161 @@
+#include <catch2/catch.hpp>
+#include <string>
+
+#include "oc8_as/opt.h"
+#include "oc8_as/parser.h"
+#include "oc8_as/printer.h"
+#include "oc8_as/sfile.h"
+
+namespace {
+
+// Parse `src`, optimize it with `flags`, and print it again
+std::string optimize(const std::string &src, unsigned flags,
+                     size_t *nb_deleted = nullptr) {
+  oc8_as_sfile_t *sf = oc8_as_parse_raw(src.c_str(), src.size());
+  oc8_as_sfile_check(sf);
+  size_t res = oc8_as_optimize_sfile(sf, flags);
+  if (nb_deleted)
+    *nb_deleted = res;
+  std::string out(64 * 1024, '\0');
+  out.resize(oc8_as_print_sfile(sf, &out[0], out.size(), NULL, NULL));
+  oc8_as_sfile_free(sf);
+  return out;
+}
+
+} // namespace
+
+TEST_CASE("opt tail calls", "") {
+  std::string src = ".type f, @function\n"
+                    "f:\n"
+                    "  call g\n"
+                    "  ret\n"
+                    ".size f, 4\n"
+                    "h:\n"
+                    "  call g\n"
+                    "Lret:\n"
+                    "  ret\n"
+                    "k:\n"
+                    "  skpe 1, %v0\n"
+                    "  call g\n"
+                    "  ret\n";
+  size_t n;
+  REQUIRE(optimize(src, OC8_AS_OPT_ALL, &n) == ".size f, 2\n"
+                                               ".type f, @function\n"
+                                               "f:\n"
+                                               "    jmp g\n"
+                                               "h:\n"
+                                               "    jmp g\n"
+                                               "Lret:\n"
+                                               "    ret\n"
+                                               "k:\n"
+                                               "    skpe 0x1, %v0\n"
+                                               "    call g\n"
+                                               "    ret\n");
+  REQUIRE(n == 2);
+
+  REQUIRE(optimize(src, OC8_AS_OPT_ALL & ~OC8_AS_OPT_TAIL_CALLS, &n) ==
+          optimize(src, 0));
+  REQUIRE(n == 0);
+}
+
+TEST_CASE("opt nops", "") {
+  std::string src = ".type f, @function\n"
+                    "f:\n"
+                    "  mov %v1, %v1\n"
+                    "L1:\n"
+                    "  add 0, %v2\n"
+                    "  mov %v1, %v2\n"
+                    "  add 1, %v2\n"
+                    "  skpn %v0, %v1\n"
+                    "  mov %v3, %v3\n"
+                    "  jmp L2\n"
+                    "L2:\n"
+                    "  ret\n"
+                    ".size f, 16\n"
+                    ".type data, @object\n"
+                    "data:\n"
+                    "  .byte 1\n"
+                    "  .byte 2\n"
+                    ".size data, 2\n";
+  size_t n;
+  REQUIRE(optimize(src, OC8_AS_OPT_NOPS, &n) == ".size f, 10\n"
+                                                ".type f, @function\n"
+                                                "f:\n"
+                                                "L1:\n"
+                                                "    mov %v1, %v2\n"
+                                                "    add 0x1, %v2\n"
+                                                "    skpn %v0, %v1\n"
+                                                "    mov %v3, %v3\n"
+                                                "L2:\n"
+                                                "    ret\n"
+                                                ".size data, 2\n"
+                                                ".type data, @object\n"
+                                                "data:\n"
+                                                ".byte 0x1\n"
+                                                ".byte 0x2\n");
+  REQUIRE(n == 6);
+}
+
+TEST_CASE("opt jumps", "") {
+  std::string src = "_start:\n"
+                    "  call L1\n"
+                    "  jmp L1\n"
+                    "L1:\n"
+                    "  jmp L2\n"
+                    "  cls\n"
+                    "L2:\n"
+                    "  jmp L3\n"
+                    "  cls\n"
+                    "L3:\n"
+                    "  jmp ext\n"
+                    "Lloop:\n"
+                    "  jmp Lloop\n"
+                    "Lr:\n"
+                    "  jmp Lret\n"
+                    "Lret:\n"
+                    "  ret\n";
+  size_t n;
+  REQUIRE(optimize(src, OC8_AS_OPT_JUMPS, &n) == "_start:\n"
+                                                 "    call ext\n"
+                                                 "    jmp ext\n"
+                                                 "L1:\n"
+                                                 "    jmp ext\n"
+                                                 "    cls\n"
+                                                 "L2:\n"
+                                                 "    jmp ext\n"
+                                                 "    cls\n"
+                                                 "L3:\n"
+                                                 "    jmp ext\n"
+                                                 "Lloop:\n"
+                                                 "    jmp Lloop\n"
+                                                 "Lr:\n"
+                                                 "    ret\n"
+                                                 "Lret:\n"
+                                                 "    ret\n");
+  REQUIRE(n == 0);
+}
+
+TEST_CASE("opt without deletion", "") {
+  // The jump table needs every instruction at its place, only rewrites are
+  // done
+  std::string src = "_start:\n"
+                    "  jmp Ltable(%v0)\n"
+                    "Ltable:\n"
+                    "  call f\n"
+                    "  ret\n"
+                    "  mov %v1, %v1\n"
+                    "  ret\n"
+                    "f:\n"
+                    "  ret\n";
+  size_t n;
+  REQUIRE(optimize(src, OC8_AS_OPT_ALL, &n) == "_start:\n"
+                                               "    jmp Ltable(%v0)\n"
+                                               "Ltable:\n"
+                                               "    ret\n"
+                                               "    ret\n"
+                                               "    mov %v1, %v1\n"
+                                               "    ret\n"
+                                               "f:\n"
+                                               "    ret\n");
+  REQUIRE(n == 0);
+}
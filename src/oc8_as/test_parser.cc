@@ -1,11 +1,18 @@
 #include <catch2/catch.hpp>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
 #include <sstream>
 #include <string>
 #include <vector>
 
+#include "oc8_as/as.h"
 #include "oc8_as/parser.h"
 #include "oc8_as/printer.h"
 #include "oc8_as/sfile.h"
+#include "oc8_bin/bin_writer.h"
 
 #include "../../tests/test_src.h"
 
@@ -50,6 +57,87 @@ oc8_as_sfile_t *parse_str(const std::string &str) {
   return oc8_as_parse_raw(str.c_str(), str.size());
 }
 
+std::string print_full(oc8_as_sfile_t *sf) {
+  std::string res(1024 * 1024, '\0');
+  oc8_as_sfile_check(sf);
+  res.resize(oc8_as_print_sfile(sf, &res[0], res.size(), NULL, NULL));
+  return res;
+}
+
+// Generated source with `nb_funs` functions (at most 200), and long comments
+std::string gen_big_src(int nb_funs) {
+  std::string res;
+  for (int i = 0; i < nb_funs; ++i) {
+    std::string name = "fun_" + std::to_string(i);
+    for (int j = 0; j < 10; ++j)
+      res += "# " + std::string(100 + (i + j) % 50, '-') + "\n";
+    res += ".globl " + name + "\n";
+    res += ".type " + name + ", @function\n";
+    res += name + ":\n";
+    res += "  mov 0x" + std::to_string(i % 90 + 10) + ", %v0 # constant\n";
+    res += "  add %v0, %v" + std::to_string(i % 10) + "\n";
+    res += "  mov table, %i\n";
+    res += "  movm %i, %v1\n";
+    if (i)
+      res += "  call fun_" + std::to_string(i - 1) + "\n";
+    res += "  ret\n\n";
+  }
+  res += "table:\n  .byte 0x12\n  .word 0x3456\n";
+  return res;
+}
+
+void save_file(const char *path, const std::string &data) {
+  std::ofstream os(path);
+  os << data;
+}
+
+struct functor_str_t {
+  oc8_as_functor_fn_f fn;
+  const char *str;
+};
+
+// Custom source read byte by byte
+int get_byte_str(void *functor_ptr) {
+  auto f = (functor_str_t *)functor_ptr;
+  return *f->str ? *f->str++ : EOF;
+}
+
+oc8_as_sfile_t *parse_functor(const std::string &str) {
+  auto f = (functor_str_t *)std::malloc(sizeof(functor_str_t));
+  f->fn = get_byte_str;
+  f->str = str.c_str();
+  oc8_as_stream_t is;
+  oc8_as_stream_init_from_functor(&is, (oc8_as_functor_t *)f);
+  oc8_as_sfile_t *sf = oc8_as_run_parser(&is, "(functor)");
+  oc8_as_stream_free(&is);
+  return sf;
+}
+
+std::vector<uint8_t> compile_bytes(oc8_as_sfile_t *sf) {
+  oc8_bin_file_t bf;
+  oc8_as_sfile_check(sf);
+  REQUIRE(oc8_as_compile_sfile(sf, &bf) == 0);
+  std::vector<uint8_t> res(oc8_bin_write_file_raw(&bf, nullptr));
+  oc8_bin_write_file_raw(&bf, &res[0]);
+  oc8_bin_file_free(&bf);
+  return res;
+}
+
+oc8_as_sfile_t *parse_parallel(const std::string &str, oc8_pool_t *pool,
+                               size_t chunk_size) {
+  return oc8_as_parse_raw_parallel(str.c_str(), str.size(), "(chunks)", pool,
+                                   chunk_size, nullptr);
+}
+
+int parse_parallel_fails(const std::string &str, oc8_pool_t *pool,
+                         size_t chunk_size) {
+  oc8_as_sfile_t *sf = parse_parallel(str, pool, chunk_size);
+  if (!sf)
+    return 1;
+  oc8_as_sfile_free(sf);
+  return 0;
+}
+
 } // namespace
 
 TEST_CASE("parse ins 7XNN", "") {
@@ -499,3 +587,164 @@ TEST_CASE("parse file fact_table_src", "") {
   REQUIRE(trim(code[25]) == ".byte 0x78");
   oc8_as_sfile_free(sf);
 }
+
+TEST_CASE("parse big file from all sources", "") {
+  const char *path = "/tmp/ts_oc8_as_big.c8s";
+  std::string src = gen_big_src(200);
+  REQUIRE(src.size() > 2 * OC8_AS_STREAM_BLOCK_SIZE);
+  save_file(path, src);
+
+  oc8_as_sfile_t *sf = parse_str(src);
+  std::string ref = print_full(sf);
+  oc8_as_sfile_free(sf);
+  REQUIRE(ref.find("call fun_198") != std::string::npos);
+
+  sf = oc8_as_parse_file(path);
+  REQUIRE(print_full(sf) == ref);
+  oc8_as_sfile_free(sf);
+
+  FILE *f = fopen(path, "r");
+  oc8_as_stream_t is;
+  oc8_as_stream_init_from_file(&is, f);
+  sf = oc8_as_run_parser(&is, path);
+  oc8_as_stream_free(&is);
+  fclose(f);
+  REQUIRE(print_full(sf) == ref);
+  oc8_as_sfile_free(sf);
+
+  sf = parse_functor(src);
+  REQUIRE(print_full(sf) == ref);
+  oc8_as_sfile_free(sf);
+  std::remove(path);
+}
+
+TEST_CASE("parse in parallel chunks", "") {
+  // Symbols used before their definition, and properties set in another chunk
+  std::string src = ".equ MAX_V, 0x20\n"
+                    "_start:\n"
+                    "  mov data, %i\n"
+                    "  call later\n"
+                    "  jmp _start\n"
+                    ".globl later\n"
+                    "  .byte 0x7\n"
+                    "later:\n"
+                    "  skpe MAX_V, %v1\n"
+                    "  call ext_fun\n"
+                    "  ret\n"
+                    ".type later, @function\n"
+                    "data:\n"
+                    ".size data, 3\n"
+                    "  .word 0x1234\n"
+                    "  .zero 3\n"
+                    ".type data, @object\n"
+                    ".size data, 0\n";
+  oc8_as_sfile_t *sf = parse_str(src);
+  std::string ref = print_full(sf);
+  auto ref_bytes = compile_bytes(sf);
+  oc8_as_sfile_free(sf);
+
+  std::string big = gen_big_src(200);
+  sf = parse_str(big);
+  std::string big_ref = print_full(sf);
+  auto big_ref_bytes = compile_bytes(sf);
+  oc8_as_sfile_free(sf);
+
+  for (size_t nb_threads : {0, 3}) {
+    oc8_pool_t pool;
+    oc8_pool_init(&pool, nb_threads);
+    for (size_t chunk_size = 1; chunk_size < src.size() + 2; chunk_size += 7) {
+      sf = parse_parallel(src, &pool, chunk_size);
+      REQUIRE(print_full(sf) == ref);
+      REQUIRE(compile_bytes(sf) == ref_bytes);
+      oc8_as_sfile_free(sf);
+    }
+
+    for (size_t chunk_size : {1000, 20000, 0}) {
+      sf = parse_parallel(big, &pool, chunk_size);
+      REQUIRE(print_full(sf) == big_ref);
+      REQUIRE(compile_bytes(sf) == big_ref_bytes);
+      oc8_as_sfile_free(sf);
+    }
+    oc8_pool_free(&pool);
+  }
+}
+
+TEST_CASE("parse in parallel chunks errors", "") {
+  oc8_pool_t pool;
+  oc8_pool_init(&pool, 2);
+  std::string src = "a:\n  ret\n  cls\nb:\n  ret\n";
+  REQUIRE(parse_parallel_fails(src, &pool, 1) == 0);
+  // Redefinition in another chunk, detected by the merge
+  REQUIRE(parse_parallel_fails(src + "a:\n  ret\n", &pool, 1) == 1);
+  // Syntax error in one chunk, reported at line 6 of the whole input
+  REQUIRE(parse_parallel_fails(src + "  badins\n" + src, &pool, 1) == 1);
+  // Same constant defined in two chunks
+  std::string equ = ".equ MAX_V, 0x20\n";
+  REQUIRE(parse_parallel_fails(equ + src + equ, &pool, 1) == 1);
+  oc8_pool_free(&pool);
+}
+
+TEST_CASE("parse errors", "") {
+  const char *srcs[] = {
+      "  badins\n",           "  add 0x100, %v0\n",   "  mov $, %v0\n",
+      "  jmp 0xzz\n",         ".foo 2\n",             "  add %v0 %v1\n",
+      "a:\n  ret\na:\n",      ".equ A, 1\n.equ A, 2\n", "  mov %v0, %v1,\n",
+      "  movm %v0, %v1, %v2, %v3\n",
+  };
+  for (const char *src : srcs)
+    REQUIRE(oc8_as_parse_raw(src, strlen(src)) == nullptr);
+
+  // Errors found after the parsing
+  oc8_as_sfile_t *sf = oc8_as_parse_raw(".globl foo\n", 11);
+  REQUIRE(sf != nullptr);
+  REQUIRE(oc8_as_sfile_check(sf) != 0);
+  oc8_as_sfile_free(sf);
+}
+
+// Run with `utest_oc8as.bin [bench]`
+TEST_CASE("parser bench throughput", "[.bench]") {
+  // sfiles are limited in number of symbols: parse the same file many times
+  const char *path = "/tmp/ts_oc8_as_bench.c8s";
+  const int nb_rounds = 100;
+  std::string src = gen_big_src(200);
+  save_file(path, src);
+  double mb = nb_rounds * src.size() / (1024.0 * 1024.0);
+
+  using parse_fn_f = oc8_as_sfile_t *(*)(const char *, const std::string &);
+  auto run = [&](const char *name, parse_fn_f fn) {
+    auto begin = std::chrono::high_resolution_clock::now();
+    for (int i = 0; i < nb_rounds; ++i) {
+      oc8_as_sfile_t *sf = fn(path, src);
+      REQUIRE(sf->items_size > 0);
+      oc8_as_sfile_free(sf);
+    }
+    auto end = std::chrono::high_resolution_clock::now();
+    double s = std::chrono::duration<double>(end - begin).count();
+    std::printf("parser %-8s: %.1f MB in %.3f s, %.1f MB/s\n", name, mb, s,
+                mb / s);
+  };
+
+  run("mapped", [](const char *p, const std::string &) {
+    return oc8_as_parse_file(p);
+  });
+  run("FILE", [](const char *p, const std::string &) {
+    FILE *f = fopen(p, "r");
+    oc8_as_stream_t is;
+    oc8_as_stream_init_from_file(&is, f);
+    oc8_as_sfile_t *sf = oc8_as_run_parser(&is, p);
+    oc8_as_stream_free(&is);
+    fclose(f);
+    return sf;
+  });
+  run("functor", [](const char *, const std::string &str) {
+    return parse_functor(str);
+  });
+
+  static oc8_pool_t pool;
+  oc8_pool_init(&pool, oc8_pool_nb_cpus() - 1);
+  run("chunks", [](const char *, const std::string &str) {
+    return parse_parallel(str, &pool, str.size() / 16);
+  });
+  oc8_pool_free(&pool);
+  std::remove(path);
+}
@@ -496,3 +496,53 @@ TEST_CASE("sfile function fibo", "") {
   REQUIRE(trim(code[15]) == "ret");
   oc8_as_sfile_free(sf);
 }
+
+TEST_CASE("sfile too many symbols", "") {
+  oc8_as_sfile_t *sf = oc8_as_sfile_new();
+  for (int i = 0; i < OC8_AS_MAX_SYMS; ++i) {
+    std::string name = "L" + std::to_string(i);
+    REQUIRE(oc8_as_sfile_add_sym(sf, name.c_str()) == 0);
+    oc8_as_sfile_ins_cls(sf);
+  }
+  REQUIRE(sf->syms_defs_size == OC8_AS_MAX_SYMS);
+
+  // Errors for new symbols, the existing ones can still be used
+  REQUIRE(oc8_as_sfile_add_sym(sf, "more") != 0);
+  REQUIRE(oc8_as_sfile_dir_globl(sf, "more") != 0);
+  REQUIRE(oc8_as_sfile_sins_call(sf, "more") != 0);
+  REQUIRE(oc8_as_sfile_sins_call(sf, "L0") == 0);
+  REQUIRE(oc8_as_sfile_dir_globl(sf, "L1") == 0);
+  REQUIRE(sf->syms_defs_size == OC8_AS_MAX_SYMS);
+  REQUIRE(oc8_as_sfile_check(sf) == 0);
+  oc8_as_sfile_free(sf);
+}
+
+TEST_CASE("sfile append errors", "") {
+  oc8_as_sfile_t *sf = oc8_as_sfile_new();
+  oc8_as_sfile_add_sym(sf, "foo");
+  oc8_as_sfile_dir_byte(sf, 1);
+
+  // .align 2 cannot be moved to an odd position
+  oc8_as_sfile_t *other = oc8_as_sfile_new();
+  oc8_as_sfile_dir_align(other, 2);
+  oc8_as_sfile_ins_ret(other);
+  REQUIRE(oc8_as_sfile_append(sf, other) != 0);
+  oc8_as_sfile_free(other);
+
+  // Redefinition
+  other = oc8_as_sfile_new();
+  oc8_as_sfile_add_sym(other, "foo");
+  oc8_as_sfile_ins_ret(other);
+  REQUIRE(oc8_as_sfile_append(sf, other) != 0);
+  oc8_as_sfile_free(other);
+
+  // Too many symbols in total
+  other = oc8_as_sfile_new();
+  for (int i = 0; i < OC8_AS_MAX_SYMS; ++i)
+    oc8_as_sfile_add_sym(other, ("L" + std::to_string(i)).c_str());
+  oc8_as_sfile_ins_ret(other);
+  REQUIRE(oc8_as_sfile_append(sf, other) != 0);
+  oc8_as_sfile_free(other);
+
+  oc8_as_sfile_free(sf);
+}
@@ -1,5 +1,7 @@
 #include <catch2/catch.hpp>
+#include <cstdlib>
 #include <fstream>
+#include <string>
 
 #include "oc8_as/stream.h"
 
@@ -12,6 +14,32 @@ void save_str(const char *data) {
   os << data;
 }
 
+struct functor_str_t {
+  oc8_as_functor_fn_f fn;
+  const char *str;
+};
+
+int get_byte_str(void *functor_ptr) {
+  auto f = (functor_str_t *)functor_ptr;
+  return *f->str ? *f->str++ : EOF;
+}
+
+oc8_as_functor_t *new_functor_str(const char *str) {
+  auto f = (functor_str_t *)std::malloc(sizeof(functor_str_t));
+  f->fn = get_byte_str;
+  f->str = str;
+  return (oc8_as_functor_t *)f;
+}
+
+std::string read_all(oc8_as_stream_t *is) {
+  std::string res;
+  size_t begin = oc8_as_stream_pos(is);
+  for (int c = oc8_as_stream_get(is); c != EOF; c = oc8_as_stream_get(is))
+    res.push_back((char)c);
+  REQUIRE(oc8_as_stream_pos(is) == begin + res.size());
+  return res;
+}
+
 } // namespace
 
 TEST_CASE("Stream get str from raw", "") {
@@ -107,3 +135,54 @@ TEST_CASE("Stream get/peek str from string", "") {
   oc8_as_stream_free(&is);
   fclose(f);
 }
+
+TEST_CASE("Stream get/peek from functor", "") {
+  oc8_as_stream_t is;
+  oc8_as_stream_init_from_functor(&is, new_functor_str("helo"));
+  REQUIRE(oc8_as_stream_peek(&is) == 'h');
+  REQUIRE(oc8_as_stream_get(&is) == 'h');
+  REQUIRE(read_all(&is) == "elo");
+  REQUIRE(oc8_as_stream_peek(&is) == EOF);
+  REQUIRE(oc8_as_stream_get(&is) == EOF);
+  oc8_as_stream_free(&is);
+}
+
+TEST_CASE("Stream from path", "") {
+  save_str("hello");
+  oc8_as_stream_t is;
+  REQUIRE(oc8_as_stream_init_from_path(&is, TMP_FILE) == 0);
+  // Mapped file: all data is already available
+  REQUIRE(is.end - is.cur == 5);
+  REQUIRE(read_all(&is) == "hello");
+  REQUIRE(oc8_as_stream_get(&is) == EOF);
+  oc8_as_stream_free(&is);
+
+  save_str("");
+  REQUIRE(oc8_as_stream_init_from_path(&is, TMP_FILE) == 0);
+  REQUIRE(oc8_as_stream_peek(&is) == EOF);
+  oc8_as_stream_free(&is);
+
+  REQUIRE(oc8_as_stream_init_from_path(&is, "/tmp/no/such/file.c8s") != 0);
+}
+
+TEST_CASE("Stream many blocks", "") {
+  std::string data;
+  for (int i = 0; data.size() < 3 * OC8_AS_STREAM_BLOCK_SIZE + 17; ++i)
+    data += "line " + std::to_string(i) + "\n";
+  save_str(data.c_str());
+
+  FILE *f = fopen(TMP_FILE, "r");
+  oc8_as_stream_t is;
+  oc8_as_stream_init_from_file(&is, f);
+  REQUIRE(read_all(&is) == data);
+  oc8_as_stream_free(&is);
+  fclose(f);
+
+  oc8_as_stream_init_from_functor(&is, new_functor_str(data.c_str()));
+  REQUIRE(read_all(&is) == data);
+  oc8_as_stream_free(&is);
+
+  oc8_as_stream_init_from_raw(&is, data.c_str(), data.size());
+  REQUIRE(read_all(&is) == data);
+  oc8_as_stream_free(&is);
+}
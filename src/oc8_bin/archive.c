@@ -0,0 +1,288 @@
+#include "oc8_bin/archive.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "oc8_bin/format.h"
+#include "oc8_smap/oc8_smap.h"
+
+const uint8_t g_oc8_bin_ar_magic_value[8] = {0x14, 0x40, 0x4F, 0x43,
+                                             0x38, 0x41, 0x52, 0x00};
+
+int oc8_bin_archive_init(oc8_bin_archive_t *ar, const void *in_buf,
+                         size_t buf_len) {
+  const uint8_t *data = (const uint8_t *)in_buf;
+  memset(ar, 0, sizeof(oc8_bin_archive_t));
+  if (buf_len < sizeof(oc8_bin_raw_ar_header_t))
+    return -1;
+
+  const oc8_bin_raw_ar_header_t *header =
+      (const oc8_bin_raw_ar_header_t *)data;
+  if (memcmp(header->magic, g_oc8_bin_ar_magic_value,
+             sizeof(header->magic)) != 0 ||
+      header->version != OC8_BIN_AR_VERSION)
+    return -1;
+
+  size_t nb_members = header->nb_members;
+  size_t nb_syms = header->nb_syms;
+  size_t names_size = header->names_size;
+  size_t members_end = sizeof(oc8_bin_raw_ar_header_t) +
+                       nb_members * sizeof(oc8_bin_raw_ar_member_t);
+  if (nb_members > buf_len || members_end > buf_len || nb_syms > buf_len)
+    return -1;
+  size_t syms_end = members_end + nb_syms * sizeof(oc8_bin_raw_ar_sym_t);
+  if (syms_end > buf_len || names_size > buf_len - syms_end)
+    return -1;
+
+  const oc8_bin_raw_ar_member_t *members =
+      (const oc8_bin_raw_ar_member_t *)(data +
+                                        sizeof(oc8_bin_raw_ar_header_t));
+  const oc8_bin_raw_ar_sym_t *syms =
+      (const oc8_bin_raw_ar_sym_t *)(data + members_end);
+  const char *names = (const char *)(data + syms_end);
+  if (names_size && names[names_size - 1] != '\0')
+    return -1;
+
+  for (size_t i = 0; i < nb_members; ++i) {
+    const oc8_bin_raw_ar_member_t *m = &members[i];
+    if (m->name >= names_size || m->offset > buf_len ||
+        m->size > buf_len - m->offset)
+      return -1;
+  }
+  for (size_t i = 0; i < nb_syms; ++i) {
+    const oc8_bin_raw_ar_sym_t *s = &syms[i];
+    if (s->name >= names_size || s->member >= nb_members ||
+        s->hash != oc8_bin_raw_hash_name(names + s->name))
+      return -1;
+  }
+
+  ar->data = data;
+  ar->size = buf_len;
+  ar->members = members;
+  ar->nb_members = nb_members;
+  ar->syms = syms;
+  ar->nb_syms = nb_syms;
+  ar->names = names;
+  ar->names_size = names_size;
+  return 0;
+}
+
+int oc8_bin_archive_open(oc8_bin_archive_t *ar, const char *path) {
+  oc8_bin_map_t map;
+  if (oc8_bin_map_open(&map, path) != 0) {
+    memset(ar, 0, sizeof(oc8_bin_archive_t));
+    return -1;
+  }
+
+  if (oc8_bin_archive_init(ar, map.data, map.size) != 0) {
+    oc8_bin_map_close(&map);
+    return -1;
+  }
+  ar->map = map;
+  return 0;
+}
+
+void oc8_bin_archive_close(oc8_bin_archive_t *ar) {
+  oc8_bin_map_close(&ar->map);
+  memset(ar, 0, sizeof(oc8_bin_archive_t));
+}
+
+static int cmp_sym(uint32_t hash, const char *name, uint32_t other_hash,
+                   const char *other_name) {
+  if (hash != other_hash)
+    return hash < other_hash ? -1 : 1;
+  return strcmp(name, other_name);
+}
+
+long oc8_bin_archive_find_sym(const oc8_bin_archive_t *ar, const char *name) {
+  uint32_t hash = oc8_bin_raw_hash_name(name);
+  size_t lo = 0;
+  size_t hi = ar->nb_syms;
+  while (lo < hi) {
+    size_t mid = lo + (hi - lo) / 2;
+    const oc8_bin_raw_ar_sym_t *s = &ar->syms[mid];
+    int cmp = cmp_sym(hash, name, s->hash, ar->names + s->name);
+    if (cmp == 0)
+      return (long)s->member;
+    if (cmp < 0)
+      hi = mid;
+    else
+      lo = mid + 1;
+  }
+  return -1;
+}
+
+void oc8_bin_archive_get(const oc8_bin_archive_t *ar, size_t idx,
+                         oc8_bin_pack_member_t *member) {
+  const oc8_bin_raw_ar_member_t *m = &ar->members[idx];
+  member->name = ar->names + m->name;
+  member->data = ar->data + m->offset;
+  member->size = m->size;
+}
+
+typedef struct {
+  uint32_t hash;
+  const char *name; // inside the member data
+  uint32_t member;
+} sort_item_t;
+
+// Same symbols are sorted by member: the first one is indexed
+static int cmp_sort_items(const void *a, const void *b) {
+  const sort_item_t *x = (const sort_item_t *)a;
+  const sort_item_t *y = (const sort_item_t *)b;
+  int cmp = cmp_sym(x->hash, x->name, y->hash, y->name);
+  if (cmp != 0)
+    return cmp;
+  return x->member < y->member ? -1 : x->member > y->member;
+}
+
+// List the global symbols defined by all members
+// @returns the number of symbols, they are sorted and unique
+static size_t list_syms(const oc8_bin_pack_member_t *members,
+                        size_t nb_members, sort_item_t **out_items) {
+  size_t cap = 16;
+  size_t nb_items = 0;
+  sort_item_t *items = malloc(cap * sizeof(sort_item_t));
+  oc8_smap_t names;
+  oc8_smap_init(&names);
+
+  for (size_t i = 0; i < nb_members; ++i) {
+    oc8_bin_file_view_t view;
+    if (!oc8_smap_insert(&names, members[i].name, i)) {
+      fprintf(stderr, "oc8_bin_archive_write_raw: Duplicate member `%s'.\n",
+              members[i].name);
+      goto err;
+    }
+    if (oc8_bin_file_view_init(&view, members[i].data, members[i].size) !=
+            0 ||
+        view.type != OC8_BIN_FILE_TYPE_OBJ) {
+      fprintf(stderr,
+              "oc8_bin_archive_write_raw: Member `%s' isn't an object "
+              "file.\n",
+              members[i].name);
+      goto err;
+    }
+
+    for (size_t j = 0; j < view.syms_defs_size; ++j) {
+      oc8_bin_view_sym_t sym;
+      if (oc8_bin_file_view_get_sym(&view, j, &sym) != 0) {
+        fprintf(stderr,
+                "oc8_bin_archive_write_raw: Invalid symbols in member "
+                "`%s'.\n",
+                members[i].name);
+        goto err;
+      }
+      if (!sym.is_global || sym.addr == 0)
+        continue;
+      if (nb_items == cap) {
+        cap *= 2;
+        items = realloc(items, cap * sizeof(sort_item_t));
+      }
+      items[nb_items].hash = oc8_bin_raw_hash_name(sym.name);
+      items[nb_items].name = sym.name;
+      items[nb_items++].member = i;
+    }
+  }
+  oc8_smap_free(&names);
+
+  qsort(items, nb_items, sizeof(sort_item_t), cmp_sort_items);
+  size_t nb_syms = 0;
+  for (size_t i = 0; i < nb_items; ++i)
+    if (nb_syms == 0 || cmp_sym(items[nb_syms - 1].hash,
+                                items[nb_syms - 1].name, items[i].hash,
+                                items[i].name) != 0)
+      items[nb_syms++] = items[i];
+  *out_items = items;
+  return nb_syms;
+
+err:
+  oc8_smap_free(&names);
+  free(items);
+  *out_items = NULL;
+  return (size_t)-1;
+}
+
+size_t oc8_bin_archive_write_raw(const oc8_bin_pack_member_t *members,
+                                 size_t nb_members, uint8_t *out_buf) {
+  sort_item_t *items;
+  size_t nb_syms = list_syms(members, nb_members, &items);
+  if (nb_syms == (size_t)-1)
+    return 0;
+
+  size_t names_size = 0;
+  for (size_t i = 0; i < nb_members; ++i)
+    names_size += strlen(members[i].name) + 1;
+  for (size_t i = 0; i < nb_syms; ++i)
+    names_size += strlen(items[i].name) + 1;
+  size_t members_end = sizeof(oc8_bin_raw_ar_header_t) +
+                       nb_members * sizeof(oc8_bin_raw_ar_member_t);
+  size_t syms_end = members_end + nb_syms * sizeof(oc8_bin_raw_ar_sym_t);
+  size_t len = syms_end + names_size;
+
+  oc8_bin_raw_ar_header_t header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, g_oc8_bin_ar_magic_value, sizeof(header.magic));
+  header.version = OC8_BIN_AR_VERSION;
+  header.nb_members = (uint32_t)nb_members;
+  header.nb_syms = (uint32_t)nb_syms;
+  header.names_size = (uint32_t)names_size;
+  if (out_buf)
+    memcpy(out_buf, &header, sizeof(header));
+
+  size_t name_pos = 0;
+  for (size_t i = 0; i < nb_members; ++i) {
+    const oc8_bin_pack_member_t *m = &members[i];
+    size_t name_len = strlen(m->name) + 1;
+    oc8_bin_raw_ar_member_t entry;
+    entry.name = (uint32_t)name_pos;
+    entry.offset = (uint32_t)len;
+    entry.size = (uint32_t)m->size;
+    if (out_buf) {
+      memcpy(out_buf + sizeof(header) + i * sizeof(entry), &entry,
+             sizeof(entry));
+      memcpy(out_buf + syms_end + name_pos, m->name, name_len);
+      memcpy(out_buf + len, m->data, m->size);
+    }
+    name_pos += name_len;
+    len += m->size;
+  }
+
+  for (size_t i = 0; i < nb_syms; ++i) {
+    size_t name_len = strlen(items[i].name) + 1;
+    oc8_bin_raw_ar_sym_t entry;
+    entry.hash = items[i].hash;
+    entry.name = (uint32_t)name_pos;
+    entry.member = items[i].member;
+    if (out_buf) {
+      memcpy(out_buf + members_end + i * sizeof(entry), &entry,
+             sizeof(entry));
+      memcpy(out_buf + syms_end + name_pos, items[i].name, name_len);
+    }
+    name_pos += name_len;
+  }
+
+  free(items);
+  return len;
+}
+
+int oc8_bin_archive_write_to_file(const oc8_bin_pack_member_t *members,
+                                  size_t nb_members, const char *path) {
+  size_t len = oc8_bin_archive_write_raw(members, nb_members, NULL);
+  if (len == 0)
+    return -1;
+
+  uint8_t *buf = malloc(len);
+  oc8_bin_archive_write_raw(members, nb_members, buf);
+
+  FILE *os = fopen(path, "wb");
+  int err = !os || fwrite(buf, 1, len, os) != len;
+  if (os && fclose(os) != 0)
+    err = 1;
+  free(buf);
+  if (err)
+    fprintf(stderr,
+            "oc8_bin_archive_write_to_file: Failed to write file `%s'.\n",
+            path);
+  return err ? -1 : 0;
+}
@@ -4,39 +4,73 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "oc8_bin/bin_view.h"
 #include "oc8_bin/format.h"
-#include "oc8_defs/debug.h"
 
-static void check_magic(const oc8_bin_raw_header_t *header) {
+static int check_magic(const oc8_bin_raw_header_t *header) {
   for (size_t i = 0; i < sizeof(header->magic); ++i)
     if (header->magic[i] != g_oc8_bin_raw_magic_value[i]) {
       fprintf(
           stderr,
-          "oc8_bin_read_file_raw: Not a bin file (invalid magic number)\n.");
-      PANIC();
+          "oc8_bin_read_file_raw: Not a bin file (invalid magic number).\n");
+      return -1;
     }
+  return 0;
 }
 
-static void io_error(const char *path) {
-  fprintf(stderr, "oc8_bin_read_from_file: Failed to read file `%s'.\n", path);
-  PANIC();
-}
+// Version 11: go through a view, and copy everything
+static int read_v11(oc8_bin_file_t *f, const void *in_buf, size_t buf_len) {
+  oc8_bin_file_view_t view;
+  if (oc8_bin_file_view_init(&view, in_buf, buf_len) != 0) {
+    fprintf(stderr, "oc8_bin_read_file_raw: Invalid data. Sections directory "
+                    "is corrupted.\n");
+    return -1;
+  }
 
-void oc8_bin_read_file_raw(oc8_bin_file_t *f, const void *in_buf,
-                           size_t buf_len) {
-  oc8_bin_file_init(f);
-  if (buf_len < sizeof(oc8_bin_raw_header_t)) {
-    fprintf(stderr, "oc8_bin_read_file_raw: Not a bin file (invalid header)\n");
-    PANIC();
+  if (oc8_bin_file_set_version(f, view.version) != 0 ||
+      oc8_bin_file_set_type(f, view.type) != 0 ||
+      oc8_bin_file_set_defs_count(f, view.syms_defs_size) != 0)
+    return -1;
+  for (size_t i = 0; i < view.syms_defs_size; ++i) {
+    oc8_bin_view_sym_t sym;
+    if (oc8_bin_file_view_get_sym(&view, i, &sym) != 0) {
+      fprintf(stderr, "oc8_bin_read_file_raw: Invalid symbol def %u.\n",
+              (unsigned)i);
+      return -1;
+    }
+    if (oc8_bin_file_add_def(f, sym.name, sym.is_global, sym.type,
+                             sym.addr) < 0 ||
+        oc8_bin_file_set_def_size(f, sym.id, sym.size) != 0)
+      return -1;
   }
 
+  oc8_bin_sym_ref_t *refs = oc8_arena_alloc(
+      f->arena, view.syms_refs_size * sizeof(oc8_bin_sym_ref_t));
+  if (oc8_bin_file_view_get_refs(&view, refs) != 0) {
+    fprintf(stderr, "oc8_bin_read_file_raw: Invalid symbol refs.\n");
+    oc8_arena_release(f->arena, refs);
+    return -1;
+  }
+  for (size_t i = 0; i < view.syms_refs_size; ++i)
+    oc8_bin_file_add_ref(f, refs[i].ins_addr, refs[i].sym_id);
+  oc8_arena_release(f->arena, refs);
+
+  if (oc8_bin_file_init_rom(f, view.rom_size) != 0)
+    return -1;
+  memcpy(f->rom, view.rom, view.rom_size);
+  return 0;
+}
+
+// Version 10: fixed size entries
+static int read_v10(oc8_bin_file_t *f, const void *in_buf, size_t buf_len) {
   const oc8_bin_raw_header_t *header = (const oc8_bin_raw_header_t *)in_buf;
-  check_magic(header);
-  oc8_bin_file_set_version(f, header->version);
-  oc8_bin_file_set_type(
-      f, header->type == 1
-             ? OC8_BIN_FILE_TYPE_OBJ
-             : (header->type == 2 ? OC8_BIN_FILE_TYPE_BIN : 0xFF));
+
+  if (oc8_bin_file_set_version(f, header->version) != 0 ||
+      oc8_bin_file_set_type(
+          f, header->type == 1
+                 ? OC8_BIN_FILE_TYPE_OBJ
+                 : (header->type == 2 ? OC8_BIN_FILE_TYPE_BIN : 0xFF)) != 0)
+    return -1;
   size_t nb_defs = header->nb_syms_defs;
   size_t nb_refs = header->nb_syms_refs;
   size_t rom_size = header->rom_size;
@@ -48,10 +82,11 @@ void oc8_bin_read_file_raw(oc8_bin_file_t *f, const void *in_buf,
             "oc8_bin_read_file_raw: Invalid data. According to header, raw "
             "data should be %u bytes, but it's only %u bytes.\n",
             (unsigned)len, (unsigned)buf_len);
-    PANIC();
+    return -1;
   }
 
-  oc8_bin_file_set_defs_count(f, nb_defs);
+  if (oc8_bin_file_set_defs_count(f, nb_defs) != 0)
+    return -1;
 
   const oc8_bin_raw_sym_def_t *defs = (const oc8_bin_raw_sym_def_t *)&header[1];
   const oc8_bin_raw_sym_ref_t *refs =
@@ -75,8 +110,9 @@ void oc8_bin_read_file_raw(oc8_bin_file_t *f, const void *in_buf,
       raw_type = 0xFF;
     };
 
-    oc8_bin_file_add_def(f, raw_def->name, raw_def->is_global, raw_type,
-                         raw_def->addr);
+    if (oc8_bin_file_add_def(f, raw_def->name, raw_def->is_global, raw_type,
+                             raw_def->addr) < 0)
+      return -1;
   }
 
   for (size_t i = 0; i < nb_refs; ++i) {
@@ -84,24 +120,49 @@ void oc8_bin_read_file_raw(oc8_bin_file_t *f, const void *in_buf,
     oc8_bin_file_add_ref(f, raw_ref->ins_addr, raw_ref->sym_id);
   }
 
-  oc8_bin_file_init_rom(f, rom_size);
+  if (oc8_bin_file_init_rom(f, rom_size) != 0)
+    return -1;
   memcpy(f->rom, rom_data, rom_size);
+  return 0;
+}
+
+int oc8_bin_read_file_raw(oc8_bin_file_t *f, const void *in_buf,
+                          size_t buf_len) {
+  return oc8_bin_read_file_raw_arena(f, in_buf, buf_len, NULL);
 }
 
-void oc8_bin_read_from_file(oc8_bin_file_t *f, const char *path) {
-  FILE *is = fopen(path, "rb");
-  if (is == NULL)
-    io_error(path);
-  fseek(is, 0, SEEK_END);
-  size_t size = ftell(is);
-  fseek(is, 0, SEEK_SET);
-  if (!size)
-    io_error(path);
-
-  char *buf = malloc(size);
-  if (fread(buf, 1, size, is) != size)
-    io_error(path);
-  oc8_bin_read_file_raw(f, buf, size);
-  free(buf);
-  fclose(is);
+int oc8_bin_read_file_raw_arena(oc8_bin_file_t *f, const void *in_buf,
+                                size_t buf_len, oc8_arena_t *arena) {
+  if (buf_len < sizeof(oc8_bin_raw_header_t)) {
+    fprintf(stderr, "oc8_bin_read_file_raw: Not a bin file (invalid header)\n");
+    return -1;
+  }
+  const oc8_bin_raw_header_t *header = (const oc8_bin_raw_header_t *)in_buf;
+  if (check_magic(header) != 0)
+    return -1;
+
+  oc8_bin_file_init_arena(f, arena);
+  int err = header->version == OC8_BIN_VERSION_V11
+                ? read_v11(f, in_buf, buf_len)
+                : read_v10(f, in_buf, buf_len);
+  if (err)
+    oc8_bin_file_free(f);
+  return err;
+}
+
+int oc8_bin_read_from_file(oc8_bin_file_t *f, const char *path) {
+  return oc8_bin_read_from_file_arena(f, path, NULL);
+}
+
+int oc8_bin_read_from_file_arena(oc8_bin_file_t *f, const char *path,
+                                 oc8_arena_t *arena) {
+  oc8_bin_map_t map;
+  if (oc8_bin_map_open(&map, path) != 0) {
+    fprintf(stderr, "oc8_bin_read_from_file: Failed to read file `%s'.\n",
+            path);
+    return -1;
+  }
+  int err = oc8_bin_read_file_raw_arena(f, map.data, map.size, arena);
+  oc8_bin_map_close(&map);
+  return err;
 }
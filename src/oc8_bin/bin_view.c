@@ -0,0 +1,477 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "oc8_bin/bin_view.h"
+
+#include "oc8_bin/pack.h"
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Map the opened file `fd`, of infos `st`
+static int map_fd(oc8_bin_map_t *map, int fd, const struct stat *st) {
+  if (st->st_size <= 0)
+    return -1;
+
+  // The mapping stays valid after the file is closed
+  void *data = mmap(NULL, (size_t)st->st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  if (data == MAP_FAILED)
+    return -1;
+
+  map->data = map->base = (const uint8_t *)data;
+  map->size = map->base_size = (size_t)st->st_size;
+  map->shared_pack = NULL;
+  return 0;
+}
+
+static int map_file(oc8_bin_map_t *map, const char *path) {
+  int fd = open(path, O_RDONLY);
+  if (fd < 0)
+    return -1;
+
+  struct stat st;
+  int err = fstat(fd, &st) != 0 || map_fd(map, fd, &st) != 0;
+  close(fd);
+  return err ? -1 : 0;
+}
+
+// A pack mapped once, and shared by all its open members
+typedef struct shared_pack_s {
+  char *path;
+  struct stat st; // to detect that the file changed
+  oc8_bin_map_t map;
+  oc8_bin_pack_t pack;
+  size_t refs;
+  struct shared_pack_s *next;
+} shared_pack_t;
+
+static pthread_mutex_t g_packs_lock = PTHREAD_MUTEX_INITIALIZER;
+static shared_pack_t *g_packs = NULL;
+// Members are often read one after the other: the last pack used has one
+// more ref, and stays mapped when they are closed
+static shared_pack_t *g_last_pack = NULL;
+
+static int same_file(const struct stat *a, const struct stat *b) {
+  return a->st_dev == b->st_dev && a->st_ino == b->st_ino &&
+         a->st_size == b->st_size && a->st_mtim.tv_sec == b->st_mtim.tv_sec &&
+         a->st_mtim.tv_nsec == b->st_mtim.tv_nsec;
+}
+
+// Must be called with the lock held
+static void pack_unref(shared_pack_t *sp) {
+  if (--sp->refs)
+    return;
+
+  shared_pack_t **it = &g_packs;
+  while (*it != sp)
+    it = &(*it)->next;
+  *it = sp->next;
+  munmap((void *)sp->map.base, sp->map.base_size);
+  free(sp->path);
+  free(sp);
+}
+
+// @returns the pack at `path` with one more ref, or NULL if it cannot be
+// mapped or isn't a pack
+// Must be called with the lock held
+static shared_pack_t *pack_get(const char *path) {
+  int fd = open(path, O_RDONLY);
+  if (fd < 0)
+    return NULL;
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    close(fd);
+    return NULL;
+  }
+
+  // A pack rewritten since it was mapped is mapped again
+  shared_pack_t *sp = g_packs;
+  while (sp && (strcmp(sp->path, path) != 0 || !same_file(&sp->st, &st)))
+    sp = sp->next;
+  if (!sp) {
+    sp = malloc(sizeof(shared_pack_t));
+    if (map_fd(&sp->map, fd, &st) != 0) {
+      close(fd);
+      free(sp);
+      return NULL;
+    }
+    if (oc8_bin_pack_init(&sp->pack, sp->map.base, sp->map.base_size) != 0) {
+      close(fd);
+      oc8_bin_map_close(&sp->map);
+      free(sp);
+      return NULL;
+    }
+    sp->path = strdup(path);
+    sp->st = st;
+    sp->refs = 0;
+    sp->next = g_packs;
+    g_packs = sp;
+  }
+  close(fd);
+
+  ++sp->refs;
+  if (g_last_pack != sp) {
+    ++sp->refs;
+    if (g_last_pack)
+      pack_unref(g_last_pack);
+    g_last_pack = sp;
+  }
+  return sp;
+}
+
+// Get the shared mapping of the pack, and only keep a view of the member
+static int map_member(oc8_bin_map_t *map, const char *path,
+                      const char *member) {
+  size_t pack_path_len = (size_t)(member - path - 1);
+  char *pack_path = malloc(pack_path_len + 1);
+  memcpy(pack_path, path, pack_path_len);
+  pack_path[pack_path_len] = '\0';
+
+  pthread_mutex_lock(&g_packs_lock);
+  shared_pack_t *sp = pack_get(pack_path);
+  long idx = sp ? oc8_bin_pack_find(&sp->pack, member) : -1;
+  oc8_bin_pack_member_t res;
+  if (idx >= 0)
+    oc8_bin_pack_get(&sp->pack, (size_t)idx, &res);
+  if (sp && (idx < 0 || res.size == 0)) {
+    pack_unref(sp);
+    sp = NULL;
+  }
+  pthread_mutex_unlock(&g_packs_lock);
+  free(pack_path);
+  if (!sp)
+    return -1;
+
+  map->data = (const uint8_t *)res.data;
+  map->size = res.size;
+  map->base = sp->map.base;
+  map->base_size = sp->map.base_size;
+  map->shared_pack = sp;
+  return 0;
+}
+
+int oc8_bin_map_open(oc8_bin_map_t *map, const char *path) {
+  map->data = map->base = NULL;
+  map->size = map->base_size = 0;
+  map->shared_pack = NULL;
+  return map_file(map, path);
+}
+
+int oc8_bin_map_open_member(oc8_bin_map_t *map, const char *path) {
+  if (oc8_bin_map_open(map, path) == 0)
+    return 0;
+  const char *member = oc8_bin_pack_split_path(path);
+  return member ? map_member(map, path, member) : -1;
+}
+
+void oc8_bin_map_close(oc8_bin_map_t *map) {
+  if (map->shared_pack) {
+    pthread_mutex_lock(&g_packs_lock);
+    pack_unref((shared_pack_t *)map->shared_pack);
+    pthread_mutex_unlock(&g_packs_lock);
+  } else if (map->base)
+    munmap((void *)map->base, map->base_size);
+  map->data = map->base = NULL;
+  map->size = map->base_size = 0;
+  map->shared_pack = NULL;
+}
+
+static uint16_t read_u16(const uint8_t *in) {
+  uint16_t res;
+  memcpy(&res, in, sizeof(uint16_t));
+  return res;
+}
+
+static int raw_type(uint16_t type, oc8_bin_file_type_t *out) {
+  if (type != 1 && type != 2)
+    return -1;
+  *out = type == 1 ? OC8_BIN_FILE_TYPE_OBJ : OC8_BIN_FILE_TYPE_BIN;
+  return 0;
+}
+
+static oc8_bin_sym_type_t raw_sym_type(uint8_t type) {
+  switch (type) {
+  case 0:
+    return OC8_BIN_SYM_TYPE_NO;
+  case 1:
+    return OC8_BIN_SYM_TYPE_FUN;
+  case 2:
+    return OC8_BIN_SYM_TYPE_OBJ;
+  default:
+    return (oc8_bin_sym_type_t)0xFF;
+  }
+}
+
+static int init_v10(oc8_bin_file_view_t *view, const uint8_t *in_buf,
+                    size_t buf_len) {
+  if (buf_len < sizeof(oc8_bin_raw_header_t))
+    return -1;
+
+  const oc8_bin_raw_header_t *header = (const oc8_bin_raw_header_t *)in_buf;
+  size_t nb_defs = header->nb_syms_defs;
+  size_t nb_refs = header->nb_syms_refs;
+  size_t rom_size = header->rom_size;
+  size_t len = sizeof(oc8_bin_raw_header_t) +
+               nb_defs * sizeof(oc8_bin_raw_sym_def_t) +
+               nb_refs * sizeof(oc8_bin_raw_sym_ref_t) + rom_size;
+  if (len != buf_len || raw_type(header->type, &view->type) != 0)
+    return -1;
+
+  view->syms_defs = (const oc8_bin_raw_sym_def_t *)&header[1];
+  view->syms_defs_size = nb_defs;
+  view->syms_refs = (const oc8_bin_raw_sym_ref_t *)&view->syms_defs[nb_defs];
+  view->syms_refs_size = nb_refs;
+  view->rom = (const uint8_t *)&view->syms_refs[nb_refs];
+  view->rom_size = rom_size;
+  return 0;
+}
+
+static int init_v11(oc8_bin_file_view_t *view, const uint8_t *in_buf,
+                    size_t buf_len) {
+  if (buf_len < sizeof(oc8_bin_raw_header_v11_t))
+    return -1;
+
+  const oc8_bin_raw_header_v11_t *header =
+      (const oc8_bin_raw_header_v11_t *)in_buf;
+  size_t nb_secs = header->nb_secs;
+  if (raw_type(header->type, &view->type) != 0 ||
+      sizeof(oc8_bin_raw_header_v11_t) + nb_secs * sizeof(oc8_bin_raw_sec_t) >
+          buf_len)
+    return -1;
+
+  // Locate all sections
+  const oc8_bin_raw_sec_t *dir = (const oc8_bin_raw_sec_t *)&header[1];
+  const uint8_t *secs[OC8_BIN_NB_SECS + 1] = {NULL};
+  size_t sizes[OC8_BIN_NB_SECS + 1] = {0};
+  for (size_t i = 0; i < nb_secs; ++i) {
+    size_t kind = dir[i].kind;
+    size_t off = dir[i].offset;
+    size_t size = dir[i].size;
+    if (off > buf_len || size > buf_len - off)
+      return -1;
+    if (kind < OC8_BIN_SEC_ROM || kind > OC8_BIN_NB_SECS)
+      continue; // Unknown sections are ignored
+    if (secs[kind])
+      return -1;
+    secs[kind] = in_buf + off;
+    sizes[kind] = size;
+  }
+
+  view->rom = secs[OC8_BIN_SEC_ROM];
+  view->rom_size = sizes[OC8_BIN_SEC_ROM];
+
+  view->strtab = (const char *)secs[OC8_BIN_SEC_STRTAB];
+  view->strtab_size = sizes[OC8_BIN_SEC_STRTAB];
+  if (view->strtab_size && view->strtab[view->strtab_size - 1] != '\0')
+    return -1;
+
+  if (sizes[OC8_BIN_SEC_SYMS] % sizeof(oc8_bin_raw_sym_v11_t))
+    return -1;
+  view->syms = (const oc8_bin_raw_sym_v11_t *)secs[OC8_BIN_SEC_SYMS];
+  view->syms_defs_size =
+      sizes[OC8_BIN_SEC_SYMS] / sizeof(oc8_bin_raw_sym_v11_t);
+
+  view->refs = secs[OC8_BIN_SEC_REFS];
+  view->refs_size = sizes[OC8_BIN_SEC_REFS];
+  uint32_t nb_refs = 0;
+  if (view->refs_size &&
+      !oc8_bin_raw_read_varint(view->refs, view->refs_size, &nb_refs))
+    return -1;
+  view->syms_refs_size = nb_refs;
+
+  // The indexes are optional
+  if (sizes[OC8_BIN_SEC_HASH] >= sizeof(uint32_t)) {
+    uint32_t nb_buckets;
+    memcpy(&nb_buckets, secs[OC8_BIN_SEC_HASH], sizeof(uint32_t));
+    if (nb_buckets == 0 || (nb_buckets & (nb_buckets - 1)) ||
+        sizes[OC8_BIN_SEC_HASH] !=
+            sizeof(uint32_t) + (size_t)nb_buckets * sizeof(uint16_t))
+      return -1;
+    view->hash = secs[OC8_BIN_SEC_HASH] + sizeof(uint32_t);
+    view->hash_nb_buckets = nb_buckets;
+  }
+
+  if (sizes[OC8_BIN_SEC_ADDR]) {
+    if (sizes[OC8_BIN_SEC_ADDR] != view->syms_defs_size * sizeof(uint16_t))
+      return -1;
+    view->addr_index = secs[OC8_BIN_SEC_ADDR];
+  }
+
+  if (sizes[OC8_BIN_SEC_SIZES]) {
+    if (sizes[OC8_BIN_SEC_SIZES] != view->syms_defs_size * sizeof(uint16_t))
+      return -1;
+    view->sizes = secs[OC8_BIN_SEC_SIZES];
+  }
+  return 0;
+}
+
+int oc8_bin_file_view_init(oc8_bin_file_view_t *view, const void *in_buf,
+                           size_t buf_len) {
+  memset(view, 0, sizeof(oc8_bin_file_view_t));
+
+  // Magic and version are at the same place for all versions
+  const oc8_bin_raw_header_t *header = (const oc8_bin_raw_header_t *)in_buf;
+  if (buf_len < sizeof(header->magic) + sizeof(header->version) ||
+      memcmp(header->magic, g_oc8_bin_raw_magic_value,
+             sizeof(header->magic)) != 0)
+    return -1;
+
+  view->version = header->version;
+  int err = -1;
+  if (view->version == OC8_BIN_VERSION_V10)
+    err = init_v10(view, (const uint8_t *)in_buf, buf_len);
+  else if (view->version == OC8_BIN_VERSION_V11)
+    err = init_v11(view, (const uint8_t *)in_buf, buf_len);
+
+  if (err)
+    memset(view, 0, sizeof(oc8_bin_file_view_t));
+  return err;
+}
+
+int oc8_bin_file_view_open(oc8_bin_file_view_t *view, const char *path) {
+  oc8_bin_map_t map;
+  if (oc8_bin_map_open(&map, path) != 0) {
+    memset(view, 0, sizeof(oc8_bin_file_view_t));
+    return -1;
+  }
+
+  if (oc8_bin_file_view_init(view, map.data, map.size) != 0) {
+    oc8_bin_map_close(&map);
+    return -1;
+  }
+  view->map = map;
+  return 0;
+}
+
+void oc8_bin_file_view_close(oc8_bin_file_view_t *view) {
+  oc8_bin_map_close(&view->map);
+  memset(view, 0, sizeof(oc8_bin_file_view_t));
+}
+
+int oc8_bin_file_view_get_sym(const oc8_bin_file_view_t *view, size_t id,
+                              oc8_bin_view_sym_t *sym) {
+  if (id >= view->syms_defs_size)
+    return -1;
+
+  sym->id = (uint16_t)id;
+  if (view->syms_defs) {
+    const oc8_bin_raw_sym_def_t *def = &view->syms_defs[id];
+    if (def->name[OC8_MAX_SYM_SIZE] != '\0')
+      return -1;
+    sym->name = def->name;
+    sym->is_global = def->is_global;
+    sym->type = raw_sym_type(def->type);
+    sym->addr = def->addr;
+    sym->size = 0;
+  } else {
+    const oc8_bin_raw_sym_v11_t *def = &view->syms[id];
+    if (def->name >= view->strtab_size)
+      return -1;
+    sym->name = view->strtab + def->name;
+    sym->is_global = def->is_global;
+    sym->type = raw_sym_type(def->type);
+    sym->addr = def->addr;
+    sym->size = view->sizes ? read_u16(view->sizes + id * sizeof(uint16_t)) : 0;
+  }
+  return 0;
+}
+
+long oc8_bin_file_view_find_global(const oc8_bin_file_view_t *view,
+                                   const char *name) {
+  oc8_bin_view_sym_t sym;
+
+  if (view->hash) {
+    size_t mask = view->hash_nb_buckets - 1;
+    size_t idx = oc8_bin_raw_hash_name(name) & mask;
+    for (size_t i = 0; i < view->hash_nb_buckets; ++i) {
+      uint16_t val = read_u16(view->hash + idx * sizeof(uint16_t));
+      if (!val)
+        break;
+      if (oc8_bin_file_view_get_sym(view, val - 1, &sym) == 0 &&
+          sym.is_global && strcmp(sym.name, name) == 0)
+        return val - 1;
+      idx = (idx + 1) & mask;
+    }
+    return -1;
+  }
+
+  for (size_t i = 0; i < view->syms_defs_size; ++i)
+    if (oc8_bin_file_view_get_sym(view, i, &sym) == 0 && sym.is_global &&
+        strcmp(sym.name, name) == 0)
+      return (long)i;
+  return -1;
+}
+
+long oc8_bin_file_view_find_addr(const oc8_bin_file_view_t *view,
+                                 uint16_t addr) {
+  oc8_bin_view_sym_t sym;
+
+  if (view->addr_index) {
+    // Lower bound of addr
+    size_t beg = 0;
+    size_t end = view->syms_defs_size;
+    while (beg < end) {
+      size_t mid = beg + (end - beg) / 2;
+      uint16_t id = read_u16(view->addr_index + mid * sizeof(uint16_t));
+      if (oc8_bin_file_view_get_sym(view, id, &sym) != 0)
+        return -1;
+      if (sym.addr < addr)
+        beg = mid + 1;
+      else
+        end = mid;
+    }
+    if (beg == view->syms_defs_size)
+      return -1;
+    uint16_t id = read_u16(view->addr_index + beg * sizeof(uint16_t));
+    oc8_bin_file_view_get_sym(view, id, &sym);
+    return sym.addr == addr ? (long)id : -1;
+  }
+
+  for (size_t i = 0; i < view->syms_defs_size; ++i)
+    if (oc8_bin_file_view_get_sym(view, i, &sym) == 0 && sym.addr == addr)
+      return (long)i;
+  return -1;
+}
+
+int oc8_bin_file_view_get_refs(const oc8_bin_file_view_t *view,
+                               oc8_bin_sym_ref_t *out) {
+  if (view->syms_refs) {
+    for (size_t i = 0; i < view->syms_refs_size; ++i) {
+      out[i].ins_addr = view->syms_refs[i].ins_addr;
+      out[i].sym_id = view->syms_refs[i].sym_id;
+    }
+    return 0;
+  }
+
+  const uint8_t *in = view->refs;
+  size_t len = view->refs_size;
+  size_t pos = 0;
+  uint32_t val;
+  if (view->syms_refs_size)
+    pos = oc8_bin_raw_read_varint(in, len, &val);
+
+  uint16_t prev = 0;
+  for (size_t i = 0; i < view->syms_refs_size; ++i) {
+    uint32_t delta;
+    uint32_t sym_id;
+    size_t n = oc8_bin_raw_read_varint(in + pos, len - pos, &delta);
+    if (!n)
+      return -1;
+    pos += n;
+    n = oc8_bin_raw_read_varint(in + pos, len - pos, &sym_id);
+    if (!n)
+      return -1;
+    pos += n;
+
+    // Undo zigzag encoding
+    int32_t diff = (int32_t)(delta >> 1) ^ -(int32_t)(delta & 1);
+    prev = (uint16_t)(prev + diff);
+    out[i].ins_addr = prev;
+    out[i].sym_id = (uint16_t)sym_id;
+  }
+  return 0;
+}
@@ -4,10 +4,15 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "oc8_bin/cache.h"
 #include "oc8_bin/format.h"
-#include "oc8_defs/debug.h"
 
-size_t oc8_bin_write_file_raw(oc8_bin_file_t *f, void *out_buf) {
+static uint8_t raw_sym_type(oc8_bin_sym_type_t type) {
+  return type == OC8_BIN_SYM_TYPE_FUN ? 1
+                                      : (type == OC8_BIN_SYM_TYPE_OBJ ? 2 : 0);
+}
+
+static size_t write_v10(oc8_bin_file_t *f, void *out_buf) {
   char *cbuf = (char *)out_buf;
   size_t nb_defs = f->syms_defs_size;
   size_t nb_refs = f->syms_refs_size;
@@ -24,7 +29,7 @@ size_t oc8_bin_write_file_raw(oc8_bin_file_t *f, void *out_buf) {
   void *rom_data = (void *)&refs[nb_refs];
 
   memcpy(&header->magic[0], g_oc8_bin_raw_magic_value, sizeof(header->magic));
-  header->version = 10;
+  header->version = OC8_BIN_VERSION_V10;
   header->type = f->header.type == OC8_BIN_FILE_TYPE_OBJ ? 1 : 2;
   header->nb_syms_defs = nb_defs;
   header->nb_syms_refs = nb_refs;
@@ -33,11 +38,11 @@ size_t oc8_bin_write_file_raw(oc8_bin_file_t *f, void *out_buf) {
   for (size_t i = 0; i < nb_defs; ++i) {
     oc8_bin_raw_sym_def_t *raw_def = &defs[i];
     oc8_bin_sym_def_t *def = &f->syms_defs[i];
-    memcpy(raw_def->name, def->name, sizeof(raw_def->name));
+    // Names are shorter than OC8_MAX_SYM_SIZE, the rest is zeroed
+    memset(raw_def->name, 0, sizeof(raw_def->name));
+    strcpy(raw_def->name, def->name);
     raw_def->is_global = def->is_global ? 1 : 0;
-    raw_def->type = def->type == OC8_BIN_SYM_TYPE_FUN
-                        ? 1
-                        : (def->type == OC8_BIN_SYM_TYPE_OBJ ? 2 : 0);
+    raw_def->type = raw_sym_type(def->type);
     raw_def->addr = def->addr;
   }
 
@@ -53,24 +58,183 @@ size_t oc8_bin_write_file_raw(oc8_bin_file_t *f, void *out_buf) {
   return len;
 }
 
-void oc8_bin_write_to_file(oc8_bin_file_t *f, const char *path) {
-  FILE *os = fopen(path, "wb");
-  if (os == NULL) {
-    fprintf(stderr, "oc8_bin_write_to_file: Failed to open output file `%s'.\n",
-            path);
-    PANIC();
+static int cmp_u32(const void *a, const void *b) {
+  uint32_t x = *(const uint32_t *)a;
+  uint32_t y = *(const uint32_t *)b;
+  return x < y ? -1 : x > y;
+}
+
+static uint32_t zigzag(int32_t val) {
+  return ((uint32_t)val << 1) ^ (uint32_t)(val >> 31);
+}
+
+static size_t write_refs(oc8_bin_file_t *f, uint8_t *out) {
+  size_t len = oc8_bin_raw_write_varint(f->syms_refs_size, out);
+  uint16_t prev = 0;
+  for (size_t i = 0; i < f->syms_refs_size; ++i) {
+    oc8_bin_sym_ref_t *ref = &f->syms_refs[i];
+    uint32_t delta = zigzag((int32_t)ref->ins_addr - (int32_t)prev);
+    len += oc8_bin_raw_write_varint(delta, out ? out + len : NULL);
+    len += oc8_bin_raw_write_varint(ref->sym_id, out ? out + len : NULL);
+    prev = ref->ins_addr;
+  }
+  return len;
+}
+
+static size_t hash_nb_buckets(oc8_bin_file_t *f) {
+  size_t nb_globals = 0;
+  for (size_t i = 0; i < f->syms_defs_size; ++i)
+    nb_globals += f->syms_defs[i].is_global ? 1 : 0;
+
+  // At most half full
+  size_t res = 1;
+  while (res < 2 * nb_globals)
+    res *= 2;
+  return res;
+}
+
+static void write_u16(uint8_t *out, uint16_t val) {
+  memcpy(out, &val, sizeof(uint16_t));
+}
+
+static void write_hash(oc8_bin_file_t *f, uint8_t *out, size_t nb_buckets) {
+  uint32_t nb_buckets32 = (uint32_t)nb_buckets;
+  memcpy(out, &nb_buckets32, sizeof(uint32_t));
+  uint16_t *buckets = calloc(nb_buckets, sizeof(uint16_t));
+
+  for (size_t i = 0; i < f->syms_defs_size; ++i) {
+    oc8_bin_sym_def_t *def = &f->syms_defs[i];
+    if (!def->is_global)
+      continue;
+    size_t idx = oc8_bin_raw_hash_name(def->name) & (nb_buckets - 1);
+    while (buckets[idx])
+      idx = (idx + 1) & (nb_buckets - 1);
+    buckets[idx] = (uint16_t)(def->id + 1);
+  }
+
+  for (size_t i = 0; i < nb_buckets; ++i)
+    write_u16(out + sizeof(uint32_t) + i * sizeof(uint16_t), buckets[i]);
+  free(buckets);
+}
+
+static void write_addr_index(oc8_bin_file_t *f, uint8_t *out) {
+  // Sort (addr, id) pairs packed in one integer
+  size_t nb_defs = f->syms_defs_size;
+  uint32_t *keys = malloc((nb_defs ? nb_defs : 1) * sizeof(uint32_t));
+  for (size_t i = 0; i < nb_defs; ++i)
+    keys[i] = ((uint32_t)f->syms_defs[i].addr << 16) | f->syms_defs[i].id;
+  qsort(keys, nb_defs, sizeof(uint32_t), cmp_u32);
+
+  for (size_t i = 0; i < nb_defs; ++i)
+    write_u16(out + i * sizeof(uint16_t), (uint16_t)(keys[i] & 0xFFFF));
+  free(keys);
+}
+
+static size_t sizes_size(oc8_bin_file_t *f) {
+  for (size_t i = 0; i < f->syms_defs_size; ++i)
+    if (f->syms_defs[i].size)
+      return f->syms_defs_size * sizeof(uint16_t);
+  return 0;
+}
+
+static size_t write_v11(oc8_bin_file_t *f, void *out_buf) {
+  size_t nb_defs = f->syms_defs_size;
+
+  // Deduplicate names in the string table
+  oc8_smap_t names;
+  oc8_smap_init(&names);
+  uint32_t *names_off = malloc((nb_defs ? nb_defs : 1) * sizeof(uint32_t));
+  size_t strtab_size = 0;
+  for (size_t i = 0; i < nb_defs; ++i) {
+    const char *name = f->syms_defs[i].name;
+    oc8_smap_node_t *node = oc8_smap_find(&names, name);
+    if (node)
+      names_off[i] = (uint32_t)node->val;
+    else {
+      names_off[i] = (uint32_t)strtab_size;
+      oc8_smap_insert(&names, name, strtab_size);
+      strtab_size += strlen(name) + 1;
+    }
+  }
+  oc8_smap_free(&names);
+
+  size_t nb_buckets = hash_nb_buckets(f);
+  oc8_bin_raw_sec_t secs[OC8_BIN_NB_SECS];
+  size_t sizes[OC8_BIN_NB_SECS] = {
+      f->rom_size,
+      strtab_size,
+      nb_defs * sizeof(oc8_bin_raw_sym_v11_t),
+      write_refs(f, NULL),
+      sizeof(uint32_t) + nb_buckets * sizeof(uint16_t),
+      nb_defs * sizeof(uint16_t),
+      sizes_size(f),
+  };
+  size_t off = sizeof(oc8_bin_raw_header_v11_t) + sizeof(secs);
+  for (size_t i = 0; i < OC8_BIN_NB_SECS; ++i) {
+    secs[i].kind = (uint16_t)(OC8_BIN_SEC_ROM + i);
+    secs[i].reserved = 0;
+    secs[i].offset = (uint32_t)off;
+    secs[i].size = (uint32_t)sizes[i];
+    off += sizes[i];
+  }
+  if (out_buf == NULL) {
+    free(names_off);
+    return off;
+  }
+
+  uint8_t *out = (uint8_t *)out_buf;
+  oc8_bin_raw_header_v11_t *header = (oc8_bin_raw_header_v11_t *)out;
+  memcpy(&header->magic[0], g_oc8_bin_raw_magic_value, sizeof(header->magic));
+  header->version = OC8_BIN_VERSION_V11;
+  header->type = f->header.type == OC8_BIN_FILE_TYPE_OBJ ? 1 : 2;
+  header->nb_secs = OC8_BIN_NB_SECS;
+  header->reserved = 0;
+  memcpy(&header[1], secs, sizeof(secs));
+
+  memcpy(out + secs[0].offset, f->rom, f->rom_size);
+
+  char *strtab = (char *)out + secs[1].offset;
+  oc8_bin_raw_sym_v11_t *syms = (oc8_bin_raw_sym_v11_t *)(out + secs[2].offset);
+  for (size_t i = 0; i < nb_defs; ++i) {
+    oc8_bin_sym_def_t *def = &f->syms_defs[i];
+    strcpy(strtab + names_off[i], def->name);
+    syms[i].name = names_off[i];
+    syms[i].addr = def->addr;
+    syms[i].is_global = def->is_global ? 1 : 0;
+    syms[i].type = raw_sym_type(def->type);
   }
 
+  write_refs(f, out + secs[3].offset);
+  write_hash(f, out + secs[4].offset, nb_buckets);
+  write_addr_index(f, out + secs[5].offset);
+  if (secs[6].size)
+    for (size_t i = 0; i < nb_defs; ++i)
+      write_u16(out + secs[6].offset + i * sizeof(uint16_t),
+                f->syms_defs[i].size);
+  free(names_off);
+  return off;
+}
+
+size_t oc8_bin_write_file_raw(oc8_bin_file_t *f, void *out_buf) {
+  if (f->header.version == OC8_BIN_VERSION_V10)
+    return write_v10(f, out_buf);
+  return write_v11(f, out_buf);
+}
+
+int oc8_bin_write_to_file(oc8_bin_file_t *f, const char *path) {
   size_t len = oc8_bin_write_file_raw(f, NULL);
   void *buf = malloc(len);
+  if (!buf) {
+    fprintf(stderr, "oc8_bin_write_to_file: Cannot allocate %zu bytes.\n",
+            len);
+    return -1;
+  }
   oc8_bin_write_file_raw(f, buf);
-  if (fwrite(buf, 1, len, os) != len) {
+  int err = oc8_bin_write_file_atomic(path, buf, len, 0644);
+  if (err)
     fprintf(stderr,
             "oc8_bin_write_to_file: Failed to write to output file `%s'.\n",
             path);
-    PANIC();
-  }
-
   free(buf);
-  fclose(os);
+  return err;
 }
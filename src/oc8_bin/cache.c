@@ -0,0 +1,118 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "oc8_bin/cache.h"
+
+#include "oc8_bin/bin_view.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define FNV_PRIME (0x100000001b3ULL)
+
+// Mode of the cache entries: read-only, so a hard link to an entry cannot be
+// modified in place by mistake
+#define ENTRY_MODE (0444)
+
+uint64_t oc8_bin_hash(const void *data, size_t len, uint64_t h) {
+  const uint8_t *ptr = (const uint8_t *)data;
+  for (size_t i = 0; i < len; ++i) {
+    h ^= ptr[i];
+    h *= FNV_PRIME;
+  }
+  return h;
+}
+
+uint64_t oc8_bin_hash_str(const char *str, uint64_t h) {
+  return oc8_bin_hash(str, strlen(str) + 1, h);
+}
+
+int oc8_bin_cache_open(oc8_bin_cache_t *cache, const char *dir) {
+  struct stat st;
+  if (mkdir(dir, 0777) != 0 && errno != EEXIST)
+    return -1;
+  if (stat(dir, &st) != 0 || !S_ISDIR(st.st_mode))
+    return -1;
+  cache->dir = strdup(dir);
+  return 0;
+}
+
+void oc8_bin_cache_close(oc8_bin_cache_t *cache) {
+  free(cache->dir);
+  cache->dir = NULL;
+}
+
+char *oc8_bin_cache_path(const oc8_bin_cache_t *cache, uint64_t key,
+                         const char *ext) {
+  size_t len = strlen(cache->dir) + strlen(ext) + 19;
+  char *res = malloc(len);
+  snprintf(res, len, "%s/%016llx.%s", cache->dir, (unsigned long long)key,
+           ext);
+  return res;
+}
+
+// Replace `dst` by a copy of `src`
+static int copy_file(const char *src, const char *dst, unsigned mode) {
+  oc8_bin_map_t map;
+  if (oc8_bin_map_open(&map, src) != 0)
+    return -1;
+  int err = oc8_bin_write_file_atomic(dst, map.data, map.size, mode);
+  oc8_bin_map_close(&map);
+  return err;
+}
+
+int oc8_bin_cache_get(const oc8_bin_cache_t *cache, uint64_t key,
+                      const char *ext, const char *out_path) {
+  char *entry = oc8_bin_cache_path(cache, key, ext);
+  int err = access(entry, R_OK);
+  if (!err) {
+    unlink(out_path);
+    if (link(entry, out_path) != 0)
+      err = copy_file(entry, out_path, 0644);
+  }
+  free(entry);
+  return err;
+}
+
+int oc8_bin_cache_put(const oc8_bin_cache_t *cache, uint64_t key,
+                      const char *ext, const char *path) {
+  char *entry = oc8_bin_cache_path(cache, key, ext);
+  int err = copy_file(path, entry, ENTRY_MODE);
+  free(entry);
+  return err;
+}
+
+int oc8_bin_write_file_atomic(const char *path, const void *data, size_t len,
+                              unsigned mode) {
+  size_t tmp_len = strlen(path) + 8;
+  char *tmp_path = malloc(tmp_len);
+  snprintf(tmp_path, tmp_len, "%s.XXXXXX", path);
+  int fd = mkstemp(tmp_path);
+  if (fd < 0) {
+    free(tmp_path);
+    return -1;
+  }
+
+  const uint8_t *ptr = (const uint8_t *)data;
+  int err = 0;
+  while (len && !err) {
+    ssize_t n = write(fd, ptr, len);
+    if (n <= 0)
+      err = errno != EINTR;
+    else {
+      ptr += n;
+      len -= (size_t)n;
+    }
+  }
+  if (fchmod(fd, mode) != 0 || close(fd) != 0)
+    err = 1;
+  if (!err && rename(tmp_path, path) != 0)
+    err = 1;
+  if (err)
+    unlink(tmp_path);
+  free(tmp_path);
+  return err ? -1 : 0;
+}
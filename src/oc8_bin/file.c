@@ -6,16 +6,21 @@
 #include <string.h>
 
 #include "oc8_defs/oc8_defs.h"
+#include "oc8_smap/oc8_strpool.h"
 
 #define REFS_BASE_CAP (16)
 
-void oc8_bin_file_init(oc8_bin_file_t *bf) {
+void oc8_bin_file_init(oc8_bin_file_t *bf) { oc8_bin_file_init_arena(bf, NULL); }
+
+void oc8_bin_file_init_arena(oc8_bin_file_t *bf, oc8_arena_t *arena) {
+  bf->arena = arena;
   bf->syms_defs = NULL;
   bf->syms_defs_size = 0;
   bf->syms_defs_cap = 0;
-  oc8_smap_init(&bf->globals);
+  oc8_smap_init_interned(&bf->globals, arena);
 
-  bf->syms_refs = malloc(REFS_BASE_CAP * sizeof(oc8_bin_sym_ref_t));
+  bf->syms_refs =
+      oc8_arena_alloc(arena, REFS_BASE_CAP * sizeof(oc8_bin_sym_ref_t));
   bf->syms_refs_size = 0;
   bf->syms_refs_cap = REFS_BASE_CAP;
 
@@ -23,57 +28,72 @@ void oc8_bin_file_init(oc8_bin_file_t *bf) {
   bf->rom_size = 0;
 }
 
-void oc8_bin_file_init_binary_rom(oc8_bin_file_t *bf, const void *rom,
-                                  size_t rom_size) {
+int oc8_bin_file_init_binary_rom(oc8_bin_file_t *bf, const void *rom,
+                                 size_t rom_size) {
   oc8_bin_file_init(bf);
-  oc8_bin_file_set_version(bf, 10);
-  oc8_bin_file_set_type(bf, OC8_BIN_FILE_TYPE_BIN);
+  int err = oc8_bin_file_set_version(bf, OC8_BIN_VERSION) ||
+            oc8_bin_file_set_type(bf, OC8_BIN_FILE_TYPE_BIN);
   // add _rom_begin symbol at 0x200
-  oc8_bin_file_set_defs_count(bf, 1);
-  oc8_bin_file_add_def(bf, "_rom_begin", 0, OC8_BIN_SYM_TYPE_NO, OC8_ROM_START);
+  err = err || oc8_bin_file_set_defs_count(bf, 1) ||
+        oc8_bin_file_add_def(bf, "_rom_begin", 0, OC8_BIN_SYM_TYPE_NO,
+                             OC8_ROM_START) < 0;
   // copy full rom content
-  oc8_bin_file_init_rom(bf, rom_size);
+  err = err || oc8_bin_file_init_rom(bf, rom_size);
+  if (err) {
+    oc8_bin_file_free(bf);
+    return -1;
+  }
   memcpy(bf->rom, rom, rom_size);
+  return 0;
 }
 
 void oc8_bin_file_free(oc8_bin_file_t *bf) {
-  free(bf->syms_defs);
-  free(bf->syms_refs);
-  free(bf->rom);
+  oc8_arena_release(bf->arena, bf->syms_defs);
+  oc8_arena_release(bf->arena, bf->syms_refs);
+  oc8_arena_release(bf->arena, bf->rom);
   oc8_smap_free(&bf->globals);
 }
 
-void oc8_bin_file_check(oc8_bin_file_t *bf, int is_bin) {
+int oc8_bin_file_validate(const oc8_bin_file_t *bf, int is_bin) {
 
   uint16_t max_addr = bf->rom_size + OC8_ROM_START;
 
   for (size_t i = 0; i < bf->syms_defs_size; ++i) {
-    oc8_bin_sym_def_t *def = &bf->syms_defs[i];
+    const oc8_bin_sym_def_t *def = &bf->syms_defs[i];
     if (def->addr && (def->addr < OC8_ROM_START || def->addr >= max_addr)) {
       fprintf(stderr,
               "bin_file_check fail for symdef `%s': addr %u not in valid range "
               "[%u, %u[\n",
               def->name, (unsigned)def->addr, (unsigned)OC8_ROM_START,
               (unsigned)max_addr);
-      PANIC();
+      return -1;
+    }
+
+    if (def->size && (def->addr == 0 || def->addr + def->size > max_addr)) {
+      fprintf(stderr,
+              "bin_file_check fail for symdef `%s': range [%u, %u[ not in "
+              "ROM\n",
+              def->name, (unsigned)def->addr,
+              (unsigned)(def->addr + def->size));
+      return -1;
     }
 
     if (is_bin && def->addr == 0) {
       fprintf(stderr, "bin_file_check fail for symdef `%s': not defined\n",
               def->name);
-      PANIC();
+      return -1;
     }
   }
 
   for (size_t i = 0; i < bf->syms_refs_size; ++i) {
-    oc8_bin_sym_ref_t *ref = &bf->syms_refs[i];
+    const oc8_bin_sym_ref_t *ref = &bf->syms_refs[i];
     if (ref->ins_addr < OC8_ROM_START || ref->ins_addr >= max_addr) {
       fprintf(stderr,
               "bin_file_check fail for symref: addr %u not in valid range "
               "[%u, %u[\n",
               (unsigned)ref->ins_addr, (unsigned)OC8_ROM_START,
               (unsigned)max_addr);
-      PANIC();
+      return -1;
     }
 
     if (ref->sym_id >= bf->syms_defs_size) {
@@ -81,101 +101,118 @@ void oc8_bin_file_check(oc8_bin_file_t *bf, int is_bin) {
               "bin_file_check fail for symref: reference def id %u, but there "
               "are only %u defs\n",
               (unsigned)ref->sym_id, (unsigned)bf->syms_defs_size);
-      PANIC();
+      return -1;
     }
   }
 
   if (is_bin && bf->header.type == OC8_BIN_FILE_TYPE_OBJ) {
     fprintf(stderr,
             "bin_file_check fail: file type is object and not binary\n");
-    PANIC();
+    return -1;
   }
+
+  return 0;
 }
 
-void oc8_bin_file_set_version(oc8_bin_file_t *bf, uint16_t version) {
-  if (version != 10) {
+int oc8_bin_file_set_version(oc8_bin_file_t *bf, uint16_t version) {
+  if (version != OC8_BIN_VERSION_V10 && version != OC8_BIN_VERSION_V11) {
     fprintf(stderr,
-            "bin_file_check fail: invalid version %u, Only 10 is supported.\n",
+            "bin_file_check fail: invalid version %u, Only 10 and 11 are "
+            "supported.\n",
             (unsigned)version);
-    PANIC();
+    return -1;
   }
   bf->header.version = version;
+  return 0;
 }
 
-void oc8_bin_file_set_type(oc8_bin_file_t *bf, oc8_bin_file_type_t type) {
+int oc8_bin_file_set_type(oc8_bin_file_t *bf, oc8_bin_file_type_t type) {
   if (type != OC8_BIN_FILE_TYPE_OBJ && type != OC8_BIN_FILE_TYPE_BIN) {
     fprintf(stderr, "bin_file_check fail: invalid type %u.\n", (unsigned)type);
-    PANIC();
+    return -1;
   }
   bf->header.type = type;
+  return 0;
 }
 
-void oc8_bin_file_set_defs_count(oc8_bin_file_t *bf, size_t len) {
+int oc8_bin_file_set_defs_count(oc8_bin_file_t *bf, size_t len) {
   if (bf->syms_defs) {
     fprintf(stderr, "bin_file_check: set_defs_count already called\n");
-    PANIC();
+    return -1;
   }
 
-  bf->syms_defs = malloc(len * sizeof(oc8_bin_sym_def_t));
+  bf->syms_defs = oc8_arena_alloc(bf->arena, len * sizeof(oc8_bin_sym_def_t));
   bf->syms_defs_size = 0;
   bf->syms_defs_cap = len;
+  return 0;
 }
 
-uint16_t oc8_bin_file_add_def(oc8_bin_file_t *bf, const char *name,
-                              int is_global, oc8_bin_sym_type_t type,
-                              uint16_t addr) {
+int oc8_bin_file_add_def(oc8_bin_file_t *bf, const char *name, int is_global,
+                         oc8_bin_sym_type_t type, uint16_t addr) {
   if (!bf->syms_defs || bf->syms_defs_size == bf->syms_defs_cap) {
     fprintf(stderr,
             "bin_file_check: add_def: defs not setup, or reached max size\n");
-    PANIC();
+    return -1;
   }
 
-  uint16_t id = bf->syms_defs_size++;
-  oc8_bin_sym_def_t *def = &bf->syms_defs[id];
-
-  memset(&def->name[0], 0, sizeof(def->name));
   int i = 0;
   while (i < OC8_MAX_SYM_SIZE && name[i]) {
-    char c = name[i];
+    char c = name[i++];
     if (!isalnum(c) && c != '_') {
       fprintf(stderr, "bin_file_check: add_def: invalid symbol name\n");
-      PANIC();
+      return -1;
     }
-    def->name[i++] = c;
   }
   if (i >= OC8_MAX_SYM_SIZE) {
     fprintf(stderr, "bin_file_check: add_def: symbol name too long\n");
-    PANIC();
+    return -1;
   }
-  def->name[i] = '\0';
-  def->is_global = !!is_global;
 
   if (type < OC8_BIN_SYM_TYPE_FUN || type > OC8_BIN_SYM_TYPE_NO) {
     fprintf(stderr, "bin_file_check: add_def: invalid type: %u.\n",
             (unsigned)type);
-    PANIC();
+    return -1;
   }
-  def->type = type;
-
-  def->addr = addr;
 
+  // The def is only added once it's valid
+  uint16_t id = bf->syms_defs_size;
+  oc8_bin_sym_def_t *def = &bf->syms_defs[id];
+  def->name = oc8_strpool_intern(name);
   if (is_global && !oc8_smap_insert(&bf->globals, def->name, id)) {
     fprintf(stderr,
             "bin_file_check: add_ref: there is already a global symbol `%s'.\n",
             def->name);
-    PANIC();
+    return -1;
   }
 
+  def->is_global = !!is_global;
+  def->type = type;
+  def->addr = addr;
+  def->size = 0;
   def->id = id;
+  ++bf->syms_defs_size;
   return id;
 }
 
+int oc8_bin_file_set_def_size(oc8_bin_file_t *bf, uint16_t sym_id,
+                              uint16_t size) {
+  if (sym_id >= bf->syms_defs_size) {
+    fprintf(stderr, "bin_file_check: set_def_size: invalid symbol id %u\n",
+            (unsigned)sym_id);
+    return -1;
+  }
+  bf->syms_defs[sym_id].size = size;
+  return 0;
+}
+
 void oc8_bin_file_add_ref(oc8_bin_file_t *bf, uint16_t ins_addr,
                           uint16_t sym_id) {
   if (bf->syms_refs_size == bf->syms_refs_cap) {
+    size_t old_size = bf->syms_refs_cap * sizeof(oc8_bin_sym_ref_t);
     bf->syms_refs_cap *= 2;
     bf->syms_refs =
-        realloc(bf->syms_refs, bf->syms_refs_cap * sizeof(oc8_bin_sym_ref_t));
+        oc8_arena_realloc(bf->arena, bf->syms_refs, old_size,
+                          bf->syms_refs_cap * sizeof(oc8_bin_sym_ref_t));
   }
 
   oc8_bin_sym_ref_t *ref = &bf->syms_refs[bf->syms_refs_size++];
@@ -185,10 +222,10 @@ void oc8_bin_file_add_ref(oc8_bin_file_t *bf, uint16_t ins_addr,
 
 /// Allocate memory for the ROM, can only be called once,
 /// Cannot be resized later
-void oc8_bin_file_init_rom(oc8_bin_file_t *bf, size_t rom_size) {
+int oc8_bin_file_init_rom(oc8_bin_file_t *bf, size_t rom_size) {
   if (bf->rom) {
     fprintf(stderr, "bin_file_check: init_rom cannot be called twice.\n");
-    PANIC();
+    return -1;
   }
 
   size_t max_size = OC8_MEMORY_SIZE - OC8_ROM_START;
@@ -198,9 +235,10 @@ void oc8_bin_file_init_rom(oc8_bin_file_t *bf, size_t rom_size) {
         stderr,
         "bin_fil_check: init_rom: ROM too big, want %u, maximum size is %u.\n",
         (unsigned)rom_size, (unsigned)max_size);
-    PANIC();
+    return -1;
   }
 
-  bf->rom = malloc(rom_size);
+  bf->rom = oc8_arena_alloc(bf->arena, rom_size);
   bf->rom_size = rom_size;
+  return 0;
 }
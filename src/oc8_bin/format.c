@@ -1,4 +1,48 @@
+#include "oc8_bin/format.h"
+
 #include <stdint.h>
 
+#define FNV_OFFSET (0x811c9dc5U)
+#define FNV_PRIME (0x01000193U)
+
+// Max number of bytes of a 32-bit varint
+#define VARINT_MAX_SIZE (5)
+
 const uint8_t g_oc8_bin_raw_magic_value[8] = {0x14, 0x40, 0x4F, 0x43,
                                               0x38, 0x00, 0x00, 0x00};
+
+uint32_t oc8_bin_raw_hash_name(const char *name) {
+  uint32_t hash = FNV_OFFSET;
+  for (; *name; ++name) {
+    hash ^= (uint8_t)*name;
+    hash *= FNV_PRIME;
+  }
+  return hash;
+}
+
+size_t oc8_bin_raw_write_varint(uint32_t val, uint8_t *out_buf) {
+  size_t len = 0;
+  do {
+    uint8_t byte = val & 0x7F;
+    val >>= 7;
+    if (val)
+      byte |= 0x80;
+    if (out_buf)
+      out_buf[len] = byte;
+    ++len;
+  } while (val);
+  return len;
+}
+
+size_t oc8_bin_raw_read_varint(const uint8_t *in_buf, size_t buf_len,
+                               uint32_t *val) {
+  uint32_t res = 0;
+  for (size_t i = 0; i < buf_len && i < VARINT_MAX_SIZE; ++i) {
+    res |= (uint32_t)(in_buf[i] & 0x7F) << (7 * i);
+    if (!(in_buf[i] & 0x80)) {
+      *val = res;
+      return i + 1;
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,218 @@
+#include "oc8_bin/pack.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "oc8_bin/format.h"
+
+const uint8_t g_oc8_bin_pack_magic_value[8] = {0x14, 0x40, 0x4F, 0x43,
+                                               0x38, 0x50, 0x4B, 0x00};
+
+static size_t align_up(size_t val) {
+  return (val + OC8_BIN_PACK_ALIGN - 1) & ~(size_t)(OC8_BIN_PACK_ALIGN - 1);
+}
+
+int oc8_bin_pack_init(oc8_bin_pack_t *pack, const void *in_buf,
+                      size_t buf_len) {
+  const uint8_t *data = (const uint8_t *)in_buf;
+  memset(pack, 0, sizeof(oc8_bin_pack_t));
+  if (buf_len < sizeof(oc8_bin_raw_pack_header_t))
+    return -1;
+
+  const oc8_bin_raw_pack_header_t *header =
+      (const oc8_bin_raw_pack_header_t *)data;
+  if (memcmp(header->magic, g_oc8_bin_pack_magic_value,
+             sizeof(header->magic)) != 0 ||
+      header->version != OC8_BIN_PACK_VERSION)
+    return -1;
+
+  size_t nb_members = header->nb_members;
+  size_t names_size = header->names_size;
+  size_t index_end = sizeof(oc8_bin_raw_pack_header_t) +
+                     nb_members * sizeof(oc8_bin_raw_pack_entry_t);
+  if (nb_members > buf_len || index_end > buf_len ||
+      names_size > buf_len - index_end)
+    return -1;
+
+  const oc8_bin_raw_pack_entry_t *entries =
+      (const oc8_bin_raw_pack_entry_t *)(data +
+                                         sizeof(oc8_bin_raw_pack_header_t));
+  const char *names = (const char *)(data + index_end);
+  if (names_size && names[names_size - 1] != '\0')
+    return -1;
+
+  for (size_t i = 0; i < nb_members; ++i) {
+    const oc8_bin_raw_pack_entry_t *e = &entries[i];
+    if (e->name >= names_size || e->offset > buf_len ||
+        e->size > buf_len - e->offset)
+      return -1;
+    if (e->hash != oc8_bin_raw_hash_name(names + e->name))
+      return -1;
+  }
+
+  pack->data = data;
+  pack->size = buf_len;
+  pack->entries = entries;
+  pack->nb_members = nb_members;
+  pack->names = names;
+  pack->names_size = names_size;
+  return 0;
+}
+
+int oc8_bin_pack_open(oc8_bin_pack_t *pack, const char *path) {
+  oc8_bin_map_t map;
+  if (oc8_bin_map_open(&map, path) != 0) {
+    memset(pack, 0, sizeof(oc8_bin_pack_t));
+    return -1;
+  }
+
+  if (oc8_bin_pack_init(pack, map.data, map.size) != 0) {
+    oc8_bin_map_close(&map);
+    return -1;
+  }
+  pack->map = map;
+  return 0;
+}
+
+void oc8_bin_pack_close(oc8_bin_pack_t *pack) {
+  oc8_bin_map_close(&pack->map);
+  memset(pack, 0, sizeof(oc8_bin_pack_t));
+}
+
+static int cmp_entry(uint32_t hash, const char *name, uint32_t other_hash,
+                     const char *other_name) {
+  if (hash != other_hash)
+    return hash < other_hash ? -1 : 1;
+  return strcmp(name, other_name);
+}
+
+long oc8_bin_pack_find(const oc8_bin_pack_t *pack, const char *name) {
+  uint32_t hash = oc8_bin_raw_hash_name(name);
+  size_t lo = 0;
+  size_t hi = pack->nb_members;
+  while (lo < hi) {
+    size_t mid = lo + (hi - lo) / 2;
+    const oc8_bin_raw_pack_entry_t *e = &pack->entries[mid];
+    int cmp = cmp_entry(hash, name, e->hash, pack->names + e->name);
+    if (cmp == 0)
+      return (long)mid;
+    if (cmp < 0)
+      hi = mid;
+    else
+      lo = mid + 1;
+  }
+  return -1;
+}
+
+void oc8_bin_pack_get(const oc8_bin_pack_t *pack, size_t idx,
+                      oc8_bin_pack_member_t *member) {
+  const oc8_bin_raw_pack_entry_t *e = &pack->entries[idx];
+  member->name = pack->names + e->name;
+  member->data = pack->data + e->offset;
+  member->size = e->size;
+}
+
+typedef struct {
+  uint32_t hash;
+  const oc8_bin_pack_member_t *member;
+} sort_item_t;
+
+static int cmp_sort_items(const void *a, const void *b) {
+  const sort_item_t *x = (const sort_item_t *)a;
+  const sort_item_t *y = (const sort_item_t *)b;
+  return cmp_entry(x->hash, x->member->name, y->hash, y->member->name);
+}
+
+size_t oc8_bin_pack_write_raw(const oc8_bin_pack_member_t *members,
+                              size_t nb_members, uint8_t *out_buf) {
+  sort_item_t *items = malloc((nb_members ? nb_members : 1) *
+                              sizeof(sort_item_t));
+  size_t names_size = 0;
+  for (size_t i = 0; i < nb_members; ++i) {
+    items[i].hash = oc8_bin_raw_hash_name(members[i].name);
+    items[i].member = &members[i];
+    names_size += strlen(members[i].name) + 1;
+  }
+  qsort(items, nb_members, sizeof(sort_item_t), cmp_sort_items);
+  for (size_t i = 1; i < nb_members; ++i)
+    if (cmp_sort_items(&items[i - 1], &items[i]) == 0) {
+      fprintf(stderr, "oc8_bin_pack_write_raw: Duplicate member `%s'.\n",
+              items[i].member->name);
+      free(items);
+      return 0;
+    }
+
+  size_t index_end = sizeof(oc8_bin_raw_pack_header_t) +
+                     nb_members * sizeof(oc8_bin_raw_pack_entry_t);
+  size_t len = index_end + names_size;
+
+  oc8_bin_raw_pack_header_t header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, g_oc8_bin_pack_magic_value, sizeof(header.magic));
+  header.version = OC8_BIN_PACK_VERSION;
+  header.nb_members = (uint32_t)nb_members;
+  header.names_size = (uint32_t)names_size;
+  if (out_buf)
+    memcpy(out_buf, &header, sizeof(header));
+
+  size_t name_pos = 0;
+  for (size_t i = 0; i < nb_members; ++i) {
+    const oc8_bin_pack_member_t *m = items[i].member;
+    size_t name_len = strlen(m->name) + 1;
+    size_t start = align_up(len);
+    // Padding is zeroed, the output only depends on the members
+    if (out_buf)
+      memset(out_buf + len, 0, start - len);
+    len = start;
+
+    oc8_bin_raw_pack_entry_t entry;
+    entry.hash = items[i].hash;
+    entry.name = (uint32_t)name_pos;
+    entry.offset = (uint32_t)len;
+    entry.size = (uint32_t)m->size;
+    if (out_buf) {
+      memcpy(out_buf + sizeof(header) + i * sizeof(entry), &entry,
+             sizeof(entry));
+      memcpy(out_buf + index_end + name_pos, m->name, name_len);
+      memcpy(out_buf + len, m->data, m->size);
+    }
+
+    name_pos += name_len;
+    len += m->size;
+  }
+
+  free(items);
+  return len;
+}
+
+int oc8_bin_pack_write_to_file(const oc8_bin_pack_member_t *members,
+                               size_t nb_members, const char *path) {
+  size_t len = oc8_bin_pack_write_raw(members, nb_members, NULL);
+  if (len == 0)
+    return -1;
+
+  uint8_t *buf = malloc(len);
+  oc8_bin_pack_write_raw(members, nb_members, buf);
+
+  FILE *os = fopen(path, "wb");
+  int err = !os || fwrite(buf, 1, len, os) != len;
+  if (os && fclose(os) != 0)
+    err = 1;
+  free(buf);
+  if (err)
+    fprintf(stderr, "oc8_bin_pack_write_to_file: Failed to write file `%s'.\n",
+            path);
+  return err ? -1 : 0;
+}
+
+const char *oc8_bin_pack_split_path(const char *path) {
+  const char *ext = strstr(path, OC8_BIN_PACK_EXT);
+  while (ext) {
+    const char *sep = ext + strlen(OC8_BIN_PACK_EXT);
+    if (*sep == OC8_BIN_PACK_SEP && sep[1] != '\0')
+      return sep + 1;
+    ext = strstr(ext + 1, OC8_BIN_PACK_EXT);
+  }
+  return NULL;
+}
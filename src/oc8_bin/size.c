@@ -0,0 +1,34 @@
+#include "oc8_bin/size.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+static int cmp_sym_size(const void *a, const void *b) {
+  const oc8_bin_sym_def_t *x = ((const oc8_bin_sym_size_t *)a)->def;
+  const oc8_bin_sym_def_t *y = ((const oc8_bin_sym_size_t *)b)->def;
+  if (x->addr != y->addr)
+    return x->addr < y->addr ? -1 : 1;
+  return strcmp(x->name, y->name);
+}
+
+size_t oc8_bin_get_sym_sizes(const oc8_bin_file_t *bf,
+                             oc8_bin_sym_size_t *out) {
+  size_t nb_syms = 0;
+  for (size_t i = 0; i < bf->syms_defs_size; ++i)
+    if (bf->syms_defs[i].addr != 0)
+      out[nb_syms++].def = &bf->syms_defs[i];
+  qsort(out, nb_syms, sizeof(oc8_bin_sym_size_t), cmp_sym_size);
+
+  // Going backward, `next_addr` is the next higher address
+  size_t next_addr = OC8_ROM_START + bf->rom_size;
+  for (size_t i = nb_syms; i > 0; --i) {
+    oc8_bin_sym_size_t *sym = &out[i - 1];
+    if (i < nb_syms && out[i].def->addr > sym->def->addr)
+      next_addr = out[i].def->addr;
+    sym->is_estimated = sym->def->size == 0;
+    sym->size = sym->is_estimated && next_addr > sym->def->addr
+                    ? next_addr - sym->def->addr
+                    : sym->def->size;
+  }
+  return nb_syms;
+}
@@ -0,0 +1,109 @@
+#include <catch2/catch.hpp>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "oc8_as/as.h"
+#include "oc8_as/parser.h"
+#include "oc8_bin/archive.h"
+#include "oc8_bin/bin_writer.h"
+
+#include "../../tests/test_src.h"
+
+#define TMP_AR_FILE "/tmp/oc8_test_archive.c8a"
+
+namespace {
+
+std::vector<uint8_t> write_ar(const std::vector<oc8_bin_pack_member_t> &ms) {
+  size_t len = oc8_bin_archive_write_raw(&ms[0], ms.size(), nullptr);
+  REQUIRE(len > 0);
+  std::vector<uint8_t> res(len);
+  REQUIRE(oc8_bin_archive_write_raw(&ms[0], ms.size(), &res[0]) == len);
+  return res;
+}
+
+std::vector<uint8_t> compile(const std::string &code) {
+  oc8_as_sfile_t *sf = oc8_as_parse_raw(code.c_str(), code.size());
+  oc8_bin_file_t bf;
+  oc8_as_sfile_check(sf);
+  REQUIRE(oc8_as_compile_sfile(sf, &bf) == 0);
+  std::vector<uint8_t> res(oc8_bin_write_file_raw(&bf, nullptr));
+  oc8_bin_write_file_raw(&bf, &res[0]);
+  oc8_bin_file_free(&bf);
+  oc8_as_sfile_free(sf);
+  return res;
+}
+
+} // namespace
+
+TEST_CASE("archive symbol index", "") {
+  std::vector<std::string> names;
+  std::vector<std::vector<uint8_t>> objs;
+  for (int i = 0; i < 40; ++i) {
+    std::string fun = "fun_" + std::to_string(i);
+    names.push_back("m" + std::to_string(i) + ".c8o");
+    // Local symbols aren't indexed
+    objs.push_back(compile("  .globl " + fun + "\n" + fun + ":\n" +
+                           "Llocal:\n  jmp Llocal\nlocal_" + fun +
+                           ":\n  ret\n"));
+  }
+  names.push_back("fibo.c8o");
+  objs.push_back(compile(test_fibo_src));
+  // fibo is defined twice, the first member is indexed
+  names.push_back("fibo2.c8o");
+  objs.push_back(compile(test_fibo_src));
+  std::vector<oc8_bin_pack_member_t> ms;
+  for (size_t i = 0; i < names.size(); ++i)
+    ms.push_back({names[i].c_str(), &objs[i][0], objs[i].size()});
+
+  auto raw = write_ar(ms);
+  oc8_bin_archive_t ar;
+  REQUIRE(oc8_bin_archive_init(&ar, &raw[0], raw.size()) == 0);
+  REQUIRE(ar.nb_members == names.size());
+  REQUIRE(ar.nb_syms == 41);
+
+  for (size_t i = 0; i < ar.nb_members; ++i) {
+    oc8_bin_pack_member_t m;
+    oc8_bin_archive_get(&ar, i, &m);
+    REQUIRE(names[i] == m.name);
+    REQUIRE(m.size == objs[i].size());
+    REQUIRE(std::memcmp(m.data, &objs[i][0], m.size) == 0);
+  }
+  for (int i = 0; i < 40; ++i) {
+    std::string fun = "fun_" + std::to_string(i);
+    REQUIRE(oc8_bin_archive_find_sym(&ar, fun.c_str()) == i);
+    REQUIRE(oc8_bin_archive_find_sym(&ar, ("local_" + fun).c_str()) == -1);
+  }
+  REQUIRE(oc8_bin_archive_find_sym(&ar, "fibo") == 40);
+  REQUIRE(oc8_bin_archive_find_sym(&ar, "fun_40") == -1);
+  REQUIRE(oc8_bin_archive_find_sym(&ar, "") == -1);
+
+  REQUIRE(oc8_bin_archive_write_to_file(&ms[0], ms.size(), TMP_AR_FILE) ==
+          0);
+  oc8_bin_archive_t ar_file;
+  REQUIRE(oc8_bin_archive_open(&ar_file, TMP_AR_FILE) == 0);
+  REQUIRE(ar_file.size == raw.size());
+  REQUIRE(std::memcmp(ar_file.data, &raw[0], raw.size()) == 0);
+  oc8_bin_archive_close(&ar_file);
+  std::remove(TMP_AR_FILE);
+}
+
+TEST_CASE("archive invalid", "") {
+  auto fibo = compile(test_fibo_src);
+  uint8_t a = 1;
+  std::vector<oc8_bin_pack_member_t> ms = {{"fibo", &fibo[0], fibo.size()},
+                                           {"fibo", &fibo[0], fibo.size()}};
+  REQUIRE(oc8_bin_archive_write_raw(&ms[0], ms.size(), nullptr) == 0);
+  ms[1] = {"a", &a, 1};
+  REQUIRE(oc8_bin_archive_write_raw(&ms[0], ms.size(), nullptr) == 0);
+
+  ms.pop_back();
+  auto raw = write_ar(ms);
+  oc8_bin_archive_t ar;
+  REQUIRE(oc8_bin_archive_init(&ar, &raw[0], raw.size() - 1) != 0);
+  REQUIRE(oc8_bin_archive_init(&ar, &raw[0], 10) != 0);
+  raw[0] = 0;
+  REQUIRE(oc8_bin_archive_init(&ar, &raw[0], raw.size()) != 0);
+  REQUIRE(oc8_bin_archive_open(&ar, "/tmp/oc8_test_archive_none.c8a") != 0);
+}
@@ -0,0 +1,93 @@
+#include <catch2/catch.hpp>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+#include "oc8_bin/cache.h"
+
+#define TMP_CACHE_DIR "/tmp/oc8_test_cache"
+#define TMP_OUT_FILE "/tmp/oc8_test_cache_out.bin"
+
+namespace {
+
+void write_file(const char *path, const std::string &data) {
+  REQUIRE(oc8_bin_write_file_atomic(path, data.c_str(), data.size(), 0644) ==
+          0);
+}
+
+std::string read_file(const char *path) {
+  FILE *f = std::fopen(path, "rb");
+  REQUIRE(f != nullptr);
+  std::string res;
+  char buf[256];
+  size_t len;
+  while ((len = std::fread(buf, 1, sizeof(buf), f)) > 0)
+    res.append(buf, len);
+  std::fclose(f);
+  return res;
+}
+
+std::string entry_path(oc8_bin_cache_t *cache, uint64_t key, const char *ext) {
+  char *path = oc8_bin_cache_path(cache, key, ext);
+  std::string res = path;
+  std::free(path);
+  return res;
+}
+
+} // namespace
+
+TEST_CASE("hash chaining", "") {
+  const char *str = "hello world";
+  uint64_t h = oc8_bin_hash(str, std::strlen(str), OC8_BIN_HASH_INIT);
+  uint64_t h2 = oc8_bin_hash(str, 5, OC8_BIN_HASH_INIT);
+  h2 = oc8_bin_hash(str + 5, 6, h2);
+  REQUIRE(h == h2);
+  REQUIRE(h != oc8_bin_hash("hello worle", 11, OC8_BIN_HASH_INIT));
+  REQUIRE(oc8_bin_hash(nullptr, 0, OC8_BIN_HASH_INIT) == OC8_BIN_HASH_INIT);
+
+  // The terminator separates strings
+  uint64_t ab = oc8_bin_hash_str("b", oc8_bin_hash_str("a", OC8_BIN_HASH_INIT));
+  REQUIRE(ab != oc8_bin_hash_str("ab", OC8_BIN_HASH_INIT));
+}
+
+TEST_CASE("cache put and get", "") {
+  oc8_bin_cache_t cache;
+  REQUIRE(oc8_bin_cache_open(&cache, TMP_CACHE_DIR) == 0);
+  uint64_t key = oc8_bin_hash_str("cache put and get", OC8_BIN_HASH_INIT);
+  unlink(entry_path(&cache, key, "c8o").c_str());
+  REQUIRE(oc8_bin_cache_get(&cache, key, "c8o", TMP_OUT_FILE) != 0);
+
+  write_file(TMP_OUT_FILE, "some object");
+  REQUIRE(oc8_bin_cache_put(&cache, key, "c8o", TMP_OUT_FILE) == 0);
+  unlink(TMP_OUT_FILE);
+  REQUIRE(oc8_bin_cache_get(&cache, key, "c8o", TMP_OUT_FILE) == 0);
+  REQUIRE(read_file(TMP_OUT_FILE) == "some object");
+  REQUIRE(oc8_bin_cache_get(&cache, key, "c8bin", TMP_OUT_FILE) != 0);
+
+  // The output is a hard link to the read-only entry
+  struct stat st_out, st_entry;
+  REQUIRE(stat(TMP_OUT_FILE, &st_out) == 0);
+  REQUIRE(stat(entry_path(&cache, key, "c8o").c_str(), &st_entry) == 0);
+  REQUIRE(st_out.st_ino == st_entry.st_ino);
+  REQUIRE((st_entry.st_mode & 0777) == 0444);
+
+  // Writing the output again leaves the entry unchanged
+  write_file(TMP_OUT_FILE, "other object");
+  REQUIRE(read_file(TMP_OUT_FILE) == "other object");
+  REQUIRE(read_file(entry_path(&cache, key, "c8o").c_str()) == "some object");
+  REQUIRE(stat(TMP_OUT_FILE, &st_out) == 0);
+  REQUIRE((st_out.st_mode & 0777) == 0644);
+  oc8_bin_cache_close(&cache);
+}
+
+TEST_CASE("cache open errors", "") {
+  oc8_bin_cache_t cache;
+  write_file(TMP_OUT_FILE, "not a dir");
+  REQUIRE(oc8_bin_cache_open(&cache, TMP_OUT_FILE) != 0);
+  REQUIRE(oc8_bin_cache_open(&cache, "/tmp/no/such/dir") != 0);
+  REQUIRE(oc8_bin_write_file_atomic("/tmp/no/such/file", "a", 1, 0644) != 0);
+}
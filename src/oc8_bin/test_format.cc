@@ -1,4 +1,7 @@
+#include <algorithm>
 #include <catch2/catch.hpp>
+#include <cstdio>
+#include <cstring>
 #include <sstream>
 #include <string>
 #include <vector>
@@ -7,6 +10,7 @@
 #include "oc8_as/parser.h"
 #include "oc8_as/sfile.h"
 #include "oc8_bin/bin_reader.h"
+#include "oc8_bin/bin_view.h"
 #include "oc8_bin/bin_writer.h"
 #include "oc8_bin/file.h"
 
@@ -22,8 +26,8 @@ void test_read_write(const char *code) {
   oc8_as_sfile_t *sf = parse_str(code);
   oc8_bin_file_t bf;
   oc8_as_sfile_check(sf);
-  oc8_as_compile_sfile(sf, &bf);
-  oc8_bin_file_check(&bf, 0);
+  REQUIRE(oc8_as_compile_sfile(sf, &bf) == 0);
+  REQUIRE(oc8_bin_file_validate(&bf, 0) == 0);
 
   // Write 1
   size_t len1 = oc8_bin_write_file_raw(&bf, NULL);
@@ -33,7 +37,7 @@ void test_read_write(const char *code) {
   // Read 1
   oc8_bin_file_t bf2;
   oc8_bin_read_file_raw(&bf2, buff1, len1);
-  oc8_bin_file_check(&bf2, 0);
+  REQUIRE(oc8_bin_file_validate(&bf2, 0) == 0);
 
   // Write 2
   size_t len2 = oc8_bin_write_file_raw(&bf2, NULL);
@@ -51,6 +55,97 @@ void test_read_write(const char *code) {
   oc8_as_sfile_free(sf);
 }
 
+std::vector<char> write_raw(oc8_bin_file_t *bf, uint16_t version) {
+  oc8_bin_file_set_version(bf, version);
+  std::vector<char> buf(oc8_bin_write_file_raw(bf, NULL));
+  REQUIRE(oc8_bin_write_file_raw(bf, &buf[0]) == buf.size());
+  return buf;
+}
+
+void test_convert(const char *code) {
+  oc8_as_sfile_t *sf = parse_str(code);
+  oc8_bin_file_t bf;
+  oc8_as_sfile_check(sf);
+  REQUIRE(oc8_as_compile_sfile(sf, &bf) == 0);
+  REQUIRE(oc8_bin_file_validate(&bf, 0) == 0);
+  auto buf10 = write_raw(&bf, OC8_BIN_VERSION_V10);
+  auto buf11 = write_raw(&bf, OC8_BIN_VERSION_V11);
+  REQUIRE(buf11.size() < buf10.size());
+
+  // v10 => v11 => v10
+  oc8_bin_file_t bf11;
+  oc8_bin_read_file_raw(&bf11, &buf11[0], buf11.size());
+  REQUIRE(oc8_bin_file_validate(&bf11, 0) == 0);
+  REQUIRE(bf11.header.version == OC8_BIN_VERSION_V11);
+  REQUIRE(write_raw(&bf11, OC8_BIN_VERSION_V10) == buf10);
+  REQUIRE(write_raw(&bf11, OC8_BIN_VERSION_V11) == buf11);
+
+  oc8_bin_file_free(&bf);
+  oc8_bin_file_free(&bf11);
+  oc8_as_sfile_free(sf);
+}
+
+void test_view(const char *code, uint16_t version) {
+  oc8_as_sfile_t *sf = parse_str(code);
+  oc8_bin_file_t bf;
+  oc8_as_sfile_check(sf);
+  REQUIRE(oc8_as_compile_sfile(sf, &bf) == 0);
+  REQUIRE(oc8_bin_file_validate(&bf, 0) == 0);
+  auto buf = write_raw(&bf, version);
+
+  const char *path = "/tmp/oc8_test_format_view.c8o";
+  FILE *os = std::fopen(path, "wb");
+  REQUIRE(os);
+  REQUIRE(std::fwrite(&buf[0], 1, buf.size(), os) == buf.size());
+  std::fclose(os);
+
+  oc8_bin_file_view_t view;
+  REQUIRE(oc8_bin_file_view_open(&view, path) == 0);
+  REQUIRE(view.version == version);
+  REQUIRE(view.type == bf.header.type);
+  REQUIRE(view.syms_defs_size == bf.syms_defs_size);
+  REQUIRE(view.syms_refs_size == bf.syms_refs_size);
+  for (size_t i = 0; i < bf.syms_defs_size; ++i) {
+    const oc8_bin_sym_def_t &def = bf.syms_defs[i];
+    oc8_bin_view_sym_t sym;
+    REQUIRE(oc8_bin_file_view_get_sym(&view, i, &sym) == 0);
+    REQUIRE(std::strcmp(sym.name, def.name) == 0);
+    REQUIRE(sym.id == i);
+    REQUIRE(sym.addr == def.addr);
+    REQUIRE(sym.is_global == def.is_global);
+    REQUIRE(sym.type == def.type);
+    REQUIRE(sym.size == (version == OC8_BIN_VERSION_V11 ? def.size : 0));
+    if (def.is_global)
+      REQUIRE(oc8_bin_file_view_find_global(&view, def.name) == (long)i);
+
+    long at = oc8_bin_file_view_find_addr(&view, def.addr);
+    REQUIRE(at >= 0);
+    REQUIRE(at <= (long)i);
+    REQUIRE(bf.syms_defs[at].addr == def.addr);
+  }
+
+  std::vector<oc8_bin_sym_ref_t> refs(bf.syms_refs_size + 1);
+  REQUIRE(oc8_bin_file_view_get_refs(&view, &refs[0]) == 0);
+  for (size_t i = 0; i < bf.syms_refs_size; ++i) {
+    REQUIRE(refs[i].ins_addr == bf.syms_refs[i].ins_addr);
+    REQUIRE(refs[i].sym_id == bf.syms_refs[i].sym_id);
+  }
+  REQUIRE(view.rom_size == bf.rom_size);
+  REQUIRE(std::memcmp(view.rom, bf.rom, bf.rom_size) == 0);
+  REQUIRE(oc8_bin_file_view_find_global(&view, "_not_a_sym") == -1);
+  REQUIRE(oc8_bin_file_view_find_addr(&view, 0xFFF) == -1);
+  oc8_bin_file_view_close(&view);
+
+  // Truncated data
+  REQUIRE(oc8_bin_file_view_init(&view, &buf[0], buf.size() - 1) != 0);
+  REQUIRE(oc8_bin_file_view_init(&view, code, std::strlen(code)) != 0);
+  REQUIRE(oc8_bin_file_view_open(&view, "/tmp/oc8_not_a_file") != 0);
+
+  std::remove(path);
+  oc8_bin_file_free(&bf);
+  oc8_as_sfile_free(sf);
+}
+
 } // namespace
 
 TEST_CASE("format function fibo", "") { test_read_write(test_fibo_src); }
@@ -66,3 +161,108 @@ TEST_CASE("format call_add_mem", "") { test_read_write(test_call_add_mem_src); }
 TEST_CASE("format function fact_table", "") {
   test_read_write(test_fact_table_src);
 }
+
+TEST_CASE("format convert fibo", "") { test_convert(test_fibo_src); }
+
+TEST_CASE("format convert fact_table", "") {
+  test_convert(test_fact_table_src);
+}
+
+TEST_CASE("format view fibo", "") {
+  test_view(test_fibo_src, OC8_BIN_VERSION_V10);
+  test_view(test_fibo_src, OC8_BIN_VERSION_V11);
+}
+
+TEST_CASE("format view fact_table", "") {
+  test_view(test_fact_table_src, OC8_BIN_VERSION_V10);
+  test_view(test_fact_table_src, OC8_BIN_VERSION_V11);
+}
+
+TEST_CASE("format symbol sizes", "") {
+  const char *code = "  .globl foo\n"
+                     "  .type foo, @function\n"
+                     "foo:\n"
+                     "  ret\n"
+                     "  .size foo, 2\n"
+                     "  .type data, @object\n"
+                     "data:\n"
+                     "  .byte 1\n"
+                     "  .byte 2\n"
+                     "  .byte 3\n"
+                     "  .size data, 3\n";
+  test_read_write(code);
+  test_view(code, OC8_BIN_VERSION_V10);
+  test_view(code, OC8_BIN_VERSION_V11);
+
+  oc8_as_sfile_t *sf = parse_str(code);
+  oc8_bin_file_t bf;
+  oc8_as_sfile_check(sf);
+  REQUIRE(oc8_as_compile_sfile(sf, &bf) == 0);
+  std::vector<uint16_t> sizes;
+  for (size_t i = 0; i < bf.syms_defs_size; ++i)
+    sizes.push_back(bf.syms_defs[i].size);
+  std::sort(sizes.begin(), sizes.end());
+  REQUIRE(sizes == std::vector<uint16_t>{2, 3});
+
+  // Only version 11 keeps them
+  auto buf = write_raw(&bf, OC8_BIN_VERSION_V10);
+  oc8_bin_file_t bf10;
+  oc8_bin_read_file_raw(&bf10, &buf[0], buf.size());
+  for (size_t i = 0; i < bf10.syms_defs_size; ++i)
+    REQUIRE(bf10.syms_defs[i].size == 0);
+
+  oc8_bin_file_free(&bf);
+  oc8_bin_file_free(&bf10);
+  oc8_as_sfile_free(sf);
+}
+
+TEST_CASE("format interned names", "") {
+  oc8_as_sfile_t *sf = parse_str(test_fibo_src);
+  oc8_bin_file_t bf;
+  oc8_as_sfile_check(sf);
+  REQUIRE(oc8_as_compile_sfile(sf, &bf) == 0);
+  size_t len = oc8_bin_write_file_raw(&bf, NULL);
+  std::vector<char> buf(len);
+  oc8_bin_write_file_raw(&bf, &buf[0]);
+
+  // The same names in two files share the same storage
+  oc8_bin_file_t bf2;
+  oc8_bin_read_file_raw(&bf2, &buf[0], len);
+  REQUIRE(bf2.syms_defs_size == bf.syms_defs_size);
+  for (size_t i = 0; i < bf.syms_defs_size; ++i)
+    REQUIRE(bf.syms_defs[i].name == bf2.syms_defs[i].name);
+  REQUIRE(sizeof(oc8_bin_sym_def_t) <= 16);
+
+  oc8_bin_file_free(&bf);
+  oc8_bin_file_free(&bf2);
+  oc8_as_sfile_free(sf);
+}
+
+TEST_CASE("format read errors", "") {
+  oc8_as_sfile_t *sf = parse_str(test_fibo_src);
+  oc8_bin_file_t bf;
+  oc8_as_sfile_check(sf);
+  REQUIRE(oc8_as_compile_sfile(sf, &bf) == 0);
+
+  for (uint16_t version : {OC8_BIN_VERSION_V10, OC8_BIN_VERSION_V11}) {
+    auto buf = write_raw(&bf, version);
+    oc8_bin_file_t bf2;
+    // Truncated, and invalid magic number
+    REQUIRE(oc8_bin_read_file_raw(&bf2, &buf[0], 4) != 0);
+    REQUIRE(oc8_bin_read_file_raw(&bf2, &buf[0], buf.size() - 1) != 0);
+    buf[0] ^= 0xFF;
+    REQUIRE(oc8_bin_read_file_raw(&bf2, &buf[0], buf.size()) != 0);
+  }
+
+  // The file is unmapped on error
+  const char *path = "/tmp/ts_oc8_bin_read_err.c8o";
+  FILE *os = std::fopen(path, "wb");
+  std::fputs("not a bin file", os);
+  std::fclose(os);
+  oc8_bin_file_t bf2;
+  REQUIRE(oc8_bin_read_from_file(&bf2, path) != 0);
+  REQUIRE(oc8_bin_read_from_file(&bf2, "/tmp/no/such/file.c8o") != 0);
+
+  oc8_bin_file_free(&bf);
+  oc8_as_sfile_free(sf);
+}
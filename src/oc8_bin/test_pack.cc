@@ -0,0 +1,161 @@
+#include <catch2/catch.hpp>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "oc8_as/as.h"
+#include "oc8_as/parser.h"
+#include "oc8_bin/bin_reader.h"
+#include "oc8_bin/bin_view.h"
+#include "oc8_bin/bin_writer.h"
+#include "oc8_bin/pack.h"
+
+#include "../../tests/test_src.h"
+
+#define TMP_PACK_FILE "/tmp/oc8_test_pack.c8pk"
+
+namespace {
+
+std::vector<uint8_t> write_pack(const std::vector<oc8_bin_pack_member_t> &ms) {
+  size_t len = oc8_bin_pack_write_raw(&ms[0], ms.size(), nullptr);
+  REQUIRE(len > 0);
+  std::vector<uint8_t> res(len);
+  REQUIRE(oc8_bin_pack_write_raw(&ms[0], ms.size(), &res[0]) == len);
+  return res;
+}
+
+std::vector<uint8_t> compile(const char *code) {
+  oc8_as_sfile_t *sf = oc8_as_parse_raw(code, std::strlen(code));
+  oc8_bin_file_t bf;
+  oc8_as_sfile_check(sf);
+  REQUIRE(oc8_as_compile_sfile(sf, &bf) == 0);
+  std::vector<uint8_t> res(oc8_bin_write_file_raw(&bf, nullptr));
+  oc8_bin_write_file_raw(&bf, &res[0]);
+  oc8_bin_file_free(&bf);
+  oc8_as_sfile_free(sf);
+  return res;
+}
+
+} // namespace
+
+TEST_CASE("pack find members", "") {
+  std::vector<std::string> names;
+  std::vector<std::vector<uint8_t>> datas;
+  for (int i = 0; i < 50; ++i) {
+    names.push_back("game-" + std::to_string(i));
+    datas.push_back(std::vector<uint8_t>(i * 37 + 1, (uint8_t)i));
+  }
+  std::vector<oc8_bin_pack_member_t> ms;
+  for (size_t i = 0; i < names.size(); ++i)
+    ms.push_back({names[i].c_str(), &datas[i][0], datas[i].size()});
+
+  auto raw = write_pack(ms);
+  oc8_bin_pack_t pack;
+  REQUIRE(oc8_bin_pack_init(&pack, &raw[0], raw.size()) == 0);
+  REQUIRE(pack.nb_members == names.size());
+
+  for (size_t i = 0; i < names.size(); ++i) {
+    long idx = oc8_bin_pack_find(&pack, names[i].c_str());
+    REQUIRE(idx >= 0);
+    oc8_bin_pack_member_t m;
+    oc8_bin_pack_get(&pack, idx, &m);
+    REQUIRE(names[i] == m.name);
+    REQUIRE(m.size == datas[i].size());
+    REQUIRE(std::memcmp(m.data, &datas[i][0], m.size) == 0);
+    // Zero-copy, and page aligned
+    REQUIRE((const uint8_t *)m.data >= &raw[0]);
+    REQUIRE(((const uint8_t *)m.data - &raw[0]) % OC8_BIN_PACK_ALIGN == 0);
+  }
+  REQUIRE(oc8_bin_pack_find(&pack, "game-50") == -1);
+  REQUIRE(oc8_bin_pack_find(&pack, "") == -1);
+
+  // Same members in another order give the same pack
+  std::vector<oc8_bin_pack_member_t> rev(ms.rbegin(), ms.rend());
+  REQUIRE(write_pack(rev) == raw);
+}
+
+TEST_CASE("pack invalid", "") {
+  uint8_t a = 1;
+  std::vector<oc8_bin_pack_member_t> ms = {{"a", &a, 1}, {"a", &a, 1}};
+  REQUIRE(oc8_bin_pack_write_raw(&ms[0], ms.size(), nullptr) == 0);
+
+  ms.pop_back();
+  auto raw = write_pack(ms);
+  oc8_bin_pack_t pack;
+  REQUIRE(oc8_bin_pack_init(&pack, &raw[0], raw.size() - 1) != 0);
+  REQUIRE(oc8_bin_pack_init(&pack, &raw[0], 10) != 0);
+  raw[0] = 0;
+  REQUIRE(oc8_bin_pack_init(&pack, &raw[0], raw.size()) != 0);
+}
+
+TEST_CASE("pack member path", "") {
+  REQUIRE(oc8_bin_pack_split_path("rom.c8bin") == nullptr);
+  REQUIRE(oc8_bin_pack_split_path("a.c8pk") == nullptr);
+  REQUIRE(oc8_bin_pack_split_path("a.c8pk:") == nullptr);
+  REQUIRE(std::string(oc8_bin_pack_split_path("dir/a.c8pk:fibo")) == "fibo");
+
+  auto fibo = compile(test_fibo_src);
+  auto fact = compile(test_fact_table_src);
+  std::vector<oc8_bin_pack_member_t> ms = {
+      {"fibo", &fibo[0], fibo.size()},
+      {"fact", &fact[0], fact.size()},
+  };
+  REQUIRE(oc8_bin_pack_write_to_file(&ms[0], ms.size(), TMP_PACK_FILE) == 0);
+
+  oc8_bin_map_t map, map2;
+  REQUIRE(oc8_bin_map_open_member(&map, TMP_PACK_FILE ":fact") == 0);
+  REQUIRE(map.size == fact.size());
+  REQUIRE(std::memcmp(map.data, &fact[0], fact.size()) == 0);
+  REQUIRE(map.base_size > map.size);
+  REQUIRE(oc8_bin_map_open_member(&map2, TMP_PACK_FILE ":none") != 0);
+  // Only with the member syntax
+  REQUIRE(oc8_bin_map_open(&map2, TMP_PACK_FILE ":fibo") != 0);
+
+  // The pack is mapped once for all its members
+  REQUIRE(oc8_bin_map_open_member(&map2, TMP_PACK_FILE ":fibo") == 0);
+  REQUIRE(map2.base == map.base);
+  oc8_bin_map_close(&map2);
+  oc8_bin_map_close(&map);
+
+  // Members can be used like any other file
+  REQUIRE(oc8_bin_map_open_member(&map, TMP_PACK_FILE ":fibo") == 0);
+  oc8_bin_file_view_t view;
+  REQUIRE(oc8_bin_file_view_init(&view, map.data, map.size) == 0);
+  REQUIRE(oc8_bin_file_view_find_global(&view, "fibo") >= 0);
+  oc8_bin_map_close(&map);
+
+  REQUIRE(oc8_bin_map_open_member(&map, TMP_PACK_FILE ":fact") == 0);
+  oc8_bin_file_t bf;
+  REQUIRE(oc8_bin_read_file_raw(&bf, map.data, map.size) == 0);
+  oc8_bin_map_close(&map);
+  REQUIRE(oc8_bin_file_validate(&bf, 0) == 0);
+  std::vector<uint8_t> out(oc8_bin_write_file_raw(&bf, nullptr));
+  oc8_bin_write_file_raw(&bf, &out[0]);
+  REQUIRE(out == fact);
+  oc8_bin_file_free(&bf);
+
+  // A real file is never read as a member
+  const char *real_path = TMP_PACK_FILE ":fibo";
+  FILE *os = std::fopen(real_path, "wb");
+  std::fwrite(&fact[0], 1, fact.size(), os);
+  std::fclose(os);
+  REQUIRE(oc8_bin_map_open(&map, real_path) == 0);
+  REQUIRE(map.size == fact.size());
+  oc8_bin_map_close(&map);
+  REQUIRE(oc8_bin_map_open_member(&map, real_path) == 0);
+  REQUIRE(map.size == fact.size());
+  oc8_bin_map_close(&map);
+  std::remove(real_path);
+
+  // A pack written again is mapped again
+  std::remove(TMP_PACK_FILE);
+  ms.pop_back();
+  ms[0].name = "fact";
+  REQUIRE(oc8_bin_pack_write_to_file(&ms[0], ms.size(), TMP_PACK_FILE) == 0);
+  REQUIRE(oc8_bin_map_open_member(&map, TMP_PACK_FILE ":fact") == 0);
+  REQUIRE(map.size == fibo.size());
+  REQUIRE(std::memcmp(map.data, &fibo[0], fibo.size()) == 0);
+  oc8_bin_map_close(&map);
+  std::remove(TMP_PACK_FILE);
+}
@@ -0,0 +1,51 @@
+#include <catch2/catch.hpp>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "oc8_as/as.h"
+#include "oc8_as/parser.h"
+#include "oc8_bin/size.h"
+
+TEST_CASE("symbol sizes", "") {
+  const char *code = "  .globl f\n"
+                     "  .type f, @function\n"
+                     "f:\n"
+                     "  add %v1, %v0\n"
+                     "Lin:\n"
+                     "  ret\n"
+                     "  .size f, 4\n"
+                     "g:\n"
+                     "  call ext\n"
+                     "g_alias:\n"
+                     "data:\n"
+                     "  .byte 1\n"
+                     "  .byte 2\n"
+                     "  .byte 3\n";
+  oc8_as_sfile_t *sf = oc8_as_parse_raw(code, std::strlen(code));
+  oc8_bin_file_t bf;
+  oc8_as_sfile_check(sf);
+  REQUIRE(oc8_as_compile_sfile(sf, &bf) == 0);
+
+  std::vector<oc8_bin_sym_size_t> syms(bf.syms_defs_size);
+  // The extern symbol has no size
+  REQUIRE(oc8_bin_get_sym_sizes(&bf, &syms[0]) == 5);
+  struct {
+    const char *name;
+    uint16_t addr;
+    uint16_t size;
+    int is_estimated;
+  } expected[] = {
+      {"f", 0x200, 4, 0},    {"Lin", 0x202, 2, 1},     {"g", 0x204, 2, 1},
+      {"data", 0x206, 3, 1}, {"g_alias", 0x206, 3, 1},
+  };
+  for (size_t i = 0; i < 5; ++i) {
+    REQUIRE(std::string(syms[i].def->name) == expected[i].name);
+    REQUIRE(syms[i].def->addr == expected[i].addr);
+    REQUIRE(syms[i].size == expected[i].size);
+    REQUIRE(syms[i].is_estimated == expected[i].is_estimated);
+  }
+
+  oc8_bin_file_free(&bf);
+  oc8_as_sfile_free(sf);
+}
@@ -0,0 +1,171 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "oc8_build/client.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+char *oc8_build_socket_path(void) {
+  const char *env = getenv("OC8_BUILDD_SOCKET");
+  if (env)
+    return env[0] ? strdup(env) : NULL;
+
+  char buf[64];
+  snprintf(buf, sizeof(buf), "/tmp/oc8-buildd-%u.sock", (unsigned)getuid());
+  return strdup(buf);
+}
+
+char *oc8_build_abs_path(const char *path) {
+  if (path[0] == '/')
+    return strdup(path);
+
+  size_t cap = 256;
+  char *res = malloc(cap);
+  while (getcwd(res, cap) == NULL) {
+    if (errno != ERANGE) {
+      free(res);
+      return strdup(path);
+    }
+    cap *= 2;
+    res = realloc(res, cap);
+  }
+  size_t dir_len = strlen(res);
+  res = realloc(res, dir_len + strlen(path) + 2);
+  res[dir_len] = '/';
+  strcpy(res + dir_len + 1, path);
+  return res;
+}
+
+// The client must not be killed by SIGPIPE if the server stops
+static int send_all(int fd, const void *buf, size_t len) {
+  const char *ptr = (const char *)buf;
+  while (len) {
+    ssize_t n = send(fd, ptr, len, MSG_NOSIGNAL);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      return -1;
+    ptr += n;
+    len -= (size_t)n;
+  }
+  return 0;
+}
+
+static int read_all(int fd, void *buf, size_t len) {
+  char *ptr = (char *)buf;
+  while (len) {
+    ssize_t n = read(fd, ptr, len);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      return -1;
+    ptr += n;
+    len -= (size_t)n;
+  }
+  return 0;
+}
+
+// Send the header, with our stderr
+static int send_header(int fd, const oc8_build_req_header_t *header) {
+  struct iovec iov;
+  iov.iov_base = (void *)header;
+  iov.iov_len = sizeof(*header);
+
+  union {
+    char buf[CMSG_SPACE(sizeof(int))];
+    struct cmsghdr align;
+  } ctrl;
+  memset(&ctrl, 0, sizeof(ctrl));
+  struct msghdr msg;
+  memset(&msg, 0, sizeof(msg));
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = ctrl.buf;
+  msg.msg_controllen = sizeof(ctrl.buf);
+
+  struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+  cmsg->cmsg_level = SOL_SOCKET;
+  cmsg->cmsg_type = SCM_RIGHTS;
+  cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+  int err_fd = STDERR_FILENO;
+  memcpy(CMSG_DATA(cmsg), &err_fd, sizeof(int));
+
+  ssize_t n;
+  do
+    n = sendmsg(fd, &msg, MSG_NOSIGNAL);
+  while (n < 0 && errno == EINTR);
+  if (n < 0)
+    return -1;
+  return send_all(fd, (const char *)header + n, sizeof(*header) - n);
+}
+
+int oc8_build_client_send(const char *socket_path, oc8_build_req_kind_t kind,
+                          const char *const *strs, size_t nb_strs,
+                          int *status) {
+  struct sockaddr_un addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  if (strlen(socket_path) >= sizeof(addr.sun_path))
+    return -1;
+  strcpy(addr.sun_path, socket_path);
+
+  oc8_build_req_header_t header;
+  header.magic = OC8_BUILD_MAGIC;
+  header.kind = kind;
+  header.nb_strs = nb_strs;
+  size_t strs_len = 0;
+  for (size_t i = 0; i < nb_strs; ++i)
+    strs_len += strlen(strs[i]) + 1;
+  if (strs_len > OC8_BUILD_MAX_STRS_LEN)
+    return -1;
+  header.strs_len = strs_len;
+
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd < 0)
+    return -1;
+  if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+    close(fd);
+    return -1;
+  }
+
+  // Our output must be written before the one of the server
+  fflush(stderr);
+  int err = send_header(fd, &header);
+  for (size_t i = 0; i < nb_strs && !err; ++i)
+    err = send_all(fd, strs[i], strlen(strs[i]) + 1);
+
+  int32_t res;
+  if (!err)
+    err = read_all(fd, &res, sizeof(res));
+  close(fd);
+  if (err)
+    return -1;
+  *status = res;
+  return 0;
+}
+
+int oc8_build_client_forward(oc8_build_req_kind_t kind,
+                             const char *const *strs, size_t nb_strs,
+                             int *status) {
+  char *socket_path = oc8_build_socket_path();
+  if (!socket_path)
+    return -1;
+
+  char **abs_strs = malloc((nb_strs + 1) * sizeof(char *));
+  for (size_t i = 0; i < nb_strs; ++i)
+    abs_strs[i] = strs[i][0] ? oc8_build_abs_path(strs[i]) : strdup("");
+  int err = oc8_build_client_send(socket_path, kind,
+                                  (const char *const *)abs_strs, nb_strs,
+                                  status);
+
+  for (size_t i = 0; i < nb_strs; ++i)
+    free(abs_strs[i]);
+  free(abs_strs);
+  free(socket_path);
+  return err;
+}
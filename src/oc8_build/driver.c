@@ -0,0 +1,62 @@
+#include "oc8_build/driver.h"
+#include "oc8_as/as.h"
+#include "oc8_as/parser.h"
+#include "oc8_as/stream.h"
+#include "oc8_emu/mem.h"
+#include "oc8_ld/linker.h"
+
+#include <stdio.h>
+
+int oc8_build_link_sources(const oc8_build_src_t *srcs, size_t nb_srcs,
+                           oc8_bin_file_t *out_bf, oc8_arena_t *arena) {
+  oc8_ld_linker_t ld;
+  oc8_ld_linker_init_arena(&ld, 1, arena);
+  oc8_bin_file_t *objs = oc8_arena_alloc(arena, nb_srcs * sizeof(*objs));
+  int err = 0;
+  for (size_t i = 0; i < nb_srcs && !err; ++i) {
+    // A raw stream owns nothing, no need to free it
+    oc8_as_stream_t is;
+    oc8_as_stream_init_from_raw(&is, srcs[i].data, srcs[i].len);
+    oc8_as_sfile_t *sf = oc8_as_run_parser_arena(&is, srcs[i].name, arena);
+    err = !sf || oc8_as_sfile_check(sf) != 0 ||
+          oc8_as_compile_sfile(sf, &objs[i]) != 0 ||
+          oc8_bin_file_validate(&objs[i], /*is_bin=*/0) != 0;
+    if (!err)
+      oc8_ld_linker_add(&ld, &objs[i]);
+  }
+
+  // All memory is in the arena
+  if (!err)
+    err = oc8_ld_linker_link(&ld, out_bf) != 0 ||
+          oc8_bin_file_validate(out_bf, /*is_bin=*/1) != 0;
+  oc8_ld_linker_free(&ld);
+  if (err) {
+    // The message was already printed
+    fprintf(stderr, "oc8-build: Failed to build.\n");
+    return -1;
+  }
+  return 0;
+}
+
+int oc8_build_load_emu(const oc8_build_src_t *srcs, size_t nb_srcs) {
+  oc8_arena_t arena;
+  oc8_arena_init(&arena, 0);
+  oc8_bin_file_t bf;
+  int err = oc8_build_link_sources(srcs, nb_srcs, &bf, &arena);
+  if (!err)
+    oc8_emu_load_rom(bf.rom, bf.rom_size);
+  oc8_arena_free(&arena);
+  return err;
+}
+
+int oc8_build_load_batch(const oc8_build_src_t *srcs, size_t nb_srcs,
+                         oc8_emu_batch_t *b, size_t idx) {
+  oc8_arena_t arena;
+  oc8_arena_init(&arena, 0);
+  oc8_bin_file_t bf;
+  int err = oc8_build_link_sources(srcs, nb_srcs, &bf, &arena);
+  if (!err)
+    err = oc8_emu_batch_load_rom(b, idx, bf.rom, bf.rom_size);
+  oc8_arena_free(&arena);
+  return err;
+}
@@ -0,0 +1,469 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "oc8_build/server.h"
+#include "oc8_as/as.h"
+#include "oc8_bin/archive.h"
+#include "oc8_bin/bin_reader.h"
+#include "oc8_bin/bin_writer.h"
+#include "oc8_bin/cache.h"
+#include "oc8_build/client.h"
+#include "oc8_ld/incremental.h"
+#include "oc8_ld/linker.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#define LISTEN_BACKLOG (16)
+
+static int get_file_id(const char *path, oc8_build_file_id_t *id) {
+  struct stat st;
+  if (stat(path, &st) != 0)
+    return -1;
+  id->mtime_sec = st.st_mtim.tv_sec;
+  id->mtime_nsec = st.st_mtim.tv_nsec;
+  id->size = st.st_size;
+  id->ino = st.st_ino;
+  id->dev = st.st_dev;
+  return 0;
+}
+
+static int same_file_id(const oc8_build_file_id_t *a,
+                        const oc8_build_file_id_t *b) {
+  return a->mtime_sec == b->mtime_sec && a->mtime_nsec == b->mtime_nsec &&
+         a->size == b->size && a->ino == b->ino && a->dev == b->dev;
+}
+
+static void obj_release(oc8_build_obj_t *obj) {
+  if (--obj->refs == 0) {
+    oc8_arena_free(&obj->arena);
+    free(obj);
+  }
+}
+
+// @returns the object of the entry of `path`, or NULL if none or the file
+// changed
+static oc8_build_obj_t *find_obj(oc8_smap_t *entries, const char *path,
+                                 const oc8_build_file_id_t *id) {
+  oc8_smap_node_t *node = oc8_smap_find(entries, path);
+  if (!node)
+    return NULL;
+  oc8_build_entry_t *entry = (oc8_build_entry_t *)node->val;
+  return same_file_id(&entry->id, id) ? entry->obj : NULL;
+}
+
+static void set_entry(oc8_smap_t *entries, const char *path,
+                      const oc8_build_file_id_t *id, oc8_build_obj_t *obj) {
+  ++obj->refs;
+  oc8_build_entry_t *entry;
+  oc8_smap_node_t *node = oc8_smap_find(entries, path);
+  if (node) {
+    entry = (oc8_build_entry_t *)node->val;
+    obj_release(entry->obj);
+  } else {
+    entry = malloc(sizeof(oc8_build_entry_t));
+    oc8_smap_insert(entries, path, (size_t)entry);
+  }
+  entry->id = *id;
+  entry->obj = obj;
+}
+
+// @returns the object file at `path`, or NULL on error (printed)
+static oc8_build_obj_t *read_obj(const char *path) {
+  oc8_build_obj_t *obj = malloc(sizeof(oc8_build_obj_t));
+  oc8_arena_init(&obj->arena, 0);
+  obj->refs = 0;
+  if (oc8_bin_read_from_file_arena(&obj->bf, path, &obj->arena) != 0) {
+    oc8_arena_free(&obj->arena);
+    free(obj);
+    return NULL;
+  }
+
+  int err = oc8_bin_file_validate(&obj->bf, /*is_bin=*/0);
+  if (!err && obj->bf.header.type != OC8_BIN_FILE_TYPE_OBJ) {
+    fprintf(stderr, "oc8-ld: Input file `%s' must be of type object.\n",
+            path);
+    err = -1;
+  }
+  if (err) {
+    oc8_arena_free(&obj->arena);
+    free(obj);
+    return NULL;
+  }
+  return obj;
+}
+
+static int open_cache(oc8_bin_cache_t *cache, const char *dir,
+                      const char *tool) {
+  if (oc8_bin_cache_open(cache, dir) != 0) {
+    fprintf(stderr, "%s: Cannot use cache directory `%s'.\n", tool, dir);
+    return -1;
+  }
+  return 0;
+}
+
+typedef struct {
+  const char *in_path;
+  const char *out_path;
+  oc8_build_file_id_t in_id;
+  oc8_build_obj_t *obj; // from memory, or NULL if it must be assembled
+  const oc8_bin_cache_t *cache;
+  int err;
+} as_job_t;
+
+static void run_as_job(void *arg, size_t idx) {
+  as_job_t *job = ((as_job_t **)arg)[idx];
+  job->err = oc8_as_assemble_file(job->in_path, job->out_path, NULL,
+                                  job->cache);
+}
+
+static int run_as(oc8_build_server_t *s, const char *const *strs,
+                  size_t nb_strs) {
+  oc8_bin_cache_t cache;
+  if (strs[0][0] && open_cache(&cache, strs[0], "oc8-as") != 0)
+    return 1;
+
+  size_t nb_jobs = (nb_strs - 1) / 2;
+  as_job_t *jobs = calloc(nb_jobs, sizeof(as_job_t));
+  as_job_t **misses = malloc(nb_jobs * sizeof(as_job_t *));
+  size_t nb_misses = 0;
+  for (size_t i = 0; i < nb_jobs; ++i) {
+    as_job_t *job = &jobs[i];
+    job->in_path = strs[1 + 2 * i];
+    job->out_path = strs[2 + 2 * i];
+    job->cache = strs[0][0] ? &cache : NULL;
+    if (get_file_id(job->in_path, &job->in_id) == 0)
+      job->obj = find_obj(&s->sources, job->in_path, &job->in_id);
+    if (!job->obj)
+      misses[nb_misses++] = job;
+  }
+
+  // Same as oc8-as: a single file is parsed in chunks
+  if (nb_misses == 1)
+    misses[0]->err = oc8_as_assemble_file(
+        misses[0]->in_path, misses[0]->out_path,
+        s->nb_threads > 1 ? &s->pool : NULL, misses[0]->cache);
+  else if (nb_misses > 1)
+    oc8_pool_run(&s->pool, run_as_job, misses, nb_misses);
+
+  size_t nb_failed = 0;
+  for (size_t i = 0; i < nb_jobs; ++i) {
+    as_job_t *job = &jobs[i];
+    oc8_build_file_id_t out_id;
+    if (job->obj) {
+      ++s->nb_reused;
+      if (get_file_id(job->out_path, &out_id) != 0 ||
+          find_obj(&s->objects, job->out_path, &out_id) != job->obj)
+        job->err = oc8_bin_write_to_file(&job->obj->bf, job->out_path);
+    } else if (!job->err) {
+      job->obj = read_obj(job->out_path);
+      if (job->obj)
+        set_entry(&s->sources, job->in_path, &job->in_id, job->obj);
+    }
+
+    if (!job->err && job->obj && get_file_id(job->out_path, &out_id) == 0)
+      set_entry(&s->objects, job->out_path, &out_id, job->obj);
+    nb_failed += job->err != 0;
+  }
+  if (nb_failed && nb_jobs > 1)
+    fprintf(stderr, "oc8-as: %zu of %zu files failed.\n", nb_failed, nb_jobs);
+
+  free(misses);
+  free(jobs);
+  if (strs[0][0])
+    oc8_bin_cache_close(&cache);
+  return nb_failed != 0;
+}
+
+// @returns 0 if success, != 0 on error (printed)
+static int link_objs(oc8_build_obj_t **objs, size_t nb_objs,
+                     const char *out_path, oc8_pool_t *pool) {
+  oc8_arena_t arena;
+  oc8_arena_init(&arena, 0);
+  oc8_ld_linker_t ld;
+  oc8_ld_linker_init_arena(&ld, 1, &arena);
+  oc8_ld_linker_set_pool(&ld, pool);
+  for (size_t i = 0; i < nb_objs; ++i)
+    oc8_ld_linker_add(&ld, &objs[i]->bf);
+
+  // `out_bf` is in the arena, freed with it even on error
+  oc8_bin_file_t out_bf;
+  int err = oc8_ld_linker_link(&ld, &out_bf);
+  if (!err)
+    err = oc8_bin_file_validate(&out_bf, /*is_bin=*/1) != 0 ||
+          oc8_bin_write_to_file(&out_bf, out_path) != 0;
+  oc8_ld_linker_free(&ld);
+  oc8_arena_free(&arena);
+  return err ? -1 : 0;
+}
+
+static int is_archive(const char *path) {
+  size_t len = strlen(path);
+  size_t ext_len = strlen(OC8_BIN_AR_EXT);
+  return len > ext_len && strcmp(path + len - ext_len, OC8_BIN_AR_EXT) == 0;
+}
+
+static int run_ld(oc8_build_server_t *s, const char *const *strs,
+                  size_t nb_strs) {
+  const char *out_path = strs[1];
+  const char *const *in_paths = strs + 2;
+  size_t nb_ins = nb_strs - 2;
+
+  // The cache of oc8-ld already reuses its previous output, and archives
+  // aren't kept in memory: the linker only reads the members it needs
+  int has_archives = 0;
+  for (size_t i = 0; i < nb_ins; ++i)
+    has_archives |= is_archive(in_paths[i]);
+  if (strs[0][0] || has_archives) {
+    oc8_bin_cache_t cache;
+    if (strs[0][0] && open_cache(&cache, strs[0], "oc8-ld") != 0)
+      return 1;
+    oc8_ld_link_opts_t opts = {.pool = &s->pool,
+                               .cache = strs[0][0] ? &cache : NULL};
+    int err = oc8_ld_link_files(in_paths, nb_ins, out_path, &opts, NULL);
+    if (strs[0][0])
+      oc8_bin_cache_close(&cache);
+    return err != 0;
+  }
+
+  oc8_build_obj_t **objs = malloc(nb_ins * sizeof(oc8_build_obj_t *));
+  int err = 0;
+  for (size_t i = 0; i < nb_ins && !err; ++i) {
+    oc8_build_file_id_t id;
+    if (get_file_id(in_paths[i], &id) != 0) {
+      fprintf(stderr, "oc8-ld: Failed to read file `%s'.\n", in_paths[i]);
+      err = 1;
+      break;
+    }
+
+    objs[i] = find_obj(&s->objects, in_paths[i], &id);
+    if (objs[i]) {
+      ++s->nb_reused;
+      continue;
+    }
+    objs[i] = read_obj(in_paths[i]);
+    if (objs[i])
+      set_entry(&s->objects, in_paths[i], &id, objs[i]);
+    else
+      err = 1;
+  }
+
+  if (!err)
+    err = link_objs(objs, nb_ins, out_path, &s->pool) != 0;
+  if (err)
+    fprintf(stderr, "oc8-ld: Failed to link `%s'.\n", out_path);
+  free(objs);
+  return err;
+}
+
+static int recv_all(int fd, void *buf, size_t len) {
+  char *ptr = (char *)buf;
+  while (len) {
+    ssize_t n = recv(fd, ptr, len, 0);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      return -1;
+    ptr += n;
+    len -= (size_t)n;
+  }
+  return 0;
+}
+
+// Receive the header, and the stderr of the client
+static int recv_header(int fd, oc8_build_req_header_t *header, int *err_fd) {
+  struct iovec iov;
+  iov.iov_base = header;
+  iov.iov_len = sizeof(*header);
+
+  union {
+    char buf[CMSG_SPACE(sizeof(int))];
+    struct cmsghdr align;
+  } ctrl;
+  struct msghdr msg;
+  memset(&msg, 0, sizeof(msg));
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = ctrl.buf;
+  msg.msg_controllen = sizeof(ctrl.buf);
+
+  ssize_t n;
+  do
+    n = recvmsg(fd, &msg, 0);
+  while (n < 0 && errno == EINTR);
+  if (n <= 0)
+    return -1;
+
+  struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+  if (cmsg && cmsg->cmsg_level == SOL_SOCKET &&
+      cmsg->cmsg_type == SCM_RIGHTS &&
+      cmsg->cmsg_len == CMSG_LEN(sizeof(int)))
+    memcpy(err_fd, CMSG_DATA(cmsg), sizeof(int));
+  return recv_all(fd, (char *)header + n, sizeof(*header) - n);
+}
+
+static int valid_nb_strs(const oc8_build_req_header_t *header) {
+  switch (header->kind) {
+  case OC8_BUILD_REQ_AS:
+    return header->nb_strs % 2 == 1;
+  case OC8_BUILD_REQ_LD:
+    return header->nb_strs >= 3;
+  case OC8_BUILD_REQ_STOP:
+    return header->nb_strs == 0;
+  default:
+    return 0;
+  }
+}
+
+// Read the strings of the request
+// @returns an array of `nb_strs` pointers in `buf`, or NULL if invalid
+static const char **recv_strs(int fd, const oc8_build_req_header_t *header,
+                              char **buf) {
+  size_t len = header->strs_len;
+  if (len > OC8_BUILD_MAX_STRS_LEN || !valid_nb_strs(header))
+    return NULL;
+  *buf = malloc(len + 1);
+  if (recv_all(fd, *buf, len) != 0 || (len && (*buf)[len - 1] != 0))
+    return NULL;
+
+  const char **strs = malloc((header->nb_strs + 1) * sizeof(const char *));
+  size_t nb_strs = 0;
+  for (size_t i = 0; i < len; i += strlen(*buf + i) + 1) {
+    if (nb_strs == header->nb_strs) {
+      free(strs);
+      return NULL;
+    }
+    strs[nb_strs++] = *buf + i;
+  }
+  if (nb_strs != header->nb_strs) {
+    free(strs);
+    return NULL;
+  }
+  return strs;
+}
+
+// @returns 1 if the server must stop
+static int serve_client(oc8_build_server_t *s, int fd) {
+  oc8_build_req_header_t header;
+  int err_fd = -1;
+  char *buf = NULL;
+  const char **strs = NULL;
+  if (recv_header(fd, &header, &err_fd) == 0 &&
+      header.magic == OC8_BUILD_MAGIC)
+    strs = recv_strs(fd, &header, &buf);
+
+  int stop = 0;
+  if (strs) {
+    int32_t status = 0;
+    stop = header.kind == OC8_BUILD_REQ_STOP;
+    if (!stop) {
+      // Everything printed during the request goes to the client
+      fflush(stderr);
+      int saved_fd = err_fd >= 0 ? dup(STDERR_FILENO) : -1;
+      if (saved_fd >= 0)
+        dup2(err_fd, STDERR_FILENO);
+      if (header.kind == OC8_BUILD_REQ_AS)
+        status = run_as(s, strs, header.nb_strs);
+      else
+        status = run_ld(s, strs, header.nb_strs);
+      fflush(stderr);
+      if (saved_fd >= 0) {
+        dup2(saved_fd, STDERR_FILENO);
+        close(saved_fd);
+      }
+    }
+    send(fd, &status, sizeof(status), MSG_NOSIGNAL);
+  }
+
+  if (err_fd >= 0)
+    close(err_fd);
+  free(strs);
+  free(buf);
+  return stop;
+}
+
+int oc8_build_server_init(oc8_build_server_t *s, const char *socket_path,
+                          size_t nb_threads) {
+  struct sockaddr_un addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  if (strlen(socket_path) >= sizeof(addr.sun_path)) {
+    fprintf(stderr, "oc8-buildd: Socket path `%s' is too long.\n",
+            socket_path);
+    return -1;
+  }
+  strcpy(addr.sun_path, socket_path);
+
+  // The socket of a server that stopped without cleanup is removed
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd >= 0 && connect(fd, (struct sockaddr *)&addr, sizeof(addr)) == 0) {
+    close(fd);
+    fprintf(stderr, "oc8-buildd: A server is already running on `%s'.\n",
+            socket_path);
+    return -1;
+  }
+  if (fd >= 0)
+    close(fd);
+  unlink(socket_path);
+
+  fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd < 0 || bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+      chmod(socket_path, 0600) != 0 || listen(fd, LISTEN_BACKLOG) != 0) {
+    fprintf(stderr, "oc8-buildd: Cannot listen on `%s'.\n", socket_path);
+    if (fd >= 0)
+      close(fd);
+    return -1;
+  }
+
+  s->socket_path = strdup(socket_path);
+  s->fd = fd;
+  s->nb_threads = nb_threads ? nb_threads : oc8_pool_nb_cpus();
+  oc8_pool_init(&s->pool, s->nb_threads - 1);
+  oc8_smap_init(&s->sources);
+  oc8_smap_init(&s->objects);
+  s->nb_reused = 0;
+  return 0;
+}
+
+void oc8_build_server_run(oc8_build_server_t *s) {
+  for (;;) {
+    int fd = accept(s->fd, NULL, NULL);
+    if (fd < 0 && errno == EINTR)
+      continue;
+    if (fd < 0) {
+      fprintf(stderr, "oc8-buildd: Failed to accept a client.\n");
+      return;
+    }
+
+    int stop = serve_client(s, fd);
+    close(fd);
+    if (stop)
+      return;
+  }
+}
+
+static void free_entries(oc8_smap_t *entries) {
+  oc8_smap_it_t it = oc8_smap_get_it(entries);
+  while (oc8_smap_it_get(&it) != NULL) {
+    oc8_build_entry_t *entry = (oc8_build_entry_t *)oc8_smap_it_get(&it)->val;
+    obj_release(entry->obj);
+    free(entry);
+    oc8_smap_it_next(&it);
+  }
+  oc8_smap_free(entries);
+}
+
+void oc8_build_server_free(oc8_build_server_t *s) {
+  close(s->fd);
+  unlink(s->socket_path);
+  free(s->socket_path);
+  oc8_pool_free(&s->pool);
+
+  free_entries(&s->sources);
+  free_entries(&s->objects);
+}
@@ -0,0 +1,113 @@
+#include <catch2/catch.hpp>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "oc8_build/driver.h"
+#include "oc8_emu/cpu.h"
+#include "oc8_emu/mem.h"
+
+#include "../../tests/test_src.h"
+
+namespace {
+
+oc8_build_src_t make_src(const char *name, const std::string &code) {
+  return {name, code.c_str(), code.size()};
+}
+
+// v15 = x + 8, and loop forever
+std::string start_src(int x) {
+  return "  .globl _start\n"
+         "_start:\n"
+         "  mov " +
+         std::to_string(x) +
+         ", %v0\n"
+         "  mov 8, %v1\n"
+         "  call my_add\n"
+         "  mov %v0, %vf\n"
+         "Lend:\n"
+         "  jmp Lend\n";
+}
+
+} // namespace
+
+TEST_CASE("build sources in memory", "") {
+  std::string start = start_src(6);
+  std::string add = test_my_add_src;
+  oc8_build_src_t srcs[] = {make_src("start", start), make_src("add", add)};
+
+  oc8_arena_t arena;
+  oc8_arena_init(&arena, 0);
+  oc8_bin_file_t bf;
+  REQUIRE(oc8_build_link_sources(srcs, 2, &bf, &arena) == 0);
+  REQUIRE(bf.header.type == OC8_BIN_FILE_TYPE_BIN);
+  REQUIRE(bf.rom_size == 16);
+  oc8_arena_free(&arena);
+
+  oc8_emu_init();
+  REQUIRE(oc8_build_load_emu(srcs, 2) == 0);
+  for (int i = 0; i < 10; ++i)
+    oc8_emu_cpu_step();
+  REQUIRE(g_oc8_emu_cpu.regs_data[15] == 14);
+}
+
+TEST_CASE("build sources in memory errors", "") {
+  std::string start = start_src(6);
+  std::string bad = "  badins %v0\n";
+  oc8_build_src_t srcs[] = {make_src("start", start), make_src("bad", bad)};
+  oc8_arena_t arena;
+  oc8_arena_init(&arena, 0);
+  oc8_bin_file_t bf;
+  REQUIRE(oc8_build_link_sources(srcs, 2, &bf, &arena) != 0);
+  // Undefined my_add
+  REQUIRE(oc8_build_link_sources(srcs, 1, &bf, &arena) != 0);
+  oc8_arena_free(&arena);
+}
+
+TEST_CASE("build many programs into a batch", "") {
+  const size_t nb_progs = 200;
+  std::string add = test_my_add_src;
+  oc8_emu_batch_t b;
+  oc8_emu_batch_init(&b, nb_progs, 2);
+  for (size_t i = 0; i < nb_progs; ++i) {
+    std::string start = start_src(i);
+    oc8_build_src_t srcs[] = {make_src("start", start), make_src("add", add)};
+    REQUIRE(oc8_build_load_batch(srcs, 2, &b, i) == 0);
+  }
+
+  oc8_emu_batch_step(&b, 10);
+  for (size_t i = 0; i < nb_progs; ++i) {
+    REQUIRE(b.halted[i] == 0);
+    REQUIRE(b.cpus[i].regs_data[15] == (uint8_t)(i + 8));
+  }
+  oc8_emu_batch_free(&b);
+}
+
+// Run with `utest_oc8build.bin [bench]`
+TEST_CASE("build in memory bench", "[.bench]") {
+  const size_t nb_progs = 10000;
+  std::string add = test_my_add_src;
+  std::vector<std::string> starts;
+  for (size_t i = 0; i < nb_progs; ++i)
+    starts.push_back(start_src(i % 256));
+
+  auto begin = std::chrono::steady_clock::now();
+  oc8_arena_t arena;
+  oc8_arena_init(&arena, 0);
+  for (size_t i = 0; i < nb_progs; ++i) {
+    oc8_build_src_t srcs[] = {make_src("start", starts[i]),
+                              make_src("add", add)};
+    oc8_bin_file_t bf;
+    REQUIRE(oc8_build_link_sources(srcs, 2, &bf, &arena) == 0);
+    oc8_arena_free(&arena);
+    oc8_arena_init(&arena, 0);
+  }
+  oc8_arena_free(&arena);
+  double secs = std::chrono::duration<double>(
+                    std::chrono::steady_clock::now() - begin)
+                    .count();
+  std::printf("build in memory: %zu programs in %.3fs (%.0f / s)\n", nb_progs,
+              secs, nb_progs / secs);
+}
@@ -0,0 +1,104 @@
+#include <catch2/catch.hpp>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "oc8_as/as.h"
+#include "oc8_bin/cache.h"
+#include "oc8_build/client.h"
+#include "oc8_build/server.h"
+#include "oc8_ld/incremental.h"
+
+#include "../../tests/test_src.h"
+
+#define TMP_SOCKET "/tmp/oc8_test_buildd.sock"
+#define TMP_PREFIX "/tmp/oc8_test_buildd_"
+
+namespace {
+
+void save_file(const std::string &path, const std::string &data) {
+  REQUIRE(oc8_bin_write_file_atomic(path.c_str(), data.c_str(), data.size(),
+                                    0644) == 0);
+}
+
+std::string read_file(const std::string &path) {
+  std::ifstream is(path, std::ios::binary);
+  return std::string(std::istreambuf_iterator<char>(is),
+                     std::istreambuf_iterator<char>());
+}
+
+int send_req(oc8_build_req_kind_t kind, const std::vector<std::string> &args) {
+  std::vector<const char *> strs;
+  for (const auto &arg : args)
+    strs.push_back(arg.c_str());
+  int status = -1;
+  REQUIRE(oc8_build_client_send(TMP_SOCKET, kind, strs.data(), strs.size(),
+                                &status) == 0);
+  return status;
+}
+
+} // namespace
+
+TEST_CASE("build server", "") {
+  std::string add_src = TMP_PREFIX "add.c8s";
+  std::string add_obj = TMP_PREFIX "add.c8o";
+  std::string start_src = TMP_PREFIX "start.c8s";
+  std::string start_obj = TMP_PREFIX "start.c8o";
+  std::string out = TMP_PREFIX "out.c8bin";
+  std::string ref = TMP_PREFIX "ref.c8bin";
+  save_file(add_src, test_my_add_src);
+  save_file(start_src, test_call_add_src);
+
+  int status;
+  REQUIRE(oc8_build_client_send(TMP_SOCKET, OC8_BUILD_REQ_STOP, nullptr, 0,
+                                &status) != 0);
+  oc8_build_server_t server;
+  REQUIRE(oc8_build_server_init(&server, TMP_SOCKET, 2) == 0);
+  std::thread th([&] { oc8_build_server_run(&server); });
+  oc8_build_server_t other;
+  REQUIRE(oc8_build_server_init(&other, TMP_SOCKET, 1) != 0);
+
+  // Same outputs as the tools
+  REQUIRE(send_req(OC8_BUILD_REQ_AS,
+                   {"", add_src, add_obj, start_src, start_obj}) == 0);
+  REQUIRE(send_req(OC8_BUILD_REQ_LD, {"", out, start_obj, add_obj}) == 0);
+  REQUIRE(server.nb_reused == 2);
+  std::string add_ref = read_file(add_obj);
+  REQUIRE(oc8_as_assemble_file(add_src.c_str(), add_obj.c_str(), nullptr,
+                               nullptr) == 0);
+  REQUIRE(read_file(add_obj) == add_ref);
+  const char *ins[] = {start_obj.c_str(), add_obj.c_str()};
+  REQUIRE(oc8_ld_link_files(ins, 2, ref.c_str(), nullptr, nullptr) == 0);
+  REQUIRE(read_file(out) == read_file(ref));
+
+  // add_obj was replaced: written again from memory, not assembled
+  REQUIRE(send_req(OC8_BUILD_REQ_AS,
+                   {"", add_src, add_obj, start_src, start_obj}) == 0);
+  REQUIRE(server.nb_reused == 4);
+  REQUIRE(send_req(OC8_BUILD_REQ_LD, {"", out, start_obj, add_obj}) == 0);
+  REQUIRE(server.nb_reused == 6);
+  REQUIRE(read_file(out) == read_file(ref));
+
+  // Errors only fail the request
+  save_file(start_src, "  call my_add, 3\n");
+  REQUIRE(send_req(OC8_BUILD_REQ_AS, {"", start_src, start_obj}) == 1);
+  REQUIRE(send_req(OC8_BUILD_REQ_LD, {"", out, add_obj}) == 1);
+  REQUIRE(send_req(OC8_BUILD_REQ_LD, {"", out, TMP_PREFIX "none.c8o"}) == 1);
+  REQUIRE(send_req(OC8_BUILD_REQ_LD, {"", out, add_src}) == 1);
+
+  // Changed source
+  save_file(start_src, test_call_add_mem_src);
+  REQUIRE(send_req(OC8_BUILD_REQ_AS, {"", start_src, start_obj}) == 0);
+  REQUIRE(send_req(OC8_BUILD_REQ_LD, {"", out, start_obj, add_obj}) == 0);
+  REQUIRE(oc8_ld_link_files(ins, 2, ref.c_str(), nullptr, nullptr) == 0);
+  REQUIRE(read_file(out) == read_file(ref));
+
+  REQUIRE(send_req(OC8_BUILD_REQ_STOP, {}) == 0);
+  th.join();
+  oc8_build_server_free(&server);
+  REQUIRE(oc8_build_client_send(TMP_SOCKET, OC8_BUILD_REQ_STOP, nullptr, 0,
+                                &status) != 0);
+}
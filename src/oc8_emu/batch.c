@@ -0,0 +1,328 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "oc8_emu/batch.h"
+#include "oc8_emu/rom_cache.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define CACHE_LINE (64)
+
+// Machines are stepped by chunks, a chunk is the unit of work of a thread
+#define CHUNK_SIZE (32)
+
+#define DEFAULT_CPU_SPEED (500)
+#define FRAMES_PER_SEC (60)
+
+#define ALIGN_UP(X) (((X) + CACHE_LINE - 1) & ~(size_t)(CACHE_LINE - 1))
+
+// Every worker owns a range of chunks [next, end)
+// It takes chunks from the front of its range, and once empty steals chunks
+// from the ranges of the other workers
+// Padded so that workers never share a cache line
+typedef struct __attribute__((aligned(CACHE_LINE))) {
+  size_t next;
+  size_t end;
+  uint64_t counter_ins;
+  pthread_t thread;
+  oc8_emu_batch_pool_t *pool;
+} worker_t;
+
+struct oc8_emu_batch_pool {
+  pthread_mutex_t lock;
+  pthread_cond_t start_cv;
+  pthread_cond_t done_cv;
+
+  // Incremented every time a new step is started
+  unsigned gen;
+
+  // Number of threads still working on the current step
+  unsigned nb_busy;
+
+  int stop;
+
+  // Number of instructions run by every machine for the current step
+  unsigned nb_ins;
+
+  // workers[0] is the thread calling `oc8_emu_batch_step`
+  unsigned nb_workers;
+  worker_t *workers;
+
+  oc8_emu_batch_t *b;
+};
+
+// 0 instructions per frame is used as 1
+static unsigned get_ins_per_frame(const oc8_emu_batch_t *b) {
+  return b->ins_per_frame ? b->ins_per_frame : 1;
+}
+
+static uint64_t run_machine(oc8_emu_batch_t *b, size_t idx, unsigned nb_ins) {
+  if (b->halted[idx])
+    return 0;
+
+  oc8_emu_ctx_t *ctx = &b->ctxs[idx];
+  unsigned ipf = get_ins_per_frame(b);
+  for (unsigned i = 0; i < nb_ins; ++i) {
+    int err = oc8_emu_ctx_exec(ctx);
+    if (err) {
+      b->halted[idx] = (uint8_t)err;
+      return i;
+    }
+    if (ctx->cpu->counter_ins % ipf == 0)
+      oc8_emu_ctx_decrease_timers(ctx, 1);
+  }
+
+  return nb_ins;
+}
+
+static size_t take_chunk(worker_t *w) {
+  return __atomic_fetch_add(&w->next, 1, __ATOMIC_RELAXED);
+}
+
+static void run_job(oc8_emu_batch_pool_t *pool, unsigned id) {
+  oc8_emu_batch_t *b = pool->b;
+  worker_t *self = &pool->workers[id];
+  uint64_t counter_ins = 0;
+
+  // Own range first, then go through all the others
+  for (unsigned i = 0; i < pool->nb_workers; ++i) {
+    worker_t *w = &pool->workers[(id + i) % pool->nb_workers];
+    for (;;) {
+      size_t chunk = take_chunk(w);
+      if (chunk >= w->end)
+        break;
+
+      size_t beg = chunk * CHUNK_SIZE;
+      size_t end = beg + CHUNK_SIZE < b->size ? beg + CHUNK_SIZE : b->size;
+      for (size_t idx = beg; idx < end; ++idx)
+        counter_ins += run_machine(b, idx, pool->nb_ins);
+    }
+  }
+
+  self->counter_ins = counter_ins;
+}
+
+static void *worker_main(void *arg) {
+  worker_t *self = (worker_t *)arg;
+  oc8_emu_batch_pool_t *pool = self->pool;
+  unsigned id = (unsigned)(self - pool->workers);
+  unsigned seen_gen = 0;
+
+  for (;;) {
+    pthread_mutex_lock(&pool->lock);
+    while (!pool->stop && pool->gen == seen_gen)
+      pthread_cond_wait(&pool->start_cv, &pool->lock);
+    if (pool->stop) {
+      pthread_mutex_unlock(&pool->lock);
+      break;
+    }
+    seen_gen = pool->gen;
+    pthread_mutex_unlock(&pool->lock);
+
+    run_job(pool, id);
+
+    pthread_mutex_lock(&pool->lock);
+    if (--pool->nb_busy == 0)
+      pthread_cond_signal(&pool->done_cv);
+    pthread_mutex_unlock(&pool->lock);
+  }
+
+  return NULL;
+}
+
+static void pool_free(oc8_emu_batch_pool_t *pool) {
+  pthread_mutex_lock(&pool->lock);
+  pool->stop = 1;
+  pthread_cond_broadcast(&pool->start_cv);
+  pthread_mutex_unlock(&pool->lock);
+
+  for (unsigned i = 1; i < pool->nb_workers; ++i)
+    pthread_join(pool->workers[i].thread, NULL);
+
+  pthread_mutex_destroy(&pool->lock);
+  pthread_cond_destroy(&pool->start_cv);
+  pthread_cond_destroy(&pool->done_cv);
+  free(pool->workers);
+  free(pool);
+}
+
+// @returns 0 if success, != 0 on error (printed)
+static int pool_init(oc8_emu_batch_t *b, unsigned nb_threads) {
+  if (nb_threads == 0) {
+    long nb_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    nb_threads = nb_cpus > 0 ? (unsigned)nb_cpus : 1;
+  }
+
+  oc8_emu_batch_pool_t *pool = malloc(sizeof(oc8_emu_batch_pool_t));
+  if (!pool) {
+    fprintf(stderr, "oc8_emu_batch_init: failed to allocate threads\n");
+    return -1;
+  }
+  pthread_mutex_init(&pool->lock, NULL);
+  pthread_cond_init(&pool->start_cv, NULL);
+  pthread_cond_init(&pool->done_cv, NULL);
+  pool->gen = 0;
+  pool->nb_busy = 0;
+  pool->stop = 0;
+  pool->nb_ins = 0;
+  pool->nb_workers = nb_threads;
+  pool->b = b;
+  if (posix_memalign((void **)&pool->workers, CACHE_LINE,
+                     nb_threads * sizeof(worker_t))) {
+    fprintf(stderr, "oc8_emu_batch_init: failed to allocate threads\n");
+    pool->workers = NULL;
+    pool->nb_workers = 1;
+    pool_free(pool);
+    return -1;
+  }
+  memset(pool->workers, 0, nb_threads * sizeof(worker_t));
+
+  for (unsigned i = 0; i < nb_threads; ++i)
+    pool->workers[i].pool = pool;
+  for (unsigned i = 1; i < nb_threads; ++i)
+    if (pthread_create(&pool->workers[i].thread, NULL, worker_main,
+                       &pool->workers[i])) {
+      fprintf(stderr, "oc8_emu_batch_init: failed to create thread\n");
+      // Only stop the threads already running
+      pool->nb_workers = i;
+      pool_free(pool);
+      return -1;
+    }
+
+  b->pool = pool;
+  return 0;
+}
+
+int oc8_emu_batch_init(oc8_emu_batch_t *b, size_t size, unsigned nb_threads) {
+  // All arrays in one block, each starting on a new cache line
+  size_t cpus_off = 0;
+  size_t stacks_off = ALIGN_UP(cpus_off + size * sizeof(oc8_emu_cpu_t));
+  size_t screens_off = ALIGN_UP(
+      stacks_off + size * OC8_EMU_MIN_STACK_SIZE * sizeof(uint16_t));
+  size_t keypads_off = ALIGN_UP(screens_off + size * OC8_EMU_SCREEN_SIZE);
+  size_t halted_off =
+      ALIGN_UP(keypads_off + size * OC8_EMU_NB_KEYS * sizeof(int));
+  size_t ctxs_off = ALIGN_UP(halted_off + size);
+  size_t total = ALIGN_UP(ctxs_off + size * sizeof(oc8_emu_ctx_t));
+
+  uint8_t *block;
+  if (posix_memalign((void **)&block, CACHE_LINE, total ? total : CACHE_LINE)) {
+    fprintf(stderr, "oc8_emu_batch_init: failed to allocate %zu machines\n",
+            size);
+    return -1;
+  }
+
+  b->size = size;
+  b->cpus = (oc8_emu_cpu_t *)(block + cpus_off);
+  b->stacks = (uint16_t *)(block + stacks_off);
+  b->screens = block + screens_off;
+  b->keypads = (int *)(block + keypads_off);
+  b->halted = block + halted_off;
+  b->ctxs = (oc8_emu_ctx_t *)(block + ctxs_off);
+  b->ins_per_frame = DEFAULT_CPU_SPEED / FRAMES_PER_SEC;
+  b->counter_ins = 0;
+
+  for (size_t i = 0; i < size; ++i) {
+    oc8_emu_ctx_t *ctx = &b->ctxs[i];
+    ctx->cpu = &b->cpus[i];
+    ctx->image = NULL;
+    ctx->stack = b->stacks + i * OC8_EMU_MIN_STACK_SIZE;
+    ctx->screen = oc8_emu_batch_screen(b, i);
+    ctx->keypad = oc8_emu_batch_keypad(b, i);
+    ctx->metrics = NULL;
+    oc8_emu_batch_reset(b, i);
+  }
+
+  if (pool_init(b, nb_threads) != 0) {
+    for (size_t i = 0; i < size; ++i)
+      oc8_emu_ctx_detach(&b->ctxs[i]);
+    free(block);
+    return -1;
+  }
+  return 0;
+}
+
+void oc8_emu_batch_free(oc8_emu_batch_t *b) {
+  pool_free(b->pool);
+  for (size_t i = 0; i < b->size; ++i)
+    oc8_emu_ctx_detach(&b->ctxs[i]);
+  // The block starts with the cpus array
+  free(b->cpus);
+  b->pool = NULL;
+  b->size = 0;
+}
+
+void oc8_emu_batch_reset(oc8_emu_batch_t *b, size_t idx) {
+  oc8_emu_cpu_t *cpu = &b->cpus[idx];
+  memset(cpu, 0, sizeof(oc8_emu_cpu_t));
+  cpu->cpu_speed = DEFAULT_CPU_SPEED;
+  oc8_emu_ctx_attach(&b->ctxs[idx], oc8_emu_image_font());
+  memset(b->ctxs[idx].stack, 0, OC8_EMU_MIN_STACK_SIZE * sizeof(uint16_t));
+  memset(oc8_emu_batch_screen(b, idx), 0, OC8_EMU_SCREEN_SIZE);
+  memset(oc8_emu_batch_keypad(b, idx), 0, OC8_EMU_NB_KEYS * sizeof(int));
+  b->halted[idx] = 0;
+}
+
+int oc8_emu_batch_load_rom(oc8_emu_batch_t *b, size_t idx,
+                           const void *rom_bytes, unsigned rom_size) {
+  oc8_emu_rom_t *rom = oc8_emu_rom_cache_get(rom_bytes, rom_size);
+  if (!rom)
+    return 1;
+
+  oc8_emu_ctx_attach(&b->ctxs[idx], rom->image);
+  oc8_emu_rom_unref(rom);
+  b->cpus[idx].reg_pc = OC8_EMU_ROM_ADDR;
+  return 0;
+}
+
+int oc8_emu_batch_load_rom_all(oc8_emu_batch_t *b, const void *rom_bytes,
+                               unsigned rom_size) {
+  oc8_emu_rom_t *rom = oc8_emu_rom_cache_get(rom_bytes, rom_size);
+  if (!rom)
+    return 1;
+
+  for (size_t i = 0; i < b->size; ++i) {
+    oc8_emu_ctx_attach(&b->ctxs[i], rom->image);
+    b->cpus[i].reg_pc = OC8_EMU_ROM_ADDR;
+  }
+  oc8_emu_rom_unref(rom);
+  return 0;
+}
+
+void oc8_emu_batch_step(oc8_emu_batch_t *b, unsigned nb_ins) {
+  oc8_emu_batch_pool_t *pool = b->pool;
+  size_t nb_chunks = (b->size + CHUNK_SIZE - 1) / CHUNK_SIZE;
+  if (nb_chunks == 0 || nb_ins == 0)
+    return;
+
+  // Split chunks evenly, the ranges are only written when no one is working
+  unsigned nb_workers = pool->nb_workers;
+  for (unsigned i = 0; i < nb_workers; ++i) {
+    pool->workers[i].next = nb_chunks * i / nb_workers;
+    pool->workers[i].end = nb_chunks * (i + 1) / nb_workers;
+  }
+  pool->nb_ins = nb_ins;
+
+  pthread_mutex_lock(&pool->lock);
+  pool->nb_busy = nb_workers - 1;
+  ++pool->gen;
+  pthread_cond_broadcast(&pool->start_cv);
+  pthread_mutex_unlock(&pool->lock);
+
+  run_job(pool, 0);
+
+  pthread_mutex_lock(&pool->lock);
+  while (pool->nb_busy)
+    pthread_cond_wait(&pool->done_cv, &pool->lock);
+  pthread_mutex_unlock(&pool->lock);
+
+  for (unsigned i = 0; i < nb_workers; ++i)
+    b->counter_ins += pool->workers[i].counter_ins;
+}
+
+void oc8_emu_batch_step_frame(oc8_emu_batch_t *b) {
+  oc8_emu_batch_step(b, get_ins_per_frame(b));
+}
@@ -1,9 +1,11 @@
 #define _POSIX_C_SOURCE 200809L
 
 #include "oc8_emu/cpu.h"
+#include "oc8_emu/ctx.h"
 #include "oc8_emu/debug.h"
 #include "oc8_emu/input.h"
 #include "oc8_emu/mem.h"
+#include "oc8_emu/metrics.h"
 #include "oc8_emu/screen.h"
 
 #include <assert.h>
@@ -17,11 +19,22 @@
 #define TIMER_ROUND_DURATION (1e6 / 60)
 #define MIN_SLEEP_TIME_US (200)
 
-// Implementation in exec_ins.c
-void oc8_emu_exec_ins();
-
 oc8_emu_cpu_t g_oc8_emu_cpu;
 
+#define PAGE(I) (g_oc8_emu_mem.ram + (I)*OC8_EMU_PAGE_SIZE)
+oc8_emu_ctx_t g_oc8_emu_ctx = {
+    &g_oc8_emu_cpu,
+    {PAGE(0), PAGE(1), PAGE(2), PAGE(3), PAGE(4), PAGE(5), PAGE(6), PAGE(7),
+     PAGE(8), PAGE(9), PAGE(10), PAGE(11), PAGE(12), PAGE(13), PAGE(14),
+     PAGE(15)},
+    0,
+    NULL,
+    g_oc8_emu_mem.stack,
+    g_oc8_emu_screen,
+    g_oc8_emu_keypad,
+    &g_oc8_emu_metrics};
+#undef PAGE
+
 static uint64_t time_us() {
   struct timespec spec;
   clock_gettime(CLOCK_REALTIME, &spec);
@@ -47,32 +60,84 @@ void oc8_emu_init() {
   oc8_emu_init_mem();
   oc8_emu_init_screen();
   oc8_emu_init_debug();
+  oc8_emu_init_metrics();
 }
 
-static void decrease_timers(unsigned val) {
-  uint8_t tval = (uint8_t)val;
-  if (tval > g_oc8_emu_cpu.reg_dt)
-    g_oc8_emu_cpu.reg_dt = 0;
+void oc8_emu_ctx_decrease_timers(oc8_emu_ctx_t *ctx, unsigned val) {
+  oc8_emu_cpu_t *cpu = ctx->cpu;
+  uint8_t tval = val > 0xFF ? 0xFF : (uint8_t)val;
+  if (tval > cpu->reg_dt)
+    cpu->reg_dt = 0;
   else
-    g_oc8_emu_cpu.reg_dt -= tval;
-  if (tval > g_oc8_emu_cpu.reg_st)
-    g_oc8_emu_cpu.reg_st = 0;
+    cpu->reg_dt -= tval;
+  if (tval > cpu->reg_st)
+    cpu->reg_st = 0;
   else
-    g_oc8_emu_cpu.reg_st -= tval;
+    cpu->reg_st -= tval;
 }
 
-static void fetch_ins() {
-  unsigned pc = g_oc8_emu_cpu.reg_pc;
-  assert(pc < OC8_EMU_RAM_SIZE);
-  if (pc & 0x1) {
-    fprintf(stderr, "Warning: fetch instruction at unaligned address %x\n", pc);
+static void update_metrics(oc8_emu_ctx_t *ctx) {
+  oc8_emu_metrics_t *m = ctx->metrics;
+  oc8_emu_cpu_t *cpu = ctx->cpu;
+  if (!m)
+    return;
+
+  oc8_emu_metrics_inc(&m->ins);
+  if (cpu->curr_ins.type == OC8_IS_TYPE_DXYN)
+    oc8_emu_metrics_inc(&m->frame_draws);
+
+  // Measure FX0A from the first blocked try until the key is received
+  if (cpu->block_waitq && !m->waitk_begin)
+    m->waitk_begin = oc8_emu_metrics_now_us();
+  else if (!cpu->block_waitq && m->waitk_begin) {
+    oc8_emu_metrics_observe(&m->waitk_us,
+                            oc8_emu_metrics_now_us() - m->waitk_begin);
+    m->waitk_begin = 0;
   }
+}
 
-  const char *pc_ptr = (const char *)&g_oc8_emu_mem.ram[pc];
-  if (oc8_is_decode_ins(&g_oc8_emu_cpu.curr_ins, pc_ptr) != 0) {
-    fprintf(stderr, "Failed to decode instruction at address %x\n", pc);
-    exit(1);
+// Use the instruction decoded by the image if the opcode wasn't modified
+// Returns 0 if it must be decoded
+static int fetch_decoded(oc8_emu_ctx_t *ctx, unsigned pc) {
+  const oc8_emu_image_t *img = ctx->image;
+  unsigned off = pc - OC8_EMU_ROM_ADDR;
+  if (!img || off >= img->ins_size || !img->ins_ok[off])
+    return 0;
+
+  unsigned pages = (1 << (pc / OC8_EMU_PAGE_SIZE)) |
+                   (1 << ((pc + 1) / OC8_EMU_PAGE_SIZE));
+  if ((ctx->shared_pages & pages) != pages)
+    return 0;
+
+  ctx->cpu->curr_ins = img->ins[off];
+  return 1;
+}
+
+int oc8_emu_ctx_exec(oc8_emu_ctx_t *ctx) {
+  oc8_emu_cpu_t *cpu = ctx->cpu;
+
+  // Fecth instruction
+  unsigned pc = cpu->reg_pc;
+  assert(pc < OC8_EMU_RAM_SIZE);
+  if (!fetch_decoded(ctx, pc)) {
+    char opcode[2];
+    opcode[0] = (char)oc8_emu_ctx_read(ctx, pc);
+    opcode[1] = (char)oc8_emu_ctx_read(ctx, pc + 1);
+    if (oc8_is_decode_ins(&cpu->curr_ins, opcode) != 0)
+      return OC8_EMU_EXEC_ERR_DECODE;
   }
+  int err = oc8_emu_check_ins(ctx);
+  if (err != OC8_EMU_EXEC_OK)
+    return err;
+
+  cpu->block_waitq = 0;
+  cpu->screen_changed = 0;
+  ++cpu->counter_ins;
+
+  // Exec instruction
+  oc8_emu_exec_ins(ctx);
+  update_metrics(ctx);
+  return OC8_EMU_EXEC_OK;
 }
 
 void oc8_emu_cpu_step() {
@@ -82,19 +147,27 @@ void oc8_emu_cpu_step() {
   unsigned timer_dec =
       (now - g_oc8_emu_cpu.timer_last_update) / TIMER_ROUND_DURATION;
   if (timer_dec > 0) {
-    decrease_timers(timer_dec);
+    oc8_emu_ctx_decrease_timers(&g_oc8_emu_ctx, timer_dec);
     g_oc8_emu_cpu.timer_last_update +=
         (uint64_t)timer_dec * TIMER_ROUND_DURATION;
   }
 
-  // Fecth instruction
-  fetch_ins();
-  g_oc8_emu_cpu.block_waitq = 0;
-  g_oc8_emu_cpu.screen_changed = 0;
-  ++g_oc8_emu_cpu.counter_ins;
+  unsigned pc = g_oc8_emu_cpu.reg_pc;
+  if (pc & 0x1) {
+    fprintf(stderr, "Warning: fetch instruction at unaligned address %x\n", pc);
+  }
 
-  // Exec instruction
-  oc8_emu_exec_ins();
+  int err = oc8_emu_ctx_exec(&g_oc8_emu_ctx);
+  if (err == OC8_EMU_EXEC_ERR_DECODE) {
+    fprintf(stderr, "Failed to decode instruction at address %x\n", pc);
+    exit(1);
+  } else if (err == OC8_EMU_EXEC_ERR_STACK) {
+    fprintf(stderr, "Return with empty stack at address %x\n", pc);
+    exit(1);
+  } else if (err == OC8_EMU_EXEC_ERR_OPERAND) {
+    fprintf(stderr, "Invalid operand for instruction at address %x\n", pc);
+    exit(1);
+  }
 }
 
 void oc8_emu_cpu_cycle() {
@@ -104,8 +177,11 @@ void oc8_emu_cpu_cycle() {
     unsigned fq = g_oc8_emu_cpu.cpu_speed;
     uint64_t cycle_elapse_us = time_us() - g_oc8_emu_cpu.last_cycle_time;
     uint64_t cycle_wait_us = 1e6L / fq;
-    if (cycle_elapse_us > cycle_wait_us)
+    if (cycle_elapse_us > cycle_wait_us) {
+      oc8_emu_metrics_observe(&g_oc8_emu_metrics.pacing_jitter_us,
+                              cycle_elapse_us - cycle_wait_us);
       break;
+    }
 
     // Either busy or sleep wait
     uint64_t wait_us = cycle_wait_us - cycle_elapse_us;
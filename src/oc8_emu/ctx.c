@@ -0,0 +1,38 @@
+#include "oc8_emu/ctx.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+void oc8_emu_ctx_set_mem(oc8_emu_ctx_t *ctx, oc8_emu_mem_t *mem) {
+  oc8_emu_ctx_detach(ctx);
+  for (unsigned i = 0; i < OC8_EMU_NB_PAGES; ++i)
+    ctx->pages[i] = mem->ram + i * OC8_EMU_PAGE_SIZE;
+  ctx->stack = mem->stack;
+}
+
+void oc8_emu_ctx_attach(oc8_emu_ctx_t *ctx, oc8_emu_image_t *img) {
+  oc8_emu_image_ref(img);
+  oc8_emu_ctx_detach(ctx);
+  memcpy(ctx->pages, img->pages, sizeof(ctx->pages));
+  ctx->shared_pages = (1 << OC8_EMU_NB_PAGES) - 1;
+  ctx->image = img;
+}
+
+void oc8_emu_ctx_detach(oc8_emu_ctx_t *ctx) {
+  if (!ctx->image)
+    return;
+
+  for (unsigned i = 0; i < OC8_EMU_NB_PAGES; ++i)
+    if (!((ctx->shared_pages >> i) & 0x1))
+      free(ctx->pages[i]);
+  oc8_emu_image_unref(ctx->image);
+  ctx->image = NULL;
+  ctx->shared_pages = 0;
+}
+
+void oc8_emu_ctx_privatize(oc8_emu_ctx_t *ctx, unsigned page) {
+  uint8_t *copy = malloc(OC8_EMU_PAGE_SIZE);
+  memcpy(copy, ctx->pages[page], OC8_EMU_PAGE_SIZE);
+  ctx->pages[page] = copy;
+  ctx->shared_pages &= ~(1 << page);
+}
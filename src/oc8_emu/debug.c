@@ -1,11 +1,17 @@
 #include "oc8_emu/debug.h"
 
 #include "oc8_emu/mem.h"
+#include "oc8_emu/rom_cache.h"
 
 oc8_bin_file_t g_oc8_emu_bin_file = {.header = {.version = 0}};
+oc8_emu_rom_t *g_oc8_emu_bin_rom = NULL;
 
 void oc8_emu_init_debug() {
-  if (g_oc8_emu_bin_file_loaded()) {
+  if (g_oc8_emu_bin_rom) {
+    oc8_emu_rom_unref(g_oc8_emu_bin_rom);
+    g_oc8_emu_bin_rom = NULL;
+    g_oc8_emu_bin_file.header.version = 0;
+  } else if (g_oc8_emu_bin_file_loaded()) {
     oc8_bin_file_free(&g_oc8_emu_bin_file);
     g_oc8_emu_bin_file.header.version = 0;
   }
@@ -17,6 +23,11 @@ void oc8_emu_gen_debug_bin_file() {
 
   const void *rom_ptr = g_oc8_emu_mem.ram + OC8_EMU_ROM_ADDR;
   size_t rom_size = OC8_EMU_RAM_SIZE - OC8_EMU_ROM_ADDR;
-  oc8_bin_file_init_binary_rom(&g_oc8_emu_bin_file, rom_ptr, rom_size);
-  oc8_bin_file_check(&g_oc8_emu_bin_file, /*is_bin=*/1);
+  if (oc8_bin_file_init_binary_rom(&g_oc8_emu_bin_file, rom_ptr, rom_size)) {
+    // Already freed, only mark it empty
+    g_oc8_emu_bin_file.header.version = 0;
+  } else if (oc8_bin_file_validate(&g_oc8_emu_bin_file, /*is_bin=*/1)) {
+    oc8_bin_file_free(&g_oc8_emu_bin_file);
+    g_oc8_emu_bin_file.header.version = 0;
+  }
 }
@@ -4,447 +4,494 @@
 #include <string.h>
 
 #include "oc8_emu/cpu.h"
+#include "oc8_emu/ctx.h"
 #include "oc8_emu/input.h"
 #include "oc8_emu/mem.h"
 #include "oc8_emu/screen.h"
 
 #define OPCODE_SIZE (2)
 
-static void exec_ins_0NNN() {
+int oc8_emu_check_ins(const oc8_emu_ctx_t *ctx) {
+  const oc8_emu_cpu_t *cpu = ctx->cpu;
+  const oc8_is_ins_t *ins = &cpu->curr_ins;
+  switch (ins->type) {
+  case OC8_IS_TYPE_00EE:
+    return cpu->reg_sp == 0 ? OC8_EMU_EXEC_ERR_STACK : OC8_EMU_EXEC_OK;
+  case OC8_IS_TYPE_CXNN:
+    return ins->operands[1] == 0 ? OC8_EMU_EXEC_ERR_OPERAND : OC8_EMU_EXEC_OK;
+  case OC8_IS_TYPE_EX9E:
+  case OC8_IS_TYPE_EXA1:
+    return cpu->regs_data[ins->operands[0]] >= OC8_EMU_NB_KEYS
+               ? OC8_EMU_EXEC_ERR_OPERAND
+               : OC8_EMU_EXEC_OK;
+  default:
+    return OC8_EMU_EXEC_OK;
+  }
+}
+
+static void exec_ins_0NNN(oc8_emu_ctx_t *ctx) {
+  (void)ctx;
   fprintf(stderr, "Instruction 0NNN not implemented. Aborting !\n");
 }
 
-static void exec_ins_00E0() {
-  memset(g_oc8_emu_screen, 0, sizeof(g_oc8_emu_screen));
-  g_oc8_emu_cpu.screen_changed = 1;
-  g_oc8_emu_cpu.reg_pc += OPCODE_SIZE;
+static void exec_ins_00E0(oc8_emu_ctx_t *ctx) {
+  oc8_emu_cpu_t *cpu = ctx->cpu;
+  memset(ctx->screen, 0, OC8_EMU_SCREEN_SIZE);
+  cpu->screen_changed = 1;
+  cpu->reg_pc += OPCODE_SIZE;
 }
 
-static void exec_ins_00EE() {
-  unsigned sp = g_oc8_emu_cpu.reg_sp;
+static void exec_ins_00EE(oc8_emu_ctx_t *ctx) {
+  oc8_emu_cpu_t *cpu = ctx->cpu;
+  unsigned sp = cpu->reg_sp;
   assert(sp);
-  unsigned new_pc = g_oc8_emu_mem.stack[--sp] & 0xFFF;
-  g_oc8_emu_cpu.reg_sp = sp;
-  g_oc8_emu_cpu.reg_pc = new_pc;
+  unsigned new_pc = ctx->stack[--sp] & 0xFFF;
+  cpu->reg_sp = sp;
+  cpu->reg_pc = new_pc;
 }
 
-static void exec_ins_1NNN() {
-  unsigned new_pc = g_oc8_emu_cpu.curr_ins.operands[0] & 0xFFF;
-  g_oc8_emu_cpu.reg_pc = new_pc;
+static void exec_ins_1NNN(oc8_emu_ctx_t *ctx) {
+  oc8_emu_cpu_t *cpu = ctx->cpu;
+  unsigned new_pc = cpu->curr_ins.operands[0] & 0xFFF;
+  cpu->reg_pc = new_pc;
 }
 
-static void exec_ins_2NNN() {
-  unsigned next_ins = g_oc8_emu_cpu.reg_pc + OPCODE_SIZE;
-  unsigned new_pc = g_oc8_emu_cpu.curr_ins.operands[0] & 0xFFF;
-  unsigned sp = g_oc8_emu_cpu.reg_sp;
-  g_oc8_emu_mem.stack[sp++] = next_ins;
+static void exec_ins_2NNN(oc8_emu_ctx_t *ctx) {
+  oc8_emu_cpu_t *cpu = ctx->cpu;
+  unsigned next_ins = cpu->reg_pc + OPCODE_SIZE;
+  unsigned new_pc = cpu->curr_ins.operands[0] & 0xFFF;
+  unsigned sp = cpu->reg_sp;
+  ctx->stack[sp++] = next_ins;
 
-  g_oc8_emu_cpu.reg_sp = sp;
-  g_oc8_emu_cpu.reg_pc = new_pc;
+  cpu->reg_sp = sp;
+  cpu->reg_pc = new_pc;
 }
 
-static void exec_ins_3XNN() {
-  unsigned vx = g_oc8_emu_cpu.curr_ins.operands[0];
-  unsigned imm = g_oc8_emu_cpu.curr_ins.operands[1];
+static void exec_ins_3XNN(oc8_emu_ctx_t *ctx) {
+  oc8_emu_cpu_t *cpu = ctx->cpu;
+  unsigned vx = cpu->curr_ins.operands[0];
+  unsigned imm = cpu->curr_ins.operands[1];
 
-  if (g_oc8_emu_cpu.regs_data[vx] == imm)
-    g_oc8_emu_cpu.reg_pc += 2 * OPCODE_SIZE;
+  if (cpu->regs_data[vx] == imm)
+    cpu->reg_pc += 2 * OPCODE_SIZE;
   else
-    g_oc8_emu_cpu.reg_pc += OPCODE_SIZE;
+    cpu->reg_pc += OPCODE_SIZE;
 }
 
-static void exec_ins_4XNN() {
-  unsigned vx = g_oc8_emu_cpu.curr_ins.operands[0];
-  unsigned imm = g_oc8_emu_cpu.curr_ins.operands[1];
+static void exec_ins_4XNN(oc8_emu_ctx_t *ctx) {
+  oc8_emu_cpu_t *cpu = ctx->cpu;
+  unsigned vx = cpu->curr_ins.operands[0];
+  unsigned imm = cpu->curr_ins.operands[1];
 
-  if (g_oc8_emu_cpu.regs_data[vx] != imm)
-    g_oc8_emu_cpu.reg_pc += 2 * OPCODE_SIZE;
+  if (cpu->regs_data[vx] != imm)
+    cpu->reg_pc += 2 * OPCODE_SIZE;
   else
-    g_oc8_emu_cpu.reg_pc += OPCODE_SIZE;
+    cpu->reg_pc += OPCODE_SIZE;
 }
 
-static void exec_ins_5XY0() {
-  unsigned vx = g_oc8_emu_cpu.curr_ins.operands[0];
-  unsigned vy = g_oc8_emu_cpu.curr_ins.operands[1];
+static void exec_ins_5XY0(oc8_emu_ctx_t *ctx) {
+  oc8_emu_cpu_t *cpu = ctx->cpu;
+  unsigned vx = cpu->curr_ins.operands[0];
+  unsigned vy = cpu->curr_ins.operands[1];
 
-  if (g_oc8_emu_cpu.regs_data[vx] == g_oc8_emu_cpu.regs_data[vy])
-    g_oc8_emu_cpu.reg_pc += 2 * OPCODE_SIZE;
+  if (cpu->regs_data[vx] == cpu->regs_data[vy])
+    cpu->reg_pc += 2 * OPCODE_SIZE;
   else
-    g_oc8_emu_cpu.reg_pc += OPCODE_SIZE;
+    cpu->reg_pc += OPCODE_SIZE;
 }
 
-static void exec_ins_6XNN() {
-  unsigned vx = g_oc8_emu_cpu.curr_ins.operands[0];
-  unsigned imm = g_oc8_emu_cpu.curr_ins.operands[1];
+static void exec_ins_6XNN(oc8_emu_ctx_t *ctx) {
+  oc8_emu_cpu_t *cpu = ctx->cpu;
+  unsigned vx = cpu->curr_ins.operands[0];
+  unsigned imm = cpu->curr_ins.operands[1];
 
-  g_oc8_emu_cpu.regs_data[vx] = imm & 0xFF;
-  g_oc8_emu_cpu.reg_pc += OPCODE_SIZE;
+  cpu->regs_data[vx] = imm & 0xFF;
+  cpu->reg_pc += OPCODE_SIZE;
 }
 
-static void exec_ins_7XNN() {
-  unsigned vx = g_oc8_emu_cpu.curr_ins.operands[0];
-  uint8_t imm = g_oc8_emu_cpu.curr_ins.operands[1];
+static void exec_ins_7XNN(oc8_emu_ctx_t *ctx) {
+  oc8_emu_cpu_t *cpu = ctx->cpu;
+  unsigned vx = cpu->curr_ins.operands[0];
+  uint8_t imm = cpu->curr_ins.operands[1];
 
-  g_oc8_emu_cpu.regs_data[vx] += imm;
-  g_oc8_emu_cpu.reg_pc += OPCODE_SIZE;
+  cpu->regs_data[vx] += imm;
+  cpu->reg_pc += OPCODE_SIZE;
 }
 
-static void exec_ins_8XY0() {
-  unsigned vx = g_oc8_emu_cpu.curr_ins.operands[0];
-  unsigned vy = g_oc8_emu_cpu.curr_ins.operands[1];
+static void exec_ins_8XY0(oc8_emu_ctx_t *ctx) {
+  oc8_emu_cpu_t *cpu = ctx->cpu;
+  unsigned vx = cpu->curr_ins.operands[0];
+  unsigned vy = cpu->curr_ins.operands[1];
 
-  g_oc8_emu_cpu.regs_data[vx] = g_oc8_emu_cpu.regs_data[vy];
-  g_oc8_emu_cpu.reg_pc += OPCODE_SIZE;
+  cpu->regs_data[vx] = cpu->regs_data[vy];
+  cpu->reg_pc += OPCODE_SIZE;
 }
 
-static void exec_ins_8XY1() {
-  unsigned vx = g_oc8_emu_cpu.curr_ins.operands[0];
-  unsigned vy = g_oc8_emu_cpu.curr_ins.operands[1];
+static void exec_ins_8XY1(oc8_emu_ctx_t *ctx) {
+  oc8_emu_cpu_t *cpu = ctx->cpu;
+  unsigned vx = cpu->curr_ins.operands[0];
+  unsigned vy = cpu->curr_ins.operands[1];
 
-  g_oc8_emu_cpu.regs_data[vx] |= g_oc8_emu_cpu.regs_data[vy];
-  g_oc8_emu_cpu.reg_pc += OPCODE_SIZE;
+  cpu->regs_data[vx] |= cpu->regs_data[vy];
+  cpu->reg_pc += OPCODE_SIZE;
 }
 
-static void exec_ins_8XY2() {
-  unsigned vx = g_oc8_emu_cpu.curr_ins.operands[0];
-  unsigned vy = g_oc8_emu_cpu.curr_ins.operands[1];
+static void exec_ins_8XY2(oc8_emu_ctx_t *ctx) {
+  oc8_emu_cpu_t *cpu = ctx->cpu;
+  unsigned vx = cpu->curr_ins.operands[0];
+  unsigned vy = cpu->curr_ins.operands[1];
 
-  g_oc8_emu_cpu.regs_data[vx] &= g_oc8_emu_cpu.regs_data[vy];
-  g_oc8_emu_cpu.reg_pc += OPCODE_SIZE;
+  cpu->regs_data[vx] &= cpu->regs_data[vy];
+  cpu->reg_pc += OPCODE_SIZE;
 }
 
-static void exec_ins_8XY3() {
-  unsigned vx = g_oc8_emu_cpu.curr_ins.operands[0];
-  unsigned vy = g_oc8_emu_cpu.curr_ins.operands[1];
+static void exec_ins_8XY3(oc8_emu_ctx_t *ctx) {
+  oc8_emu_cpu_t *cpu = ctx->cpu;
+  unsigned vx = cpu->curr_ins.operands[0];
+  unsigned vy = cpu->curr_ins.operands[1];
 
-  g_oc8_emu_cpu.regs_data[vx] ^= g_oc8_emu_cpu.regs_data[vy];
-  g_oc8_emu_cpu.reg_pc += OPCODE_SIZE;
+  cpu->regs_data[vx] ^= cpu->regs_data[vy];
+  cpu->reg_pc += OPCODE_SIZE;
 }
 
-static void exec_ins_8XY4() {
-  unsigned vx = g_oc8_emu_cpu.curr_ins.operands[0];
-  unsigned vy = g_oc8_emu_cpu.curr_ins.operands[1];
+static void exec_ins_8XY4(oc8_emu_ctx_t *ctx) {
+  oc8_emu_cpu_t *cpu = ctx->cpu;
+  unsigned vx = cpu->curr_ins.operands[0];
+  unsigned vy = cpu->curr_ins.operands[1];
 
-  g_oc8_emu_cpu.regs_data[OC8_EMU_REG_FLAG] =
-      (unsigned)g_oc8_emu_cpu.regs_data[vx] +
-          (unsigned)g_oc8_emu_cpu.regs_data[vy] >
-      255;
-  g_oc8_emu_cpu.regs_data[vx] += g_oc8_emu_cpu.regs_data[vy];
-  g_oc8_emu_cpu.reg_pc += OPCODE_SIZE;
+  cpu->regs_data[OC8_EMU_REG_FLAG] =
+      (unsigned)cpu->regs_data[vx] + (unsigned)cpu->regs_data[vy] > 255;
+  cpu->regs_data[vx] += cpu->regs_data[vy];
+  cpu->reg_pc += OPCODE_SIZE;
 }
 
-static void exec_ins_8XY5() {
-  unsigned vx = g_oc8_emu_cpu.curr_ins.operands[0];
-  unsigned vy = g_oc8_emu_cpu.curr_ins.operands[1];
+static void exec_ins_8XY5(oc8_emu_ctx_t *ctx) {
+  oc8_emu_cpu_t *cpu = ctx->cpu;
+  unsigned vx = cpu->curr_ins.operands[0];
+  unsigned vy = cpu->curr_ins.operands[1];
 
-  g_oc8_emu_cpu.regs_data[OC8_EMU_REG_FLAG] =
-      g_oc8_emu_cpu.regs_data[vx] > g_oc8_emu_cpu.regs_data[vy];
-  g_oc8_emu_cpu.regs_data[vx] -= g_oc8_emu_cpu.regs_data[vy];
-  g_oc8_emu_cpu.reg_pc += OPCODE_SIZE;
+  cpu->regs_data[OC8_EMU_REG_FLAG] = cpu->regs_data[vx] > cpu->regs_data[vy];
+  cpu->regs_data[vx] -= cpu->regs_data[vy];
+  cpu->reg_pc += OPCODE_SIZE;
 }
 
-static void exec_ins_8XY6() {
-  unsigned vx = g_oc8_emu_cpu.curr_ins.operands[0];
-  unsigned vy = g_oc8_emu_cpu.curr_ins.operands[1];
+static void exec_ins_8XY6(oc8_emu_ctx_t *ctx) {
+  oc8_emu_cpu_t *cpu = ctx->cpu;
+  unsigned vx = cpu->curr_ins.operands[0];
+  unsigned vy = cpu->curr_ins.operands[1];
 
-  g_oc8_emu_cpu.regs_data[OC8_EMU_REG_FLAG] = g_oc8_emu_cpu.regs_data[vy] & 0x1;
-  g_oc8_emu_cpu.regs_data[vx] = g_oc8_emu_cpu.regs_data[vy] >> 1;
-  g_oc8_emu_cpu.reg_pc += OPCODE_SIZE;
+  cpu->regs_data[OC8_EMU_REG_FLAG] = cpu->regs_data[vy] & 0x1;
+  cpu->regs_data[vx] = cpu->regs_data[vy] >> 1;
+  cpu->reg_pc += OPCODE_SIZE;
 }
 
-static void exec_ins_8XY7() {
-  unsigned vx = g_oc8_emu_cpu.curr_ins.operands[0];
-  unsigned vy = g_oc8_emu_cpu.curr_ins.operands[1];
+static void exec_ins_8XY7(oc8_emu_ctx_t *ctx) {
+  oc8_emu_cpu_t *cpu = ctx->cpu;
+  unsigned vx = cpu->curr_ins.operands[0];
+  unsigned vy = cpu->curr_ins.operands[1];
 
-  g_oc8_emu_cpu.regs_data[OC8_EMU_REG_FLAG] =
-      g_oc8_emu_cpu.regs_data[vy] > g_oc8_emu_cpu.regs_data[vx];
-  g_oc8_emu_cpu.regs_data[vx] =
-      g_oc8_emu_cpu.regs_data[vy] - g_oc8_emu_cpu.regs_data[vx];
-  g_oc8_emu_cpu.reg_pc += OPCODE_SIZE;
+  cpu->regs_data[OC8_EMU_REG_FLAG] = cpu->regs_data[vy] > cpu->regs_data[vx];
+  cpu->regs_data[vx] = cpu->regs_data[vy] - cpu->regs_data[vx];
+  cpu->reg_pc += OPCODE_SIZE;
 }
 
-static void exec_ins_8XYE() {
-  unsigned vx = g_oc8_emu_cpu.curr_ins.operands[0];
-  unsigned vy = g_oc8_emu_cpu.curr_ins.operands[1];
+static void exec_ins_8XYE(oc8_emu_ctx_t *ctx) {
+  oc8_emu_cpu_t *cpu = ctx->cpu;
+  unsigned vx = cpu->curr_ins.operands[0];
+  unsigned vy = cpu->curr_ins.operands[1];
 
-  g_oc8_emu_cpu.regs_data[OC8_EMU_REG_FLAG] =
-      g_oc8_emu_cpu.regs_data[vy] & 0x80 ? 1 : 0;
-  g_oc8_emu_cpu.regs_data[vx] = g_oc8_emu_cpu.regs_data[vy] << 1;
-  g_oc8_emu_cpu.reg_pc += OPCODE_SIZE;
+  cpu->regs_data[OC8_EMU_REG_FLAG] = cpu->regs_data[vy] & 0x80 ? 1 : 0;
+  cpu->regs_data[vx] = cpu->regs_data[vy] << 1;
+  cpu->reg_pc += OPCODE_SIZE;
 }
 
-static void exec_ins_9XY0() {
-  unsigned vx = g_oc8_emu_cpu.curr_ins.operands[0];
-  unsigned vy = g_oc8_emu_cpu.curr_ins.operands[1];
+static void exec_ins_9XY0(oc8_emu_ctx_t *ctx) {
+  oc8_emu_cpu_t *cpu = ctx->cpu;
+  unsigned vx = cpu->curr_ins.operands[0];
+  unsigned vy = cpu->curr_ins.operands[1];
 
-  if (g_oc8_emu_cpu.regs_data[vx] != g_oc8_emu_cpu.regs_data[vy])
-    g_oc8_emu_cpu.reg_pc += 2 * OPCODE_SIZE;
+  if (cpu->regs_data[vx] != cpu->regs_data[vy])
+    cpu->reg_pc += 2 * OPCODE_SIZE;
   else
-    g_oc8_emu_cpu.reg_pc += OPCODE_SIZE;
+    cpu->reg_pc += OPCODE_SIZE;
 }
 
-static void exec_ins_ANNN() {
-  unsigned addr = g_oc8_emu_cpu.curr_ins.operands[0] & 0xFFF;
-  g_oc8_emu_cpu.reg_i = addr;
-  g_oc8_emu_cpu.reg_pc += OPCODE_SIZE;
+static void exec_ins_ANNN(oc8_emu_ctx_t *ctx) {
+  oc8_emu_cpu_t *cpu = ctx->cpu;
+  unsigned addr = cpu->curr_ins.operands[0] & 0xFFF;
+  cpu->reg_i = addr;
+  cpu->reg_pc += OPCODE_SIZE;
 }
 
-static void exec_ins_BNNN() {
-  unsigned addr = g_oc8_emu_cpu.curr_ins.operands[0] & 0xFFF;
-  unsigned new_pc = g_oc8_emu_cpu.regs_data[0] + addr;
+static void exec_ins_BNNN(oc8_emu_ctx_t *ctx) {
+  oc8_emu_cpu_t *cpu = ctx->cpu;
+  unsigned addr = cpu->curr_ins.operands[0] & 0xFFF;
+  unsigned new_pc = cpu->regs_data[0] + addr;
   if (new_pc >= 4096)
     fprintf(stderr, "Warning: pc overflows when executing BNNN: %u\n", new_pc);
 
-  g_oc8_emu_cpu.reg_pc = new_pc & 0xFFF;
+  cpu->reg_pc = new_pc & 0xFFF;
 }
 
-static void exec_ins_CXNN() {
-  unsigned vx = g_oc8_emu_cpu.curr_ins.operands[0];
-  unsigned imm = g_oc8_emu_cpu.curr_ins.operands[1];
+static void exec_ins_CXNN(oc8_emu_ctx_t *ctx) {
+  oc8_emu_cpu_t *cpu = ctx->cpu;
+  unsigned vx = cpu->curr_ins.operands[0];
+  unsigned imm = cpu->curr_ins.operands[1];
 
-  g_oc8_emu_cpu.rg_seed = g_oc8_emu_cpu.rg_seed * 1103515245 + 12345;
-  g_oc8_emu_cpu.regs_data[vx] = (g_oc8_emu_cpu.rg_seed / 65536) % imm;
-  g_oc8_emu_cpu.reg_pc += OPCODE_SIZE;
+  cpu->rg_seed = cpu->rg_seed * 1103515245 + 12345;
+  cpu->regs_data[vx] = (cpu->rg_seed / 65536) % imm;
+  cpu->reg_pc += OPCODE_SIZE;
 }
 
-static void exec_ins_DXYN() {
-  unsigned vx = g_oc8_emu_cpu.curr_ins.operands[0];
-  unsigned vy = g_oc8_emu_cpu.curr_ins.operands[1];
-  unsigned x0 = g_oc8_emu_cpu.regs_data[vx] % OC8_EMU_SCREEN_WIDTH;
-  unsigned y0 = g_oc8_emu_cpu.regs_data[vy] % OC8_EMU_SCREEN_HEIGHT;
+static void exec_ins_DXYN(oc8_emu_ctx_t *ctx) {
+  oc8_emu_cpu_t *cpu = ctx->cpu;
+  unsigned vx = cpu->curr_ins.operands[0];
+  unsigned vy = cpu->curr_ins.operands[1];
+  unsigned x0 = cpu->regs_data[vx] % OC8_EMU_SCREEN_WIDTH;
+  unsigned y0 = cpu->regs_data[vy] % OC8_EMU_SCREEN_HEIGHT;
   unsigned w = 8;
-  unsigned h = g_oc8_emu_cpu.curr_ins.operands[2];
-  unsigned addr = g_oc8_emu_cpu.reg_i;
+  unsigned h = cpu->curr_ins.operands[2];
+  unsigned addr = cpu->reg_i;
   unsigned vf = 0;
 
   for (unsigned y = 0; y < h && y + y0 < OC8_EMU_SCREEN_HEIGHT; ++y) {
-    unsigned hline = g_oc8_emu_mem.ram[addr++];
+    unsigned hline = oc8_emu_ctx_read(ctx, addr++);
     for (unsigned x = 0; x < w && x + x0 < OC8_EMU_SCREEN_WIDTH; ++x) {
       if ((hline & (0x1 << (7 - x))) == 0)
         continue;
 
-      int old_val = oc8_emu_screen_get_pix(x + x0, y + y0);
-      oc8_emu_screen_set_pix(x + x0, y + y0, !old_val);
+      int old_val = oc8_emu_screen_buf_get_pix(ctx->screen, x + x0, y + y0);
+      oc8_emu_screen_buf_set_pix(ctx->screen, x + x0, y + y0, !old_val);
       if (old_val)
         vf = 1;
     }
   }
 
-  g_oc8_emu_cpu.screen_changed = 1;
-  g_oc8_emu_cpu.regs_data[OC8_EMU_REG_FLAG] = vf;
-  g_oc8_emu_cpu.reg_pc += OPCODE_SIZE;
+  cpu->screen_changed = 1;
+  cpu->regs_data[OC8_EMU_REG_FLAG] = vf;
+  cpu->reg_pc += OPCODE_SIZE;
 }
 
-static void exec_ins_EX9E() {
-  unsigned vx = g_oc8_emu_cpu.curr_ins.operands[0];
-  unsigned key = g_oc8_emu_cpu.regs_data[vx];
+static void exec_ins_EX9E(oc8_emu_ctx_t *ctx) {
+  oc8_emu_cpu_t *cpu = ctx->cpu;
+  unsigned vx = cpu->curr_ins.operands[0];
+  unsigned key = cpu->regs_data[vx];
 
-  if (g_oc8_emu_keypad[key])
-    g_oc8_emu_cpu.reg_pc += 2 * OPCODE_SIZE;
+  if (ctx->keypad[key])
+    cpu->reg_pc += 2 * OPCODE_SIZE;
   else
-    g_oc8_emu_cpu.reg_pc += OPCODE_SIZE;
+    cpu->reg_pc += OPCODE_SIZE;
 }
 
-static void exec_ins_EXA1() {
-  unsigned vx = g_oc8_emu_cpu.curr_ins.operands[0];
-  unsigned key = g_oc8_emu_cpu.regs_data[vx];
+static void exec_ins_EXA1(oc8_emu_ctx_t *ctx) {
+  oc8_emu_cpu_t *cpu = ctx->cpu;
+  unsigned vx = cpu->curr_ins.operands[0];
+  unsigned key = cpu->regs_data[vx];
 
-  if (!g_oc8_emu_keypad[key])
-    g_oc8_emu_cpu.reg_pc += 2 * OPCODE_SIZE;
+  if (!ctx->keypad[key])
+    cpu->reg_pc += 2 * OPCODE_SIZE;
   else
-    g_oc8_emu_cpu.reg_pc += OPCODE_SIZE;
+    cpu->reg_pc += OPCODE_SIZE;
 }
 
-static void exec_ins_FX07() {
-  unsigned vx = g_oc8_emu_cpu.curr_ins.operands[0];
-  g_oc8_emu_cpu.regs_data[vx] = g_oc8_emu_cpu.reg_dt;
-  g_oc8_emu_cpu.reg_pc += OPCODE_SIZE;
+static void exec_ins_FX07(oc8_emu_ctx_t *ctx) {
+  oc8_emu_cpu_t *cpu = ctx->cpu;
+  unsigned vx = cpu->curr_ins.operands[0];
+  cpu->regs_data[vx] = cpu->reg_dt;
+  cpu->reg_pc += OPCODE_SIZE;
 }
 
-static int get_keypress() {
+static int get_keypress(oc8_emu_ctx_t *ctx) {
   for (int i = 0; i < OC8_EMU_NB_KEYS; ++i)
-    if (g_oc8_emu_keypad[i])
+    if (ctx->keypad[i])
       return i;
   return -1;
 }
 
-static void exec_ins_FX0A() {
-  int key = get_keypress();
+static void exec_ins_FX0A(oc8_emu_ctx_t *ctx) {
+  oc8_emu_cpu_t *cpu = ctx->cpu;
+  int key = get_keypress(ctx);
   if (key == -1) {
-    g_oc8_emu_cpu.block_waitq = 1;
+    cpu->block_waitq = 1;
     return;
   }
 
-  unsigned vx = g_oc8_emu_cpu.curr_ins.operands[0];
-  g_oc8_emu_cpu.regs_data[vx] = (uint8_t)key;
-  g_oc8_emu_cpu.reg_pc += OPCODE_SIZE;
+  unsigned vx = cpu->curr_ins.operands[0];
+  cpu->regs_data[vx] = (uint8_t)key;
+  cpu->reg_pc += OPCODE_SIZE;
 }
 
-static void exec_ins_FX15() {
-  unsigned vx = g_oc8_emu_cpu.curr_ins.operands[0];
-  g_oc8_emu_cpu.reg_dt = g_oc8_emu_cpu.regs_data[vx];
-  g_oc8_emu_cpu.reg_pc += OPCODE_SIZE;
+static void exec_ins_FX15(oc8_emu_ctx_t *ctx) {
+  oc8_emu_cpu_t *cpu = ctx->cpu;
+  unsigned vx = cpu->curr_ins.operands[0];
+  cpu->reg_dt = cpu->regs_data[vx];
+  cpu->reg_pc += OPCODE_SIZE;
 }
 
-static void exec_ins_FX18() {
-  unsigned vx = g_oc8_emu_cpu.curr_ins.operands[0];
-  g_oc8_emu_cpu.reg_st = g_oc8_emu_cpu.regs_data[vx];
-  g_oc8_emu_cpu.reg_pc += OPCODE_SIZE;
+static void exec_ins_FX18(oc8_emu_ctx_t *ctx) {
+  oc8_emu_cpu_t *cpu = ctx->cpu;
+  unsigned vx = cpu->curr_ins.operands[0];
+  cpu->reg_st = cpu->regs_data[vx];
+  cpu->reg_pc += OPCODE_SIZE;
 }
 
-static void exec_ins_FX1E() {
-  unsigned vx = g_oc8_emu_cpu.curr_ins.operands[0];
-  g_oc8_emu_cpu.reg_i =
-      (g_oc8_emu_cpu.reg_i + g_oc8_emu_cpu.regs_data[vx]) & 0xFFF;
-  g_oc8_emu_cpu.reg_pc += OPCODE_SIZE;
+static void exec_ins_FX1E(oc8_emu_ctx_t *ctx) {
+  oc8_emu_cpu_t *cpu = ctx->cpu;
+  unsigned vx = cpu->curr_ins.operands[0];
+  cpu->reg_i = (cpu->reg_i + cpu->regs_data[vx]) & 0xFFF;
+  cpu->reg_pc += OPCODE_SIZE;
 }
 
-static void exec_ins_FX29() {
-  unsigned vx = g_oc8_emu_cpu.curr_ins.operands[0];
-  unsigned digit = g_oc8_emu_cpu.regs_data[vx] & 0xF;
-  g_oc8_emu_cpu.reg_i = OC8_EMU_FONT_HEXA_ADDR + 5 * digit;
-  g_oc8_emu_cpu.reg_pc += OPCODE_SIZE;
+static void exec_ins_FX29(oc8_emu_ctx_t *ctx) {
+  oc8_emu_cpu_t *cpu = ctx->cpu;
+  unsigned vx = cpu->curr_ins.operands[0];
+  unsigned digit = cpu->regs_data[vx] & 0xF;
+  cpu->reg_i = OC8_EMU_FONT_HEXA_ADDR + 5 * digit;
+  cpu->reg_pc += OPCODE_SIZE;
 }
 
-static void exec_ins_FX33() {
-  unsigned vx = g_oc8_emu_cpu.curr_ins.operands[0];
-  unsigned i = g_oc8_emu_cpu.reg_i;
-  unsigned val = g_oc8_emu_cpu.regs_data[vx];
+static void exec_ins_FX33(oc8_emu_ctx_t *ctx) {
+  oc8_emu_cpu_t *cpu = ctx->cpu;
+  unsigned vx = cpu->curr_ins.operands[0];
+  unsigned i = cpu->reg_i;
+  unsigned val = cpu->regs_data[vx];
 
-  g_oc8_emu_mem.ram[i + 0] = val / 100;
-  g_oc8_emu_mem.ram[i + 1] = (val % 100) / 10;
-  g_oc8_emu_mem.ram[i + 2] = val % 10;
-  g_oc8_emu_cpu.reg_pc += OPCODE_SIZE;
+  oc8_emu_ctx_write(ctx, i + 0, val / 100);
+  oc8_emu_ctx_write(ctx, i + 1, (val % 100) / 10);
+  oc8_emu_ctx_write(ctx, i + 2, val % 10);
+  cpu->reg_pc += OPCODE_SIZE;
 }
 
-static void exec_ins_FX55() {
-  unsigned vx = g_oc8_emu_cpu.curr_ins.operands[0];
-  unsigned i = g_oc8_emu_cpu.reg_i;
+static void exec_ins_FX55(oc8_emu_ctx_t *ctx) {
+  oc8_emu_cpu_t *cpu = ctx->cpu;
+  unsigned vx = cpu->curr_ins.operands[0];
+  unsigned i = cpu->reg_i;
 
   for (unsigned vi = 0; vi <= vx; ++vi)
-    g_oc8_emu_mem.ram[i + vi] = g_oc8_emu_cpu.regs_data[vi];
+    oc8_emu_ctx_write(ctx, i + vi, cpu->regs_data[vi]);
 
-  g_oc8_emu_cpu.reg_i += vx + 1;
-  g_oc8_emu_cpu.reg_pc += OPCODE_SIZE;
+  cpu->reg_i += vx + 1;
+  cpu->reg_pc += OPCODE_SIZE;
 }
 
-static void exec_ins_FX65() {
-  unsigned vx = g_oc8_emu_cpu.curr_ins.operands[0];
-  unsigned i = g_oc8_emu_cpu.reg_i;
+static void exec_ins_FX65(oc8_emu_ctx_t *ctx) {
+  oc8_emu_cpu_t *cpu = ctx->cpu;
+  unsigned vx = cpu->curr_ins.operands[0];
+  unsigned i = cpu->reg_i;
 
   for (unsigned vi = 0; vi <= vx; ++vi)
-    g_oc8_emu_cpu.regs_data[vi] = g_oc8_emu_mem.ram[i + vi];
+    cpu->regs_data[vi] = oc8_emu_ctx_read(ctx, i + vi);
 
-  g_oc8_emu_cpu.reg_i += vx + 1;
-  g_oc8_emu_cpu.reg_pc += OPCODE_SIZE;
+  cpu->reg_i += vx + 1;
+  cpu->reg_pc += OPCODE_SIZE;
 }
 
-void oc8_emu_exec_ins() {
-  switch (g_oc8_emu_cpu.curr_ins.type) {
+void oc8_emu_exec_ins(oc8_emu_ctx_t *ctx) {
+  switch (ctx->cpu->curr_ins.type) {
   case OC8_IS_TYPE_0NNN:
-    exec_ins_0NNN();
+    exec_ins_0NNN(ctx);
     break;
   case OC8_IS_TYPE_00E0:
-    exec_ins_00E0();
+    exec_ins_00E0(ctx);
     break;
   case OC8_IS_TYPE_00EE:
-    exec_ins_00EE();
+    exec_ins_00EE(ctx);
     break;
   case OC8_IS_TYPE_1NNN:
-    exec_ins_1NNN();
+    exec_ins_1NNN(ctx);
     break;
   case OC8_IS_TYPE_2NNN:
-    exec_ins_2NNN();
+    exec_ins_2NNN(ctx);
     break;
   case OC8_IS_TYPE_3XNN:
-    exec_ins_3XNN();
+    exec_ins_3XNN(ctx);
     break;
   case OC8_IS_TYPE_4XNN:
-    exec_ins_4XNN();
+    exec_ins_4XNN(ctx);
     break;
   case OC8_IS_TYPE_5XY0:
-    exec_ins_5XY0();
+    exec_ins_5XY0(ctx);
     break;
   case OC8_IS_TYPE_6XNN:
-    exec_ins_6XNN();
+    exec_ins_6XNN(ctx);
     break;
   case OC8_IS_TYPE_7XNN:
-    exec_ins_7XNN();
+    exec_ins_7XNN(ctx);
     break;
   case OC8_IS_TYPE_8XY0:
-    exec_ins_8XY0();
+    exec_ins_8XY0(ctx);
     break;
   case OC8_IS_TYPE_8XY1:
-    exec_ins_8XY1();
+    exec_ins_8XY1(ctx);
     break;
   case OC8_IS_TYPE_8XY2:
-    exec_ins_8XY2();
+    exec_ins_8XY2(ctx);
     break;
   case OC8_IS_TYPE_8XY3:
-    exec_ins_8XY3();
+    exec_ins_8XY3(ctx);
     break;
   case OC8_IS_TYPE_8XY4:
-    exec_ins_8XY4();
+    exec_ins_8XY4(ctx);
     break;
   case OC8_IS_TYPE_8XY5:
-    exec_ins_8XY5();
+    exec_ins_8XY5(ctx);
     break;
   case OC8_IS_TYPE_8XY6:
-    exec_ins_8XY6();
+    exec_ins_8XY6(ctx);
     break;
   case OC8_IS_TYPE_8XY7:
-    exec_ins_8XY7();
+    exec_ins_8XY7(ctx);
     break;
   case OC8_IS_TYPE_8XYE:
-    exec_ins_8XYE();
+    exec_ins_8XYE(ctx);
     break;
   case OC8_IS_TYPE_9XY0:
-    exec_ins_9XY0();
+    exec_ins_9XY0(ctx);
     break;
   case OC8_IS_TYPE_ANNN:
-    exec_ins_ANNN();
+    exec_ins_ANNN(ctx);
     break;
   case OC8_IS_TYPE_BNNN:
-    exec_ins_BNNN();
+    exec_ins_BNNN(ctx);
     break;
   case OC8_IS_TYPE_CXNN:
-    exec_ins_CXNN();
+    exec_ins_CXNN(ctx);
     break;
   case OC8_IS_TYPE_DXYN:
-    exec_ins_DXYN();
+    exec_ins_DXYN(ctx);
     break;
   case OC8_IS_TYPE_EX9E:
-    exec_ins_EX9E();
+    exec_ins_EX9E(ctx);
     break;
   case OC8_IS_TYPE_EXA1:
-    exec_ins_EXA1();
+    exec_ins_EXA1(ctx);
     break;
   case OC8_IS_TYPE_FX07:
-    exec_ins_FX07();
+    exec_ins_FX07(ctx);
     break;
   case OC8_IS_TYPE_FX0A:
-    exec_ins_FX0A();
+    exec_ins_FX0A(ctx);
     break;
   case OC8_IS_TYPE_FX15:
-    exec_ins_FX15();
+    exec_ins_FX15(ctx);
     break;
   case OC8_IS_TYPE_FX18:
-    exec_ins_FX18();
+    exec_ins_FX18(ctx);
     break;
   case OC8_IS_TYPE_FX1E:
-    exec_ins_FX1E();
+    exec_ins_FX1E(ctx);
     break;
   case OC8_IS_TYPE_FX29:
-    exec_ins_FX29();
+    exec_ins_FX29(ctx);
     break;
   case OC8_IS_TYPE_FX33:
-    exec_ins_FX33();
+    exec_ins_FX33(ctx);
     break;
   case OC8_IS_TYPE_FX55:
-    exec_ins_FX55();
+    exec_ins_FX55(ctx);
     break;
   case OC8_IS_TYPE_FX65:
-    exec_ins_FX65();
+    exec_ins_FX65(ctx);
     break;
 
   default:
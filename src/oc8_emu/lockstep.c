@@ -0,0 +1,796 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "oc8_emu/lockstep.h"
+#include "oc8_emu/ctx.h"
+#include "oc8_emu/rom_cache.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define CACHE_LINE (64)
+#define OPCODE_SIZE (2)
+#define DEFAULT_CPU_SPEED (500)
+#define FRAMES_PER_SEC (60)
+#define MAX_BUDGET (0xFFFF)
+
+// Unused PC value when looking for the lowest PC, > any valid PC
+#define NO_PC (0x7FFF)
+
+#define ALIGN_UP(X) (((X) + CACHE_LINE - 1) & ~(size_t)(CACHE_LINE - 1))
+
+//===----------------------------------------------------------------------===//
+// Vector operations
+//
+// A vector holds VL 8-bit lanes, or VL/2 16-bit lanes
+// Masks are 0xFF / 0xFFFF for selected lanes, 0 otherwhise
+// A block is VL machines: one vector for 8-bit registers, and 2 vectors for
+// 16-bit registers (lo for the first VL/2 machines, hi for the others)
+//===----------------------------------------------------------------------===//
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+
+#define VL (32)
+typedef __m256i vec_t;
+
+static inline vec_t v_load(const void *p) {
+  return _mm256_load_si256((const vec_t *)p);
+}
+static inline void v_store(void *p, vec_t v) {
+  _mm256_store_si256((vec_t *)p, v);
+}
+static inline vec_t v_and(vec_t a, vec_t b) { return _mm256_and_si256(a, b); }
+static inline vec_t v_or(vec_t a, vec_t b) { return _mm256_or_si256(a, b); }
+static inline vec_t v_xor(vec_t a, vec_t b) { return _mm256_xor_si256(a, b); }
+// ~a & b
+static inline vec_t v_andnot(vec_t a, vec_t b) {
+  return _mm256_andnot_si256(a, b);
+}
+static inline vec_t v8_set1(uint8_t x) { return _mm256_set1_epi8((char)x); }
+static inline vec_t v8_add(vec_t a, vec_t b) { return _mm256_add_epi8(a, b); }
+static inline vec_t v8_sub(vec_t a, vec_t b) { return _mm256_sub_epi8(a, b); }
+static inline vec_t v8_subs(vec_t a, vec_t b) { return _mm256_subs_epu8(a, b); }
+static inline vec_t v8_max(vec_t a, vec_t b) { return _mm256_max_epu8(a, b); }
+static inline vec_t v8_cmpeq(vec_t a, vec_t b) {
+  return _mm256_cmpeq_epi8(a, b);
+}
+static inline vec_t v8_srl1(vec_t v) {
+  return _mm256_and_si256(_mm256_srli_epi16(v, 1), v8_set1(0x7F));
+}
+static inline vec_t v8_srl7(vec_t v) {
+  return _mm256_and_si256(_mm256_srli_epi16(v, 7), v8_set1(0x01));
+}
+static inline uint32_t v8_movemask(vec_t m) {
+  return (uint32_t)_mm256_movemask_epi8(m);
+}
+static inline vec_t v16_set1(uint16_t x) {
+  return _mm256_set1_epi16((short)x);
+}
+static inline vec_t v16_add(vec_t a, vec_t b) { return _mm256_add_epi16(a, b); }
+static inline vec_t v16_min(vec_t a, vec_t b) { return _mm256_min_epi16(a, b); }
+static inline vec_t v16_cmpeq(vec_t a, vec_t b) {
+  return _mm256_cmpeq_epi16(a, b);
+}
+// Zero-extend the 8-bit lanes of the first / second half to 16-bit
+static inline vec_t v8_lo16(vec_t v) {
+  return _mm256_cvtepu8_epi16(_mm256_castsi256_si128(v));
+}
+static inline vec_t v8_hi16(vec_t v) {
+  return _mm256_cvtepu8_epi16(_mm256_extracti128_si256(v, 1));
+}
+// Extend a 8-bit mask of the first / second half to 16-bit
+static inline vec_t m8_lo16(vec_t m) {
+  return _mm256_cvtepi8_epi16(_mm256_castsi256_si128(m));
+}
+static inline vec_t m8_hi16(vec_t m) {
+  return _mm256_cvtepi8_epi16(_mm256_extracti128_si256(m, 1));
+}
+// Narrow two 16-bit masks to one 8-bit mask
+static inline vec_t m16_pack8(vec_t lo, vec_t hi) {
+  return _mm256_permute4x64_epi64(_mm256_packs_epi16(lo, hi), 0xD8);
+}
+
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+
+#define VL (16)
+typedef __m128i vec_t;
+
+static inline vec_t v_load(const void *p) {
+  return _mm_load_si128((const vec_t *)p);
+}
+static inline void v_store(void *p, vec_t v) { _mm_store_si128((vec_t *)p, v); }
+static inline vec_t v_and(vec_t a, vec_t b) { return _mm_and_si128(a, b); }
+static inline vec_t v_or(vec_t a, vec_t b) { return _mm_or_si128(a, b); }
+static inline vec_t v_xor(vec_t a, vec_t b) { return _mm_xor_si128(a, b); }
+// ~a & b
+static inline vec_t v_andnot(vec_t a, vec_t b) {
+  return _mm_andnot_si128(a, b);
+}
+static inline vec_t v8_set1(uint8_t x) { return _mm_set1_epi8((char)x); }
+static inline vec_t v8_add(vec_t a, vec_t b) { return _mm_add_epi8(a, b); }
+static inline vec_t v8_sub(vec_t a, vec_t b) { return _mm_sub_epi8(a, b); }
+static inline vec_t v8_subs(vec_t a, vec_t b) { return _mm_subs_epu8(a, b); }
+static inline vec_t v8_max(vec_t a, vec_t b) { return _mm_max_epu8(a, b); }
+static inline vec_t v8_cmpeq(vec_t a, vec_t b) { return _mm_cmpeq_epi8(a, b); }
+static inline vec_t v8_srl1(vec_t v) {
+  return _mm_and_si128(_mm_srli_epi16(v, 1), v8_set1(0x7F));
+}
+static inline vec_t v8_srl7(vec_t v) {
+  return _mm_and_si128(_mm_srli_epi16(v, 7), v8_set1(0x01));
+}
+static inline uint32_t v8_movemask(vec_t m) {
+  return (uint32_t)_mm_movemask_epi8(m);
+}
+static inline vec_t v16_set1(uint16_t x) { return _mm_set1_epi16((short)x); }
+static inline vec_t v16_add(vec_t a, vec_t b) { return _mm_add_epi16(a, b); }
+static inline vec_t v16_min(vec_t a, vec_t b) { return _mm_min_epi16(a, b); }
+static inline vec_t v16_cmpeq(vec_t a, vec_t b) {
+  return _mm_cmpeq_epi16(a, b);
+}
+// Zero-extend the 8-bit lanes of the first / second half to 16-bit
+static inline vec_t v8_lo16(vec_t v) {
+  return _mm_unpacklo_epi8(v, _mm_setzero_si128());
+}
+static inline vec_t v8_hi16(vec_t v) {
+  return _mm_unpackhi_epi8(v, _mm_setzero_si128());
+}
+// Extend a 8-bit mask of the first / second half to 16-bit
+static inline vec_t m8_lo16(vec_t m) { return _mm_unpacklo_epi8(m, m); }
+static inline vec_t m8_hi16(vec_t m) { return _mm_unpackhi_epi8(m, m); }
+// Narrow two 16-bit masks to one 8-bit mask
+static inline vec_t m16_pack8(vec_t lo, vec_t hi) {
+  return _mm_packs_epi16(lo, hi);
+}
+
+#else
+// Portable version, same semantics without intrinsics
+
+#define VL (16)
+typedef union {
+  uint8_t b[VL];
+  uint16_t w[VL / 2];
+} vec_t;
+
+#define V8_MAP(EXPR)                                                           \
+  vec_t r;                                                                     \
+  for (int i = 0; i < VL; ++i)                                                 \
+    r.b[i] = (uint8_t)(EXPR);                                                  \
+  return r
+#define V16_MAP(EXPR)                                                          \
+  vec_t r;                                                                     \
+  for (int i = 0; i < VL / 2; ++i)                                             \
+    r.w[i] = (uint16_t)(EXPR);                                                 \
+  return r
+
+static inline vec_t v_load(const void *p) {
+  vec_t r;
+  memcpy(&r, p, sizeof(r));
+  return r;
+}
+static inline void v_store(void *p, vec_t v) { memcpy(p, &v, sizeof(v)); }
+static inline vec_t v_and(vec_t a, vec_t b) { V8_MAP(a.b[i] & b.b[i]); }
+static inline vec_t v_or(vec_t a, vec_t b) { V8_MAP(a.b[i] | b.b[i]); }
+static inline vec_t v_xor(vec_t a, vec_t b) { V8_MAP(a.b[i] ^ b.b[i]); }
+// ~a & b
+static inline vec_t v_andnot(vec_t a, vec_t b) { V8_MAP(~a.b[i] & b.b[i]); }
+static inline vec_t v8_set1(uint8_t x) { V8_MAP(x); }
+static inline vec_t v8_add(vec_t a, vec_t b) { V8_MAP(a.b[i] + b.b[i]); }
+static inline vec_t v8_sub(vec_t a, vec_t b) { V8_MAP(a.b[i] - b.b[i]); }
+static inline vec_t v8_subs(vec_t a, vec_t b) {
+  V8_MAP(a.b[i] > b.b[i] ? a.b[i] - b.b[i] : 0);
+}
+static inline vec_t v8_max(vec_t a, vec_t b) {
+  V8_MAP(a.b[i] > b.b[i] ? a.b[i] : b.b[i]);
+}
+static inline vec_t v8_cmpeq(vec_t a, vec_t b) {
+  V8_MAP(a.b[i] == b.b[i] ? 0xFF : 0);
+}
+static inline vec_t v8_srl1(vec_t v) { V8_MAP(v.b[i] >> 1); }
+static inline vec_t v8_srl7(vec_t v) { V8_MAP(v.b[i] >> 7); }
+static inline uint32_t v8_movemask(vec_t m) {
+  uint32_t res = 0;
+  for (int i = 0; i < VL; ++i)
+    res |= (uint32_t)(m.b[i] >> 7) << i;
+  return res;
+}
+static inline vec_t v16_set1(uint16_t x) { V16_MAP(x); }
+static inline vec_t v16_add(vec_t a, vec_t b) { V16_MAP(a.w[i] + b.w[i]); }
+static inline vec_t v16_min(vec_t a, vec_t b) {
+  V16_MAP((int16_t)a.w[i] < (int16_t)b.w[i] ? a.w[i] : b.w[i]);
+}
+static inline vec_t v16_cmpeq(vec_t a, vec_t b) {
+  V16_MAP(a.w[i] == b.w[i] ? 0xFFFF : 0);
+}
+// Zero-extend the 8-bit lanes of the first / second half to 16-bit
+static inline vec_t v8_lo16(vec_t v) { V16_MAP(v.b[i]); }
+static inline vec_t v8_hi16(vec_t v) { V16_MAP(v.b[i + VL / 2]); }
+// Extend a 8-bit mask of the first / second half to 16-bit
+static inline vec_t m8_lo16(vec_t m) { V16_MAP(m.b[i] ? 0xFFFF : 0); }
+static inline vec_t m8_hi16(vec_t m) { V16_MAP(m.b[i + VL / 2] ? 0xFFFF : 0); }
+// Narrow two 16-bit masks to one 8-bit mask
+static inline vec_t m16_pack8(vec_t lo, vec_t hi) {
+  V8_MAP(i < VL / 2 ? (lo.w[i] ? 0xFF : 0) : (hi.w[i - VL / 2] ? 0xFF : 0));
+}
+
+#endif
+
+// Select b where m is set, a otherwhise
+static inline vec_t v_blend(vec_t a, vec_t b, vec_t m) {
+  return v_or(v_andnot(m, a), v_and(m, b));
+}
+
+// a > b for unsigned 8-bit lanes
+static inline vec_t v8_cmpgt(vec_t a, vec_t b) {
+  return v_xor(v8_cmpeq(v8_max(a, b), b), v8_set1(0xFF));
+}
+
+//===----------------------------------------------------------------------===//
+// Block operations
+//===----------------------------------------------------------------------===//
+
+// 16-bit registers of one block
+static inline void v16_blend_store(uint16_t *p, vec_t m, vec_t lo, vec_t hi) {
+  v_store(p, v_blend(v_load(p), lo, m8_lo16(m)));
+  v_store(p + VL / 2, v_blend(v_load(p + VL / 2), hi, m8_hi16(m)));
+}
+
+static inline void v8_blend_store(uint8_t *p, vec_t m, vec_t v) {
+  v_store(p, v_blend(v_load(p), v, m));
+}
+
+// Add an 8-bit increment to the PC of every machine of the block
+static inline void pc_add8(uint16_t *pc, vec_t inc) {
+  v_store(pc, v16_add(v_load(pc), v8_lo16(inc)));
+  v_store(pc + VL / 2, v16_add(v_load(pc + VL / 2), v8_hi16(inc)));
+}
+
+// Skip the next instruction if `cond` is set
+static inline void pc_skip_if(uint16_t *pc, vec_t m, vec_t cond) {
+  vec_t two = v8_set1(OPCODE_SIZE);
+  pc_add8(pc, v_and(m, v8_add(two, v_and(cond, two))));
+}
+
+static inline void pc_next(uint16_t *pc, vec_t m) {
+  pc_add8(pc, v_and(m, v8_set1(OPCODE_SIZE)));
+}
+
+static int is_vector_ins(oc8_is_type_t type) {
+  switch (type) {
+  case OC8_IS_TYPE_1NNN:
+  case OC8_IS_TYPE_3XNN:
+  case OC8_IS_TYPE_4XNN:
+  case OC8_IS_TYPE_5XY0:
+  case OC8_IS_TYPE_6XNN:
+  case OC8_IS_TYPE_7XNN:
+  case OC8_IS_TYPE_8XY0:
+  case OC8_IS_TYPE_8XY1:
+  case OC8_IS_TYPE_8XY2:
+  case OC8_IS_TYPE_8XY3:
+  case OC8_IS_TYPE_8XY4:
+  case OC8_IS_TYPE_8XY5:
+  case OC8_IS_TYPE_8XY6:
+  case OC8_IS_TYPE_8XY7:
+  case OC8_IS_TYPE_8XYE:
+  case OC8_IS_TYPE_9XY0:
+  case OC8_IS_TYPE_ANNN:
+  case OC8_IS_TYPE_FX07:
+  case OC8_IS_TYPE_FX15:
+  case OC8_IS_TYPE_FX18:
+  case OC8_IS_TYPE_FX1E:
+  case OC8_IS_TYPE_FX29:
+    return 1;
+  default:
+    return 0;
+  }
+}
+
+// Execute `ins` on the machines of block `off` selected by `m`
+// The registers are read again after every write, to get the same results
+// than exec_ins.c when X or Y is VF
+static void exec_block(oc8_emu_lockstep_t *ls, const oc8_is_ins_t *ins,
+                       size_t off, vec_t m) {
+  size_t stride = ls->stride;
+  uint8_t *px = ls->regs + (ins->operands[0] & 0xF) * stride + off;
+  uint8_t *py = ls->regs + (ins->operands[1] & 0xF) * stride + off;
+  uint8_t *pf = ls->regs + OC8_EMU_REG_FLAG * stride + off;
+  uint16_t *pc = ls->reg_pc + off;
+  uint16_t *pi = ls->reg_i + off;
+  vec_t one = v8_set1(1);
+  vec_t imm8 = v8_set1((uint8_t)ins->operands[1]);
+  vec_t f;
+
+  switch (ins->type) {
+  case OC8_IS_TYPE_1NNN: {
+    vec_t addr = v16_set1(ins->operands[0] & 0xFFF);
+    v16_blend_store(pc, m, addr, addr);
+    break;
+  }
+
+  case OC8_IS_TYPE_3XNN:
+    pc_skip_if(pc, m, v8_cmpeq(v_load(px), imm8));
+    break;
+
+  case OC8_IS_TYPE_4XNN:
+    pc_skip_if(pc, m, v_xor(v8_cmpeq(v_load(px), imm8), v8_set1(0xFF)));
+    break;
+
+  case OC8_IS_TYPE_5XY0:
+    pc_skip_if(pc, m, v8_cmpeq(v_load(px), v_load(py)));
+    break;
+
+  case OC8_IS_TYPE_9XY0:
+    pc_skip_if(pc, m,
+               v_xor(v8_cmpeq(v_load(px), v_load(py)), v8_set1(0xFF)));
+    break;
+
+  case OC8_IS_TYPE_6XNN:
+    v8_blend_store(px, m, imm8);
+    pc_next(pc, m);
+    break;
+
+  case OC8_IS_TYPE_7XNN:
+    v8_blend_store(px, m, v8_add(v_load(px), imm8));
+    pc_next(pc, m);
+    break;
+
+  case OC8_IS_TYPE_8XY0:
+    v8_blend_store(px, m, v_load(py));
+    pc_next(pc, m);
+    break;
+
+  case OC8_IS_TYPE_8XY1:
+    v8_blend_store(px, m, v_or(v_load(px), v_load(py)));
+    pc_next(pc, m);
+    break;
+
+  case OC8_IS_TYPE_8XY2:
+    v8_blend_store(px, m, v_and(v_load(px), v_load(py)));
+    pc_next(pc, m);
+    break;
+
+  case OC8_IS_TYPE_8XY3:
+    v8_blend_store(px, m, v_xor(v_load(px), v_load(py)));
+    pc_next(pc, m);
+    break;
+
+  case OC8_IS_TYPE_8XY4:
+    // vx + vy > 255 <=> vx > ~vy
+    f = v8_cmpgt(v_load(px), v_xor(v_load(py), v8_set1(0xFF)));
+    v8_blend_store(pf, m, v_and(f, one));
+    v8_blend_store(px, m, v8_add(v_load(px), v_load(py)));
+    pc_next(pc, m);
+    break;
+
+  case OC8_IS_TYPE_8XY5:
+    f = v8_cmpgt(v_load(px), v_load(py));
+    v8_blend_store(pf, m, v_and(f, one));
+    v8_blend_store(px, m, v8_sub(v_load(px), v_load(py)));
+    pc_next(pc, m);
+    break;
+
+  case OC8_IS_TYPE_8XY6:
+    v8_blend_store(pf, m, v_and(v_load(py), one));
+    v8_blend_store(px, m, v8_srl1(v_load(py)));
+    pc_next(pc, m);
+    break;
+
+  case OC8_IS_TYPE_8XY7:
+    f = v8_cmpgt(v_load(py), v_load(px));
+    v8_blend_store(pf, m, v_and(f, one));
+    v8_blend_store(px, m, v8_sub(v_load(py), v_load(px)));
+    pc_next(pc, m);
+    break;
+
+  case OC8_IS_TYPE_8XYE:
+    v8_blend_store(pf, m, v8_srl7(v_load(py)));
+    v8_blend_store(px, m, v8_add(v_load(py), v_load(py)));
+    pc_next(pc, m);
+    break;
+
+  case OC8_IS_TYPE_ANNN: {
+    vec_t addr = v16_set1(ins->operands[0] & 0xFFF);
+    v16_blend_store(pi, m, addr, addr);
+    pc_next(pc, m);
+    break;
+  }
+
+  case OC8_IS_TYPE_FX07:
+    v8_blend_store(px, m, v_load(ls->reg_dt + off));
+    pc_next(pc, m);
+    break;
+
+  case OC8_IS_TYPE_FX15:
+    v8_blend_store(ls->reg_dt + off, m, v_load(px));
+    pc_next(pc, m);
+    break;
+
+  case OC8_IS_TYPE_FX18:
+    v8_blend_store(ls->reg_st + off, m, v_load(px));
+    pc_next(pc, m);
+    break;
+
+  case OC8_IS_TYPE_FX1E: {
+    vec_t vx = v_load(px);
+    vec_t mask12 = v16_set1(0xFFF);
+    vec_t lo = v_and(v16_add(v_load(pi), v8_lo16(vx)), mask12);
+    vec_t hi = v_and(v16_add(v_load(pi + VL / 2), v8_hi16(vx)), mask12);
+    v16_blend_store(pi, m, lo, hi);
+    pc_next(pc, m);
+    break;
+  }
+
+  case OC8_IS_TYPE_FX29: {
+    // I = font + 5 * digit, 5 * digit fits in 8 bits
+    vec_t digit = v_and(v_load(px), v8_set1(0xF));
+    vec_t d4 = v8_add(digit, digit);
+    vec_t d5 = v8_add(v8_add(d4, d4), digit);
+    vec_t font = v16_set1(OC8_EMU_FONT_HEXA_ADDR);
+    v16_blend_store(pi, m, v16_add(font, v8_lo16(d5)),
+                    v16_add(font, v8_hi16(d5)));
+    pc_next(pc, m);
+    break;
+  }
+
+  default:
+    break;
+  }
+}
+
+//===----------------------------------------------------------------------===//
+// Scalar fallback
+//===----------------------------------------------------------------------===//
+
+static void mark_written(oc8_emu_lockstep_t *ls, unsigned addr, unsigned len) {
+  for (unsigned i = 0; i < len; ++i) {
+    unsigned a = (addr + i) & (OC8_EMU_RAM_SIZE - 1);
+    ls->mem_written[a / 8] |= 1 << (a % 8);
+  }
+}
+
+static int is_written(const oc8_emu_lockstep_t *ls, unsigned addr) {
+  addr &= OC8_EMU_RAM_SIZE - 1;
+  return (ls->mem_written[addr / 8] >> (addr % 8)) & 0x1;
+}
+
+// Run one instruction of machine `idx` with exec_ins.c
+static void exec_lane(oc8_emu_lockstep_t *ls, const oc8_is_ins_t *ins,
+                      size_t idx) {
+  size_t stride = ls->stride;
+  oc8_emu_cpu_t cpu;
+  cpu.reg_pc = ls->reg_pc[idx];
+  cpu.reg_i = ls->reg_i[idx];
+  for (unsigned r = 0; r < OC8_EMU_NB_REGS; ++r)
+    cpu.regs_data[r] = ls->regs[r * stride + idx];
+  cpu.reg_dt = ls->reg_dt[idx];
+  cpu.reg_st = ls->reg_st[idx];
+  cpu.reg_sp = ls->reg_sp[idx];
+  cpu.block_waitq = 0;
+  cpu.screen_changed = 0;
+  cpu.rg_seed = ls->rg_seed[idx];
+  cpu.curr_ins = *ins;
+
+  // The machine state isn't changed if the instruction is invalid
+  oc8_emu_ctx_t *ctx = &ls->ctxs[idx];
+  ctx->cpu = &cpu;
+  int err = oc8_emu_check_ins(ctx);
+  if (err == OC8_EMU_EXEC_OK)
+    oc8_emu_exec_ins(ctx);
+  ctx->cpu = NULL;
+  if (err != OC8_EMU_EXEC_OK) {
+    ls->halted[idx] = (uint8_t)err;
+    return;
+  }
+
+  if (ins->type == OC8_IS_TYPE_FX33)
+    mark_written(ls, ls->reg_i[idx], 3);
+  else if (ins->type == OC8_IS_TYPE_FX55)
+    mark_written(ls, ls->reg_i[idx], ins->operands[0] + 1);
+
+  ls->reg_pc[idx] = cpu.reg_pc;
+  ls->reg_i[idx] = cpu.reg_i;
+  for (unsigned r = 0; r < OC8_EMU_NB_REGS; ++r)
+    ls->regs[r * stride + idx] = cpu.regs_data[r];
+  ls->reg_dt[idx] = cpu.reg_dt;
+  ls->reg_st[idx] = cpu.reg_st;
+  ls->reg_sp[idx] = cpu.reg_sp;
+  ls->block_waitq[idx] = (uint8_t)cpu.block_waitq;
+  ls->rg_seed[idx] = cpu.rg_seed;
+}
+
+//===----------------------------------------------------------------------===//
+// Lockstep loop
+//===----------------------------------------------------------------------===//
+
+// Find the lowest PC of all machines that can run
+// Also store the mask of these machines in ls->mask
+static unsigned find_min_pc(oc8_emu_lockstep_t *ls) {
+  vec_t zero = v8_set1(0);
+  vec_t no_pc = v16_set1(NO_PC);
+  vec_t min_pc = no_pc;
+
+  for (size_t off = 0; off < ls->stride; off += VL) {
+    vec_t run = v8_cmpeq(v_load(ls->halted + off), zero);
+    vec_t b_lo = v_load(ls->budget + off);
+    vec_t b_hi = v_load(ls->budget + off + VL / 2);
+    vec_t act_lo = v_andnot(v16_cmpeq(b_lo, zero), m8_lo16(run));
+    vec_t act_hi = v_andnot(v16_cmpeq(b_hi, zero), m8_hi16(run));
+    vec_t pc_lo = v_blend(no_pc, v_load(ls->reg_pc + off), act_lo);
+    vec_t pc_hi = v_blend(no_pc, v_load(ls->reg_pc + off + VL / 2), act_hi);
+    min_pc = v16_min(min_pc, v16_min(pc_lo, pc_hi));
+    v_store(ls->mask + off, m16_pack8(act_lo, act_hi));
+  }
+
+  uint16_t lanes[VL / 2];
+  memcpy(lanes, &min_pc, sizeof(lanes));
+  unsigned res = NO_PC;
+  for (int i = 0; i < VL / 2; ++i)
+    if (lanes[i] < res)
+      res = lanes[i];
+  return res;
+}
+
+// Keep only the machines at `pc` in ls->mask
+// @returns index of the first machine selected
+static size_t select_group(oc8_emu_lockstep_t *ls, unsigned pc) {
+  vec_t vpc = v16_set1(pc);
+  size_t first = ls->stride;
+
+  for (size_t off = 0; off < ls->stride; off += VL) {
+    vec_t eq_lo = v16_cmpeq(v_load(ls->reg_pc + off), vpc);
+    vec_t eq_hi = v16_cmpeq(v_load(ls->reg_pc + off + VL / 2), vpc);
+    vec_t m = v_and(v_load(ls->mask + off), m16_pack8(eq_lo, eq_hi));
+    v_store(ls->mask + off, m);
+    uint32_t bits = v8_movemask(m);
+    ls->blk_any[off / VL] = bits != 0;
+    if (bits && first == ls->stride)
+      first = off + __builtin_ctz(bits);
+  }
+
+  return first;
+}
+
+// The instruction at `pc` was overwritten by some machines
+// Keep only the machines with the same opcode than `leader`
+static void filter_opcode(oc8_emu_lockstep_t *ls, unsigned pc, size_t leader) {
+  const oc8_emu_ctx_t *ctx = &ls->ctxs[leader];
+  uint8_t op0 = oc8_emu_ctx_read(ctx, pc);
+  uint8_t op1 = oc8_emu_ctx_read(ctx, pc + 1);
+  for (size_t i = 0; i < ls->stride; ++i) {
+    ctx = &ls->ctxs[i];
+    if (ls->mask[i] && (oc8_emu_ctx_read(ctx, pc) != op0 ||
+                        oc8_emu_ctx_read(ctx, pc + 1) != op1))
+      ls->mask[i] = 0;
+  }
+
+  for (size_t off = 0; off < ls->stride; off += VL)
+    ls->blk_any[off / VL] = v8_movemask(v_load(ls->mask + off)) != 0;
+}
+
+// 0 instructions per frame is used as 1
+static uint16_t get_ins_per_frame(const oc8_emu_lockstep_t *ls) {
+  return ls->ins_per_frame ? ls->ins_per_frame : 1;
+}
+
+// Update budget, timers and counters of all machines that ran
+static void end_group(oc8_emu_lockstep_t *ls) {
+  vec_t zero = v8_set1(0);
+  vec_t one = v8_set1(1);
+  vec_t ipf = v16_set1(get_ins_per_frame(ls));
+
+  for (size_t off = 0; off < ls->stride; off += VL) {
+    if (!ls->blk_any[off / VL])
+      continue;
+
+    // Machines halted by the instruction didn't run it
+    vec_t m = v_and(v_load(ls->mask + off),
+                    v8_cmpeq(v_load(ls->halted + off), zero));
+    uint32_t bits = v8_movemask(m);
+    ls->counter_ins += __builtin_popcount(bits);
+
+    // Add -1 to every selected lane
+    uint16_t *budget = ls->budget + off;
+    v_store(budget, v16_add(v_load(budget), m8_lo16(m)));
+    v_store(budget + VL / 2, v16_add(v_load(budget + VL / 2), m8_hi16(m)));
+
+    // Same for the instructions left in the frame, the timers tick at 0
+    uint16_t *frame_left = ls->frame_left + off;
+    vec_t m_lo = m8_lo16(m);
+    vec_t m_hi = m8_hi16(m);
+    vec_t left_lo = v16_add(v_load(frame_left), m_lo);
+    vec_t left_hi = v16_add(v_load(frame_left + VL / 2), m_hi);
+    vec_t tick_lo = v_and(m_lo, v16_cmpeq(left_lo, zero));
+    vec_t tick_hi = v_and(m_hi, v16_cmpeq(left_hi, zero));
+    v_store(frame_left, v_blend(left_lo, ipf, tick_lo));
+    v_store(frame_left + VL / 2, v_blend(left_hi, ipf, tick_hi));
+    vec_t tick = m16_pack8(tick_lo, tick_hi);
+    v_store(ls->reg_dt + off,
+            v8_subs(v_load(ls->reg_dt + off), v_and(tick, one)));
+    v_store(ls->reg_st + off,
+            v8_subs(v_load(ls->reg_st + off), v_and(tick, one)));
+  }
+
+  ++ls->counter_groups;
+}
+
+static void run_group(oc8_emu_lockstep_t *ls, unsigned pc) {
+  size_t leader = select_group(ls, pc);
+  if (is_written(ls, pc) || is_written(ls, pc + 1))
+    filter_opcode(ls, pc, leader);
+
+  oc8_is_ins_t ins;
+  char op[2];
+  op[0] = (char)oc8_emu_ctx_read(&ls->ctxs[leader], pc);
+  op[1] = (char)oc8_emu_ctx_read(&ls->ctxs[leader], pc + 1);
+  if (oc8_is_decode_ins(&ins, op) != 0) {
+    for (size_t i = 0; i < ls->stride; ++i)
+      if (ls->mask[i])
+        ls->halted[i] = OC8_EMU_EXEC_ERR_DECODE;
+    return;
+  }
+
+  int vector = is_vector_ins(ins.type);
+  for (size_t off = 0; off < ls->stride; off += VL) {
+    if (!ls->blk_any[off / VL])
+      continue;
+
+    vec_t m = v_load(ls->mask + off);
+    if (vector) {
+      exec_block(ls, &ins, off, m);
+      v_store(ls->block_waitq + off,
+              v_andnot(m, v_load(ls->block_waitq + off)));
+      continue;
+    }
+
+    uint32_t bits = v8_movemask(m);
+    while (bits) {
+      exec_lane(ls, &ins, off + __builtin_ctz(bits));
+      bits &= bits - 1;
+    }
+  }
+
+  end_group(ls);
+}
+
+static void run_budget(oc8_emu_lockstep_t *ls, unsigned nb_ins) {
+  for (size_t i = 0; i < ls->size; ++i)
+    ls->budget[i] = nb_ins;
+
+  for (;;) {
+    unsigned pc = find_min_pc(ls);
+    if (pc == NO_PC)
+      break;
+    run_group(ls, pc);
+  }
+}
+
+void oc8_emu_lockstep_step(oc8_emu_lockstep_t *ls, unsigned nb_ins) {
+  while (nb_ins) {
+    unsigned count = nb_ins < MAX_BUDGET ? nb_ins : MAX_BUDGET;
+    run_budget(ls, count);
+    nb_ins -= count;
+  }
+}
+
+void oc8_emu_lockstep_step_frame(oc8_emu_lockstep_t *ls) {
+  oc8_emu_lockstep_step(ls, get_ins_per_frame(ls));
+}
+
+//===----------------------------------------------------------------------===//
+// Setup
+//===----------------------------------------------------------------------===//
+
+int oc8_emu_lockstep_init(oc8_emu_lockstep_t *ls, size_t size) {
+  size_t stride = (size + OC8_EMU_LOCKSTEP_LANES - 1) / OC8_EMU_LOCKSTEP_LANES *
+                  OC8_EMU_LOCKSTEP_LANES;
+  size_t nb_blocks = stride / VL;
+
+  // All arrays in one block, each starting on a new cache line
+  size_t regs_off = 0;
+  size_t pc_off = ALIGN_UP(regs_off + OC8_EMU_NB_REGS * stride);
+  size_t i_off = ALIGN_UP(pc_off + stride * sizeof(uint16_t));
+  size_t budget_off = ALIGN_UP(i_off + stride * sizeof(uint16_t));
+  size_t dt_off = ALIGN_UP(budget_off + stride * sizeof(uint16_t));
+  size_t st_off = ALIGN_UP(dt_off + stride);
+  size_t sp_off = ALIGN_UP(st_off + stride);
+  size_t waitq_off = ALIGN_UP(sp_off + stride);
+  size_t halted_off = ALIGN_UP(waitq_off + stride);
+  size_t left_off = ALIGN_UP(halted_off + stride);
+  size_t mask_off = ALIGN_UP(left_off + stride * sizeof(uint16_t));
+  size_t any_off = ALIGN_UP(mask_off + stride);
+  size_t seed_off = ALIGN_UP(any_off + nb_blocks);
+  size_t stacks_off = ALIGN_UP(seed_off + stride * sizeof(unsigned long));
+  size_t ctxs_off = ALIGN_UP(stacks_off + stride * OC8_EMU_MIN_STACK_SIZE *
+                                              sizeof(uint16_t));
+  size_t screens_off = ALIGN_UP(ctxs_off + stride * sizeof(oc8_emu_ctx_t));
+  size_t keypads_off = ALIGN_UP(screens_off + stride * OC8_EMU_SCREEN_SIZE);
+  size_t total =
+      ALIGN_UP(keypads_off + stride * OC8_EMU_NB_KEYS * sizeof(int));
+
+  uint8_t *block;
+  if (posix_memalign((void **)&block, CACHE_LINE, total ? total : CACHE_LINE)) {
+    fprintf(stderr, "oc8_emu_lockstep_init: failed to allocate %zu machines\n",
+            size);
+    return -1;
+  }
+  memset(block, 0, total);
+
+  ls->size = size;
+  ls->stride = stride;
+  ls->regs = block + regs_off;
+  ls->reg_pc = (uint16_t *)(block + pc_off);
+  ls->reg_i = (uint16_t *)(block + i_off);
+  ls->budget = (uint16_t *)(block + budget_off);
+  ls->reg_dt = block + dt_off;
+  ls->reg_st = block + st_off;
+  ls->reg_sp = block + sp_off;
+  ls->block_waitq = block + waitq_off;
+  ls->halted = block + halted_off;
+  ls->frame_left = (uint16_t *)(block + left_off);
+  ls->mask = block + mask_off;
+  ls->blk_any = block + any_off;
+  ls->rg_seed = (unsigned long *)(block + seed_off);
+  ls->stacks = (uint16_t *)(block + stacks_off);
+  ls->ctxs = (oc8_emu_ctx_t *)(block + ctxs_off);
+  ls->screens = block + screens_off;
+  ls->keypads = (int *)(block + keypads_off);
+  ls->ins_per_frame = DEFAULT_CPU_SPEED / FRAMES_PER_SEC;
+  ls->counter_ins = 0;
+  ls->counter_groups = 0;
+  memset(ls->mem_written, 0, sizeof(ls->mem_written));
+
+  for (size_t i = 0; i < stride; ++i) {
+    oc8_emu_ctx_t *ctx = &ls->ctxs[i];
+    ctx->cpu = NULL;
+    ctx->image = NULL;
+    ctx->stack = ls->stacks + i * OC8_EMU_MIN_STACK_SIZE;
+    ctx->screen = oc8_emu_lockstep_screen(ls, i);
+    ctx->keypad = oc8_emu_lockstep_keypad(ls, i);
+    ctx->metrics = NULL;
+    oc8_emu_lockstep_reset(ls, i);
+  }
+  return 0;
+}
+
+void oc8_emu_lockstep_free(oc8_emu_lockstep_t *ls) {
+  for (size_t i = 0; i < ls->stride; ++i)
+    oc8_emu_ctx_detach(&ls->ctxs[i]);
+  // The block starts with the regs array
+  free(ls->regs);
+  ls->size = 0;
+  ls->stride = 0;
+}
+
+void oc8_emu_lockstep_reset(oc8_emu_lockstep_t *ls, size_t idx) {
+  for (unsigned r = 0; r < OC8_EMU_NB_REGS; ++r)
+    ls->regs[r * ls->stride + idx] = 0;
+  ls->reg_pc[idx] = 0;
+  ls->reg_i[idx] = 0;
+  ls->reg_dt[idx] = 0;
+  ls->reg_st[idx] = 0;
+  ls->reg_sp[idx] = 0;
+  ls->rg_seed[idx] = 0;
+  ls->block_waitq[idx] = 0;
+  ls->halted[idx] = 0;
+  ls->frame_left[idx] = get_ins_per_frame(ls);
+  oc8_emu_ctx_attach(&ls->ctxs[idx], oc8_emu_image_font());
+  memset(ls->ctxs[idx].stack, 0, OC8_EMU_MIN_STACK_SIZE * sizeof(uint16_t));
+  memset(oc8_emu_lockstep_screen(ls, idx), 0, OC8_EMU_SCREEN_SIZE);
+  memset(oc8_emu_lockstep_keypad(ls, idx), 0, OC8_EMU_NB_KEYS * sizeof(int));
+}
+
+int oc8_emu_lockstep_load_rom(oc8_emu_lockstep_t *ls, const void *rom_bytes,
+                              unsigned rom_size) {
+  oc8_emu_rom_t *rom = oc8_emu_rom_cache_get(rom_bytes, rom_size);
+  if (!rom)
+    return 1;
+
+  for (size_t i = 0; i < ls->stride; ++i) {
+    oc8_emu_ctx_attach(&ls->ctxs[i], rom->image);
+    ls->reg_pc[i] = OC8_EMU_ROM_ADDR;
+  }
+  oc8_emu_rom_unref(rom);
+  memset(ls->mem_written, 0, sizeof(ls->mem_written));
+  return 0;
+}
@@ -1,19 +1,19 @@
 #include "oc8_emu/mem.h"
 
-#include "oc8_bin/bin_reader.h"
 #include "oc8_bin/file.h"
-#include "oc8_bin/format.h"
 #include "oc8_emu/cpu.h"
 #include "oc8_emu/debug.h"
+#include "oc8_emu/rom_cache.h"
 
-#include <errno.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
 oc8_emu_mem_t g_oc8_emu_mem;
 
-static const uint8_t FONT_DATA[] = {
+// The font data starts at the beginning of its page
+// Shared by all images
+static uint8_t g_font_page[OC8_EMU_PAGE_SIZE] = {
     0xF0, 0x90, 0x90, 0x90, 0xF0, // 0
     0x20, 0x60, 0x20, 0x20, 0x70, // 1
     0xF0, 0x10, 0xF0, 0x80, 0xF0, // 2
@@ -30,10 +30,83 @@ static const uint8_t FONT_DATA[] = {
     0xE0, 0x90, 0x90, 0x90, 0xE0, // D
 };
 
-void oc8_emu_init_mem() {
-  memset(&g_oc8_emu_mem, 0, sizeof(g_oc8_emu_mem));
-  memcpy(g_oc8_emu_mem.ram + OC8_EMU_FONT_HEXA_ADDR, FONT_DATA,
-         sizeof(FONT_DATA));
+static uint8_t g_zero_page[OC8_EMU_PAGE_SIZE];
+
+#define ZP (g_zero_page)
+static oc8_emu_image_t g_font_image = {
+    1,
+    {ZP, g_font_page, ZP, ZP, ZP, ZP, ZP, ZP, ZP, ZP, ZP, ZP, ZP, ZP, ZP, ZP},
+    NULL,
+    NULL,
+    0};
+#undef ZP
+
+void oc8_emu_init_mem() { oc8_emu_mem_reset(&g_oc8_emu_mem); }
+
+void oc8_emu_mem_reset(oc8_emu_mem_t *mem) {
+  memset(mem, 0, sizeof(oc8_emu_mem_t));
+  memcpy(mem->ram + OC8_EMU_FONT_HEXA_ADDR, g_font_page, OC8_EMU_PAGE_SIZE);
+}
+
+oc8_emu_image_t *oc8_emu_image_font() { return &g_font_image; }
+
+oc8_emu_image_t *oc8_emu_image_new(const void *rom_bytes, unsigned rom_size) {
+  if (rom_size > OC8_EMU_RAM_SIZE - OC8_EMU_ROM_ADDR)
+    return NULL;
+
+  unsigned first = OC8_EMU_ROM_ADDR / OC8_EMU_PAGE_SIZE;
+  unsigned nb_pages = (rom_size + OC8_EMU_PAGE_SIZE - 1) / OC8_EMU_PAGE_SIZE;
+  size_t data_size = (size_t)nb_pages * OC8_EMU_PAGE_SIZE;
+  oc8_emu_image_t *img = malloc(sizeof(oc8_emu_image_t) + data_size);
+  memcpy(img, oc8_emu_image_font(), sizeof(oc8_emu_image_t));
+  img->refs = 1;
+  img->ins = NULL;
+  img->ins_ok = NULL;
+  img->ins_size = 0;
+
+  memset(img->data, 0, data_size);
+  memcpy(img->data, rom_bytes, rom_size);
+  for (unsigned i = 0; i < nb_pages; ++i)
+    img->pages[first + i] = img->data + i * OC8_EMU_PAGE_SIZE;
+  return img;
+}
+
+void oc8_emu_image_decode(oc8_emu_image_t *img) {
+  if (img->ins)
+    return;
+
+  // An instruction is only decoded if its 2 bytes are in the ROM pages
+  unsigned first = OC8_EMU_ROM_ADDR / OC8_EMU_PAGE_SIZE;
+  unsigned nb_pages = 0;
+  while (first + nb_pages < OC8_EMU_NB_PAGES &&
+         img->pages[first + nb_pages] ==
+             img->data + nb_pages * OC8_EMU_PAGE_SIZE)
+    ++nb_pages;
+  if (nb_pages == 0)
+    return;
+
+  unsigned size = nb_pages * OC8_EMU_PAGE_SIZE - 1;
+  img->ins = malloc(size * sizeof(oc8_is_ins_t));
+  img->ins_ok = malloc(size);
+  img->ins_size = size;
+  for (unsigned i = 0; i < size; ++i) {
+    const char *opcode = (const char *)img->data + i;
+    img->ins_ok[i] = oc8_is_try_decode_ins(&img->ins[i], opcode) == 0;
+  }
+}
+
+void oc8_emu_image_ref(oc8_emu_image_t *img) {
+  __atomic_add_fetch(&img->refs, 1, __ATOMIC_RELAXED);
+}
+
+void oc8_emu_image_unref(oc8_emu_image_t *img) {
+  if (img == &g_font_image)
+    return;
+  if (__atomic_sub_fetch(&img->refs, 1, __ATOMIC_ACQ_REL) == 0) {
+    free(img->ins);
+    free(img->ins_ok);
+    free(img);
+  }
 }
 
 void oc8_emu_load_rom(const void *rom_bytes, unsigned rom_size) {
@@ -56,59 +129,20 @@ void oc8_emu_load_bin(oc8_bin_file_t *bf) {
 }
 
 void oc8_emu_load_rom_file(const char *path) {
-  // Open and load file content
-  FILE *is = fopen(path, "rb");
-  if (is == NULL) {
-    fprintf(stderr,
-            "oc8_emu_load_rom_file: Cannot open file %s: %s. Aborting !\n",
-            path, strerror(errno));
+  // The file content is parsed once, even if loaded by many emulators
+  oc8_emu_rom_t *rom = oc8_emu_rom_cache_get_file(path);
+  if (!rom) {
+    fprintf(stderr, "oc8_emu_load_rom_file: Cannot load %s. Aborting !\n",
+            path);
     exit(1);
   }
 
-  fseek(is, 0, SEEK_END);
-  unsigned long rom_size = ftell(is);
-  fseek(is, 0, SEEK_SET);
-  uint8_t *buf = (uint8_t *)malloc(rom_size);
-
-  if (!rom_size || fread(buf, 1, rom_size, is) != rom_size) {
-    fprintf(stderr,
-            "oc8_emu_load_rom_file: Cannot read file %s: %s. Aborting !\n",
-            path, strerror(errno));
-    exit(1);
-  }
-
-  // Check if ocbin file
-  size_t magic_size = sizeof(g_oc8_bin_raw_magic_value);
-  int is_bin = rom_size > magic_size;
-  if (is_bin)
-    for (size_t i = 0; i < magic_size; ++i)
-      if (buf[i] != g_oc8_bin_raw_magic_value[i]) {
-        is_bin = 0;
-        break;
-      }
-
-  // Load ocbin file
-  if (is_bin) {
-    oc8_bin_file_t bf;
-    oc8_bin_read_file_raw(&bf, buf, rom_size);
-    oc8_bin_file_check(&bf, /*is_bin=*/1);
-    oc8_emu_load_bin(&bf);
-  }
-
-  // Load ROM file
-  else {
-    unsigned max_size = OC8_EMU_RAM_SIZE - OC8_EMU_ROM_ADDR;
-    if (rom_size > (unsigned long)max_size) {
-      fprintf(stderr,
-              "oc8_emu_load_rom_file failed: file %s is of size %lu, max size "
-              "is %u. Aborting !\n",
-              path, rom_size, max_size);
-      exit(1);
-    }
-    oc8_emu_load_rom(buf, (unsigned)rom_size);
-  }
-
-  // Clear memory
-  free(buf);
-  fclose(is);
+  oc8_emu_load_rom(rom->rom, (unsigned)rom->rom_size);
+  if (rom->has_bin) {
+    // The symbols stay owned by the cache entry
+    oc8_emu_init_debug();
+    memcpy(&g_oc8_emu_bin_file, &rom->bin, sizeof(oc8_bin_file_t));
+    g_oc8_emu_bin_rom = rom;
+  } else
+    oc8_emu_rom_unref(rom);
 }
@@ -0,0 +1,296 @@
+#define _POSIX_C_SOURCE 200809L
+#define _DEFAULT_SOURCE
+
+#include "oc8_emu/metrics.h"
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+#define LISTEN_BACKLOG (8)
+#define CLIENT_TIMEOUT_US (100 * 1000)
+
+oc8_emu_metrics_t g_oc8_emu_metrics;
+
+void oc8_emu_init_metrics() {
+  memset(&g_oc8_emu_metrics, 0, sizeof(g_oc8_emu_metrics));
+  g_oc8_emu_metrics.ips_last_time = oc8_emu_metrics_now_us();
+}
+
+uint64_t oc8_emu_metrics_now_us() {
+  struct timespec spec;
+  clock_gettime(CLOCK_MONOTONIC, &spec);
+  return (uint64_t)spec.tv_sec * 1000000 + (uint64_t)spec.tv_nsec / 1000;
+}
+
+void oc8_emu_metrics_observe(oc8_emu_metrics_hist_t *h, uint64_t val) {
+  size_t idx = 0;
+  while (idx + 1 < OC8_EMU_METRICS_HIST_BUCKETS && val > ((uint64_t)1 << idx))
+    ++idx;
+
+  ++h->buckets[idx];
+  h->sum += val;
+  ++h->count;
+}
+
+void oc8_emu_metrics_frame(oc8_emu_metrics_t *m) {
+  oc8_emu_metrics_inc(&m->frames);
+  oc8_emu_metrics_observe(&m->draws_per_frame, m->frame_draws.val);
+  m->frame_draws.val = 0;
+}
+
+// Output buffer that keeps counting once full
+typedef struct {
+  char *buf;
+  size_t cap;
+  size_t len;
+} out_t;
+
+static void out_printf(out_t *os, const char *fmt, ...) {
+  va_list ap;
+  va_start(ap, fmt);
+  size_t rem = os->len < os->cap ? os->cap - os->len : 0;
+  int n = vsnprintf(rem ? os->buf + os->len : NULL, rem, fmt, ap);
+  va_end(ap);
+  if (n > 0)
+    os->len += n;
+}
+
+static void out_header(out_t *os, const char *name, const char *type,
+                       const char *help) {
+  out_printf(os, "# HELP %s %s\n", name, help);
+  out_printf(os, "# TYPE %s %s\n", name, type);
+}
+
+static void out_counter(out_t *os, const char *name, const char *help,
+                        uint64_t val) {
+  out_header(os, name, "counter", help);
+  out_printf(os, "%s %llu\n", name, (unsigned long long)val);
+}
+
+static void out_hist(out_t *os, const char *name, const char *help,
+                     const oc8_emu_metrics_hist_t *h) {
+  out_header(os, name, "histogram", help);
+  uint64_t total = 0;
+  for (size_t i = 0; i + 1 < OC8_EMU_METRICS_HIST_BUCKETS; ++i) {
+    total += h->buckets[i];
+    out_printf(os, "%s_bucket{le=\"%llu\"} %llu\n", name,
+               (unsigned long long)1 << i, (unsigned long long)total);
+  }
+  total += h->buckets[OC8_EMU_METRICS_HIST_BUCKETS - 1];
+  out_printf(os, "%s_bucket{le=\"+Inf\"} %llu\n", name,
+             (unsigned long long)total);
+  out_printf(os, "%s_sum %llu\n", name, (unsigned long long)h->sum);
+  out_printf(os, "%s_count %llu\n", name, (unsigned long long)h->count);
+}
+
+void oc8_emu_metrics_update_ips(oc8_emu_metrics_t *m) {
+  uint64_t now = oc8_emu_metrics_now_us();
+  uint64_t ins = m->ins.val;
+  if (now > m->ips_last_time)
+    m->ips = (double)(ins - m->ips_last_ins) * 1e6 / (now - m->ips_last_time);
+  m->ips_last_time = now;
+  m->ips_last_ins = ins;
+}
+
+size_t oc8_emu_metrics_print(const oc8_emu_metrics_t *m, char *out_buf,
+                             size_t out_buf_len) {
+  out_t os;
+  os.buf = out_buf;
+  os.cap = out_buf_len;
+  os.len = 0;
+
+  out_counter(&os, "oc8_emu_instructions_total",
+              "Number of executed instructions", m->ins.val);
+  out_header(&os, "oc8_emu_instructions_per_second", "gauge",
+             "Executed instructions per second between the last 2 scrapes");
+  out_printf(&os, "oc8_emu_instructions_per_second %.1f\n", m->ips);
+  out_counter(&os, "oc8_emu_frames_total",
+              "Number of frames presented by the front-end", m->frames.val);
+  out_hist(&os, "oc8_emu_draws_per_frame",
+           "Number of DXYN instructions executed per presented frame",
+           &m->draws_per_frame);
+  out_counter(&os, "oc8_emu_rom_cache_hits_total",
+              "Number of ROM cache lookups that found the ROM",
+              m->rom_cache_hits.val);
+  out_counter(&os, "oc8_emu_rom_cache_misses_total",
+              "Number of ROM cache lookups that loaded a new ROM",
+              m->rom_cache_misses.val);
+  out_hist(&os, "oc8_emu_waitk_us", "Time in us spent waiting on FX0A",
+           &m->waitk_us);
+  out_hist(&os, "oc8_emu_pacing_jitter_us",
+           "Delay in us between the wanted and the real cycle start time",
+           &m->pacing_jitter_us);
+
+  if (out_buf_len)
+    out_buf[os.len < out_buf_len ? os.len : out_buf_len - 1] = '\0';
+  return os.len;
+}
+
+static int set_nonblock(int fd) {
+  int flags = fcntl(fd, F_GETFL, 0);
+  return flags < 0 ? -1 : fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+}
+
+static int open_unix(oc8_emu_metrics_server_t *srv, const char *path) {
+  struct sockaddr_un sa;
+  if (strlen(path) >= sizeof(sa.sun_path) ||
+      strlen(path) >= sizeof(srv->unix_path)) {
+    fprintf(stderr, "oc8_emu_metrics_server_open: socket path too long\n");
+    return -1;
+  }
+
+  memset(&sa, 0, sizeof(sa));
+  sa.sun_family = AF_UNIX;
+  strcpy(sa.sun_path, path);
+  srv->fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (srv->fd < 0)
+    return -1;
+
+  unlink(path);
+  if (bind(srv->fd, (struct sockaddr *)&sa, sizeof(sa)) != 0)
+    return -1;
+  strcpy(srv->unix_path, path);
+  return 0;
+}
+
+static int open_tcp(oc8_emu_metrics_server_t *srv, const char *port) {
+  char *end;
+  long val = strtol(port, &end, 10);
+  if (*port == '\0' || *end != '\0' || val < 0 || val > 0xFFFF) {
+    fprintf(stderr, "oc8_emu_metrics_server_open: invalid port `%s'\n", port);
+    return -1;
+  }
+
+  struct sockaddr_in sa;
+  memset(&sa, 0, sizeof(sa));
+  sa.sin_family = AF_INET;
+  sa.sin_port = htons((uint16_t)val);
+  sa.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  srv->fd = socket(AF_INET, SOCK_STREAM, 0);
+  if (srv->fd < 0)
+    return -1;
+
+  int yes = 1;
+  setsockopt(srv->fd, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+  return bind(srv->fd, (struct sockaddr *)&sa, sizeof(sa));
+}
+
+int oc8_emu_metrics_server_open(oc8_emu_metrics_server_t *srv,
+                                oc8_emu_metrics_t *m, const char *addr) {
+  srv->fd = -1;
+  srv->m = m;
+  srv->unix_path[0] = '\0';
+  srv->nb_clients = 0;
+
+  int err = strncmp(addr, "unix:", 5) == 0 ? open_unix(srv, addr + 5)
+                                           : open_tcp(srv, addr);
+  if (!err)
+    err = listen(srv->fd, LISTEN_BACKLOG);
+  if (!err)
+    err = set_nonblock(srv->fd);
+
+  if (err) {
+    fprintf(stderr, "oc8_emu_metrics_server_open: cannot listen on `%s'\n",
+            addr);
+    oc8_emu_metrics_server_close(srv);
+    return -1;
+  }
+  return 0;
+}
+
+static void send_all(int fd, const char *buf, size_t len) {
+  while (len) {
+    ssize_t n = send(fd, buf, len, MSG_NOSIGNAL);
+    if (n <= 0)
+      return;
+    buf += n;
+    len -= n;
+  }
+}
+
+static void answer_client(oc8_emu_metrics_server_t *srv, int fd) {
+  oc8_emu_metrics_update_ips(srv->m);
+  size_t len = oc8_emu_metrics_print(srv->m, NULL, 0);
+  char *body = malloc(len + 1);
+  oc8_emu_metrics_print(srv->m, body, len + 1);
+
+  char header[128];
+  int header_len = snprintf(header, sizeof(header),
+                            "HTTP/1.0 200 OK\r\n"
+                            "Content-Type: text/plain; version=0.0.4\r\n"
+                            "Content-Length: %u\r\n\r\n",
+                            (unsigned)len);
+  send_all(fd, header, header_len);
+  send_all(fd, body, len);
+  free(body);
+}
+
+// Read the request of a pending client, without blocking
+// The request content is ignored, every path returns the metrics
+// @returns 1 if the client is done (answered, closed or timed out)
+static int poll_client(oc8_emu_metrics_server_t *srv, int fd,
+                       uint64_t deadline, uint64_t now) {
+  char req[512];
+  ssize_t n = recv(fd, req, sizeof(req), 0);
+  if (n > 0) {
+    answer_client(srv, fd);
+    return 1;
+  }
+  if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR))
+    return now >= deadline;
+  return 1;
+}
+
+void oc8_emu_metrics_server_poll(oc8_emu_metrics_server_t *srv) {
+  if (srv->fd < 0)
+    return;
+
+  uint64_t now = oc8_emu_metrics_now_us();
+  // New clients wait in the backlog while all slots are used
+  while (srv->nb_clients < OC8_EMU_METRICS_MAX_CLIENTS) {
+    int fd = accept(srv->fd, NULL, NULL);
+    if (fd < 0)
+      break;
+    if (set_nonblock(fd) != 0) {
+      close(fd);
+      continue;
+    }
+    srv->clients[srv->nb_clients] = fd;
+    srv->clients_deadline[srv->nb_clients] = now + CLIENT_TIMEOUT_US;
+    ++srv->nb_clients;
+  }
+
+  size_t i = 0;
+  while (i < srv->nb_clients) {
+    if (!poll_client(srv, srv->clients[i], srv->clients_deadline[i], now)) {
+      ++i;
+      continue;
+    }
+    close(srv->clients[i]);
+    --srv->nb_clients;
+    srv->clients[i] = srv->clients[srv->nb_clients];
+    srv->clients_deadline[i] = srv->clients_deadline[srv->nb_clients];
+  }
+}
+
+void oc8_emu_metrics_server_close(oc8_emu_metrics_server_t *srv) {
+  for (size_t i = 0; i < srv->nb_clients; ++i)
+    close(srv->clients[i]);
+  srv->nb_clients = 0;
+  if (srv->fd >= 0)
+    close(srv->fd);
+  if (srv->unix_path[0])
+    unlink(srv->unix_path);
+  srv->fd = -1;
+  srv->unix_path[0] = '\0';
+}
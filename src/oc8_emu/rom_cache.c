@@ -0,0 +1,267 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "oc8_emu/rom_cache.h"
+#include "oc8_emu/metrics.h"
+
+#include "oc8_bin/bin_reader.h"
+#include "oc8_bin/bin_view.h"
+#include "oc8_bin/format.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define INIT_NB_BUCKETS (64)
+#define BIN_ARENA_CHUNK_SIZE (4096)
+
+#define FNV_OFFSET (0xcbf29ce484222325ULL)
+#define FNV_PRIME (0x100000001b3ULL)
+
+static pthread_mutex_t g_lock = PTHREAD_MUTEX_INITIALIZER;
+static oc8_emu_rom_t **g_buckets = NULL;
+static size_t g_nb_buckets = 0;
+static size_t g_size = 0;
+
+static uint64_t hash_content(const void *content, size_t size,
+                             int detect_bin) {
+  const uint8_t *bytes = (const uint8_t *)content;
+  uint64_t hash = FNV_OFFSET ^ (uint64_t)detect_bin;
+  for (size_t i = 0; i < size; ++i) {
+    hash ^= bytes[i];
+    hash *= FNV_PRIME;
+  }
+  return hash;
+}
+
+static int is_bin_file(const uint8_t *content, size_t size) {
+  size_t magic_size = sizeof(g_oc8_bin_raw_magic_value);
+  return size > magic_size &&
+         memcmp(content, g_oc8_bin_raw_magic_value, magic_size) == 0;
+}
+
+// Why `cache_get` failed, to print the right message
+typedef struct {
+  enum { CACHE_ERR_INVALID_BIN, CACHE_ERR_TOO_BIG } kind;
+  size_t rom_size; // only for CACHE_ERR_TOO_BIG
+} cache_err_t;
+
+// Must be called with the lock held
+static oc8_emu_rom_t *find(const void *content, size_t size, uint64_t hash,
+                           int detect_bin) {
+  if (!g_nb_buckets)
+    return NULL;
+  for (oc8_emu_rom_t *rom = g_buckets[hash % g_nb_buckets]; rom;
+       rom = rom->next)
+    if (rom->hash == hash && rom->detect_bin == detect_bin &&
+        rom->content_size == size && memcmp(rom->content, content, size) == 0)
+      return rom;
+  return NULL;
+}
+
+// Make room for one more entry, the table doubles when the load factor
+// would go above 1
+// Must be called with the lock held
+static void reserve_one() {
+  if (g_nb_buckets && g_size + 1 <= g_nb_buckets)
+    return;
+
+  size_t new_nb = g_nb_buckets ? 2 * g_nb_buckets : INIT_NB_BUCKETS;
+  oc8_emu_rom_t **new_buckets = calloc(new_nb, sizeof(oc8_emu_rom_t *));
+  for (size_t i = 0; i < g_nb_buckets; ++i) {
+    oc8_emu_rom_t *rom = g_buckets[i];
+    while (rom) {
+      oc8_emu_rom_t *next = rom->next;
+      rom->next = new_buckets[rom->hash % new_nb];
+      new_buckets[rom->hash % new_nb] = rom;
+      rom = next;
+    }
+  }
+
+  free(g_buckets);
+  g_buckets = new_buckets;
+  g_nb_buckets = new_nb;
+}
+
+// Read and check the .c8bin file `content` into `rom->bin`
+// Its memory is allocated from `rom->bin_arena`
+// @returns 0 if success, != 0 on error (printed)
+static int read_bin(oc8_emu_rom_t *rom, const void *content, size_t size) {
+  oc8_arena_init(&rom->bin_arena, BIN_ARENA_CHUNK_SIZE);
+  int err = oc8_bin_read_file_raw_arena(&rom->bin, content, size,
+                                        &rom->bin_arena);
+  if (!err)
+    err = oc8_bin_file_validate(&rom->bin, /*is_bin=*/1);
+  if (err)
+    oc8_arena_free(&rom->bin_arena);
+  return err;
+}
+
+// Parse and decode the ROM, done without holding the lock
+// On error, returns NULL and sets `*err`
+static oc8_emu_rom_t *rom_new(const void *content, size_t size, uint64_t hash,
+                              int detect_bin, cache_err_t *err) {
+  oc8_emu_rom_t *rom = malloc(sizeof(oc8_emu_rom_t));
+  const void *rom_bytes = content;
+  size_t rom_size = size;
+
+  rom->has_bin = detect_bin && is_bin_file(content, size);
+  if (rom->has_bin) {
+    if (read_bin(rom, content, size) != 0) {
+      free(rom);
+      err->kind = CACHE_ERR_INVALID_BIN;
+      return NULL;
+    }
+    rom_bytes = rom->bin.rom;
+    rom_size = rom->bin.rom_size;
+  }
+
+  rom->image = rom_size <= OC8_EMU_RAM_SIZE - OC8_EMU_ROM_ADDR
+                   ? oc8_emu_image_new(rom_bytes, (unsigned)rom_size)
+                   : NULL;
+  if (!rom->image) {
+    if (rom->has_bin)
+      oc8_arena_free(&rom->bin_arena);
+    free(rom);
+    err->kind = CACHE_ERR_TOO_BIG;
+    err->rom_size = rom_size;
+    return NULL;
+  }
+  oc8_emu_image_decode(rom->image);
+  rom->rom = rom->image->data;
+  rom->rom_size = rom_size;
+
+  rom->refs = 1;
+  rom->hash = hash;
+  rom->content = malloc(size ? size : 1);
+  memcpy(rom->content, content, size);
+  rom->content_size = size;
+  rom->detect_bin = detect_bin;
+  rom->next = NULL;
+  return rom;
+}
+
+static oc8_emu_rom_t *cache_get(const void *content, size_t size,
+                                int detect_bin, cache_err_t *err) {
+  uint64_t hash = hash_content(content, size, detect_bin);
+
+  // Counted under the lock, the cache can be used by many threads
+  pthread_mutex_lock(&g_lock);
+  oc8_emu_rom_t *rom = find(content, size, hash, detect_bin);
+  if (rom) {
+    oc8_emu_rom_ref(rom);
+    oc8_emu_metrics_inc(&g_oc8_emu_metrics.rom_cache_hits);
+  } else
+    oc8_emu_metrics_inc(&g_oc8_emu_metrics.rom_cache_misses);
+  pthread_mutex_unlock(&g_lock);
+  if (rom)
+    return rom;
+
+  oc8_emu_rom_t *res = rom_new(content, size, hash, detect_bin, err);
+  if (!res)
+    return NULL;
+
+  // Another thread may have loaded the same ROM in the meantime
+  pthread_mutex_lock(&g_lock);
+  rom = find(content, size, hash, detect_bin);
+  if (rom)
+    oc8_emu_rom_ref(rom);
+  else {
+    reserve_one();
+    oc8_emu_rom_ref(res);
+    res->next = g_buckets[hash % g_nb_buckets];
+    g_buckets[hash % g_nb_buckets] = res;
+    ++g_size;
+  }
+  pthread_mutex_unlock(&g_lock);
+
+  if (rom) {
+    oc8_emu_rom_unref(res);
+    return rom;
+  }
+  return res;
+}
+
+oc8_emu_rom_t *oc8_emu_rom_cache_get(const void *rom_bytes, size_t rom_size) {
+  cache_err_t err;
+  return cache_get(rom_bytes, rom_size, /*detect_bin=*/0, &err);
+}
+
+oc8_emu_rom_t *oc8_emu_rom_cache_get_content(const void *content,
+                                             size_t content_size) {
+  cache_err_t err;
+  return cache_get(content, content_size, /*detect_bin=*/1, &err);
+}
+
+oc8_emu_rom_t *oc8_emu_rom_cache_get_file(const char *path) {
+  oc8_bin_map_t map;
+  if (oc8_bin_map_open_member(&map, path) != 0) {
+    fprintf(stderr, "oc8_emu_rom_cache_get_file: Cannot read file %s\n",
+            path);
+    return NULL;
+  }
+
+  cache_err_t err;
+  oc8_emu_rom_t *rom =
+      cache_get(map.data, map.size, /*detect_bin=*/1, &err);
+  if (!rom && err.kind == CACHE_ERR_INVALID_BIN)
+    fprintf(stderr, "oc8_emu_rom_cache_get_file: file %s is not a valid "
+                    ".c8bin file\n",
+            path);
+  else if (!rom)
+    fprintf(stderr,
+            "oc8_emu_rom_cache_get_file: ROM of file %s is of size %zu, max "
+            "size is %u\n",
+            path, err.rom_size, OC8_EMU_RAM_SIZE - OC8_EMU_ROM_ADDR);
+  oc8_bin_map_close(&map);
+  return rom;
+}
+
+void oc8_emu_rom_ref(oc8_emu_rom_t *rom) {
+  __atomic_add_fetch(&rom->refs, 1, __ATOMIC_RELAXED);
+}
+
+void oc8_emu_rom_unref(oc8_emu_rom_t *rom) {
+  if (__atomic_sub_fetch(&rom->refs, 1, __ATOMIC_ACQ_REL) != 0)
+    return;
+
+  oc8_emu_image_unref(rom->image);
+  if (rom->has_bin)
+    oc8_arena_free(&rom->bin_arena);
+  free(rom->content);
+  free(rom);
+}
+
+void oc8_emu_rom_cache_trim() {
+  oc8_emu_rom_t *unused = NULL;
+
+  // Entries with only the cache reference cannot be found by anyone else
+  pthread_mutex_lock(&g_lock);
+  for (size_t i = 0; i < g_nb_buckets; ++i) {
+    oc8_emu_rom_t **it = &g_buckets[i];
+    while (*it) {
+      oc8_emu_rom_t *rom = *it;
+      if (__atomic_load_n(&rom->refs, __ATOMIC_ACQUIRE) == 1) {
+        *it = rom->next;
+        rom->next = unused;
+        unused = rom;
+        --g_size;
+      } else
+        it = &rom->next;
+    }
+  }
+  pthread_mutex_unlock(&g_lock);
+
+  while (unused) {
+    oc8_emu_rom_t *next = unused->next;
+    oc8_emu_rom_unref(unused);
+    unused = next;
+  }
+}
+
+size_t oc8_emu_rom_cache_size() {
+  pthread_mutex_lock(&g_lock);
+  size_t res = g_size;
+  pthread_mutex_unlock(&g_lock);
+  return res;
+}
@@ -0,0 +1,223 @@
+#include <catch2/catch.hpp>
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "oc8_emu/oc8_emu.h"
+#include "oc8_is/oc8_is.h"
+#include "test_utils.hh"
+
+namespace {
+
+std::vector<uint8_t> make_rom(const std::vector<uint16_t> &ops) {
+  std::vector<uint8_t> res;
+  for (auto op : ops) {
+    res.push_back(op >> 8);
+    res.push_back(op & 0xFF);
+  }
+  return res;
+}
+
+// Counter loop that draws, uses random numbers and subroutines
+const std::vector<uint16_t> LOOP_OPS = {
+    0x6000, // 200: V0 = 0
+    0x6100, // 202: V1 = 0
+    0xA210, // 204: I = 210
+    0xC2FF, // 206: V2 = rand
+    0xD015, // 208: draw (V0, V1)
+    0x2212, // 20A: call 212
+    0x8024, // 20C: V0 += V2
+    0x1206, // 20E: jmp 206
+    0xF0F0, // 210: sprite
+    0x7103, // 212: V1 += 3
+    0x00EE, // 214: ret
+};
+
+} // namespace
+
+TEST_CASE("batch same result than global emu", "") {
+  const unsigned nb_steps = 1000;
+  auto rom = make_rom(LOOP_OPS);
+  oc8_emu_init();
+  g_oc8_emu_cpu.rg_seed = 17;
+  oc8_emu_load_rom(&rom[0], rom.size());
+  for (unsigned i = 0; i < nb_steps; ++i)
+    oc8_emu_cpu_step();
+
+  oc8_emu_batch_t b;
+  oc8_emu_batch_init(&b, 3, 2);
+  REQUIRE(oc8_emu_batch_load_rom_all(&b, &rom[0], rom.size()) == 0);
+  for (size_t i = 0; i < b.size; ++i)
+    b.cpus[i].rg_seed = 17;
+  oc8_emu_batch_step(&b, nb_steps);
+
+  REQUIRE(b.counter_ins == 3 * nb_steps);
+  for (size_t i = 0; i < b.size; ++i) {
+    REQUIRE(!b.halted[i]);
+    REQUIRE(b.cpus[i].reg_pc == g_oc8_emu_cpu.reg_pc);
+    REQUIRE(b.cpus[i].reg_i == g_oc8_emu_cpu.reg_i);
+    REQUIRE(std::memcmp(b.cpus[i].regs_data, g_oc8_emu_cpu.regs_data,
+                        OC8_EMU_NB_REGS) == 0);
+    REQUIRE(std::memcmp(oc8_emu_batch_screen(&b, i), g_oc8_emu_screen,
+                        OC8_EMU_SCREEN_SIZE) == 0);
+  }
+  oc8_emu_batch_free(&b);
+}
+
+TEST_CASE("batch keypads", "") {
+  // Wait for a key, store it in V3, then loop
+  auto rom = make_rom({0xF30A, 0x1202});
+  oc8_emu_batch_t b;
+  oc8_emu_batch_init(&b, 40, 4);
+  oc8_emu_batch_load_rom_all(&b, &rom[0], rom.size());
+
+  oc8_emu_batch_step(&b, 3);
+  for (size_t i = 0; i < b.size; ++i) {
+    REQUIRE(b.cpus[i].reg_pc == 0x200);
+    REQUIRE(b.cpus[i].block_waitq == 1);
+  }
+
+  for (size_t i = 0; i < b.size; ++i)
+    b.keypads[i * OC8_EMU_NB_KEYS + i % OC8_EMU_NB_KEYS] = 1;
+  oc8_emu_batch_step(&b, 1);
+  for (size_t i = 0; i < b.size; ++i) {
+    REQUIRE(b.cpus[i].reg_pc == 0x202);
+    REQUIRE(b.cpus[i].regs_data[3] == i % OC8_EMU_NB_KEYS);
+  }
+  oc8_emu_batch_free(&b);
+}
+
+TEST_CASE("batch halts invalid machines", "") {
+  auto good = make_rom({0x7001, 0x1200});
+  auto bad_ret = make_rom({0x7001, 0x00EE});
+  auto bad_op = make_rom({0x7001, 0x5121});
+  auto bad_rand = make_rom({0x7001, 0xC000});
+  auto bad_key = make_rom({0x6010, 0xE09E});
+  oc8_emu_batch_t b;
+  oc8_emu_batch_init(&b, 5, 2);
+  oc8_emu_batch_load_rom(&b, 0, &good[0], good.size());
+  oc8_emu_batch_load_rom(&b, 1, &bad_ret[0], bad_ret.size());
+  oc8_emu_batch_load_rom(&b, 2, &bad_op[0], bad_op.size());
+  oc8_emu_batch_load_rom(&b, 3, &bad_rand[0], bad_rand.size());
+  oc8_emu_batch_load_rom(&b, 4, &bad_key[0], bad_key.size());
+
+  oc8_emu_batch_step(&b, 10);
+  REQUIRE(b.halted[0] == 0);
+  REQUIRE(b.cpus[0].regs_data[0] == 5);
+  REQUIRE(b.halted[1] == OC8_EMU_EXEC_ERR_STACK);
+  REQUIRE(b.cpus[1].regs_data[0] == 1);
+  REQUIRE(b.cpus[1].reg_pc == 0x202);
+  REQUIRE(b.halted[2] == OC8_EMU_EXEC_ERR_DECODE);
+  REQUIRE(b.halted[3] == OC8_EMU_EXEC_ERR_OPERAND);
+  REQUIRE(b.cpus[3].reg_pc == 0x202);
+  REQUIRE(b.halted[4] == OC8_EMU_EXEC_ERR_OPERAND);
+  REQUIRE(b.cpus[4].reg_pc == 0x202);
+  REQUIRE(b.counter_ins == 10 + 1 + 1 + 1 + 1);
+
+  oc8_emu_batch_reset(&b, 1);
+  REQUIRE(b.halted[1] == 0);
+  REQUIRE(b.cpus[1].regs_data[0] == 0);
+  oc8_emu_batch_free(&b);
+}
+
+TEST_CASE("batch timers count instructions", "") {
+  // DT = 5, then loop
+  auto rom = make_rom({0x6505, 0xF515, 0x1204});
+  oc8_emu_batch_t b;
+  oc8_emu_batch_init(&b, 1, 1);
+  b.ins_per_frame = 8;
+  oc8_emu_batch_load_rom_all(&b, &rom[0], rom.size());
+
+  oc8_emu_batch_step(&b, 2);
+  REQUIRE(b.cpus[0].reg_dt == 5);
+  oc8_emu_batch_step(&b, 37);
+  REQUIRE(b.cpus[0].reg_dt == 1);
+  oc8_emu_batch_step_frame(&b);
+  REQUIRE(b.cpus[0].reg_dt == 0);
+  oc8_emu_batch_free(&b);
+}
+
+TEST_CASE("batch independent of the number of threads", "") {
+  const size_t nb_machines = 1000;
+  auto rom = make_rom(LOOP_OPS);
+  oc8_emu_batch_t b1;
+  oc8_emu_batch_t b4;
+  oc8_emu_batch_init(&b1, nb_machines, 1);
+  oc8_emu_batch_init(&b4, nb_machines, 4);
+  oc8_emu_batch_load_rom_all(&b1, &rom[0], rom.size());
+  oc8_emu_batch_load_rom_all(&b4, &rom[0], rom.size());
+  for (size_t i = 0; i < nb_machines; ++i) {
+    b1.cpus[i].rg_seed = i;
+    b4.cpus[i].rg_seed = i;
+  }
+
+  for (int i = 0; i < 20; ++i) {
+    oc8_emu_batch_step_frame(&b1);
+    oc8_emu_batch_step_frame(&b4);
+  }
+
+  REQUIRE(b1.counter_ins == b4.counter_ins);
+  REQUIRE(std::memcmp(b1.screens, b4.screens,
+                      nb_machines * OC8_EMU_SCREEN_SIZE) == 0);
+  for (size_t i = 0; i < nb_machines; ++i)
+    REQUIRE(std::memcmp(b1.cpus[i].regs_data, b4.cpus[i].regs_data,
+                        OC8_EMU_NB_REGS) == 0);
+  oc8_emu_batch_free(&b1);
+  oc8_emu_batch_free(&b4);
+}
+
+TEST_CASE("batch shares ROM pages", "") {
+  // Store V0 at 0x300, then loop
+  auto rom = make_rom({0x6007, 0xA300, 0xF055, 0x1206});
+  oc8_emu_batch_t b;
+  oc8_emu_batch_init(&b, 4, 1);
+  oc8_emu_batch_load_rom_all(&b, &rom[0], rom.size());
+
+  // One more reference owned by the ROM cache
+  oc8_emu_image_t *img = b.ctxs[0].image;
+  REQUIRE(img->refs == 5);
+  for (size_t i = 0; i < b.size; ++i) {
+    REQUIRE(b.ctxs[i].image == img);
+    for (unsigned p = 0; p < OC8_EMU_NB_PAGES; ++p)
+      REQUIRE(b.ctxs[i].pages[p] == b.ctxs[0].pages[p]);
+  }
+  REQUIRE(b.ctxs[0].pages[1] == oc8_emu_image_font()->pages[1]);
+  REQUIRE(oc8_emu_ctx_read(&b.ctxs[0], OC8_EMU_FONT_HEXA_ADDR) == 0xF0);
+
+  // Only the written page of machine 2 is copied
+  for (size_t i = 0; i < b.size; ++i)
+    if (i != 2)
+      b.cpus[i].reg_pc = 0x206;
+  oc8_emu_batch_step(&b, 3);
+  REQUIRE(b.ctxs[2].shared_pages == (0xFFFF & ~(1 << 3)));
+  REQUIRE(b.ctxs[1].shared_pages == 0xFFFF);
+  REQUIRE(b.ctxs[2].pages[3] != b.ctxs[1].pages[3]);
+  REQUIRE(b.ctxs[2].pages[2] == b.ctxs[1].pages[2]);
+  REQUIRE(oc8_emu_ctx_read(&b.ctxs[2], 0x300) == 7);
+  REQUIRE(oc8_emu_ctx_read(&b.ctxs[1], 0x300) == 0);
+  REQUIRE(img->pages[3][0] == 0);
+
+  oc8_emu_batch_reset(&b, 0);
+  REQUIRE(img->refs == 4);
+  REQUIRE(b.ctxs[0].image == oc8_emu_image_font());
+  oc8_emu_batch_free(&b);
+}
+
+TEST_CASE("ctx set_mem detaches the image", "") {
+  auto rom = make_rom({0x6007, 0x1202});
+  oc8_emu_image_t *img = oc8_emu_image_new(&rom[0], rom.size());
+  oc8_emu_ctx_t ctx;
+  std::memset(&ctx, 0, sizeof(ctx));
+  oc8_emu_ctx_attach(&ctx, img);
+  REQUIRE(img->refs == 2);
+
+  oc8_emu_mem_t mem;
+  oc8_emu_ctx_set_mem(&ctx, &mem);
+  REQUIRE(img->refs == 1);
+  REQUIRE(ctx.image == nullptr);
+  REQUIRE(ctx.shared_pages == 0);
+  REQUIRE(ctx.pages[1] == mem.ram + OC8_EMU_PAGE_SIZE);
+  oc8_emu_image_unref(img);
+}
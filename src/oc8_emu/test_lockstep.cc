@@ -0,0 +1,248 @@
+#include <catch2/catch.hpp>
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "oc8_emu/oc8_emu.h"
+#include "oc8_is/oc8_is.h"
+#include "test_utils.hh"
+
+namespace {
+
+std::vector<uint8_t> make_rom(const std::vector<uint16_t> &ops) {
+  std::vector<uint8_t> res;
+  for (auto op : ops) {
+    res.push_back(op >> 8);
+    res.push_back(op & 0xFF);
+  }
+  return res;
+}
+
+// Loop a random number of times, using all vectorized instructions
+const std::vector<uint16_t> ALU_OPS = {
+    0xC10F, // 200: V1 = rand
+    0x6200, // 202: V2 = 0
+    0x7201, // 204: V2 += 1
+    0x8324, // 206: V3 += V2
+    0x8435, // 208: V4 -= V3
+    0x8536, // 20A: V5 = V3 >> 1
+    0x8637, // 20C: V6 = V3 - V6
+    0x873E, // 20E: V7 = V3 << 1
+    0x8831, // 210: V8 |= V3
+    0x8972, // 212: V9 &= V7
+    0x8A43, // 214: VA ^= V4
+    0x9120, // 216: skip if V1 != V2
+    0x121C, // 218: jmp 21C
+    0x1204, // 21A: jmp 204
+    0xA400, // 21C: I = 400
+    0xF355, // 21E: store V0..V3
+    0xF329, // 220: I = font(V3)
+    0xD125, // 222: draw
+    0xF31E, // 224: I += V3
+    0xF315, // 226: DT = V3
+    0xF418, // 228: ST = V4
+    0xF407, // 22A: V4 = DT
+    0x5450, // 22C: skip if V4 == V5
+    0x4A00, // 22E: skip if VA != 0
+    0x2240, // 230: call 240
+    0x80F0, // 232: V0 = VF
+    0x3B05, // 234: skip if VB == 5
+    0x1200, // 236: jmp 200
+    0x00EE, // 238: ret with empty stack
+    0x0000, // 23A
+    0x0000, // 23C
+    0x0000, // 23E
+    0x7B01, // 240: VB += 1
+    0x00EE, // 242: ret
+};
+
+// Some machines overwrite the instruction at 210
+const std::vector<uint16_t> SELF_MOD_OPS = {
+    0xC502, // 200: V5 = rand
+    0x3501, // 202: skip if V5 == 1
+    0x120E, // 204: jmp 20E
+    0x606B, // 206: V0 = 6B
+    0x6107, // 208: V1 = 07
+    0xA210, // 20A: I = 210
+    0xF155, // 20C: store V0, V1 at 210
+    0x6B01, // 20E: VB = 1
+    0x6B02, // 210: VB = 2, or VB = 7
+    0x1212, // 212: loop
+};
+
+void init_both(oc8_emu_batch_t *b, oc8_emu_lockstep_t *ls, size_t size,
+               const std::vector<uint8_t> &rom) {
+  REQUIRE(oc8_emu_batch_init(b, size, 1) == 0);
+  REQUIRE(oc8_emu_lockstep_init(ls, size) == 0);
+  REQUIRE(oc8_emu_batch_load_rom_all(b, &rom[0], rom.size()) == 0);
+  REQUIRE(oc8_emu_lockstep_load_rom(ls, &rom[0], rom.size()) == 0);
+  for (size_t i = 0; i < size; ++i) {
+    b->cpus[i].rg_seed = i * 7 + 1;
+    ls->rg_seed[i] = i * 7 + 1;
+  }
+}
+
+void check_same(oc8_emu_batch_t *b, oc8_emu_lockstep_t *ls) {
+  REQUIRE(b->counter_ins == ls->counter_ins);
+  for (size_t i = 0; i < b->size; ++i) {
+    const oc8_emu_cpu_t &cpu = b->cpus[i];
+    REQUIRE(cpu.reg_pc == ls->reg_pc[i]);
+    REQUIRE(cpu.reg_i == ls->reg_i[i]);
+    REQUIRE(cpu.reg_dt == ls->reg_dt[i]);
+    REQUIRE(cpu.reg_st == ls->reg_st[i]);
+    REQUIRE(cpu.reg_sp == ls->reg_sp[i]);
+    REQUIRE(b->halted[i] == ls->halted[i]);
+    for (unsigned r = 0; r < OC8_EMU_NB_REGS; ++r)
+      REQUIRE(cpu.regs_data[r] == oc8_emu_lockstep_reg(ls, r)[i]);
+    REQUIRE(std::memcmp(oc8_emu_batch_screen(b, i),
+                        oc8_emu_lockstep_screen(ls, i),
+                        OC8_EMU_SCREEN_SIZE) == 0);
+    for (unsigned addr = 0; addr < OC8_EMU_RAM_SIZE; ++addr)
+      REQUIRE(oc8_emu_ctx_read(&b->ctxs[i], addr) ==
+              oc8_emu_ctx_read(&ls->ctxs[i], addr));
+  }
+}
+
+} // namespace
+
+TEST_CASE("lockstep groups identical machines", "") {
+  auto rom = make_rom(ALU_OPS);
+  oc8_emu_lockstep_t ls;
+  oc8_emu_lockstep_init(&ls, 100);
+  REQUIRE(ls.stride == 128);
+  oc8_emu_lockstep_load_rom(&ls, &rom[0], rom.size());
+  oc8_emu_lockstep_step(&ls, 50);
+  REQUIRE(ls.counter_ins == 100 * 50);
+  REQUIRE(ls.counter_groups == 50);
+  for (size_t i = 1; i < ls.size; ++i)
+    REQUIRE(ls.reg_pc[i] == ls.reg_pc[0]);
+  oc8_emu_lockstep_free(&ls);
+}
+
+TEST_CASE("lockstep same timers than batch", "") {
+  // DT = FF, then loop
+  auto rom = make_rom({0x60FF, 0xF015, 0x1204});
+  for (unsigned ipf : {300, 0}) {
+    oc8_emu_batch_t b;
+    oc8_emu_lockstep_t ls;
+    init_both(&b, &ls, 40, rom);
+    b.ins_per_frame = ipf;
+    ls.ins_per_frame = ipf;
+    // The new value is used from the next frame, restart all machines
+    for (size_t i = 0; i < ls.size; ++i)
+      oc8_emu_lockstep_reset(&ls, i);
+    REQUIRE(oc8_emu_lockstep_load_rom(&ls, &rom[0], rom.size()) == 0);
+
+    oc8_emu_batch_step(&b, 1000);
+    oc8_emu_lockstep_step(&ls, 1000);
+    check_same(&b, &ls);
+    REQUIRE(ls.reg_dt[0] == (ipf ? 0xFF - 3 : 0));
+    oc8_emu_batch_step_frame(&b);
+    oc8_emu_lockstep_step_frame(&ls);
+    check_same(&b, &ls);
+    oc8_emu_batch_free(&b);
+    oc8_emu_lockstep_free(&ls);
+  }
+}
+
+TEST_CASE("lockstep same result than batch", "") {
+  auto rom = make_rom(ALU_OPS);
+  oc8_emu_batch_t b;
+  oc8_emu_lockstep_t ls;
+  init_both(&b, &ls, 77, rom);
+
+  for (unsigned nb_ins : {1, 7, 100, 1000}) {
+    oc8_emu_batch_step(&b, nb_ins);
+    oc8_emu_lockstep_step(&ls, nb_ins);
+    check_same(&b, &ls);
+  }
+  for (int i = 0; i < 10; ++i) {
+    oc8_emu_batch_step_frame(&b);
+    oc8_emu_lockstep_step_frame(&ls);
+  }
+  check_same(&b, &ls);
+
+  // Machines diverged but still share instructions
+  REQUIRE(ls.counter_groups < ls.counter_ins);
+  oc8_emu_batch_free(&b);
+  oc8_emu_lockstep_free(&ls);
+}
+
+TEST_CASE("lockstep self-modifying code", "") {
+  auto rom = make_rom(SELF_MOD_OPS);
+  oc8_emu_batch_t b;
+  oc8_emu_lockstep_t ls;
+  init_both(&b, &ls, 40, rom);
+
+  oc8_emu_batch_step(&b, 20);
+  oc8_emu_lockstep_step(&ls, 20);
+  check_same(&b, &ls);
+  size_t nb_mod = 0;
+  for (size_t i = 0; i < ls.size; ++i) {
+    uint8_t vb = oc8_emu_lockstep_reg(&ls, 0xB)[i];
+    REQUIRE(vb == (ls.regs[5 * ls.stride + i] == 1 ? 7 : 2));
+    nb_mod += vb == 7;
+  }
+  REQUIRE(nb_mod > 0);
+  REQUIRE(nb_mod < ls.size);
+  oc8_emu_batch_free(&b);
+  oc8_emu_lockstep_free(&ls);
+}
+
+TEST_CASE("lockstep halts invalid operands", "") {
+  // Random machines run rand % 0, or test the key 0x10
+  oc8_emu_batch_t b;
+  oc8_emu_lockstep_t ls;
+  auto rom = make_rom({
+      0xC203, // 200: V2 = rand % 3
+      0x3200, // 202: skip if V2 == 0
+      0x6010, // 204: V0 = 0x10
+      0xC302, // 206: V3 = rand % 2
+      0x3300, // 208: skip if V3 == 0
+      0xC000, // 20A: V0 = rand % 0
+      0xE09E, // 20C: skip if key V0
+      0x120E, // 20E: loop
+      0x120E, // 210: loop
+  });
+  init_both(&b, &ls, 40, rom);
+  oc8_emu_batch_step(&b, 20);
+  oc8_emu_lockstep_step(&ls, 20);
+  check_same(&b, &ls);
+  size_t nb_halted = 0;
+  for (size_t i = 0; i < ls.size; ++i) {
+    unsigned v2 = oc8_emu_lockstep_reg(&ls, 2)[i];
+    unsigned v3 = oc8_emu_lockstep_reg(&ls, 3)[i];
+    unsigned pc = v3 ? 0x20A : v2 ? 0x20C : 0x20E;
+    REQUIRE(ls.reg_pc[i] == pc);
+    REQUIRE(ls.halted[i] == (pc == 0x20E ? 0 : OC8_EMU_EXEC_ERR_OPERAND));
+    nb_halted += ls.halted[i] != 0;
+  }
+  REQUIRE(nb_halted > 0);
+  REQUIRE(nb_halted < ls.size);
+  oc8_emu_batch_free(&b);
+  oc8_emu_lockstep_free(&ls);
+}
+
+TEST_CASE("lockstep keypad", "") {
+  // Wait for a key, store it in V3, then loop
+  auto rom = make_rom({0xF30A, 0x1202});
+  oc8_emu_lockstep_t ls;
+  oc8_emu_lockstep_init(&ls, 20);
+  oc8_emu_lockstep_load_rom(&ls, &rom[0], rom.size());
+
+  oc8_emu_lockstep_step(&ls, 2);
+  for (size_t i = 0; i < ls.size; ++i)
+    REQUIRE(ls.block_waitq[i] == 1);
+
+  for (size_t i = 0; i < ls.size; i += 2)
+    oc8_emu_lockstep_keypad(&ls, i)[i % OC8_EMU_NB_KEYS] = 1;
+  oc8_emu_lockstep_step(&ls, 1);
+  for (size_t i = 0; i < ls.size; ++i) {
+    REQUIRE(ls.block_waitq[i] == i % 2);
+    REQUIRE(ls.reg_pc[i] == (i % 2 ? 0x200 : 0x202));
+    REQUIRE(oc8_emu_lockstep_reg(&ls, 3)[i] == (i % 2 ? 0 : i % 16));
+  }
+  oc8_emu_lockstep_free(&ls);
+}
@@ -0,0 +1,122 @@
+#include <catch2/catch.hpp>
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "oc8_emu/oc8_emu.h"
+#include "oc8_is/oc8_is.h"
+#include "test_utils.hh"
+
+namespace {
+
+std::string print_metrics() {
+  std::size_t len = oc8_emu_metrics_print(&g_oc8_emu_metrics, nullptr, 0);
+  std::vector<char> buf(len + 1);
+  REQUIRE(oc8_emu_metrics_print(&g_oc8_emu_metrics, &buf[0], buf.size()) ==
+          len);
+  return std::string(&buf[0]);
+}
+
+bool has_line(const std::string &out, const std::string &line) {
+  return out.find("\n" + line + "\n") != std::string::npos;
+}
+
+} // namespace
+
+TEST_CASE("metrics count instructions", "") {
+  EnvBuilder::get().opcodes("6001 6102 6203").run(3);
+  REQUIRE(g_oc8_emu_metrics.ins.val == 3);
+  REQUIRE(has_line(print_metrics(), "oc8_emu_instructions_total 3"));
+}
+
+TEST_CASE("metrics draws per frame", "") {
+  EnvBuilder::get().opcodes("D001 D001 D001").run(2);
+  REQUIRE(g_oc8_emu_metrics.frame_draws.val == 2);
+  oc8_emu_metrics_frame(&g_oc8_emu_metrics);
+  oc8_emu_cpu_step();
+  oc8_emu_metrics_frame(&g_oc8_emu_metrics);
+
+  REQUIRE(g_oc8_emu_metrics.frame_draws.val == 0);
+  REQUIRE(g_oc8_emu_metrics.frames.val == 2);
+  auto out = print_metrics();
+  REQUIRE(has_line(out, "oc8_emu_frames_total 2"));
+  REQUIRE(has_line(out, "oc8_emu_draws_per_frame_bucket{le=\"1\"} 1"));
+  REQUIRE(has_line(out, "oc8_emu_draws_per_frame_bucket{le=\"2\"} 2"));
+  REQUIRE(has_line(out, "oc8_emu_draws_per_frame_bucket{le=\"+Inf\"} 2"));
+  REQUIRE(has_line(out, "oc8_emu_draws_per_frame_sum 3"));
+  REQUIRE(has_line(out, "oc8_emu_draws_per_frame_count 2"));
+}
+
+TEST_CASE("metrics FX0A wait", "") {
+  EnvBuilder::get().opcodes("F30A").run(2);
+  REQUIRE(g_oc8_emu_metrics.waitk_begin != 0);
+  REQUIRE(g_oc8_emu_metrics.waitk_us.count == 0);
+  g_oc8_emu_keypad[4] = 1;
+  oc8_emu_cpu_step();
+  REQUIRE(g_oc8_emu_metrics.waitk_begin == 0);
+  REQUIRE(g_oc8_emu_metrics.waitk_us.count == 1);
+}
+
+TEST_CASE("metrics histogram buckets", "") {
+  oc8_emu_metrics_hist_t h;
+  std::memset(&h, 0, sizeof(h));
+  oc8_emu_metrics_observe(&h, 0);
+  oc8_emu_metrics_observe(&h, 1);
+  oc8_emu_metrics_observe(&h, 3);
+  oc8_emu_metrics_observe(&h, 4);
+  oc8_emu_metrics_observe(&h, (std::uint64_t)1 << 40);
+  REQUIRE(h.buckets[0] == 2);
+  REQUIRE(h.buckets[1] == 0);
+  REQUIRE(h.buckets[2] == 2);
+  REQUIRE(h.buckets[OC8_EMU_METRICS_HIST_BUCKETS - 1] == 1);
+  REQUIRE(h.count == 5);
+}
+
+TEST_CASE("metrics counters are cache-line padded", "") {
+  REQUIRE(sizeof(oc8_emu_metrics_counter_t) == OC8_EMU_METRICS_CACHE_LINE);
+  REQUIRE(alignof(oc8_emu_metrics_t) == OC8_EMU_METRICS_CACHE_LINE);
+}
+
+TEST_CASE("metrics server unix socket", "") {
+  const char *path = "/tmp/oc8_test_metrics.sock";
+  EnvBuilder::get().opcodes("6001").run(1);
+  oc8_emu_metrics_server_t srv;
+  std::string addr = std::string("unix:") + path;
+  REQUIRE(oc8_emu_metrics_server_open(&srv, &g_oc8_emu_metrics,
+                                      addr.c_str()) == 0);
+
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  REQUIRE(fd >= 0);
+  struct sockaddr_un sa;
+  std::memset(&sa, 0, sizeof(sa));
+  sa.sun_family = AF_UNIX;
+  std::strcpy(sa.sun_path, path);
+  REQUIRE(connect(fd, (struct sockaddr *)&sa, sizeof(sa)) == 0);
+
+  // No request yet: the client is accepted and stays pending
+  oc8_emu_metrics_server_poll(&srv);
+  REQUIRE(srv.nb_clients == 1);
+
+  const char *req = "GET /metrics HTTP/1.0\r\n\r\n";
+  REQUIRE(write(fd, req, std::strlen(req)) == (ssize_t)std::strlen(req));
+  oc8_emu_metrics_server_poll(&srv);
+  REQUIRE(srv.nb_clients == 0);
+
+  std::string res;
+  char buf[1024];
+  ssize_t n;
+  while ((n = read(fd, buf, sizeof(buf))) > 0)
+    res.append(buf, n);
+  close(fd);
+  oc8_emu_metrics_server_close(&srv);
+
+  REQUIRE(res.find("HTTP/1.0 200 OK") == 0);
+  REQUIRE(has_line(res, "oc8_emu_instructions_total 1"));
+  REQUIRE(access(path, F_OK) != 0);
+}
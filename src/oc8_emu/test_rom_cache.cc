@@ -0,0 +1,236 @@
+#include <catch2/catch.hpp>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "oc8_bin/bin_writer.h"
+#include "oc8_bin/pack.h"
+#include "oc8_emu/oc8_emu.h"
+
+namespace {
+
+std::vector<uint8_t> make_rom(const std::vector<uint16_t> &ops) {
+  std::vector<uint8_t> res;
+  for (auto op : ops) {
+    res.push_back(op >> 8);
+    res.push_back(op & 0xFF);
+  }
+  return res;
+}
+
+} // namespace
+
+TEST_CASE("rom_cache same content same entry", "") {
+  auto rom1 = make_rom({0x6001, 0x1202, 0x0101});
+  auto rom2 = make_rom({0x6001, 0x1202, 0x0102});
+  oc8_emu_rom_cache_trim();
+  REQUIRE(oc8_emu_rom_cache_size() == 0);
+
+  oc8_emu_rom_t *a = oc8_emu_rom_cache_get(&rom1[0], rom1.size());
+  oc8_emu_rom_t *b = oc8_emu_rom_cache_get(&rom1[0], rom1.size());
+  oc8_emu_rom_t *c = oc8_emu_rom_cache_get(&rom2[0], rom2.size());
+  REQUIRE(a == b);
+  REQUIRE(a != c);
+  REQUIRE(a->refs == 3);
+  REQUIRE(oc8_emu_rom_cache_size() == 2);
+  REQUIRE(a->rom_size == rom1.size());
+  REQUIRE(std::memcmp(a->rom, &rom1[0], rom1.size()) == 0);
+  REQUIRE(!a->has_bin);
+
+  // Still used entries are kept
+  oc8_emu_rom_unref(b);
+  oc8_emu_rom_unref(c);
+  oc8_emu_rom_cache_trim();
+  REQUIRE(oc8_emu_rom_cache_size() == 1);
+  REQUIRE(oc8_emu_rom_cache_get(&rom1[0], rom1.size()) == a);
+  oc8_emu_rom_unref(a);
+  oc8_emu_rom_unref(a);
+  oc8_emu_rom_cache_trim();
+  REQUIRE(oc8_emu_rom_cache_size() == 0);
+
+  std::vector<uint8_t> big(OC8_EMU_RAM_SIZE);
+  REQUIRE(oc8_emu_rom_cache_get(&big[0], big.size()) == nullptr);
+}
+
+TEST_CASE("rom_cache counts hits and misses", "") {
+  auto rom = make_rom({0x6003, 0x1202, 0x0103});
+  oc8_emu_rom_cache_trim();
+  std::uint64_t hits = g_oc8_emu_metrics.rom_cache_hits.val;
+  std::uint64_t misses = g_oc8_emu_metrics.rom_cache_misses.val;
+
+  oc8_emu_rom_t *a = oc8_emu_rom_cache_get(&rom[0], rom.size());
+  oc8_emu_rom_t *b = oc8_emu_rom_cache_get(&rom[0], rom.size());
+  REQUIRE(g_oc8_emu_metrics.rom_cache_hits.val == hits + 1);
+  REQUIRE(g_oc8_emu_metrics.rom_cache_misses.val == misses + 1);
+
+  std::vector<char> buf(
+      oc8_emu_metrics_print(&g_oc8_emu_metrics, nullptr, 0) + 1);
+  oc8_emu_metrics_print(&g_oc8_emu_metrics, &buf[0], buf.size());
+  std::string line = "\noc8_emu_rom_cache_hits_total " +
+                     std::to_string(hits + 1) + "\n";
+  REQUIRE(std::string(&buf[0]).find(line) != std::string::npos);
+  oc8_emu_rom_unref(a);
+  oc8_emu_rom_unref(b);
+}
+
+TEST_CASE("rom_cache decoded instructions", "") {
+  auto rom = make_rom({0x6001, 0x1202, 0x5121});
+  oc8_emu_rom_t *entry = oc8_emu_rom_cache_get(&rom[0], rom.size());
+  const oc8_emu_image_t *img = entry->image;
+
+  REQUIRE(img->ins_size == OC8_EMU_PAGE_SIZE - 1);
+  REQUIRE(img->ins_ok[0]);
+  REQUIRE(img->ins[0].type == OC8_IS_TYPE_6XNN);
+  REQUIRE(img->ins[2].type == OC8_IS_TYPE_1NNN);
+  REQUIRE(img->ins[2].operands[0] == 0x202);
+  REQUIRE(!img->ins_ok[4]);
+  // Unaligned instruction 0x0112
+  REQUIRE(img->ins_ok[1]);
+  REQUIRE(img->ins[1].type == OC8_IS_TYPE_0NNN);
+  oc8_emu_rom_unref(entry);
+}
+
+TEST_CASE("rom_cache decoded instructions after write", "") {
+  // Replace the instruction at 0x206 (V1 = 2) by V2 = 2
+  auto rom = make_rom({0x6062, 0xA206, 0xF055, 0x6102, 0x1208});
+  oc8_emu_batch_t b;
+  oc8_emu_batch_init(&b, 2, 1);
+  oc8_emu_batch_load_rom_all(&b, &rom[0], rom.size());
+  b.cpus[1].reg_pc = 0x206;
+  oc8_emu_batch_step(&b, 5);
+  REQUIRE(b.cpus[0].regs_data[1] == 0);
+  REQUIRE(b.cpus[0].regs_data[2] == 2);
+  REQUIRE(b.cpus[1].regs_data[1] == 2);
+  REQUIRE(b.cpus[1].regs_data[2] == 0);
+
+  // Replace only the second byte: V1 = 9
+  rom[1] = 0x09;
+  rom[3] = 0x07;
+  oc8_emu_batch_load_rom_all(&b, &rom[0], rom.size());
+  oc8_emu_batch_step(&b, 4);
+  REQUIRE(b.cpus[0].regs_data[1] == 9);
+  oc8_emu_batch_free(&b);
+}
+
+TEST_CASE("rom_cache bin file", "") {
+  auto rom = make_rom({0x6003, 0x1202});
+  oc8_bin_file_t bf;
+  REQUIRE(oc8_bin_file_init_binary_rom(&bf, &rom[0], rom.size()) == 0);
+  REQUIRE(oc8_bin_file_validate(&bf, /*is_bin=*/1) == 0);
+  std::vector<uint8_t> content(oc8_bin_write_file_raw(&bf, nullptr));
+  oc8_bin_write_file_raw(&bf, &content[0]);
+  oc8_bin_file_free(&bf);
+
+  oc8_emu_rom_t *entry =
+      oc8_emu_rom_cache_get_content(&content[0], content.size());
+  REQUIRE(entry->has_bin);
+  REQUIRE(entry->bin.syms_defs_size == 1);
+  REQUIRE(entry->rom_size == rom.size());
+  REQUIRE(std::memcmp(entry->rom, &rom[0], rom.size()) == 0);
+
+  // Raw ROMs are never parsed as .c8bin
+  oc8_emu_rom_t *raw = oc8_emu_rom_cache_get(&content[0], content.size());
+  REQUIRE(raw != entry);
+  REQUIRE(!raw->has_bin);
+  oc8_emu_rom_unref(entry);
+  oc8_emu_rom_unref(raw);
+}
+
+TEST_CASE("rom_cache invalid bin file", "") {
+  auto rom = make_rom({0x6003, 0x1202});
+  oc8_bin_file_t bf;
+  REQUIRE(oc8_bin_file_init_binary_rom(&bf, &rom[0], rom.size()) == 0);
+  std::vector<uint8_t> content(oc8_bin_write_file_raw(&bf, nullptr));
+  oc8_bin_write_file_raw(&bf, &content[0]);
+  oc8_bin_file_free(&bf);
+
+  // Truncated file
+  REQUIRE(oc8_emu_rom_cache_get_content(&content[0], content.size() - 1) ==
+          nullptr);
+
+  // Symbol outside of the ROM, rejected by the bin file check
+  REQUIRE(oc8_bin_file_init_binary_rom(&bf, &rom[0], rom.size()) == 0);
+  bf.syms_defs[0].addr = 0x300;
+  content.resize(oc8_bin_write_file_raw(&bf, nullptr));
+  oc8_bin_write_file_raw(&bf, &content[0]);
+  oc8_bin_file_free(&bf);
+  REQUIRE(oc8_emu_rom_cache_get_content(&content[0], content.size()) ==
+          nullptr);
+
+  const char *path = "/tmp/oc8_test_rom_cache_invalid.c8bin";
+  FILE *f = std::fopen(path, "wb");
+  std::fwrite(&content[0], 1, content.size(), f);
+  std::fclose(f);
+  REQUIRE(oc8_emu_rom_cache_get_file(path) == nullptr);
+  std::remove(path);
+}
+
+TEST_CASE("rom_cache grows", "") {
+  oc8_emu_rom_cache_trim();
+  std::vector<oc8_emu_rom_t *> entries;
+  for (uint16_t i = 0; i < 300; ++i) {
+    auto rom = make_rom({(uint16_t)(0x6000 | (i & 0xFF)), (uint16_t)i});
+    entries.push_back(oc8_emu_rom_cache_get(&rom[0], rom.size()));
+  }
+  REQUIRE(oc8_emu_rom_cache_size() == entries.size());
+
+  // Every entry is still found after the table grew
+  for (uint16_t i = 0; i < 300; ++i) {
+    auto rom = make_rom({(uint16_t)(0x6000 | (i & 0xFF)), (uint16_t)i});
+    oc8_emu_rom_t *entry = oc8_emu_rom_cache_get(&rom[0], rom.size());
+    REQUIRE(entry == entries[i]);
+    oc8_emu_rom_unref(entry);
+  }
+  for (auto entry : entries)
+    oc8_emu_rom_unref(entry);
+  oc8_emu_rom_cache_trim();
+  REQUIRE(oc8_emu_rom_cache_size() == 0);
+}
+
+TEST_CASE("rom_cache many threads", "") {
+  auto rom = make_rom({0x6001, 0x7001, 0x1202, 0x0103});
+  oc8_emu_rom_cache_trim();
+  std::vector<oc8_emu_rom_t *> entries(8);
+  std::vector<std::thread> threads;
+  for (size_t i = 0; i < entries.size(); ++i)
+    threads.emplace_back([&, i] {
+      entries[i] = oc8_emu_rom_cache_get(&rom[0], rom.size());
+    });
+  for (auto &t : threads)
+    t.join();
+
+  REQUIRE(oc8_emu_rom_cache_size() == 1);
+  for (auto entry : entries)
+    REQUIRE(entry == entries[0]);
+  REQUIRE(entries[0]->refs == entries.size() + 1);
+  for (auto entry : entries)
+    oc8_emu_rom_unref(entry);
+  oc8_emu_rom_cache_trim();
+  REQUIRE(oc8_emu_rom_cache_size() == 0);
+}
+
+TEST_CASE("rom_cache pack member", "") {
+  auto rom1 = make_rom({0x6001, 0x1202});
+  auto rom2 = make_rom({0x6002, 0x1202});
+  std::vector<oc8_bin_pack_member_t> ms = {
+      {"one", &rom1[0], rom1.size()},
+      {"two", &rom2[0], rom2.size()},
+  };
+  const char *path = "/tmp/oc8_test_rom_cache.c8pk";
+  REQUIRE(oc8_bin_pack_write_to_file(&ms[0], ms.size(), path) == 0);
+
+  oc8_emu_rom_t *entry =
+      oc8_emu_rom_cache_get_file("/tmp/oc8_test_rom_cache.c8pk:two");
+  REQUIRE(entry);
+  REQUIRE(entry->rom_size == rom2.size());
+  REQUIRE(std::memcmp(entry->rom, &rom2[0], rom2.size()) == 0);
+  REQUIRE(oc8_emu_rom_cache_get_content(&rom2[0], rom2.size()) == entry);
+  oc8_emu_rom_unref(entry);
+  oc8_emu_rom_unref(entry);
+  REQUIRE(oc8_emu_rom_cache_get_file("/tmp/oc8_test_rom_cache.c8pk:x") ==
+          nullptr);
+  std::remove(path);
+}
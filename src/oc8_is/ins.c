@@ -15,10 +15,17 @@
 #define OPCODE_H123(X) ((X)&0xFFF)
 #define OPCODE_H23(X) ((X)&0xFF)
 
-/// Decode the instruction stored in the 2 bytes of `buf`, and
-/// Write result in `ins`
-/// @returns != 0 if failed to decode instruction
 int oc8_is_decode_ins(oc8_is_ins_t *ins, const char *buf) {
+  if (oc8_is_try_decode_ins(ins, buf) == 0)
+    return 0;
+
+  // Opcode not recognized
+  uint16_t opcode = OPCODE_SWAP(ins->opcode);
+  fprintf(stderr, "Warning: Unknown code [%x]\n", (int)opcode);
+  return 1;
+}
+
+int oc8_is_try_decode_ins(oc8_is_ins_t *ins, const char *buf) {
   uint16_t opcode = *((uint16_t *)buf);
   ins->opcode = opcode;
 
@@ -235,7 +242,6 @@ int oc8_is_decode_ins(oc8_is_ins_t *ins, const char *buf) {
 
   else {
     // Opcode not recognized
-    fprintf(stderr, "Warning: Unknown code [%x]\n", (int)opcode);
     return 1;
   }
 
@@ -0,0 +1,97 @@
+#include "oc8_ld/archive.h"
+#include "oc8_bin/bin_reader.h"
+
+#include <stdio.h>
+#include <string.h>
+
+typedef struct {
+  oc8_ld_linker_t *ld;
+  oc8_smap_t globals;  // global symbols defined by all units
+  uint8_t **extracted; // for every archive, 1 if a member is a unit
+} extract_t;
+
+static void add_globals(extract_t *ex, const oc8_bin_file_t *bf) {
+  for (size_t i = 0; i < bf->syms_defs_size; ++i) {
+    const oc8_bin_sym_def_t *def = &bf->syms_defs[i];
+    if (def->addr != 0 && def->is_global)
+      oc8_smap_insert(&ex->globals, def->name, 1);
+  }
+}
+
+// @returns 0 if success, != 0 if the member isn't a valid object (printed)
+static int add_member(extract_t *ex, size_t ar_idx, size_t member_idx) {
+  oc8_ld_linker_t *ld = ex->ld;
+  oc8_bin_pack_member_t member;
+  oc8_bin_archive_get(ld->archives_arr[ar_idx], member_idx, &member);
+  ex->extracted[ar_idx][member_idx] = 1;
+
+  // Released with the linker, even if invalid
+  oc8_bin_file_t *bf = oc8_arena_alloc(ld->arena, sizeof(oc8_bin_file_t));
+  if (oc8_bin_read_file_raw_arena(bf, member.data, member.size, ld->arena)) {
+    fprintf(stderr, "Linker error: cannot read archive member `%s'.\n",
+            member.name);
+    return -1;
+  }
+  oc8_ld_linker_add_named(ld, bf, member.name);
+  ld->units_arr[ld->units_size - 1]->owns_bf = 1;
+  if (bf->header.type != OC8_BIN_FILE_TYPE_OBJ) {
+    fprintf(stderr, "Linker error: archive member `%s' isn't an object.\n",
+            member.name);
+    return -1;
+  }
+  if (oc8_bin_file_validate(bf, /*is_bin=*/0) != 0)
+    return -1;
+  add_globals(ex, bf);
+  return 0;
+}
+
+// Add the member that defines `name`, if any
+// @returns 0 if success, != 0 on error
+static int find_member(extract_t *ex, const char *name) {
+  for (size_t i = 0; i < ex->ld->archives_size; ++i) {
+    long member_idx = oc8_bin_archive_find_sym(ex->ld->archives_arr[i], name);
+    if (member_idx < 0)
+      continue;
+    // Already a unit if the archive index is right
+    if (!ex->extracted[i][member_idx])
+      return add_member(ex, i, member_idx);
+    return 0;
+  }
+  return 0;
+}
+
+int oc8_ld_extract_members(oc8_ld_linker_t *ld, size_t *nb_added) {
+  oc8_arena_t *arena = ld->arena;
+  extract_t ex;
+  ex.ld = ld;
+  oc8_smap_init_interned(&ex.globals, arena);
+  ex.extracted = oc8_arena_alloc(arena, ld->archives_size * sizeof(uint8_t *));
+  for (size_t i = 0; i < ld->archives_size; ++i) {
+    size_t nb_members = ld->archives_arr[i]->nb_members;
+    ex.extracted[i] = oc8_arena_alloc(arena, nb_members + 1);
+    memset(ex.extracted[i], 0, nb_members + 1);
+  }
+
+  size_t nb_inputs = ld->units_size;
+  for (size_t i = 0; i < nb_inputs; ++i)
+    add_globals(&ex, ld->units_arr[i]->bf);
+
+  // New units are added at the end: go through all of them once
+  int err = 0;
+  for (size_t i = 0; i < ld->units_size && !err; ++i) {
+    const oc8_bin_file_t *bf = ld->units_arr[i]->bf;
+    for (size_t j = 0; j < bf->syms_defs_size && !err; ++j) {
+      const oc8_bin_sym_def_t *def = &bf->syms_defs[j];
+      if (def->addr == 0 && !oc8_smap_find(&ex.globals, def->name))
+        err = find_member(&ex, def->name);
+    }
+  }
+
+  for (size_t i = ld->archives_size; i > 0; --i)
+    oc8_arena_release(arena, ex.extracted[i - 1]);
+  oc8_arena_release(arena, ex.extracted);
+  oc8_smap_free(&ex.globals);
+  if (nb_added)
+    *nb_added = ld->units_size - nb_inputs;
+  return err;
+}
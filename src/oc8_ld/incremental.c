@@ -0,0 +1,461 @@
+#include "oc8_ld/incremental.h"
+#include "oc8_bin/archive.h"
+#include "oc8_bin/bin_reader.h"
+#include "oc8_bin/bin_view.h"
+#include "oc8_bin/bin_writer.h"
+#include "oc8_ld/linker.h"
+#include "oc8_ld/lto.h"
+#include "oc8_ld/map.h"
+#include "oc8_ld/pieces.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define STATE_MAGIC "OC8LDST"
+#define STATE_VERSION (1)
+
+typedef struct {
+  char magic[8];
+  uint32_t version;
+  uint32_t nb_units;
+  uint64_t out_key; // key of the output in the cache
+} state_header_t;
+
+// Everything the output depends on, for one input
+typedef struct {
+  uint64_t content;    // hash of the file
+  uint64_t iface;      // hash of ROM size and symbol defs
+  uint32_t defs_start; // output id of its first defined symbol
+  uint32_t refs_start; // index of its first ref in the output
+  uint32_t refs_count;
+  uint16_t rom_addr;
+  uint16_t pad;
+} unit_state_t;
+
+typedef struct {
+  const char *path;
+  oc8_bin_map_t map;
+  oc8_bin_file_t bf; // only read when needed
+  int loaded;
+  oc8_bin_archive_t ar; // only if `is_archive`
+  int is_archive;
+  unit_state_t st;
+} input_t;
+
+typedef struct {
+  input_t *ins;
+  size_t nb_ins;
+  const char *out_path;
+  const oc8_bin_cache_t *cache;
+  oc8_pool_t *pool;
+  int use_gc;
+  int use_icf;
+  uint16_t lto_max_size;
+  FILE *report;
+  FILE *map;
+  int has_archives;
+  oc8_arena_t arena;
+} link_job_t;
+
+static uint64_t iface_hash(oc8_bin_file_t *bf) {
+  uint64_t rom_size = bf->rom_size;
+  uint64_t h = oc8_bin_hash(&rom_size, sizeof(rom_size), OC8_BIN_HASH_INIT);
+  for (size_t i = 0; i < bf->syms_defs_size; ++i) {
+    oc8_bin_sym_def_t *def = &bf->syms_defs[i];
+    uint8_t infos[6] = {def->is_global,
+                        (uint8_t)def->type,
+                        (uint8_t)(def->addr & 0xFF),
+                        (uint8_t)(def->addr >> 8),
+                        (uint8_t)(def->size & 0xFF),
+                        (uint8_t)(def->size >> 8)};
+    h = oc8_bin_hash_str(def->name, h);
+    h = oc8_bin_hash(infos, sizeof(infos), h);
+  }
+  return h;
+}
+
+// The mapping is closed by `free_job`, even on error
+// @returns 0 if success, != 0 if the input isn't a valid object (printed)
+static int load_input(link_job_t *job, input_t *in) {
+  if (in->loaded)
+    return 0;
+  if (oc8_bin_read_file_raw_arena(&in->bf, in->map.data, in->map.size,
+                                  &job->arena) != 0) {
+    fprintf(stderr, "oc8-ld: Invalid input file `%s'.\n", in->path);
+    return -1;
+  }
+  in->loaded = 1;
+  if (oc8_bin_file_validate(&in->bf, /*is_bin=*/0) != 0)
+    return -1;
+  if (in->bf.header.type != OC8_BIN_FILE_TYPE_OBJ) {
+    fprintf(stderr, "oc8-ld: Input file `%s' must be of type object.\n",
+            in->path);
+    return -1;
+  }
+  in->st.iface = iface_hash(&in->bf);
+  return 0;
+}
+
+static char *state_path(link_job_t *job) {
+  uint64_t key = oc8_bin_hash_str("oc8-ld state", OC8_BIN_HASH_INIT);
+  key = oc8_bin_hash_str(job->out_path, key);
+  return oc8_bin_cache_path(job->cache, key, "c8ld");
+}
+
+// @returns the state of the last link, or NULL if none or different inputs
+static unit_state_t *read_state(link_job_t *job, uint64_t *out_key) {
+  char *path = state_path(job);
+  oc8_bin_map_t map;
+  int err = oc8_bin_map_open(&map, path);
+  free(path);
+  if (err)
+    return NULL;
+
+  unit_state_t *res = NULL;
+  const state_header_t *header = (const state_header_t *)map.data;
+  size_t len = sizeof(state_header_t) + job->nb_ins * sizeof(unit_state_t);
+  if (map.size == len && memcmp(header->magic, STATE_MAGIC, 8) == 0 &&
+      header->version == STATE_VERSION && header->nb_units == job->nb_ins) {
+    res = malloc(job->nb_ins * sizeof(unit_state_t));
+    memcpy(res, map.data + sizeof(state_header_t),
+           job->nb_ins * sizeof(unit_state_t));
+    *out_key = header->out_key;
+  }
+  oc8_bin_map_close(&map);
+  return res;
+}
+
+static void write_state(link_job_t *job, uint64_t out_key) {
+  size_t len = sizeof(state_header_t) + job->nb_ins * sizeof(unit_state_t);
+  uint8_t *buf = calloc(1, len);
+  state_header_t *header = (state_header_t *)buf;
+  memcpy(header->magic, STATE_MAGIC, 8);
+  header->version = STATE_VERSION;
+  header->nb_units = job->nb_ins;
+  header->out_key = out_key;
+  unit_state_t *units = (unit_state_t *)(buf + sizeof(state_header_t));
+  for (size_t i = 0; i < job->nb_ins; ++i)
+    units[i] = job->ins[i].st;
+
+  // Not an error, the next link will be a full one
+  char *path = state_path(job);
+  oc8_bin_write_file_atomic(path, buf, len, 0644);
+  free(path);
+  free(buf);
+}
+
+// @returns 0 if success, != 0 on error (printed)
+static int link_full(link_job_t *job, oc8_bin_file_t *out_bf) {
+  oc8_ld_linker_t ld;
+  oc8_ld_linker_init_arena(&ld, 1, &job->arena);
+  oc8_ld_linker_set_pool(&ld, job->pool);
+  oc8_ld_linker_set_gc(&ld, job->use_gc);
+  oc8_ld_linker_set_icf(&ld, job->use_icf);
+  oc8_ld_linker_set_lto(&ld, job->lto_max_size);
+  for (size_t i = 0; i < job->nb_ins; ++i) {
+    input_t *in = &job->ins[i];
+    if (in->is_archive) {
+      oc8_ld_linker_add_archive(&ld, &in->ar);
+      continue;
+    }
+    if (load_input(job, in) != 0) {
+      oc8_ld_linker_free(&ld);
+      return -1;
+    }
+    oc8_ld_linker_add_named(&ld, &in->bf, in->path);
+  }
+  if (oc8_ld_linker_link(&ld, out_bf) != 0) {
+    oc8_ld_linker_free(&ld);
+    return -1;
+  }
+  if (job->report) {
+    oc8_ld_print_inlines(&ld, job->report);
+    oc8_ld_print_folds(&ld, job->report);
+  }
+  if (job->map)
+    oc8_ld_print_map(&ld, out_bf, job->map);
+
+  // Same order of symbols and refs as the linker, only needed if there is one
+  // unit per input
+  size_t defs_start = 0;
+  size_t refs_start = 0;
+  for (size_t i = 0; i < ld.units_size && !job->has_archives; ++i) {
+    oc8_ld_unit_t *unit = ld.units_arr[i];
+    if (i > 0) {
+      unit_state_t *st = &job->ins[i - 1].st;
+      st->rom_addr = unit->rom_addr;
+      st->defs_start = defs_start;
+      st->refs_start = refs_start;
+      st->refs_count = unit->bf->syms_refs_size;
+    }
+    for (size_t j = 0; j < unit->bf->syms_defs_size; ++j)
+      defs_start += unit->bf->syms_defs[j].addr != 0;
+    refs_start += unit->bf->syms_refs_size;
+  }
+  oc8_ld_linker_free(&ld);
+  return 0;
+}
+
+static void copy_refs(oc8_bin_file_t *out_bf, oc8_bin_file_t *prev_bf,
+                      size_t begin, size_t end) {
+  for (size_t i = begin; i < end; ++i)
+    oc8_bin_file_add_ref(out_bf, prev_bf->syms_refs[i].ins_addr,
+                         prev_bf->syms_refs[i].sym_id);
+}
+
+// Add the refs of a changed input, with the same symbol ids as the linker
+// @returns 0 if success, != 0 if a symbol is undefined (printed)
+static int add_unit_refs(link_job_t *job, oc8_bin_file_t *out_bf,
+                         input_t *in) {
+  oc8_bin_file_t *bf = &in->bf;
+  uint16_t *syms_map =
+      oc8_arena_alloc(&job->arena, bf->syms_defs_size * sizeof(uint16_t));
+  uint16_t next_id = in->st.defs_start;
+  for (size_t i = 0; i < bf->syms_defs_size; ++i) {
+    oc8_bin_sym_def_t *def = &bf->syms_defs[i];
+    if (def->addr != 0) {
+      syms_map[def->id] = next_id++;
+      continue;
+    }
+
+    oc8_smap_node_t *node = oc8_smap_find(&out_bf->globals, def->name);
+    if (node == NULL) {
+      fprintf(stderr, "Linker error: undefined reference to `%s'.\n",
+              def->name);
+      oc8_arena_release(&job->arena, syms_map);
+      return -1;
+    }
+    syms_map[def->id] = (uint16_t)node->val;
+  }
+
+  in->st.refs_start = out_bf->syms_refs_size;
+  for (size_t i = 0; i < bf->syms_refs_size; ++i) {
+    oc8_bin_sym_ref_t *ref = &bf->syms_refs[i];
+    uint16_t ins_addr = ref->ins_addr - OC8_ROM_START + in->st.rom_addr;
+    oc8_bin_file_add_ref(out_bf, ins_addr, syms_map[ref->sym_id]);
+  }
+  in->st.refs_count = bf->syms_refs_size;
+  oc8_arena_release(&job->arena, syms_map);
+  return 0;
+}
+
+// @returns 0 if `out_bf` was built from the previous output, 1 if a full
+// link is needed, -1 on error (printed)
+static int link_incremental(link_job_t *job, const unit_state_t *prev,
+                            uint64_t prev_key, oc8_bin_file_t *out_bf) {
+  // The layout stays the same only if no interface changed
+  for (size_t i = 0; i < job->nb_ins; ++i) {
+    input_t *in = &job->ins[i];
+    uint64_t content = in->st.content;
+    if (content == prev[i].content) {
+      in->st = prev[i];
+      continue;
+    }
+    if (load_input(job, in) != 0)
+      return -1;
+    if (in->st.iface != prev[i].iface)
+      return 1;
+    uint64_t iface = in->st.iface;
+    in->st = prev[i];
+    in->st.content = content;
+    in->st.iface = iface;
+  }
+
+  char *prev_path = oc8_bin_cache_path(job->cache, prev_key, "c8bin");
+  oc8_bin_map_t map;
+  int err = oc8_bin_map_open(&map, prev_path);
+  free(prev_path);
+  if (err)
+    return 1;
+  oc8_bin_file_t prev_bf;
+  err = oc8_bin_read_file_raw_arena(&prev_bf, map.data, map.size, &job->arena);
+  oc8_bin_map_close(&map);
+  if (err)
+    return 1;
+
+  // Same symbols, the previous output was valid
+  oc8_bin_file_init_arena(out_bf, &job->arena);
+  oc8_bin_file_set_version(out_bf, OC8_BIN_VERSION);
+  oc8_bin_file_set_type(out_bf, OC8_BIN_FILE_TYPE_BIN);
+  oc8_bin_file_set_defs_count(out_bf, prev_bf.syms_defs_size);
+  for (size_t i = 0; i < prev_bf.syms_defs_size; ++i) {
+    oc8_bin_sym_def_t *def = &prev_bf.syms_defs[i];
+    oc8_bin_file_add_def(out_bf, def->name, def->is_global, def->type,
+                         def->addr);
+    oc8_bin_file_set_def_size(out_bf, def->id, def->size);
+  }
+
+  // Refs of the changed inputs are replaced
+  size_t prev_ref = 0;
+  for (size_t i = 0; i < job->nb_ins; ++i) {
+    input_t *in = &job->ins[i];
+    copy_refs(out_bf, &prev_bf, prev_ref, prev[i].refs_start);
+    prev_ref = prev[i].refs_start + prev[i].refs_count;
+    if (in->loaded) {
+      if (add_unit_refs(job, out_bf, in) != 0) {
+        oc8_bin_file_free(out_bf);
+        return -1;
+      }
+    } else {
+      in->st.refs_start = out_bf->syms_refs_size;
+      copy_refs(out_bf, &prev_bf, prev[i].refs_start, prev_ref);
+    }
+  }
+  copy_refs(out_bf, &prev_bf, prev_ref, prev_bf.syms_refs_size);
+
+  // Same for ROM bytes, patched again
+  oc8_bin_file_init_rom(out_bf, prev_bf.rom_size);
+  memcpy(out_bf->rom, prev_bf.rom, prev_bf.rom_size);
+  for (size_t i = 0; i < job->nb_ins; ++i) {
+    input_t *in = &job->ins[i];
+    if (!in->loaded)
+      continue;
+    memcpy(out_bf->rom + in->st.rom_addr - OC8_ROM_START, in->bf.rom,
+           in->bf.rom_size);
+    for (size_t j = 0; j < in->st.refs_count; ++j) {
+      oc8_bin_sym_ref_t *ref = &out_bf->syms_refs[in->st.refs_start + j];
+      uint16_t val = out_bf->syms_defs[ref->sym_id].addr;
+      if (oc8_ld_fix_opcode(out_bf->rom, ref->ins_addr, val) != 0) {
+        oc8_bin_file_free(out_bf);
+        return -1;
+      }
+    }
+  }
+  return 0;
+}
+
+static void free_job(link_job_t *job) {
+  for (size_t i = 0; i < job->nb_ins; ++i)
+    oc8_bin_map_close(&job->ins[i].map);
+  free(job->ins);
+  oc8_arena_free(&job->arena);
+}
+
+// ROM size of a mapped binary file, without reading it
+static size_t map_rom_size(const oc8_bin_map_t *map) {
+  oc8_bin_file_view_t view;
+  if (oc8_bin_file_view_init(&view, map->data, map->size) != 0)
+    return 0;
+  return view.rom_size;
+}
+
+// ROM size of all members of an archive
+static size_t archive_rom_size(const oc8_bin_archive_t *ar) {
+  size_t res = 0;
+  for (size_t i = 0; i < ar->nb_members; ++i) {
+    oc8_bin_pack_member_t member;
+    oc8_bin_file_view_t view;
+    oc8_bin_archive_get(ar, i, &member);
+    if (oc8_bin_file_view_init(&view, member.data, member.size) == 0)
+      res += view.rom_size;
+  }
+  return res;
+}
+
+// The start code is a single jump
+static size_t without_start(size_t rom_size) {
+  return rom_size >= 2 ? rom_size - 2 : 0;
+}
+
+// @returns 0 if success, != 0 on error (printed)
+static int run_job(link_job_t *job, oc8_ld_link_res_t *res) {
+  uint64_t version = OC8_LD_CACHE_VERSION;
+  uint64_t use_gc = job->use_gc;
+  uint64_t use_icf = job->use_icf;
+  uint64_t lto_max_size = job->lto_max_size;
+  uint64_t key = oc8_bin_hash_str("oc8-ld", OC8_BIN_HASH_INIT);
+  key = oc8_bin_hash(&version, sizeof(version), key);
+  key = oc8_bin_hash(&use_gc, sizeof(use_gc), key);
+  key = oc8_bin_hash(&use_icf, sizeof(use_icf), key);
+  if (lto_max_size)
+    key = oc8_bin_hash(&lto_max_size, sizeof(lto_max_size), key);
+  res->in_rom_size = 0;
+  for (size_t i = 0; i < job->nb_ins; ++i) {
+    input_t *in = &job->ins[i];
+    if (oc8_bin_map_open(&in->map, in->path) != 0) {
+      fprintf(stderr, "oc8-ld: Failed to read file `%s'.\n", in->path);
+      return -1;
+    }
+    in->st.content = oc8_bin_hash(in->map.data, in->map.size,
+                                  OC8_BIN_HASH_INIT);
+    key = oc8_bin_hash(&in->st.content, sizeof(in->st.content), key);
+    in->is_archive =
+        oc8_bin_archive_init(&in->ar, in->map.data, in->map.size) == 0;
+    job->has_archives |= in->is_archive;
+    res->in_rom_size += in->is_archive ? archive_rom_size(&in->ar)
+                                       : map_rom_size(&in->map);
+  }
+
+  const oc8_bin_cache_t *cache = job->cache;
+  if (cache && !job->map &&
+      oc8_bin_cache_get(cache, key, "c8bin", job->out_path) == 0) {
+    oc8_bin_map_t map;
+    res->kind = OC8_LD_LINK_CACHED;
+    res->out_rom_size = 0;
+    if (oc8_bin_map_open(&map, job->out_path) == 0) {
+      res->out_rom_size = without_start(map_rom_size(&map));
+      oc8_bin_map_close(&map);
+    }
+    return 0;
+  }
+
+  res->kind = OC8_LD_LINK_FULL;
+  oc8_bin_file_t out_bf;
+  uint64_t prev_key;
+  // The incremental link keeps all units whole, and needs one unit per input
+  int use_state = cache && !job->use_gc && !job->use_icf &&
+                  !job->lto_max_size && !job->has_archives;
+  unit_state_t *prev =
+      use_state && !job->map ? read_state(job, &prev_key) : NULL;
+  int err = prev ? link_incremental(job, prev, prev_key, &out_bf) : 1;
+  free(prev);
+  if (err == 0)
+    res->kind = OC8_LD_LINK_INCREMENTAL;
+  else if (err > 0)
+    err = link_full(job, &out_bf);
+  if (err)
+    return -1;
+
+  // `out_bf` is in the arena of the job
+  if (oc8_bin_file_validate(&out_bf, /*is_bin=*/1) != 0 ||
+      oc8_bin_write_to_file(&out_bf, job->out_path) != 0)
+    return -1;
+  res->out_rom_size = without_start(out_bf.rom_size);
+  if (cache && oc8_bin_cache_put(cache, key, "c8bin", job->out_path) == 0 &&
+      use_state)
+    write_state(job, key);
+  return 0;
+}
+
+int oc8_ld_link_files(const char *const *in_paths, size_t nb_inputs,
+                      const char *out_path, const oc8_ld_link_opts_t *opts,
+                      oc8_ld_link_res_t *res) {
+  link_job_t job;
+  job.ins = calloc(nb_inputs, sizeof(input_t));
+  job.nb_ins = nb_inputs;
+  job.out_path = out_path;
+  job.cache = opts ? opts->cache : NULL;
+  job.pool = opts ? opts->pool : NULL;
+  job.use_gc = opts ? opts->use_gc : 0;
+  job.use_icf = opts ? opts->use_icf : 0;
+  job.lto_max_size = opts ? opts->lto_max_size : 0;
+  job.report = opts ? opts->report : NULL;
+  job.map = opts ? opts->map : NULL;
+  job.has_archives = 0;
+  oc8_arena_init(&job.arena, 0);
+  for (size_t i = 0; i < nb_inputs; ++i)
+    job.ins[i].path = in_paths[i];
+
+  oc8_ld_link_res_t job_res;
+  int err = run_job(&job, &job_res);
+  free_job(&job);
+  if (err) {
+    // The message was already printed
+    fprintf(stderr, "oc8-ld: Failed to link `%s'.\n", out_path);
+    return -1;
+  }
+  if (res)
+    *res = job_res;
+  return 0;
+}
@@ -1,6 +1,9 @@
 #include "oc8_ld/linker.h"
 #include "oc8_defs/debug.h"
 #include "oc8_is/ins.h"
+#include "oc8_ld/archive.h"
+#include "oc8_ld/lto.h"
+#include "oc8_ld/pieces.h"
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -9,16 +12,33 @@
 #define UNITS_ALLOC_BASE (8)
 
 void oc8_ld_linker_init(oc8_ld_linker_t *ld, int use_start_sym) {
+  oc8_ld_linker_init_arena(ld, use_start_sym, NULL);
+}
+
+void oc8_ld_linker_init_arena(oc8_ld_linker_t *ld, int use_start_sym,
+                              oc8_arena_t *arena) {
+  ld->arena = arena;
   ld->units_size = 0;
   ld->units_cap = UNITS_ALLOC_BASE;
-  ld->units_arr = malloc(ld->units_cap * sizeof(oc8_ld_unit_t *));
+  ld->units_arr =
+      oc8_arena_alloc(arena, ld->units_cap * sizeof(oc8_ld_unit_t *));
   ld->use_start_bf = 0;
+  ld->archives_arr = NULL;
+  ld->archives_size = 0;
+  ld->archives_cap = 0;
+  ld->pool = NULL;
+  ld->use_gc = 0;
+  ld->use_icf = 0;
+  ld->lto_max_size = 0;
+  ld->inlined_arr = NULL;
+  ld->inlined_size = 0;
+  ld->inlined_cap = 0;
 
   if (use_start_sym) {
     oc8_bin_file_t *bf = &ld->start_bf;
     ld->use_start_bf = 1;
-    oc8_bin_file_init(bf);
-    oc8_bin_file_set_version(bf, 10);
+    oc8_bin_file_init_arena(bf, arena);
+    oc8_bin_file_set_version(bf, OC8_BIN_VERSION);
     oc8_bin_file_set_type(bf, OC8_BIN_FILE_TYPE_BIN);
     oc8_bin_file_set_defs_count(bf, 2);
     oc8_bin_file_add_def(bf, "_rom_begin", 0, OC8_BIN_SYM_TYPE_NO,
@@ -33,159 +53,294 @@ void oc8_ld_linker_init(oc8_ld_linker_t *ld, int use_start_sym) {
     jmp_ins.operands[0] = 0;
     oc8_is_encode_ins(&jmp_ins, (char *)bf->rom);
 
-    oc8_ld_linker_add(ld, bf);
+    oc8_ld_linker_add_named(ld, bf, "<start>");
   }
 }
 
 void oc8_ld_linker_free(oc8_ld_linker_t *ld) {
   for (size_t i = 0; i < ld->units_size; ++i) {
     oc8_ld_unit_t *unit = ld->units_arr[i];
-    free(unit->syms_map);
-    free(unit);
+    oc8_arena_release(ld->arena, unit->pieces);
+    oc8_arena_release(ld->arena, unit->syms_map);
+    if (unit->owns_bf) {
+      oc8_bin_file_free(unit->bf);
+      oc8_arena_release(ld->arena, unit->bf);
+    }
+    oc8_arena_release(ld->arena, unit);
   }
 
   if (ld->use_start_bf)
     oc8_bin_file_free(&ld->start_bf);
 
-  free(ld->units_arr);
+  oc8_arena_release(ld->arena, ld->inlined_arr);
+  oc8_arena_release(ld->arena, ld->archives_arr);
+  oc8_arena_release(ld->arena, ld->units_arr);
 }
 
 void oc8_ld_linker_add(oc8_ld_linker_t *ld, oc8_bin_file_t *bf) {
+  oc8_ld_linker_add_named(ld, bf, NULL);
+}
+
+void oc8_ld_linker_add_named(oc8_ld_linker_t *ld, oc8_bin_file_t *bf,
+                             const char *name) {
   if (ld->units_size == ld->units_cap) {
+    size_t old_size = ld->units_cap * sizeof(oc8_ld_unit_t *);
     ld->units_cap *= 2;
-    ld->units_arr =
-        realloc(ld->units_arr, ld->units_cap * sizeof(oc8_ld_unit_t *));
+    ld->units_arr = oc8_arena_realloc(ld->arena, ld->units_arr, old_size,
+                                      ld->units_cap * sizeof(oc8_ld_unit_t *));
   }
 
-  oc8_ld_unit_t *unit = malloc(sizeof(oc8_ld_unit_t));
+  oc8_ld_unit_t *unit = oc8_arena_alloc(ld->arena, sizeof(oc8_ld_unit_t));
   unit->bf = bf;
   unit->syms_map = NULL;
+  unit->pieces = NULL;
+  unit->nb_pieces = 0;
+  unit->owns_bf = 0;
+  unit->name = name;
 
   ld->units_arr[ld->units_size++] = unit;
 }
 
-static inline uint16_t check_val(uint16_t val, uint16_t max,
-                                 uint16_t ins_addr) {
+void oc8_ld_linker_add_archive(oc8_ld_linker_t *ld,
+                               const oc8_bin_archive_t *ar) {
+  if (ld->archives_size == ld->archives_cap) {
+    size_t old_size = ld->archives_cap * sizeof(oc8_bin_archive_t *);
+    ld->archives_cap = ld->archives_cap ? 2 * ld->archives_cap : 4;
+    ld->archives_arr = oc8_arena_realloc(
+        ld->arena, ld->archives_arr, old_size,
+        ld->archives_cap * sizeof(oc8_bin_archive_t *));
+  }
+  ld->archives_arr[ld->archives_size++] = ar;
+}
+
+// @returns 0 if `val` fits in `max`, != 0 otherwise (printed)
+static inline int check_val(uint16_t val, uint16_t max, uint16_t ins_addr) {
   if (val > max) {
     fprintf(stderr,
             "Linker cannot resolve value when fixing instruction at %x\n: "
             "value is %u, but max is %u.\n",
             (unsigned)ins_addr, (unsigned)val, (unsigned)max);
-    PANIC();
+    return -1;
   }
-  return val;
+  return 0;
 }
 
-// Change the opcode of the instruction at `ins_addr`
-// `val` if the value of the label
-static void fix_opcode(uint8_t *rom, uint16_t ins_addr, uint16_t val) {
-  char *ins_ptr = (char *)&rom[ins_addr - OC8_ROM_START];
-  oc8_is_ins_t ins;
-  if (oc8_is_decode_ins(&ins, ins_ptr) != 0) {
-    fprintf(stderr, "Linker failed to decode insstruction at %x.\n",
-            (unsigned)ins_addr);
-    PANIC();
+// Find the immediate field of the instruction `ins` from its first nibble,
+// without decoding it
+// @returns 0 if found, != 0 if it has none
+static int find_patch_kind(const uint8_t *ins, oc8_ld_patch_kind_t *kind) {
+  switch (ins[0] >> 4) {
+  case 0x0:
+    // 00E0 and 00EE aren't 0NNN
+    if (ins[0] == 0 && (ins[1] == 0xE0 || ins[1] == 0xEE))
+      return -1;
+    *kind = OC8_LD_PATCH_NNN;
+    return 0;
+  case 0x1:
+  case 0x2:
+  case 0xA:
+  case 0xB:
+    *kind = OC8_LD_PATCH_NNN;
+    return 0;
+  case 0x3:
+  case 0x4:
+  case 0x6:
+  case 0x7:
+  case 0xC:
+    *kind = OC8_LD_PATCH_NN;
+    return 0;
+  case 0xD:
+    *kind = OC8_LD_PATCH_N;
+    return 0;
+  default:
+    return -1;
   }
-  ins.opcode = 0;
-
-  switch (ins.type) {
-  case OC8_IS_TYPE_2NNN:
-  case OC8_IS_TYPE_1NNN:
-  case OC8_IS_TYPE_BNNN:
-  case OC8_IS_TYPE_ANNN:
-  case OC8_IS_TYPE_0NNN:
-    ins.operands[0] = check_val(val, 0xFFF, ins_addr);
-    break;
-
-  case OC8_IS_TYPE_7XNN:
-  case OC8_IS_TYPE_6XNN:
-  case OC8_IS_TYPE_CXNN:
-  case OC8_IS_TYPE_3XNN:
-  case OC8_IS_TYPE_4XNN:
-    ins.operands[1] = check_val(val, 0xFF, ins_addr);
-    break;
+}
 
-  case OC8_IS_TYPE_DXYN:
-    ins.operands[2] = check_val(val, 0xF, ins_addr);
-    break;
+// Same as `find_patch_kind`, but the error is printed, with the same messages
+// as a full decode
+static int get_patch_kind(const uint8_t *ins, uint16_t ins_addr,
+                          oc8_ld_patch_kind_t *kind) {
+  if (find_patch_kind(ins, kind) == 0)
+    return 0;
 
-  default:
+  oc8_is_ins_t dec;
+  if (oc8_is_decode_ins(&dec, (const char *)ins) != 0)
+    fprintf(stderr, "Linker failed to decode insstruction at %x.\n",
+            (unsigned)ins_addr);
+  else
     fprintf(stderr,
             "Linker received an instruction to fix without immediate at %x.\n",
             (unsigned)ins_addr);
-    PANIC();
-  }
+  return -1;
+}
 
-  ins.opcode = 0;
-  if (oc8_is_encode_ins(&ins, ins_ptr) != 0) {
-    fprintf(stderr, "Linker failed to encode instruction at %x.\n",
-            (unsigned)ins_addr);
-    PANIC();
+static const uint16_t patch_max[] = {0xFFF, 0xFF, 0xF};
+
+// Masked store of the immediate field, can't fail
+static inline void apply_patch(uint8_t *ins, oc8_ld_patch_kind_t kind,
+                               uint16_t val) {
+  switch (kind) {
+  case OC8_LD_PATCH_NNN:
+    ins[0] = (ins[0] & 0xF0) | (val >> 8);
+    ins[1] = val & 0xFF;
+    break;
+  case OC8_LD_PATCH_NN:
+    ins[1] = val;
+    break;
+  case OC8_LD_PATCH_N:
+    ins[1] = (ins[1] & 0xF0) | val;
+    break;
   }
 }
 
-void oc8_ld_linker_link(oc8_ld_linker_t *ld, oc8_bin_file_t *out_bf) {
+int oc8_ld_get_patch_kind(const uint8_t *ins, oc8_ld_patch_kind_t *kind) {
+  return find_patch_kind(ins, kind);
+}
 
-  // Initialize output bin file
-  oc8_bin_file_init(out_bf);
-  oc8_bin_file_set_version(out_bf, 10);
-  oc8_bin_file_set_type(out_bf, OC8_BIN_FILE_TYPE_BIN);
+void oc8_ld_apply_patch(uint8_t *ins, oc8_ld_patch_kind_t kind, uint16_t val) {
+  apply_patch(ins, kind, val);
+}
 
-  // Step 1)
-  size_t out_rom_off = OC8_ROM_START;
-  for (size_t i = 0; i < ld->units_size; ++i) {
-    oc8_ld_unit_t *unit = ld->units_arr[i];
-    unit->rom_addr = out_rom_off;
-    out_rom_off += unit->bf->rom_size;
-  }
-  size_t out_rom_size = out_rom_off - OC8_ROM_START;
-  if (out_rom_off > OC8_MEMORY_SIZE) {
-    fprintf(stderr,
-            "Output ROM too big; max address is %u, but %u is reached.\n",
-            (unsigned)OC8_MEMORY_SIZE, (unsigned)out_rom_off);
-    PANIC();
+int oc8_ld_fix_opcode(uint8_t *rom, uint16_t ins_addr, uint16_t val) {
+  uint8_t *ins = &rom[ins_addr - OC8_ROM_START];
+  oc8_ld_patch_kind_t kind;
+  if (get_patch_kind(ins, ins_addr, &kind) != 0 ||
+      check_val(val, patch_max[kind], ins_addr) != 0)
+    return -1;
+  apply_patch(ins, kind, val);
+  return 0;
+}
+
+void oc8_ld_linker_set_pool(oc8_ld_linker_t *ld, oc8_pool_t *pool) {
+  ld->pool = pool;
+}
+
+void oc8_ld_linker_set_gc(oc8_ld_linker_t *ld, int use_gc) {
+  ld->use_gc = use_gc;
+}
+
+void oc8_ld_linker_set_icf(oc8_ld_linker_t *ld, int use_icf) {
+  ld->use_icf = use_icf;
+}
+
+void oc8_ld_linker_set_lto(oc8_ld_linker_t *ld, uint16_t max_size) {
+  ld->lto_max_size = max_size;
+}
+
+static inline const oc8_ld_piece_t *get_piece(const oc8_ld_unit_t *unit,
+                                              uint16_t off) {
+  return &unit->pieces[oc8_ld_find_piece(unit, off)];
+}
+
+// Its symbol defs are in the output
+static inline int is_live(const oc8_ld_unit_t *unit, uint16_t addr) {
+  if (!unit->pieces)
+    return 1;
+  return unit->nb_pieces && get_piece(unit, addr - OC8_ROM_START)->is_live;
+}
+
+// Its bytes and refs are in the output
+static inline int is_kept(const oc8_ld_unit_t *unit, uint16_t addr) {
+  if (!unit->pieces)
+    return 1;
+  if (!unit->nb_pieces)
+    return 0;
+  const oc8_ld_piece_t *piece = get_piece(unit, addr - OC8_ROM_START);
+  return piece->is_live && !piece->is_folded;
+}
+
+// Address in the output of the offset `off` in the obj ROM
+static uint16_t out_addr(const oc8_ld_linker_t *ld, const oc8_ld_unit_t *unit,
+                         uint16_t off) {
+  if (!unit->pieces)
+    return unit->rom_addr + off;
+  const oc8_ld_piece_t *piece = get_piece(unit, off);
+  off -= piece->begin;
+  if (piece->is_folded) {
+    unit = ld->units_arr[piece->kept_unit];
+    piece = &unit->pieces[piece->kept_piece];
   }
+  return unit->rom_addr + piece->out_off + off;
+}
 
-  // Step 2)
-  // Count number of defs first
-  size_t nb_defs = 0;
-  for (size_t i = 0; i < ld->units_size; ++i) {
-    oc8_ld_unit_t *unit = ld->units_arr[i];
-    for (size_t j = 0; j < unit->bf->syms_defs_size; ++j) {
-      oc8_bin_sym_def_t *def = &unit->bf->syms_defs[j];
-      nb_defs += def->addr != 0;
+// Ref of the output, with its precomputed patch
+typedef struct {
+  uint16_t rom_off; // offset of the instruction in the output ROM
+  uint16_t val;
+  oc8_ld_patch_kind_t kind;
+} patch_t;
+
+typedef struct {
+  oc8_ld_linker_t *ld;
+  oc8_bin_file_t *out_bf;
+  patch_t *patches;
+} patch_job_t;
+
+// Steps 5) and 6) for one unit, units are disjoint parts of the ROM
+static void patch_unit(void *arg, size_t idx) {
+  patch_job_t *job = (patch_job_t *)arg;
+  oc8_ld_unit_t *unit = job->ld->units_arr[idx];
+  uint8_t *out_rom = job->out_bf->rom;
+  uint8_t *out = out_rom + unit->rom_addr - OC8_ROM_START;
+  if (!unit->pieces)
+    memcpy(out, unit->bf->rom, unit->bf->rom_size);
+  else {
+    // Padding bytes are 0
+    memset(out, 0, unit->out_size);
+    for (size_t i = 0; i < unit->nb_pieces; ++i) {
+      oc8_ld_piece_t *piece = &unit->pieces[i];
+      if (piece->is_live && !piece->is_folded)
+        memcpy(out + piece->out_off, unit->bf->rom + piece->begin,
+               piece->end - piece->begin);
     }
   }
-  oc8_bin_file_set_defs_count(out_bf, nb_defs);
 
+  patch_t *patches = job->patches + unit->refs_begin;
+  for (size_t i = 0; i < unit->refs_size; ++i)
+    apply_patch(out_rom + patches[i].rom_off, patches[i].kind,
+                patches[i].val);
+}
+
+// Steps 2) to 4), once the addresses of the units are known
+// `patches` is set even on error
+// @returns 0 if success, != 0 on error (printed)
+static int link_syms(oc8_ld_linker_t *ld, oc8_bin_file_t *out_bf,
+                     size_t nb_defs, patch_t *patches) {
+  // Step 2)
+  oc8_bin_file_set_defs_count(out_bf, nb_defs);
   for (size_t i = 0; i < ld->units_size; ++i) {
     oc8_ld_unit_t *unit = ld->units_arr[i];
-    unit->syms_map = malloc(unit->bf->syms_defs_size * sizeof(uint16_t));
+    unit->syms_map = oc8_arena_alloc(
+        ld->arena, unit->bf->syms_defs_size * sizeof(uint16_t));
 
     for (size_t j = 0; j < unit->bf->syms_defs_size; ++j) {
       oc8_bin_sym_def_t *def = &unit->bf->syms_defs[j];
-      if (def->addr == 0)
+      if (def->addr == 0 || !is_live(unit, def->addr))
         continue;
 
       const char *new_def_name = def->name;
       int new_def_global = def->is_global;
       oc8_bin_sym_type_t new_def_type = def->type;
-      uint16_t new_def_addr = def->addr - OC8_ROM_START + unit->rom_addr;
+      uint16_t new_def_addr = out_addr(ld, unit, def->addr - OC8_ROM_START);
 
       if (new_def_global &&
           oc8_smap_find(&out_bf->globals, new_def_name) != NULL) {
         fprintf(stderr, "Linker error: multiple definitions of `%s'.\n",
                 new_def_name);
-        PANIC();
+        return -1;
       }
 
-      uint16_t new_sym_id = oc8_bin_file_add_def(
+      int new_sym_id = oc8_bin_file_add_def(
           out_bf, new_def_name, new_def_global, new_def_type, new_def_addr);
+      if (new_sym_id < 0 ||
+          oc8_bin_file_set_def_size(out_bf, new_sym_id, def->size) != 0)
+        return -1;
       unit->syms_map[def->id] = new_sym_id;
     }
   }
 
-  // Step 3)
+  // Steps 3) and 4), with the patch of every ref: all addresses are known
   for (size_t i = 0; i < ld->units_size; ++i) {
     oc8_ld_unit_t *unit = ld->units_arr[i];
     for (size_t j = 0; j < unit->bf->syms_defs_size; ++j) {
@@ -193,41 +348,120 @@ void oc8_ld_linker_link(oc8_ld_linker_t *ld, oc8_bin_file_t *out_bf) {
       if (def->addr != 0)
         continue;
 
+      // Only used by removed pieces, or undefined
       oc8_smap_node_t *node = oc8_smap_find(&out_bf->globals, def->name);
+      if (node == NULL && ld->use_gc) {
+        unit->syms_map[def->id] = (uint16_t)-1;
+        continue;
+      }
       if (node == NULL) {
         fprintf(stderr, "Linker error: undefined reference to `%s'.\n",
                 def->name);
-        PANIC();
+        return -1;
       }
       unit->syms_map[def->id] = (uint16_t)node->val;
     }
-  }
 
-  // Step 4)
-  for (size_t i = 0; i < ld->units_size; ++i) {
-    oc8_ld_unit_t *unit = ld->units_arr[i];
+    size_t nb_patches = 0;
     for (size_t j = 0; j < unit->bf->syms_refs_size; ++j) {
       oc8_bin_sym_ref_t *ref = &unit->bf->syms_refs[j];
-      uint16_t new_ins_addr = ref->ins_addr - OC8_ROM_START + unit->rom_addr;
+      if (!is_kept(unit, ref->ins_addr))
+        continue;
+      size_t ins_off = ref->ins_addr - OC8_ROM_START;
+      uint16_t new_ins_addr = out_addr(ld, unit, ins_off);
       uint16_t new_sym_id = unit->syms_map[ref->sym_id];
       assert(new_sym_id < nb_defs);
-
       oc8_bin_file_add_ref(out_bf, new_ins_addr, new_sym_id);
+
+      // The instruction must be in the obj ROM, and in a single piece
+      size_t end =
+          unit->pieces ? get_piece(unit, ins_off)->end : unit->bf->rom_size;
+      if (ins_off + 2 > end) {
+        fprintf(stderr, "Linker failed to decode insstruction at %x.\n",
+                (unsigned)new_ins_addr);
+        return -1;
+      }
+      patch_t *patch = &patches[unit->refs_begin + nb_patches++];
+      patch->rom_off = new_ins_addr - OC8_ROM_START;
+      patch->val = out_bf->syms_defs[new_sym_id].addr;
+      if (get_patch_kind(unit->bf->rom + ins_off, new_ins_addr,
+                         &patch->kind) != 0 ||
+          check_val(patch->val, patch_max[patch->kind], new_ins_addr) != 0)
+        return -1;
     }
   }
+  return 0;
+}
 
-  // Step 5)
-  oc8_bin_file_init_rom(out_bf, out_rom_size);
+int oc8_ld_linker_link(oc8_ld_linker_t *ld, oc8_bin_file_t *out_bf) {
+
+  // Initialize output bin file
+  oc8_bin_file_init_arena(out_bf, ld->arena);
+  oc8_bin_file_set_version(out_bf, OC8_BIN_VERSION);
+  oc8_bin_file_set_type(out_bf, OC8_BIN_FILE_TYPE_BIN);
+
+  // Members of archives needed by the units
+  if ((ld->archives_size && oc8_ld_extract_members(ld, NULL) != 0) ||
+      (ld->lto_max_size && oc8_ld_inline_calls(ld, NULL) != 0)) {
+    oc8_bin_file_free(out_bf);
+    return -1;
+  }
+
+  // Step 0), all units are kept whole without it
+  if (ld->use_gc || ld->use_icf) {
+    if (oc8_ld_collect_pieces(ld) != 0) {
+      oc8_bin_file_free(out_bf);
+      return -1;
+    }
+  } else
+    for (size_t i = 0; i < ld->units_size; ++i) {
+      oc8_ld_unit_t *unit = ld->units_arr[i];
+      unit->out_size = unit->bf->rom_size;
+      unit->refs_size = unit->bf->syms_refs_size;
+    }
+
+  // Step 1), and count defs and refs
+  size_t out_rom_off = OC8_ROM_START;
+  size_t nb_defs = 0;
+  size_t nb_refs = 0;
   for (size_t i = 0; i < ld->units_size; ++i) {
     oc8_ld_unit_t *unit = ld->units_arr[i];
-    memcpy(out_bf->rom + unit->rom_addr - OC8_ROM_START, unit->bf->rom,
-           unit->bf->rom_size);
+    unit->rom_addr = out_rom_off;
+    unit->refs_begin = nb_refs;
+    out_rom_off += unit->out_size;
+    nb_refs += unit->refs_size;
+    for (size_t j = 0; j < unit->bf->syms_defs_size; ++j) {
+      uint16_t addr = unit->bf->syms_defs[j].addr;
+      nb_defs += addr != 0 && is_live(unit, addr);
+    }
+  }
+  size_t out_rom_size = out_rom_off - OC8_ROM_START;
+  if (out_rom_off > OC8_MEMORY_SIZE) {
+    fprintf(stderr,
+            "Output ROM too big; max address is %u, but %u is reached "
+            "(%u bytes over).\n",
+            (unsigned)OC8_MEMORY_SIZE, (unsigned)out_rom_off,
+            (unsigned)(out_rom_off - OC8_MEMORY_SIZE));
+    oc8_bin_file_free(out_bf);
+    return -1;
   }
 
-  // Step 6)
-  for (size_t i = 0; i < out_bf->syms_refs_size; ++i) {
-    oc8_bin_sym_ref_t *ref = &out_bf->syms_refs[i];
-    uint16_t val = out_bf->syms_defs[ref->sym_id].addr;
-    fix_opcode(out_bf->rom, ref->ins_addr, val);
+  // Steps 2) to 4)
+  patch_t *patches = oc8_arena_alloc(ld->arena, nb_refs * sizeof(patch_t));
+  if (link_syms(ld, out_bf, nb_defs, patches) != 0) {
+    oc8_arena_release(ld->arena, patches);
+    oc8_bin_file_free(out_bf);
+    return -1;
   }
+
+  // Steps 5) and 6)
+  oc8_bin_file_init_rom(out_bf, out_rom_size);
+  patch_job_t job = {ld, out_bf, patches};
+  if (ld->pool)
+    oc8_pool_run(ld->pool, patch_unit, &job, ld->units_size);
+  else
+    for (size_t i = 0; i < ld->units_size; ++i)
+      patch_unit(&job, i);
+  oc8_arena_release(ld->arena, patches);
+  return 0;
 }
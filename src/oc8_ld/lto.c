@@ -0,0 +1,442 @@
+#include "oc8_ld/lto.h"
+#include "oc8_as/as.h"
+#include "oc8_as/opt.h"
+#include "oc8_is/ins.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define OPCODE_SIZE (2)
+
+typedef enum {
+  LEAF_NO,
+  LEAF_LOCAL,  // uses local symbols, only inlined in its own unit
+  LEAF_GLOBAL, // inlined in any unit
+} leaf_kind_t;
+
+typedef struct {
+  oc8_ld_linker_t *ld;
+  oc8_smap_t globals; // val is unit index << 16 | sym id
+
+  // For every object unit, NULL for the others
+  uint8_t **leaves;   // [sym_id] => leaf_kind_t
+  uint32_t **refs_at; // [offset] => index of the ref at offset + 1, or 0
+} ctx_t;
+
+// @returns 0 if the bytes at `off` are an instruction, decoded in `ins`,
+// that is encoded the same way again
+static int get_ins(const oc8_bin_file_t *bf, size_t off, oc8_is_ins_t *ins) {
+  if (off + OPCODE_SIZE > bf->rom_size ||
+      oc8_is_try_decode_ins(ins, (const char *)bf->rom + off) != 0)
+    return -1;
+  oc8_is_ins_t copy = *ins;
+  copy.opcode = 0;
+  oc8_is_encode_ins(&copy, NULL);
+  return copy.opcode == ins->opcode ? 0 : -1;
+}
+
+static int is_skip(oc8_is_type_t type) {
+  return type == OC8_IS_TYPE_3XNN || type == OC8_IS_TYPE_4XNN ||
+         type == OC8_IS_TYPE_5XY0 || type == OC8_IS_TYPE_9XY0 ||
+         type == OC8_IS_TYPE_EX9E || type == OC8_IS_TYPE_EXA1;
+}
+
+static int is_jump(oc8_is_type_t type) {
+  return type == OC8_IS_TYPE_0NNN || type == OC8_IS_TYPE_1NNN ||
+         type == OC8_IS_TYPE_2NNN || type == OC8_IS_TYPE_BNNN;
+}
+
+static const char *ref_name(const oc8_bin_file_t *bf, uint32_t ref) {
+  return bf->syms_defs[bf->syms_refs[ref - 1].sym_id].name;
+}
+
+// @returns NULL if a ref is invalid (printed)
+static uint32_t *index_refs(oc8_arena_t *arena, const oc8_bin_file_t *bf) {
+  uint32_t *res = oc8_arena_alloc(arena, (bf->rom_size + 1) * sizeof(uint32_t));
+  memset(res, 0, (bf->rom_size + 1) * sizeof(uint32_t));
+  for (size_t i = 0; i < bf->syms_refs_size; ++i) {
+    size_t off = bf->syms_refs[i].ins_addr - OC8_ROM_START;
+    if (bf->syms_refs[i].ins_addr < OC8_ROM_START ||
+        off + OPCODE_SIZE > bf->rom_size ||
+        bf->syms_refs[i].sym_id >= bf->syms_defs_size) {
+      fprintf(stderr, "Linker error: invalid ref at 0x%X.\n",
+              (unsigned)bf->syms_refs[i].ins_addr);
+      oc8_arena_release(arena, res);
+      return NULL;
+    }
+    res[off] = (uint32_t)i + 1;
+  }
+  return res;
+}
+
+static leaf_kind_t get_leaf_kind(const ctx_t *ctx, size_t unit_idx,
+                                 const oc8_bin_sym_def_t *def) {
+  const oc8_bin_file_t *bf = ctx->ld->units_arr[unit_idx]->bf;
+  const uint32_t *refs_at = ctx->refs_at[unit_idx];
+  size_t begin = def->addr - OC8_ROM_START;
+  size_t end = begin + def->size;
+  if (def->type != OC8_BIN_SYM_TYPE_FUN || def->addr < OC8_ROM_START ||
+      def->size < OPCODE_SIZE || def->size % OPCODE_SIZE != 0 ||
+      def->size > ctx->ld->lto_max_size || end > bf->rom_size)
+    return LEAF_NO;
+
+  leaf_kind_t res = LEAF_GLOBAL;
+  for (size_t off = begin; off < end; off += OPCODE_SIZE) {
+    oc8_is_ins_t ins;
+    int is_last = off + OPCODE_SIZE == end;
+    if (get_ins(bf, off, &ins) != 0 || refs_at[off + 1] ||
+        is_jump(ins.type) || (ins.type == OC8_IS_TYPE_00EE) != is_last ||
+        (off + 2 * OPCODE_SIZE == end && is_skip(ins.type)))
+      return LEAF_NO;
+    if (refs_at[off]) {
+      const oc8_bin_sym_def_t *sym =
+          &bf->syms_defs[bf->syms_refs[refs_at[off] - 1].sym_id];
+      if (sym->addr != 0 && !sym->is_global)
+        res = LEAF_LOCAL;
+    }
+  }
+  return res;
+}
+
+// 1 if every symbol used by the body of `def` (of another unit) means the
+// same in the unit `unit_idx`: it doesn't have a local one with this name
+static int is_visible(const ctx_t *ctx, size_t unit_idx, size_t def_unit,
+                      const oc8_bin_sym_def_t *def) {
+  const oc8_bin_file_t *bf = ctx->ld->units_arr[unit_idx]->bf;
+  const oc8_bin_file_t *def_bf = ctx->ld->units_arr[def_unit]->bf;
+  const uint32_t *refs_at = ctx->refs_at[def_unit];
+  size_t begin = def->addr - OC8_ROM_START;
+  for (size_t off = begin; off < begin + def->size; off += OPCODE_SIZE) {
+    if (!refs_at[off])
+      continue;
+    const char *name = ref_name(def_bf, refs_at[off]);
+    for (size_t i = 0; i < bf->syms_defs_size; ++i)
+      if (bf->syms_defs[i].addr != 0 && !bf->syms_defs[i].is_global &&
+          bf->syms_defs[i].name == name)
+        return 0;
+  }
+  return 1;
+}
+
+// Find the leaf function called by the ref `ref` of the unit `unit_idx`
+// @returns 0 if found, with its unit in `callee_unit`, and its def in
+// `callee`
+static int find_callee(ctx_t *ctx, size_t unit_idx, uint32_t ref,
+                       size_t *callee_unit, const oc8_bin_sym_def_t **callee) {
+  const oc8_bin_file_t *bf = ctx->ld->units_arr[unit_idx]->bf;
+  uint16_t sym_id = bf->syms_refs[ref - 1].sym_id;
+  const oc8_bin_sym_def_t *def = &bf->syms_defs[sym_id];
+  if (def->addr != 0) {
+    *callee_unit = unit_idx;
+    *callee = def;
+    return ctx->leaves[unit_idx][sym_id] != LEAF_NO ? 0 : -1;
+  }
+
+  // Undefined symbols are errors of step 3)
+  oc8_smap_node_t *node = oc8_smap_find(&ctx->globals, def->name);
+  if (node == NULL)
+    return -1;
+  size_t def_unit = node->val >> 16;
+  uint16_t def_id = node->val & 0xFFFF;
+  const oc8_bin_sym_def_t *res =
+      &ctx->ld->units_arr[def_unit]->bf->syms_defs[def_id];
+  if (ctx->leaves[def_unit][def_id] != LEAF_GLOBAL ||
+      !is_visible(ctx, unit_idx, def_unit, res))
+    return -1;
+  *callee_unit = def_unit;
+  *callee = res;
+  return 0;
+}
+
+// 1 if the unit can be lifted to assembly items, and has a call to a leaf
+// function
+static int needs_lift(ctx_t *ctx, size_t unit_idx) {
+  const oc8_bin_file_t *bf = ctx->ld->units_arr[unit_idx]->bf;
+  const uint32_t *refs_at = ctx->refs_at[unit_idx];
+  if (!refs_at || bf->rom_size == 0 || bf->syms_defs_size > OC8_AS_MAX_SYMS)
+    return 0;
+  for (size_t i = 0; i < bf->syms_defs_size; ++i) {
+    const oc8_bin_sym_def_t *def = &bf->syms_defs[i];
+    if (def->addr != 0 &&
+        (def->addr < OC8_ROM_START ||
+         (size_t)def->addr - OC8_ROM_START + def->size > bf->rom_size))
+      return 0;
+  }
+
+  // The refs must be on whole instructions, and the code can't move with a
+  // jump table
+  int has_call = 0;
+  for (size_t i = 0; i < bf->syms_refs_size; ++i) {
+    size_t off = bf->syms_refs[i].ins_addr - OC8_ROM_START;
+    oc8_is_ins_t ins;
+    if (get_ins(bf, off, &ins) != 0 || refs_at[off + 1] ||
+        ins.type == OC8_IS_TYPE_BNNN)
+      return 0;
+    for (size_t j = 0; j < bf->syms_defs_size; ++j)
+      if (bf->syms_defs[j].addr == OC8_ROM_START + off + 1)
+        return 0;
+
+    size_t callee_unit;
+    const oc8_bin_sym_def_t *callee;
+    if (ins.type == OC8_IS_TYPE_2NNN &&
+        find_callee(ctx, unit_idx, (uint32_t)i + 1, &callee_unit, &callee) ==
+            0)
+      has_call = 1;
+  }
+  return has_call;
+}
+
+static int cmp_defs(const void *a, const void *b) {
+  const oc8_bin_sym_def_t *x = *(const oc8_bin_sym_def_t *const *)a;
+  const oc8_bin_sym_def_t *y = *(const oc8_bin_sym_def_t *const *)b;
+  if (x->addr != y->addr)
+    return x->addr < y->addr ? -1 : 1;
+  return x->id < y->id ? -1 : x->id > y->id;
+}
+
+// `name` is interned
+static void add_inlined(oc8_ld_linker_t *ld, size_t unit_idx,
+                        const char *name) {
+  for (size_t i = 0; i < ld->inlined_size; ++i)
+    if (ld->inlined_arr[i].unit == unit_idx &&
+        ld->inlined_arr[i].name == name) {
+      ++ld->inlined_arr[i].nb_calls;
+      return;
+    }
+
+  if (ld->inlined_size == ld->inlined_cap) {
+    size_t old_size = ld->inlined_cap * sizeof(oc8_ld_inlined_t);
+    ld->inlined_cap = ld->inlined_cap ? 2 * ld->inlined_cap : 8;
+    ld->inlined_arr =
+        oc8_arena_realloc(ld->arena, ld->inlined_arr, old_size,
+                          ld->inlined_cap * sizeof(oc8_ld_inlined_t));
+  }
+  oc8_ld_inlined_t *res = &ld->inlined_arr[ld->inlined_size++];
+  res->unit = (uint32_t)unit_idx;
+  res->name = name;
+  res->nb_calls = 1;
+}
+
+// Add the body of the leaf function `def` to `sf`, without its `ret`
+// @returns 0 if success, != 0 on error
+static int add_body(const ctx_t *ctx, oc8_as_sfile_t *sf, size_t def_unit,
+                    const oc8_bin_sym_def_t *def) {
+  const oc8_bin_file_t *bf = ctx->ld->units_arr[def_unit]->bf;
+  const uint32_t *refs_at = ctx->refs_at[def_unit];
+  size_t begin = def->addr - OC8_ROM_START;
+  int err = 0;
+  for (size_t off = begin; off + OPCODE_SIZE < begin + def->size;
+       off += OPCODE_SIZE) {
+    oc8_is_ins_t ins;
+    get_ins(bf, off, &ins);
+    err |= oc8_as_sfile_add_ins(
+        sf, &ins, refs_at[off] ? ref_name(bf, refs_at[off]) : NULL);
+  }
+  return err;
+}
+
+// Lift the unit `unit_idx` to assembly items, with the calls to leaf
+// functions replaced by their body, and assemble it again into `out_bf`
+// The number of calls replaced is added to `*nb_calls`
+// @returns 0 if success, != 0 on error (printed), `out_bf` isn't initialized
+// then
+static int inline_unit(ctx_t *ctx, size_t unit_idx, oc8_bin_file_t *out_bf,
+                       size_t *nb_calls) {
+  oc8_ld_linker_t *ld = ctx->ld;
+  const oc8_bin_file_t *bf = ld->units_arr[unit_idx]->bf;
+  const uint32_t *refs_at = ctx->refs_at[unit_idx];
+  size_t rom_size = bf->rom_size;
+
+  // Defined symbols sorted by address, and the bytes of objects
+  const oc8_bin_sym_def_t **defs = oc8_arena_alloc(
+      ld->arena, (bf->syms_defs_size + 1) * sizeof(oc8_bin_sym_def_t *));
+  uint8_t *is_data = oc8_arena_alloc(ld->arena, rom_size + 1);
+  uint8_t *has_def = oc8_arena_alloc(ld->arena, rom_size + 1);
+  uint16_t *new_pos =
+      oc8_arena_alloc(ld->arena, (rom_size + 1) * sizeof(uint16_t));
+  memset(is_data, 0, rom_size + 1);
+  memset(has_def, 0, rom_size + 1);
+  size_t nb_defs = 0;
+  for (size_t i = 0; i < bf->syms_defs_size; ++i) {
+    const oc8_bin_sym_def_t *def = &bf->syms_defs[i];
+    if (def->addr == 0)
+      continue;
+    size_t begin = def->addr - OC8_ROM_START;
+    defs[nb_defs++] = def;
+    has_def[begin] = 1;
+    if (def->type == OC8_BIN_SYM_TYPE_OBJ)
+      memset(is_data + begin, 1, def->size);
+  }
+  qsort(defs, nb_defs, sizeof(oc8_bin_sym_def_t *), cmp_defs);
+
+  oc8_as_sfile_t *sf = oc8_as_sfile_new_arena(ld->arena);
+  size_t next_def = 0;
+  int after_skip = 0;
+  int err = 0;
+  size_t off = 0;
+  for (;;) {
+    while (next_def < nb_defs &&
+           (size_t)defs[next_def]->addr - OC8_ROM_START == off)
+      err |= oc8_as_sfile_add_sym(sf, defs[next_def++]->name);
+    new_pos[off] = sf->curr_addr;
+    if (off == rom_size)
+      break;
+
+    // Bytes that may not be code
+    oc8_is_ins_t ins;
+    uint32_t ref = refs_at[off];
+    if (!ref && (is_data[off] || off + 1 == rom_size || has_def[off + 1] ||
+                 refs_at[off + 1] || get_ins(bf, off, &ins) != 0)) {
+      oc8_as_sfile_dir_byte(sf, bf->rom[off++]);
+      after_skip = 0;
+      continue;
+    }
+
+    get_ins(bf, off, &ins);
+    new_pos[off + 1] = sf->curr_addr + 1;
+    size_t callee_unit;
+    const oc8_bin_sym_def_t *callee;
+    if (ins.type == OC8_IS_TYPE_2NNN && ref &&
+        find_callee(ctx, unit_idx, ref, &callee_unit, &callee) == 0 &&
+        (!after_skip || callee->size == 2 * OPCODE_SIZE)) {
+      err |= add_body(ctx, sf, callee_unit, callee);
+      add_inlined(ld, callee_unit, callee->name);
+      ++*nb_calls;
+      after_skip = 0;
+    } else {
+      err |= oc8_as_sfile_add_ins(sf, &ins, ref ? ref_name(bf, ref) : NULL);
+      after_skip = is_skip(ins.type);
+    }
+    off += OPCODE_SIZE;
+  }
+
+  // The sizes grow with the bodies inlined
+  for (size_t i = 0; i < nb_defs; ++i) {
+    const oc8_bin_sym_def_t *def = defs[i];
+    size_t begin = def->addr - OC8_ROM_START;
+    if (def->is_global)
+      err |= oc8_as_sfile_dir_globl(sf, def->name);
+    if (def->type == OC8_BIN_SYM_TYPE_FUN)
+      err |= oc8_as_sfile_dir_type(sf, def->name, OC8_AS_DATA_SYM_TYPE_FUN);
+    else if (def->type == OC8_BIN_SYM_TYPE_OBJ)
+      err |= oc8_as_sfile_dir_type(sf, def->name, OC8_AS_DATA_SYM_TYPE_OBJ);
+    if (def->size)
+      err |= oc8_as_sfile_dir_size(sf, def->name,
+                                   new_pos[begin + def->size] - new_pos[begin]);
+  }
+
+  if (!err && oc8_as_sfile_check(sf) == 0) {
+    oc8_as_optimize_sfile(sf, OC8_AS_OPT_JUMPS);
+    err = oc8_as_compile_sfile(sf, out_bf) != 0;
+    if (!err && oc8_bin_file_validate(out_bf, /*is_bin=*/0) != 0) {
+      oc8_bin_file_free(out_bf);
+      err = 1;
+    }
+  } else
+    err = 1;
+  if (err)
+    fprintf(stderr, "Linker error: failed to inline calls in unit #%zu.\n",
+            unit_idx);
+
+  oc8_as_sfile_free(sf);
+  oc8_arena_release(ld->arena, new_pos);
+  oc8_arena_release(ld->arena, has_def);
+  oc8_arena_release(ld->arena, is_data);
+  oc8_arena_release(ld->arena, defs);
+  return err ? -1 : 0;
+}
+
+int oc8_ld_inline_calls(oc8_ld_linker_t *ld, size_t *nb_calls) {
+  size_t nb_units = ld->units_size;
+  ctx_t ctx;
+  ctx.ld = ld;
+  oc8_smap_init_interned(&ctx.globals, ld->arena);
+  ctx.leaves = oc8_arena_alloc(ld->arena, (nb_units + 1) * sizeof(uint8_t *));
+  ctx.refs_at =
+      oc8_arena_alloc(ld->arena, (nb_units + 1) * sizeof(uint32_t *));
+  for (size_t i = 0; i < nb_units; ++i) {
+    ctx.leaves[i] = NULL;
+    ctx.refs_at[i] = NULL;
+  }
+
+  int err = 0;
+  for (size_t i = 0; i < nb_units && !err; ++i) {
+    const oc8_bin_file_t *bf = ld->units_arr[i]->bf;
+    if (bf->header.type != OC8_BIN_FILE_TYPE_OBJ)
+      continue;
+    ctx.refs_at[i] = index_refs(ld->arena, bf);
+    err = !ctx.refs_at[i];
+    for (size_t j = 0; j < bf->syms_defs_size; ++j) {
+      const oc8_bin_sym_def_t *def = &bf->syms_defs[j];
+      if (def->addr != 0 && def->is_global)
+        oc8_smap_insert(&ctx.globals, def->name, (i << 16) | j);
+    }
+  }
+
+  for (size_t i = 0; i < nb_units && !err; ++i) {
+    const oc8_bin_file_t *bf = ld->units_arr[i]->bf;
+    if (!ctx.refs_at[i])
+      continue;
+    ctx.leaves[i] = oc8_arena_alloc(ld->arena, bf->syms_defs_size + 1);
+    for (size_t j = 0; j < bf->syms_defs_size; ++j)
+      ctx.leaves[i][j] = get_leaf_kind(&ctx, i, &bf->syms_defs[j]);
+  }
+
+  // The units are changed only at the end, the bodies are read from the
+  // original objects
+  // On error, no unit is changed
+  oc8_bin_file_t **new_bfs =
+      oc8_arena_alloc(ld->arena, (nb_units + 1) * sizeof(oc8_bin_file_t *));
+  size_t nb_inlined = 0;
+  for (size_t i = 0; i < nb_units; ++i) {
+    new_bfs[i] = NULL;
+    if (err || !needs_lift(&ctx, i))
+      continue;
+    new_bfs[i] = oc8_arena_alloc(ld->arena, sizeof(oc8_bin_file_t));
+    if (inline_unit(&ctx, i, new_bfs[i], &nb_inlined) != 0) {
+      oc8_arena_release(ld->arena, new_bfs[i]);
+      new_bfs[i] = NULL;
+      err = 1;
+    }
+  }
+
+  for (size_t i = 0; i < nb_units; ++i) {
+    oc8_ld_unit_t *unit = ld->units_arr[i];
+    if (!new_bfs[i])
+      continue;
+    if (err) {
+      oc8_bin_file_free(new_bfs[i]);
+      oc8_arena_release(ld->arena, new_bfs[i]);
+      continue;
+    }
+    if (unit->owns_bf) {
+      oc8_bin_file_free(unit->bf);
+      oc8_arena_release(ld->arena, unit->bf);
+    }
+    unit->bf = new_bfs[i];
+    unit->owns_bf = 1;
+  }
+
+  oc8_arena_release(ld->arena, new_bfs);
+  for (size_t i = 0; i < nb_units; ++i) {
+    oc8_arena_release(ld->arena, ctx.leaves[i]);
+    oc8_arena_release(ld->arena, ctx.refs_at[i]);
+  }
+  oc8_arena_release(ld->arena, ctx.refs_at);
+  oc8_arena_release(ld->arena, ctx.leaves);
+  oc8_smap_free(&ctx.globals);
+  if (nb_calls)
+    *nb_calls = nb_inlined;
+  return err ? -1 : 0;
+}
+
+size_t oc8_ld_print_inlines(const oc8_ld_linker_t *ld, FILE *os) {
+  size_t nb_calls = 0;
+  for (size_t i = 0; i < ld->inlined_size; ++i) {
+    const oc8_ld_inlined_t *inlined = &ld->inlined_arr[i];
+    fprintf(os, "inlined `%s' at %zu call site%s\n", inlined->name,
+            inlined->nb_calls, inlined->nb_calls > 1 ? "s" : "");
+    nb_calls += inlined->nb_calls;
+  }
+  return nb_calls;
+}
@@ -0,0 +1,67 @@
+#include "oc8_ld/map.h"
+#include "oc8_bin/size.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+static const char *type_name(oc8_bin_sym_type_t type) {
+  switch (type) {
+  case OC8_BIN_SYM_TYPE_FUN:
+    return "function";
+  case OC8_BIN_SYM_TYPE_OBJ:
+    return "object";
+  default:
+    return "-";
+  }
+}
+
+// Bytes of the unit copied to the output
+static size_t kept_size(const oc8_ld_unit_t *unit) {
+  if (!unit->pieces)
+    return unit->out_size;
+  size_t res = 0;
+  for (size_t i = 0; i < unit->nb_pieces; ++i) {
+    const oc8_ld_piece_t *piece = &unit->pieces[i];
+    if (piece->is_live && !piece->is_folded)
+      res += piece->end - piece->begin;
+  }
+  return res;
+}
+
+void oc8_ld_print_map(const oc8_ld_linker_t *ld, const oc8_bin_file_t *out_bf,
+                      FILE *os) {
+  size_t padding = 0;
+  for (size_t i = 0; i < ld->units_size; ++i)
+    padding += ld->units_arr[i]->out_size - kept_size(ld->units_arr[i]);
+  size_t used = out_bf->rom_size;
+  fprintf(os, "ROM: %zu bytes used, %zu bytes free, %zu bytes of padding\n",
+          used, (size_t)OC8_BIN_ROM_MAX_SIZE - used, padding);
+
+  oc8_bin_sym_size_t *syms =
+      malloc((out_bf->syms_defs_size + 1) * sizeof(oc8_bin_sym_size_t));
+  size_t nb_syms = oc8_bin_get_sym_sizes(out_bf, syms);
+  size_t sym_idx = 0;
+
+  fprintf(os, "\n%7s %6s %6s %8s %8s  %s\n", "addr", "size", "input",
+          "padding", "removed", "name");
+  for (size_t i = 0; i < ld->units_size; ++i) {
+    const oc8_ld_unit_t *unit = ld->units_arr[i];
+    size_t kept = kept_size(unit);
+    fprintf(os, "\n  0x%03X %6u %6zu %8zu %8zu  %s\n",
+            (unsigned)unit->rom_addr, (unsigned)unit->out_size,
+            unit->bf->rom_size, (size_t)unit->out_size - kept,
+            unit->bf->rom_size - kept, unit->name ? unit->name : "<input>");
+
+    size_t end = unit->rom_addr + unit->out_size;
+    for (; sym_idx < nb_syms && syms[sym_idx].def->addr < end; ++sym_idx) {
+      const oc8_bin_sym_size_t *sym = &syms[sym_idx];
+      char size[8];
+      snprintf(size, sizeof(size), "%s%u", sym->is_estimated ? "~" : "",
+               (unsigned)sym->size);
+      fprintf(os, "    0x%03X %6s  %-8s %-6s %s\n", (unsigned)sym->def->addr,
+              size, type_name(sym->def->type),
+              sym->def->is_global ? "global" : "local", sym->def->name);
+    }
+  }
+  free(syms);
+}
@@ -0,0 +1,617 @@
+#include "oc8_ld/pieces.h"
+#include "oc8_bin/cache.h"
+#include "oc8_smap/oc8_strpool.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+size_t oc8_ld_find_piece(const oc8_ld_unit_t *unit, uint16_t off) {
+  size_t lo = 0;
+  size_t hi = unit->nb_pieces;
+  while (hi - lo > 1) {
+    size_t mid = (lo + hi) / 2;
+    if (unit->pieces[mid].begin <= off)
+      lo = mid;
+    else
+      hi = mid;
+  }
+  return lo;
+}
+
+typedef struct {
+  uint16_t begin;
+  uint16_t end;
+  uint16_t sym_id;
+} range_t;
+
+// By begin, the largest range first
+static int cmp_range(const void *a, const void *b) {
+  const range_t *ra = (const range_t *)a;
+  const range_t *rb = (const range_t *)b;
+  if (ra->begin != rb->begin)
+    return ra->begin < rb->begin ? -1 : 1;
+  return ra->end > rb->end ? -1 : ra->end < rb->end;
+}
+
+static void add_piece(oc8_ld_unit_t *unit, uint16_t begin, uint16_t end,
+                      int is_sized, uint16_t sym_id) {
+  oc8_ld_piece_t *piece = &unit->pieces[unit->nb_pieces++];
+  piece->begin = begin;
+  piece->end = end;
+  piece->out_off = 0;
+  piece->sym_id = sym_id;
+  piece->kept_unit = 0;
+  piece->kept_piece = 0;
+  piece->is_sized = is_sized;
+  piece->is_live = 0;
+  piece->is_folded = 0;
+}
+
+// Ranges inside or across a previous one are ignored
+static void split_unit(oc8_ld_linker_t *ld, oc8_ld_unit_t *unit) {
+  oc8_bin_file_t *bf = unit->bf;
+  range_t *ranges =
+      oc8_arena_alloc(ld->arena, (bf->syms_defs_size + 1) * sizeof(range_t));
+  size_t nb_ranges = 0;
+  for (size_t i = 0; i < bf->syms_defs_size; ++i) {
+    oc8_bin_sym_def_t *def = &bf->syms_defs[i];
+    if (def->addr < OC8_ROM_START || def->size == 0 ||
+        def->type == OC8_BIN_SYM_TYPE_NO)
+      continue;
+    size_t begin = def->addr - OC8_ROM_START;
+    if (begin + def->size <= bf->rom_size) {
+      ranges[nb_ranges].begin = begin;
+      ranges[nb_ranges].end = begin + def->size;
+      ranges[nb_ranges++].sym_id = def->id;
+    }
+  }
+  qsort(ranges, nb_ranges, sizeof(range_t), cmp_range);
+
+  unit->pieces = oc8_arena_alloc(ld->arena,
+                                 (2 * nb_ranges + 1) * sizeof(oc8_ld_piece_t));
+  unit->nb_pieces = 0;
+  uint16_t pos = 0;
+  for (size_t i = 0; i < nb_ranges; ++i) {
+    if (ranges[i].begin < pos)
+      continue;
+    if (ranges[i].begin > pos)
+      add_piece(unit, pos, ranges[i].begin, 0, 0);
+    add_piece(unit, ranges[i].begin, ranges[i].end, 1, ranges[i].sym_id);
+    pos = ranges[i].end;
+  }
+  if (pos < bf->rom_size)
+    add_piece(unit, pos, bf->rom_size, 0, 0);
+  oc8_arena_release(ld->arena, ranges);
+}
+
+typedef struct {
+  uint32_t unit;
+  uint32_t piece;
+} piece_id_t;
+
+typedef struct {
+  oc8_ld_linker_t *ld;
+  oc8_smap_t globals; // val is unit index << 16 | sym id
+
+  // For every unit, refs indices grouped by piece, sorted by address
+  uint32_t **pieces_refs;
+  uint32_t **refs;
+
+  // Global index of the first piece of every unit
+  size_t *units_base;
+  size_t nb_pieces;
+
+  piece_id_t *stack; // live pieces whose refs weren't followed yet
+  size_t stack_size;
+} ctx_t;
+
+// Find the piece of the symbol `sym_id` of the unit, and the offset in it
+// @returns 0 if found, 1 if the symbol isn't in the ROM, -1 if it's undefined
+// (printed)
+static int resolve_sym(ctx_t *ctx, size_t unit_idx, uint16_t sym_id,
+                       piece_id_t *id, uint16_t *off) {
+  oc8_bin_sym_def_t *def =
+      &ctx->ld->units_arr[unit_idx]->bf->syms_defs[sym_id];
+  if (def->addr == 0) {
+    oc8_smap_node_t *node = oc8_smap_find(&ctx->globals, def->name);
+    if (node == NULL) {
+      fprintf(stderr, "Linker error: undefined reference to `%s'.\n",
+              def->name);
+      return -1;
+    }
+    unit_idx = node->val >> 16;
+    def = &ctx->ld->units_arr[unit_idx]->bf->syms_defs[node->val & 0xFFFF];
+  }
+
+  oc8_ld_unit_t *unit = ctx->ld->units_arr[unit_idx];
+  if (def->addr < OC8_ROM_START || !unit->nb_pieces)
+    return 1;
+  uint16_t rom_off = def->addr - OC8_ROM_START;
+  id->unit = unit_idx;
+  id->piece = oc8_ld_find_piece(unit, rom_off);
+  *off = rom_off - unit->pieces[id->piece].begin;
+  return 0;
+}
+
+static void mark_piece(ctx_t *ctx, size_t unit_idx, size_t piece_idx) {
+  oc8_ld_piece_t *piece = &ctx->ld->units_arr[unit_idx]->pieces[piece_idx];
+  if (piece->is_live)
+    return;
+  piece->is_live = 1;
+  ctx->stack[ctx->stack_size].unit = unit_idx;
+  ctx->stack[ctx->stack_size++].piece = piece_idx;
+}
+
+// @returns 0 if success, != 0 if the symbol is undefined (printed)
+static int mark_sym(ctx_t *ctx, size_t unit_idx, uint16_t sym_id) {
+  piece_id_t id;
+  uint16_t off;
+  int res = resolve_sym(ctx, unit_idx, sym_id, &id, &off);
+  if (res == 0)
+    mark_piece(ctx, id.unit, id.piece);
+  return res < 0 ? -1 : 0;
+}
+
+// Group the refs of the unit by piece
+static void sort_refs(ctx_t *ctx, size_t unit_idx) {
+  oc8_ld_unit_t *unit = ctx->ld->units_arr[unit_idx];
+  oc8_arena_t *arena = ctx->ld->arena;
+  const oc8_bin_sym_ref_t *syms_refs = unit->bf->syms_refs;
+  size_t nb_refs = unit->bf->syms_refs_size;
+  uint32_t *begins =
+      oc8_arena_alloc(arena, (unit->nb_pieces + 1) * sizeof(uint32_t));
+  uint32_t *refs = oc8_arena_alloc(arena, (nb_refs + 1) * sizeof(uint32_t));
+  uint32_t *refs_piece =
+      oc8_arena_alloc(arena, (nb_refs + 1) * sizeof(uint32_t));
+
+  memset(begins, 0, (unit->nb_pieces + 1) * sizeof(uint32_t));
+  for (size_t i = 0; i < nb_refs && unit->nb_pieces; ++i) {
+    uint16_t off = syms_refs[i].ins_addr - OC8_ROM_START;
+    refs_piece[i] = oc8_ld_find_piece(unit, off);
+    ++begins[refs_piece[i] + 1];
+  }
+  for (size_t i = 0; i < unit->nb_pieces; ++i)
+    begins[i + 1] += begins[i];
+  for (size_t i = 0; i < nb_refs && unit->nb_pieces; ++i)
+    refs[begins[refs_piece[i]]++] = i;
+  // Each begin was moved to the next one
+  for (size_t i = unit->nb_pieces; i > 0; --i)
+    begins[i] = begins[i - 1];
+  begins[0] = 0;
+
+  // Insertion sort of every piece, the refs are usually already sorted
+  for (size_t p = 0; p < unit->nb_pieces; ++p)
+    for (size_t i = begins[p] + 1; i < begins[p + 1]; ++i) {
+      uint32_t ref = refs[i];
+      size_t j = i;
+      for (; j > begins[p] &&
+             syms_refs[refs[j - 1]].ins_addr > syms_refs[ref].ins_addr;
+           --j)
+        refs[j] = refs[j - 1];
+      refs[j] = ref;
+    }
+
+  oc8_arena_release(arena, refs_piece);
+  ctx->pieces_refs[unit_idx] = begins;
+  ctx->refs[unit_idx] = refs;
+}
+
+// @returns 0 if success, != 0 if a live piece uses an undefined symbol
+// (printed)
+static int mark_live(ctx_t *ctx) {
+  oc8_ld_linker_t *ld = ctx->ld;
+  if (!ld->use_gc) {
+    for (size_t i = 0; i < ld->units_size; ++i)
+      for (size_t j = 0; j < ld->units_arr[i]->nb_pieces; ++j)
+        ld->units_arr[i]->pieces[j].is_live = 1;
+    return 0;
+  }
+
+  // Roots: the start code, or the beginning of the ROM
+  if (ld->use_start_bf)
+    for (size_t i = 0; i < ld->units_arr[0]->nb_pieces; ++i)
+      mark_piece(ctx, 0, i);
+  else if (ld->units_size && ld->units_arr[0]->nb_pieces)
+    mark_piece(ctx, 0, 0);
+  oc8_smap_node_t *start =
+      oc8_smap_find(&ctx->globals, oc8_strpool_intern("_start"));
+  if (start && mark_sym(ctx, start->val >> 16, start->val & 0xFFFF) != 0)
+    return -1;
+
+  while (ctx->stack_size) {
+    piece_id_t id = ctx->stack[--ctx->stack_size];
+    oc8_ld_unit_t *unit = ld->units_arr[id.unit];
+    uint32_t *begins = ctx->pieces_refs[id.unit];
+    for (uint32_t i = begins[id.piece]; i < begins[id.piece + 1]; ++i) {
+      oc8_bin_sym_ref_t *ref = &unit->bf->syms_refs[ctx->refs[id.unit][i]];
+      if (ref->sym_id < unit->bf->syms_defs_size &&
+          mark_sym(ctx, id.unit, ref->sym_id) != 0)
+        return -1;
+    }
+    if (!unit->pieces[id.piece].is_sized && id.piece + 1 < unit->nb_pieces)
+      mark_piece(ctx, id.unit, id.piece + 1);
+  }
+  return 0;
+}
+
+typedef struct {
+  uint64_t hash;
+  uint32_t piece;
+} fold_key_t;
+
+static int cmp_fold_key(const void *a, const void *b) {
+  const fold_key_t *ka = (const fold_key_t *)a;
+  const fold_key_t *kb = (const fold_key_t *)b;
+  if (ka->hash != kb->hash)
+    return ka->hash < kb->hash ? -1 : 1;
+  return ka->piece < kb->piece ? -1 : ka->piece > kb->piece;
+}
+
+typedef struct {
+  ctx_t *ctx;
+  piece_id_t *ids; // global index => piece
+
+  // Every unit ROM, with the immediate fields of the refs set to 0
+  uint8_t **roms;
+
+  // For every ref, in the order of `ctx->refs`: global index of the target
+  // piece, and offset in it
+  uint32_t **targets;
+  uint16_t **targets_off;
+
+  // Pieces that can be folded have a class >= nb_pieces
+  // The others are alone in the class of their index
+  uint32_t *cls;
+  uint32_t *new_cls;
+  fold_key_t *keys;
+  size_t nb_keys;
+} icf_t;
+
+static inline oc8_ld_piece_t *get_piece(icf_t *icf, uint32_t g) {
+  return &icf->ctx->ld->units_arr[icf->ids[g].unit]->pieces[icf->ids[g].piece];
+}
+
+// Normalize the refs of a live sized piece, and find their targets
+// @returns 0 if the piece can be folded, 1 if it can't, -1 if it uses an
+// undefined symbol (printed)
+static int prepare_piece(icf_t *icf, piece_id_t id) {
+  ctx_t *ctx = icf->ctx;
+  oc8_ld_unit_t *unit = ctx->ld->units_arr[id.unit];
+  oc8_ld_piece_t *piece = &unit->pieces[id.piece];
+  uint32_t *begins = ctx->pieces_refs[id.unit];
+  for (uint32_t i = begins[id.piece]; i < begins[id.piece + 1]; ++i) {
+    oc8_bin_sym_ref_t *ref = &unit->bf->syms_refs[ctx->refs[id.unit][i]];
+    size_t ins_off = ref->ins_addr - OC8_ROM_START;
+    piece_id_t target;
+    uint16_t target_off;
+    oc8_ld_patch_kind_t kind;
+    uint8_t *ins = icf->roms[id.unit] + ins_off;
+    // Invalid refs are errors of the link, if the piece is kept
+    if (ins_off + 2 > piece->end || ref->sym_id >= unit->bf->syms_defs_size ||
+        oc8_ld_get_patch_kind(ins, &kind) != 0)
+      return 1;
+    int res = resolve_sym(ctx, id.unit, ref->sym_id, &target, &target_off);
+    if (res != 0)
+      return res;
+
+    oc8_ld_apply_patch(ins, kind, 0);
+    icf->targets[id.unit][i] = ctx->units_base[target.unit] + target.piece;
+    icf->targets_off[id.unit][i] = target_off;
+  }
+  return 0;
+}
+
+// First round: bytes and refs offsets, next ones: classes of refs targets
+static uint64_t hash_piece(icf_t *icf, uint32_t g, int round) {
+  piece_id_t id = icf->ids[g];
+  oc8_ld_piece_t *piece = get_piece(icf, g);
+  uint32_t *begins = icf->ctx->pieces_refs[id.unit];
+  uint64_t h = OC8_BIN_HASH_INIT;
+  if (round == 0) {
+    uint16_t len = piece->end - piece->begin;
+    h = oc8_bin_hash(&len, sizeof(len), h);
+    h = oc8_bin_hash(icf->roms[id.unit] + piece->begin, len, h);
+  } else
+    h = oc8_bin_hash(&icf->cls[g], sizeof(uint32_t), h);
+
+  for (uint32_t i = begins[id.piece]; i < begins[id.piece + 1]; ++i) {
+    oc8_bin_sym_ref_t *ref =
+        &icf->ctx->ld->units_arr[id.unit]->bf
+             ->syms_refs[icf->ctx->refs[id.unit][i]];
+    if (round == 0) {
+      uint16_t off = ref->ins_addr - OC8_ROM_START - piece->begin;
+      h = oc8_bin_hash(&off, sizeof(off), h);
+    } else {
+      h = oc8_bin_hash(&icf->cls[icf->targets[id.unit][i]], sizeof(uint32_t),
+                       h);
+      h = oc8_bin_hash(&icf->targets_off[id.unit][i], sizeof(uint16_t), h);
+    }
+  }
+  return h;
+}
+
+static int equal_pieces(icf_t *icf, uint32_t ga, uint32_t gb, int round) {
+  piece_id_t a = icf->ids[ga];
+  piece_id_t b = icf->ids[gb];
+  oc8_ld_piece_t *pa = get_piece(icf, ga);
+  oc8_ld_piece_t *pb = get_piece(icf, gb);
+  uint32_t *begins_a = icf->ctx->pieces_refs[a.unit];
+  uint32_t *begins_b = icf->ctx->pieces_refs[b.unit];
+  uint32_t nb_refs = begins_a[a.piece + 1] - begins_a[a.piece];
+  if (round == 0) {
+    uint16_t len = pa->end - pa->begin;
+    if (len != pb->end - pb->begin ||
+        nb_refs != begins_b[b.piece + 1] - begins_b[b.piece] ||
+        memcmp(icf->roms[a.unit] + pa->begin, icf->roms[b.unit] + pb->begin,
+               len) != 0)
+      return 0;
+  } else if (icf->cls[ga] != icf->cls[gb])
+    return 0;
+
+  for (uint32_t i = 0; i < nb_refs; ++i) {
+    uint32_t ia = begins_a[a.piece] + i;
+    uint32_t ib = begins_b[b.piece] + i;
+    if (round == 0) {
+      oc8_bin_file_t *bfa = icf->ctx->ld->units_arr[a.unit]->bf;
+      oc8_bin_file_t *bfb = icf->ctx->ld->units_arr[b.unit]->bf;
+      if (bfa->syms_refs[icf->ctx->refs[a.unit][ia]].ins_addr - pa->begin !=
+          bfb->syms_refs[icf->ctx->refs[b.unit][ib]].ins_addr - pb->begin)
+        return 0;
+    } else if (icf->cls[icf->targets[a.unit][ia]] !=
+                   icf->cls[icf->targets[b.unit][ib]] ||
+               icf->targets_off[a.unit][ia] != icf->targets_off[b.unit][ib])
+      return 0;
+  }
+  return 1;
+}
+
+// Put the pieces in new classes, a class is only split by a round
+// @returns the number of classes
+static size_t split_classes(icf_t *icf, int round, uint32_t *reps) {
+  size_t base = icf->ctx->nb_pieces;
+  for (size_t i = 0; i < icf->nb_keys; ++i)
+    icf->keys[i].hash = hash_piece(icf, icf->keys[i].piece, round);
+  qsort(icf->keys, icf->nb_keys, sizeof(fold_key_t), cmp_fold_key);
+
+  size_t nb_cls = 0;
+  for (size_t begin = 0, end; begin < icf->nb_keys; begin = end) {
+    // Compare with the first piece of every class of the same hash
+    size_t nb_reps = 0;
+    for (end = begin;
+         end < icf->nb_keys && icf->keys[end].hash == icf->keys[begin].hash;
+         ++end) {
+      uint32_t g = icf->keys[end].piece;
+      size_t j = 0;
+      while (j < nb_reps && !equal_pieces(icf, reps[j], g, round))
+        ++j;
+      if (j < nb_reps)
+        icf->new_cls[g] = icf->new_cls[reps[j]];
+      else {
+        reps[nb_reps++] = g;
+        icf->new_cls[g] = base + nb_cls++;
+      }
+    }
+  }
+
+  for (size_t i = 0; i < icf->nb_keys; ++i)
+    icf->cls[icf->keys[i].piece] = icf->new_cls[icf->keys[i].piece];
+  return nb_cls;
+}
+
+// Code without a size may run into the next piece, unless it ends with a
+// jump or a return
+static int may_run_into(const oc8_ld_unit_t *unit, size_t piece_idx) {
+  if (piece_idx == 0 || unit->pieces[piece_idx - 1].is_sized)
+    return 0;
+  const oc8_ld_piece_t *prev = &unit->pieces[piece_idx - 1];
+  if (prev->end - prev->begin < 2)
+    return 1;
+  const uint8_t *ins = unit->bf->rom + prev->end - 2;
+  return !(ins[0] >> 4 == 0x1 || ins[0] >> 4 == 0xB ||
+           (ins[0] == 0x00 && ins[1] == 0xEE));
+}
+
+// Only FX33 (bcd) and FX55 (movm to memory) write to memory: if no unit has
+// their bytes, even in data or at odd offsets, the objects are read-only
+static int may_write_memory(const oc8_ld_linker_t *ld) {
+  for (size_t i = 0; i < ld->units_size; ++i) {
+    const oc8_bin_file_t *bf = ld->units_arr[i]->bf;
+    for (size_t j = 0; j + 1 < bf->rom_size; ++j)
+      if (bf->rom[j] >> 4 == 0xF &&
+          (bf->rom[j + 1] == 0x33 || bf->rom[j + 1] == 0x55))
+        return 1;
+  }
+  return 0;
+}
+
+// @returns 0 if success, != 0 if a piece uses an undefined symbol (printed)
+static int fold_pieces(ctx_t *ctx) {
+  oc8_ld_linker_t *ld = ctx->ld;
+  oc8_arena_t *arena = ld->arena;
+  size_t nb_units = ld->units_size;
+  size_t nb_pieces = ctx->nb_pieces;
+  icf_t icf;
+  icf.ctx = ctx;
+  icf.ids = oc8_arena_alloc(arena, (nb_pieces + 1) * sizeof(piece_id_t));
+  icf.roms = oc8_arena_alloc(arena, (nb_units + 1) * sizeof(uint8_t *));
+  icf.targets = oc8_arena_alloc(arena, (nb_units + 1) * sizeof(uint32_t *));
+  icf.targets_off =
+      oc8_arena_alloc(arena, (nb_units + 1) * sizeof(uint16_t *));
+  icf.cls = oc8_arena_alloc(arena, (nb_pieces + 1) * sizeof(uint32_t));
+  icf.new_cls = oc8_arena_alloc(arena, (nb_pieces + 1) * sizeof(uint32_t));
+  icf.keys = oc8_arena_alloc(arena, (nb_pieces + 1) * sizeof(fold_key_t));
+  icf.nb_keys = 0;
+  int only_funs = may_write_memory(ld);
+  int err = 0;
+
+  for (size_t i = 0; i < nb_units; ++i) {
+    oc8_bin_file_t *bf = ld->units_arr[i]->bf;
+    icf.roms[i] = oc8_arena_alloc(arena, bf->rom_size + 1);
+    memcpy(icf.roms[i], bf->rom, bf->rom_size);
+    icf.targets[i] =
+        oc8_arena_alloc(arena, (bf->syms_refs_size + 1) * sizeof(uint32_t));
+    icf.targets_off[i] =
+        oc8_arena_alloc(arena, (bf->syms_refs_size + 1) * sizeof(uint16_t));
+  }
+
+  for (size_t i = 0; i < nb_units; ++i) {
+    oc8_ld_unit_t *unit = ld->units_arr[i];
+    for (size_t j = 0; j < unit->nb_pieces; ++j) {
+      size_t g = ctx->units_base[i] + j;
+      oc8_ld_piece_t *piece = &unit->pieces[j];
+      icf.ids[g].unit = i;
+      icf.ids[g].piece = j;
+      icf.cls[g] = g;
+
+      if (err || !piece->is_live || !piece->is_sized ||
+          may_run_into(unit, j) ||
+          (only_funs && unit->bf->syms_defs[piece->sym_id].type !=
+                            OC8_BIN_SYM_TYPE_FUN))
+        continue;
+      int res = prepare_piece(&icf, icf.ids[g]);
+      err = res < 0;
+      if (res != 0)
+        continue;
+      icf.keys[icf.nb_keys].hash = 0;
+      icf.keys[icf.nb_keys++].piece = g;
+    }
+  }
+  // Nothing is folded on error
+  if (err)
+    icf.nb_keys = 0;
+
+  uint32_t *reps = oc8_arena_alloc(arena, (nb_pieces + 1) * sizeof(uint32_t));
+  size_t nb_cls = split_classes(&icf, 0, reps);
+  for (int round = 1;; ++round) {
+    size_t new_nb_cls = split_classes(&icf, round, reps);
+    if (new_nb_cls == nb_cls)
+      break;
+    nb_cls = new_nb_cls;
+  }
+
+  // The piece of every class with the smallest index is kept
+  uint32_t *kept = reps;
+  for (size_t i = 0; i < nb_cls; ++i)
+    kept[i] = (uint32_t)-1;
+  for (size_t i = 0; i < icf.nb_keys; ++i) {
+    uint32_t g = icf.keys[i].piece;
+    uint32_t *cls_kept = &kept[icf.cls[g] - nb_pieces];
+    if (*cls_kept == (uint32_t)-1 || g < *cls_kept)
+      *cls_kept = g;
+  }
+  for (size_t i = 0; i < icf.nb_keys; ++i) {
+    uint32_t g = icf.keys[i].piece;
+    uint32_t k = kept[icf.cls[g] - nb_pieces];
+    if (k == g)
+      continue;
+    oc8_ld_piece_t *piece = get_piece(&icf, g);
+    piece->is_folded = 1;
+    piece->kept_unit = icf.ids[k].unit;
+    piece->kept_piece = icf.ids[k].piece;
+  }
+
+  oc8_arena_release(arena, reps);
+  for (size_t i = nb_units; i > 0; --i) {
+    oc8_arena_release(arena, icf.targets_off[i - 1]);
+    oc8_arena_release(arena, icf.targets[i - 1]);
+    oc8_arena_release(arena, icf.roms[i - 1]);
+  }
+  oc8_arena_release(arena, icf.keys);
+  oc8_arena_release(arena, icf.new_cls);
+  oc8_arena_release(arena, icf.cls);
+  oc8_arena_release(arena, icf.targets_off);
+  oc8_arena_release(arena, icf.targets);
+  oc8_arena_release(arena, icf.roms);
+  oc8_arena_release(arena, icf.ids);
+  return err ? -1 : 0;
+}
+
+int oc8_ld_collect_pieces(oc8_ld_linker_t *ld) {
+  ctx_t ctx;
+  ctx.ld = ld;
+  oc8_smap_init_interned(&ctx.globals, ld->arena);
+  ctx.pieces_refs = oc8_arena_alloc(ld->arena,
+                                    (ld->units_size + 1) * sizeof(uint32_t *));
+  ctx.refs = oc8_arena_alloc(ld->arena,
+                             (ld->units_size + 1) * sizeof(uint32_t *));
+  ctx.units_base =
+      oc8_arena_alloc(ld->arena, (ld->units_size + 1) * sizeof(size_t));
+
+  ctx.nb_pieces = 0;
+  int err = 0;
+  for (size_t i = 0; i < ld->units_size; ++i) {
+    oc8_ld_unit_t *unit = ld->units_arr[i];
+    split_unit(ld, unit);
+    sort_refs(&ctx, i);
+    ctx.units_base[i] = ctx.nb_pieces;
+    ctx.nb_pieces += unit->nb_pieces;
+
+    for (size_t j = 0; j < unit->bf->syms_defs_size && !err; ++j) {
+      oc8_bin_sym_def_t *def = &unit->bf->syms_defs[j];
+      if (def->addr == 0 || !def->is_global)
+        continue;
+      if (!oc8_smap_insert(&ctx.globals, def->name, i << 16 | def->id)) {
+        fprintf(stderr, "Linker error: multiple definitions of `%s'.\n",
+                def->name);
+        err = 1;
+      }
+    }
+  }
+  ctx.stack =
+      oc8_arena_alloc(ld->arena, (ctx.nb_pieces + 1) * sizeof(piece_id_t));
+  ctx.stack_size = 0;
+
+  if (!err)
+    err = mark_live(&ctx) != 0;
+  if (!err && ld->use_icf)
+    err = fold_pieces(&ctx) != 0;
+
+  // Kept pieces are moved closer, with the same address parity
+  for (size_t i = 0; i < ld->units_size && !err; ++i) {
+    oc8_ld_unit_t *unit = ld->units_arr[i];
+    uint16_t off = 0;
+    unit->refs_size = 0;
+    for (size_t j = 0; j < unit->nb_pieces; ++j) {
+      oc8_ld_piece_t *piece = &unit->pieces[j];
+      if (!piece->is_live || piece->is_folded)
+        continue;
+      off += (off ^ piece->begin) & 1;
+      piece->out_off = off;
+      off += piece->end - piece->begin;
+      unit->refs_size += ctx.pieces_refs[i][j + 1] - ctx.pieces_refs[i][j];
+    }
+    unit->out_size = off;
+  }
+
+  for (size_t i = ld->units_size; i > 0; --i) {
+    oc8_arena_release(ld->arena, ctx.refs[i - 1]);
+    oc8_arena_release(ld->arena, ctx.pieces_refs[i - 1]);
+  }
+  oc8_arena_release(ld->arena, ctx.stack);
+  oc8_arena_release(ld->arena, ctx.units_base);
+  oc8_arena_release(ld->arena, ctx.refs);
+  oc8_arena_release(ld->arena, ctx.pieces_refs);
+  oc8_smap_free(&ctx.globals);
+  return err ? -1 : 0;
+}
+
+size_t oc8_ld_print_folds(const oc8_ld_linker_t *ld, FILE *os) {
+  size_t saved = 0;
+  for (size_t i = 0; i < ld->units_size; ++i) {
+    const oc8_ld_unit_t *unit = ld->units_arr[i];
+    for (size_t j = 0; j < unit->nb_pieces; ++j) {
+      const oc8_ld_piece_t *piece = &unit->pieces[j];
+      if (!piece->is_folded)
+        continue;
+      const oc8_ld_unit_t *kept_unit = ld->units_arr[piece->kept_unit];
+      const oc8_ld_piece_t *kept = &kept_unit->pieces[piece->kept_piece];
+      size_t size = piece->end - piece->begin;
+      fprintf(os, "folded `%s' into `%s' (%zu bytes)\n",
+              unit->bf->syms_defs[piece->sym_id].name,
+              kept_unit->bf->syms_defs[kept->sym_id].name, size);
+      saved += size;
+    }
+  }
+  return saved;
+}
@@ -1,4 +1,5 @@
 #include <catch2/catch.hpp>
+#include <chrono>
 
 #include <cstdio>
 #include <cstdlib>
@@ -10,11 +11,17 @@
 #include "oc8_as/parser.h"
 #include "oc8_as/sfile.h"
 #include "oc8_bin/bin_reader.h"
+#include "oc8_bin/bin_writer.h"
 #include "oc8_bin/file.h"
 #include "oc8_emu/cpu.h"
 #include "oc8_emu/mem.h"
 #include "oc8_is/oc8_is.h"
+#include "oc8_ld/incremental.h"
 #include "oc8_ld/linker.h"
+#include "oc8_ld/lto.h"
+#include "oc8_ld/map.h"
+#include "oc8_ld/pieces.h"
+#include "oc8_pool/oc8_pool.h"
 
 #include "../../tests/test_src.h"
 
@@ -23,6 +30,31 @@
 #define BIN_B2R BUILD_DIR "/bin/oc8-bin2rom"
 #define BIN_R2B BUILD_DIR "/bin/oc8-rom2bin"
 
+// The test binary is linked with --wrap for malloc / calloc / realloc
+// Only calls from the oc8 libraries and this file are counted
+static size_t g_nb_mallocs = 0;
+
+extern "C" {
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t nmemb, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+
+void *__wrap_malloc(size_t size) {
+  __atomic_add_fetch(&g_nb_mallocs, 1, __ATOMIC_RELAXED);
+  return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t nmemb, size_t size) {
+  __atomic_add_fetch(&g_nb_mallocs, 1, __ATOMIC_RELAXED);
+  return __real_calloc(nmemb, size);
+}
+
+void *__wrap_realloc(void *ptr, size_t size) {
+  __atomic_add_fetch(&g_nb_mallocs, 1, __ATOMIC_RELAXED);
+  return __real_realloc(ptr, size);
+}
+}
+
 namespace {
 
 void write_bin(const std::string &path, const void *buf, size_t len) {
@@ -47,23 +79,25 @@ char *read_bin(const std::string &path, size_t *len) {
   return buf;
 }
 
-void compile_str(const std::vector<const char *> &code, oc8_bin_file_t *bf) {
+void compile_str(const std::vector<const char *> &code, oc8_bin_file_t *bf,
+                 oc8_arena_t *arena = nullptr) {
   std::vector<oc8_bin_file_t> objs(code.size());
   oc8_ld_linker_t ld;
-  oc8_ld_linker_init(&ld, 1);
+  oc8_ld_linker_init_arena(&ld, 1, arena);
 
   for (std::size_t i = 0; i < code.size(); ++i) {
-    oc8_as_sfile_t *sf = oc8_as_parse_raw(code[i], strlen(code[i]));
+    oc8_as_sfile_t *sf =
+        oc8_as_parse_raw_arena(code[i], strlen(code[i]), arena);
     oc8_bin_file_t *bf = &objs[i];
     oc8_as_sfile_check(sf);
-    oc8_as_compile_sfile(sf, bf);
-    oc8_bin_file_check(bf, 0);
+    REQUIRE(oc8_as_compile_sfile(sf, bf) == 0);
+    REQUIRE(oc8_bin_file_validate(bf, 0) == 0);
     oc8_as_sfile_free(sf);
     oc8_ld_linker_add(&ld, bf);
   }
 
-  oc8_ld_linker_link(&ld, bf);
-  oc8_bin_file_check(bf, 1);
+  REQUIRE(oc8_ld_linker_link(&ld, bf) == 0);
+  REQUIRE(oc8_bin_file_validate(bf, 1) == 0);
 
   for (auto &obj : objs)
     oc8_bin_file_free(&obj);
@@ -103,6 +137,14 @@ void run_emu_until(uint16_t addr, size_t max_steps = 1000) {
   REQUIRE(st < max_steps);
 }
 
+std::string read_str(const std::string &path) {
+  size_t len;
+  char *buf = read_bin(path, &len);
+  std::string res(buf, len);
+  std::free(buf);
+  return res;
+}
+
 int my_fibo(int x) { return x <= 1 ? x : my_fibo(x - 1) + my_fibo(x - 2); }
 
 int my_fact(int x) { return x <= 1 ? 1 : x * my_fact(x - 1); }
@@ -286,7 +328,7 @@ TEST_CASE("binaries program call_add_mem_src", "") {
 
   oc8_bin_file_t bf;
   oc8_bin_read_from_file(&bf, bin_path);
-  oc8_bin_file_check(&bf, /*is_bin=*/1);
+  REQUIRE(oc8_bin_file_validate(&bf, /*is_bin=*/1) == 0);
 
   REQUIRE(bf.syms_defs_size == 4);
   REQUIRE(bf.syms_refs_size == 3);
@@ -307,7 +349,7 @@ TEST_CASE("binaries program call_add_mem_src", "") {
 
   oc8_bin_file_t bf2;
   oc8_bin_read_from_file(&bf2, bin2_path);
-  oc8_bin_file_check(&bf2, /*is_bin=*/1);
+  REQUIRE(oc8_bin_file_validate(&bf2, /*is_bin=*/1) == 0);
   REQUIRE(bf.rom_size == bf2.rom_size);
   for (size_t i = 0; i < bf.rom_size; ++i)
     REQUIRE(bf.rom[i] == bf2.rom[i]);
@@ -333,3 +375,771 @@ TEST_CASE("binaries program call_add_mem_src", "") {
   oc8_bin_file_free(&bf);
   oc8_bin_file_free(&bf2);
 }
+
+TEST_CASE("link files with a cache", "") {
+  const char *cache_dir = "/tmp/oc8_test_linker_cache";
+  const char *out_path = "/tmp/oc8_test_linker_cache.c8bin";
+  const char *ref_path = "/tmp/oc8_test_linker_cache_ref.c8bin";
+  REQUIRE(std::system((std::string("rm -rf ") + cache_dir).c_str()) == 0);
+  oc8_bin_cache_t cache;
+  REQUIRE(oc8_bin_cache_open(&cache, cache_dir) == 0);
+  oc8_ld_link_opts_t opts = {};
+  opts.cache = &cache;
+
+  std::string start_src = "  .globl _start\n"
+                          "  .type _start, @function\n"
+                          "_start:\n"
+                          "  mov args, %i\n"
+                          "  movm %i, %v1\n"
+                          "  call my_add\n"
+                          "  mov %v0, %vf\n"
+                          "  .type args, @object\n"
+                          "args:\n"
+                          "  .byte 8\n"
+                          "  .byte 13\n";
+  std::vector<std::string> srcs = {start_src, test_my_add_src, test_fibo_src};
+  std::vector<std::string> objs;
+  std::vector<const char *> in_paths;
+  for (size_t i = 0; i < srcs.size(); ++i)
+    objs.push_back("/tmp/oc8_test_linker_cache_" + std::to_string(i) + ".c8o");
+  for (const auto &obj : objs)
+    in_paths.push_back(obj.c_str());
+
+  // Every output must be the same as a full link without cache
+  auto link = [&](const std::string &new_start_src) {
+    srcs[0] = new_start_src;
+    for (size_t i = 0; i < srcs.size(); ++i) {
+      std::string src_path = objs[i] + ".c8s";
+      write_bin(src_path, srcs[i].c_str(), srcs[i].size());
+      REQUIRE(oc8_as_assemble_file(src_path.c_str(), objs[i].c_str(),
+                                   nullptr, nullptr) == 0);
+    }
+    REQUIRE(oc8_ld_link_files(&in_paths[0], in_paths.size(), ref_path,
+                              nullptr, nullptr) == 0);
+    oc8_ld_link_res_t res;
+    REQUIRE(oc8_ld_link_files(&in_paths[0], in_paths.size(), out_path, &opts,
+                              &res) == 0);
+    REQUIRE(read_str(out_path) == read_str(ref_path));
+    REQUIRE(res.in_rom_size == res.out_rom_size);
+    return res.kind;
+  };
+
+  REQUIRE(link(start_src) == OC8_LD_LINK_FULL);
+  REQUIRE(link(start_src) == OC8_LD_LINK_CACHED);
+
+  // Same symbols: only the first unit is patched, with one more ref
+  std::string src2 = start_src;
+  src2.replace(src2.find("  mov %v0, %vf"), 14, "  jmp _start");
+  src2.replace(src2.find(".byte 8"), 7, ".byte 9");
+  REQUIRE(link(src2) == OC8_LD_LINK_INCREMENTAL);
+  oc8_bin_file_t bf;
+  oc8_bin_read_from_file(&bf, out_path);
+  REQUIRE(bf.syms_refs_size == 6);
+  oc8_bin_file_free(&bf);
+  REQUIRE(link(start_src) == OC8_LD_LINK_CACHED);
+
+  // New symbol
+  std::string src3 = start_src + "  .globl other\nother:\n  .byte 1\n";
+  REQUIRE(link(src3) == OC8_LD_LINK_FULL);
+
+  // Errors
+  REQUIRE(oc8_ld_link_files(&in_paths[1], 2, out_path, &opts, nullptr) != 0);
+  const char *no_file = "/tmp/no/such/file.c8o";
+  REQUIRE(oc8_ld_link_files(&no_file, 1, out_path, &opts, nullptr) != 0);
+  oc8_bin_cache_close(&cache);
+}
+
+namespace {
+
+// Fix `val` in the instruction, and decode it
+int fix_ins(oc8_is_ins_t *ins, uint16_t val) {
+  uint8_t rom[2];
+  oc8_is_encode_ins(ins, (char *)rom);
+  if (oc8_ld_fix_opcode(rom, OC8_ROM_START, val) != 0)
+    return -1;
+  REQUIRE(oc8_is_decode_ins(ins, (const char *)rom) == 0);
+  return 0;
+}
+
+// Unit k jumps to unit k + 1, the last one returns
+std::vector<std::string> chain_srcs(size_t nb_units) {
+  std::vector<std::string> res;
+  res.push_back("  .globl _start\n_start:\n  call f0\nLend:\n  jmp Lend\n");
+  for (size_t k = 0; k < nb_units; ++k) {
+    std::string name = "f" + std::to_string(k);
+    std::string next = "f" + std::to_string(k + 1);
+    res.push_back("  .globl " + name + "\n" + name + ":\n" +
+                  (k + 1 < nb_units ? "  jmp " + next + "\n" : "  ret\n"));
+  }
+  return res;
+}
+
+std::vector<oc8_bin_file_t> compile_objs(const std::vector<std::string> &srcs,
+                                         oc8_arena_t *arena) {
+  std::vector<oc8_bin_file_t> objs(srcs.size());
+  for (size_t i = 0; i < srcs.size(); ++i) {
+    oc8_as_sfile_t *sf =
+        oc8_as_parse_raw_arena(srcs[i].c_str(), srcs[i].size(), arena);
+    oc8_as_sfile_check(sf);
+    REQUIRE(oc8_as_compile_sfile(sf, &objs[i]) == 0);
+    REQUIRE(oc8_bin_file_validate(&objs[i], 0) == 0);
+  }
+  return objs;
+}
+
+// @returns 0 if success, != 0 on error (printed)
+int try_link_objs(std::vector<oc8_bin_file_t> &objs, oc8_bin_file_t *out_bf,
+                  oc8_arena_t *arena, int use_gc, oc8_pool_t *pool = nullptr) {
+  oc8_ld_linker_t ld;
+  oc8_ld_linker_init_arena(&ld, 1, arena);
+  oc8_ld_linker_set_pool(&ld, pool);
+  oc8_ld_linker_set_gc(&ld, use_gc);
+  for (auto &obj : objs)
+    oc8_ld_linker_add(&ld, &obj);
+  int err = oc8_ld_linker_link(&ld, out_bf);
+  if (!err && oc8_bin_file_validate(out_bf, 1) != 0) {
+    oc8_bin_file_free(out_bf);
+    err = -1;
+  }
+  oc8_ld_linker_free(&ld);
+  return err;
+}
+
+void link_objs(std::vector<oc8_bin_file_t> &objs, oc8_pool_t *pool,
+               oc8_bin_file_t *out_bf, oc8_arena_t *arena, int use_gc = 0) {
+  REQUIRE(try_link_objs(objs, out_bf, arena, use_gc, pool) == 0);
+}
+
+const oc8_bin_sym_def_t *find_def(const oc8_bin_file_t &bf, const char *name) {
+  for (size_t i = 0; i < bf.syms_defs_size; ++i)
+    if (std::strcmp(bf.syms_defs[i].name, name) == 0)
+      return &bf.syms_defs[i];
+  return nullptr;
+}
+
+} // namespace
+
+TEST_CASE("fix opcode patch kinds", "") {
+  struct {
+    oc8_is_type_t type;
+    size_t op;
+    uint16_t max;
+  } cases[] = {
+      {OC8_IS_TYPE_0NNN, 0, 0xFFF}, {OC8_IS_TYPE_1NNN, 0, 0xFFF},
+      {OC8_IS_TYPE_2NNN, 0, 0xFFF}, {OC8_IS_TYPE_ANNN, 0, 0xFFF},
+      {OC8_IS_TYPE_BNNN, 0, 0xFFF}, {OC8_IS_TYPE_3XNN, 1, 0xFF},
+      {OC8_IS_TYPE_4XNN, 1, 0xFF},  {OC8_IS_TYPE_6XNN, 1, 0xFF},
+      {OC8_IS_TYPE_7XNN, 1, 0xFF},  {OC8_IS_TYPE_CXNN, 1, 0xFF},
+      {OC8_IS_TYPE_DXYN, 2, 0xF},
+  };
+
+  for (const auto &c : cases) {
+    for (uint16_t val : {(uint16_t)0x1, c.max, (uint16_t)(c.max / 3)}) {
+      oc8_is_ins_t ins;
+      ins.opcode = 0;
+      ins.type = c.type;
+      ins.operands[0] = c.op == 0 ? 0x123 : 0xA;
+      ins.operands[1] = c.op == 1 ? 0x45 : 0xB;
+      ins.operands[2] = 0x6;
+      oc8_is_ins_t ref = ins;
+      ref.operands[c.op] = val;
+
+      REQUIRE(fix_ins(&ins, val) == 0);
+      REQUIRE(ins.type == c.type);
+      // The immediate is always the last operand
+      for (size_t i = 0; i <= c.op; ++i)
+        REQUIRE(ins.operands[i] == ref.operands[i]);
+    }
+
+    oc8_is_ins_t ins;
+    ins.opcode = 0;
+    ins.type = c.type;
+    ins.operands[0] = ins.operands[1] = ins.operands[2] = 1;
+    REQUIRE(fix_ins(&ins, c.max + 1) != 0);
+  }
+
+  oc8_is_ins_t ins;
+  ins.opcode = 0;
+  ins.type = OC8_IS_TYPE_00EE;
+  REQUIRE(fix_ins(&ins, 0x200) != 0);
+  ins.type = OC8_IS_TYPE_8XY4;
+  ins.operands[0] = ins.operands[1] = 2;
+  REQUIRE(fix_ins(&ins, 0x200) != 0);
+}
+
+TEST_CASE("link units in parallel", "") {
+  oc8_arena_t arena;
+  oc8_arena_init(&arena, 0);
+  auto objs = compile_objs(chain_srcs(300), &arena);
+  oc8_bin_file_t bf;
+  oc8_bin_file_t bf_pool;
+  oc8_pool_t pool;
+  oc8_pool_init(&pool, 3);
+  link_objs(objs, nullptr, &bf, &arena);
+  link_objs(objs, &pool, &bf_pool, &arena);
+  oc8_pool_free(&pool);
+
+  // 299 jumps, plus the jumps of _rom_begin and _start
+  REQUIRE(bf.syms_refs_size == 302);
+  REQUIRE(bf.rom_size == bf_pool.rom_size);
+  REQUIRE(std::memcmp(bf.rom, bf_pool.rom, bf.rom_size) == 0);
+  REQUIRE(bf.syms_refs_size == bf_pool.syms_refs_size);
+  REQUIRE(std::memcmp(bf.syms_refs, bf_pool.syms_refs,
+                      bf.syms_refs_size * sizeof(oc8_bin_sym_ref_t)) == 0);
+
+  // Goes through all units, and back
+  setup_emu(&bf);
+  run_emu_until(0x202);
+  run_emu_until(0x204, 2000);
+  REQUIRE(g_oc8_emu_cpu.reg_sp == 0);
+  oc8_arena_free(&arena);
+}
+
+TEST_CASE("link with gc sections", "") {
+  std::vector<std::string> srcs = {
+      "  .globl _start\n"
+      "  .type _start, @function\n"
+      "_start:\n"
+      "  mov args, %i\n"
+      "  movm %i, %v1\n"
+      "  call my_add\n"
+      "  call helper\n"
+      "  mov %v0, %vf\n"
+      "Lend:\n"
+      "  jmp Lend\n"
+      "  .size _start, 12\n"
+      "  .type unused_data, @object\n"
+      "unused_data:\n"
+      "  .byte 1\n"
+      "  .byte 2\n"
+      "  .byte 3\n"
+      "  .size unused_data, 3\n"
+      "  .type args, @object\n"
+      "args:\n"
+      "  .byte 8\n"
+      "  .byte 13\n"
+      "  .size args, 2\n",
+
+      // my_sub is removed, with its undefined reference
+      "  .globl my_add\n"
+      "  .type my_add, @function\n"
+      "my_add:\n"
+      "  add %v1, %v0\n"
+      "  ret\n"
+      "  .size my_add, 4\n"
+      "  .globl my_sub\n"
+      "  .type my_sub, @function\n"
+      "my_sub:\n"
+      "  call missing_fun\n"
+      "  ret\n"
+      "  .size my_sub, 4\n",
+
+      // helper has no size: it runs into helper_end, that is kept
+      "  .globl helper\n"
+      "helper:\n"
+      "  mov 1, %v2\n"
+      "  .type helper_end, @function\n"
+      "helper_end:\n"
+      "  ret\n"
+      "  .size helper_end, 2\n",
+
+      // Not used at all
+      test_fibo_src,
+  };
+
+  oc8_arena_t arena;
+  oc8_arena_init(&arena, 0);
+  auto objs = compile_objs(srcs, &arena);
+  oc8_bin_file_t bf;
+  REQUIRE(try_link_objs(objs, &bf, &arena, 0) != 0);
+  REQUIRE(try_link_objs(objs, &bf, &arena, 1) == 0);
+
+  // args keeps an odd address: 1 padding byte
+  REQUIRE(bf.rom_size == 2 + 12 + 1 + 2 + 4 + 4);
+  for (const char *name : {"_start", "args", "my_add", "helper", "helper_end"})
+    REQUIRE(find_def(bf, name) != nullptr);
+  for (const char *name : {"unused_data", "my_sub", "fibo"})
+    REQUIRE(find_def(bf, name) == nullptr);
+  REQUIRE(find_def(bf, "args")->addr == OC8_ROM_START + 2 + 13);
+  REQUIRE(find_def(bf, "args")->size == 2);
+  REQUIRE(find_def(bf, "my_add")->size == 4);
+
+  setup_emu(&bf);
+  run_emu_until(find_def(bf, "Lend")->addr);
+  REQUIRE(g_oc8_emu_cpu.regs_data[0] == 21);
+  REQUIRE(g_oc8_emu_cpu.regs_data[2] == 1);
+  REQUIRE(g_oc8_emu_cpu.regs_data[15] == 21);
+
+  // Same output from files, with the size reclaimed
+  std::vector<std::string> paths;
+  std::vector<const char *> in_paths;
+  for (size_t i = 0; i < objs.size(); ++i) {
+    paths.push_back("/tmp/oc8_test_linker_gc_" + std::to_string(i) + ".c8o");
+    REQUIRE(oc8_bin_write_to_file(&objs[i], paths.back().c_str()) == 0);
+  }
+  for (const auto &path : paths)
+    in_paths.push_back(path.c_str());
+  const char *out_path = "/tmp/oc8_test_linker_gc.c8bin";
+  oc8_ld_link_opts_t opts = {};
+  opts.use_gc = 1;
+  oc8_ld_link_res_t res;
+  REQUIRE(oc8_ld_link_files(&in_paths[0], in_paths.size(), out_path, &opts,
+                            &res) == 0);
+  size_t len;
+  char *out = read_bin(out_path, &len);
+  oc8_bin_file_t out_bf;
+  oc8_bin_read_file_raw(&out_bf, out, len);
+  REQUIRE(out_bf.rom_size == bf.rom_size);
+  REQUIRE(std::memcmp(out_bf.rom, bf.rom, bf.rom_size) == 0);
+  size_t in_rom_size = 0;
+  for (auto &obj : objs)
+    in_rom_size += obj.rom_size;
+  REQUIRE(res.in_rom_size == in_rom_size);
+  REQUIRE(res.out_rom_size == bf.rom_size - 2);
+  oc8_bin_file_free(&out_bf);
+  std::free(out);
+  oc8_arena_free(&arena);
+}
+
+namespace {
+
+std::string sized_def(const char *name, const char *type, const char *body,
+                      size_t size) {
+  return std::string("  .globl ") + name + "\n  .type " + name + ", @" +
+         type + "\n" + name + ":\n" + body + "  .size " + name + ", " +
+         std::to_string(size) + "\n";
+}
+
+} // namespace
+
+TEST_CASE("link with identical code folding", "") {
+  std::vector<std::string> srcs = {
+      sized_def("_start", "function",
+                "  call load_b\n"
+                "  movm %i, %v1\n"
+                "  call add_b\n"
+                "  mov %v0, %v5\n"
+                "  call load_c\n"
+                "  movm %i, %v1\n"
+                "  call add_a\n"
+                "Lend:\n"
+                "  jmp Lend\n",
+                16),
+      sized_def("add_a", "function", "  add %v1, %v0\n  ret\n", 4) +
+          sized_def("sprite_a", "object", "  .byte 0xF0\n  .byte 0x90\n", 2) +
+          sized_def("load_a", "function", "  mov sprite_a, %i\n  ret\n", 4) +
+          sized_def("load_c", "function", "  mov sprite_c, %i\n  ret\n", 4),
+
+      // Same as above, but sprite_c
+      sized_def("add_b", "function", "  add %v1, %v0\n  ret\n", 4) +
+          sized_def("sprite_b", "object", "  .byte 0xF0\n  .byte 0x90\n", 2) +
+          sized_def("load_b", "function", "  mov sprite_b, %i\n  ret\n", 4) +
+          sized_def("sprite_c", "object", "  .byte 0xF0\n  .byte 0x91\n", 2),
+
+      // helper has no size, and runs into add_c
+      "helper:\n  mov 1, %v2\n" +
+          sized_def("add_c", "function", "  add %v1, %v0\n  ret\n", 4),
+  };
+
+  oc8_arena_t arena;
+  oc8_arena_init(&arena, 0);
+  auto objs = compile_objs(srcs, &arena);
+  oc8_bin_file_t ref_bf;
+  link_objs(objs, nullptr, &ref_bf, &arena);
+  REQUIRE(ref_bf.rom_size == 2 + 16 + 14 + 12 + 6);
+
+  oc8_ld_linker_t ld;
+  oc8_ld_linker_init_arena(&ld, 1, &arena);
+  oc8_ld_linker_set_icf(&ld, 1);
+  for (auto &obj : objs)
+    oc8_ld_linker_add(&ld, &obj);
+  oc8_bin_file_t bf;
+  REQUIRE(oc8_ld_linker_link(&ld, &bf) == 0);
+  REQUIRE(oc8_bin_file_validate(&bf, 1) == 0);
+  std::FILE *os = std::tmpfile();
+  REQUIRE(oc8_ld_print_folds(&ld, os) == 4 + 2 + 4);
+  oc8_ld_linker_free(&ld);
+  std::rewind(os);
+  std::string report;
+  for (int c; (c = std::fgetc(os)) != EOF;)
+    report += (char)c;
+  std::fclose(os);
+  REQUIRE(report == "folded `add_b' into `add_a' (4 bytes)\n"
+                    "folded `sprite_b' into `sprite_a' (2 bytes)\n"
+                    "folded `load_b' into `load_a' (4 bytes)\n");
+
+  // All symbols are kept, the folded ones are aliases
+  REQUIRE(bf.rom_size == ref_bf.rom_size - 10);
+  REQUIRE(find_def(bf, "add_b")->addr == find_def(bf, "add_a")->addr);
+  REQUIRE(find_def(bf, "sprite_b")->addr == find_def(bf, "sprite_a")->addr);
+  REQUIRE(find_def(bf, "load_b")->addr == find_def(bf, "load_a")->addr);
+  REQUIRE(find_def(bf, "load_c")->addr != find_def(bf, "load_a")->addr);
+  REQUIRE(find_def(bf, "sprite_c")->addr != find_def(bf, "sprite_a")->addr);
+  REQUIRE(find_def(bf, "add_c")->addr != find_def(bf, "add_a")->addr);
+  REQUIRE(bf.syms_refs_size == ref_bf.syms_refs_size - 1);
+
+  setup_emu(&bf);
+  run_emu_until(find_def(bf, "Lend")->addr);
+  REQUIRE(g_oc8_emu_cpu.regs_data[5] == 0x80);
+  REQUIRE(g_oc8_emu_cpu.regs_data[0] == 0x81);
+  oc8_arena_free(&arena);
+}
+
+TEST_CASE("identical code folding keeps written objects", "") {
+  std::vector<std::string> srcs = {
+      sized_def("_start", "function",
+                "  mov 123, %v0\n"
+                "  mov buf1, %i\n"
+                "  bcd %v0\n"
+                "  mov buf2, %i\n"
+                "  movm %i, %v1\n"
+                "Lend:\n"
+                "  jmp Lend\n",
+                12),
+      sized_def("buf1", "object", "  .zero 4\n", 4) +
+          sized_def("buf2", "object", "  .zero 4\n", 4) +
+          sized_def("add_a", "function", "  add %v1, %v0\n  ret\n", 4) +
+          sized_def("add_b", "function", "  add %v1, %v0\n  ret\n", 4),
+  };
+
+  oc8_arena_t arena;
+  oc8_arena_init(&arena, 0);
+  auto objs = compile_objs(srcs, &arena);
+  oc8_ld_linker_t ld;
+  oc8_ld_linker_init_arena(&ld, 1, &arena);
+  oc8_ld_linker_set_icf(&ld, 1);
+  for (auto &obj : objs)
+    oc8_ld_linker_add(&ld, &obj);
+  oc8_bin_file_t bf;
+  REQUIRE(oc8_ld_linker_link(&ld, &bf) == 0);
+  REQUIRE(oc8_bin_file_validate(&bf, 1) == 0);
+  std::FILE *os = std::tmpfile();
+  REQUIRE(oc8_ld_print_folds(&ld, os) == 4);
+  oc8_ld_linker_free(&ld);
+  std::fclose(os);
+
+  // Only the functions are folded, bcd writes to buf1
+  REQUIRE(find_def(bf, "add_b")->addr == find_def(bf, "add_a")->addr);
+  REQUIRE(find_def(bf, "buf2")->addr != find_def(bf, "buf1")->addr);
+  setup_emu(&bf);
+  run_emu_until(find_def(bf, "Lend")->addr);
+  REQUIRE(g_oc8_emu_cpu.regs_data[0] == 0);
+  REQUIRE(g_oc8_emu_cpu.regs_data[1] == 0);
+  oc8_arena_free(&arena);
+}
+
+TEST_CASE("link with inlining", "") {
+  std::vector<std::string> srcs = {
+      sized_def("_start", "function",
+                "  mov 6, %v0\n"
+                "  mov 8, %v1\n"
+                "  call add\n"
+                "  skpe 14, %v0\n"
+                "  call twice\n"
+                "  call twice\n"
+                "  call load\n"
+                "  call big\n"
+                "Lend:\n"
+                "  jmp Lend\n",
+                18),
+      sized_def("add", "function", "  add %v1, %v0\n  ret\n", 4) +
+          sized_def("twice", "function",
+                    "  add %v1, %v0\n  add %v1, %v0\n  ret\n", 6) +
+          sized_def("big", "function",
+                    "  add %v1, %v0\n  add %v1, %v0\n  add %v1, %v0\n"
+                    "  ret\n",
+                    8) +
+          "  .type sprite, @object\n"
+          "sprite:\n  .byte 0xF0\n  .byte 0x90\n"
+          "  .size sprite, 2\n" +
+          sized_def("load", "function", "  mov sprite, %i\n  ret\n", 4) +
+          sized_def("helper", "function", "  call load\n  ret\n", 4),
+  };
+
+  oc8_arena_t arena;
+  oc8_arena_init(&arena, 0);
+  auto objs = compile_objs(srcs, &arena);
+  oc8_bin_file_t ref_bf;
+  link_objs(objs, nullptr, &ref_bf, &arena);
+
+  oc8_ld_linker_t ld;
+  oc8_ld_linker_init_arena(&ld, 1, &arena);
+  oc8_ld_linker_set_lto(&ld, OC8_LD_LTO_DEFAULT_MAX_SIZE);
+  for (auto &obj : objs)
+    oc8_ld_linker_add(&ld, &obj);
+  oc8_bin_file_t bf;
+  REQUIRE(oc8_ld_linker_link(&ld, &bf) == 0);
+  REQUIRE(oc8_bin_file_validate(&bf, 1) == 0);
+  std::FILE *os = std::tmpfile();
+  REQUIRE(oc8_ld_print_inlines(&ld, os) == 3);
+  oc8_ld_linker_free(&ld);
+  std::rewind(os);
+  std::string report;
+  for (int c; (c = std::fgetc(os)) != EOF;)
+    report += (char)c;
+  std::fclose(os);
+  // The call after the skip, the one to a function using a local symbol of
+  // another unit, and the one to a function too big are kept
+  REQUIRE(report == "inlined `add' at 1 call site\n"
+                    "inlined `twice' at 1 call site\n"
+                    "inlined `load' at 1 call site\n");
+
+  // The functions are kept, `twice' grows _start by 2 bytes
+  REQUIRE(bf.rom_size == ref_bf.rom_size + 2);
+  REQUIRE(find_def(bf, "_start")->size == 20);
+  REQUIRE(find_def(bf, "add") != nullptr);
+  const oc8_bin_sym_def_t *helper = find_def(bf, "helper");
+  REQUIRE(helper->size == 4);
+  REQUIRE(bf.rom[helper->addr - OC8_ROM_START] >> 4 == 0xA);
+
+  setup_emu(&bf);
+  run_emu_until(find_def(bf, "Lend")->addr);
+  REQUIRE(g_oc8_emu_cpu.regs_data[0] == 6 + 8 + 2 * 8 + 3 * 8);
+  REQUIRE(g_oc8_emu_cpu.reg_i == find_def(bf, "sprite")->addr);
+  oc8_arena_free(&arena);
+}
+
+namespace {
+
+// Archive of the objects compiled from `srcs`, members are m0, m1, ...
+std::vector<uint8_t> make_archive(const std::vector<std::string> &srcs,
+                                  oc8_arena_t *arena) {
+  auto objs = compile_objs(srcs, arena);
+  std::vector<std::vector<uint8_t>> raws;
+  std::vector<std::string> names;
+  std::vector<oc8_bin_pack_member_t> ms;
+  for (auto &obj : objs) {
+    raws.emplace_back(oc8_bin_write_file_raw(&obj, nullptr));
+    oc8_bin_write_file_raw(&obj, &raws.back()[0]);
+    names.push_back("m" + std::to_string(names.size()));
+  }
+  for (size_t i = 0; i < raws.size(); ++i)
+    ms.push_back({names[i].c_str(), &raws[i][0], raws[i].size()});
+  std::vector<uint8_t> res(oc8_bin_archive_write_raw(&ms[0], ms.size(),
+                                                     nullptr));
+  REQUIRE(oc8_bin_archive_write_raw(&ms[0], ms.size(), &res[0]) ==
+          res.size());
+  return res;
+}
+
+} // namespace
+
+TEST_CASE("link with archives", "") {
+  oc8_arena_t arena;
+  oc8_arena_init(&arena, 0);
+  auto main_objs = compile_objs({"  .globl _start\n"
+                                 "_start:\n"
+                                 "  mov 3, %v0\n"
+                                 "  mov 4, %v1\n"
+                                 "  call my_add\n"
+                                 "  call my_mul2\n"
+                                 "Lend:\n"
+                                 "  jmp Lend\n",
+                                 // Not taken from the archive
+                                 "  .globl my_mul2\n"
+                                 "my_mul2:\n"
+                                 "  add %v0, %v0\n"
+                                 "  ret\n"},
+                                &arena);
+  auto lib = make_archive({
+                              // Needs an undefined symbol, never added
+                              "  .globl unused\n"
+                              "unused:\n"
+                              "  call missing_fun\n"
+                              "  ret\n",
+                              "  .globl my_add\n"
+                              "my_add:\n"
+                              "  call helper\n"
+                              "  add %v1, %v0\n"
+                              "  ret\n",
+                              "  .globl helper\n"
+                              "helper:\n"
+                              "  add 1, %v1\n"
+                              "  ret\n",
+                              "  .globl my_mul2\n"
+                              "my_mul2:\n"
+                              "  call missing_fun\n"
+                              "  ret\n",
+                          },
+                          &arena);
+  // my_add is found in the first archive
+  auto other_lib = make_archive({"  .globl my_add\n"
+                                 "my_add:\n"
+                                 "  call missing_fun\n"
+                                 "  ret\n"},
+                                &arena);
+  oc8_bin_archive_t ar;
+  oc8_bin_archive_t other_ar;
+  REQUIRE(oc8_bin_archive_init(&ar, &lib[0], lib.size()) == 0);
+  REQUIRE(oc8_bin_archive_init(&other_ar, &other_lib[0], other_lib.size()) ==
+          0);
+
+  oc8_ld_linker_t ld;
+  oc8_ld_linker_init_arena(&ld, 1, &arena);
+  for (auto &obj : main_objs)
+    oc8_ld_linker_add(&ld, &obj);
+  oc8_ld_linker_add_archive(&ld, &ar);
+  oc8_ld_linker_add_archive(&ld, &other_ar);
+  oc8_bin_file_t bf;
+  REQUIRE(oc8_ld_linker_link(&ld, &bf) == 0);
+  REQUIRE(oc8_bin_file_validate(&bf, 1) == 0);
+  REQUIRE(ld.units_size == 1 + 2 + 2);
+  oc8_ld_linker_free(&ld);
+
+  REQUIRE(bf.rom_size == 2 + 10 + 4 + 6 + 4);
+  REQUIRE(find_def(bf, "my_add") != nullptr);
+  REQUIRE(find_def(bf, "helper") != nullptr);
+  REQUIRE(find_def(bf, "unused") == nullptr);
+  setup_emu(&bf);
+  run_emu_until(find_def(bf, "Lend")->addr);
+  REQUIRE(g_oc8_emu_cpu.regs_data[0] == 16);
+
+  // Same output from files, the archive is an input like the others
+  std::string main_path = "/tmp/oc8_test_linker_ar_main.c8o";
+  std::string mul_path = "/tmp/oc8_test_linker_ar_mul.c8o";
+  std::string ar_path = "/tmp/oc8_test_linker_ar.c8a";
+  REQUIRE(oc8_bin_write_to_file(&main_objs[0], main_path.c_str()) == 0);
+  REQUIRE(oc8_bin_write_to_file(&main_objs[1], mul_path.c_str()) == 0);
+  write_bin(ar_path, &lib[0], lib.size());
+  const char *in_paths[] = {main_path.c_str(), ar_path.c_str(),
+                            mul_path.c_str()};
+  const char *out_path = "/tmp/oc8_test_linker_ar.c8bin";
+  oc8_ld_link_res_t res;
+  REQUIRE(oc8_ld_link_files(in_paths, 3, out_path, nullptr, &res) == 0);
+  size_t len;
+  char *out = read_bin(out_path, &len);
+  oc8_bin_file_t out_bf;
+  oc8_bin_read_file_raw(&out_bf, out, len);
+  REQUIRE(out_bf.rom_size == bf.rom_size);
+  setup_emu(&out_bf);
+  run_emu_until(find_def(out_bf, "Lend")->addr);
+  REQUIRE(g_oc8_emu_cpu.regs_data[0] == 16);
+  REQUIRE(res.in_rom_size == 10 + 4 + 4 + 6 + 4 + 4);
+  oc8_bin_file_free(&out_bf);
+  std::free(out);
+
+  // Without mul_path, my_mul2 is taken from the archive, and needs a symbol
+  // defined nowhere
+  REQUIRE(oc8_ld_link_files(in_paths, 2, out_path, nullptr, &res) != 0);
+  oc8_arena_free(&arena);
+}
+
+TEST_CASE("linker map", "") {
+  oc8_arena_t arena;
+  oc8_arena_init(&arena, 0);
+  auto objs = compile_objs({"  .globl _start\n"
+                            "  .type _start, @function\n"
+                            "_start:\n"
+                            "  mov used, %i\n"
+                            "Lend:\n"
+                            "  jmp Lend\n"
+                            "  .size _start, 4\n"
+                            "  .type odd, @object\n"
+                            "odd:\n"
+                            "  .byte 1\n"
+                            "  .size odd, 1\n"
+                            "  .type used, @object\n"
+                            "used:\n"
+                            "  .byte 2\n"
+                            "  .byte 3\n"
+                            "  .size used, 2\n"},
+                           &arena);
+  oc8_ld_linker_t ld;
+  oc8_ld_linker_init_arena(&ld, 1, &arena);
+  oc8_ld_linker_set_gc(&ld, 1);
+  oc8_ld_linker_add_named(&ld, &objs[0], "main.c8o");
+  oc8_bin_file_t bf;
+  REQUIRE(oc8_ld_linker_link(&ld, &bf) == 0);
+  std::FILE *os = std::tmpfile();
+  oc8_ld_print_map(&ld, &bf, os);
+  oc8_ld_linker_free(&ld);
+  std::rewind(os);
+  std::string map;
+  for (int c; (c = std::fgetc(os)) != EOF;)
+    map += (char)c;
+  std::fclose(os);
+
+  // odd is removed, and used keeps an odd address
+  REQUIRE(map == "ROM: 9 bytes used, 3575 bytes free, 1 bytes of padding\n"
+                 "\n"
+                 "   addr   size  input  padding  removed  name\n"
+                 "\n"
+                 "  0x200      2      2        0        0  <start>\n"
+                 "    0x200     ~2  -        local  _rom_begin\n"
+                 "\n"
+                 "  0x202      7      7        1        1  main.c8o\n"
+                 "    0x202      4  function global _start\n"
+                 "    0x204     ~3  -        local  Lend\n"
+                 "    0x207      2  object   local  used\n");
+  oc8_arena_free(&arena);
+}
+
+// Run with `utest_oc8ld.bin [bench]`
+TEST_CASE("link many units bench", "[.bench]") {
+  oc8_arena_t arena;
+  oc8_arena_init(&arena, 0);
+  // Max ROM size: 6 bytes for _start, 2 per unit
+  size_t nb_units = 1700;
+  auto objs = compile_objs(chain_srcs(nb_units), &arena);
+  oc8_pool_t pool;
+  oc8_pool_init(&pool, oc8_pool_nb_cpus() - 1);
+
+  for (oc8_pool_t *p : {(oc8_pool_t *)nullptr, &pool}) {
+    const int nb_iters = 200;
+    auto begin = std::chrono::steady_clock::now();
+    for (int i = 0; i < nb_iters; ++i) {
+      oc8_arena_t link_arena;
+      oc8_arena_init(&link_arena, 0);
+      oc8_bin_file_t bf;
+      link_objs(objs, p, &bf, &link_arena);
+      oc8_arena_free(&link_arena);
+    }
+    double us = std::chrono::duration<double, std::micro>(
+                    std::chrono::steady_clock::now() - begin)
+                    .count() /
+                nb_iters;
+    std::printf("link %zu units, %s: %.1fus\n", nb_units,
+                p ? "pool" : "no pool", us);
+  }
+  oc8_pool_free(&pool);
+  oc8_arena_free(&arena);
+}
+
+// Malloc calls of a whole assemble + link job, with or without an arena
+size_t count_mallocs(oc8_arena_t *arena, std::vector<uint8_t> &rom) {
+  std::vector<const char *> code = {test_call_add_src, test_my_add_src};
+  size_t begin = g_nb_mallocs;
+  oc8_bin_file_t bf;
+  compile_str(code, &bf, arena);
+  rom.assign(bf.rom, bf.rom + bf.rom_size);
+  oc8_bin_file_free(&bf);
+  if (arena)
+    oc8_arena_free(arena);
+  return g_nb_mallocs - begin;
+}
+
+TEST_CASE("arena malloc count", "") {
+  // First run to fill the string pool, that is shared by all jobs
+  std::vector<uint8_t> rom_heap;
+  std::vector<uint8_t> rom_arena;
+  count_mallocs(nullptr, rom_heap);
+
+  size_t nb_heap = count_mallocs(nullptr, rom_heap);
+  oc8_arena_t arena;
+  oc8_arena_init(&arena, 0);
+  size_t nb_arena = count_mallocs(&arena, rom_arena);
+  REQUIRE(rom_heap == rom_arena);
+  REQUIRE(nb_arena * 4 < nb_heap);
+}
+
+// Run with `utest_oc8ld.bin [bench]`
+TEST_CASE("arena malloc count report", "[.bench]") {
+  std::vector<uint8_t> rom;
+  count_mallocs(nullptr, rom);
+  size_t nb_heap = count_mallocs(nullptr, rom);
+  oc8_arena_t arena;
+  oc8_arena_init(&arena, 0);
+  size_t nb_arena = count_mallocs(&arena, rom);
+  std::printf("assemble + link 2 files: %zu malloc calls, %zu with an arena\n",
+              nb_heap, nb_arena);
+}
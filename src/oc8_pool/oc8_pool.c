@@ -0,0 +1,106 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "oc8_pool/oc8_pool.h"
+
+#include <stdlib.h>
+#include <unistd.h>
+
+// Take jobs of the current batch until there is none left
+static void run_jobs(oc8_pool_t *pool) {
+  for (;;) {
+    size_t idx = __atomic_fetch_add(&pool->next, 1, __ATOMIC_RELAXED);
+    if (idx >= pool->nb_jobs)
+      break;
+    pool->fn(pool->arg, idx);
+  }
+}
+
+static void *worker_main(void *ptr) {
+  oc8_pool_t *pool = (oc8_pool_t *)ptr;
+  size_t gen = 0;
+
+  pthread_mutex_lock(&pool->lock);
+  for (;;) {
+    while (!pool->stop && pool->gen == gen)
+      pthread_cond_wait(&pool->cv_work, &pool->lock);
+    if (pool->stop)
+      break;
+    gen = pool->gen;
+    pthread_mutex_unlock(&pool->lock);
+
+    run_jobs(pool);
+
+    pthread_mutex_lock(&pool->lock);
+    if (++pool->nb_finished == pool->nb_threads)
+      pthread_cond_signal(&pool->cv_done);
+  }
+  pthread_mutex_unlock(&pool->lock);
+  return NULL;
+}
+
+size_t oc8_pool_nb_cpus(void) {
+  long res = sysconf(_SC_NPROCESSORS_ONLN);
+  return res > 0 ? (size_t)res : 1;
+}
+
+void oc8_pool_init(oc8_pool_t *pool, size_t nb_threads) {
+  pthread_mutex_init(&pool->lock, NULL);
+  pthread_cond_init(&pool->cv_work, NULL);
+  pthread_cond_init(&pool->cv_done, NULL);
+  pthread_mutex_init(&pool->run_lock, NULL);
+  pool->stop = 0;
+  pool->fn = NULL;
+  pool->arg = NULL;
+  pool->nb_jobs = 0;
+  pool->next = 0;
+  pool->gen = 0;
+  pool->nb_finished = 0;
+
+  pool->threads = malloc((nb_threads ? nb_threads : 1) * sizeof(pthread_t));
+  pool->nb_threads = 0;
+  for (size_t i = 0; i < nb_threads; ++i) {
+    if (pthread_create(&pool->threads[i], NULL, worker_main, pool) != 0)
+      break;
+    ++pool->nb_threads;
+  }
+}
+
+void oc8_pool_free(oc8_pool_t *pool) {
+  pthread_mutex_lock(&pool->lock);
+  pool->stop = 1;
+  pthread_cond_broadcast(&pool->cv_work);
+  pthread_mutex_unlock(&pool->lock);
+
+  for (size_t i = 0; i < pool->nb_threads; ++i)
+    pthread_join(pool->threads[i], NULL);
+  free(pool->threads);
+  pthread_mutex_destroy(&pool->lock);
+  pthread_cond_destroy(&pool->cv_work);
+  pthread_cond_destroy(&pool->cv_done);
+  pthread_mutex_destroy(&pool->run_lock);
+}
+
+void oc8_pool_run(oc8_pool_t *pool, oc8_pool_fn_f fn, void *arg,
+                  size_t nb_jobs) {
+  pthread_mutex_lock(&pool->run_lock);
+
+  pthread_mutex_lock(&pool->lock);
+  pool->fn = fn;
+  pool->arg = arg;
+  pool->nb_jobs = nb_jobs;
+  pool->next = 0;
+  pool->nb_finished = 0;
+  ++pool->gen;
+  pthread_cond_broadcast(&pool->cv_work);
+  pthread_mutex_unlock(&pool->lock);
+
+  run_jobs(pool);
+
+  // Every worker must be done with the batch before the next one starts
+  pthread_mutex_lock(&pool->lock);
+  while (pool->nb_finished < pool->nb_threads)
+    pthread_cond_wait(&pool->cv_done, &pool->lock);
+  pthread_mutex_unlock(&pool->lock);
+
+  pthread_mutex_unlock(&pool->run_lock);
+}
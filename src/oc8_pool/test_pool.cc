@@ -0,0 +1,54 @@
+#include <catch2/catch.hpp>
+#include <thread>
+#include <vector>
+
+#include "oc8_pool/oc8_pool.h"
+
+namespace {
+
+void square_job(void *arg, size_t idx) {
+  auto out = (std::vector<size_t> *)arg;
+  (*out)[idx] = idx * idx;
+}
+
+void count_job(void *arg, size_t) {
+  __atomic_add_fetch((size_t *)arg, 1, __ATOMIC_RELAXED);
+}
+
+} // namespace
+
+TEST_CASE("pool run all jobs", "") {
+  for (size_t nb_threads : {0, 1, 3, 8}) {
+    oc8_pool_t pool;
+    oc8_pool_init(&pool, nb_threads);
+    REQUIRE(pool.nb_threads == nb_threads);
+    for (size_t nb_jobs : {0, 1, 7, 1000}) {
+      std::vector<size_t> out(nb_jobs, 0);
+      oc8_pool_run(&pool, square_job, &out, nb_jobs);
+      for (size_t i = 0; i < nb_jobs; ++i)
+        REQUIRE(out[i] == i * i);
+    }
+    oc8_pool_free(&pool);
+  }
+}
+
+TEST_CASE("pool many batches", "") {
+  oc8_pool_t pool;
+  oc8_pool_init(&pool, 4);
+  size_t count = 0;
+  for (int i = 0; i < 500; ++i)
+    oc8_pool_run(&pool, count_job, &count, 10);
+  REQUIRE(count == 5000);
+
+  // Batches from many threads are run one after the other
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; ++t)
+    threads.emplace_back([&pool, &count] {
+      for (int i = 0; i < 100; ++i)
+        oc8_pool_run(&pool, count_job, &count, 10);
+    });
+  for (auto &th : threads)
+    th.join();
+  REQUIRE(count == 9000);
+  oc8_pool_free(&pool);
+}
@@ -1,19 +1,120 @@
 #include "oc8_smap/oc8_smap.h"
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 
-void oc8_smap_init(oc8_smap_t *sm) {
+#define INIT_SLOTS_SIZE (16)
+#define CHUNK_SIZE (4096)
+
+// Hash of an empty slot, any other hash value means removed
+#define SLOT_EMPTY (0)
+#define SLOT_REMOVED (1)
+
+#define FNV_OFFSET (0xcbf29ce484222325ULL)
+#define FNV_PRIME (0x100000001b3ULL)
+
+#define PTR_HASH_MUL (0x9e3779b97f4a7c15ULL)
+
+size_t oc8_smap_hash(const char *key) {
+  uint64_t hash = FNV_OFFSET;
+  for (; *key; ++key) {
+    hash ^= (uint8_t)*key;
+    hash *= FNV_PRIME;
+  }
+  return (size_t)hash;
+}
+
+// Interned keys are hashed by address, the high bits are folded back because
+// the slot index only uses the low bits
+static size_t hash_key(const oc8_smap_t *sm, const char *key) {
+  if (!sm->interned_keys)
+    return oc8_smap_hash(key);
+  uint64_t hash = (uint64_t)(uintptr_t)key * PTR_HASH_MUL;
+  return (size_t)(hash ^ (hash >> 32));
+}
+
+static int same_key(const oc8_smap_t *sm, const char *a, const char *b) {
+  return sm->interned_keys ? a == b : strcmp(a, b) == 0;
+}
+
+static oc8_arena_t *nodes_arena(oc8_smap_t *sm) {
+  return sm->arena ? sm->arena : &sm->nodes;
+}
+
+// Find the slot of `key`, or NULL if not found
+static oc8_smap_slot_t *find_slot(oc8_smap_t *sm, const char *key,
+                                  size_t hash) {
+  if (!sm->slots_size)
+    return NULL;
+
+  size_t mask = sm->slots_size - 1;
+  for (size_t i = hash & mask;; i = (i + 1) & mask) {
+    oc8_smap_slot_t *slot = &sm->slots[i];
+    if (slot->node) {
+      if (slot->hash == hash && same_key(sm, slot->node->key, key))
+        return slot;
+    } else if (slot->hash == SLOT_EMPTY)
+      return NULL;
+  }
+}
+
+// Empty or removed slot where a node with `hash` can be inserted
+static oc8_smap_slot_t *free_slot(oc8_smap_slot_t *slots, size_t slots_size,
+                                  size_t hash) {
+  size_t mask = slots_size - 1;
+  size_t i = hash & mask;
+  while (slots[i].node)
+    i = (i + 1) & mask;
+  return &slots[i];
+}
+
+// Grow (or clean the removed slots) so that there is room for one more node
+// The load factor stays under 3/4
+static void reserve_one(oc8_smap_t *sm) {
+  if (sm->slots_size && (sm->slots_used + 1) * 4 <= sm->slots_size * 3)
+    return;
+
+  size_t new_size = sm->slots_size ? sm->slots_size : INIT_SLOTS_SIZE;
+  while ((sm->len + 1) * 2 > new_size)
+    new_size *= 2;
+  oc8_smap_slot_t *slots =
+      oc8_arena_alloc(sm->arena, new_size * sizeof(oc8_smap_slot_t));
+  memset(slots, 0, new_size * sizeof(oc8_smap_slot_t));
+
+  for (oc8_smap_node_t *node = sm->head; node; node = node->next) {
+    oc8_smap_slot_t *slot = free_slot(slots, new_size, node->hash);
+    slot->hash = node->hash;
+    slot->node = node;
+  }
+
+  oc8_arena_release(sm->arena, sm->slots);
+  sm->slots = slots;
+  sm->slots_size = new_size;
+  sm->slots_used = sm->len;
+}
+
+void oc8_smap_init(oc8_smap_t *sm) { oc8_smap_init_arena(sm, NULL); }
+
+void oc8_smap_init_arena(oc8_smap_t *sm, oc8_arena_t *arena) {
   sm->head = NULL;
+  sm->tail = NULL;
   sm->len = 0;
+  sm->slots = NULL;
+  sm->slots_size = 0;
+  sm->slots_used = 0;
+  sm->arena = arena;
+  oc8_arena_init(&sm->nodes, CHUNK_SIZE);
+  sm->interned_keys = 0;
+}
+
+void oc8_smap_init_interned(oc8_smap_t *sm, oc8_arena_t *arena) {
+  oc8_smap_init_arena(sm, arena);
+  sm->interned_keys = 1;
 }
 
 void oc8_smap_free(oc8_smap_t *sm) {
-  oc8_smap_node_t *node = sm->head;
-  while (node) {
-    oc8_smap_node_t *next = node->next;
-    free(node);
-    node = next;
-  }
+  oc8_arena_free(&sm->nodes);
+  oc8_arena_release(sm->arena, sm->slots);
 }
 
 oc8_smap_it_t oc8_smap_get_it(oc8_smap_t *sm) {
@@ -23,31 +124,47 @@ oc8_smap_it_t oc8_smap_get_it(oc8_smap_t *sm) {
 }
 
 oc8_smap_node_t *oc8_smap_find(oc8_smap_t *sm, const char *key) {
-  oc8_smap_node_t *node = sm->head;
-  while (node) {
-    if (strcmp(node->key, key) == 0)
-      return node;
-    node = node->next;
-  }
-  return NULL;
+  oc8_smap_slot_t *slot = find_slot(sm, key, hash_key(sm, key));
+  return slot ? slot->node : NULL;
 }
 
 /// Insert a <key, val> pair in the map
 /// If key already exists, update the value
 /// Returns 1 if it was an insertion, 0 if it was an update
 int oc8_smap_insert(oc8_smap_t *sm, const char *key, size_t val) {
-  oc8_smap_node_t *node = oc8_smap_find(sm, key);
-  if (node) {
-    node->val = val;
+  size_t hash = hash_key(sm, key);
+  oc8_smap_slot_t *slot = find_slot(sm, key, hash);
+  if (slot) {
+    slot->node->val = val;
     return 0;
   }
 
-  size_t key_len = strlen(key);
-  node = malloc(sizeof(oc8_smap_node_t) + key_len + 1);
-  node->next = sm->head;
+  size_t key_len = sm->interned_keys ? 0 : strlen(key) + 1;
+  oc8_smap_node_t *node =
+      oc8_arena_alloc(nodes_arena(sm), sizeof(oc8_smap_node_t) + key_len);
+  node->next = NULL;
+  node->prev = sm->tail;
+  node->hash = hash;
   node->val = val;
-  memcpy(node->key, key, key_len + 1);
-  sm->head = node;
+  if (sm->interned_keys)
+    node->key = key;
+  else {
+    memcpy(node->key_buf, key, key_len);
+    node->key = node->key_buf;
+  }
+
+  reserve_one(sm);
+  slot = free_slot(sm->slots, sm->slots_size, hash);
+  if (slot->hash == SLOT_EMPTY)
+    ++sm->slots_used;
+  slot->hash = hash;
+  slot->node = node;
+
+  if (sm->tail)
+    sm->tail->next = node;
+  else
+    sm->head = node;
+  sm->tail = node;
   ++sm->len;
   return 1;
 }
@@ -55,29 +172,24 @@ int oc8_smap_insert(oc8_smap_t *sm, const char *key, size_t val) {
 /// Remove a key (and it's associated value) from the map, if it exists
 /// Returns 1 if the key was found and removed, 0 if not found
 int oc8_smap_remove(oc8_smap_t *sm, const char *key) {
-  oc8_smap_node_t *node = sm->head;
-  if (!node) // Special :Empty list
+  oc8_smap_slot_t *slot = find_slot(sm, key, hash_key(sm, key));
+  if (!slot)
     return 0;
-  if (strcmp(node->key, key) == 0) { // Special: key at the front
-    sm->head = node->next;
-    free(node);
-    --sm->len;
-    return 1;
-  }
 
-  while (node->next) {
-    oc8_smap_node_t *next = node->next;
-    if (strcmp(next->key, key) != 0) {
-      node = next;
-      continue;
-    }
-
-    // Key found, remove node
-    node->next = next->next;
-    free(next);
-    --sm->len;
-    return 1;
-  }
+  // The slot can't be emptied, or the search of the next keys would stop
+  // there. The node memory is kept until the map is freed
+  oc8_smap_node_t *node = slot->node;
+  slot->hash = SLOT_REMOVED;
+  slot->node = NULL;
 
-  return 0;
+  if (node->prev)
+    node->prev->next = node->next;
+  else
+    sm->head = node->next;
+  if (node->next)
+    node->next->prev = node->prev;
+  else
+    sm->tail = node->prev;
+  --sm->len;
+  return 1;
 }
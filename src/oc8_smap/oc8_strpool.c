@@ -0,0 +1,59 @@
+#include "oc8_smap/oc8_strpool.h"
+#include "oc8_smap/oc8_smap.h"
+
+#include <pthread.h>
+
+// Strings are spread over shards by hash, each with its own lock: threads
+// interning different names rarely wait for each other
+#define NB_SHARDS (16)
+#define SHARD_BITS (4)
+
+// The strings are the keys of the maps, their arenas keep them at the same
+// address. The maps are never freed
+// Zero-initialized: an empty map, with nodes in chunks of the default size
+typedef struct {
+  pthread_mutex_t lock;
+  oc8_smap_t pool;
+} shard_t;
+
+#define SHARD_INIT {.lock = PTHREAD_MUTEX_INITIALIZER}
+#define SHARDS_INIT_4 SHARD_INIT, SHARD_INIT, SHARD_INIT, SHARD_INIT
+
+static shard_t g_shards[NB_SHARDS] = {SHARDS_INIT_4, SHARDS_INIT_4,
+                                      SHARDS_INIT_4, SHARDS_INIT_4};
+
+// The map uses the low bits of the hash, the shard the high ones
+static shard_t *get_shard(const char *str) {
+  size_t hash = oc8_smap_hash(str);
+  return &g_shards[hash >> (8 * sizeof(size_t) - SHARD_BITS)];
+}
+
+const char *oc8_strpool_intern(const char *str) {
+  shard_t *shard = get_shard(str);
+  pthread_mutex_lock(&shard->lock);
+  oc8_smap_node_t *node = oc8_smap_find(&shard->pool, str);
+  if (!node) {
+    oc8_smap_insert(&shard->pool, str, 0);
+    node = shard->pool.tail;
+  }
+  pthread_mutex_unlock(&shard->lock);
+  return node->key;
+}
+
+const char *oc8_strpool_find(const char *str) {
+  shard_t *shard = get_shard(str);
+  pthread_mutex_lock(&shard->lock);
+  oc8_smap_node_t *node = oc8_smap_find(&shard->pool, str);
+  pthread_mutex_unlock(&shard->lock);
+  return node ? node->key : NULL;
+}
+
+size_t oc8_strpool_size(void) {
+  size_t res = 0;
+  for (size_t i = 0; i < NB_SHARDS; ++i) {
+    pthread_mutex_lock(&g_shards[i].lock);
+    res += g_shards[i].pool.len;
+    pthread_mutex_unlock(&g_shards[i].lock);
+  }
+  return res;
+}
@@ -1,6 +1,9 @@
 #include <catch2/catch.hpp>
 
 #include "oc8_smap/oc8_smap.h"
+#include "oc8_smap/oc8_strpool.h"
+#include <chrono>
+#include <cstdio>
 #include <set>
 #include <string>
 #include <utility>
@@ -128,3 +131,141 @@ TEST_CASE("oc8_smap insert remove", "") {
 
   oc8_smap_free(&sm);
 }
+
+TEST_CASE("oc8_smap insertion order", "") {
+  oc8_smap_t sm;
+  oc8_smap_init(&sm);
+  std::vector<std::string> exp;
+  for (int i = 0; i < 100; ++i) {
+    exp.push_back("sym_" + std::to_string(i * 7919 % 100));
+    oc8_smap_insert(&sm, exp.back().c_str(), i);
+  }
+  // Removed keys are skipped, and re-inserted keys go last
+  oc8_smap_remove(&sm, exp[0].c_str());
+  oc8_smap_remove(&sm, exp[50].c_str());
+  oc8_smap_insert(&sm, exp[50].c_str(), 50);
+  exp.erase(exp.begin() + 50);
+  exp.erase(exp.begin());
+  exp.push_back("sym_" + std::to_string(50 * 7919 % 100));
+
+  std::vector<std::string> keys;
+  auto it = oc8_smap_get_it(&sm);
+  while (oc8_smap_it_get(&it)) {
+    keys.push_back(oc8_smap_it_get(&it)->key);
+    oc8_smap_it_next(&it);
+  }
+  REQUIRE(keys == exp);
+  oc8_smap_free(&sm);
+}
+
+TEST_CASE("oc8_smap stable nodes", "") {
+  oc8_smap_t sm;
+  oc8_smap_init(&sm);
+  oc8_smap_insert(&sm, "first", 1);
+  oc8_smap_node_t *node = oc8_smap_find(&sm, "first");
+  const char *key = node->key;
+
+  // Growing the table doesn't move the nodes
+  for (int i = 0; i < 1000; ++i)
+    oc8_smap_insert(&sm, std::to_string(i).c_str(), i);
+  REQUIRE(oc8_smap_find(&sm, "first") == node);
+  REQUIRE(node->key == key);
+
+  // Many insertions / removals of the same key reuse the removed slots
+  for (int i = 0; i < 10000; ++i) {
+    REQUIRE(oc8_smap_insert(&sm, "tmp", i) == 1);
+    REQUIRE(oc8_smap_remove(&sm, "tmp") == 1);
+  }
+  REQUIRE(sm.len == 1001);
+  REQUIRE(sm.slots_size <= 4096);
+  oc8_smap_free(&sm);
+}
+
+TEST_CASE("oc8_smap many keys", "") {
+  const int nb_keys = 100000;
+  std::vector<std::string> keys;
+  for (int i = 0; i < nb_keys; ++i)
+    keys.push_back("_L" + std::to_string(i) + "_sym");
+
+  oc8_smap_t sm;
+  oc8_smap_init(&sm);
+  for (int i = 0; i < nb_keys; ++i)
+    REQUIRE(oc8_smap_insert(&sm, keys[i].c_str(), i) == 1);
+  REQUIRE(sm.len == (size_t)nb_keys);
+  for (int i = 0; i < nb_keys; ++i) {
+    auto node = oc8_smap_find(&sm, keys[i].c_str());
+    REQUIRE(node);
+    REQUIRE(node->val == (size_t)i);
+  }
+  REQUIRE(oc8_smap_find(&sm, "_L100000_sym") == nullptr);
+  for (int i = 0; i < nb_keys; i += 2)
+    REQUIRE(oc8_smap_remove(&sm, keys[i].c_str()) == 1);
+  REQUIRE(sm.len == (size_t)nb_keys / 2);
+  for (int i = 0; i < nb_keys; ++i)
+    REQUIRE((oc8_smap_find(&sm, keys[i].c_str()) != nullptr) == (i % 2 == 1));
+  oc8_smap_free(&sm);
+}
+
+TEST_CASE("oc8_smap interned keys", "") {
+  oc8_smap_t sm;
+  oc8_smap_init_interned(&sm, nullptr);
+  std::vector<const char *> keys;
+  for (int i = 0; i < 1000; ++i) {
+    auto key = "smap_interned_" + std::to_string(i);
+    keys.push_back(oc8_strpool_intern(key.c_str()));
+    REQUIRE(oc8_smap_insert(&sm, keys.back(), i) == 1);
+  }
+  REQUIRE(oc8_smap_insert(&sm, keys[3], 42) == 0);
+
+  for (int i = 0; i < 1000; ++i) {
+    auto node = oc8_smap_find(&sm, keys[i]);
+    REQUIRE(node);
+    REQUIRE(node->key == keys[i]);
+    REQUIRE(node->val == (i == 3 ? 42 : (size_t)i));
+  }
+
+  // Same string, but not interned
+  std::string copy = keys[5];
+  REQUIRE(oc8_smap_find(&sm, copy.c_str()) == nullptr);
+  REQUIRE(oc8_smap_remove(&sm, keys[5]) == 1);
+  REQUIRE(oc8_smap_find(&sm, keys[5]) == nullptr);
+  REQUIRE(sm.len == 999);
+  oc8_smap_free(&sm);
+}
+
+// Run with `utest_oc8smap.bin [bench]`
+TEST_CASE("oc8_smap bench 100k", "[.bench]") {
+  const int nb_keys = 100000;
+  const int nb_rounds = 10;
+  std::vector<std::string> keys;
+  for (int i = 0; i < nb_keys; ++i)
+    keys.push_back("_L" + std::to_string(i) + "_sym");
+
+  double insert_us = 0;
+  double find_us = 0;
+  for (int r = 0; r < nb_rounds; ++r) {
+    oc8_smap_t sm;
+    oc8_smap_init(&sm);
+    auto begin = std::chrono::high_resolution_clock::now();
+    for (int i = 0; i < nb_keys; ++i)
+      oc8_smap_insert(&sm, keys[i].c_str(), i);
+    auto mid = std::chrono::high_resolution_clock::now();
+    size_t sum = 0;
+    for (int i = 0; i < nb_keys; ++i)
+      sum += oc8_smap_find(&sm, keys[i].c_str())->val;
+    auto end = std::chrono::high_resolution_clock::now();
+    REQUIRE(sum == (size_t)nb_keys * (nb_keys - 1) / 2);
+    oc8_smap_free(&sm);
+
+    insert_us +=
+        std::chrono::duration_cast<std::chrono::microseconds>(mid - begin)
+            .count();
+    find_us +=
+        std::chrono::duration_cast<std::chrono::microseconds>(end - mid)
+            .count();
+  }
+
+  std::printf("oc8_smap: %d keys, insert %.1f ns/key, find %.1f ns/key\n",
+              nb_keys, insert_us * 1000 / nb_rounds / nb_keys,
+              find_us * 1000 / nb_rounds / nb_keys);
+}
@@ -0,0 +1,45 @@
+#include <catch2/catch.hpp>
+
+#include "oc8_smap/oc8_strpool.h"
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+TEST_CASE("oc8_strpool same pointer", "") {
+  std::string a = "strpool_foo";
+  std::string b = "strpool_foo";
+  const char *ia = oc8_strpool_intern(a.c_str());
+  const char *ib = oc8_strpool_intern(b.c_str());
+  REQUIRE(ia == ib);
+  REQUIRE(ia != a.c_str());
+  REQUIRE(std::strcmp(ia, "strpool_foo") == 0);
+  REQUIRE(oc8_strpool_find("strpool_foo") == ia);
+
+  REQUIRE(oc8_strpool_find("strpool_bar") == nullptr);
+  size_t size = oc8_strpool_size();
+  const char *ic = oc8_strpool_intern("strpool_bar");
+  REQUIRE(ic != ia);
+  REQUIRE(oc8_strpool_size() == size + 1);
+  REQUIRE(oc8_strpool_intern(ic) == ic);
+  REQUIRE(oc8_strpool_size() == size + 1);
+}
+
+TEST_CASE("oc8_strpool many threads", "") {
+  std::vector<std::vector<const char *>> res(4);
+  std::vector<std::thread> threads;
+  for (size_t t = 0; t < res.size(); ++t)
+    threads.emplace_back([&, t] {
+      for (int i = 0; i < 2000; ++i) {
+        auto str = "strpool_th_" + std::to_string(i);
+        res[t].push_back(oc8_strpool_intern(str.c_str()));
+      }
+    });
+  for (auto &t : threads)
+    t.join();
+
+  for (size_t t = 1; t < res.size(); ++t)
+    REQUIRE(res[t] == res[0]);
+  for (int i = 0; i < 2000; ++i)
+    REQUIRE(res[0][i] == "strpool_th_" + std::to_string(i));
+}